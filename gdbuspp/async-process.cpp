@@ -18,16 +18,26 @@
 #include <iostream>
 #include <string>
 #include <memory>
+#include <sched.h>
 
 #include "async-process.hpp"
 #include "authz-request.hpp"
 #include "exceptions.hpp"
+#define GDBUSPP_LOG_CATEGORY REQUESTS
+#include "features/debug-log.hpp"
+#include "features/probes.hpp"
 #include "object/base.hpp"
 #include "glib2/callbacks.hpp"
 
 
 using namespace DBus;
 
+/**
+ *  Maximum number of released AsyncProcess::Request objects kept
+ *  for reuse
+ */
+#define GDBUSPP_REQUEST_RECYCLE_MAX 256
+
 
 AsyncProcess::Exception::Exception(const std::string &err)
     : DBus::Exception("AsyncProcess", err)
@@ -35,22 +45,112 @@ AsyncProcess::Exception::Exception(const std::string &err)
 }
 
 
+AsyncProcess::LimitsExceeded::LimitsExceeded(const std::string &err)
+    : AsyncProcess::Exception(err)
+{
+}
+
+
 
 //
 //  AsyncProcess::Request
 //
 
+namespace {
+
+/**
+ *  The released AsyncProcess::Request objects kept for reuse
+ */
+class RecycledRequests
+{
+  public:
+    RecycledRequests()
+    {
+        requests.reserve(GDBUSPP_REQUEST_RECYCLE_MAX);
+    }
+
+    ~RecycledRequests() noexcept
+    {
+        for (auto req : requests)
+        {
+            delete req;
+        }
+    }
+
+    AsyncProcess::Request *Acquire() noexcept
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        if (requests.empty())
+        {
+            return nullptr;
+        }
+        AsyncProcess::Request *req = requests.back();
+        requests.pop_back();
+        return req;
+    }
+
+    bool Release(AsyncProcess::Request *req) noexcept
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        if (requests.size() >= GDBUSPP_REQUEST_RECYCLE_MAX)
+        {
+            return false;
+        }
+        requests.push_back(req);
+        return true;
+    }
+
+  private:
+    std::mutex mtx{};
+    std::vector<AsyncProcess::Request *> requests{};
+};
+
+
+static RecycledRequests &recycled_requests()
+{
+    static RecycledRequests recycled;
+    return recycled;
+}
+
+} // anonymous namespace
+
+
+void AsyncProcess::Request::Recycler::operator()(Request *req) const noexcept
+{
+    if (!req)
+    {
+        return;
+    }
+    req->reset();
+    if (!recycled_requests().Release(req))
+    {
+        delete req;
+    }
+}
+
+
+AsyncProcess::Request::UPtr AsyncProcess::Request::Create(GDBusConnection *gdbus_conn,
+                                                          std::shared_ptr<Object::Base> dbus_object,
+                                                          const std::string &sender,
+                                                          const DBus::Object::Path &object_path,
+                                                          const std::string &interface)
+{
+    Request *recycled = recycled_requests().Acquire();
+    UPtr req(recycled ? recycled : new Request());
+    req->prepare(gdbus_conn, dbus_object, sender, object_path, interface);
+    return req;
+}
 
 
-AsyncProcess::Request::Request(GDBusConnection *gdbus_conn_,
-                               std::shared_ptr<Object::Base> dbus_object_,
-                               const std::string &sender_,
-                               const DBus::Object::Path &object_path,
-                               const std::string &interface)
-    : dbusconn(gdbus_conn_),
-      object(dbus_object_),
-      sender(sender_)
+void AsyncProcess::Request::prepare(GDBusConnection *gdbus_conn_,
+                                    std::shared_ptr<Object::Base> dbus_object_,
+                                    const std::string &sender_,
+                                    const DBus::Object::Path &object_path,
+                                    const std::string &interface)
 {
+    dbusconn = gdbus_conn_;
+    object = std::move(dbus_object_);
+    sender.assign(sender_);
     if ((object_path != object->GetPath())
         || (interface != object->GetInterface()))
     {
@@ -60,6 +160,67 @@ AsyncProcess::Request::Request(GDBusConnection *gdbus_conn_,
 }
 
 
+void AsyncProcess::Request::reset() noexcept
+{
+    if (params_owned && params)
+    {
+        g_variant_unref(params);
+    }
+    if (cancellable)
+    {
+        g_object_unref(cancellable);
+    }
+    if (response)
+    {
+        g_variant_unref(response);
+    }
+    dbusconn = nullptr;
+    object.reset();
+    sender.clear();
+    request_type = Object::Operation::NONE;
+    method.clear();
+    property.clear();
+    params = nullptr;
+    params_owned = false;
+    invocation = nullptr;
+    response = nullptr;
+    error_domain.assign(DEFAULT_ERROR_DOMAIN);
+    priority = Priority::NORMAL;
+    sequence = 0;
+    backlog = 0;
+    run_inline = false;
+    strand = false;
+    authorized = false;
+    reserved = false;
+    cancellable = nullptr;
+    metrics.reset();
+    received_at = 0;
+}
+
+
+AsyncProcess::Request::~Request() noexcept
+{
+    if (params_owned && params)
+    {
+        g_variant_unref(params);
+    }
+    if (cancellable)
+    {
+        g_object_unref(cancellable);
+    }
+    if (response)
+    {
+        g_variant_unref(response);
+    }
+}
+
+
+bool AsyncProcess::Request::IsCancelled() const noexcept
+{
+    return cancellable && g_cancellable_is_cancelled(cancellable);
+}
+
+
 void AsyncProcess::Request::MethodCall(const std::string &meth,
                                        GVariant *prms,
                                        GDBusMethodInvocation *invoc) noexcept
@@ -68,6 +229,8 @@ void AsyncProcess::Request::MethodCall(const std::string &meth,
     method = meth;
     params = prms;
     invocation = invoc;
+    priority = object->GetMethodPriority(method);
+    run_inline = object->MethodRunsInline(method);
 }
 
 
@@ -78,6 +241,14 @@ void AsyncProcess::Request::GetProperty(const std::string &propname) noexcept
 }
 
 
+void AsyncProcess::Request::GetProperty(const std::string &propname,
+                                        GDBusMethodInvocation *invoc) noexcept
+{
+    GetProperty(propname);
+    invocation = invoc;
+}
+
+
 void AsyncProcess::Request::SetProperty(const std::string &propname, GVariant *prms) noexcept
 {
     request_type = Object::Operation::PROPERTY_SET;
@@ -86,6 +257,16 @@ void AsyncProcess::Request::SetProperty(const std::string &propname, GVariant *p
 }
 
 
+void AsyncProcess::Request::SetProperty(const std::string &propname,
+                                        GVariant *prms,
+                                        GDBusMethodInvocation *invoc) noexcept
+{
+    SetProperty(propname, prms);
+    params_owned = true;
+    invocation = invoc;
+}
+
+
 
 //
 //   AsyncProcess::Pool
@@ -93,52 +274,440 @@ void AsyncProcess::Request::SetProperty(const std::string &propname, GVariant *p
 
 
 
-AsyncProcess::Pool::Pool()
+namespace DBus::AsyncProcess::_private {
+
+/**
+ *  Sorts the queued requests in the glib2 thread pool; first by
+ *  priority, then by how many requests the same sender has ahead of
+ *  it and then in the order they were queued.  This gives a round-robin
+ *  order between the senders.
+ */
+static int request_queue_order(const void *a, const void *b, void *)
+{
+    auto req_a = static_cast<const Request *>(a);
+    auto req_b = static_cast<const Request *>(b);
+    if (req_a->priority != req_b->priority)
+    {
+        return (req_a->priority < req_b->priority ? -1 : 1);
+    }
+    if (req_a->backlog != req_b->backlog)
+    {
+        return (req_a->backlog < req_b->backlog ? -1 : 1);
+    }
+    return (req_a->sequence < req_b->sequence ? -1 : 1);
+}
+
+
+/**
+ *  Sorts the requests waiting for an object serializing its requests;
+ *  by priority and then in the order they arrived
+ */
+static bool strand_queue_order(const Request *a, const Request *b)
+{
+    if (a->priority != b->priority)
+    {
+        return a->priority < b->priority;
+    }
+    return a->sequence < b->sequence;
+}
+
+
+/**
+ *  Completes a request which will not be processed with an error reply,
+ *  so the caller does not wait for a reply which never comes
+ *
+ * @param req   Request to complete; released when done
+ * @param msg   C string with the error message to return
+ */
+static void reject_request(Request::UPtr &req, const char *msg) noexcept
 {
-    int avail_procs = (g_get_num_processors() / 2);
+    if (req->invocation)
+    {
+        g_dbus_method_invocation_return_error_literal(req->invocation,
+                                                      G_DBUS_ERROR,
+                                                      G_DBUS_ERROR_FAILED,
+                                                      msg);
+        req->invocation = nullptr;
+    }
+    req.reset();
+}
+
+
+/**
+ *  Pool the calling thread is processing a request for, between the
+ *  Pool::RequestStarted() and Pool::RequestDone() calls.  Used by
+ *  Pool::Drain() to not wait for the request of the calling thread.
+ */
+static thread_local const Pool *processing_pool = nullptr;
+
+} // namespace DBus::AsyncProcess::_private
+
+
+AsyncProcess::Pool::Pool(const Config &cfg)
+    : config(cfg)
+{
+    if (!config.cpu_affinity.empty() && !config.exclusive)
+    {
+        throw AsyncProcess::Exception("CPU affinity requires exclusive threads");
+    }
+
+    int max_threads = (config.max_threads > 0
+                           ? static_cast<int>(config.max_threads)
+                           : std::max(1, static_cast<int>(g_get_num_processors() / 2)));
+    GError *err = nullptr;
     pool = g_thread_pool_new(glib2::Callbacks::_int_pool_processpool_cb,
-                             nullptr,
-                             std::max(1, avail_procs),
-                             false,
-                             nullptr);
+                             this,
+                             max_threads,
+                             config.exclusive,
+                             &err);
     if (!pool)
     {
-        throw DBus::Exception("AsyncProcess::Pool", "g_thread_pool_new() failed");
+        throw DBus::Exception("AsyncProcess::Pool", "g_thread_pool_new() failed", err);
     }
+    g_thread_pool_set_sort_function(pool, AsyncProcess::_private::request_queue_order, nullptr);
 }
 
 
 AsyncProcess::Pool::~Pool() noexcept
 {
-    g_thread_pool_free(pool, true, true);
+    // The queued requests are passed on to the worker threads, which
+    // return an error reply for each of them
+    shutting_down.store(true);
+    g_thread_pool_free(pool, false, true);
+    for (auto &s : strands)
+    {
+        for (auto &req : s.second)
+        {
+            Request::UPtr r(req);
+            _private::reject_request(r, "Service is shutting down");
+        }
+    }
+    for (auto &sl : sender_load)
+    {
+        g_object_unref(sl.second.cancellable);
+    }
 }
 
 
 void AsyncProcess::Pool::PushCallback(Request::UPtr &req)
 {
-    void *ptr = req.release();
-    if (!ptr)
+    if (!req)
     {
         std::cerr << "ctx.release() returned nullptr" << std::endl;
         return;
     }
 
+    if (!req->reserved)
+    {
+        Reserve(req);
+    }
+    req->reserved = false;
+    req->sequence = sequence.fetch_add(1, std::memory_order_relaxed);
+    GDBUSPP_TRACE(REQUESTS, DEBUG, "Request queued: sequence={}, backlog={}", req->sequence, req->backlog);
+    if (GDBUSPP_PROBE_ENABLED(request_queued))
+    {
+        GDBUSPP_PROBE(request_queued,
+                      req->object->GetPath().c_str(),
+                      req->object->GetInterface().c_str(),
+                      (req->method.empty() ? req->property.c_str() : req->method.c_str()),
+                      req->sequence);
+    }
+
+    if (req->object->RequestsSerialized())
+    {
+        req->strand = true;
+        std::lock_guard<std::mutex> lg(strand_mtx);
+        auto it = strands.find(req->object.get());
+        if (strands.end() != it)
+        {
+            // A request for the same object is being processed or queued;
+            // this one is run once that has completed, see StrandNext()
+            auto &queue = it->second;
+            queue.insert(std::upper_bound(queue.begin(),
+                                          queue.end(),
+                                          req.get(),
+                                          _private::strand_queue_order),
+                         req.get());
+            req.release();
+            return;
+        }
+        strands[req->object.get()] = {};
+    }
 
     GError *err = nullptr;
+    if (g_thread_pool_push(pool, req.get(), &err))
+    {
+        req.release();
+        return;
+    }
 
-    if (!g_thread_pool_push(pool, ptr, &err))
+    if (err)
+    {
+        std::cerr << "** ERROR ** AsyncProcess::Pool::PushCallback:"
+                  << std::string(err->message) << std::endl
+                  << "         ** " << req.get() << std::endl;
+        g_error_free(err);
+    }
+    else
+    {
+        std::cerr << "** ERROR **  AsyncProcess::Pool::PushCallback:"
+                  << "Failed calling g_thread_pool_push() {" << req.get() << "}"
+                  << std::endl;
+    }
+
+    const std::string sender = req->sender;
+    const Object::Base *strand_object = (req->strand ? req->object.get() : nullptr);
+    _private::reject_request(req, "Request could not be queued");
+    RequestDone(sender, false);
+    if (strand_object)
+    {
+        // The requests of the same object which arrived meanwhile
+        // cannot be queued either
+        std::deque<Request *> waiting;
+        {
+            std::lock_guard<std::mutex> lg(strand_mtx);
+            auto it = strands.find(strand_object);
+            if (strands.end() != it)
+            {
+                waiting.swap(it->second);
+                strands.erase(it);
+            }
+        }
+        for (auto &w : waiting)
+        {
+            Request::UPtr r(w);
+            const std::string s = r->sender;
+            _private::reject_request(r, "Request could not be queued");
+            RequestDone(s, false);
+        }
+    }
+}
+
+
+void AsyncProcess::Pool::Reserve(Request::UPtr &req)
+{
+    std::lock_guard<std::mutex> lg(load_mtx);
+    if (draining)
+    {
+        throw AsyncProcess::Exception("Service is shutting down");
+    }
+    if (config.max_queued > 0 && total_load >= config.max_queued)
+    {
+        throw AsyncProcess::LimitsExceeded("Too many requests queued");
+    }
+    SenderLoad &sl = sender_load[req->sender];
+    if (config.max_queued_per_sender > 0 && sl.load >= config.max_queued_per_sender)
     {
-        if (err)
+        throw AsyncProcess::LimitsExceeded("Too many requests queued from "
+                                           + req->sender);
+    }
+    if (!sl.cancellable)
+    {
+        sl.cancellable = g_cancellable_new();
+        if (sender_watch && ':' == req->sender[0])
         {
-            std::cerr << "** ERROR ** AsyncProcess::Pool::PushCallback:"
-                      << std::string(err->message) << std::endl
-                      << "         ** " << &req << std::endl;
+            std::weak_ptr<Pool> pool_wptr = weak_from_this();
+            sender_watch->Add(req->sender,
+                              [pool_wptr](const std::string &sender)
+                              {
+                                  auto pool = pool_wptr.lock();
+                                  if (pool)
+                                  {
+                                      pool->CancelSender(sender);
+                                  }
+                              });
         }
-        else
+    }
+    if (!req->cancellable)
+    {
+        req->cancellable = G_CANCELLABLE(g_object_ref(sl.cancellable));
+    }
+    req->backlog = sl.load++;
+    ++total_load;
+    req->reserved = true;
+}
+
+
+void AsyncProcess::Pool::Unreserve(Request::UPtr &req) noexcept
+{
+    if (req && req->reserved)
+    {
+        req->reserved = false;
+        RequestDone(req->sender, false);
+    }
+}
+
+
+void AsyncProcess::Pool::RequestStarted() noexcept
+{
+    std::lock_guard<std::mutex> lg(load_mtx);
+    ++in_flight;
+    _private::processing_pool = this;
+}
+
+
+void AsyncProcess::Pool::RequestDone(const std::string &sender, const bool started) noexcept
+{
+    std::lock_guard<std::mutex> lg(load_mtx);
+    if (started)
+    {
+        --in_flight;
+        _private::processing_pool = nullptr;
+    }
+    auto it = sender_load.find(sender);
+    if (sender_load.end() == it)
+    {
+        return;
+    }
+    if (--(it->second.load) == 0)
+    {
+        g_object_unref(it->second.cancellable);
+        if (sender_watch)
         {
-            std::cerr << "** ERROR **  AsyncProcess::Pool::PushCallback:"
-                      << "Failed calling g_thread_pool_push() {" << &req << "}"
-                      << std::endl;
+            sender_watch->Remove(sender);
         }
+        sender_load.erase(it);
+    }
+    if (--total_load <= 1)
+    {
+        drained_cv.notify_all();
+    }
+}
+
+
+bool AsyncProcess::Pool::ShuttingDown() const noexcept
+{
+    return shutting_down.load();
+}
+
+
+AsyncProcess::Request::UPtr AsyncProcess::Pool::StrandNext(const Object::Base *object,
+                                                           const bool run_here) noexcept
+{
+    std::lock_guard<std::mutex> lg(strand_mtx);
+    auto it = strands.find(object);
+    if (strands.end() == it)
+    {
+        return nullptr;
+    }
+    if (it->second.empty())
+    {
+        strands.erase(it);
+        return nullptr;
+    }
+    Request::UPtr next(it->second.front());
+    it->second.pop_front();
+    if (run_here)
+    {
+        return next;
+    }
+
+    if (!g_thread_pool_push(pool, next.get(), nullptr))
+    {
+        // Could not be queued again; process it right away instead
+        return next;
+    }
+    next.release();
+    return nullptr;
+}
+
+
+unsigned int AsyncProcess::Pool::GetInFlight() const noexcept
+{
+    std::lock_guard<std::mutex> lg(load_mtx);
+    return in_flight;
+}
+
+
+unsigned int AsyncProcess::Pool::GetQueued() const noexcept
+{
+    std::lock_guard<std::mutex> lg(load_mtx);
+    return total_load - in_flight;
+}
+
+
+unsigned int AsyncProcess::Pool::GetThreads() const noexcept
+{
+    return g_thread_pool_get_num_threads(pool);
+}
+
+
+bool AsyncProcess::Pool::Drain(const std::chrono::milliseconds deadline)
+{
+    // When called while processing a request of this pool, such as a
+    // D-Bus method stopping the service, that request cannot complete
+    // before this returns; it is not waited for.
+    const unsigned int own = (this == _private::processing_pool ? 1 : 0);
+
+    std::unique_lock<std::mutex> lg(load_mtx);
+    draining = true;
+    const bool drained = drained_cv.wait_for(lg,
+                                             deadline,
+                                             [this, own]()
+                                             {
+                                                 return own >= total_load;
+                                             });
+    if (!drained)
+    {
+        GDBUSPP_LOG("AsyncProcess::Pool: drain deadline reached with "
+                    << in_flight << " requests in flight and "
+                    << (total_load - in_flight) << " queued");
+    }
+    return drained;
+}
+
+
+void AsyncProcess::Pool::WatchSenders(DBus::Connection::Ptr conn)
+{
+    std::lock_guard<std::mutex> lg(load_mtx);
+    if (sender_watch || !conn)
+    {
+        return;
+    }
+    sender_watch = BusWatcher::NameSet::Create(conn);
+}
+
+
+void AsyncProcess::Pool::CancelSender(const std::string &sender) noexcept
+{
+    std::lock_guard<std::mutex> lg(load_mtx);
+    auto it = sender_load.find(sender);
+    if (sender_load.end() == it)
+    {
+        return;
+    }
+    GDBUSPP_LOG("AsyncProcess::Pool: caller vanished, cancelling "
+                << it->second.load << " requests from " << sender);
+    g_cancellable_cancel(it->second.cancellable);
+}
+
+
+void AsyncProcess::Pool::PrepareWorkerThread() const noexcept
+{
+    if (config.cpu_affinity.empty())
+    {
+        return;
+    }
+
+    // Exclusive threads are only used by this pool; the
+    // affinity only needs to be set once per thread
+    thread_local bool prepared = false;
+    if (prepared)
+    {
+        return;
+    }
+    prepared = true;
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (const auto &cpu : config.cpu_affinity)
+    {
+        CPU_SET(cpu, &cpus);
+    }
+    if (0 != sched_setaffinity(0, sizeof(cpus), &cpus))
+    {
+        std::cerr << "** ERROR **  AsyncProcess::Pool: "
+                  << "Could not set the CPU affinity of the processing thread"
+                  << std::endl;
     }
 }
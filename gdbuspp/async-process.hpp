@@ -15,15 +15,34 @@
  * @brief C++ wrapper for the glib2 g_thread_pool interface
  */
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <sstream>
+#include <unordered_map>
+#include <vector>
 #include <gio/gio.h>
 
+#include "bus-watcher.hpp"
+#include "connection.hpp"
 #include "exceptions.hpp"
+#include "features/metrics.hpp"
 #include "object/operation.hpp"
 #include "object/path.hpp"
 
+/**
+ *  Maximum number of requests of an object serializing its requests
+ *  processed in a row by the same worker thread, before the next one is
+ *  queued in the thread pool again.  See Object::Base::SerializeRequests()
+ */
+#define GDBUSPP_STRAND_BURST 32
+
+
 namespace DBus {
 
 // Forward declaration; needed by AsyncProcess below
@@ -41,7 +60,8 @@ class Base;
  *
  *  The basic conecpt is around using a pool of processing threads, which
  *  receives a pointer to some data to work on.  The thread pool is by
- *  designed to be half of the amount of available CPU cores.
+ *  default designed to be half of the amount of available CPU cores.
+ *  This can be changed via the AsyncProcess::Pool::Config settings.
  *
  */
 namespace AsyncProcess {
@@ -53,6 +73,32 @@ class Exception : public DBus::Exception
 };
 
 
+/**
+ *  Thrown by AsyncProcess::Pool::PushCallback() when a request is rejected
+ *  because the configured queue limits are reached.  The D-Bus caller
+ *  should receive an org.freedesktop.DBus.Error.LimitsExceeded error.
+ */
+class LimitsExceeded : public Exception
+{
+  public:
+    LimitsExceeded(const std::string &err);
+};
+
+
+/**
+ *  Processing priority of a request.  Queued requests with a higher
+ *  priority are processed before requests with a lower priority.
+ *  Requests with the same priority are processed in the order they
+ *  were queued.
+ */
+enum class Priority : uint8_t
+{
+    HIGH = 0,   ///< Cheap control-plane operations, should not wait for others
+    NORMAL = 1, ///< Default priority
+    LOW = 2     ///< Long-running bulk operations
+};
+
+
 /**
  *  The AsyncProcess::Request contains information related to a specific
  *  incoming D-Bus request.  It carries information as the D-Bus connection,
@@ -65,21 +111,34 @@ class Exception : public DBus::Exception
  *  It is the glib2 thread pool feature which will queue up and dispatch
  *  these requests when there are resources available.
  *
+ *  Released requests are recycled by later @Create() calls, keeping the
+ *  memory and the string buffers of the request.  In a steady state
+ *  this avoids allocating anything per request.
  */
 struct Request
 {
   public:
+    /**
+     *  Deleter used by Request::UPtr.  This cleans up the request and
+     *  keeps it for reuse instead of freeing it, unless enough requests
+     *  are already kept.
+     */
+    struct Recycler
+    {
+        void operator()(Request *req) const noexcept;
+    };
+
     using Ptr = std::shared_ptr<Request>;
-    using UPtr = std::unique_ptr<Request>;
+    using UPtr = std::unique_ptr<Request, Recycler>;
 
     /// glib2 D-Bus connection object where the request came from
-    const GDBusConnection *dbusconn;
+    const GDBusConnection *dbusconn = nullptr;
 
     /// aka: Object::Base::Ptr; the DBus::Object::Base object being processed
     std::shared_ptr<Object::Base> object;
 
     /// The D-Bus caller's unique bus name
-    const std::string sender;
+    std::string sender;
 
     /// The object operation this request wants to perform
     Object::Operation request_type = Object::Operation::NONE;
@@ -97,15 +156,59 @@ struct Request
     /// Used with ReqType::METHOD, where the result of the callback function is returned
     GDBusMethodInvocation *invocation = nullptr;
 
+    /// Used with Object::Operation::METHOD_CALL requests without an
+    /// invocation, such as calls via Object::BatchObject; the values
+    /// returned by the method.  Owned by this request.
+    GVariant *response = nullptr;
+
     /// Default error domain in case of reporting errors back
-    std::string error_domain = "net.openvpn.gdbuspp.request";
+    std::string error_domain = DEFAULT_ERROR_DOMAIN;
+
+    /// Processing priority of this request in the AsyncProcess::Pool queue
+    Priority priority = Priority::NORMAL;
+
+    /// Queue order of this request; set by AsyncProcess::Pool::PushCallback()
+    uint64_t sequence = 0;
+
+    /// Number of requests from the same sender being processed or queued
+    /// before this request; set by AsyncProcess::Pool::PushCallback()
+    unsigned int backlog = 0;
+
+    /// If true, the request is processed by the thread dispatching the
+    /// D-Bus call instead of being queued in the AsyncProcess::Pool
+    bool run_inline = false;
+
+    /// Set when the object serializes its requests, see
+    /// Object::Base::SerializeRequests(); set by AsyncProcess::Pool::PushCallback()
+    bool strand = false;
+
+    /// Set when the request was authorized before being queued, via
+    /// Object::Base::AuthorizeAsync()
+    bool authorized = false;
+
+    /// Set while the request is counted against the queue limits without
+    /// being queued yet, see AsyncProcess::Pool::Reserve()
+    bool reserved = false;
+
+    /// Cancelled when the D-Bus caller disconnects; shared by all the
+    /// requests from the same caller.  Set by AsyncProcess::Pool::PushCallback()
+    GCancellable *cancellable = nullptr;
+
+    /// Metrics of the called method; only set while Features::Metrics
+    /// are enabled.  Set by glib2::Callbacks::_int_dbusobject_callback_method_call()
+    Features::Metrics::MethodStats::Ptr metrics = nullptr;
+
+    /// Monotonic timestamp (microseconds) of when the request was received;
+    /// only set together with the metrics pointer
+    int64_t received_at = 0;
 
 
     /**
      *  Creates a new AsyncProcess::Request object for a specific D-Bus object.
      *  These objects are created via the glib2::Callback C functions which
      *  will end up in the DBus::Object::Base callback methods to be processed
-     *  in that object.
+     *  in that object.  A previously released request is reused if
+     *  available.
      *
      * @param gdbus_conn      glib2 GDBusConnection object where the request came from
      * @param dbus_object     DBus::Object::Ptr (shared_ptr) to the C++ object side
@@ -114,21 +217,17 @@ struct Request
      * @param interface       std::String with the D-Bus interface to operate on
      *
      * @returns a Request::Ptr (unique_ptr) to the new async request
+     *
+     * @throws AsyncProcess::Exception if the object path or interface does
+     *         not match the D-Bus object
      */
     static Request::UPtr Create(GDBusConnection *gdbus_conn,
                                 std::shared_ptr<Object::Base> dbus_object,
                                 const std::string &sender,
                                 const DBus::Object::Path &object_path,
-                                const std::string &interface)
-    {
-        return UPtr(new Request(gdbus_conn,
-                                dbus_object,
-                                sender,
-                                object_path,
-                                interface));
-    }
+                                const std::string &interface);
 
-    virtual ~Request() noexcept = default;
+    virtual ~Request() noexcept;
 
 
     /**
@@ -154,6 +253,19 @@ struct Request
      */
     void GetProperty(const std::string &propname) noexcept;
 
+    /**
+     *  Prepare this request to retrieve a D-Bus object property value
+     *  asynchronously, via an org.freedesktop.DBus.Properties.Get or
+     *  GetAll method call.
+     *
+     * @param propname  std::string containing the property name to extract the
+     *                  value for.  If empty, all property values are retrieved
+     * @param invoc     GDBusMethodInvocation pointer needed to respond to the
+     *                  D-Bus method call
+     */
+    void GetProperty(const std::string &propname,
+                     GDBusMethodInvocation *invoc) noexcept;
+
 
     /**
      *  Prepare this request to set a new value to a property in the given
@@ -166,6 +278,32 @@ struct Request
      */
     void SetProperty(const std::string &propname, GVariant *prms) noexcept;
 
+    /**
+     *  Prepare this request to set a new value to a property in the given
+     *  D-Bus object asynchronously, via an org.freedesktop.DBus.Properties.Set
+     *  method call.
+     *
+     *  This request object takes over the ownership of the value.
+     *
+     * @param propname   std::string containing the property name where to
+     *                   set the property value
+     * @param prms       GVariant* containing the new value to use for the
+     *                   property
+     * @param invoc      GDBusMethodInvocation pointer needed to respond to the
+     *                   D-Bus method call
+     */
+    void SetProperty(const std::string &propname,
+                     GVariant *prms,
+                     GDBusMethodInvocation *invoc) noexcept;
+
+
+    /**
+     *  Check if the D-Bus caller of this request has disconnected
+     *
+     * @return true if the request has been cancelled
+     */
+    bool IsCancelled() const noexcept;
+
 
     /**
      *  Standard iostream compliant stream operator, providing a human readable
@@ -197,23 +335,40 @@ struct Request
 
 
   private:
+    static constexpr const char *DEFAULT_ERROR_DOMAIN = "net.openvpn.gdbuspp.request";
+
+    /// Set if the params value is owned by this request object
+    bool params_owned = false;
+
     /**
-     *  This is the base information required for all kind
-     *  of DBus object operations.
-     *
      *  This must be called via the static @Create() method
+     */
+    Request() = default;
+
+    /**
+     *  Sets the base information required for all kind of DBus
+     *  object operations.
      *
      * @param gdbus_conn      GDBusConnection pointer where the request came from
      * @param dbus_object     DBus::Object::Ptr (shared_ptr) to the C++ object side
      * @param sender          std::string containing the unique bus name of the sender
      * @param object_path     DBus::Object::Path with the D-Bus object path to operate on
      * @param interface       std::String with the D-Bus interface to operate on
+     *
+     * @throws AsyncProcess::Exception if the object path or interface does
+     *         not match the D-Bus object
      */
-    Request(GDBusConnection *gdbus_conn,
-            std::shared_ptr<Object::Base> dbus_object,
-            const std::string &sender,
-            const DBus::Object::Path &object_path,
-            const std::string &interface);
+    void prepare(GDBusConnection *gdbus_conn,
+                 std::shared_ptr<Object::Base> dbus_object,
+                 const std::string &sender,
+                 const DBus::Object::Path &object_path,
+                 const std::string &interface);
+
+    /**
+     *  Releases everything this request refers to and restores the
+     *  default values, keeping the allocated string buffers.
+     */
+    void reset() noexcept;
 };
 
 
@@ -223,45 +378,256 @@ struct Request
  *  feature.  This is also the object receiving AsyncProcess::Request objects
  *  to be queued for processing
  */
-class Pool
+class Pool : public std::enable_shared_from_this<Pool>
 {
   public:
     using Ptr = std::shared_ptr<Pool>;
 
     /**
-     * Construct a new Pool object
+     *  Settings for the thread pool processing the requests
+     */
+    struct Config
+    {
+        /// Maximum number of processing threads.  If 0, half of the
+        /// available CPU cores are used
+        unsigned int max_threads = 0;
+
+        /// If true, the threads are dedicated to this pool.  Otherwise
+        /// the threads are shared with other non-exclusive glib2 thread pools
+        bool exclusive = false;
+
+        /// CPU cores the processing threads may run on.  If empty, the
+        /// threads may run on any CPU core.  This requires exclusive threads
+        std::vector<unsigned int> cpu_affinity = {};
+
+        /// Maximum number of requests being queued or processed in total.
+        /// If 0, there is no limit
+        unsigned int max_queued = 0;
+
+        /// Maximum number of requests from a single D-Bus caller being
+        /// queued or processed.  If 0, there is no limit
+        unsigned int max_queued_per_sender = 0;
+    };
+
+    /**
+     * Construct a new Pool object with the default settings
      *
      * The glib2 thread pool is allocated and prepared when the
      * constructed returns
      */
     [[nodiscard]] static Pool::Ptr Create()
     {
-        return Pool::Ptr(new Pool());
+        return Pool::Ptr(new Pool(Config()));
+    }
+
+    /**
+     * Construct a new Pool object
+     *
+     * The glib2 thread pool is allocated and prepared when the
+     * constructed returns
+     *
+     * @param cfg   Pool::Config with the thread pool settings
+     *
+     * @throws AsyncProcess::Exception if the configuration is invalid
+     *         or the thread pool could not be created
+     */
+    [[nodiscard]] static Pool::Ptr Create(const Config &cfg)
+    {
+        return Pool::Ptr(new Pool(cfg));
     }
 
 
     /**
      * Destroy the Pool object
      *
-     * This will also release the glib2 thread pool once all pushed requests
-     * has been processed.  This will block the destructor to return until
-     * the processing queue is empty.  New requests are not allowed to be added
-     * in the mean time.
+     * This waits for the requests being processed to complete and then
+     * releases the glib2 thread pool.  The requests still queued are not
+     * processed; their callers get an error reply instead.  New requests
+     * are not allowed to be added in the mean time.
      */
     ~Pool() noexcept;
 
     /**
      *  Pushes a new AsyncProcess::Request to queued up for processing
      *
+     *  Requests with the same priority are scheduled round-robin between
+     *  the D-Bus callers, so a single caller flooding the service does not
+     *  starve the other callers.
+     *
      * @param req  AsyncProcess::Request::UPtr  to the data to be processed
+     *
+     * @throws AsyncProcess::LimitsExceeded if the request is rejected due
+     *         to the configured queue limits.  The request is not
+     *         released in this case.
+     * @throws AsyncProcess::Exception if the pool is being drained,
+     *         see @Drain().  The request is not released in this case.
      */
     void PushCallback(Request::UPtr &req);
 
+    /**
+     *  Count a request against the queue limits before it is queued,
+     *  while it waits for an asynchronous authorization decision.  The
+     *  request also gets the cancellation of its D-Bus caller.  A
+     *  reserved request is queued by PushCallback() without being
+     *  checked against the limits again, also while the pool is being
+     *  drained.  If it is not queued, the reservation must be released
+     *  via Unreserve().
+     *
+     * @param req  AsyncProcess::Request::UPtr to the request to count
+     *
+     * @throws AsyncProcess::LimitsExceeded or AsyncProcess::Exception,
+     *         like PushCallback()
+     */
+    void Reserve(Request::UPtr &req);
+
+    /**
+     *  Release the reservation made by Reserve() of a request which will
+     *  not be queued
+     *
+     * @param req  AsyncProcess::Request::UPtr to the reserved request
+     */
+    void Unreserve(Request::UPtr &req) noexcept;
+
+    /**
+     *  Marks a request as taken by a processing thread.  This is called
+     *  by the glib2::Callbacks::_int_pool_processpool_cb() function.
+     */
+    void RequestStarted() noexcept;
+
+    /**
+     *  Marks a request from a D-Bus caller as processed, making room
+     *  for more requests from the same caller.  This is called by the
+     *  glib2::Callbacks::_int_pool_processpool_cb() function.
+     *
+     * @param sender  std::string with the unique bus name of the caller
+     * @param started bool flag, false if the request was never passed
+     *                to @RequestStarted()
+     */
+    void RequestDone(const std::string &sender, const bool started = true) noexcept;
+
+    /**
+     *  Check if the pool is being destroyed.  Requests taken from the
+     *  queue are then completed with an error reply instead of being
+     *  processed.  This is called by the
+     *  glib2::Callbacks::_int_pool_processpool_cb() function.
+     *
+     * @return true if the pool is being destroyed
+     */
+    bool ShuttingDown() const noexcept;
+
+    /**
+     *  Retrieve the next request of an object serializing its requests,
+     *  once the previous one has been processed.  See
+     *  Object::Base::SerializeRequests().  This is called by the
+     *  glib2::Callbacks::_int_pool_processpool_cb() function.
+     *
+     * @param object    Object::Base which request has been processed
+     * @param run_here  bool flag, if true the next request is returned to
+     *                  the calling processing thread.  Otherwise it is
+     *                  queued in the thread pool.
+     *
+     * @return Request::UPtr with the next request to process, nullptr if
+     *         there is none or it was queued in the thread pool
+     */
+    Request::UPtr StrandNext(const Object::Base *object, const bool run_here) noexcept;
+
+    /**
+     *  Retrieve the number of requests currently being processed
+     *
+     * @return unsigned int
+     */
+    unsigned int GetInFlight() const noexcept;
+
+    /**
+     *  Retrieve the number of requests queued and waiting for a
+     *  processing thread
+     *
+     * @return unsigned int
+     */
+    unsigned int GetQueued() const noexcept;
+
+    /**
+     *  Retrieve the number of threads currently running in the pool
+     *
+     * @return unsigned int
+     */
+    unsigned int GetThreads() const noexcept;
+
+    /**
+     *  Stop accepting new requests and wait for the queued and in-flight
+     *  requests to complete.  New requests are rejected from this point on,
+     *  even if the deadline is reached.
+     *
+     *  When called by a processing thread of this pool, the request being
+     *  processed by that thread is not waited for, as it cannot complete
+     *  before this returns.
+     *
+     * @param deadline  std::chrono::milliseconds of the maximum time to wait
+     *
+     * @return true if all the requests completed before the deadline,
+     *         otherwise false
+     */
+    bool Drain(const std::chrono::milliseconds deadline);
+
+    /**
+     *  Prepares the calling processing thread according to the pool
+     *  configuration.  This is called by the
+     *  glib2::Callbacks::_int_pool_processpool_cb() function before
+     *  processing a request.
+     */
+    void PrepareWorkerThread() const noexcept;
+
+    /**
+     *  Watch for D-Bus callers disconnecting from the bus.  Only the
+     *  callers with queued or in-flight requests are watched, via a
+     *  BusWatcher::NameSet.  When such a caller disconnects, its requests
+     *  are cancelled; see @CancelSender().
+     *
+     * @param conn  DBus::Connection::Ptr of the bus the requests arrive on
+     */
+    void WatchSenders(DBus::Connection::Ptr conn);
+
+    /**
+     *  Cancel all the queued and in-flight requests from a D-Bus caller.
+     *  Queued requests are dropped without being processed; requests
+     *  being processed can check the cancellation via
+     *  Object::Method::Arguments::IsCancelled().
+     *
+     * @param sender  std::string with the unique bus name of the caller
+     */
+    void CancelSender(const std::string &sender) noexcept;
+
 
   private:
+    const Config config;
     GThreadPool *pool = nullptr;
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<bool> shutting_down{false}; ///< Set by ~Pool()
 
-    Pool();
+    /// Requests being queued or processed by a single D-Bus caller
+    struct SenderLoad
+    {
+        unsigned int load = 0;               ///< Queued or in-flight requests
+        GCancellable *cancellable = nullptr; ///< Cancelled on disconnect
+    };
+
+    /// Requests being queued or processed per D-Bus caller
+    std::unordered_map<std::string, SenderLoad> sender_load{};
+    unsigned int total_load = 0; ///< Queued and in-flight requests
+    unsigned int in_flight = 0;  ///< Requests being processed
+    bool draining = false;       ///< New requests are rejected, see Drain()
+    mutable std::mutex load_mtx{};
+    std::condition_variable drained_cv{};
+
+    /// Callers in sender_load being watched, see WatchSenders()
+    BusWatcher::NameSet::Ptr sender_watch = nullptr;
+
+    /// Objects serializing their requests with a request being processed
+    /// or queued, with their requests waiting for it to complete
+    std::unordered_map<const Object::Base *, std::deque<Request *>> strands{};
+    std::mutex strand_mtx{};
+
+    Pool(const Config &cfg);
 };
 
 }; // namespace AsyncProcess
@@ -0,0 +1,245 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file authz-cache.cpp
+ *
+ * @brief  Implementation of the internal Authz::Cache
+ */
+
+#include <algorithm>
+#include <string>
+#include <gio/gio.h>
+
+#include "authz-cache.hpp"
+#define GDBUSPP_LOG_CATEGORY CALLBACKS
+#include "features/debug-log.hpp"
+#include "object/operation.hpp"
+
+/**
+ *  Maximum number of cached decisions per D-Bus caller.  When exceeded,
+ *  expired decisions are removed; if that is not enough, all the decisions
+ *  for that caller are removed.
+ */
+#define DBUS_AUTHZ_CACHE_SIZE 256
+
+/**
+ *  Maximum number of D-Bus callers with cached decisions.  Each caller
+ *  needs a match rule on the bus, which limits the number of match rules
+ *  per connection; dbus-daemon allows 512 by default.
+ */
+#define DBUS_AUTHZ_CACHE_CALLERS 128
+
+
+namespace DBus {
+namespace Authz {
+
+namespace _private {
+
+/**
+ *  Composes the cache key of an Authz::Request for a specific caller
+ *
+ * @param req   Authz::Request::Ptr
+ *
+ * @return std::string
+ */
+static inline std::string cache_key(const Request::Ptr req)
+{
+    return Object::OperationString(req->operation) + "|"
+           + std::string(req->object_path) + "|" + req->interface
+           + "|" + req->target;
+}
+
+} // namespace _private
+
+
+std::mutex Cache::registry_mtx;
+std::map<GDBusConnection *, std::weak_ptr<Cache>> Cache::registry;
+
+
+Cache::Ptr Cache::Create(DBus::Connection::Ptr conn)
+{
+    std::lock_guard<std::mutex> lg(registry_mtx);
+    auto &entry = registry[conn->ConnPtr()];
+    auto cache = entry.lock();
+    if (!cache)
+    {
+        cache = Cache::Ptr(new Cache(conn));
+        entry = cache;
+    }
+    return cache;
+}
+
+
+Cache::Ptr Cache::Get(GDBusConnection *conn) noexcept
+{
+    std::lock_guard<std::mutex> lg(registry_mtx);
+    auto it = registry.find(conn);
+    return (registry.end() != it ? it->second.lock() : nullptr);
+}
+
+
+Cache::Cache(DBus::Connection::Ptr conn)
+    : connection(conn->ConnPtr())
+{
+    g_object_ref(connection);
+
+    // Peer-to-peer connections have no bus daemon reporting callers
+    // disconnecting; the single peer is the connection itself
+    if (BusType::PEER != conn->GetBusType())
+    {
+        callers_watch = BusWatcher::NameSet::Create(conn);
+    }
+}
+
+
+Cache::~Cache() noexcept
+{
+    {
+        std::lock_guard<std::mutex> lg(registry_mtx);
+        auto it = registry.find(connection);
+        if (registry.end() != it && it->second.expired())
+        {
+            registry.erase(it);
+        }
+    }
+    g_object_unref(connection);
+}
+
+
+bool Cache::Lookup(const Request::Ptr req) noexcept
+{
+    try
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        auto c = callers.find(req->caller);
+        if (callers.end() == c)
+        {
+            return false;
+        }
+        auto g = c->second.granted.find(_private::cache_key(req));
+        if (c->second.granted.end() == g)
+        {
+            return false;
+        }
+        if (std::chrono::steady_clock::now() >= g->second)
+        {
+            c->second.granted.erase(g);
+            return false;
+        }
+        return true;
+    }
+    catch (const std::exception &)
+    {
+        return false;
+    }
+}
+
+
+void Cache::Store(const Request::Ptr req, const std::chrono::milliseconds ttl) noexcept
+{
+    try
+    {
+        const auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lg(mtx);
+        auto c = callers.find(req->caller);
+        if (callers.end() == c)
+        {
+            if (!make_room(now))
+            {
+                return;
+            }
+
+            // The caller must be tracked for disappearing, otherwise
+            // the decision is not cached.  This also catches callers
+            // which have already left the bus.
+            if (callers_watch)
+            {
+                std::weak_ptr<Cache> cache_wptr = weak_from_this();
+                callers_watch->Add(req->caller,
+                                   [cache_wptr](const std::string &caller)
+                                   {
+                                       auto cache = cache_wptr.lock();
+                                       if (cache)
+                                       {
+                                           GDBUSPP_LOG("Authz::Cache: caller vanished: " << caller);
+                                           cache->Forget(caller);
+                                       }
+                                   });
+            }
+            c = callers.emplace(req->caller, CallerEntries{}).first;
+        }
+
+        auto &granted = c->second.granted;
+        if (granted.size() >= DBUS_AUTHZ_CACHE_SIZE)
+        {
+            for (auto it = granted.begin(); it != granted.end();)
+            {
+                it = (now >= it->second ? granted.erase(it) : std::next(it));
+            }
+            if (granted.size() >= DBUS_AUTHZ_CACHE_SIZE)
+            {
+                granted.clear();
+            }
+        }
+        granted[_private::cache_key(req)] = now + ttl;
+    }
+    catch (const std::exception &)
+    {
+        // Not caching the decision is not critical
+    }
+}
+
+
+void Cache::Forget(const std::string &caller) noexcept
+{
+    std::lock_guard<std::mutex> lg(mtx);
+    auto c = callers.find(caller);
+    if (callers.end() == c)
+    {
+        return;
+    }
+    if (callers_watch)
+    {
+        callers_watch->Remove(caller);
+    }
+    callers.erase(c);
+}
+
+
+bool Cache::make_room(const std::chrono::steady_clock::time_point &now)
+{
+    if (callers.size() < DBUS_AUTHZ_CACHE_CALLERS)
+    {
+        return true;
+    }
+    for (auto c = callers.begin(); c != callers.end();)
+    {
+        const auto &granted = c->second.granted;
+        const bool valid = std::any_of(granted.begin(),
+                                       granted.end(),
+                                       [&now](const auto &g)
+                                       {
+                                           return now < g.second;
+                                       });
+        if (valid)
+        {
+            ++c;
+            continue;
+        }
+        if (callers_watch)
+        {
+            callers_watch->Remove(c->first);
+        }
+        c = callers.erase(c);
+    }
+    return callers.size() < DBUS_AUTHZ_CACHE_CALLERS;
+}
+
+} // namespace Authz
+} // namespace DBus
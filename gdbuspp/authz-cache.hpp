@@ -0,0 +1,142 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file authz-cache.hpp
+ *
+ * @brief  Declaration of the internal Authz::Cache, keeping track of
+ *         recently granted authorization requests
+ */
+
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <gio/gio.h>
+
+#include "authz-request.hpp"
+#include "bus-watcher.hpp"
+#include "connection.hpp"
+
+
+namespace DBus {
+namespace Authz {
+
+/**
+ *  Cache of granted Authz::Request decisions, shared by all the D-Bus
+ *  objects on the same D-Bus connection.  This is used for objects which
+ *  have enabled it via Object::Base::EnableAuthorizationCache().
+ *
+ *  The cache is owned by the Object::Manager objects of the connection;
+ *  it is created together with the first Object::Manager and kept until
+ *  the last one is destroyed.
+ *
+ *  Only granted requests are cached, so a caller being rejected will be
+ *  evaluated again on the next call.  Entries expire after the time-to-live
+ *  configured by the object.  All the entries for a caller are removed when
+ *  the caller's unique bus name disappears from the bus.  The callers are
+ *  tracked by a single BusWatcher::NameSet, which only has the callers with
+ *  cached decisions.  Each of them needs a match rule on the bus, which
+ *  limits the number of callers to cache decisions for.
+ */
+class Cache : public std::enable_shared_from_this<Cache>
+{
+  public:
+    using Ptr = std::shared_ptr<Cache>;
+
+    /**
+     *  Create the Authz::Cache object for a D-Bus connection.  If one
+     *  exists already, that object is returned instead.  The caller
+     *  must keep the returned object for as long as the cache is to be
+     *  used; this is done by the Object::Manager.
+     *
+     * @param conn  DBus::Connection::Ptr to the connection
+     *
+     * @return Cache::Ptr
+     */
+    static Cache::Ptr Create(DBus::Connection::Ptr conn);
+
+    /**
+     *  Retrieve the Authz::Cache object for a D-Bus connection
+     *
+     * @param conn  GDBusConnection pointer to the connection
+     *
+     * @return Cache::Ptr, nullptr if no cache exists for the connection
+     */
+    static Cache::Ptr Get(GDBusConnection *conn) noexcept;
+
+    ~Cache() noexcept;
+
+    /**
+     *  Check if an identical authorization request has been granted
+     *  recently
+     *
+     * @param req   Authz::Request::Ptr to look up
+     *
+     * @return true if a valid granted decision is cached, otherwise false
+     */
+    bool Lookup(const Request::Ptr req) noexcept;
+
+    /**
+     *  Store a granted authorization request decision.  If the caller has
+     *  already left the bus, the decision is removed again once the caller
+     *  lookup has completed.
+     *
+     * @param req   Authz::Request::Ptr which was granted
+     * @param ttl   std::chrono::milliseconds for how long the decision is valid
+     */
+    void Store(const Request::Ptr req, const std::chrono::milliseconds ttl) noexcept;
+
+    /**
+     *  Remove all cached decisions for a D-Bus caller.  This is called
+     *  when the unique bus name of the caller disappears.
+     *
+     * @param caller  std::string with the unique bus name of the caller
+     */
+    void Forget(const std::string &caller) noexcept;
+
+
+  private:
+    /// Cached decisions for a single D-Bus caller
+    struct CallerEntries
+    {
+        /// Expiry time of each granted request, keyed by operation,
+        /// object path, interface and target
+        std::unordered_map<std::string, std::chrono::steady_clock::time_point> granted{};
+    };
+
+    GDBusConnection *connection = nullptr;
+
+    /// Tracks the callers with cached decisions.  This is nullptr on
+    /// peer-to-peer connections, where callers cannot be tracked.
+    BusWatcher::NameSet::Ptr callers_watch = nullptr;
+    std::mutex mtx{};
+    std::unordered_map<std::string, CallerEntries> callers{};
+
+    static std::mutex registry_mtx;
+    static std::map<GDBusConnection *, std::weak_ptr<Cache>> registry;
+
+    Cache(DBus::Connection::Ptr conn);
+
+    /**
+     *  Make room for a new caller in the cache, by removing the callers
+     *  with only expired decisions.  The mtx must be locked by the caller.
+     *
+     * @param now  Current std::chrono::steady_clock time
+     *
+     * @return true if a new caller can be added
+     */
+    bool make_room(const std::chrono::steady_clock::time_point &now);
+};
+
+} // namespace Authz
+} // namespace DBus
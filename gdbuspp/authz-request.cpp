@@ -12,6 +12,7 @@
  * @brief  Implementation of the Authz::Request and related APIs
  */
 
+#include <iostream>
 #include <string>
 
 #include "authz-request.hpp"
@@ -37,24 +38,41 @@ const std::string Exception::compose_error(const Request::Ptr req,
         return errmsg;
     }
 
-    std::ostringstream r;
-    r << "Autorization failed for " << req->caller;
+    // Rejected requests may arrive in large numbers; the message is
+    // assembled from preformatted parts into a single allocation
+    static const std::string prefix = "Autorization failed for ";
+    static const std::string op_none = " [NO OPERATION] ";
+    static const std::string op_method = " performing method call ";
+    static const std::string op_get = " reading property ";
+    static const std::string op_set = " setting property ";
+    static const std::string in_object = " in object ";
+
+    const std::string *operation = &op_none;
     switch (req->operation)
     {
     case Object::Operation::METHOD_CALL:
-        r << " performing method call ";
+        operation = &op_method;
         break;
     case Object::Operation::PROPERTY_GET:
-        r << " reading property ";
+        operation = &op_get;
         break;
     case Object::Operation::PROPERTY_SET:
-        r << " setting property ";
+        operation = &op_set;
         break;
     case Object::Operation::NONE:
-        r << " [NO OPERATION] ";
+        break;
     }
-    r << req->target << " in object " << req->object_path;
-    return std::string(r.str());
+
+    std::string r;
+    r.reserve(prefix.size() + req->caller.size() + operation->size()
+              + req->target.size() + in_object.size() + req->object_path.size());
+    r.append(prefix)
+        .append(req->caller)
+        .append(*operation)
+        .append(req->target)
+        .append(in_object)
+        .append(req->object_path);
+    return r;
 }
 
 
@@ -116,10 +134,108 @@ Authz::Request::Request(const AsyncProcess::Request::UPtr &req)
 }
 
 
+Authz::Request::Ptr Authz::Request::Create(const AsyncProcess::Request::UPtr &req)
+{
+    // Only this thread can hand out new references to the last object,
+    // so a use count of 1 means nobody else is using it
+    thread_local Request::Ptr last = nullptr;
+    if (last && 1 == last.use_count() && last->matches(req))
+    {
+        return last;
+    }
+    last = Ptr(new Request(req));
+    return last;
+}
+
+
+bool Authz::Request::matches(const AsyncProcess::Request::UPtr &req) const noexcept
+{
+    const std::string &intf = req->object->GetInterface();
+    const std::string &member = (Object::Operation::METHOD_CALL == req->request_type
+                                     ? req->method
+                                     : req->property);
+    return operation == req->request_type
+           && caller == req->sender
+           && object_path == req->object->GetPath()
+           && interface == intf
+           && target.size() == intf.size() + 1 + member.size()
+           && target.compare(0, intf.size(), intf) == 0
+           && '.' == target[intf.size()]
+           && target.compare(intf.size() + 1, std::string::npos, member) == 0;
+}
+
+
 const std::string Authz::Request::OperationString() const noexcept
 {
     return Object::OperationString(operation);
 }
 
+
+
+Decision::Decision(ResultFnc result_fn_, GCancellable *cancellable_)
+    : result_fn(std::move(result_fn_)),
+      cancellable(cancellable_ ? G_CANCELLABLE(g_object_ref(cancellable_)) : nullptr)
+{
+}
+
+
+Decision::~Decision() noexcept
+{
+    // A decision nobody completed must not leave the caller waiting
+    complete(Result::DENIED, "");
+    if (cancellable)
+    {
+        g_object_unref(cancellable);
+    }
+}
+
+
+void Decision::Grant() noexcept
+{
+    complete(Result::GRANTED, "");
+}
+
+
+void Decision::Deny(const std::string &message) noexcept
+{
+    complete(Result::DENIED, message);
+}
+
+
+void Decision::Defer() noexcept
+{
+    complete(Result::DEFERRED, "");
+}
+
+
+bool Decision::IsCancelled() const noexcept
+{
+    return cancellable && g_cancellable_is_cancelled(cancellable);
+}
+
+
+bool Decision::IsCompleted() const noexcept
+{
+    return completed;
+}
+
+
+void Decision::complete(const Result result, const std::string &message) noexcept
+{
+    if (completed.exchange(true))
+    {
+        return;
+    }
+    try
+    {
+        result_fn(result, message);
+    }
+    catch (const std::exception &excp)
+    {
+        std::cerr << "** ERROR **  Authz::Decision: " << excp.what() << std::endl;
+    }
+    result_fn = nullptr;
+}
+
 } // namespace Authz
 } // namespace DBus
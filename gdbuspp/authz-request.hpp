@@ -14,7 +14,11 @@
 
 #pragma once
 
+#include <atomic>
+#include <functional>
+#include <memory>
 #include <string>
+#include <gio/gio.h>
 
 #include "async-process.hpp"
 #include "exceptions.hpp"
@@ -81,15 +85,17 @@ class Request
      *  Construct a new Authz Request object by extracting information
      *  from a AsyncProcess::Request object.
      *
+     *  The last object created by the calling thread is returned again
+     *  if it carries the same information and nothing else holds a
+     *  reference to it.  Repeated identical calls from the same caller
+     *  are then authorized without allocating a new object.
+     *
      * @param req   The AsyncProcess::Request object to extract information from
      *
      * @return Authz::Reqeuest::Ptr  A new object which can be passed to
      *         the DBus::Object::Authorize() method
      */
-    [[nodiscard]] static Request::Ptr Create(const AsyncProcess::Request::UPtr &req)
-    {
-        return Ptr(new Request(req));
-    }
+    [[nodiscard]] static Request::Ptr Create(const AsyncProcess::Request::UPtr &req);
 
 
     /**
@@ -132,6 +138,117 @@ class Request
      * @see Create
      */
     Request(const AsyncProcess::Request::UPtr &req);
+
+    /**
+     *  Check if this object carries the same information as would be
+     *  extracted from an AsyncProcess::Request
+     *
+     * @param req   The AsyncProcess::Request object to compare with
+     *
+     * @return true if identical
+     */
+    bool matches(const AsyncProcess::Request::UPtr &req) const noexcept;
+};
+
+
+
+/**
+ *  Pending authorization decision, used by objects evaluating the
+ *  authorization asynchronously via Object::Base::AuthorizeAsync().
+ *
+ *  The object completes the decision by calling either Grant() or Deny(),
+ *  from any thread and at any later point.  Only the first call has any
+ *  effect.  If the object releases the decision without completing it,
+ *  the request is denied.
+ */
+class Decision
+{
+  public:
+    using Ptr = std::shared_ptr<Decision>;
+
+    /// Outcome of a decision
+    enum class Result
+    {
+        GRANTED,
+        DENIED,
+        DEFERRED ///< Left to Object::Base::Authorize(), see Defer()
+    };
+
+    /**
+     *  Function called with the outcome of the decision
+     *
+     * @param result   Result of the decision
+     * @param message  std::string with the rejection message given to Deny()
+     */
+    using ResultFnc = std::function<void(const Result result, const std::string &message)>;
+
+    /**
+     *  Prepare a new pending decision
+     *
+     * @param result_fn    ResultFnc called when the decision is completed
+     * @param cancellable  GCancellable cancelled when the D-Bus caller
+     *                     disconnects, may be nullptr
+     *
+     * @return Decision::Ptr
+     */
+    [[nodiscard]] static Decision::Ptr Create(ResultFnc result_fn,
+                                              GCancellable *cancellable = nullptr)
+    {
+        return Ptr(new Decision(std::move(result_fn), cancellable));
+    }
+
+    ~Decision() noexcept;
+
+    Decision(const Decision &) = delete;
+    Decision &operator=(const Decision &) = delete;
+
+    /**
+     *  Allow the request to be processed
+     */
+    void Grant() noexcept;
+
+    /**
+     *  Reject the request
+     *
+     * @param message  std::string with the rejection message to send to
+     *                 the caller.  If empty, the message from
+     *                 Object::Base::AuthorizationRejected() is used.
+     */
+    void Deny(const std::string &message = "") noexcept;
+
+    /**
+     *  Leave the decision to Object::Base::Authorize(), called by the
+     *  AsyncProcess::Pool worker thread processing the request, as if
+     *  Object::Base::AsyncAuthorization() was not enabled.  This is what
+     *  the default Object::Base::AuthorizeAsync() does.
+     */
+    void Defer() noexcept;
+
+    /**
+     *  Check if the D-Bus caller has disconnected.  The result of the
+     *  decision is then not needed anymore; the request is dropped
+     *  whatever the outcome.
+     *
+     * @return bool
+     */
+    bool IsCancelled() const noexcept;
+
+    /**
+     *  Check if Grant() or Deny() has been called
+     *
+     * @return bool
+     */
+    bool IsCompleted() const noexcept;
+
+
+  private:
+    ResultFnc result_fn;
+    GCancellable *cancellable = nullptr;
+    std::atomic<bool> completed{false};
+
+    Decision(ResultFnc result_fn_, GCancellable *cancellable_);
+
+    void complete(const Result result, const std::string &message) noexcept;
 };
 
 
@@ -13,6 +13,8 @@
  */
 
 
+#include <iostream>
+
 #include "exceptions.hpp"
 #include "bus-watcher.hpp"
 
@@ -34,6 +36,7 @@ BusWatcher::BusWatcher(BusType bus_type, const std::string &bus_name, bool start
 
 BusWatcher::BusWatcher(DBus::Connection::Ptr conn, const std::string &bus_name, bool start)
 {
+    MainLoop::ContextScope scope(conn->GetMainLoop());
     watcher_id_ = g_bus_watch_name_on_connection(
         conn->ConnPtr(),
         bus_name.c_str(),
@@ -87,4 +90,425 @@ void BusWatcher::on_name_disappeared(GDBusConnection *connection,
 }
 
 
+
+
+//
+//  BusWatcher::NameSet
+//
+
+/// Data passed to the asynchronous GetNameOwner lookups
+struct NameSetLookup
+{
+    std::weak_ptr<BusWatcher::NameSet> watcher;
+    std::string name;
+};
+
+
+/**
+ *  Reports a failing AddMatch call.  The bus limits the number of match
+ *  rules per connection, so a bus name may not be watched after all.
+ */
+static void on_add_match(GObject *source, GAsyncResult *res, gpointer user_data)
+{
+    GError *error = nullptr;
+    GVariant *r = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), res, &error);
+    if (r)
+    {
+        g_variant_unref(r);
+    }
+    if (error)
+    {
+        std::cerr << "** ERROR **  BusWatcher::NameSet: "
+                  << "Failed adding the NameOwnerChanged match rule: "
+                  << error->message << std::endl;
+        g_error_free(error);
+    }
+}
+
+
+/**
+ *  Send an AddMatch or RemoveMatch call for the NameOwnerChanged signal
+ *  of a single bus name, without waiting for the result.  A failing
+ *  AddMatch call is reported via the main context of the calling thread.
+ *
+ * @param conn    GDBusConnection to send the call over
+ * @param method  const char * with the method to call
+ * @param name    std::string with the bus name
+ */
+static void name_owner_match(GDBusConnection *conn,
+                             const char *method,
+                             const std::string &name)
+{
+    const std::string rule = "type='signal',"
+                             "sender='org.freedesktop.DBus',"
+                             "interface='org.freedesktop.DBus',"
+                             "member='NameOwnerChanged',"
+                             "path='/org/freedesktop/DBus',"
+                             "arg0='"
+                             + name + "'";
+    g_dbus_connection_call(conn,
+                           "org.freedesktop.DBus",
+                           "/org/freedesktop/DBus",
+                           "org.freedesktop.DBus",
+                           method,
+                           g_variant_new("(s)", rule.c_str()),
+                           nullptr,
+                           G_DBUS_CALL_FLAGS_NONE,
+                           -1,
+                           nullptr,
+                           (0 == g_strcmp0(method, "AddMatch") ? on_add_match : nullptr),
+                           nullptr);
+}
+
+
+BusWatcher::NameSet::Ptr BusWatcher::NameSet::Create(DBus::Connection::Ptr conn,
+                                                     const std::vector<std::string> &names,
+                                                     bool start)
+{
+    if (names.empty())
+    {
+        throw BusWatcher::Exception("No bus names to watch");
+    }
+    auto watcher = NameSet::Ptr(new NameSet(conn, names));
+    watcher->watch(start);
+    return watcher;
+}
+
+
+BusWatcher::NameSet::Ptr BusWatcher::NameSet::Create(DBus::Connection::Ptr conn)
+{
+    auto watcher = NameSet::Ptr(new NameSet(conn, {}));
+    watcher->watch(false);
+    return watcher;
+}
+
+
+BusWatcher::NameSet::NameSet(DBus::Connection::Ptr conn,
+                             const std::vector<std::string> &names_)
+    : connection(conn)
+{
+    for (const auto &n : names_)
+    {
+        names.emplace(n, NameState{});
+    }
+}
+
+
+BusWatcher::NameSet::~NameSet() noexcept
+{
+    if (subscription_id > 0)
+    {
+        g_dbus_connection_signal_unsubscribe(connection->ConnPtr(), subscription_id);
+        if (!g_dbus_connection_is_closed(connection->ConnPtr()))
+        {
+            for (const auto &n : names)
+            {
+                if (n.second.matched)
+                {
+                    name_owner_match(connection->ConnPtr(), "RemoveMatch", n.first);
+                }
+            }
+        }
+    }
+}
+
+
+void BusWatcher::NameSet::SetNameAppearedHandler(const std::string &name, AppearedFnc fnc)
+{
+    std::lock_guard lock{mtx};
+    auto it = names.find(name);
+    if (names.end() == it)
+    {
+        throw BusWatcher::Exception("Bus name is not watched: " + name);
+    }
+    it->second.appeared = std::move(fnc);
+}
+
+
+void BusWatcher::NameSet::SetNameDisappearedHandler(const std::string &name, DisappearedFnc fnc)
+{
+    std::lock_guard lock{mtx};
+    auto it = names.find(name);
+    if (names.end() == it)
+    {
+        throw BusWatcher::Exception("Bus name is not watched: " + name);
+    }
+    it->second.disappeared = std::move(fnc);
+}
+
+
+bool BusWatcher::NameSet::Add(const std::string &name, DisappearedFnc disappeared)
+{
+    std::lock_guard lock{mtx};
+    auto [it, inserted] = names.emplace(name, NameState{});
+    if (!inserted)
+    {
+        return false;
+    }
+    it->second.expect_owner = true;
+    it->second.disappeared = std::move(disappeared);
+    added.push_back(name);
+    if (add_scheduled)
+    {
+        return true;
+    }
+
+    // The owner lookup reply is delivered via the main context of the
+    // thread doing the call, so it is done by the main loop of the
+    // connection instead of the calling thread
+    add_scheduled = true;
+    MainLoop::Ptr loop = connection->GetMainLoop();
+    GSource *src = g_idle_source_new();
+    g_source_set_callback(src,
+                          process_added,
+                          new std::weak_ptr<NameSet>(shared_from_this()),
+                          [](gpointer data)
+                          {
+                              delete static_cast<std::weak_ptr<NameSet> *>(data);
+                          });
+    g_source_attach(src, (loop ? loop->GetContext() : nullptr));
+    g_source_unref(src);
+    return true;
+}
+
+
+void BusWatcher::NameSet::Remove(const std::string &name) noexcept
+{
+    std::lock_guard lock{mtx};
+    auto it = names.find(name);
+    if (names.end() == it)
+    {
+        return;
+    }
+    if (it->second.matched && !g_dbus_connection_is_closed(connection->ConnPtr()))
+    {
+        name_owner_match(connection->ConnPtr(), "RemoveMatch", name);
+    }
+    if (!it->second.owner.empty())
+    {
+        --owned;
+    }
+    names.erase(it);
+    cv.notify_all();
+}
+
+
+std::string BusWatcher::NameSet::GetOwner(const std::string &name) const
+{
+    std::lock_guard lock{mtx};
+    auto it = names.find(name);
+    if (names.end() == it)
+    {
+        throw BusWatcher::Exception("Bus name is not watched: " + name);
+    }
+    return it->second.owner;
+}
+
+
+void BusWatcher::NameSet::watch(bool start)
+{
+    MainLoop::ContextScope scope(connection->GetMainLoop());
+
+    // The subscription must be in place before the owner lookups, otherwise
+    // a change between the lookup and the subscription could be missed.
+    //
+    // A single signal subscription matches all bus names.  The match rule
+    // glib2 would add for it would make the bus send every NameOwnerChanged
+    // signal to this connection, so a match rule with an arg0 filter is
+    // added per watched name instead.  The bus processes these calls in
+    // order, so the rules are active before the owner lookups below.
+    subscription_id = g_dbus_connection_signal_subscribe(
+        connection->ConnPtr(),
+        "org.freedesktop.DBus",
+        "org.freedesktop.DBus",
+        "NameOwnerChanged",
+        "/org/freedesktop/DBus",
+        nullptr,
+        G_DBUS_SIGNAL_FLAGS_NO_MATCH_RULE,
+        on_name_owner_changed,
+        new std::weak_ptr<NameSet>(shared_from_this()),
+        [](gpointer data)
+        {
+            delete static_cast<std::weak_ptr<NameSet> *>(data);
+        });
+
+    for (auto &n : names)
+    {
+        name_owner_match(connection->ConnPtr(), "AddMatch", n.first);
+        n.second.matched = true;
+    }
+
+    for (const auto &[name, state] : names)
+    {
+        if (start)
+        {
+            g_dbus_connection_call(connection->ConnPtr(),
+                                   "org.freedesktop.DBus",
+                                   "/org/freedesktop/DBus",
+                                   "org.freedesktop.DBus",
+                                   "StartServiceByName",
+                                   g_variant_new("(su)", name.c_str(), 0),
+                                   G_VARIANT_TYPE("(u)"),
+                                   G_DBUS_CALL_FLAGS_NONE,
+                                   -1,
+                                   nullptr,
+                                   nullptr,
+                                   nullptr);
+        }
+        lookup(name);
+    }
+}
+
+
+void BusWatcher::NameSet::lookup(const std::string &name)
+{
+    g_dbus_connection_call(connection->ConnPtr(),
+                           "org.freedesktop.DBus",
+                           "/org/freedesktop/DBus",
+                           "org.freedesktop.DBus",
+                           "GetNameOwner",
+                           g_variant_new("(s)", name.c_str()),
+                           G_VARIANT_TYPE("(s)"),
+                           G_DBUS_CALL_FLAGS_NONE,
+                           -1,
+                           nullptr,
+                           on_owner_lookup,
+                           new NameSetLookup{weak_from_this(), name});
+}
+
+
+void BusWatcher::NameSet::owner_changed(const std::string &name,
+                                        const std::string &owner,
+                                        const bool from_signal)
+{
+    AppearedFnc appeared = nullptr;
+    DisappearedFnc disappeared = nullptr;
+    {
+        std::lock_guard lock{mtx};
+        auto it = names.find(name);
+        if (names.end() == it || (!from_signal && it->second.seen))
+        {
+            return;
+        }
+        NameState &st = it->second;
+        st.seen = st.seen || from_signal;
+
+        const bool had_owner = !st.owner.empty();
+        if (owner.empty() && (had_owner || st.expect_owner))
+        {
+            owned -= (had_owner ? 1 : 0);
+            disappeared = st.disappeared;
+        }
+        else if (!had_owner && !owner.empty())
+        {
+            ++owned;
+        }
+        if (!owner.empty() && owner != st.owner)
+        {
+            appeared = st.appeared;
+        }
+        st.owner = owner;
+        st.expect_owner = false;
+        cv.notify_all();
+    }
+
+    if (disappeared)
+    {
+        disappeared(name);
+    }
+    if (appeared)
+    {
+        appeared(name, owner);
+    }
+}
+
+
+void BusWatcher::NameSet::on_name_owner_changed(GDBusConnection *conn,
+                                                const gchar *sender,
+                                                const gchar *obj_path,
+                                                const gchar *intf_name,
+                                                const gchar *signal_name,
+                                                GVariant *params,
+                                                gpointer user_data)
+{
+    auto watcher = static_cast<std::weak_ptr<NameSet> *>(user_data)->lock();
+    if (!watcher)
+    {
+        return;
+    }
+    const gchar *name = nullptr;
+    const gchar *new_owner = nullptr;
+    g_variant_get(params, "(&s&s&s)", &name, nullptr, &new_owner);
+    watcher->owner_changed(name, new_owner, true);
+}
+
+
+void BusWatcher::NameSet::on_owner_lookup(GObject *source,
+                                          GAsyncResult *res,
+                                          gpointer user_data)
+{
+    std::unique_ptr<NameSetLookup> lookup(static_cast<NameSetLookup *>(user_data));
+
+    // Errors are expected here; org.freedesktop.DBus.Error.NameHasNoOwner
+    // is returned when the bus name is not present
+    GError *error = nullptr;
+    GVariant *r = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), res, &error);
+    std::string owner{};
+    if (r)
+    {
+        const gchar *o = nullptr;
+        g_variant_get(r, "(&s)", &o);
+        owner = o;
+        g_variant_unref(r);
+    }
+    if (error)
+    {
+        g_error_free(error);
+    }
+
+    auto watcher = lookup->watcher.lock();
+    if (watcher)
+    {
+        watcher->owner_changed(lookup->name, owner, false);
+    }
+}
+
+
+gboolean BusWatcher::NameSet::process_added(gpointer user_data)
+{
+    auto watcher = static_cast<std::weak_ptr<NameSet> *>(user_data)->lock();
+    if (!watcher)
+    {
+        return G_SOURCE_REMOVE;
+    }
+
+    std::vector<std::string> pending{};
+    {
+        std::lock_guard lock{watcher->mtx};
+        pending.swap(watcher->added);
+        watcher->add_scheduled = false;
+        for (auto it = pending.begin(); it != pending.end();)
+        {
+            // Bus names removed again in the mean time are skipped
+            auto n = watcher->names.find(*it);
+            if (watcher->names.end() == n || n->second.matched)
+            {
+                it = pending.erase(it);
+                continue;
+            }
+            n->second.matched = true;
+            name_owner_match(watcher->connection->ConnPtr(), "AddMatch", *it);
+            ++it;
+        }
+    }
+
+    // The bus processes the calls in order, so the match rules are
+    // active before the owner lookups
+    for (const auto &name : pending)
+    {
+        watcher->lookup(name);
+    }
+    return G_SOURCE_REMOVE;
+}
+
 } // namespace DBus
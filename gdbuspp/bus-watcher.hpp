@@ -19,8 +19,10 @@
 #include <gio/gio.h>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "connection.hpp"
 #include "exceptions.hpp"
@@ -45,6 +47,229 @@ class BusWatcher
         Exception(const std::string &errm);
     };
 
+
+    /**
+     *  Watches a set of bus names using a single NameOwnerChanged signal
+     *  subscription, instead of one g_bus_watch_name() watcher per name.
+     *  This is useful when waiting for a larger number of services
+     *  to appear on the bus.  The bus only sends the signals of the
+     *  watched names, via a match rule per name.
+     *
+     *  The current owners are looked up asynchronously when the watcher
+     *  is created, so the main loop of the connection needs to run.
+     */
+    class NameSet : public std::enable_shared_from_this<NameSet>
+    {
+      public:
+        using Ptr = std::shared_ptr<NameSet>;
+
+        /// Called with the bus name and the unique bus name of the new owner
+        using AppearedFnc = std::function<void(const std::string &, const std::string &)>;
+
+        /// Called with the bus name which lost its owner
+        using DisappearedFnc = std::function<void(const std::string &)>;
+
+        /**
+         *  Sets up a watch on a set of bus names
+         *
+         * @param conn      DBus::Connection to use setting up the watcher
+         * @param names     std::vector<std::string> with the bus names to watch
+         * @param start     If this is `true`, the services owning bus names
+         *                  not yet present on the bus are activated
+         *
+         * @return NameSet::Ptr
+         *
+         * @throws BusWatcher::Exception if no bus names are given
+         */
+        [[nodiscard]] static NameSet::Ptr Create(DBus::Connection::Ptr conn,
+                                                 const std::vector<std::string> &names,
+                                                 bool start = false);
+
+        /**
+         *  Sets up a watch without any bus names.  The bus names to
+         *  watch are added and removed later on via Add() and Remove().
+         *
+         * @param conn      DBus::Connection to use setting up the watcher
+         *
+         * @return NameSet::Ptr
+         */
+        [[nodiscard]] static NameSet::Ptr Create(DBus::Connection::Ptr conn);
+
+        ~NameSet() noexcept;
+
+        NameSet(const NameSet &) = delete;
+        NameSet &operator=(const NameSet &) = delete;
+
+        /**
+         *  Set an (optional) callback to be invoked when a bus name appears
+         *
+         * @param name  std::string with the watched bus name
+         * @param fnc   AppearedFnc to call
+         *
+         * @throws BusWatcher::Exception if the bus name is not watched
+         */
+        void SetNameAppearedHandler(const std::string &name, AppearedFnc fnc);
+
+        /**
+         *  Set an (optional) callback to be invoked when a bus name disappears
+         *
+         * @param name  std::string with the watched bus name
+         * @param fnc   DisappearedFnc to call
+         *
+         * @throws BusWatcher::Exception if the bus name is not watched
+         */
+        void SetNameDisappearedHandler(const std::string &name, DisappearedFnc fnc);
+
+        /**
+         *  Start watching a bus name.  The match rule and the owner lookup
+         *  are done via the main loop of the connection, so this can be
+         *  called from any thread.
+         *
+         *  Unlike the bus names given to Create(), the disappeared
+         *  callback is also called if the bus name turns out to have no
+         *  owner when it is looked up.  A unique bus name may leave the
+         *  bus before it is added.
+         *
+         * @param name         std::string with the bus name to watch
+         * @param disappeared  DisappearedFnc to call when the bus name
+         *                     has no owner (optional)
+         *
+         * @return true if the bus name was added, false if it is already
+         *         watched
+         */
+        bool Add(const std::string &name, DisappearedFnc disappeared = nullptr);
+
+        /**
+         *  Stop watching a bus name.  Nothing happens if the bus name is
+         *  not watched.
+         *
+         * @param name  std::string with the bus name
+         */
+        void Remove(const std::string &name) noexcept;
+
+        /**
+         *  Retrieve the current owner of a watched bus name
+         *
+         * @param name  std::string with the watched bus name
+         *
+         * @return std::string with the unique bus name of the owner; empty
+         *         if the bus name is not present on the bus
+         *
+         * @throws BusWatcher::Exception if the bus name is not watched
+         */
+        std::string GetOwner(const std::string &name) const;
+
+        /**
+         *  Wait for a specified period of time for all the bus names to appear
+         *
+         * @param  timeout How long to wait for the bus names to appear.
+         * @return `true` if all the bus names are present, `false` if the
+         *         timeout occured while waiting.
+         */
+        template <typename Rep, typename Period>
+        bool WaitForAll(const std::chrono::duration<Rep, Period> &timeout)
+        {
+            std::unique_lock<std::mutex> lock{mtx};
+            return cv.wait_for(lock, timeout, [this]
+                               {
+                                   return owned == names.size();
+                               });
+        }
+
+        /**
+         *  Wait for a specified period of time for any of the bus names
+         *  to appear
+         *
+         * @param  timeout How long to wait for a bus name to appear.
+         * @return `true` if at least one of the bus names is present,
+         *         `false` if the timeout occured while waiting.
+         */
+        template <typename Rep, typename Period>
+        bool WaitForAny(const std::chrono::duration<Rep, Period> &timeout)
+        {
+            std::unique_lock<std::mutex> lock{mtx};
+            return cv.wait_for(lock, timeout, [this]
+                               {
+                                   return owned > 0;
+                               });
+        }
+
+      private:
+        /// Tracking state of a single watched bus name
+        struct NameState
+        {
+            std::string owner{};          ///< Current owner; empty if none
+            bool seen = false;            ///< A NameOwnerChanged signal was seen
+            bool matched = false;         ///< The match rule has been added
+            bool expect_owner = false;    ///< Added via Add(), see there
+            AppearedFnc appeared{};       ///< Optional appeared callback
+            DisappearedFnc disappeared{}; ///< Optional disappeared callback
+        };
+
+        DBus::Connection::Ptr connection;
+        std::unordered_map<std::string, NameState> names{};
+        size_t owned = 0; ///< Number of watched names with an owner
+        guint subscription_id = 0;
+        mutable std::mutex mtx{};
+        std::condition_variable cv{};
+
+        /// Bus names passed to Add(), waiting for process_added()
+        std::vector<std::string> added{};
+        bool add_scheduled = false;
+
+        NameSet(DBus::Connection::Ptr conn, const std::vector<std::string> &names);
+
+        /**
+         *  Subscribe to the NameOwnerChanged signal and look up the
+         *  current owners of all the watched bus names
+         *
+         * @param start  Activate the services not present on the bus
+         */
+        void watch(bool start);
+
+        /**
+         *  Add the match rule and look up the owner of a watched bus name
+         *
+         * @param name  std::string with the bus name
+         */
+        void lookup(const std::string &name);
+
+        /**
+         *  Update the owner of a watched bus name and call the callbacks
+         *
+         * @param name         std::string with the bus name
+         * @param owner        std::string with the new owner; empty if none
+         * @param from_signal  true if the update comes from NameOwnerChanged.
+         *                     The initial owner lookup is ignored if a
+         *                     signal has already been processed.
+         */
+        void owner_changed(const std::string &name,
+                           const std::string &owner,
+                           const bool from_signal);
+
+        static void on_name_owner_changed(GDBusConnection *conn,
+                                          const gchar *sender,
+                                          const gchar *obj_path,
+                                          const gchar *intf_name,
+                                          const gchar *signal_name,
+                                          GVariant *params,
+                                          gpointer user_data);
+
+        static void on_owner_lookup(GObject *source,
+                                    GAsyncResult *res,
+                                    gpointer user_data);
+
+        /**
+         *  glib2 idle callback doing the lookups of the bus names passed
+         *  to Add(), run by the main loop of the connection
+         *
+         * @param user_data  Raw pointer to a std::weak_ptr<NameSet>
+         *
+         * @return G_SOURCE_REMOVE, this is only run once
+         */
+        static gboolean process_added(gpointer user_data);
+    };
+
     /**
      *  Sets up a watch on a bus name.
      *
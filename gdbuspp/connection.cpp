@@ -12,8 +12,14 @@
  * @brief Implementation of the DBus::Connection class
  */
 
+#include <chrono>
+#include <future>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 #include <glib.h>
 #include <gio/gio.h>
 
@@ -21,7 +27,6 @@
 
 namespace DBus {
 
-
 Connection::Exception::Exception(const std::string &err, GError *gliberr)
     : DBus::Exception("DBus::Connection", err, gliberr)
 {
@@ -30,6 +35,59 @@ Connection::Exception::Exception(const std::string &err, GError *gliberr)
 
 Connection::Connection(BusType bustype)
     : type(bustype)
+{
+    dbuscon = connect_bus(bustype);
+}
+
+
+Connection::Connection(BusType bustype, ReadyCallback ready, const bool lazy)
+    : type(bustype)
+{
+    if (BusType::SESSION != bustype && BusType::SYSTEM != bustype)
+    {
+        throw Connection::Exception("Invalid bus type");
+    }
+
+    if (lazy)
+    {
+        pending = std::async(std::launch::deferred,
+                             [bustype]()
+                             {
+                                 return connect_bus(bustype);
+                             })
+                      .share();
+        return;
+    }
+
+    // The connecting thread is detached, as the ready callback may
+    // release the last reference to this object.  The promise keeps
+    // the result available regardless of the lifetime of this object.
+    auto promise = std::make_shared<std::promise<GDBusConnection *>>();
+    pending = promise->get_future().share();
+    std::thread(
+        [bustype, promise, ready]()
+        {
+            std::exception_ptr error = nullptr;
+            try
+            {
+                promise->set_value(connect_bus(bustype));
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+                promise->set_exception(error);
+            }
+            if (ready)
+            {
+                ready(error);
+            }
+        })
+        .detach();
+}
+
+
+Connection::Connection(BusType bustype, const bool exclusive)
+    : type(bustype)
 {
     GBusType glib2_bustype = G_BUS_TYPE_NONE;
     switch (bustype)
@@ -44,14 +102,59 @@ Connection::Connection(BusType bustype)
         throw Connection::Exception("Invalid bus type");
     }
 
+    if (!exclusive)
+    {
+        throw Connection::Exception("Shared connections must use Connection::Create()");
+    }
+
     GError *error = nullptr;
-    dbuscon = g_bus_get_sync(glib2_bustype, nullptr, &error);
+    gchar *address = g_dbus_address_get_for_bus_sync(glib2_bustype, nullptr, &error);
+    if (!address || error)
+    {
+        g_free(address);
+        throw Connection::Exception("Could not look up the D-Bus address", error);
+    }
+
+    dbuscon = g_dbus_connection_new_for_address_sync(
+        address,
+        static_cast<GDBusConnectionFlags>(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT
+                                          | G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+        nullptr, // GDBusAuthObserver
+        nullptr, // GCancellable
+        &error);
+    g_free(address);
     if (!dbuscon || error)
     {
-        std::string errmsg = "Could not connect to the D-Bus";
+        if (dbuscon)
+        {
+            g_object_unref(dbuscon);
+        }
+        dbuscon = nullptr;
+        throw Connection::Exception("Could not connect to the D-Bus", error);
+    }
+}
+
+
+Connection::Connection(const std::string &address)
+    : type(BusType::PEER)
+{
+    GError *error = nullptr;
+    dbuscon = g_dbus_connection_new_for_address_sync(address.c_str(),
+                                                     G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT,
+                                                     nullptr, // GDBusAuthObserver
+                                                     nullptr, // GCancellable
+                                                     &error);
+    if (!dbuscon || error)
+    {
+        std::string errmsg = "Could not connect to D-Bus peer at " + address;
         if (error)
         {
             errmsg += ": " + std::string(error->message);
+            g_error_free(error);
+        }
+        if (dbuscon)
+        {
+            g_object_unref(dbuscon);
         }
         dbuscon = nullptr;
         throw Connection::Exception(errmsg);
@@ -59,11 +162,22 @@ Connection::Connection(BusType bustype)
 }
 
 
+Connection::Connection(GDBusConnection *conn, DBus::BusType bustype)
+    : type(bustype)
+{
+    if (!conn || !G_IS_DBUS_CONNECTION(conn))
+    {
+        throw Connection::Exception("Invalid GDBusConnection");
+    }
+    dbuscon = G_DBUS_CONNECTION(g_object_ref(conn));
+}
+
+
 Connection::~Connection() noexcept
 {
     try
     {
-        Connection::Disconnect();
+        Connection::Disconnect(!nonblocking_close);
     }
     catch (const Connection::Exception &err)
     {
@@ -74,23 +188,34 @@ Connection::~Connection() noexcept
 
 GDBusConnection *Connection::ConnPtr() const noexcept
 {
-    return dbuscon;
+    return resolve();
+}
+
+
+void Connection::WaitReady() const
+{
+    if (!resolve() && connect_error)
+    {
+        std::rethrow_exception(connect_error);
+    }
 }
 
 
 const std::string Connection::GetUniqueBusName() const
 {
-    if (!G_IS_DBUS_CONNECTION(dbuscon))
+    GDBusConnection *conn = resolve();
+    if (!G_IS_DBUS_CONNECTION(conn))
     {
         throw Connection::Exception("Invalid connection");
     }
-    return std::string(g_dbus_connection_get_unique_name(dbuscon));
+    const char *name = g_dbus_connection_get_unique_name(conn);
+    return (name ? std::string(name) : "");
 }
 
 
 const DBus::BusType Connection::GetBusType() const noexcept
 {
-    if (!G_IS_DBUS_CONNECTION(dbuscon))
+    if (!G_IS_DBUS_CONNECTION(resolve()))
     {
         return DBus::BusType::UNKNOWN;
     }
@@ -100,15 +225,45 @@ const DBus::BusType Connection::GetBusType() const noexcept
 
 const bool Connection::Check() const
 {
-    return dbuscon
-           && G_IS_DBUS_CONNECTION(dbuscon)
-           && !g_dbus_connection_is_closed(dbuscon);
+    GDBusConnection *conn = resolve();
+    return conn
+           && G_IS_DBUS_CONNECTION(conn)
+           && !g_dbus_connection_is_closed(conn);
+}
+
+
+void Connection::BindMainLoop(MainLoop::Ptr loop) noexcept
+{
+    mainloop = loop;
 }
 
 
-void Connection::Disconnect()
+MainLoop::Ptr Connection::GetMainLoop() const noexcept
+{
+    return mainloop;
+}
+
+
+void Connection::SetNonBlockingClose(const bool enable) noexcept
+{
+    nonblocking_close = enable;
+}
+
+
+void Connection::Disconnect(const bool wait)
 {
-    if (!dbuscon)
+    {
+        // A lazy connection never used does not need to be established
+        // just to be closed again
+        std::lock_guard<std::mutex> lg(pending_mtx);
+        if (!dbuscon && pending.valid()
+            && pending.wait_for(std::chrono::seconds(0)) == std::future_status::deferred)
+        {
+            pending = {};
+            return;
+        }
+    }
+    if (!resolve())
     {
         return;
     }
@@ -117,6 +272,16 @@ void Connection::Disconnect()
         throw Connection::Exception("D-Bus connection broken");
     }
 
+    if (!wait)
+    {
+        // The glib2 D-Bus worker thread sends the pending messages
+        // before closing; the close operation keeps its own reference
+        g_dbus_connection_close(dbuscon, nullptr, nullptr, nullptr);
+        g_object_unref(dbuscon);
+        dbuscon = nullptr;
+        return;
+    }
+
     GError *err_flush = nullptr;
     bool r = g_dbus_connection_flush_sync(dbuscon, nullptr, &err_flush);
     if (!r || err_flush)
@@ -134,4 +299,333 @@ void Connection::Disconnect()
     dbuscon = nullptr;
 }
 
+
+GDBusConnection *Connection::connect_bus(DBus::BusType bustype)
+{
+    GBusType glib2_bustype = G_BUS_TYPE_NONE;
+    switch (bustype)
+    {
+    case BusType::SESSION:
+        glib2_bustype = G_BUS_TYPE_SESSION;
+        break;
+    case BusType::SYSTEM:
+        glib2_bustype = G_BUS_TYPE_SYSTEM;
+        break;
+    default:
+        throw Connection::Exception("Invalid bus type");
+    }
+
+    GError *error = nullptr;
+    GDBusConnection *conn = g_bus_get_sync(glib2_bustype, nullptr, &error);
+    if (!conn || error)
+    {
+        std::string errmsg = "Could not connect to the D-Bus";
+        if (error)
+        {
+            errmsg += ": " + std::string(error->message);
+            g_error_free(error);
+        }
+        if (conn)
+        {
+            g_object_unref(conn);
+        }
+        throw Connection::Exception(errmsg);
+    }
+    return conn;
+}
+
+
+GDBusConnection *Connection::resolve() const noexcept
+{
+    std::lock_guard<std::mutex> lg(pending_mtx);
+    if (dbuscon || !pending.valid())
+    {
+        return dbuscon;
+    }
+    try
+    {
+        dbuscon = pending.get();
+    }
+    catch (...)
+    {
+        connect_error = std::current_exception();
+    }
+    pending = {};
+    return dbuscon;
+}
+
+
+
+
+thread_local Connection::Cork *Connection::Cork::current = nullptr;
+
+
+Connection::Cork::Cork(Connection::Ptr conn)
+    : Cork(conn->ConnPtr())
+{
+}
+
+
+Connection::Cork::Cork(GDBusConnection *conn)
+    : connection(G_DBUS_CONNECTION(g_object_ref(conn))), outer(current)
+{
+    current = this;
+}
+
+
+Connection::Cork::~Cork() noexcept
+{
+    current = outer;
+
+    // A scope nested within another scope for the same connection hands
+    // its messages over to the outer scope
+    Cork *scope = find(connection);
+    if (scope)
+    {
+        scope->held.insert(scope->held.end(), held.begin(), held.end());
+    }
+    else
+    {
+        for (auto &msg : held)
+        {
+            GError *err = nullptr;
+            if (!g_dbus_connection_send_message(connection,
+                                                msg,
+                                                G_DBUS_SEND_MESSAGE_FLAGS_NONE,
+                                                nullptr,
+                                                &err))
+            {
+                std::cerr << "[GDBus++ Error] Failed to send a corked message";
+                if (err)
+                {
+                    std::cerr << ": " << err->message;
+                    g_error_free(err);
+                }
+                std::cerr << std::endl;
+            }
+            g_object_unref(msg);
+        }
+    }
+    g_object_unref(connection);
+}
+
+
+bool Connection::Cork::SendMessage(GDBusConnection *conn,
+                                   GDBusMessage *msg,
+                                   GError **error)
+{
+    Cork *scope = find(conn);
+    if (!scope)
+    {
+        return g_dbus_connection_send_message(conn,
+                                              msg,
+                                              G_DBUS_SEND_MESSAGE_FLAGS_NONE,
+                                              nullptr,
+                                              error);
+    }
+    scope->held.push_back(G_DBUS_MESSAGE(g_object_ref(msg)));
+    return true;
+}
+
+
+bool Connection::Cork::EmitSignal(GDBusConnection *conn,
+                                  const char *destination,
+                                  const char *path,
+                                  const char *interface,
+                                  const char *signal_name,
+                                  GVariant *params,
+                                  GError **error)
+{
+    Cork *scope = find(conn);
+    if (!scope)
+    {
+        return g_dbus_connection_emit_signal(conn,
+                                             destination,
+                                             path,
+                                             interface,
+                                             signal_name,
+                                             params,
+                                             error);
+    }
+
+    // Consumes a floating params reference, like g_dbus_connection_emit_signal()
+    GDBusMessage *msg = g_dbus_message_new_signal(path, interface, signal_name);
+    if (destination)
+    {
+        g_dbus_message_set_destination(msg, destination);
+    }
+    if (params)
+    {
+        g_dbus_message_set_body(msg, params);
+    }
+    scope->held.push_back(msg);
+    return true;
+}
+
+
+void Connection::Cork::ReturnValue(GDBusMethodInvocation *invocation,
+                                   GVariant *params,
+                                   GUnixFDList *fd_list)
+{
+    Cork *scope = find(g_dbus_method_invocation_get_connection(invocation));
+    if (!scope)
+    {
+        if (fd_list)
+        {
+            g_dbus_method_invocation_return_value_with_unix_fd_list(invocation,
+                                                                    params,
+                                                                    fd_list);
+        }
+        else
+        {
+            g_dbus_method_invocation_return_value(invocation, params);
+        }
+        return;
+    }
+
+    // The reply is built as glib2 does it; this takes over the
+    // invocation reference and a floating params reference
+    GDBusMessage *call = g_dbus_method_invocation_get_message(invocation);
+    if (!params)
+    {
+        params = g_variant_new_tuple(nullptr, 0);
+    }
+    g_variant_ref_sink(params);
+    if (0 == (g_dbus_message_get_flags(call) & G_DBUS_MESSAGE_FLAGS_NO_REPLY_EXPECTED))
+    {
+        GDBusMessage *reply = g_dbus_message_new_method_reply(call);
+        g_dbus_message_set_body(reply, params);
+        if (fd_list)
+        {
+            g_dbus_message_set_unix_fd_list(reply, fd_list);
+        }
+        scope->held.push_back(reply);
+    }
+    g_variant_unref(params);
+    g_object_unref(invocation);
+}
+
+
+void Connection::Cork::ReturnDBusError(GDBusMethodInvocation *invocation,
+                                       const char *error_name,
+                                       const char *message)
+{
+    Cork *scope = find(g_dbus_method_invocation_get_connection(invocation));
+    if (!scope)
+    {
+        g_dbus_method_invocation_return_dbus_error(invocation, error_name, message);
+        return;
+    }
+
+    // The error reply is held back like any other reply, so it is not
+    // sent ahead of the messages held back before it.  This takes over
+    // the invocation reference.
+    GDBusMessage *call = g_dbus_method_invocation_get_message(invocation);
+    if (0 == (g_dbus_message_get_flags(call) & G_DBUS_MESSAGE_FLAGS_NO_REPLY_EXPECTED))
+    {
+        scope->held.push_back(g_dbus_message_new_method_error_literal(call,
+                                                                      error_name,
+                                                                      message));
+    }
+    g_object_unref(invocation);
+}
+
+
+void Connection::Cork::TakeError(GDBusMethodInvocation *invocation, GError *error)
+{
+    if (!find(g_dbus_method_invocation_get_connection(invocation)))
+    {
+        g_dbus_method_invocation_take_error(invocation, error);
+        return;
+    }
+
+    // The error name is encoded as glib2 does it
+    gchar *error_name = g_dbus_error_encode_gerror(error);
+    ReturnDBusError(invocation, error_name, error->message);
+    g_free(error_name);
+    g_error_free(error);
+}
+
+
+Connection::Cork *Connection::Cork::find(GDBusConnection *conn) noexcept
+{
+    for (Cork *scope = current; scope; scope = scope->outer)
+    {
+        if (scope->connection == conn)
+        {
+            return scope;
+        }
+    }
+    return nullptr;
+}
+
+
+
+
+Connection::Pool::Pool(const DBus::BusType &bustype, const size_t size)
+{
+    if (size < 1 || size > DBUS_CONNECTION_POOL_MAX)
+    {
+        throw Connection::Exception("Invalid connection pool size: "
+                                    + std::to_string(size));
+    }
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        auto conn = Connection::CreateExclusive(bustype);
+        auto loop = MainLoop::CreatePrivate();
+        conn->BindMainLoop(loop);
+        loop->Start();
+        connections.push_back(conn);
+    }
+}
+
+
+Connection::Pool::~Pool() noexcept
+{
+    for (const auto &conn : connections)
+    {
+        auto loop = conn->GetMainLoop();
+        try
+        {
+            if (loop && loop->Running())
+            {
+                loop->Stop();
+            }
+        }
+        catch (const MainLoop::Exception &)
+        {
+            // The loop stopped in the meantime, nothing to do
+        }
+    }
+}
+
+
+Connection::Ptr Connection::Pool::Get() const noexcept
+{
+    return connections[Shard()];
+}
+
+
+Connection::Ptr Connection::Pool::Get(const size_t index) const
+{
+    if (index >= connections.size())
+    {
+        throw Connection::Exception("Connection pool index out of range");
+    }
+    return connections[index];
+}
+
+
+size_t Connection::Pool::Shard() const noexcept
+{
+    return std::hash<std::thread::id>{}(std::this_thread::get_id()) % connections.size();
+}
+
+
+size_t Connection::Pool::Size() const noexcept
+{
+    return connections.size();
+}
+
 } // namespace DBus
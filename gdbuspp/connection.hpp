@@ -8,13 +8,20 @@
 
 #pragma once
 
+#include <exception>
+#include <functional>
+#include <future>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 #include <glib.h>
 #include <gio/gio.h>
 
 #include "exceptions.hpp"
+#include "mainloop.hpp"
 
 /**
  * @file connection.cpp
@@ -22,6 +29,12 @@
  * @brief Declaration of the DBus::Connection class
  */
 
+/**
+ *  Maximum number of connections in a DBus::Connection::Pool
+ */
+#define DBUS_CONNECTION_POOL_MAX 64
+
+
 namespace DBus {
 
 /**
@@ -32,7 +45,8 @@ enum class BusType
 {
     UNKNOWN, ///< Not identified/set
     SESSION, ///< Connect to the Session D-Bus bus
-    SYSTEM   ///< Connect to the System D-Bus bus
+    SYSTEM,  ///< Connect to the System D-Bus bus
+    PEER     ///< Direct peer-to-peer connection, without a bus daemon
 };
 
 /**
@@ -51,6 +65,17 @@ class Connection
         virtual ~Exception() noexcept = default;
     };
 
+    class Pool;
+    class Cork;
+
+    /**
+     *  Callback function used by CreateAsync(), called when the
+     *  connection has been established or failed.  The error argument
+     *  is nullptr on success, otherwise it carries the
+     *  Connection::Exception.
+     */
+    using ReadyCallback = std::function<void(std::exception_ptr error)>;
+
 
     /**
      *  Prepares a new connection to the D-Bus bus.
@@ -65,6 +90,91 @@ class Connection
     }
 
 
+    /**
+     *  Prepares a new connection to the D-Bus bus which is not shared
+     *  with any other Connection object in this process.  Each such
+     *  connection has its own unique bus name and its own message
+     *  queue and locking inside glib2.
+     *
+     * @param bustype  Defines if the connection should be to the
+     *                 system bus or session bus
+     * @return Returns a Connection::Ptr with the new D-Bus connection
+     */
+    [[nodiscard]] static Connection::Ptr CreateExclusive(const DBus::BusType &bustype)
+    {
+        return Ptr(new Connection(bustype, true));
+    }
+
+
+    /**
+     *  Prepares a new connection to the D-Bus bus without blocking the
+     *  caller.  The connection is established in a separate thread;
+     *  the returned object can be used right away and any use needing
+     *  the underlying connection waits until it is ready.
+     *
+     * @param bustype  Defines if the connection should be to the
+     *                 system bus or session bus
+     * @param ready    (optional) ReadyCallback called from the connecting
+     *                 thread once the connection attempt has completed
+     * @return Returns a Connection::Ptr to the pending D-Bus connection
+     */
+    [[nodiscard]] static Connection::Ptr CreateAsync(const DBus::BusType &bustype,
+                                                     ReadyCallback ready = nullptr)
+    {
+        return Ptr(new Connection(bustype, std::move(ready)));
+    }
+
+
+    /**
+     *  Prepares a new connection to the D-Bus bus which is only
+     *  established on first use, such as when a Proxy::Client is
+     *  created or ConnPtr() is called.  Tools which may exit before
+     *  doing any D-Bus calls do not pay for connecting.
+     *
+     * @param bustype  Defines if the connection should be to the
+     *                 system bus or session bus
+     * @return Returns a Connection::Ptr to the not yet established
+     *         D-Bus connection
+     */
+    [[nodiscard]] static Connection::Ptr CreateLazy(const DBus::BusType &bustype)
+    {
+        return Ptr(new Connection(bustype, nullptr, true));
+    }
+
+
+    /**
+     *  Prepares a new direct peer-to-peer D-Bus connection, bypassing
+     *  the D-Bus daemon.  The other end is typically a DBus::PeerServer.
+     *
+     *  Peer-to-peer connections have no bus names; Proxy::Client objects
+     *  on such a connection must use an empty destination.
+     *
+     * @param address  std::string with the D-Bus address to connect to,
+     *                 such as "unix:path=/run/my-service/socket"
+     * @return Returns a Connection::Ptr with the peer-to-peer connection
+     */
+    [[nodiscard]] static Connection::Ptr CreatePeer(const std::string &address)
+    {
+        return Ptr(new Connection(address));
+    }
+
+
+    /**
+     *  Wraps an already established glib2 GDBusConnection, such as the
+     *  connections accepted by DBus::PeerServer.  A new reference to the
+     *  connection is taken.
+     *
+     * @param conn     GDBusConnection pointer to wrap
+     * @param bustype  DBus::BusType describing the connection
+     * @return Returns a Connection::Ptr wrapping the glib2 connection
+     */
+    [[nodiscard]] static Connection::Ptr Create(GDBusConnection *conn,
+                                                const DBus::BusType &bustype)
+    {
+        return Ptr(new Connection(conn, bustype));
+    }
+
+
     /**
      * When the Connection object is being destructed, it will first
      * close all connections and release related resources.
@@ -73,17 +183,30 @@ class Connection
 
 
     /**
-     *  Retrieve the raw glib2 based connection pointer
+     *  Retrieve the raw glib2 based connection pointer.  For connections
+     *  created via CreateAsync() or CreateLazy(), this waits for or
+     *  establishes the connection first.
      *
-     * @return GDBusConnection*
+     * @return GDBusConnection*, nullptr if the connection could not be
+     *         established
      */
     GDBusConnection *ConnPtr() const noexcept;
 
 
+    /**
+     *  Wait for a connection created via CreateAsync() or CreateLazy()
+     *  to be established.  This returns immediately for all other
+     *  connections.
+     *
+     * @throws Connection::Exception if the connection failed
+     */
+    void WaitReady() const;
+
+
     /**
      *  Retrieve the unique D-Bus bus name this connection has been
      *  assigned.  This is controlled by the main D-Bus daemon on the
-     *  system.
+     *  system.  Peer-to-peer connections return an empty string.
      *
      * @return const std::string
      */
@@ -106,11 +229,48 @@ class Connection
      */
     const bool Check() const;
 
+    /**
+     *  Bind this connection to a specific main loop.  D-Bus objects,
+     *  bus names and signal subscriptions registered via this
+     *  Connection object afterwards are dispatched in that main loop.
+     *  Binding independent services or client connections to separate
+     *  MainLoop::CreatePrivate() main loops lets them dispatch in
+     *  parallel.
+     *
+     *  Registrations done before binding are not moved.
+     *
+     * @param loop  MainLoop::Ptr to bind to, nullptr for the default
+     *              main context
+     */
+    void BindMainLoop(MainLoop::Ptr loop) noexcept;
+
+    /**
+     *  Retrieve the main loop this connection is bound to
+     *
+     * @return MainLoop::Ptr, nullptr if not bound to a specific main loop
+     */
+    MainLoop::Ptr GetMainLoop() const noexcept;
+
     /**
      *  Explicit disconnect request, clossing the D-Bus connection
      *  and release related resources.
+     *
+     * @param wait  If true (default), wait until all pending messages
+     *              have been sent and the connection is closed.  If
+     *              false, the pending messages are sent and the
+     *              connection closed in the background by the glib2
+     *              D-Bus worker thread.
+     */
+    void Disconnect(const bool wait = true);
+
+    /**
+     *  Do not wait for the pending messages to be sent and the
+     *  connection to be closed when this object is destroyed.  This
+     *  saves a round trip on exit for short-lived tools.
+     *
+     * @param enable  bool, enables non-blocking close on destruction
      */
-    void Disconnect();
+    void SetNonBlockingClose(const bool enable) noexcept;
 
     friend std::ostream &operator<<(std::ostream &os, const Connection::Ptr &req)
     {
@@ -120,6 +280,8 @@ class Connection
             return os << std::string("Connection(BusType::SESSION)");
         case BusType::SYSTEM:
             return os << std::string("Connection(BusType::SYSTEM)");
+        case BusType::PEER:
+            return os << std::string("Connection(BusType::PEER)");
         default:
             return os << std::string("Connection(BusType::UNKNOWN)");
         }
@@ -128,10 +290,221 @@ class Connection
 
 
   private:
-    GDBusConnection *dbuscon = nullptr; ///< The glib2 connection object
-    BusType type;                       ///< The bus type this object uses
+    mutable GDBusConnection *dbuscon = nullptr; ///< The glib2 connection object
+    BusType type;                               ///< The bus type this object uses
+    MainLoop::Ptr mainloop{};                   ///< Main loop dispatching callbacks
+    bool nonblocking_close = false;             ///< Don't wait for close on destruction
+
+    /// Pending connection of CreateAsync() and CreateLazy() objects
+    mutable std::shared_future<GDBusConnection *> pending{};
+    mutable std::exception_ptr connect_error = nullptr;
+    mutable std::mutex pending_mtx{};
 
     Connection(DBus::BusType bustype);
+    Connection(DBus::BusType bustype, const bool exclusive);
+    Connection(DBus::BusType bustype, ReadyCallback ready, const bool lazy = false);
+    Connection(const std::string &address);
+    Connection(GDBusConnection *conn, DBus::BusType bustype);
+
+    /**
+     *  Connect to the D-Bus bus, blocking until connected
+     *
+     * @param bustype  DBus::BusType to connect to
+     * @return GDBusConnection* to the shared bus connection
+     * @throws Connection::Exception on errors
+     */
+    static GDBusConnection *connect_bus(DBus::BusType bustype);
+
+    /**
+     *  Completes a pending connection, if there is one
+     *
+     * @return GDBusConnection* or nullptr if the connection failed
+     */
+    GDBusConnection *resolve() const noexcept;
+};
+
+
+
+/**
+ *  Scope holding back the signals and method replies a thread sends on
+ *  a connection while the scope exists.  When the scope ends, the
+ *  messages are handed over to the glib2 D-Bus worker in their original
+ *  order in one burst, so it writes them back to back instead of waking
+ *  up for each of them.  This covers Signals::Emit, property change
+ *  notifications and method replies, including the error replies sent by
+ *  GDBus++, so they all keep their order.  Outgoing method calls are never
+ *  held back.
+ *
+ *  Only messages sent by the thread which created the scope are held
+ *  back; other threads are not affected.  Scopes can be nested; the
+ *  messages are released by the outermost scope for the same connection.
+ *
+ *  Example - several signals and the replies of deferred method calls
+ *  being written in one go:
+ *
+ *     {
+ *         DBus::Connection::Cork cork(connection);
+ *         signals->SendGVariant("Progress", ...);
+ *         signals->SendGVariant("Done", ...);
+ *         deferred_reply->Return(...);
+ *     }
+ */
+class Connection::Cork
+{
+  public:
+    Cork(Connection::Ptr conn);
+    Cork(GDBusConnection *conn);
+    ~Cork() noexcept;
+
+    Cork(const Cork &) = delete;
+    Cork &operator=(const Cork &) = delete;
+
+    /**
+     *  Send a message, or hold it back if the current thread has a
+     *  Cork scope for the connection.  Used by GDBus++ for all outgoing
+     *  signals.
+     *
+     * @param conn   GDBusConnection to send the message on
+     * @param msg    GDBusMessage to send; the reference is not taken over
+     * @param error  GError return pointer, used if sending failed
+     *
+     * @return true if the message was sent or held back
+     */
+    static bool SendMessage(GDBusConnection *conn, GDBusMessage *msg, GError **error);
+
+    /**
+     *  Cork scope aware variant of g_dbus_connection_emit_signal()
+     */
+    static bool EmitSignal(GDBusConnection *conn,
+                           const char *destination,
+                           const char *path,
+                           const char *interface,
+                           const char *signal_name,
+                           GVariant *params,
+                           GError **error);
+
+    /**
+     *  Cork scope aware variant of g_dbus_method_invocation_return_value()
+     *  and g_dbus_method_invocation_return_value_with_unix_fd_list()
+     */
+    static void ReturnValue(GDBusMethodInvocation *invocation,
+                            GVariant *params,
+                            GUnixFDList *fd_list = nullptr);
+
+    /**
+     *  Cork scope aware variant of g_dbus_method_invocation_return_dbus_error()
+     */
+    static void ReturnDBusError(GDBusMethodInvocation *invocation,
+                                const char *error_name,
+                                const char *message);
+
+    /**
+     *  Cork scope aware variant of g_dbus_method_invocation_take_error()
+     */
+    static void TakeError(GDBusMethodInvocation *invocation, GError *error);
+
+  private:
+    /// Innermost Cork scope of the current thread
+    static thread_local Cork *current;
+
+    GDBusConnection *connection = nullptr;
+    Cork *outer = nullptr;
+    std::vector<GDBusMessage *> held{};
+
+    /**
+     *  Find the innermost scope of the current thread for a connection
+     *
+     * @param conn  GDBusConnection to look up
+     * @return Cork pointer, nullptr if none is active
+     */
+    static Cork *find(GDBusConnection *conn) noexcept;
+};
+
+
+
+/**
+ *  A fixed set of exclusive D-Bus connections, each bound to its own
+ *  private main loop running in a dedicated thread.  This spreads the
+ *  D-Bus traffic of multi-threaded clients across several glib2
+ *  connections instead of serializing all of it through one.
+ *
+ *  Each calling thread is always given the same connection from the
+ *  pool.  Ordering guarantees:
+ *
+ *   - Calls and signals sent from one thread go through the same
+ *     connection, and keep the D-Bus per-connection ordering towards
+ *     each destination.
+ *
+ *   - Calls sent from different threads may use different connections;
+ *     there is no ordering between them, even towards the same
+ *     destination.
+ *
+ *   - Each connection has its own unique bus name.  Services will see
+ *     the calls from a pool as coming from different senders.  Pooled
+ *     connections are intended for clients; services owning a bus name
+ *     should use a single connection.
+ */
+class Connection::Pool
+{
+  public:
+    using Ptr = std::shared_ptr<Pool>;
+
+    /**
+     *  Prepare a new connection pool
+     *
+     * @param bustype  Defines if the connections should be to the
+     *                 system bus or session bus
+     * @param size     size_t with the number of connections to prepare,
+     *                 must be between 1 and DBUS_CONNECTION_POOL_MAX
+     * @return Connection::Pool::Ptr to the new connection pool
+     * @throws Connection::Exception on errors
+     */
+    [[nodiscard]] static Pool::Ptr Create(const DBus::BusType &bustype,
+                                          const size_t size)
+    {
+        return Ptr(new Pool(bustype, size));
+    }
+
+    /**
+     *  Stops the main loops of all the connections in the pool
+     */
+    ~Pool() noexcept;
+
+    /**
+     *  Retrieve the connection used by the calling thread
+     *
+     * @return Connection::Ptr
+     */
+    Connection::Ptr Get() const noexcept;
+
+    /**
+     *  Retrieve a specific connection in the pool
+     *
+     * @param index  size_t with the index of the connection
+     * @return Connection::Ptr
+     * @throws Connection::Exception if the index is out of range
+     */
+    Connection::Ptr Get(const size_t index) const;
+
+    /**
+     *  Retrieve the index of the connection used by the calling thread
+     *
+     * @return size_t with the connection index
+     */
+    size_t Shard() const noexcept;
+
+    /**
+     *  Retrieve the number of connections in the pool
+     *
+     * @return size_t
+     */
+    size_t Size() const noexcept;
+
+
+  private:
+    std::vector<Connection::Ptr> connections{};
+
+    Pool(const DBus::BusType &bustype, const size_t size);
 };
 
 } // namespace DBus
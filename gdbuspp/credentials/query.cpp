@@ -12,13 +12,266 @@
  *  @brief Implementation of DBus::Credential::Service
  */
 
+#include <map>
+#include <mutex>
+#include <string>
+#include <gio/gio.h>
+
 #include "exceptions.hpp"
 #include "query.hpp"
+#include "../features/debug-log.hpp"
+
+#define DBUS_CREDENTIALS_CACHE_SIZE 1024
 
 
 namespace DBus {
 namespace Credentials {
 
+namespace _private {
+
+/**
+ *  Cache of the credentials of unique bus names, shared by all the
+ *  Credentials::Query objects using the same D-Bus connection.
+ *
+ *  Unique bus names are never reused on a bus, so an entry is valid
+ *  until the bus name disappears.  Each cached name is tracked via the
+ *  DBusServiceQuery object of the connection, which reports when the
+ *  name has gone.  This is processed in the glib2 D-Bus worker thread,
+ *  so this works without any main loop.
+ */
+class CredentialsCache
+{
+  public:
+    using Ptr = std::shared_ptr<CredentialsCache>;
+
+    /**
+     *  Retrieve the CredentialsCache object for a D-Bus connection.
+     *  If one does not exist already, it is created.
+     *
+     * @param conn  DBus::Connection::Ptr
+     *
+     * @return CredentialsCache::Ptr
+     */
+    static Ptr Get(DBus::Connection::Ptr conn)
+    {
+        std::lock_guard<std::mutex> lg(registry_mtx);
+        auto &entry = registry[conn->ConnPtr()];
+        auto cache = entry.lock();
+        if (!cache)
+        {
+            cache = Ptr(new CredentialsCache(conn));
+            std::weak_ptr<CredentialsCache> weak = cache;
+            cache->listener_id = cache->service_qry->AddNameOwnerListener(
+                [weak](const std::string &name, const std::string &new_owner)
+                {
+                    if (':' != name[0] || !new_owner.empty())
+                    {
+                        return;
+                    }
+                    if (auto self = weak.lock())
+                    {
+                        self->name_vanished(name);
+                    }
+                });
+            entry = cache;
+        }
+        return cache;
+    }
+
+
+    ~CredentialsCache() noexcept
+    {
+        service_qry->RemoveNameOwnerListener(listener_id);
+        for (const auto &e : entries)
+        {
+            service_qry->UntrackName(e.first);
+        }
+
+        std::lock_guard<std::mutex> lg(registry_mtx);
+        auto it = registry.find(gconn);
+        if (registry.end() != it && it->second.expired())
+        {
+            registry.erase(it);
+        }
+    }
+
+
+    /**
+     *  Look up the credentials of a unique bus name in the cache
+     *
+     * @param unique_name  std::string with the unique bus name
+     * @param info         Query::Info where the result is stored
+     *
+     * @return true if found, otherwise false
+     */
+    bool Lookup(const std::string &unique_name, Query::Info &info)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        auto it = entries.find(unique_name);
+        if (entries.end() == it)
+        {
+            return false;
+        }
+        info = it->second;
+        return true;
+    }
+
+
+    /**
+     *  Prepare for looking up the credentials of a unique bus name.
+     *
+     *  The name is tracked before the lookup is done, so it is not
+     *  possible to miss the name disappearing while the lookup is in
+     *  progress.  This must be followed by a call to either @Store()
+     *  or @Abort().
+     *
+     * @param unique_name  std::string with the unique bus name
+     */
+    void Begin(const std::string &unique_name)
+    {
+        {
+            std::lock_guard<std::mutex> lg(mtx);
+            ++pending[unique_name].refs;
+        }
+
+        try
+        {
+            service_qry->TrackName(unique_name);
+        }
+        catch (const DBus::Exception &)
+        {
+            // Without tracking the name, the entry cannot be kept
+            // current.  The result will not be cached.
+            std::lock_guard<std::mutex> lg(mtx);
+            pending[unique_name].vanished = true;
+        }
+    }
+
+
+    /**
+     *  Complete a lookup started with @Begin() and store the result,
+     *  unless the name disappeared in the mean time
+     *
+     * @param info  Query::Info with the result
+     */
+    void Store(const Query::Info &info)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        bool vanished = end_pending(info.unique_name);
+        if (vanished)
+        {
+            return;
+        }
+        entries[info.unique_name] = info;
+        while (entries.size() > DBUS_CREDENTIALS_CACHE_SIZE)
+        {
+            // Evict an arbitrary entry; it will be looked up again if needed
+            auto it = entries.begin();
+            if (it->first == info.unique_name)
+            {
+                ++it;
+            }
+            const std::string name = it->first;
+            entries.erase(it);
+            untrack(name);
+        }
+    }
+
+
+    /**
+     *  Complete a failed lookup started with @Begin()
+     *
+     * @param unique_name  std::string with the unique bus name
+     */
+    void Abort(const std::string &unique_name)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        end_pending(unique_name);
+        untrack(unique_name);
+    }
+
+
+  private:
+    struct Pending
+    {
+        unsigned int refs = 0;
+        bool vanished = false;
+    };
+
+    static std::mutex registry_mtx;
+    static std::map<GDBusConnection *, std::weak_ptr<CredentialsCache>> registry;
+
+    GDBusConnection *gconn = nullptr;
+    Proxy::Utils::DBusServiceQuery::Ptr service_qry = nullptr;
+    uint64_t listener_id = 0;
+    std::mutex mtx{};
+    std::map<std::string, Query::Info> entries{};
+    std::map<std::string, Pending> pending{};
+
+
+    CredentialsCache(DBus::Connection::Ptr conn)
+        : gconn(conn->ConnPtr()),
+          service_qry(Proxy::Utils::DBusServiceQuery::Create(conn))
+    {
+    }
+
+
+    /**
+     *  Release a pending lookup.  The mtx lock must be held.
+     *
+     * @return true if the name disappeared while the lookup was pending
+     */
+    bool end_pending(const std::string &unique_name)
+    {
+        auto it = pending.find(unique_name);
+        if (pending.end() == it)
+        {
+            return true;
+        }
+        bool vanished = it->second.vanished;
+        if (--it->second.refs == 0)
+        {
+            pending.erase(it);
+        }
+        return vanished;
+    }
+
+
+    /**
+     *  Stop tracking a bus name which is neither cached nor being
+     *  looked up.  The mtx lock must be held.
+     */
+    void untrack(const std::string &unique_name)
+    {
+        if (entries.find(unique_name) == entries.end()
+            && pending.find(unique_name) == pending.end())
+        {
+            service_qry->UntrackName(unique_name);
+        }
+    }
+
+
+    void name_vanished(const std::string &name)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        auto p = pending.find(name);
+        if (pending.end() != p)
+        {
+            p->second.vanished = true;
+        }
+        if (entries.erase(name) > 0)
+        {
+            GDBUSPP_LOG("Credentials cache: '" << name << "' disappeared");
+        }
+    }
+};
+
+std::mutex CredentialsCache::registry_mtx;
+std::map<GDBusConnection *, std::weak_ptr<CredentialsCache>> CredentialsCache::registry;
+
+} // namespace _private
+
+
 
 Credentials::Query::Query(DBus::Connection::Ptr dbuscon)
 {
@@ -27,6 +280,23 @@ Credentials::Query::Query(DBus::Connection::Ptr dbuscon)
     dbus_proxy = Proxy::Client::Create(dbuscon, "org.freedesktop.DBus");
     dbus_target = Proxy::TargetPreset::Create("/net/freedesktop/DBus",
                                               "org.freedesktop.DBus");
+    service_qry = Proxy::Utils::DBusServiceQuery::Create(dbuscon);
+    cache = _private::CredentialsCache::Get(dbuscon);
+}
+
+
+const Query::Info Credentials::Query::GetCredentials(const std::string &busname) const
+{
+    try
+    {
+        return fetch_credentials(busname);
+    }
+    catch (const DBus::Exception &excp)
+    {
+        throw Credentials::Exception("GetCredentials",
+                                     "Failed to retrieve credentials for bus name '"
+                                         + busname + "': " + excp.GetRawError());
+    }
 }
 
 
@@ -34,12 +304,7 @@ const uid_t Credentials::Query::GetUID(const std::string &busname) const
 {
     try
     {
-        GVariant *result = dbus_proxy->Call(dbus_target,
-                                            "GetConnectionUnixUser",
-                                            glib2::Value::CreateTupleWrapped(busname));
-        uid_t ret = glib2::Value::Extract<uint32_t>(result, 0);
-        g_variant_unref(result);
-        return ret;
+        return fetch_credentials(busname).uid;
     }
     catch (const DBus::Exception &excp)
     {
@@ -54,12 +319,7 @@ const pid_t Credentials::Query::GetPID(const std::string &busname) const
 {
     try
     {
-        GVariant *result = dbus_proxy->Call(dbus_target,
-                                            "GetConnectionUnixProcessID",
-                                            glib2::Value::CreateTupleWrapped(busname));
-        pid_t pid = glib2::Value::Extract<uint32_t>(result, 0);
-        g_variant_unref(result);
-        return pid;
+        return fetch_credentials(busname).pid;
     }
     catch (const DBus::Exception &excp)
     {
@@ -74,12 +334,8 @@ const std::string Credentials::Query::GetUniqueBusName(const std::string &busnam
 {
     try
     {
-        GVariant *result = dbus_proxy->Call(dbus_target,
-                                            "GetNameOwner",
-                                            glib2::Value::CreateTupleWrapped(busname));
-        std::string ret = glib2::Value::Extract<std::string>(result, 0);
-        g_variant_unref(result);
-        return ret;
+        // The shared service query object caches the result
+        return service_qry->GetNameOwner(busname);
     }
     catch (const DBus::Exception &excp)
     {
@@ -89,5 +345,78 @@ const std::string Credentials::Query::GetUniqueBusName(const std::string &busnam
     }
 }
 
+
+const Query::Info Credentials::Query::fetch_credentials(const std::string &busname) const
+{
+    Info info{};
+    info.unique_name = (!busname.empty() && ':' == busname[0]
+                            ? busname
+                            : service_qry->GetNameOwner(busname));
+    if (cache->Lookup(info.unique_name, info))
+    {
+        return info;
+    }
+
+    cache->Begin(info.unique_name);
+    GVariant *result = nullptr;
+    try
+    {
+        result = dbus_proxy->Call(dbus_target,
+                                  "GetConnectionCredentials",
+                                  glib2::Value::CreateTupleWrapped(info.unique_name));
+    }
+    catch (...)
+    {
+        cache->Abort(info.unique_name);
+        throw;
+    }
+
+    GVariant *dict = g_variant_get_child_value(result, 0);
+    g_variant_unref(result);
+
+    bool has_uid = false;
+    bool has_pid = false;
+    GVariantIter iter;
+    const gchar *key = nullptr;
+    GVariant *value = nullptr;
+    g_variant_iter_init(&iter, dict);
+    while (g_variant_iter_loop(&iter, "{&sv}", &key, &value))
+    {
+        if (g_strcmp0(key, "UnixUserID") == 0)
+        {
+            info.uid = glib2::Value::Get<uint32_t>(value);
+            has_uid = true;
+        }
+        else if (g_strcmp0(key, "ProcessID") == 0)
+        {
+            info.pid = glib2::Value::Get<uint32_t>(value);
+            has_pid = true;
+        }
+        else if (g_strcmp0(key, "LinuxSecurityLabel") == 0)
+        {
+            // Sent as a NUL terminated byte array
+            gsize len = 0;
+            auto label = static_cast<const char *>(
+                g_variant_get_fixed_array(value, &len, sizeof(guchar)));
+            info.security_label = std::string(label, len);
+            while (!info.security_label.empty() && '\0' == info.security_label.back())
+            {
+                info.security_label.pop_back();
+            }
+        }
+    }
+    g_variant_unref(dict);
+
+    if (!has_uid || !has_pid)
+    {
+        cache->Abort(info.unique_name);
+        throw Credentials::Exception("GetCredentials",
+                                     "Incomplete credentials for bus name '"
+                                         + busname + "'");
+    }
+    cache->Store(info);
+    return info;
+}
+
 } // namespace Credentials
 } // namespace DBus
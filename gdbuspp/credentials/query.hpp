@@ -16,8 +16,13 @@
  */
 
 
+#include <memory>
+#include <string>
+#include <sys/types.h>
+
 #include "../connection.hpp"
 #include "../proxy.hpp"
+#include "../proxy/utils.hpp"
 #include "../glib2/utils.hpp"
 
 #include "exceptions.hpp"
@@ -26,6 +31,11 @@
 namespace DBus {
 namespace Credentials {
 
+namespace _private {
+class CredentialsCache;
+}
+
+
 /**
  *   Queries the D-Bus daemon for the credentials of a specific D-Bus
  *   bus name.  Each D-Bus client performing an operation on a D-Bus
@@ -37,6 +47,18 @@ class Query
   public:
     using Ptr = std::shared_ptr<Credentials::Query>;
 
+    /**
+     *  All the credentials details of a bus name retrieved via
+     *  the org.freedesktop.DBus.GetConnectionCredentials method
+     */
+    struct Info
+    {
+        std::string unique_name{};    ///< Unique bus name of the connection
+        uid_t uid = -1;               ///< UID of the connection owner
+        pid_t pid = -1;               ///< Process ID of the connection owner
+        std::string security_label{}; ///< Linux security label (LSM), may be empty
+    };
+
     /**
      *  Create a new DBus::Credentials::Query object
      *
@@ -50,6 +72,21 @@ class Query
         return Credentials::Query::Ptr(new Credentials::Query(dbuscon));
     }
 
+    /**
+     *  Retrieve all the credentials of a specific bus name in a single
+     *  call to the D-Bus daemon.
+     *
+     *  The results are cached per unique bus name, shared by all
+     *  Credentials::Query objects on the same DBus::Connection.  Cache
+     *  entries are removed when the bus name disappears from the bus.
+     *
+     * @param busname  String containing the bus name
+     *
+     * @return Credentials::Query::Info with the credentials
+     * @throws DBus::Credentials::Exception on errors
+     */
+    const Info GetCredentials(const std::string &busname) const;
+
     /**
      *  Retrieve the UID of the owner of a specific bus name
      *
@@ -87,6 +124,17 @@ class Query
   private:
     DBus::Proxy::Client::Ptr dbus_proxy = nullptr;
     DBus::Proxy::TargetPreset::Ptr dbus_target = nullptr;
+    DBus::Proxy::Utils::DBusServiceQuery::Ptr service_qry = nullptr;
+    std::shared_ptr<_private::CredentialsCache> cache = nullptr;
+
+    /**
+     *  Retrieve the credentials of a bus name, via the cache
+     *
+     * @param busname  String containing the bus name
+     * @return Credentials::Query::Info
+     * @throws DBus::Exception on errors
+     */
+    const Info fetch_credentials(const std::string &busname) const;
 
 
     /**
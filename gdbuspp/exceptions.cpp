@@ -13,31 +13,96 @@
  */
 
 
+#include <mutex>
 #include <string>
-#include <sstream>
+#include <unordered_map>
 #include <gio/gio.h>
 
+#include "connection.hpp"
 #include "exceptions.hpp"
 
 
 namespace DBus {
 
+namespace _private {
+
+/**
+ *  Cache of the D-Bus error domains used in error replies.  Each domain
+ *  is resolved to a GQuark and registered with glib once, instead of
+ *  doing the same lookups in glib for each error being sent.
+ */
+class ErrorDomainRegistry
+{
+  public:
+    struct Entry
+    {
+        GQuark quark = 0;
+        bool valid = false; ///< Domain can be used as a D-Bus error name
+    };
+
+    static Entry Lookup(const std::string &domain) noexcept
+    {
+        static std::mutex mtx;
+        static std::unordered_map<std::string, Entry> domains;
+
+        std::lock_guard<std::mutex> lg(mtx);
+        auto it = domains.find(domain);
+        if (domains.end() != it)
+        {
+            return it->second;
+        }
+
+        Entry entry;
+        entry.quark = g_quark_from_string(domain.c_str());
+        entry.valid = g_dbus_is_name(domain.c_str())
+                      && !g_dbus_is_unique_name(domain.c_str());
+        if (entry.valid)
+        {
+            // This fails if the domain has already been registered
+            // elsewhere; the mapping is then already in place.
+            g_dbus_error_register_error(entry.quark, 0, domain.c_str());
+        }
+        try
+        {
+            domains.emplace(domain, entry);
+        }
+        catch (const std::exception &)
+        {
+            // Only the caching failed; the entry is still usable
+        }
+        return entry;
+    }
+};
+
+} // namespace _private
+
+
+
 Exception::Exception(const std::string &classn,
                      const std::string &err,
                      GError *gliberr)
 {
-    std::ostringstream errbuf;
-    errbuf << err;
+    std::string tmperror(err);
     if (gliberr)
     {
+        // Errors sent via ReturnMethodError() carry the error domain in
+        // the D-Bus error name only, which is stripped from the message
+        gchar *remote = g_dbus_error_get_remote_error(gliberr);
         g_dbus_error_strip_remote_error(gliberr);
-        errbuf << (err.empty() ? "" : " ") << std::string(gliberr->message);
+        tmperror += (err.empty() ? "" : " ");
+        if (remote
+            && !g_str_has_prefix(remote, "org.gtk.GDBus.UnmappedGError.")
+            && !g_str_has_prefix(gliberr->message, "GDBus.Error:"))
+        {
+            tmperror += std::string("GDBus.Error:") + remote + ": ";
+        }
+        tmperror += gliberr->message;
+        g_free(remote);
         g_error_free(gliberr);
     }
 
     // If the error is prefixed with a glib2 "GDBUs.Error:", it can be
     // split up into an error domain and an error message
-    std::string tmperror = errbuf.str();
     auto gdbuserr_start = tmperror.find("GDBus.Error:");
     if (std::string::npos != gdbuserr_start)
     {
@@ -45,7 +110,7 @@ Exception::Exception(const std::string &classn,
         if (std::string::npos != domain_end)
         {
             error = tmperror.substr(domain_end + 1);
-            auto gdbuserr_end = tmperror.find(":") + 1;
+            auto gdbuserr_end = gdbuserr_start + 12;
             error_domain = tmperror.substr(gdbuserr_end,
                                            domain_end - gdbuserr_end);
         }
@@ -59,10 +124,8 @@ Exception::Exception(const std::string &classn,
         error = tmperror;
     }
 
-
-    std::ostringstream s;
-    s << "[" << classn << "] " << errbuf.str();
-    classerr = s.str();
+    classerr.reserve(classn.size() + tmperror.size() + 3);
+    classerr.append("[").append(classn).append("] ").append(tmperror);
 }
 
 
@@ -87,15 +150,10 @@ const char *Exception::DBusErrorDomain() const noexcept
 void Exception::SetDBusError(GDBusMethodInvocation *invocation) const noexcept
 {
 #ifdef GDBUSPP_DEBUG
-    GError *dbuserr = g_dbus_error_new_for_dbus_error(error_domain.c_str(),
-                                                      classerr.c_str());
+    ReturnMethodError(invocation, error_domain, classerr);
 #else
-    GError *dbuserr = g_dbus_error_new_for_dbus_error(error_domain.c_str(),
-                                                      error.c_str());
+    ReturnMethodError(invocation, error_domain, error);
 #endif
-    dbuserr->domain = g_quark_from_string(error_domain.c_str());
-    g_dbus_method_invocation_return_gerror(invocation, dbuserr);
-    g_error_free(dbuserr);
 }
 
 
@@ -104,4 +162,35 @@ void Exception::SetDBusError(GError **dbuserror, GQuark domain, gint code) const
     g_set_error(dbuserror, domain, code, "%s", error.c_str());
 }
 
+
+void Exception::ReturnMethodError(GDBusMethodInvocation *invocation,
+                                  const std::string &domain,
+                                  const std::string &message) noexcept
+{
+    auto entry = _private::ErrorDomainRegistry::Lookup(domain);
+    if (entry.valid)
+    {
+        Connection::Cork::ReturnDBusError(invocation,
+                                          domain.c_str(),
+                                          message.c_str());
+        return;
+    }
+
+    // The domain is not a valid D-Bus error name; let glib encode
+    // the error domain into an error name it can send and keep the
+    // domain in the message, where DBus::Exception can parse it out
+    GError *dbuserr = g_error_new(entry.quark,
+                                  G_IO_ERROR_DBUS_ERROR,
+                                  "GDBus.Error:%s: %s",
+                                  domain.c_str(),
+                                  message.c_str());
+    Connection::Cork::TakeError(invocation, dbuserr);
+}
+
+
+GQuark Exception::ErrorDomainQuark(const std::string &domain) noexcept
+{
+    return _private::ErrorDomainRegistry::Lookup(domain).quark;
+}
+
 } // namespace DBus
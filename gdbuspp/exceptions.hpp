@@ -88,6 +88,34 @@ class Exception : public std::exception
                               GQuark domain,
                               gint code) const noexcept;
 
+    /**
+     *  Returns an error back to an on-going D-Bus method call.  The error
+     *  domain is used as the D-Bus error name and the message is passed
+     *  on as-is.
+     *
+     *  Error domains are registered with glib on first use and the
+     *  result is cached, so sending an error reply does not need to
+     *  build and translate a GError object.
+     *
+     * @param invocation Pointer to a invocation object of the on-going
+     *                   method call
+     * @param domain     std::string with the D-Bus error domain
+     * @param message    std::string with the error message
+     */
+    static void ReturnMethodError(GDBusMethodInvocation *invocation,
+                                  const std::string &domain,
+                                  const std::string &message) noexcept;
+
+    /**
+     *  Retrieve the GQuark of a D-Bus error domain.  The domain is
+     *  registered in glib's D-Bus error mapping, which makes errors
+     *  received with this D-Bus error name use the same GQuark.
+     *
+     * @param domain  std::string with the D-Bus error domain
+     * @return GQuark
+     */
+    static GQuark ErrorDomainQuark(const std::string &domain) noexcept;
+
   protected:
     std::string error_domain = "net.openvpn.gdbuspp";
 
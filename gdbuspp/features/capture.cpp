@@ -0,0 +1,406 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file features/capture.cpp
+ *
+ * @brief  Implementation of DBus::Features::Capture
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <glib.h>
+
+#include "capture.hpp"
+
+
+namespace DBus {
+namespace Features {
+namespace Capture {
+
+namespace {
+
+static const char file_magic[] = {'G', 'D', 'B', 'P', 'P', 'C', 'A', 'P'};
+static const char file_version = 1;
+static const char local_byteorder = (G_BYTE_ORDER == G_LITTLE_ENDIAN ? 'l' : 'B');
+
+/// Largest string or argument data accepted by the Reader; the
+/// D-Bus specification limits messages to 128 MiB
+static const uint64_t max_data_length = 128 * 1024 * 1024;
+
+static std::atomic<bool> enabled{false};
+
+
+/**
+ *  The capture file being written and its string table
+ */
+struct Writer
+{
+    std::mutex mtx{};
+    FILE *file = nullptr;
+    std::string filename{};
+    int64_t last_timestamp = 0;
+    std::unordered_map<std::string, uint64_t> strings{};
+};
+
+static Writer &writer()
+{
+    static Writer w;
+    return w;
+}
+
+
+static void close_writer(Writer &w) noexcept
+{
+    enabled.store(false, std::memory_order_relaxed);
+    if (w.file)
+    {
+        std::fclose(w.file);
+        w.file = nullptr;
+    }
+    w.strings.clear();
+}
+
+
+static void put_uint(std::string &buf, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        buf.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    buf.push_back(static_cast<char>(value));
+}
+
+
+static void put_string(Writer &w, std::string &buf, const char *str)
+{
+    const std::string s(str ? str : "");
+    const auto it = w.strings.find(s);
+    if (w.strings.end() != it)
+    {
+        put_uint(buf, it->second + 2);
+        return;
+    }
+
+    if (w.strings.size() < GDBUSPP_CAPTURE_MAX_STRINGS)
+    {
+        const uint64_t idx = w.strings.size();
+        w.strings.emplace(s, idx);
+        put_uint(buf, 1);
+    }
+    else
+    {
+        put_uint(buf, 0);
+    }
+    put_uint(buf, s.size());
+    buf.append(s);
+}
+
+
+/**
+ *  Starts capturing via the GDBUSPP_CAPTURE environment variable
+ *  when the library is loaded
+ */
+static struct InitialConfig
+{
+    InitialConfig()
+    {
+        // Not honoured in set-user-ID and set-group-ID programs
+        const char *env = secure_getenv("GDBUSPP_CAPTURE");
+        if (env && *env)
+        {
+            try
+            {
+                Start(env);
+            }
+            catch (const Capture::Exception &excp)
+            {
+                std::cerr << excp.what() << std::endl;
+            }
+        }
+    }
+} initial_config;
+
+} // anonymous namespace
+
+
+
+Exception::Exception(const std::string &errm)
+    : DBus::Exception("DBus::Features::Capture", errm, nullptr)
+{
+}
+
+
+
+bool Enabled() noexcept
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+
+void Start(const std::string &filename)
+{
+    Writer &w = writer();
+    std::lock_guard<std::mutex> lg(w.mtx);
+    if (w.file)
+    {
+        throw Capture::Exception("Already capturing to " + w.filename);
+    }
+
+    // The capture contains the arguments of all the requests; it must
+    // be a new file only readable by the service user, and must not
+    // follow a symlink planted by someone else
+    const int fd = open(filename.c_str(),
+                        O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC,
+                        0600);
+    FILE *file = (fd >= 0 ? fdopen(fd, "wb") : nullptr);
+    if (!file)
+    {
+        const int err = errno;
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        throw Capture::Exception("Could not create " + filename + ": "
+                                 + std::string(std::strerror(err)));
+    }
+    if (std::fwrite(file_magic, 1, sizeof(file_magic), file) != sizeof(file_magic)
+        || std::fputc(file_version, file) == EOF
+        || std::fputc(local_byteorder, file) == EOF)
+    {
+        std::fclose(file);
+        throw Capture::Exception("Could not write to " + filename);
+    }
+
+    w.file = file;
+    w.filename = filename;
+    w.last_timestamp = g_get_monotonic_time();
+    w.strings.clear();
+    enabled.store(true, std::memory_order_relaxed);
+}
+
+
+void Stop() noexcept
+{
+    Writer &w = writer();
+    std::lock_guard<std::mutex> lg(w.mtx);
+    close_writer(w);
+}
+
+
+void Store(const char *sender,
+           const char *path,
+           const char *interface,
+           const char *member,
+           GVariant *params) noexcept
+{
+    if (!Enabled())
+    {
+        return;
+    }
+
+    Writer &w = writer();
+    std::lock_guard<std::mutex> lg(w.mtx);
+    if (!w.file)
+    {
+        return;
+    }
+
+    try
+    {
+        std::string record;
+        const int64_t now = g_get_monotonic_time();
+        put_uint(record, static_cast<uint64_t>(std::max<int64_t>(0, now - w.last_timestamp)));
+        w.last_timestamp = now;
+
+        put_string(w, record, sender);
+        put_string(w, record, path);
+        put_string(w, record, interface);
+        put_string(w, record, member);
+        put_string(w, record, (params ? g_variant_get_type_string(params) : ""));
+
+        const size_t len = (params ? g_variant_get_size(params) : 0);
+        put_uint(record, len);
+        if (len > 0)
+        {
+            record.append(static_cast<const char *>(g_variant_get_data(params)), len);
+        }
+
+        if (std::fwrite(record.data(), 1, record.size(), w.file) != record.size())
+        {
+            std::cerr << "DBus::Features::Capture: Could not write to "
+                      << w.filename << "; capture stopped" << std::endl;
+            close_writer(w);
+        }
+    }
+    catch (const std::exception &)
+    {
+        // Out of memory; skip this record
+    }
+}
+
+
+
+//
+//  Capture::Reader
+//
+
+Reader::Reader(const std::string &filename_)
+    : filename(filename_)
+{
+    file = std::fopen(filename.c_str(), "rbe");
+    if (!file)
+    {
+        throw Capture::Exception("Could not open " + filename + ": "
+                                 + std::string(std::strerror(errno)));
+    }
+
+    char header[sizeof(file_magic) + 2] = {};
+    if (std::fread(header, 1, sizeof(header), file) != sizeof(header)
+        || std::memcmp(header, file_magic, sizeof(file_magic)) != 0)
+    {
+        std::fclose(file);
+        throw Capture::Exception(filename + " is not a capture file");
+    }
+    const char version = header[sizeof(file_magic)];
+    const char byteorder = header[sizeof(file_magic) + 1];
+    if (file_version != version || ('l' != byteorder && 'B' != byteorder))
+    {
+        std::fclose(file);
+        throw Capture::Exception(filename + " has an unsupported capture file format");
+    }
+    swap_byteorder = (local_byteorder != byteorder);
+}
+
+
+Reader::~Reader() noexcept
+{
+    std::fclose(file);
+}
+
+
+bool Reader::Next(Entry &entry)
+{
+    const int c = std::fgetc(file);
+    if (EOF == c)
+    {
+        if (std::ferror(file))
+        {
+            throw Capture::Exception("Could not read " + filename);
+        }
+        return false;
+    }
+    std::ungetc(c, file);
+
+    timestamp += static_cast<int64_t>(read_uint());
+    entry.timestamp = timestamp;
+    entry.sender = read_string();
+    entry.path = read_string();
+    entry.interface = read_string();
+    entry.member = read_string();
+    const std::string type = read_string();
+    const uint64_t len = read_uint();
+
+    if (type.empty())
+    {
+        if (len > 0)
+        {
+            throw Capture::Exception(filename + ": Invalid record");
+        }
+        entry.params.reset();
+        return true;
+    }
+    if (!g_variant_type_string_is_valid(type.c_str()) || len > max_data_length)
+    {
+        throw Capture::Exception(filename + ": Invalid record");
+    }
+
+    gpointer data = g_malloc(len);
+    if (len > 0 && std::fread(data, 1, len, file) != len)
+    {
+        g_free(data);
+        throw Capture::Exception(filename + ": Truncated record");
+    }
+    glib2::Variant params(g_variant_new_from_data(G_VARIANT_TYPE(type.c_str()),
+                                                  data,
+                                                  len,
+                                                  false,
+                                                  g_free,
+                                                  data));
+    if (swap_byteorder)
+    {
+        GVariant *swapped = g_variant_byteswap(params.get());
+        params = glib2::Variant(swapped);
+    }
+    entry.params = std::move(params);
+    return true;
+}
+
+
+uint64_t Reader::read_uint()
+{
+    uint64_t value = 0;
+    for (unsigned int shift = 0; shift < 64; shift += 7)
+    {
+        const int c = std::fgetc(file);
+        if (EOF == c)
+        {
+            throw Capture::Exception(filename + ": Truncated record");
+        }
+        value |= static_cast<uint64_t>(c & 0x7f) << shift;
+        if (0 == (c & 0x80))
+        {
+            return value;
+        }
+    }
+    throw Capture::Exception(filename + ": Invalid record");
+}
+
+
+std::string Reader::read_string()
+{
+    const uint64_t ref = read_uint();
+    if (ref >= 2)
+    {
+        if (ref - 2 >= strings.size())
+        {
+            throw Capture::Exception(filename + ": Invalid string reference");
+        }
+        return strings[ref - 2];
+    }
+
+    const uint64_t len = read_uint();
+    if (len > max_data_length)
+    {
+        throw Capture::Exception(filename + ": Invalid record");
+    }
+    std::string str(len, '\0');
+    if (len > 0 && std::fread(str.data(), 1, len, file) != len)
+    {
+        throw Capture::Exception(filename + ": Truncated record");
+    }
+    if (1 == ref)
+    {
+        strings.push_back(str);
+    }
+    return str;
+}
+
+} // namespace Capture
+} // namespace Features
+} // namespace DBus
@@ -0,0 +1,179 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+#pragma once
+
+/**
+ * @file features/capture.hpp
+ *
+ * @brief  Declaration of DBus::Features::Capture, recording the D-Bus
+ *         requests received by a service into a compact binary trace
+ *         which can be replayed by the gdbuspp-replay tool
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <glib.h>
+
+#include "../exceptions.hpp"
+#include "../glib2/variant.hpp"
+
+
+/**
+ *  Maximum number of distinct strings kept in the string table of a
+ *  capture file.  Strings seen after the table is full are written out
+ *  in full each time.
+ */
+#define GDBUSPP_CAPTURE_MAX_STRINGS 4096
+
+
+namespace DBus {
+namespace Features {
+
+/**
+ *  The Capture facility records each D-Bus method call and property
+ *  access received by the D-Bus objects of a service, with the time it
+ *  arrived, the sender, the object path, interface, member and the
+ *  serialized arguments.  Property access is recorded as the
+ *  org.freedesktop.DBus.Properties method call it arrived as; a GetAll
+ *  call is a single record.  Each record can be sent again as it is.
+ *
+ *  Capturing is disabled by default; it is started via Capture::Start()
+ *  or by setting the GDBUSPP_CAPTURE environment variable to the file
+ *  name to write to before the program starts.  The environment
+ *  variable is ignored by set-user-ID and set-group-ID programs.  While
+ *  disabled, each capture point costs a single relaxed atomic load.
+ *
+ *  The capture file starts with the "GDBPPCAP" magic, a format version
+ *  byte and the byte order byte of the serialized arguments ('l' or 'B',
+ *  as in D-Bus messages).  Each record then contains, as unsigned
+ *  LEB128 integers:
+ *
+ *    - the time since the previous record (or Start()), in microseconds
+ *    - the sender, object path, interface and member strings
+ *    - the D-Bus data type string of the arguments, empty if none
+ *    - the length of the serialized arguments, followed by the data
+ *
+ *  Each string is written as a reference: 0 for a string following
+ *  inline, 1 for a new string following inline which is added to the
+ *  string table, or 2 and above for string table entry N - 2.
+ */
+namespace Capture {
+
+class Exception : public DBus::Exception
+{
+  public:
+    Exception(const std::string &errm);
+};
+
+
+/**
+ *  Check if requests are being captured
+ *
+ * @return true if enabled
+ */
+bool Enabled() noexcept;
+
+/**
+ *  Start capturing requests into a new file.  The file is created
+ *  with 0600 permissions; an existing file or symbolic link is not
+ *  overwritten.
+ *
+ * @param filename  std::string with the file name to write to
+ *
+ * @throws Capture::Exception if already capturing or if the file
+ *         could not be created
+ */
+void Start(const std::string &filename);
+
+/**
+ *  Stop capturing requests and close the capture file
+ */
+void Stop() noexcept;
+
+/**
+ *  Record a received D-Bus method call.  Nothing is recorded unless
+ *  capturing has been started.  If writing to the capture file fails,
+ *  capturing is stopped.
+ *
+ * @param sender     C string with the unique bus name of the caller,
+ *                   empty for peer-to-peer connections
+ * @param path       C string with the D-Bus object path
+ * @param interface  C string with the D-Bus interface
+ * @param member     C string with the D-Bus method name
+ * @param params     GVariant * with the method arguments, may be nullptr.
+ *                   The reference is not taken over.
+ */
+void Store(const char *sender,
+           const char *path,
+           const char *interface,
+           const char *member,
+           GVariant *params) noexcept;
+
+
+/**
+ *  A single recorded D-Bus method call
+ */
+struct Entry
+{
+    int64_t timestamp = 0; ///< Microseconds since the capture started
+    std::string sender{};
+    std::string path{};
+    std::string interface{};
+    std::string member{};
+    glib2::Variant params{}; ///< Method arguments, may be empty
+};
+
+
+/**
+ *  Reads the records of a capture file, in the order they were recorded
+ */
+class Reader
+{
+  public:
+    /**
+     *  Open a capture file
+     *
+     * @param filename  std::string with the file name to read
+     *
+     * @throws Capture::Exception if the file could not be opened or is
+     *         not a capture file
+     */
+    Reader(const std::string &filename);
+    ~Reader() noexcept;
+
+    Reader(const Reader &) = delete;
+    Reader &operator=(const Reader &) = delete;
+
+    /**
+     *  Read the next record
+     *
+     * @param entry  Entry to fill in with the record
+     *
+     * @return true if a record was read, false at the end of the file
+     *
+     * @throws Capture::Exception if the record is truncated or invalid
+     */
+    bool Next(Entry &entry);
+
+  private:
+    const std::string filename;
+    FILE *file = nullptr;
+    bool swap_byteorder = false;
+    int64_t timestamp = 0;
+    std::vector<std::string> strings{};
+
+    uint64_t read_uint();
+    std::string read_string();
+};
+
+} // namespace Capture
+} // namespace Features
+} // namespace DBus
@@ -11,22 +11,41 @@
 /**
  * @file features/debug-log.hpp
  *
- * @brief  Internal debug logging features.  This requires the
- *         'internal_debug' option to be enabled via meson configure
+ * @brief  Internal debug logging features.  The log messages are recorded
+ *         via the runtime switchable Features::Trace facility.  With the
+ *         'internal_debug' meson option enabled, all the messages are
+ *         written to std::cerr by default as well.
+ *
+ *         A source file may define GDBUSPP_LOG_CATEGORY to one of the
+ *         Features::Trace::Category values before including this file;
+ *         the GENERAL category is used otherwise.
  */
 
-#include "build-config.h"
-
-#ifdef GDBUSPP_INTERNAL_DEBUG
-
-#include <iostream>
-
-#define GDBUSPP_LOG(msg) std::cerr << "[GDBus++ DEBUG (pid:" << getpid() << ") "                     \
-                                   << "{" << __FILE__ << ":" << __LINE__ << " " << __func__ << "}] " \
-                                   << msg << std::endl;
+#include <sstream>
 
-#else
-
-#define GDBUSPP_LOG(msg)
+#include "build-config.h"
+#include "trace.hpp"
 
+#ifndef GDBUSPP_LOG_CATEGORY
+#define GDBUSPP_LOG_CATEGORY GENERAL
 #endif
+
+/**
+ *  Log a debug message.  The msg argument is a std::ostream expression,
+ *  which is only evaluated if debug tracing of the category is enabled.
+ */
+#define GDBUSPP_LOG(msg)                                                                          \
+    do                                                                                            \
+    {                                                                                             \
+        if (DBus::Features::Trace::Enabled(DBus::Features::Trace::Category::GDBUSPP_LOG_CATEGORY, \
+                                           DBus::Features::Trace::Level::DEBUG))                  \
+        {                                                                                         \
+            std::ostringstream gdbuspp_log_msg;                                                   \
+            gdbuspp_log_msg << __func__ << ": " << msg;                                           \
+            DBus::Features::Trace::Message(DBus::Features::Trace::Category::GDBUSPP_LOG_CATEGORY, \
+                                           DBus::Features::Trace::Level::DEBUG,                   \
+                                           __FILE__,                                              \
+                                           __LINE__,                                              \
+                                           gdbuspp_log_msg.str());                                \
+        }                                                                                         \
+    } while (0)
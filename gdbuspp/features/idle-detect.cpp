@@ -12,13 +12,10 @@
  * @brief  Implementation of DBus::Feature::IdleDetect.
  */
 
-#include <ctime>
-
 #include <chrono>
-#include <condition_variable>
 #include <memory>
 #include <mutex>
-#include <thread>
+#include <glib.h>
 
 #include "../mainloop.hpp"
 #include "../object/callbacklink.hpp"
@@ -32,17 +29,14 @@ namespace Features {
 
 IdleDetect::~IdleDetect() noexcept
 {
-    if (worker && worker->joinable())
-    {
-        worker->join();
-        worker.reset();
-    }
+    Stop();
 }
 
 
 void IdleDetect::Start()
 {
-    if (worker)
+    std::lock_guard<std::mutex> lg(timer_mtx);
+    if (timer)
     {
         throw DBus::Exception("IdleDetect", "Idle detector is already running");
     }
@@ -53,83 +47,104 @@ void IdleDetect::Start()
         return;
     }
 
-    worker.reset(new std::thread([this]()
-                                 {
-                                     if (this->__idle_detector_thread())
-                                     {
-                                         try
-                                         {
-                                             this->mainloop->Stop();
-                                         }
-                                         catch (const DBus::MainLoop::Exception &)
-                                         {
-                                         }
-                                     }
-                                 }));
+    arm_timer(std::chrono::duration_cast<std::chrono::milliseconds>(timeout).count());
 }
 
 
 void IdleDetect::Stop()
 {
-    if (running)
+    std::lock_guard<std::mutex> lg(timer_mtx);
+    if (timer)
     {
-        running = false;
-        stop_condvar.notify_all();
-        if (worker && worker->joinable())
-        {
-            worker->join();
-            worker.reset();
-        }
+        g_source_destroy(timer);
+        g_source_unref(timer);
+        timer = nullptr;
     }
 }
 
 void IdleDetect::ActivityUpdate() noexcept
 {
-    last_event = std::chrono::system_clock::now();
+    last_event.store(g_get_monotonic_time(), std::memory_order_relaxed);
 }
 
 
 IdleDetect::IdleDetect(MainLoop::Ptr mainloop_,
                        Object::Manager::Ptr object_mgr_,
-                       std::chrono::duration<uint32_t> timeout_)
-    : mainloop(mainloop_), object_manager(object_mgr_), timeout(timeout_)
+                       std::chrono::duration<uint32_t> timeout_,
+                       const bool wait_requests_)
+    : mainloop(mainloop_), object_manager(object_mgr_), timeout(timeout_),
+      wait_for_requests(wait_requests_)
+{
+}
+
+
+void IdleDetect::arm_timer(const uint32_t delay_ms)
+{
+    if (timer)
+    {
+        g_source_destroy(timer);
+        g_source_unref(timer);
+    }
+
+    // The timer only holds a weak reference, so an IdleDetect object
+    // being released while the timer is pending is safely ignored
+    timer = g_timeout_source_new(delay_ms);
+    g_source_set_callback(timer,
+                          idle_timer_cb,
+                          new std::weak_ptr<IdleDetect>(weak_from_this()),
+                          [](gpointer p)
+                          {
+                              delete static_cast<std::weak_ptr<IdleDetect> *>(p);
+                          });
+    g_source_attach(timer, mainloop->GetContext());
+}
+
+
+bool IdleDetect::idle_check()
 {
+    std::lock_guard<std::mutex> lg(timer_mtx);
+    if (!timer)
+    {
+        // Stopped while this check was pending
+        return false;
+    }
+
+    const int64_t timeout_us = std::chrono::duration_cast<std::chrono::microseconds>(timeout).count();
+    const int64_t idle_us = g_get_monotonic_time() - last_event.load(std::memory_order_relaxed);
+    const auto &pool = object_manager->request_pool;
+    if ((object_manager->idle_active_objects.load() > 0)
+        || (wait_for_requests && pool
+            && (pool->GetInFlight() > 0 || pool->GetQueued() > 0)))
+    {
+        arm_timer(timeout_us / 1000);
+        return false;
+    }
+    if (idle_us < timeout_us)
+    {
+        arm_timer(((timeout_us - idle_us) / 1000) + 1);
+        return false;
+    }
+
+    g_source_unref(timer);
+    timer = nullptr;
+    return true;
 }
 
 
-bool IdleDetect::__idle_detector_thread()
+gboolean IdleDetect::idle_timer_cb(gpointer this_ptr)
 {
-    running = true;
-    while (running)
+    auto self = static_cast<std::weak_ptr<IdleDetect> *>(this_ptr)->lock();
+    if (self && self->idle_check())
     {
-        std::unique_lock<std::mutex> stop_lock(stop_condvar_mtx);
-        stop_condvar.wait_for(stop_lock,
-                              timeout,
-                              [this]()
-                              {
-                                  return !this->running;
-                              });
-
-        if (running && std::chrono::system_clock::now() > (last_event + timeout))
+        try
+        {
+            self->mainloop->Stop();
+        }
+        catch (const DBus::MainLoop::Exception &)
         {
-            uint32_t active = 0;
-            for (const auto &it : object_manager->object_map)
-            {
-                Object::Base::Ptr obj = it.second->object;
-                if (obj->GetIdleDetectorDisabled())
-                {
-                    continue;
-                }
-                ++active;
-            }
-            if (active == 0)
-            {
-                running = false;
-                return true;
-            }
         }
     }
-    return false;
+    return G_SOURCE_REMOVE;
 }
 
 
@@ -14,12 +14,12 @@
  * @brief  Declaration of DBus::Feature::IdleDetect.
  */
 
+#include <atomic>
 #include <chrono>
-#include <condition_variable>
+#include <cstdint>
 #include <memory>
 #include <mutex>
-#include <cstdint>
-#include <thread>
+#include <glib.h>
 
 #include "../mainloop.hpp"
 
@@ -35,11 +35,16 @@ namespace Features {
 /**
  *  An IdleDetect object is given access to the DBus::Object::Manager
  *  and the DBus::MainLoop used by the DBus::Service object.  It will
- *  regularly check if there are any activity happening in the service and
+ *  check if there are any activity happening in the service and
  *  if there are DBus::Object::Base objects present.  If there are no
  *  activity and no active objects in the service, it will trigger a
  *  shutdown of the service.
  *
+ *  The check is driven by a timer source attached to the main loop context;
+ *  no separate thread is used.  The last activity is an atomic timestamp
+ *  and the number of active objects is maintained incrementally by the
+ *  DBus::Object::Manager, so a check never needs to walk the object tree.
+ *
  *  The glib2::Callbacks will also have access to the IdleDetect object
  *  via the DBus::Object::CallbackLink, where it will request an activity update
  *
@@ -53,7 +58,7 @@ namespace Features {
  *  this DBus::Object::Base object is active and valid.  D-Bus activity towards
  *  this object will still be tracked as activity.
  */
-class IdleDetect
+class IdleDetect : public std::enable_shared_from_this<IdleDetect>
 {
   public:
     using Ptr = std::shared_ptr<IdleDetect>;
@@ -67,33 +72,38 @@ class IdleDetect
      *                            time the program is granted.
      * @param object_mgr          DBus::Object::Manager object, with the
      *                            objects to track activity on
+     * @param wait_for_requests   bool flag; if true, queued and in-flight
+     *                            requests in the request pool of the
+     *                            object_mgr is considered as activity
      *
      * @return IdleDetect::Ptr
      */
     [[nodiscard]] static IdleDetect::Ptr Create(MainLoop::Ptr mainloop,
                                                 std::chrono::duration<uint32_t> timeout,
-                                                std::shared_ptr<Object::Manager> object_mgr)
+                                                std::shared_ptr<Object::Manager> object_mgr,
+                                                const bool wait_for_requests = true)
     {
-        return IdleDetect::Ptr(new IdleDetect(mainloop, object_mgr, timeout));
+        return IdleDetect::Ptr(new IdleDetect(mainloop, object_mgr, timeout, wait_for_requests));
     }
 
     ~IdleDetect() noexcept;
 
     /**
-     *  Start a thread running the Idle Detection checker logic
+     *  Start the Idle Detection checker logic
      *
-     *  This internal worker thread will walk through all the registered
-     *  objects in the assigned DBus::Object::Manager, check the "disable idle
-     *  check" flag and see if this service has been idling or is holding data
-     *  it cannot not release.  If no D-Bus objects needing to be preserved
-     *  are in use, no method calls has been performed or no properties been
-     *  accessed within the defined timeout duration, it will trigger a service
-     *  shutdown
+     *  A timer is attached to the main loop context.  When it fires, it
+     *  checks the number of registered objects in the assigned
+     *  DBus::Object::Manager which have not set the "disable idle check" flag
+     *  and the time since the last activity.  If no D-Bus objects needing to
+     *  be preserved are in use, no method calls has been performed or no
+     *  properties been accessed within the defined timeout duration, it will
+     *  trigger a service shutdown.  Otherwise the timer is re-armed for
+     *  the remaining idle time.
      */
     void Start();
 
     /**
-     *  Stops the internal idle detection worker thread
+     *  Stops the idle detection timer
      */
     void Stop();
 
@@ -121,20 +131,18 @@ class IdleDetect
     /// The configured idle timeout
     const std::chrono::duration<uint32_t> timeout;
 
-    /// Is the idle detector running?
-    bool running = false;
+    /// Keep running while the request pool has pending requests
+    const bool wait_for_requests;
 
-    /// Timestamp of the last time there was some D-Bus activity
-    ///  in the service
-    std::chrono::time_point<std::chrono::system_clock> last_event{};
+    /// Monotonic timestamp (g_get_monotonic_time(), in microseconds)
+    /// of the last time there was some D-Bus activity in the service
+    std::atomic<int64_t> last_event{0};
 
-    /// Condition variable mutex, used to exit the waiting loop if the
-    /// service is shut down manually
-    std::mutex stop_condvar_mtx{};
-    std::condition_variable stop_condvar{};
+    /// Mutex protecting the timer source
+    std::mutex timer_mtx{};
 
-    /// The worker thread running the idle detector logic
-    std::unique_ptr<std::thread> worker{nullptr};
+    /// The currently armed timer source; nullptr when not running
+    GSource *timer{nullptr};
 
     /**
      *  Construct a new IdleDetect object
@@ -143,19 +151,31 @@ class IdleDetect
      * @param object_mgr   DBus::Object::Manager::Ptr holding the D-Bus
      *                     objects of the service
      * @param timeout      std::chrono::duration of the idle timeout threshold
+     * @param wait_requests  bool flag, consider pending requests as activity
      */
     IdleDetect(MainLoop::Ptr mainloop,
                std::shared_ptr<Object::Manager> object_mgr,
-               std::chrono::duration<uint32_t> timeout);
+               std::chrono::duration<uint32_t> timeout,
+               const bool wait_requests);
 
+    /**
+     *  Arm a new timer source on the main loop context, replacing the
+     *  current one.  The timer_mtx must be held by the caller.
+     *
+     * @param delay_ms  Milliseconds until the next idle check
+     */
+    void arm_timer(const uint32_t delay_ms);
 
     /**
-     *  The worker thread running in parallel to detect if the service is
-     *  running idle or not.
+     *  Timer callback checking if the service is running idle.  If not,
+     *  the timer is re-armed for the remaining time.
      *
      * @return Returns true if the service should be shut down; otherwise false
      */
-    bool __idle_detector_thread();
+    bool idle_check();
+
+    /// glib2 timer callback, calling idle_check()
+    static gboolean idle_timer_cb(gpointer this_ptr);
 };
 
 
@@ -0,0 +1,56 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file features/metrics-object.cpp
+ *
+ * @brief  Implementation of DBus::Features::MetricsObject
+ */
+
+#include <utility>
+#include <glib.h>
+
+#include "../object/method.hpp"
+#include "metrics.hpp"
+#include "metrics-object.hpp"
+
+
+namespace DBus {
+namespace Features {
+
+MetricsObject::MetricsObject(AuthorizeFnc authorize, const Object::Path &path)
+    : Object::Base(path, "net.openvpn.gdbuspp.Metrics"),
+      authorize_fn(std::move(authorize))
+{
+    // Scraping the metrics must not keep an idle service running
+    DisableIdleDetector(true);
+
+    auto prom = AddMethod("GetPrometheus",
+                          [](Object::Method::Arguments::Ptr args)
+                          {
+                              const std::string text = Metrics::FormatPrometheus(Metrics::GetSnapshot());
+                              args->SetMethodReturn(g_variant_new("(s)", text.c_str()));
+                          });
+    prom->AddOutput("metrics", "s");
+
+    AddMethod("Reset",
+              [](Object::Method::Arguments::Ptr args)
+              {
+                  Metrics::Reset();
+                  args->SetMethodReturn(nullptr);
+              });
+}
+
+
+const bool MetricsObject::Authorize(const Authz::Request::Ptr request)
+{
+    return (authorize_fn ? authorize_fn(request) : false);
+}
+
+} // namespace Features
+} // namespace DBus
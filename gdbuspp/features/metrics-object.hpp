@@ -0,0 +1,70 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+#pragma once
+
+/**
+ * @file features/metrics-object.hpp
+ *
+ * @brief  Declaration of DBus::Features::MetricsObject, exposing the
+ *         Features::Metrics via D-Bus
+ */
+
+#include <functional>
+#include <string>
+
+#include "../object/base.hpp"
+
+
+namespace DBus {
+namespace Features {
+
+/**
+ *  D-Bus object providing the collected Features::Metrics to metrics
+ *  exporters.  It is added to a service like any other object:
+ *
+ *     object_manager->CreateObject<DBus::Features::MetricsObject>(
+ *         [](const Authz::Request::Ptr req)
+ *         {
+ *             return req->caller == exporter_busname;
+ *         });
+ *
+ *  Interface net.openvpn.gdbuspp.Metrics:
+ *
+ *    - GetPrometheus() -> (s)   All metrics in the Prometheus text format
+ *    - Reset()                  Reset the method histograms
+ *
+ *  The object paths and method names of the service are revealed by the
+ *  metrics, so all requests are denied unless the authorization callback
+ *  grants them.  Creating this object does not enable collecting the
+ *  metrics; that is done via Metrics::Enable() or the GDBUSPP_METRICS
+ *  environment variable.
+ */
+class MetricsObject : public Object::Base
+{
+  public:
+    using AuthorizeFnc = std::function<bool(const Authz::Request::Ptr)>;
+
+    /**
+     *  Create the metrics object
+     *
+     * @param authorize  AuthorizeFnc deciding if a request is granted.
+     *                   If not set, all requests are denied.
+     * @param path       DBus::Object::Path of the object
+     */
+    MetricsObject(AuthorizeFnc authorize,
+                  const Object::Path &path = "/net/openvpn/gdbuspp/Metrics");
+
+    const bool Authorize(const Authz::Request::Ptr request) override;
+
+  private:
+    const AuthorizeFnc authorize_fn;
+};
+
+} // namespace Features
+} // namespace DBus
@@ -0,0 +1,330 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file features/metrics.cpp
+ *
+ * @brief  Implementation of DBus::Features::Metrics
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "metrics.hpp"
+
+
+namespace DBus {
+namespace Features {
+namespace Metrics {
+
+namespace {
+
+static std::atomic<bool> enabled{false};
+
+/// Key of the method statistics; path, interface, method
+using MethodKey = std::tuple<std::string, std::string, std::string>;
+
+/**
+ *  All the collected method statistics and registered gauges
+ */
+struct Registry
+{
+    std::shared_mutex mtx{};
+    std::map<MethodKey, MethodStats::Ptr> methods{};
+    std::vector<Gauge *> gauges{};
+};
+
+static Registry &registry()
+{
+    static Registry reg;
+    return reg;
+}
+
+
+/**
+ *  Enables the metrics via the GDBUSPP_METRICS environment variable
+ *  when the library is loaded
+ */
+static struct InitialConfig
+{
+    InitialConfig()
+    {
+        const char *env = std::getenv("GDBUSPP_METRICS");
+        if (env && std::string(env) == "1")
+        {
+            Enable(true);
+        }
+    }
+} initial_config;
+
+
+static void format_histogram(std::ostringstream &r,
+                             const std::string &name,
+                             const std::string &labels,
+                             const Histogram::Snapshot &h)
+{
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < GDBUSPP_METRICS_BUCKETS; ++i)
+    {
+        cumulative += h.buckets[i];
+        const uint64_t bound = Histogram::UpperBound(i);
+        r << name << "_bucket{" << labels << ",le=\"";
+        if (bound > 0)
+        {
+            r << static_cast<double>(bound) / 1000000.0;
+        }
+        else
+        {
+            r << "+Inf";
+        }
+        r << "\"} " << cumulative << "\n";
+    }
+    r << name << "_sum{" << labels << "} "
+      << static_cast<double>(h.sum_usec) / 1000000.0 << "\n";
+    r << name << "_count{" << labels << "} " << h.count << "\n";
+}
+
+} // anonymous namespace
+
+
+
+bool Enabled() noexcept
+{
+    return enabled.load(std::memory_order_relaxed);
+}
+
+
+void Enable(const bool enable) noexcept
+{
+    enabled.store(enable, std::memory_order_relaxed);
+}
+
+
+
+//
+//  Metrics::Histogram
+//
+
+void Histogram::Record(const int64_t usec) noexcept
+{
+    const uint64_t v = (usec > 0 ? static_cast<uint64_t>(usec) : 0);
+    size_t bucket = 0;
+    while (bucket < GDBUSPP_METRICS_BUCKETS - 1 && v >= UpperBound(bucket))
+    {
+        ++bucket;
+    }
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    sum_usec.fetch_add(v, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+Histogram::Snapshot Histogram::GetSnapshot() const noexcept
+{
+    Snapshot s;
+    s.count = count.load(std::memory_order_relaxed);
+    s.sum_usec = sum_usec.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < GDBUSPP_METRICS_BUCKETS; ++i)
+    {
+        s.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+    }
+    return s;
+}
+
+
+void Histogram::Reset() noexcept
+{
+    count = 0;
+    sum_usec = 0;
+    for (auto &b : buckets)
+    {
+        b = 0;
+    }
+}
+
+
+uint64_t Histogram::UpperBound(const size_t bucket) noexcept
+{
+    return (bucket < GDBUSPP_METRICS_BUCKETS - 1 ? (uint64_t(1) << bucket) : 0);
+}
+
+
+
+MethodStats::Ptr GetMethodStats(const std::string &path,
+                                const std::string &interface,
+                                const std::string &method)
+{
+    Registry &reg = registry();
+    MethodKey key{path, interface, method};
+    {
+        std::shared_lock<std::shared_mutex> lg(reg.mtx);
+        auto it = reg.methods.find(key);
+        if (reg.methods.end() != it)
+        {
+            return it->second;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lg(reg.mtx);
+    auto it = reg.methods.find(key);
+    if (reg.methods.end() == it)
+    {
+        if (reg.methods.size() >= GDBUSPP_METRICS_MAX_METHODS)
+        {
+            key = MethodKey{"", "", ""};
+        }
+        it = reg.methods.try_emplace(key, std::make_shared<MethodStats>()).first;
+    }
+    return it->second;
+}
+
+
+
+//
+//  Metrics::Gauge
+//
+
+Gauge::Ptr Gauge::Create(const std::string &name,
+                         const std::string &labels,
+                         ValueFnc fnc)
+{
+    auto gauge = Gauge::Ptr(new Gauge(name, labels, std::move(fnc)));
+    Registry &reg = registry();
+    std::unique_lock<std::shared_mutex> lg(reg.mtx);
+    reg.gauges.push_back(gauge.get());
+    return gauge;
+}
+
+
+Gauge::Gauge(const std::string &name_, const std::string &labels_, ValueFnc fnc)
+    : name(name_), labels(labels_), value(std::move(fnc))
+{
+}
+
+
+Gauge::~Gauge() noexcept
+{
+    Registry &reg = registry();
+    std::unique_lock<std::shared_mutex> lg(reg.mtx);
+    reg.gauges.erase(std::remove(reg.gauges.begin(), reg.gauges.end(), this),
+                     reg.gauges.end());
+}
+
+
+
+Snapshot GetSnapshot()
+{
+    Registry &reg = registry();
+    std::shared_lock<std::shared_mutex> lg(reg.mtx);
+
+    Snapshot snap;
+    snap.methods.reserve(reg.methods.size());
+    for (const auto &[key, stats] : reg.methods)
+    {
+        Snapshot::Method m;
+        std::tie(m.path, m.interface, m.method) = key;
+        m.queue_wait = stats->queue_wait.GetSnapshot();
+        m.authorization = stats->authorization.GetSnapshot();
+        m.execution = stats->execution.GetSnapshot();
+        m.errors = stats->errors.load(std::memory_order_relaxed);
+        snap.methods.push_back(std::move(m));
+    }
+    for (const auto &g : reg.gauges)
+    {
+        snap.gauges.push_back({g->name, g->labels, g->value()});
+    }
+    std::stable_sort(snap.gauges.begin(),
+                     snap.gauges.end(),
+                     [](const Snapshot::GaugeValue &a, const Snapshot::GaugeValue &b)
+                     {
+                         return a.name < b.name;
+                     });
+    return snap;
+}
+
+
+void Reset() noexcept
+{
+    // Requests in progress keep their MethodStats object; their
+    // samples are dropped with it
+    Registry &reg = registry();
+    std::unique_lock<std::shared_mutex> lg(reg.mtx);
+    reg.methods.clear();
+}
+
+
+std::string FormatPrometheus(const Snapshot &snapshot)
+{
+    static const struct
+    {
+        const char *name;
+        const char *help;
+        Histogram::Snapshot Snapshot::Method::*hist;
+    } histograms[] = {
+        {"gdbuspp_method_queue_wait_seconds",
+         "Time D-Bus method calls waited for a request pool thread",
+         &Snapshot::Method::queue_wait},
+        {"gdbuspp_method_authorization_seconds",
+         "Time spent authorizing D-Bus method calls",
+         &Snapshot::Method::authorization},
+        {"gdbuspp_method_execution_seconds",
+         "Time spent in D-Bus method callback functions",
+         &Snapshot::Method::execution},
+    };
+
+    std::ostringstream r;
+    for (const auto &h : histograms)
+    {
+        r << "# HELP " << h.name << " " << h.help << "\n"
+          << "# TYPE " << h.name << " histogram\n";
+        for (const auto &m : snapshot.methods)
+        {
+            const std::string labels = "path=\"" + m.path + "\","
+                                       + "interface=\"" + m.interface + "\","
+                                       + "method=\"" + m.method + "\"";
+            format_histogram(r, h.name, labels, m.*(h.hist));
+        }
+    }
+
+    r << "# HELP gdbuspp_method_errors_total D-Bus method callbacks failing\n"
+      << "# TYPE gdbuspp_method_errors_total counter\n";
+    for (const auto &m : snapshot.methods)
+    {
+        r << "gdbuspp_method_errors_total{path=\"" << m.path << "\","
+          << "interface=\"" << m.interface << "\","
+          << "method=\"" << m.method << "\"} " << m.errors << "\n";
+    }
+
+    std::string last_gauge{};
+    for (const auto &g : snapshot.gauges)
+    {
+        if (g.name != last_gauge)
+        {
+            r << "# TYPE " << g.name << " gauge\n";
+            last_gauge = g.name;
+        }
+        r << g.name;
+        if (!g.labels.empty())
+        {
+            r << "{" << g.labels << "}";
+        }
+        r << " " << g.value << "\n";
+    }
+    return r.str();
+}
+
+} // namespace Metrics
+} // namespace Features
+} // namespace DBus
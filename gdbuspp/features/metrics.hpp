@@ -0,0 +1,247 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+#pragma once
+
+/**
+ * @file features/metrics.hpp
+ *
+ * @brief  Declaration of DBus::Features::Metrics, latency histograms and
+ *         gauges of a GDBus++ service
+ */
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+/**
+ *  Number of histogram buckets.  Bucket N counts durations below 2^N
+ *  microseconds, the last bucket counts everything above.
+ */
+#define GDBUSPP_METRICS_BUCKETS 26
+
+/**
+ *  Maximum number of D-Bus methods tracked individually.  Services
+ *  creating objects with unique object paths would otherwise grow the
+ *  metrics without bounds.  Methods seen after the limit is reached are
+ *  collected into a single entry with empty path, interface and method.
+ */
+#define GDBUSPP_METRICS_MAX_METHODS 1024
+
+
+namespace DBus {
+namespace Features {
+
+/**
+ *  The Metrics facility collects per-method latency histograms of the
+ *  D-Bus method calls processed by a service and gauges of the request
+ *  pool.  Three durations are recorded for each method:
+ *
+ *    - queue wait:     from receiving the call until a request pool
+ *                      thread starts processing it
+ *    - authorization:  time spent in Object::Base::Authorize()
+ *    - execution:      time spent in the method callback function
+ *
+ *  Collecting metrics is disabled by default; it is enabled via
+ *  Metrics::Enable() or by setting the GDBUSPP_METRICS environment
+ *  variable to 1 before the program starts.  While disabled, each
+ *  measuring point costs a single relaxed atomic load.
+ */
+namespace Metrics {
+
+/**
+ *  Check if metrics are being collected
+ *
+ * @return true if enabled
+ */
+bool Enabled() noexcept;
+
+/**
+ *  Enable or disable collecting metrics
+ *
+ * @param enable  bool flag
+ */
+void Enable(const bool enable) noexcept;
+
+
+/**
+ *  Lock-free histogram of durations, with exponentially sized buckets
+ */
+class Histogram
+{
+  public:
+    /**
+     *  A copy of the histogram counters
+     */
+    struct Snapshot
+    {
+        uint64_t count = 0;                                ///< Number of samples
+        uint64_t sum_usec = 0;                             ///< Sum of all samples
+        std::array<uint64_t, GDBUSPP_METRICS_BUCKETS> buckets{}; ///< Per bucket counts
+    };
+
+    /**
+     *  Record a new sample
+     *
+     * @param usec  Duration in microseconds
+     */
+    void Record(const int64_t usec) noexcept;
+
+    /**
+     *  Copy the current counters
+     *
+     * @return Histogram::Snapshot
+     */
+    Snapshot GetSnapshot() const noexcept;
+
+    /**
+     *  Reset all the counters to 0
+     */
+    void Reset() noexcept;
+
+    /**
+     *  Retrieve the upper bound of a bucket
+     *
+     * @param bucket  Bucket index
+     *
+     * @return Upper bound in microseconds; 0 for the last, open ended bucket
+     */
+    static uint64_t UpperBound(const size_t bucket) noexcept;
+
+  private:
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum_usec{0};
+    std::array<std::atomic<uint64_t>, GDBUSPP_METRICS_BUCKETS> buckets{};
+};
+
+
+/**
+ *  The metrics collected for a single D-Bus method of an object
+ */
+struct MethodStats
+{
+    using Ptr = std::shared_ptr<MethodStats>;
+
+    Histogram queue_wait{};          ///< Waiting for a request pool thread
+    Histogram authorization{};       ///< Object::Base::Authorize()
+    Histogram execution{};           ///< The method callback function
+    std::atomic<uint64_t> errors{0}; ///< Method callbacks throwing exceptions
+};
+
+
+/**
+ *  Retrieve the MethodStats of a D-Bus method, creating it if needed.
+ *  When GDBUSPP_METRICS_MAX_METHODS methods are tracked already, the
+ *  shared entry for all the other methods is returned instead.
+ *
+ * @param path       std::string with the D-Bus object path
+ * @param interface  std::string with the D-Bus interface
+ * @param method     std::string with the D-Bus method name
+ *
+ * @return MethodStats::Ptr
+ */
+MethodStats::Ptr GetMethodStats(const std::string &path,
+                                const std::string &interface,
+                                const std::string &method);
+
+
+/**
+ *  A gauge reports a value retrieved when a snapshot is taken.  The gauge
+ *  is included in the snapshots as long as the Gauge object exists.
+ */
+class Gauge
+{
+  public:
+    using Ptr = std::shared_ptr<Gauge>;
+    using ValueFnc = std::function<double()>;
+
+    /**
+     *  Register a new gauge
+     *
+     * @param name    std::string with the metric name
+     * @param labels  std::string with the labels, in the Prometheus
+     *                name="value",... format without the braces.  May be empty
+     * @param fnc     ValueFnc returning the current value
+     *
+     * @return Gauge::Ptr
+     */
+    [[nodiscard]] static Gauge::Ptr Create(const std::string &name,
+                                           const std::string &labels,
+                                           ValueFnc fnc);
+
+    ~Gauge() noexcept;
+
+    const std::string name;   ///< Metric name
+    const std::string labels; ///< Metric labels
+    const ValueFnc value;     ///< Value retrieval function
+
+  private:
+    Gauge(const std::string &name, const std::string &labels, ValueFnc fnc);
+};
+
+
+/**
+ *  A copy of all the collected metrics
+ */
+struct Snapshot
+{
+    /// The metrics of a single D-Bus method
+    struct Method
+    {
+        std::string path;
+        std::string interface;
+        std::string method;
+        Histogram::Snapshot queue_wait;
+        Histogram::Snapshot authorization;
+        Histogram::Snapshot execution;
+        uint64_t errors = 0;
+    };
+
+    /// The current value of a gauge
+    struct GaugeValue
+    {
+        std::string name;
+        std::string labels;
+        double value = 0;
+    };
+
+    std::vector<Method> methods{};
+    std::vector<GaugeValue> gauges{};
+};
+
+
+/**
+ *  Take a snapshot of all the collected metrics
+ *
+ * @return Metrics::Snapshot
+ */
+Snapshot GetSnapshot();
+
+/**
+ *  Reset all the method histograms and error counters.  The methods
+ *  tracked so far are removed and tracked again when they are called.
+ */
+void Reset() noexcept;
+
+/**
+ *  Format a snapshot using the Prometheus text exposition format
+ *
+ * @param snapshot  Metrics::Snapshot to format
+ *
+ * @return std::string
+ */
+std::string FormatPrometheus(const Snapshot &snapshot);
+
+} // namespace Metrics
+} // namespace Features
+} // namespace DBus
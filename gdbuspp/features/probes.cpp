@@ -0,0 +1,27 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file features/probes.cpp
+ *
+ * @brief  Definition of the semaphores used by the SDT probes
+ */
+
+#include "probes.hpp"
+
+#ifdef GDBUSPP_SDT_PROBES
+
+// The tracers locate the semaphores via the .probes section
+#define GDBUSPP_PROBE_DEFINE(name) \
+    unsigned short gdbuspp_##name##_semaphore __attribute__((section(".probes"))) = 0;
+extern "C" {
+GDBUSPP_PROBE_LIST(GDBUSPP_PROBE_DEFINE)
+}
+#undef GDBUSPP_PROBE_DEFINE
+
+#endif
@@ -0,0 +1,70 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+#pragma once
+
+/**
+ * @file features/probes.hpp
+ *
+ * @brief  Static (USDT/SDT) probe points, usable with bpftrace, perf and
+ *         SystemTap.  This requires the 'sdt_probes' option to be enabled
+ *         via meson configure; otherwise the probes compile to nothing.
+ *
+ *         All the probes belong to the "gdbuspp" provider:
+ *
+ *           request_queued(path, interface, member, sequence)
+ *           request_dequeued(path, interface, member, queue_wait_usec)
+ *           request_completed(path, interface, member, exec_usec)
+ *           authorization(path, interface, member, allowed, usec)
+ *           proxy_call_begin(path, interface, member, destination)
+ *           proxy_call_end(path, interface, member, usec, failed)
+ *           signal_emit(path, interface, member, destination)
+ *           signal_dispatch(path, interface, member, sender)
+ *
+ *         Each probe has a semaphore, which the tracer increments while
+ *         the probe is attached.  GDBUSPP_PROBE_ENABLED() checks it, to
+ *         skip collecting timestamps and arguments when nobody listens.
+ */
+
+#include "build-config.h"
+
+#ifdef GDBUSPP_SDT_PROBES
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+/// List of all the probes, used to declare and define the semaphores
+#define GDBUSPP_PROBE_LIST(X) \
+    X(request_queued)         \
+    X(request_dequeued)       \
+    X(request_completed)      \
+    X(authorization)          \
+    X(proxy_call_begin)       \
+    X(proxy_call_end)         \
+    X(signal_emit)            \
+    X(signal_dispatch)
+
+#define GDBUSPP_PROBE_DECLARE(name) extern "C" unsigned short gdbuspp_##name##_semaphore;
+GDBUSPP_PROBE_LIST(GDBUSPP_PROBE_DECLARE)
+#undef GDBUSPP_PROBE_DECLARE
+
+/// Is a tracer attached to the probe?
+#define GDBUSPP_PROBE_ENABLED(name) __builtin_expect(gdbuspp_##name##_semaphore != 0, 0)
+
+/// Fire a probe.  The arguments must be integers or pointers
+#define GDBUSPP_PROBE(name, ...) STAP_PROBEV(gdbuspp, name, __VA_ARGS__)
+
+#else
+
+#define GDBUSPP_PROBE_ENABLED(name) false
+#define GDBUSPP_PROBE(name, ...) \
+    do                           \
+    {                            \
+    } while (0)
+
+#endif
@@ -0,0 +1,435 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file features/trace.cpp
+ *
+ * @brief  Implementation of DBus::Features::Trace
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <glib.h>
+
+#include "build-config.h"
+#include "trace.hpp"
+
+
+namespace DBus {
+namespace Features {
+namespace Trace {
+
+std::atomic<uint8_t> levels[static_cast<size_t>(Category::_COUNT)] = {};
+
+
+namespace {
+
+static const char *category_names[] = {
+    "general", "callbacks", "requests", "objects", "proxy", "signals"};
+
+static const char *level_names[] = {"off", "error", "info", "debug"};
+
+static std::atomic<bool> echo{false};
+static std::atomic<int64_t> cleared_at{0};
+
+
+/**
+ *  A single trace record.  The seq counter is odd while the owning thread
+ *  is writing the record, which allows readers on other threads to detect
+ *  a torn copy without taking any locks.
+ */
+struct Slot
+{
+    std::atomic<uint32_t> seq{0};
+    int64_t timestamp = 0;
+    Category category = Category::GENERAL;
+    Level level = Level::OFF;
+    const char *file = nullptr;
+    unsigned int line = 0;
+    const char *fmt = nullptr; ///< Deferred formatting template, or nullptr
+    uint64_t args[2] = {0, 0};
+    size_t len = 0;
+    char text[GDBUSPP_TRACE_MSG_LEN] = {}; ///< Used when fmt is nullptr
+};
+
+
+/**
+ *  Ring buffer written only by its owning thread
+ */
+struct Ring
+{
+    unsigned int id = 0;
+    std::atomic<uint64_t> head{0};
+    Slot slots[GDBUSPP_TRACE_RING_SIZE];
+};
+
+
+/// A copy of a Slot, used while formatting
+struct Snapshot
+{
+    unsigned int ring = 0;
+    int64_t timestamp = 0;
+    Category category = Category::GENERAL;
+    Level level = Level::OFF;
+    const char *file = nullptr;
+    unsigned int line = 0;
+    const char *fmt = nullptr;
+    uint64_t args[2] = {0, 0};
+    std::string text{};
+};
+
+
+/**
+ *  All the ring buffers created.  When a thread exits, its ring is kept
+ *  so its records remain available to Dump(), and it is handed over to
+ *  the next thread needing a ring.  The number of rings is thus bounded
+ *  by the number of threads recording at the same time, also in programs
+ *  starting and stopping threads continuously.
+ */
+struct Registry
+{
+    std::mutex mtx{};
+    std::vector<std::shared_ptr<Ring>> rings{};
+    std::vector<std::shared_ptr<Ring>> unused{};
+};
+
+static Registry &registry()
+{
+    static Registry reg;
+    return reg;
+}
+
+
+/**
+ *  The ring used by a thread; returned to the Registry when the
+ *  thread exits
+ */
+struct LocalRing
+{
+    std::shared_ptr<Ring> ring{};
+
+    LocalRing()
+    {
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> lg(reg.mtx);
+        if (!reg.unused.empty())
+        {
+            ring = reg.unused.back();
+            reg.unused.pop_back();
+            return;
+        }
+        ring = std::make_shared<Ring>();
+        ring->id = static_cast<unsigned int>(reg.rings.size());
+        reg.rings.push_back(ring);
+    }
+
+    ~LocalRing()
+    {
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> lg(reg.mtx);
+        reg.unused.push_back(ring);
+    }
+};
+
+
+static Ring &local_ring()
+{
+    thread_local LocalRing local;
+    return *local.ring;
+}
+
+
+static std::string format(const Snapshot &s)
+{
+    std::ostringstream r;
+    r << "[GDBus++ " << level_names[static_cast<size_t>(s.level)]
+      << " (pid:" << getpid() << ", ring:" << s.ring << ") "
+      << s.timestamp / 1000000 << "."
+      << std::to_string(1000000 + (s.timestamp % 1000000)).substr(1) << " "
+      << category_names[static_cast<size_t>(s.category)]
+      << " {" << s.file << ":" << s.line << "}] ";
+    if (!s.fmt)
+    {
+        r << s.text;
+        return r.str();
+    }
+
+    size_t argidx = 0;
+    for (const char *p = s.fmt; *p; ++p)
+    {
+        if ('{' == p[0] && '}' == p[1] && argidx < 2)
+        {
+            r << s.args[argidx++];
+            ++p;
+            continue;
+        }
+        r << *p;
+    }
+    return r.str();
+}
+
+
+static void write_record(const Category cat,
+                         const Level level,
+                         const char *file,
+                         const unsigned int line,
+                         const char *fmt,
+                         const uint64_t a0,
+                         const uint64_t a1,
+                         const std::string *msg) noexcept
+{
+    Ring &ring = local_ring();
+    const uint64_t idx = ring.head.load(std::memory_order_relaxed);
+    Slot &slot = ring.slots[idx % GDBUSPP_TRACE_RING_SIZE];
+
+    const uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+    slot.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.timestamp = g_get_monotonic_time();
+    slot.category = cat;
+    slot.level = level;
+    slot.file = file;
+    slot.line = line;
+    slot.fmt = fmt;
+    slot.args[0] = a0;
+    slot.args[1] = a1;
+    slot.len = 0;
+    if (msg)
+    {
+        slot.len = std::min(msg->size(), sizeof(slot.text));
+        std::memcpy(slot.text, msg->data(), slot.len);
+    }
+
+    slot.seq.store(seq + 2, std::memory_order_release);
+    ring.head.store(idx + 1, std::memory_order_release);
+
+    if (echo.load(std::memory_order_relaxed))
+    {
+        Snapshot s;
+        s.ring = ring.id;
+        s.timestamp = slot.timestamp;
+        s.category = cat;
+        s.level = level;
+        s.file = file;
+        s.line = line;
+        s.fmt = fmt;
+        s.args[0] = a0;
+        s.args[1] = a1;
+        if (msg)
+        {
+            s.text = *msg;
+        }
+        std::cerr << format(s) << std::endl;
+    }
+}
+
+
+/**
+ *  Configures the tracing from the build configuration and the
+ *  GDBUSPP_TRACE environment variable when the library is loaded
+ */
+static struct InitialConfig
+{
+    InitialConfig()
+    {
+#ifdef GDBUSPP_INTERNAL_DEBUG
+        SetLevel(Level::DEBUG);
+        SetEcho(true);
+#endif
+        const char *env = std::getenv("GDBUSPP_TRACE");
+        if (env)
+        {
+            Configure(env);
+        }
+    }
+} initial_config;
+
+} // anonymous namespace
+
+
+
+void SetLevel(const Category cat, const Level level) noexcept
+{
+    if (cat < Category::_COUNT)
+    {
+        levels[static_cast<size_t>(cat)].store(static_cast<uint8_t>(level),
+                                               std::memory_order_relaxed);
+    }
+}
+
+
+void SetLevel(const Level level) noexcept
+{
+    for (auto &l : levels)
+    {
+        l.store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+    }
+}
+
+
+void Configure(const std::string &spec) noexcept
+{
+    std::istringstream s(spec);
+    std::string item;
+    while (std::getline(s, item, ','))
+    {
+        if ("stderr" == item)
+        {
+            SetEcho(true);
+            continue;
+        }
+        const auto sep = item.find(':');
+        if (std::string::npos == sep)
+        {
+            continue;
+        }
+        const std::string cat = item.substr(0, sep);
+        const std::string lvl = item.substr(sep + 1);
+
+        const auto l = std::find(std::begin(level_names), std::end(level_names), lvl);
+        if (std::end(level_names) == l)
+        {
+            continue;
+        }
+        const Level level = static_cast<Level>(l - std::begin(level_names));
+        if ("all" == cat)
+        {
+            SetLevel(level);
+            continue;
+        }
+        const auto c = std::find(std::begin(category_names), std::end(category_names), cat);
+        if (std::end(category_names) != c)
+        {
+            SetLevel(static_cast<Category>(c - std::begin(category_names)), level);
+        }
+    }
+}
+
+
+void SetEcho(const bool enable) noexcept
+{
+    echo.store(enable, std::memory_order_relaxed);
+}
+
+
+void Event(const Category cat,
+           const Level level,
+           const char *file,
+           const unsigned int line,
+           const char *fmt,
+           const uint64_t a0,
+           const uint64_t a1) noexcept
+{
+    write_record(cat, level, file, line, fmt, a0, a1, nullptr);
+}
+
+
+void Message(const Category cat,
+             const Level level,
+             const char *file,
+             const unsigned int line,
+             const std::string &msg) noexcept
+{
+    write_record(cat, level, file, line, nullptr, 0, 0, &msg);
+}
+
+
+void Dump(std::ostream &os)
+{
+    std::vector<std::shared_ptr<Ring>> rings;
+    {
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> lg(reg.mtx);
+        rings = reg.rings;
+    }
+
+    const int64_t since = cleared_at.load(std::memory_order_relaxed);
+    std::vector<Snapshot> records;
+    for (const auto &ring : rings)
+    {
+        const uint64_t head = ring->head.load(std::memory_order_acquire);
+        const uint64_t start = (head > GDBUSPP_TRACE_RING_SIZE
+                                    ? head - GDBUSPP_TRACE_RING_SIZE
+                                    : 0);
+        for (uint64_t i = start; i < head; ++i)
+        {
+            const Slot &slot = ring->slots[i % GDBUSPP_TRACE_RING_SIZE];
+            const uint32_t seq = slot.seq.load(std::memory_order_acquire);
+            if (seq & 1)
+            {
+                // Being written
+                continue;
+            }
+
+            Snapshot s;
+            s.ring = ring->id;
+            s.timestamp = slot.timestamp;
+            s.category = slot.category;
+            s.level = slot.level;
+            s.file = slot.file;
+            s.line = slot.line;
+            s.fmt = slot.fmt;
+            s.args[0] = slot.args[0];
+            s.args[1] = slot.args[1];
+            s.text.assign(slot.text, std::min(slot.len, sizeof(slot.text)));
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) != seq
+                || s.timestamp < since)
+            {
+                // Overwritten while copying, or discarded by Clear()
+                continue;
+            }
+            records.push_back(std::move(s));
+        }
+    }
+
+    std::stable_sort(records.begin(),
+                     records.end(),
+                     [](const Snapshot &a, const Snapshot &b)
+                     {
+                         return a.timestamp < b.timestamp;
+                     });
+    for (const auto &s : records)
+    {
+        os << format(s) << std::endl;
+    }
+}
+
+
+void Clear() noexcept
+{
+    cleared_at.store(g_get_monotonic_time() + 1, std::memory_order_relaxed);
+}
+
+
+std::string VariantString(GVariant *value, const bool annotate)
+{
+    if (!value)
+    {
+        return "(none)";
+    }
+    gchar *str = g_variant_print(value, annotate);
+    std::string ret(str ? str : "");
+    g_free(str);
+    return ret;
+}
+
+} // namespace Trace
+} // namespace Features
+} // namespace DBus
@@ -0,0 +1,229 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+#pragma once
+
+/**
+ * @file features/trace.hpp
+ *
+ * @brief  Runtime switchable tracing of the GDBus++ internals, recording
+ *         into per-thread ring buffers.
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <glib.h>
+
+
+/**
+ *  Number of records kept in the ring buffer of each thread.  When full,
+ *  the oldest records are overwritten.
+ */
+#define GDBUSPP_TRACE_RING_SIZE 1024
+
+/**
+ *  Maximum length of an (eagerly) formatted trace message.
+ *  Longer messages are truncated.
+ */
+#define GDBUSPP_TRACE_MSG_LEN 160
+
+
+namespace DBus {
+namespace Features {
+
+/**
+ *  The Trace facility records events happening inside GDBus++ into a
+ *  lock-free ring buffer owned by each thread, which can be retrieved
+ *  via Trace::Dump().  Tracing is disabled by default and can be enabled
+ *  per category at runtime, either via Trace::SetLevel() or by setting the
+ *  GDBUSPP_TRACE environment variable before the program starts.
+ *
+ *  The GDBUSPP_TRACE value is a comma separated list of category:level
+ *  pairs, where "all" can be used as the category.  The "stderr" token
+ *  writes the records to std::cerr as well.  Example:
+ *
+ *     GDBUSPP_TRACE=callbacks:debug,proxy:info,stderr
+ *
+ *  When tracing is disabled, a trace point costs a single relaxed
+ *  atomic load and branch.  A thread only gets a ring buffer once it
+ *  records its first event.  The ring buffer of an exited thread is
+ *  reused by the next thread starting to record, so the records of
+ *  exited threads are kept until they are overwritten.
+ */
+namespace Trace {
+
+/**
+ *  Trace categories, corresponding to the GDBus++ components
+ */
+enum class Category : uint8_t
+{
+    GENERAL = 0, ///< Anything not covered by the categories below
+    CALLBACKS,   ///< glib2 callback functions, the D-Bus request entry points
+    REQUESTS,    ///< AsyncProcess request pool processing
+    OBJECTS,     ///< Object::Manager, Object::Base and their helpers
+    PROXY,       ///< Proxy::Client and friends
+    SIGNALS,     ///< Signal emitting and subscriptions
+    _COUNT       ///< Number of categories; not a valid category
+};
+
+/**
+ *  Trace levels; a record is kept if its level is at or below the
+ *  level configured for its category.
+ */
+enum class Level : uint8_t
+{
+    OFF = 0, ///< Nothing is recorded
+    ERROR,   ///< Failures only
+    INFO,    ///< Important events
+    DEBUG    ///< Everything
+};
+
+
+/// Current level per category.  Use SetLevel() to modify
+extern std::atomic<uint8_t> levels[static_cast<size_t>(Category::_COUNT)];
+
+
+/**
+ *  Check if trace records of a given category and level are kept.
+ *  This is the only cost of a trace point while tracing is disabled.
+ *
+ * @param cat    Trace::Category to check
+ * @param level  Trace::Level to check
+ *
+ * @return true if records should be kept
+ */
+inline bool Enabled(const Category cat, const Level level) noexcept
+{
+    return levels[static_cast<size_t>(cat)].load(std::memory_order_relaxed)
+           >= static_cast<uint8_t>(level);
+}
+
+
+/**
+ *  Change the trace level of a category
+ *
+ * @param cat    Trace::Category to modify
+ * @param level  Trace::Level to use
+ */
+void SetLevel(const Category cat, const Level level) noexcept;
+
+/**
+ *  Change the trace level of all categories
+ *
+ * @param level  Trace::Level to use
+ */
+void SetLevel(const Level level) noexcept;
+
+/**
+ *  Configure the tracing via a GDBUSPP_TRACE formatted string; see the
+ *  Trace namespace description for details.  Unknown categories or levels
+ *  are ignored.
+ *
+ * @param spec  std::string with the trace configuration
+ */
+void Configure(const std::string &spec) noexcept;
+
+/**
+ *  Write each record to std::cerr as well, when it is recorded.  This is
+ *  synchronous and slow, and is mostly useful while developing.
+ *
+ * @param enable  bool flag enabling or disabling the echo
+ */
+void SetEcho(const bool enable) noexcept;
+
+/**
+ *  Record an event with deferred formatting.  Only the pointer to the
+ *  message template and the two arguments are stored; any "{}" in the
+ *  template is replaced by the arguments when formatted by Dump().
+ *
+ *  This is normally used via the GDBUSPP_TRACE() macro.
+ *
+ * @param cat    Trace::Category of the event
+ * @param level  Trace::Level of the event
+ * @param file   Source file name; must be a string literal
+ * @param line   Source line number
+ * @param fmt    Message template; must be a string literal
+ * @param a0     First argument
+ * @param a1     Second argument
+ */
+void Event(const Category cat,
+           const Level level,
+           const char *file,
+           const unsigned int line,
+           const char *fmt,
+           const uint64_t a0 = 0,
+           const uint64_t a1 = 0) noexcept;
+
+/**
+ *  Record an already formatted message.  The message is truncated
+ *  to GDBUSPP_TRACE_MSG_LEN bytes.
+ *
+ *  This is normally used via the GDBUSPP_LOG() macro.
+ *
+ * @param cat    Trace::Category of the message
+ * @param level  Trace::Level of the message
+ * @param file   Source file name; must be a string literal
+ * @param line   Source line number
+ * @param msg    std::string with the message
+ */
+void Message(const Category cat,
+             const Level level,
+             const char *file,
+             const unsigned int line,
+             const std::string &msg) noexcept;
+
+/**
+ *  Format all the records currently kept in the ring buffers of all the
+ *  threads, ordered by time.  Records written while dumping may be
+ *  skipped.
+ *
+ * @param os  std::ostream to write the records to
+ */
+void Dump(std::ostream &os);
+
+/**
+ *  Discard all the records currently kept in the ring buffers
+ */
+void Clear() noexcept;
+
+/**
+ *  Helper for trace messages, returning a printable representation of a
+ *  GVariant value.
+ *
+ * @param value     GVariant to print; may be nullptr
+ * @param annotate  bool flag, include the type annotations
+ *
+ * @return std::string
+ */
+std::string VariantString(GVariant *value, const bool annotate = true);
+
+} // namespace Trace
+} // namespace Features
+} // namespace DBus
+
+
+
+/**
+ *  Record a trace event with deferred formatting.  The fmt argument must
+ *  be a string literal, and up to two integer arguments can be given.
+ */
+#define GDBUSPP_TRACE(cat, level, ...)                                                      \
+    do                                                                                      \
+    {                                                                                       \
+        if (DBus::Features::Trace::Enabled(DBus::Features::Trace::Category::cat,            \
+                                           DBus::Features::Trace::Level::level))            \
+        {                                                                                   \
+            DBus::Features::Trace::Event(DBus::Features::Trace::Category::cat,              \
+                                         DBus::Features::Trace::Level::level,               \
+                                         __FILE__,                                          \
+                                         __LINE__,                                          \
+                                         __VA_ARGS__);                                      \
+        }                                                                                   \
+    } while (0)
@@ -18,11 +18,17 @@
 #include <gio/gio.h>
 
 #include "../async-process.hpp"
+#include "../authz-cache.hpp"
+#define GDBUSPP_LOG_CATEGORY CALLBACKS
+#include "../features/capture.hpp"
 #include "../features/debug-log.hpp"
+#include "../features/probes.hpp"
 #include "../glib2/utils.hpp"
 #include "../object/base.hpp"
 #include "../object/callbacklink.hpp"
 #include "../object/manager.hpp"
+#include "../object/property-batch.hpp"
+#include "../object/subtree.hpp"
 #include "../signals/event.hpp"
 #include "../signals/exceptions.hpp"
 #include "../signals/single-subscription.hpp"
@@ -34,12 +40,26 @@ using namespace DBus;
 namespace glib2 {
 namespace Callbacks {
 
+/**
+ *  Calls and signals over peer-to-peer connections carry no sender bus
+ *  name; glib2 then passes a NULL sender, which is treated as an empty
+ *  bus name by all the callbacks.
+ *
+ * @param sender  gchar* with the sender bus name from glib2, may be NULL
+ * @return const gchar* with the sender bus name, never NULL
+ */
+static inline const gchar *_int_sender_busname(const gchar *sender) noexcept
+{
+    return (sender ? sender : "");
+}
+
 
 void _int_callback_name_acquired(GDBusConnection *conn,
                                  const char *name,
                                  void *this_ptr)
 {
     DBus::Service *service = static_cast<DBus::Service *>(this_ptr);
+    service->name_acquired();
     service->BusNameAcquired(std::string(name));
     GDBUSPP_LOG("Service registered:" << name);
     service->RunIdleDetector(true);
@@ -54,9 +74,301 @@ void _int_callback_name_lost(GDBusConnection *conn, const gchar *name, void *thi
 }
 
 
-void _int_pool_processpool_cb(void *req_ptr, void *pool_data)
+/**
+ *  Records the time spent evaluating an authorization request in the
+ *  method metrics and via the authorization probe
+ *
+ * @param req          AsyncProcess::Request::UPtr with the request
+ * @param authzres     bool with the authorization result
+ * @param authz_start  int64_t monotonic timestamp of when the evaluation
+ *                     started; 0 if not measured
+ */
+static void _int_record_authorization(const AsyncProcess::Request::UPtr &req,
+                                      const bool authzres,
+                                      const int64_t authz_start)
+{
+    GDBUSPP_TRACE(CALLBACKS, INFO, "Authorization: allowed={}, sequence={}",
+                  (authzres ? 1 : 0), req->sequence);
+    if (0 == authz_start)
+    {
+        return;
+    }
+    const int64_t duration = g_get_monotonic_time() - authz_start;
+    if (req->metrics)
+    {
+        req->metrics->authorization.Record(duration);
+    }
+    GDBUSPP_PROBE(authorization,
+                  req->object->GetPath().c_str(),
+                  req->object->GetInterface().c_str(),
+                  (req->method.empty() ? req->property.c_str() : req->method.c_str()),
+                  (authzres ? 1 : 0),
+                  duration);
+}
+
+
+/**
+ *  Authorizes a method call or property request.
+ *
+ *  If the object has enabled the authorization cache, a recently granted
+ *  identical request from the same caller is not evaluated again.
+ *  Requests already authorized via _int_authorize_async() pass directly.
+ *
+ * @param req   AsyncProcess::Request::UPtr with the request
+ *
+ * @throws Authz::Exception if the request was not authorized
+ */
+static void _int_authorize_request(AsyncProcess::Request::UPtr &req)
+{
+    if (req->authorized)
+    {
+        return;
+    }
+
+    auto azreq = Authz::Request::Create(req);
+
+    const auto cache_ttl = req->object->GetAuthorizationCacheTTL();
+    Authz::Cache::Ptr cache = nullptr;
+    if (cache_ttl.count() > 0)
+    {
+        cache = Authz::Cache::Get(const_cast<GDBusConnection *>(req->dbusconn));
+    }
+    if (cache)
+    {
+        if (cache->Lookup(azreq))
+        {
+            GDBUSPP_LOG("Authorization (cached): " << req << " Result: Allow");
+            return;
+        }
+    }
+
+    const bool probe = GDBUSPP_PROBE_ENABLED(authorization);
+    const int64_t authz_start = ((req->metrics || probe) ? g_get_monotonic_time() : 0);
+    bool authzres = req->object->Authorize(azreq);
+    _int_record_authorization(req, authzres, authz_start);
+    GDBUSPP_LOG("Authorization: "
+                << req << " Result: " << (authzres ? "Allow" : "Deny"));
+    if (!authzres)
+    {
+        // Authz failed; stop the request and return an error
+        std::string msg = req->object->AuthorizationRejected(azreq);
+        throw Authz::Exception(azreq, msg);
+    }
+
+    if (cache)
+    {
+        cache->Store(azreq, cache_ttl);
+    }
+}
+
+
+/**
+ *  Retrieves the value of the property in an authorized
+ *  property read request.
+ *
+ * @param req   AsyncProcess::Request::UPtr with the property request
+ *
+ * @return GVariant* with the property value
+ *
+ * @throws Object::Property::Exception if the property does not exist or
+ *         did not return any value
+ */
+static GVariant *_int_property_get_value(AsyncProcess::Request::UPtr &req)
+{
+    // Check if the requested property is accessible via the PropertyCollection,
+    // if not return an error
+    if (!req->object->PropertyExists(req->property))
+    {
+        GDBUSPP_LOG("Get Property Callback FAIL:" << req->object);
+        throw Object::Property::Exception(req->object, req->property, "Property not found");
+    }
+
+    // Retrieve the property value
+    GVariant *value = req->object->GetProperty(req->property);
+    if (nullptr == value)
+    {
+        GDBUSPP_LOG("GetProperty('" << req->property << "') "
+                                    << "returned nullptr: "
+                                    << req->object);
+        throw Object::Property::Exception(req->object,
+                                          req->property,
+                                          "NULL/nullptr value is not allowed");
+    }
+    GDBUSPP_LOG("Get Property Callback (Return): "
+                << req
+                << " - Value: " << Features::Trace::VariantString(value));
+    return value;
+}
+
+
+/**
+ *  Changes the property value of an authorized property change request
+ *  and sends the org.freedesktop.DBus.Properties.PropertiesChanged signal.
+ *
+ * @param req   AsyncProcess::Request::UPtr with the property request
+ *
+ * @throws Object::Property::Exception if the property does not exist or
+ *         the change could not be signalled
+ */
+static void _int_property_set_value(AsyncProcess::Request::UPtr &req)
+{
+    // If the requested property is accessible via the PropertyCollection,
+    // handle that internally
+    Object::Property::Update::Ptr updated_vals = nullptr;
+    if (req->object->PropertyExists(req->property))
+    {
+        updated_vals = req->object->SetProperty(req->property, req->params);
+        GDBUSPP_LOG("Set Property Callback (Return): "
+                    << req
+                    << " - New value: " << Features::Trace::VariantString(req->params));
+    }
+    else
+    {
+        GDBUSPP_LOG("Set Property Callback FAIL:" << req->object);
+        throw Object::Property::Exception(req->object,
+                                          req->property,
+                                          "Property not found");
+    }
+
+    // If ret != NULL, we have a valid response which contains
+    // information about what has changed.  This is further
+    // used to issue a standard D-Bus signal that an object property
+    // have been modified; which is the signal being emitted below.
+    if (!updated_vals)
+    {
+        throw Object::Property::Exception(req->object,
+                                          req->property,
+                                          "Failed signaling new property value");
+    }
+
+    if (req->object->GetPropertyChangeCoalescing())
+    {
+        auto batch = Object::Property::ChangeBatch::Get(const_cast<GDBusConnection *>(req->dbusconn),
+                                                         req->object->GetMainContext());
+        batch->Queue(req->object->GetPath(),
+                     updated_vals,
+                     req->object->GetPropertyChangeDelay());
+        return;
+    }
+
+    GError *local_err = nullptr;
+    Connection::Cork::EmitSignal(const_cast<GDBusConnection *>(req->dbusconn),
+                                 nullptr,
+                                 req->object->GetPath().c_str(),
+                                 "org.freedesktop.DBus.Properties",
+                                 "PropertiesChanged",
+                                 updated_vals->Finalize(),
+                                 &local_err);
+    if (local_err)
+    {
+        GDBUSPP_LOG("Set Property Callback FAIL:" << req->object);
+        throw Object::Property::Exception(req->object,
+                                          req->property,
+                                          "Failed signalign new property value",
+                                          local_err);
+    }
+}
+
+
+/**
+ *  Processes a property read or change request queued via the
+ *  org.freedesktop.DBus.Properties method call path and sends the
+ *  result back to the D-Bus caller.
+ *
+ * @param req   AsyncProcess::Request::UPtr with the property request
+ */
+static void _int_process_property_request(AsyncProcess::Request::UPtr &req) noexcept
+{
+    GError *err = nullptr;
+    try
+    {
+        if (Object::Operation::PROPERTY_GET == req->request_type)
+        {
+            if (req->property.empty())
+            {
+                // org.freedesktop.DBus.Properties.GetAll
+                //
+                // A GetAll request granted via AuthorizeAsync() covers all
+                // the properties.  Otherwise each property is authorized on
+                // its own, like glib2 does when it processes GetAll via the
+                // get property callback.  Properties the caller may not
+                // read are left out.
+                const bool granted = req->authorized;
+                GVariant *all = req->object->GetAllProperties(
+                    [&req, granted](const std::string &name)
+                    {
+                        if (granted)
+                        {
+                            return true;
+                        }
+                        req->property = name;
+                        req->authorized = false;
+                        try
+                        {
+                            _int_authorize_request(req);
+                            return true;
+                        }
+                        catch (const Authz::Exception &excp)
+                        {
+                            GDBUSPP_LOG("GetAll: Property '" << name << "' left out: "
+                                                             << excp.GetRawError());
+                            return false;
+                        }
+                    });
+                req->property.clear();
+                Connection::Cork::ReturnValue(req->invocation,
+                                              g_variant_new("(@a{sv})", all));
+                return;
+            }
+
+            _int_authorize_request(req);
+            GVariant *value = _int_property_get_value(req);
+            Connection::Cork::ReturnValue(req->invocation,
+                                          g_variant_new("(v)", value));
+        }
+        else
+        {
+            _int_authorize_request(req);
+            _int_property_set_value(req);
+            Connection::Cork::ReturnValue(req->invocation, nullptr);
+        }
+        return;
+    }
+    catch (const Object::Property::Exception &excp)
+    {
+        GDBUSPP_LOG("Property Request FAIL: " << req << " -- ERROR: " << excp.what());
+        excp.SetDBusErrorProperty(&err);
+    }
+    catch (const Authz::Exception &excp)
+    {
+        GDBUSPP_LOG("Property Request Authorization FAIL: " << req << " -- ERROR: " << excp.what());
+        excp.SetDBusError(&err, G_DBUS_ERROR, G_DBUS_ERROR_ACCESS_DENIED);
+    }
+    catch (const DBus::Exception &excp)
+    {
+        GDBUSPP_LOG("Property Request FAIL (DBus::Exception): " << req << " -- ERROR: " << excp.what());
+        excp.SetDBusError(&err, G_DBUS_ERROR, G_DBUS_ERROR_FAILED);
+    }
+
+    if (!err)
+    {
+        err = g_error_new_literal(G_DBUS_ERROR,
+                                  G_DBUS_ERROR_FAILED,
+                                  "Property request failed");
+    }
+    Connection::Cork::TakeError(req->invocation, err);
+}
+
+
+/**
+ *  Authorizes and processes an AsyncProcess::Request.  This is used both
+ *  by the AsyncProcess::Pool worker threads and by methods running inline
+ *  on the thread dispatching the D-Bus method call.
+ *
+ * @param req   AsyncProcess::Request::UPtr to process
+ */
+static void _int_process_request(AsyncProcess::Request::UPtr &req)
 {
-    auto req = AsyncProcess::Request::UPtr(static_cast<AsyncProcess::Request *>(req_ptr));
     if (req)
     {
         try
@@ -67,29 +379,18 @@ void _int_pool_processpool_cb(void *req_ptr, void *pool_data)
                                       "Invalid Request Type");
             }
 
-            if (Object::Operation::PROPERTY_GET == req->request_type)
+            if (Object::Operation::PROPERTY_GET == req->request_type
+                || Object::Operation::PROPERTY_SET == req->request_type)
             {
-                throw DBus::Exception("AsyncProcess::Request",
-                                      "Not yet implemented");
-            }
-
-            if (Object::Operation::PROPERTY_SET == req->request_type)
-            {
-                throw DBus::Exception("AsyncProcess::Request",
-                                      "Not yet implemented");
+                // Property requests handle authorization and errors
+                // themselves, responding via the method invocation
+                _int_process_property_request(req);
+                req.reset();
+                return;
             }
 
             //  Authorize this request before starting to process the request
-            auto azreq = Authz::Request::Create(req);
-            bool authzres = req->object->Authorize(azreq);
-            GDBUSPP_LOG("ProcessPool (Authorizaion): "
-                        << req << " Result: " << (authzres ? "Allow" : "Deny"));
-            if (!authzres)
-            {
-                // Authz failed; stop the request and return an error
-                std::string msg = req->object->AuthorizationRejected(azreq);
-                throw Authz::Exception(azreq, msg);
-            }
+            _int_authorize_request(req);
 
             // Authz granted; call the method
             // The Object::MethodCall() finds the proper callback method
@@ -106,33 +407,24 @@ void _int_pool_processpool_cb(void *req_ptr, void *pool_data)
             // If a method callback throws Method::Exception, it's an error
             // to be returned to the caller - not an error in the application
             // itself - so don't trigger additional error logging.
-            GError *dbuserr = g_dbus_error_new_for_dbus_error(excp.DBusErrorDomain(),
-                                                              excp.GetRawError());
-            dbuserr->domain = g_quark_from_string(excp.DBusErrorDomain());
-            g_dbus_method_invocation_return_gerror(req->invocation, dbuserr);
-            g_error_free(dbuserr);
+            DBus::Exception::ReturnMethodError(req->invocation,
+                                               excp.DBusErrorDomain(),
+                                               excp.GetRawError());
         }
         catch (const Authz::Exception &excp)
         {
-            GError *dbuserr = g_dbus_error_new_for_dbus_error(excp.DBusErrorDomain(),
-                                                              excp.GetRawError());
-            dbuserr->domain = g_quark_from_string(excp.DBusErrorDomain());
-            g_dbus_method_invocation_return_gerror(req->invocation, dbuserr);
-            g_error_free(dbuserr);
+            DBus::Exception::ReturnMethodError(req->invocation,
+                                               excp.DBusErrorDomain(),
+                                               excp.GetRawError());
         }
         catch (const DBus::Exception &excp)
         {
-            // TODO:  Extend this to include ReqType::GETPROP once that
-            //        path is used here.  ReqType::SETPROP will probably
-            //        not benefit much from going the async-route.
-            GDBUSPP_LOG("ProcessPool - Process Pool Method Call FAILED: " << excp.what())
+            GDBUSPP_LOG("ProcessPool - Process Pool Method Call FAILED: " << excp.what());
             if (Object::Operation::METHOD_CALL == req->request_type)
             {
-                GError *dbuserr = g_dbus_error_new_for_dbus_error(req->error_domain.c_str(),
-                                                                  excp.GetRawError());
-                dbuserr->domain = g_quark_from_string(req->error_domain.c_str());
-                g_dbus_method_invocation_return_gerror(req->invocation, dbuserr);
-                g_error_free(dbuserr);
+                DBus::Exception::ReturnMethodError(req->invocation,
+                                                   req->error_domain,
+                                                   excp.GetRawError());
 
                 std::cerr << "** ERROR ** Async call failed: "
                           << excp.what() << std::endl
@@ -141,8 +433,8 @@ void _int_pool_processpool_cb(void *req_ptr, void *pool_data)
             }
             else
             {
-                // This should only happen with ReqType::SETPROP and
-                // ReqType::NONE; both very unlikely to end up here
+                // This should only happen with Object::Operation::NONE;
+                // very unlikely to end up here
                 std::cerr << "** ERROR **  Async call failed: "
                           << excp.what() << std::endl;
             }
@@ -152,6 +444,368 @@ void _int_pool_processpool_cb(void *req_ptr, void *pool_data)
 }
 
 
+/**
+ *  Processes a single request taken from the AsyncProcess::Pool,
+ *  including the pool accounting and the request probes
+ *
+ * @param pool  AsyncProcess::Pool the request was queued in
+ * @param req   AsyncProcess::Request::UPtr to process; released when done
+ */
+static void _int_pool_process_one(AsyncProcess::Pool *pool,
+                                  AsyncProcess::Request::UPtr &req)
+{
+    pool->RequestStarted();
+    if (req->metrics)
+    {
+        req->metrics->queue_wait.Record(g_get_monotonic_time() - req->received_at);
+    }
+    const uint64_t sequence = req->sequence;
+    const int64_t trace_start = (Features::Trace::Enabled(Features::Trace::Category::REQUESTS,
+                                                          Features::Trace::Level::DEBUG)
+                                     ? g_get_monotonic_time()
+                                     : 0);
+    GDBUSPP_TRACE(REQUESTS, DEBUG, "Request dequeued: sequence={}, waited={} usec",
+                  sequence, (req->received_at > 0 ? trace_start - req->received_at : 0));
+
+    // The request is released while processed; keep what the
+    // request_completed probe needs
+    std::string probe_path{};
+    std::string probe_intf{};
+    std::string probe_member{};
+    int64_t probe_start = 0;
+    if (GDBUSPP_PROBE_ENABLED(request_dequeued) || GDBUSPP_PROBE_ENABLED(request_completed))
+    {
+        probe_path = req->object->GetPath();
+        probe_intf = req->object->GetInterface();
+        probe_member = (req->method.empty() ? req->property : req->method);
+        probe_start = g_get_monotonic_time();
+        GDBUSPP_PROBE(request_dequeued,
+                      probe_path.c_str(),
+                      probe_intf.c_str(),
+                      probe_member.c_str(),
+                      (req->received_at > 0 ? probe_start - req->received_at : 0));
+    }
+    const std::string sender = req->sender;
+    if (pool->ShuttingDown())
+    {
+        GDBUSPP_LOG("ProcessPool - Rejecting request on shutdown: " << req);
+        if (req->invocation)
+        {
+            g_dbus_method_invocation_return_error_literal(req->invocation,
+                                                          G_DBUS_ERROR,
+                                                          G_DBUS_ERROR_FAILED,
+                                                          "Service is shutting down");
+        }
+        req.reset();
+    }
+    else if (req->IsCancelled())
+    {
+        // The caller has disconnected; nobody would receive the
+        // response.  The invocation still needs to be completed to
+        // release it.
+        GDBUSPP_LOG("ProcessPool - Dropping cancelled request: " << req);
+        if (req->invocation)
+        {
+            g_dbus_method_invocation_return_error_literal(req->invocation,
+                                                          G_DBUS_ERROR,
+                                                          G_DBUS_ERROR_FAILED,
+                                                          "Caller disconnected");
+        }
+        req.reset();
+    }
+    else
+    {
+        _int_process_request(req);
+    }
+    if (probe_start > 0)
+    {
+        GDBUSPP_PROBE(request_completed,
+                      probe_path.c_str(),
+                      probe_intf.c_str(),
+                      probe_member.c_str(),
+                      g_get_monotonic_time() - probe_start);
+    }
+    GDBUSPP_TRACE(REQUESTS, DEBUG, "Request completed: sequence={}, duration={} usec",
+                  sequence, (trace_start > 0 ? g_get_monotonic_time() - trace_start : 0));
+    pool->RequestDone(sender);
+}
+
+
+void _int_pool_processpool_cb(void *req_ptr, void *pool_data)
+{
+    auto req = AsyncProcess::Request::UPtr(static_cast<AsyncProcess::Request *>(req_ptr));
+    auto pool = static_cast<AsyncProcess::Pool *>(pool_data);
+    if (!pool || !req)
+    {
+        _int_process_request(req);
+        return;
+    }
+
+    pool->PrepareWorkerThread();
+
+    // Requests of an object serializing its requests are run one at a
+    // time.  The next queued request of the same object is preferably
+    // processed by this thread, which has the object data in its caches;
+    // after a number of requests, it is queued in the pool again to let
+    // other objects get their turn.  While the pool is being destroyed,
+    // the remaining requests are rejected here.
+    std::shared_ptr<Object::Base> strand = (req->strand ? req->object : nullptr);
+    unsigned int strand_runs = 0;
+    while (req)
+    {
+        _int_pool_process_one(pool, req);
+        if (!strand)
+        {
+            break;
+        }
+        const bool run_here = (++strand_runs < GDBUSPP_STRAND_BURST || pool->ShuttingDown());
+        req = pool->StrandNext(strand.get(), run_here);
+    }
+}
+
+
+/**
+ *  Passes a prepared request on for processing.  Inline methods are
+ *  processed directly by the calling thread, all other requests are
+ *  queued in the AsyncProcess::Pool.
+ *
+ * @param cbl   Object::CallbackLink to the D-Bus object
+ * @param req   AsyncProcess::Request::UPtr to process
+ *
+ * @throws AsyncProcess::LimitsExceeded if the request could not be queued
+ */
+static void _int_dispatch_request(Object::CallbackLink *cbl,
+                                  AsyncProcess::Request::UPtr &req)
+{
+    if (req->run_inline)
+    {
+        // Trivial methods are processed directly, avoiding the
+        // overhead of passing the request to a worker thread
+        GDBUSPP_LOG("Request (Inline): " << req);
+        _int_process_request(req);
+    }
+    else
+    {
+        GDBUSPP_LOG("Request (Queuing): " << req);
+        cbl->QueueOperation(req);
+    }
+}
+
+
+/**
+ *  Sends the error of a rejected authorization back to the D-Bus caller
+ *
+ * @param req    AsyncProcess::Request::UPtr of the rejected request
+ * @param excp   Authz::Exception with the error to send
+ */
+static void _int_reject_request(AsyncProcess::Request::UPtr &req,
+                                const Authz::Exception &excp)
+{
+    if (Object::Operation::METHOD_CALL == req->request_type)
+    {
+        DBus::Exception::ReturnMethodError(req->invocation,
+                                           excp.DBusErrorDomain(),
+                                           excp.GetRawError());
+    }
+    else
+    {
+        GError *err = nullptr;
+        excp.SetDBusError(&err, G_DBUS_ERROR, G_DBUS_ERROR_ACCESS_DENIED);
+        Connection::Cork::TakeError(req->invocation, err);
+    }
+}
+
+
+/**
+ *  Authorizes a request via Object::Base::AuthorizeAsync() before it is
+ *  dispatched.  The request is handed over to the pending Authz::Decision
+ *  and dispatched by the thread completing the decision; no thread waits
+ *  for the decision meanwhile.  The pending request is counted against
+ *  the request queue limits.
+ *
+ * @param cbl   Object::CallbackLink to the D-Bus object
+ * @param req   AsyncProcess::Request::UPtr to authorize.  This is
+ *              released unless found in the authorization cache.
+ *
+ * @throws AsyncProcess::LimitsExceeded if the request queue limits are
+ *         reached
+ */
+static void _int_authorize_async(Object::CallbackLink *cbl,
+                                 AsyncProcess::Request::UPtr &req)
+{
+    auto azreq = Authz::Request::Create(req);
+
+    const auto cache_ttl = req->object->GetAuthorizationCacheTTL();
+    Authz::Cache::Ptr cache = nullptr;
+    if (cache_ttl.count() > 0)
+    {
+        cache = Authz::Cache::Get(const_cast<GDBusConnection *>(req->dbusconn));
+    }
+    if (cache)
+    {
+        if (cache->Lookup(azreq))
+        {
+            GDBUSPP_LOG("Authorization (cached): " << req << " Result: Allow");
+            req->authorized = true;
+            _int_dispatch_request(cbl, req);
+            return;
+        }
+    }
+
+    // Counted as queued while the decision is pending
+    cbl->ReserveOperation(req);
+
+    const bool probe = GDBUSPP_PROBE_ENABLED(authorization);
+    const int64_t authz_start = ((req->metrics || probe) ? g_get_monotonic_time() : 0);
+    Object::Base::Ptr object = req->object;
+    GCancellable *cancellable = req->cancellable;
+    auto link = cbl->shared_from_this();
+    auto pending = std::make_shared<AsyncProcess::Request::UPtr>(std::move(req));
+
+    using Result = Authz::Decision::Result;
+    auto decision = Authz::Decision::Create(
+        [link, pending, azreq, cache, cache_ttl, authz_start](const Result result,
+                                                              const std::string &message)
+        {
+            AsyncProcess::Request::UPtr &areq = *pending;
+            if (areq->IsCancelled())
+            {
+                // The caller has disconnected; nobody would receive the
+                // response.  The invocation still needs to be completed.
+                GDBUSPP_LOG("Authorization (async): " << areq << " Caller disconnected");
+                link->ReleaseOperation(areq);
+                g_dbus_method_invocation_return_error_literal(areq->invocation,
+                                                              G_DBUS_ERROR,
+                                                              G_DBUS_ERROR_FAILED,
+                                                              "Caller disconnected");
+                areq.reset();
+                return;
+            }
+
+            if (Result::DEFERRED != result)
+            {
+                const bool allowed = (Result::GRANTED == result);
+                _int_record_authorization(areq, allowed, authz_start);
+                GDBUSPP_LOG("Authorization (async): "
+                            << areq << " Result: " << (allowed ? "Allow" : "Deny"));
+                if (!allowed)
+                {
+                    const std::string msg = (message.empty()
+                                                 ? areq->object->AuthorizationRejected(azreq)
+                                                 : message);
+                    link->ReleaseOperation(areq);
+                    _int_reject_request(areq, Authz::Exception(azreq, msg));
+                    areq.reset();
+                    return;
+                }
+
+                if (cache)
+                {
+                    cache->Store(azreq, cache_ttl);
+                }
+                areq->authorized = true;
+            }
+
+            if (areq->run_inline)
+            {
+                // Processed right here; not queued
+                link->ReleaseOperation(areq);
+            }
+            try
+            {
+                _int_dispatch_request(link.get(), areq);
+            }
+            catch (const DBus::Exception &excp)
+            {
+                GDBUSPP_LOG("Request (Queuing FAILED): " << excp.what());
+                link->ReleaseOperation(areq);
+                excp.SetDBusError(areq->invocation);
+            }
+            areq.reset();
+        },
+        cancellable);
+
+    try
+    {
+        object->AuthorizeAsync(azreq, decision);
+    }
+    catch (const std::exception &excp)
+    {
+        // An evaluation which could not be started is a rejection
+        GDBUSPP_LOG("AuthorizeAsync FAILED: " << excp.what());
+        decision->Deny();
+    }
+}
+
+
+/**
+ *  Queues an org.freedesktop.DBus.Properties Get, Set or GetAll method
+ *  call to the AsyncProcess::Pool for D-Bus objects with asynchronous
+ *  property access enabled.
+ *
+ * @param cbl        Object::CallbackLink to the D-Bus object
+ * @param conn       GDBusConnection* where the call occurred
+ * @param sender     char * containing a unique bus name of the caller
+ * @param obj_path   char * containing the D-Bus object path to operate on
+ * @param meth_name  char * containing the org.freedesktop.DBus.Properties method
+ * @param params     GVariant * containing all the arguments to the method call
+ * @param invoc      GDBusMethodInvocation * where the response is returned
+ */
+static void _int_queue_property_request(Object::CallbackLink *cbl,
+                                        GDBusConnection *conn,
+                                        const gchar *sender,
+                                        const gchar *obj_path,
+                                        const gchar *meth_name,
+                                        GVariant *params,
+                                        GDBusMethodInvocation *invoc)
+{
+    AsyncProcess::Request::UPtr req = cbl->NewObjectOperation(conn,
+                                                              sender,
+                                                              obj_path,
+                                                              cbl->object->GetInterface());
+    if (0 == g_strcmp0(meth_name, "Get"))
+    {
+        const gchar *propname = nullptr;
+        g_variant_get(params, "(&s&s)", nullptr, &propname);
+        req->GetProperty(propname, invoc);
+    }
+    else if (0 == g_strcmp0(meth_name, "GetAll"))
+    {
+        // Authorized as a single request without a property name;
+        // see _int_process_property_request()
+        req->GetProperty("", invoc);
+    }
+    else if (0 == g_strcmp0(meth_name, "Set"))
+    {
+        const gchar *propname = nullptr;
+        GVariant *value = nullptr;
+        g_variant_get(params, "(&s&sv)", nullptr, &propname, &value);
+        req->SetProperty(propname, value, invoc);
+    }
+    else
+    {
+        throw Object::Exception(cbl->object,
+                                "Unknown org.freedesktop.DBus.Properties method");
+    }
+    if (cbl->object->GetAsyncAuthorization())
+    {
+        _int_authorize_async(cbl, req);
+    }
+    else
+    {
+        GDBUSPP_LOG("Property Callback (Queuing): " << req);
+        cbl->QueueOperation(req);
+    }
+
+    // Update the activity for the idle detector
+    Object::Manager::Ptr om = cbl->manager.lock();
+    if (om)
+    {
+        om->IdleActivityUpdate();
+    }
+}
+
+
 void _int_dbusobject_callback_method_call(GDBusConnection *conn,
                                           const gchar *sender,
                                           const gchar *obj_path,
@@ -161,6 +815,13 @@ void _int_dbusobject_callback_method_call(GDBusConnection *conn,
                                           GDBusMethodInvocation *invoc,
                                           void *this_ptr)
 {
+    sender = _int_sender_busname(sender);
+    if (Features::Capture::Enabled()
+        && 0 != g_strcmp0(intf_name, "org.freedesktop.DBus.Properties"))
+    {
+        // Property requests are recorded by the Object::Manager message filter
+        Features::Capture::Store(sender, obj_path, intf_name, meth_name, params);
+    }
     auto cbl = static_cast<Object::CallbackLink *>(this_ptr);
     if (!cbl)
     {
@@ -177,10 +838,34 @@ void _int_dbusobject_callback_method_call(GDBusConnection *conn,
 
     try
     {
+        if (0 == g_strcmp0(intf_name, "org.freedesktop.DBus.Properties"))
+        {
+            // glib2 only passes org.freedesktop.DBus.Properties calls
+            // here for objects with asynchronous property access enabled.
+            // The interface and property have already been validated
+            _int_queue_property_request(cbl, conn, sender, obj_path, meth_name, params, invoc);
+            return;
+        }
+
         AsyncProcess::Request::UPtr req = cbl->NewObjectOperation(conn, sender, obj_path, intf_name);
-        GDBUSPP_LOG("Method Callback (Queuing): " << req);
         req->MethodCall(meth_name, params, invoc);
-        cbl->QueueOperation(req);
+        if (Features::Metrics::Enabled())
+        {
+            req->metrics = Features::Metrics::GetMethodStats(obj_path, intf_name, meth_name);
+            req->received_at = g_get_monotonic_time();
+        }
+        else if (GDBUSPP_PROBE_ENABLED(request_dequeued))
+        {
+            req->received_at = g_get_monotonic_time();
+        }
+        if (cbl->object->GetAsyncAuthorization())
+        {
+            _int_authorize_async(cbl, req);
+        }
+        else
+        {
+            _int_dispatch_request(cbl, req);
+        }
 
         // Update the activity for the idle detector
         Object::Manager::Ptr om = cbl->manager.lock();
@@ -189,6 +874,14 @@ void _int_dbusobject_callback_method_call(GDBusConnection *conn,
             om->IdleActivityUpdate();
         }
     }
+    catch (const AsyncProcess::LimitsExceeded &excp)
+    {
+        GDBUSPP_LOG("Method Callback (Queuing REJECTED): " << excp.what());
+        g_dbus_method_invocation_return_error_literal(invoc,
+                                                      G_DBUS_ERROR,
+                                                      G_DBUS_ERROR_LIMITS_EXCEEDED,
+                                                      excp.GetRawError());
+    }
     catch (const DBus::Exception &excp)
     {
         GDBUSPP_LOG("Method Callback (Queuing FAILED): " << excp.what());
@@ -205,9 +898,12 @@ GVariant *_int_dbusobject_callback_get_property(GDBusConnection *conn,
                                                 GError **error,
                                                 void *this_ptr)
 {
-    // TODO:  Go a better async route via AsyncProcess::Request::MethodCall()
-    //        The glib2 gdbus callback interface expects this method to return instantly
-    //
+    // Property requests are recorded for Features::Capture by the
+    // Object::Manager message filter, as the D-Bus method they arrived as
+    sender = _int_sender_busname(sender);
+    // The glib2 gdbus callback interface expects this method to return instantly.
+    // Objects with Object::Base::AsyncPropertyAccess() enabled are processed via
+    // _int_queue_property_request() instead
     try
     {
         auto cbl = static_cast<Object::CallbackLink *>(this_ptr);
@@ -233,41 +929,10 @@ GVariant *_int_dbusobject_callback_get_property(GDBusConnection *conn,
         // Authorize this request before we do anything
         auto req = AsyncProcess::Request::Create(conn, cbl->object, sender, obj_path, intf_name);
         req->GetProperty(property_name);
-        auto azreq = Authz::Request::Create(req);
-
-        bool authzres = cbl->object->Authorize(azreq);
-        GDBUSPP_LOG("Get Property Callback (Authorizaion): "
-                    << req << " Result: " << (authzres ? "Allow" : "Deny"));
-        if (!authzres)
-        {
-            // Authz failed; stop the request and return an error
-            std::string msg = req->object->AuthorizationRejected(azreq);
-            throw Authz::Exception(azreq, msg);
-        }
-
-        // Check if the requested property is accessible via the PropertyCollection,
-        // if not return an error
-        if (!cbl->object->PropertyExists(property_name))
-        {
-            GDBUSPP_LOG("Get Property Callback FAIL:" << cbl->object);
-            throw Object::Property::Exception(cbl->object, "property_name", "Property not found");
-        }
+        _int_authorize_request(req);
 
         // Retrieve the property value and return it to the caller
-        GVariant *value = cbl->object->GetProperty(property_name);
-        if (nullptr == value)
-        {
-            GDBUSPP_LOG("GetProperty('" << property_name << "') "
-                                        << "returned nullptr: "
-                                        << cbl->object);
-            throw Object::Property::Exception(cbl->object,
-                                              property_name,
-                                              "NULL/nullptr value is not allowed");
-        }
-        GDBUSPP_LOG("Get Property Callback (Return): "
-                    << req
-                    << " - Value: " << g_variant_print(value, true));
-        return value;
+        return _int_property_get_value(req);
     }
     catch (const Object::Property::Exception &excp)
     {
@@ -305,6 +970,7 @@ gboolean _int_dbusobject_callback_set_property(GDBusConnection *conn,
                                                GError **error,
                                                void *this_ptr)
 {
+    sender = _int_sender_busname(sender);
     try
     {
         auto cbl = static_cast<Object::CallbackLink *>(this_ptr);
@@ -330,64 +996,11 @@ gboolean _int_dbusobject_callback_set_property(GDBusConnection *conn,
         // Authorize this request before we do anything
         auto req = AsyncProcess::Request::Create(conn, cbl->object, sender, obj_path, intf_name);
         req->SetProperty(property_name, value);
-        auto azreq = Authz::Request::Create(req);
-        bool authzres = cbl->object->Authorize(azreq);
-        GDBUSPP_LOG("Set Property Callback (Authorizaion): "
-                    << req << " Result: " << (authzres ? "Allow" : "Deny"));
-        if (!authzres)
-        {
-            // Authz failed; stop the request and return an error
-            std::string msg = req->object->AuthorizationRejected(azreq);
-            throw Authz::Exception(azreq, msg);
-        }
+        _int_authorize_request(req);
 
-        // If the requested property is accessible via the PropertyCollection,
-        // handle that internally
-
-        Object::Property::Update::Ptr updated_vals = nullptr;
-        if (cbl->object->PropertyExists(property_name))
-        {
-            updated_vals = cbl->object->SetProperty(property_name, value);
-            GDBUSPP_LOG("Set Property Callback (Return): "
-                        << req
-                        << " - New value: " << g_variant_print(value, true));
-        }
-        else
-        {
-            GDBUSPP_LOG("Set Property Callback FAIL:" << cbl->object);
-            throw Object::Property::Exception(cbl->object,
-                                              property_name,
-                                              "Property not found");
-        }
-
-        // If ret != NULL, we have a valid response which contains
-        // information about what has changed.  This is further
-        // used to issue a standard D-Bus signal that an object property
-        // have been modified; which is the signal being emitted below.
-        if (updated_vals)
-        {
-            GError *local_err = nullptr;
-            g_dbus_connection_emit_signal(conn,
-                                          nullptr,
-                                          obj_path,
-                                          "org.freedesktop.DBus.Properties",
-                                          "PropertiesChanged",
-                                          updated_vals->Finalize(),
-                                          &local_err);
-            if (local_err)
-            {
-                GDBUSPP_LOG("Set Property Callback FAIL:" << cbl->object);
-                throw Object::Property::Exception(cbl->object,
-                                                  property_name,
-                                                  "Failed signalign new property value",
-                                                  local_err);
-            }
-            return true;
-        }
-
-        throw Object::Property::Exception(cbl->object,
-                                          property_name,
-                                          "Failed signaling new property value");
+        // Change the value and signal the change
+        _int_property_set_value(req);
+        return true;
     }
     catch (const Object::Exception &err)
     {
@@ -442,6 +1055,228 @@ void _int_dbusobject_callback_destruct(void *this_ptr)
 }
 
 
+void _int_objectmanager_callback_method_call(GDBusConnection *conn,
+                                             const gchar *sender,
+                                             const gchar *obj_path,
+                                             const gchar *intf_name,
+                                             const gchar *meth_name,
+                                             GVariant *params,
+                                             GDBusMethodInvocation *invoc,
+                                             void *this_ptr)
+{
+    sender = _int_sender_busname(sender);
+    if (Features::Capture::Enabled())
+    {
+        Features::Capture::Store(sender, obj_path, intf_name, meth_name, params);
+    }
+    auto om = static_cast<Object::Manager *>(this_ptr);
+    if (!om)
+    {
+        g_dbus_method_invocation_return_error_literal(invoc,
+                                                      G_DBUS_ERROR,
+                                                      G_DBUS_ERROR_FAILED,
+                                                      "Object manager unavailable");
+        return;
+    }
+
+    if (std::string("GetManagedObjects") != meth_name)
+    {
+        g_dbus_method_invocation_return_error(invoc,
+                                              G_DBUS_ERROR,
+                                              G_DBUS_ERROR_UNKNOWN_METHOD,
+                                              "Unknown method: %s",
+                                              meth_name);
+        return;
+    }
+
+    try
+    {
+        om->IdleActivityUpdate();
+        GVariant *res = om->_getManagedObjects(sender);
+        Connection::Cork::ReturnValue(invoc,
+                                      g_variant_new("(@a{oa{sa{sv}}})", res));
+    }
+    catch (const DBus::Exception &excp)
+    {
+        GDBUSPP_LOG("GetManagedObjects FAIL: " << excp.what());
+        excp.SetDBusError(invoc);
+    }
+}
+
+
+/**
+ *  Materializes the object of a subtree node
+ *
+ * @param this_ptr  Raw pointer to a DBus::Object::Subtree::Ptr object
+ * @param obj_path  char * containing the D-Bus path of the subtree root
+ * @param node      char * containing the node name in the subtree
+ *
+ * @return Object::CallbackLink::Ptr to the object, nullptr if not found
+ */
+static Object::CallbackLink::Ptr _int_subtree_materialize(void *this_ptr,
+                                                          const gchar *obj_path,
+                                                          const gchar *node)
+{
+    auto subtree = static_cast<Object::Subtree::Ptr *>(this_ptr);
+    if (!subtree || !node)
+    {
+        return nullptr;
+    }
+    std::string root(obj_path);
+    return (*subtree)->Materialize(("/" == root ? "" : root) + "/" + node);
+}
+
+
+gchar **_int_subtree_callback_enumerate(GDBusConnection *conn,
+                                        const gchar *sender,
+                                        const gchar *obj_path,
+                                        void *this_ptr)
+{
+    auto subtree = static_cast<Object::Subtree::Ptr *>(this_ptr);
+    std::vector<std::string> nodes{};
+    try
+    {
+        nodes = (*subtree)->Enumerate();
+    }
+    catch (const std::exception &excp)
+    {
+        std::cerr << "** ERROR **  " << __func__ << ": "
+                  << excp.what() << std::endl;
+    }
+
+    gchar **ret = g_new0(gchar *, nodes.size() + 1);
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        ret[i] = g_strdup(nodes[i].c_str());
+    }
+    return ret;
+}
+
+
+GDBusInterfaceInfo **_int_subtree_callback_introspect(GDBusConnection *conn,
+                                                      const gchar *sender,
+                                                      const gchar *obj_path,
+                                                      const gchar *node,
+                                                      void *this_ptr)
+{
+    Object::CallbackLink::Ptr cbl = _int_subtree_materialize(this_ptr, obj_path, node);
+    if (!cbl)
+    {
+        return nullptr;
+    }
+
+    GDBusInterfaceInfo *info = nullptr;
+    try
+    {
+        info = (*static_cast<Object::Subtree::Ptr *>(this_ptr))->GetInterfaceInfo(cbl);
+    }
+    catch (const DBus::Exception &excp)
+    {
+        std::cerr << "** ERROR **  " << __func__ << ": "
+                  << excp.what() << std::endl;
+    }
+    if (!info)
+    {
+        return nullptr;
+    }
+
+    // glib2 releases both the array and the interface info references
+    GDBusInterfaceInfo **ret = g_new0(GDBusInterfaceInfo *, 2);
+    ret[0] = info;
+    return ret;
+}
+
+
+const GDBusInterfaceVTable *_int_subtree_callback_dispatch(GDBusConnection *conn,
+                                                           const gchar *sender,
+                                                           const gchar *obj_path,
+                                                           const gchar *intf_name,
+                                                           const gchar *node,
+                                                           gpointer *out_user_data,
+                                                           void *this_ptr)
+{
+    Object::CallbackLink::Ptr cbl = _int_subtree_materialize(this_ptr, obj_path, node);
+    if (!cbl || cbl->object->GetInterface() != intf_name)
+    {
+        return nullptr;
+    }
+    auto &subtree = *static_cast<Object::Subtree::Ptr *>(this_ptr);
+    const GDBusInterfaceVTable *vtable = subtree->GetVTable(cbl);
+    if (!vtable)
+    {
+        return nullptr;
+    }
+
+    // glib2 calls the vtable functions later on, as many times as the
+    // call needs or not at all, without any way to release user data.
+    // The Object::Subtree keeps the CallbackLink until glib2 is done.
+    subtree->KeepAlive(cbl);
+    *out_user_data = cbl.get();
+    return vtable;
+}
+
+
+/**
+ *  Takes a reference to a CallbackLink kept alive by
+ *  _int_subtree_callback_dispatch()
+ *
+ * @param this_ptr  Raw pointer to the Object::CallbackLink
+ *
+ * @return Object::CallbackLink::Ptr keeping the object for this call
+ */
+static Object::CallbackLink::Ptr _int_subtree_link(void *this_ptr)
+{
+    return static_cast<Object::CallbackLink *>(this_ptr)->shared_from_this();
+}
+
+
+void _int_subtree_callback_method_call(GDBusConnection *conn,
+                                       const gchar *sender,
+                                       const gchar *obj_path,
+                                       const gchar *intf_name,
+                                       const gchar *meth_name,
+                                       GVariant *params,
+                                       GDBusMethodInvocation *invoc,
+                                       void *this_ptr)
+{
+    auto link = _int_subtree_link(this_ptr);
+    _int_dbusobject_callback_method_call(conn, sender, obj_path, intf_name, meth_name, params, invoc, link.get());
+}
+
+
+GVariant *_int_subtree_callback_get_property(GDBusConnection *conn,
+                                             const gchar *sender,
+                                             const gchar *obj_path,
+                                             const gchar *intf_name,
+                                             const gchar *property_name,
+                                             GError **error,
+                                             void *this_ptr)
+{
+    auto link = _int_subtree_link(this_ptr);
+    return _int_dbusobject_callback_get_property(conn, sender, obj_path, intf_name, property_name, error, link.get());
+}
+
+
+gboolean _int_subtree_callback_set_property(GDBusConnection *conn,
+                                            const gchar *sender,
+                                            const gchar *obj_path,
+                                            const gchar *intf_name,
+                                            const gchar *property_name,
+                                            GVariant *value,
+                                            GError **error,
+                                            void *this_ptr)
+{
+    auto link = _int_subtree_link(this_ptr);
+    return _int_dbusobject_callback_set_property(conn, sender, obj_path, intf_name, property_name, value, error, link.get());
+}
+
+
+void _int_subtree_callback_destruct(void *this_ptr)
+{
+    delete static_cast<Object::Subtree::Ptr *>(this_ptr);
+}
+
+
 
 void _int_dbus_connection_signal_handler(GDBusConnection *conn,
                                          const gchar *sender,
@@ -451,6 +1286,7 @@ void _int_dbus_connection_signal_handler(GDBusConnection *conn,
                                          GVariant *params,
                                          gpointer this_ptr)
 {
+    sender = _int_sender_busname(sender);
     auto sigsub = static_cast<Signals::SingleSubscription *>(this_ptr);
     if (!sigsub)
     {
@@ -470,8 +1306,8 @@ void _int_dbus_connection_signal_handler(GDBusConnection *conn,
 
     // If the subscription is from a specific target, double check the
     // sender of the signal
-    const char *busname = sigsub->target->GetBusName();
-    if (busname && strcmp(sender, busname) != 0)
+    const std::string busname = sigsub->target->GetBusName();
+    if (!busname.empty() && busname != sender)
     {
         GDBUSPP_LOG("SIGNAL MISMATCH:" << sigsub->target << std::endl
                                        << ", sender=" << sender);
@@ -479,6 +1315,21 @@ void _int_dbus_connection_signal_handler(GDBusConnection *conn,
         return;
     }
 
+    // Object path namespace subscriptions are not filtered by glib2
+    if (sigsub->target->path_namespace && !sigsub->target->MatchPath(obj_path))
+    {
+        return;
+    }
+
+    GDBUSPP_PROBE(signal_dispatch, obj_path, intf_name, sign_name, sender);
+    if (sigsub->view_callback)
+    {
+        const Signals::EventView view(sender, obj_path, intf_name, sign_name, params);
+        GDBUSPP_LOG("Signal Callback:" << view);
+        sigsub->view_callback(view);
+        return;
+    }
+
     auto event = Signals::Event::Create(sender, obj_path, intf_name, sign_name, params);
     GDBUSPP_LOG("Signal Callback:" << event);
     sigsub->callback(event);
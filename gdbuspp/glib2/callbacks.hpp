@@ -64,7 +64,8 @@ void _int_callback_name_lost(GDBusConnection *conn, const gchar *name, void *thi
  *                   contains the data requested to be processed.  This
  *                   contains information about the D-Bus object which the
  *                   operation will be performed in.
- * @param pool_data  (Not used)
+ * @param pool_data  Raw pointer to the AsyncProcess::Pool object owning
+ *                   the glib2 thread pool
  */
 void _int_pool_processpool_cb(void *data, void *pool_data);
 
@@ -77,7 +78,8 @@ void _int_pool_processpool_cb(void *data, void *pool_data);
  *
  *  Once all the information has been gathered and inspected, a
  *  AsyncPool::Request object is created and sent to AsyncProcess::Pool queue
- *  to be processed asynchronously.
+ *  to be processed asynchronously.  Methods declared to run inline are
+ *  processed directly by the calling thread instead.
  *
  * @param conn      GDBusConnection* where the call occurred
  * @param sender    char * containing a unique bus name of the caller
@@ -180,6 +182,141 @@ gboolean _int_dbusobject_callback_set_property(GDBusConnection *conn,
 void _int_dbusobject_callback_destruct(void *this_ptr);
 
 
+/**
+ *  C wrapper function called whenever a method in the
+ *  org.freedesktop.DBus.ObjectManager interface exported by
+ *  DBus::Object::Manager::EnableObjectManager() is called.
+ *
+ * @param conn      GDBusConnection* where the call occurred
+ * @param sender    char * containing a unique bus name of the caller
+ * @param obj_path  char * containing the D-Bus object path to operate on
+ * @param intf_name char * containing the D-Bus interface inside the object
+ * @param meth_name char * containing the D-Bus method name inside the interface
+ * @param params    GVariant * containing all the arguments to the method call
+ * @param invoc     GDBusMethodINvocation * object  where the method respons
+ *                  need to be returned
+ * @param this_ptr  Raw pointer to the DBus::Object::Manager object
+ */
+void _int_objectmanager_callback_method_call(GDBusConnection *conn,
+                                             const gchar *sender,
+                                             const gchar *obj_path,
+                                             const gchar *intf_name,
+                                             const gchar *meth_name,
+                                             GVariant *params,
+                                             GDBusMethodInvocation *invoc,
+                                             void *this_ptr);
+
+
+/**
+ *  C wrapper function called when glib2 needs the child nodes of a
+ *  subtree registered via DBus::Object::Manager::RegisterSubtree()
+ *
+ * @param conn      GDBusConnection* where the call occurred
+ * @param sender    char * containing a unique bus name of the caller
+ * @param obj_path  char * containing the D-Bus path of the subtree root
+ * @param this_ptr  Raw pointer to a DBus::Object::Subtree::Ptr object
+ *
+ * @return gchar** NULL terminated list of node names
+ */
+gchar **_int_subtree_callback_enumerate(GDBusConnection *conn,
+                                        const gchar *sender,
+                                        const gchar *obj_path,
+                                        void *this_ptr);
+
+
+/**
+ *  C wrapper function called when glib2 needs the interface declarations
+ *  of a node in a subtree.  The object is materialized if needed.
+ *
+ * @param conn      GDBusConnection* where the call occurred
+ * @param sender    char * containing a unique bus name of the caller
+ * @param obj_path  char * containing the D-Bus path of the subtree root
+ * @param node      char * containing the node name in the subtree,
+ *                  NULL for the subtree root itself
+ * @param this_ptr  Raw pointer to a DBus::Object::Subtree::Ptr object
+ *
+ * @return GDBusInterfaceInfo** NULL terminated list of interfaces, or
+ *         NULL if the node does not exist
+ */
+GDBusInterfaceInfo **_int_subtree_callback_introspect(GDBusConnection *conn,
+                                                      const gchar *sender,
+                                                      const gchar *obj_path,
+                                                      const gchar *node,
+                                                      void *this_ptr);
+
+
+/**
+ *  C wrapper function called when a D-Bus call arrives for a node in a
+ *  subtree.  The object is materialized if needed and the call is then
+ *  passed on to the regular D-Bus object callback functions.
+ *
+ * @param conn          GDBusConnection* where the call occurred
+ * @param sender        char * containing a unique bus name of the caller
+ * @param obj_path      char * containing the D-Bus path of the subtree root
+ * @param intf_name     char * containing the D-Bus interface being called
+ * @param node          char * containing the node name in the subtree,
+ *                      NULL for the subtree root itself
+ * @param out_user_data Returns the CallbackLink pointer passed on to the
+ *                      object callback functions
+ * @param this_ptr      Raw pointer to a DBus::Object::Subtree::Ptr object
+ *
+ * @return const GDBusInterfaceVTable* with the object callback functions,
+ *         or NULL if the node or interface does not exist
+ */
+const GDBusInterfaceVTable *_int_subtree_callback_dispatch(GDBusConnection *conn,
+                                                           const gchar *sender,
+                                                           const gchar *obj_path,
+                                                           const gchar *intf_name,
+                                                           const gchar *node,
+                                                           gpointer *out_user_data,
+                                                           void *this_ptr);
+
+
+/**
+ *  C wrapper functions for the method calls and property access of
+ *  materialized subtree objects.  These release the pin taken by
+ *  _int_subtree_callback_dispatch() and then call the regular
+ *  _int_dbusobject_callback_* functions.
+ *
+ *  The arguments are the same as for the corresponding
+ *  _int_dbusobject_callback_* functions.
+ */
+void _int_subtree_callback_method_call(GDBusConnection *conn,
+                                       const gchar *sender,
+                                       const gchar *obj_path,
+                                       const gchar *intf_name,
+                                       const gchar *meth_name,
+                                       GVariant *params,
+                                       GDBusMethodInvocation *invoc,
+                                       void *this_ptr);
+
+GVariant *_int_subtree_callback_get_property(GDBusConnection *conn,
+                                             const gchar *sender,
+                                             const gchar *obj_path,
+                                             const gchar *intf_name,
+                                             const gchar *property_name,
+                                             GError **error,
+                                             void *this_ptr);
+
+gboolean _int_subtree_callback_set_property(GDBusConnection *conn,
+                                            const gchar *sender,
+                                            const gchar *obj_path,
+                                            const gchar *intf_name,
+                                            const gchar *property_name,
+                                            GVariant *value,
+                                            GError **error,
+                                            void *this_ptr);
+
+
+/**
+ *  C wrapper function called when a subtree has been unregistered and
+ *  all pending calls have completed.
+ *
+ * @param this_ptr  Raw pointer to a DBus::Object::Subtree::Ptr object
+ */
+void _int_subtree_callback_destruct(void *this_ptr);
+
+
 
 /**
  *  C wrapper functions called by the glib2 stack when a D-Bus signal event
@@ -39,6 +39,16 @@ Exception::Exception::Exception(const std::string &callfunc,
                       gliberr){};
 
 
+VariantType::VariantType(const std::string &sig)
+    : signature(sig)
+{
+    if (!g_variant_type_string_is_valid(signature.c_str()))
+    {
+        throw Utils::Exception("Invalid D-Bus data type: '" + signature + "'");
+    }
+}
+
+
 void CheckCapabilityFD(const GDBusConnection *dbuscon)
 {
     if (!(g_dbus_connection_get_capabilities((GDBusConnection *)dbuscon) & G_DBUS_CAPABILITY_FLAGS_UNIX_FD_PASSING))
@@ -101,6 +111,19 @@ void checkParams(const char *func,
     }
 }
 
+
+void checkParams(const char *func,
+                 GVariant *params,
+                 const VariantType &type,
+                 unsigned int num)
+{
+    if (type.Matches(params))
+    {
+        return;
+    }
+    checkParams(func, params, type.str().c_str(), num);
+}
+
 } // namespace Utils
 
 
@@ -130,6 +153,17 @@ GVariantBuilder *Create(const char *type)
 }
 
 
+Scoped::Scoped(const char *type)
+{
+    if (!g_variant_type_string_is_valid(type))
+    {
+        throw glib2::Utils::Exception("Builder::Scoped()",
+                                      "Invalid data type: " + std::string(type));
+    }
+    g_variant_builder_init(&builder, G_VARIANT_TYPE(type));
+}
+
+
 void OpenChild(GVariantBuilder *builder, const char *type)
 {
     g_variant_builder_open(builder, G_VARIANT_TYPE(type));
@@ -144,9 +178,7 @@ void CloseChild(GVariantBuilder *builder)
 
 GVariant *CreateEmpty(const char *type)
 {
-    GVariantBuilder *b = Builder::Create(type);
-    GVariant *ret = g_variant_builder_end(b);
-    g_variant_builder_unref(b);
+    GVariant *ret = Scoped(type).Finish();
     if (!ret)
     {
         throw glib2::Utils::Exception("Builder::CreateEmpty()",
@@ -177,4 +209,49 @@ GVariant *FinishWrapped(GVariantBuilder *bld) noexcept
 
 } // namespace Builder
 
+
+
+namespace Value {
+
+StringViews ExtractStringViews(glib2::Variant params,
+                               const char *override_type,
+                               bool wrapped)
+{
+    // Only the string types are stored in a way the views can refer to
+    const std::string elmtype = (override_type ? override_type : "s");
+    if ("s" != elmtype && "o" != elmtype && "g" != elmtype)
+    {
+        throw glib2::Utils::Exception("Value::ExtractStringViews()",
+                                      "Not a string data type: '" + elmtype + "'");
+    }
+    const std::string type = std::string(wrapped ? "(a" : "a")
+                             + elmtype + (wrapped ? ")" : "");
+    if (!params
+        || !g_variant_is_of_type(params.get(), G_VARIANT_TYPE(type.c_str())))
+    {
+        throw glib2::Utils::Exception("Value::ExtractStringViews()",
+                                      "Data type mismatch, expected '" + type
+                                          + "', got '" + params.GetTypeString() + "'");
+    }
+
+    // Once serialized, child values refer to the data held by their
+    // container, so the views are valid as long as params is kept.
+    // A container which is not serialized yet frees its children when
+    // it is, which would leave the views dangling.
+    g_variant_get_data(params.get());
+    GVariant *array = (wrapped ? g_variant_get_child_value(params.get(), 0)
+                               : g_variant_ref(params.get()));
+    const gsize count = g_variant_n_children(array);
+    std::vector<std::string_view> views;
+    views.reserve(count);
+    for (gsize i = 0; i < count; ++i)
+    {
+        views.push_back(Extract<std::string_view>(array, static_cast<int>(i)));
+    }
+    g_variant_unref(array);
+    return StringViews(std::move(params), std::move(views));
+}
+
+} // namespace Value
+
 } // namespace glib2
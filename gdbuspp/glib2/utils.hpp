@@ -19,15 +19,23 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <map>
+#include <optional>
+#include <tuple>
+#include <utility>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <sstream>
+#include <unordered_map>
 #include <type_traits>
 
 #include <gio/gunixfdlist.h>
 
 #include "../exceptions.hpp"
 #include "../object/path.hpp"
+#include "variant.hpp"
 
 
 namespace glib2 {
@@ -54,6 +62,56 @@ class Exception : public DBus::Exception
 void CheckCapabilityFD(const GDBusConnection *dbuscon);
 
 
+/**
+ *  Precompiled D-Bus data type, used to validate the data type of
+ *  GVariant objects without creating temporary strings.  The type string
+ *  is validated once when this object is created.
+ */
+class VariantType
+{
+  public:
+    /**
+     * @param signature  std::string with the D-Bus data type string
+     *
+     * @throws glib2::Utils::Exception if the data type string is invalid
+     */
+    explicit VariantType(const std::string &signature);
+
+    /**
+     *  Checks if the GVariant object is of this exact D-Bus data type
+     *
+     * @param value  GVariant object to check
+     * @return true if the data types matches, otherwise false.  A nullptr
+     *         value never matches.
+     */
+    bool Matches(GVariant *value) const noexcept
+    {
+        return value && g_variant_type_equal(g_variant_get_type(value), get());
+    }
+
+    /**
+     * @return const GVariantType* of this D-Bus data type
+     */
+    const GVariantType *get() const noexcept
+    {
+        // The string was validated in the constructor, so it can be
+        // used as a GVariantType directly
+        return reinterpret_cast<const GVariantType *>(signature.c_str());
+    }
+
+    /**
+     * @return const std::string& with the D-Bus data type string
+     */
+    const std::string &str() const noexcept
+    {
+        return signature;
+    }
+
+  private:
+    std::string signature;
+};
+
+
 /**
  * Unreferences an fd list. This is a helper function since the normal
  * g_unref_object does not fit the signature and there seem to be no
@@ -83,6 +141,26 @@ void checkParams(const char *func,
                  const char *format,
                  unsigned int num = 0);
 
+
+/**
+ *  Variant of checkParams() above, using a precompiled D-Bus data type.
+ *  The matching data type is validated without creating any temporary
+ *  strings; only the error path builds the error message.
+ *
+ * @param func     C string containing the calling functions name,
+ *                 used if an exception is thrown
+ * @param params   GVariant* containing the parameters
+ * @param type     VariantType with the expected data type
+ * @param num      Number of child elements in the GVariant object.
+ *                 If 0, element count will not be considered.
+ *
+ * @throws glib2::Utils::Exception
+ */
+void checkParams(const char *func,
+                 GVariant *params,
+                 const VariantType &type,
+                 unsigned int num = 0);
+
 } // namespace Utils
 
 
@@ -115,18 +193,19 @@ namespace DataType {
 const std::string Extract(GVariant *value) noexcept;
 
 
-// Declare template as prototype only so it cannot be used directly
+// Declared as prototype only here; the generic implementation further
+// below resolves container types via the DataType::Signature template
 template <typename T>
-inline const char *DBus() noexcept;
+inline constexpr const char *DBus() noexcept;
 
 template <>
-inline const char *DBus<uint32_t>() noexcept
+inline constexpr const char *DBus<uint32_t>() noexcept
 {
     return "u";
 }
 
 template <>
-inline const char *DBus<int32_t>() noexcept
+inline constexpr const char *DBus<int32_t>() noexcept
 {
     return "i";
 }
@@ -145,31 +224,31 @@ inline typename std::enable_if<sizeof(T) == 4 && std::is_signed<T>::value, const
 #endif
 
 template <>
-inline const char *DBus<uint16_t>() noexcept
+inline constexpr const char *DBus<uint16_t>() noexcept
 {
     return "q";
 }
 
 template <>
-inline const char *DBus<int16_t>() noexcept
+inline constexpr const char *DBus<int16_t>() noexcept
 {
     return "n";
 }
 
 template <>
-inline const char *DBus<uint64_t>() noexcept
+inline constexpr const char *DBus<uint64_t>() noexcept
 {
     return "t";
 }
 
 template <>
-inline const char *DBus<int64_t>() noexcept
+inline constexpr const char *DBus<int64_t>() noexcept
 {
     return "x";
 }
 
 template <>
-inline const char *DBus<std::byte>() noexcept
+inline constexpr const char *DBus<std::byte>() noexcept
 {
     // The D-Bus spec declares 'y' (BYTE) as "unsigned 8-bit integer",
     // but in C/C++ uint8_t has an ambiguity and is typedefed to
@@ -178,29 +257,218 @@ inline const char *DBus<std::byte>() noexcept
 }
 
 template <>
-inline const char *DBus<double>() noexcept
+inline constexpr const char *DBus<double>() noexcept
 {
     return "d";
 }
 
 template <>
-inline const char *DBus<bool>() noexcept
+inline constexpr const char *DBus<bool>() noexcept
 {
     return "b";
 }
 
 template <>
-inline const char *DBus<DBus::Object::Path>() noexcept
+inline constexpr const char *DBus<DBus::Object::Path>() noexcept
 {
     return "o";
 }
 
 template <>
-inline const char *DBus<std::string>() noexcept
+inline constexpr const char *DBus<std::string>() noexcept
 {
     return "s";
 }
 
+template <>
+inline constexpr const char *DBus<GBytes *>() noexcept
+{
+    return "ay";
+}
+
+
+/**
+ *  Checks if the C++ data type is stored in a GVariant array using
+ *  the same fixed size memory layout as in C++.  Arrays of such types
+ *  can be copied as a single memory block, via g_variant_get_fixed_array()
+ *  and g_variant_new_fixed_array().
+ *
+ *  The bool type is not included, as the GVariant boolean representation
+ *  does not need to match the C++ bool representation.
+ *
+ * @tparam T   C++ data type to check
+ * @return true if arrays of this type can be copied directly
+ */
+template <typename T>
+constexpr bool IsFixedSize() noexcept
+{
+    return (std::is_arithmetic<T>::value && !std::is_same<T, bool>::value)
+           || std::is_same<T, std::byte>::value;
+}
+
+
+/**
+ *  Checks if the C++ data type maps directly to a single D-Bus
+ *  data type through one of the DataType::DBus<T>() specializations
+ *  above.
+ *
+ * @tparam T   C++ data type to check
+ * @return true if T is a basic (non-container) data type
+ */
+template <typename T>
+constexpr bool IsBasic() noexcept
+{
+    return std::is_same<T, uint16_t>::value
+           || std::is_same<T, int16_t>::value
+           || std::is_same<T, uint32_t>::value
+           || std::is_same<T, int32_t>::value
+           || std::is_same<T, uint64_t>::value
+           || std::is_same<T, int64_t>::value
+           || std::is_same<T, std::byte>::value
+           || std::is_same<T, double>::value
+           || std::is_same<T, bool>::value
+           || std::is_same<T, DBus::Object::Path>::value
+           || std::is_same<T, std::string>::value
+           || std::is_same<T, GBytes *>::value;
+}
+
+
+namespace _private {
+
+/**
+ *  Fixed length D-Bus type signature, usable in constant expressions.
+ *  The str member is always NUL terminated.
+ *
+ * @tparam N   Length of the signature, excluding the NUL terminator
+ */
+template <std::size_t N>
+struct SignatureString
+{
+    char str[N + 1] = {};
+};
+
+
+constexpr std::size_t signature_length(const char *sig) noexcept
+{
+    std::size_t len = 0;
+    while (sig[len] != '\0')
+    {
+        ++len;
+    }
+    return len;
+}
+
+
+template <std::size_t N>
+constexpr SignatureString<N> signature_from(const char *sig) noexcept
+{
+    SignatureString<N> ret{};
+    for (std::size_t i = 0; i < N; ++i)
+    {
+        ret.str[i] = sig[i];
+    }
+    return ret;
+}
+
+
+template <std::size_t N, std::size_t M>
+constexpr void signature_append(SignatureString<N> &dest,
+                                std::size_t &pos,
+                                const SignatureString<M> &src) noexcept
+{
+    for (std::size_t i = 0; i < M; ++i)
+    {
+        dest.str[pos++] = src.str[i];
+    }
+}
+
+
+template <std::size_t... Ns>
+constexpr SignatureString<(Ns + ... + 0)> signature_concat(const SignatureString<Ns> &...parts) noexcept
+{
+    SignatureString<(Ns + ... + 0)> ret{};
+    std::size_t pos = 0;
+    (signature_append(ret, pos, parts), ...);
+    return ret;
+}
+
+} // namespace _private
+
+
+/**
+ *  Compile-time D-Bus type signature of a C++ data type.  The
+ *  signature is available via the static Signature<T>::value.str member.
+ *
+ *  Besides the basic data types, these C++ containers are supported
+ *  and may be nested:
+ *
+ *    - std::tuple<Ts...>    ->  (...)
+ *    - std::vector<T>       ->  aT
+ *    - std::map<K, V>       ->  a{KV}
+ *    - std::optional<T>     ->  aT  (an array of zero or one element)
+ *
+ *  The D-Bus wire format does not support the GVariant maybe type,
+ *  which is why std::optional is carried as an array.
+ *
+ *  There is no generic definition, so unsupported data types fails
+ *  at compile time.
+ */
+template <typename T, typename Enable = void>
+struct Signature;
+
+template <typename T>
+struct Signature<T, std::enable_if_t<IsBasic<T>()>>
+{
+    static constexpr auto value = _private::signature_from<_private::signature_length(DBus<T>())>(DBus<T>());
+};
+
+template <typename... Ts>
+struct Signature<std::tuple<Ts...>>
+{
+    static constexpr auto value = _private::signature_concat(_private::signature_from<1>("("),
+                                                             Signature<Ts>::value...,
+                                                             _private::signature_from<1>(")"));
+};
+
+template <typename T>
+struct Signature<std::vector<T>>
+{
+    static constexpr auto value = _private::signature_concat(_private::signature_from<1>("a"),
+                                                             Signature<T>::value);
+};
+
+template <typename K, typename V>
+struct Signature<std::map<K, V>>
+{
+    static_assert(IsBasic<K>() && !std::is_same<K, GBytes *>::value,
+                  "D-Bus dictionary keys must be a basic data type");
+    static constexpr auto value = _private::signature_concat(_private::signature_from<2>("a{"),
+                                                             Signature<K>::value,
+                                                             Signature<V>::value,
+                                                             _private::signature_from<1>("}"));
+};
+
+template <typename T>
+struct Signature<std::optional<T>>
+{
+    static constexpr auto value = _private::signature_concat(_private::signature_from<1>("a"),
+                                                             Signature<T>::value);
+};
+
+
+/**
+ *  Generic DataType::DBus<T>() implementation for container types,
+ *  the D-Bus type string is resolved at compile time.
+ *
+ * @tparam T   C++ container data type
+ * @return const char* with the D-Bus data type string
+ */
+template <typename T>
+inline constexpr const char *DBus() noexcept
+{
+    return Signature<T>::value.str;
+}
+
 } // namespace DataType
 
 
@@ -406,6 +674,148 @@ GVariant *Finish(GVariantBuilder *builder) noexcept;
 GVariant *FinishWrapped(GVariantBuilder *bld) noexcept;
 
 
+/**
+ *  GVariantBuilder living on the stack, as an alternative to the
+ *  Create() and Finish() functions which allocate the builder on the
+ *  heap.  The builder is released when the object goes out of scope,
+ *  also if the value was never completed.
+ *
+ *  The Add() methods can be chained:
+ *
+ *    glib2::Builder::Scoped b("a{sv}");
+ *    b.AddFormatted("{sv}", "name", g_variant_new_string("value"))
+ *     .AddFormatted("{sv}", "count", g_variant_new_uint32(2));
+ *    GVariant *dict = b.Finish();
+ *
+ *  Nothing can be added after Finish() or FinishWrapped() has been
+ *  called.
+ */
+class Scoped
+{
+  public:
+    /**
+     *  Prepare an empty builder
+     *
+     * @param type  D-Bus data type this builder container expects
+     *
+     * @throws glib2::Utils::Exception if the data type is invalid
+     */
+    explicit Scoped(const char *type);
+
+    ~Scoped() noexcept
+    {
+        g_variant_builder_clear(&builder);
+    }
+
+    Scoped(const Scoped &) = delete;
+    Scoped &operator=(const Scoped &) = delete;
+
+
+    /**
+     *  Add a value to the builder; see Builder::Add()
+     *
+     * @param value          Templated value to add
+     * @param override_type  (optional) If set, it will use the given type
+     *                       instead of deducting the D-Bus type for T
+     * @return Scoped& to this builder
+     */
+    template <typename T>
+    Scoped &Add(const T &value, const char *override_type = nullptr) noexcept
+    {
+        Builder::Add(&builder, value, override_type);
+        return *this;
+    }
+
+    /**
+     *  Add an already prepared GVariant object to the builder.
+     *  A floating reference is consumed.
+     *
+     * @param value  GVariant object to add
+     * @return Scoped& to this builder
+     */
+    Scoped &Add(GVariant *value) noexcept
+    {
+        g_variant_builder_add_value(&builder, value);
+        return *this;
+    }
+
+    /**
+     *  Add a value described by a GVariant format string, the same way
+     *  as g_variant_builder_add()
+     *
+     * @param format  GVariant format string of the value
+     * @param args    Values to add, as expected by the format string
+     * @return Scoped& to this builder
+     */
+    template <typename... Args>
+    Scoped &AddFormatted(const char *format, Args... args) noexcept
+    {
+        g_variant_builder_add(&builder, format, args...);
+        return *this;
+    }
+
+    /**
+     *  Open a child container; see Builder::OpenChild()
+     *
+     * @param type  D-Bus data type of the child container
+     * @return Scoped& to this builder
+     */
+    Scoped &OpenChild(const char *type) noexcept
+    {
+        g_variant_builder_open(&builder, G_VARIANT_TYPE(type));
+        return *this;
+    }
+
+    /**
+     *  Close the child container opened by OpenChild()
+     *
+     * @return Scoped& to this builder
+     */
+    Scoped &CloseChild() noexcept
+    {
+        g_variant_builder_close(&builder);
+        return *this;
+    }
+
+    /**
+     *  Access to the GVariantBuilder object, for the glib2 functions
+     *  taking one.  The builder is still owned by this object.
+     *
+     * @return GVariantBuilder*
+     */
+    GVariantBuilder *get() noexcept
+    {
+        return &builder;
+    }
+
+    /**
+     *  Complete the value being built
+     *
+     * @return GVariant* with a floating reference to the completed value
+     */
+    GVariant *Finish() noexcept
+    {
+        return g_variant_builder_end(&builder);
+    }
+
+    /**
+     *  Complete the value being built and wrap it into a tuple;
+     *  see Builder::FinishWrapped()
+     *
+     * @return GVariant* with a floating reference to the tuple
+     */
+    GVariant *FinishWrapped() noexcept
+    {
+        GVariant *value = g_variant_builder_end(&builder);
+        return g_variant_new_tuple(&value, 1);
+    }
+
+
+  private:
+    GVariantBuilder builder;
+};
+
+
 } // namespace Builder
 
 
@@ -429,7 +839,8 @@ namespace Value {
  *
  */
 
-// Declare template as prototype only so it cannot be used directly
+// Declared as prototype only here; the generic implementation further
+// below handles the container types supported by DataType::Signature
 template <typename T>
 inline T Get(GVariant *v) noexcept;
 
@@ -520,6 +931,42 @@ inline std::string Get<std::string>(GVariant *v) noexcept
     return std::string((val ? val : ""));
 }
 
+/**
+ *  Retrieve a string value without copying it.  The returned view
+ *  borrows the string stored in the GVariant object and is only valid
+ *  as long as that object exists.
+ */
+template <>
+inline std::string_view Get<std::string_view>(GVariant *v) noexcept
+{
+    gsize len = 0;
+    const char *val = g_variant_get_string(v, &len);
+    return (val ? std::string_view(val, len) : std::string_view());
+}
+
+/**
+ *  Retrieve the content of a byte array (ay) GVariant object as a
+ *  GBytes object, without copying the data.
+ *
+ *  The returned GBytes object must be released with g_bytes_unref()
+ */
+template <>
+inline GBytes *Get<GBytes *>(GVariant *v) noexcept
+{
+    return g_variant_get_data_as_bytes(v);
+}
+
+/**
+ *  Retrieve a new reference of a GVariant object in an owning
+ *  glib2::Variant handle.  This allows GetProperty<glib2::Variant>()
+ *  and Extract<glib2::Variant>() to return values of any type.
+ */
+template <>
+inline glib2::Variant Get<glib2::Variant>(GVariant *v) noexcept
+{
+    return glib2::Variant::Borrow(v);
+}
+
 
 /*
  * These methods extracts values from a GVariant object containing
@@ -528,7 +975,8 @@ inline std::string Get<std::string>(GVariant *v) noexcept
  * work more reliable and with with less surprises.
  */
 
-// Declare template as prototype only so it cannot be used directly
+// Declared as prototype only here; the generic implementation further
+// below handles the container types supported by DataType::Signature
 template <typename T>
 inline T Extract(GVariant *v, int elm) noexcept;
 
@@ -614,6 +1062,15 @@ inline DBus::Object::Path Extract<DBus::Object::Path>(GVariant *v, int elm) noex
     return ret;
 }
 
+template <>
+inline GBytes *Extract<GBytes *>(GVariant *v, int elm) noexcept
+{
+    GVariant *bv = g_variant_get_child_value(v, elm);
+    GBytes *ret = Get<GBytes *>(bv);
+    g_variant_unref(bv);
+    return ret;
+}
+
 template <>
 inline std::string Extract<std::string>(GVariant *v, int elm) noexcept
 {
@@ -623,12 +1080,153 @@ inline std::string Extract<std::string>(GVariant *v, int elm) noexcept
     return ret;
 }
 
+/**
+ *  Extract a string value from a tuple without copying it.  The
+ *  container is serialized first, if it is not already; a child value
+ *  then refers to the serialized data held by its container.  The
+ *  returned view is thus valid as long as the container GVariant object
+ *  exists.  Without this, a container built via g_variant_new() would
+ *  free its children once serialized, for example when it is sent.
+ */
+template <>
+inline std::string_view Extract<std::string_view>(GVariant *v, int elm) noexcept
+{
+    g_variant_get_data(v);
+    GVariant *bv = g_variant_get_child_value(v, elm);
+    std::string_view ret = Get<std::string_view>(bv);
+    g_variant_unref(bv);
+    return ret;
+}
+
+
+namespace _private {
+
+// Container parsers used by the generic Get<T>() implementation
+template <typename T>
+struct Unmarshal;
+
+template <typename... Ts>
+struct Unmarshal<std::tuple<Ts...>>
+{
+    static std::tuple<Ts...> Get(GVariant *v) noexcept
+    {
+        return extract(v, std::index_sequence_for<Ts...>{});
+    }
+
+  private:
+    template <std::size_t... I>
+    static std::tuple<Ts...> extract(GVariant *v, std::index_sequence<I...>) noexcept
+    {
+        return std::tuple<Ts...>(Value::Extract<Ts>(v, I)...);
+    }
+};
+
+template <typename T>
+struct Unmarshal<std::vector<T>>
+{
+    static std::vector<T> Get(GVariant *v) noexcept
+    {
+        if constexpr (DataType::IsFixedSize<T>())
+        {
+            gsize count = 0;
+            auto elements = static_cast<const T *>(g_variant_get_fixed_array(v,
+                                                                             &count,
+                                                                             sizeof(T)));
+            return std::vector<T>(elements, elements + count);
+        }
+        else
+        {
+            std::vector<T> ret;
+            const gsize count = g_variant_n_children(v);
+            ret.reserve(count);
+            for (gsize i = 0; i < count; ++i)
+            {
+                ret.emplace_back(Value::Extract<T>(v, i));
+            }
+            return ret;
+        }
+    }
+};
+
+template <typename K, typename V>
+struct Unmarshal<std::map<K, V>>
+{
+    static std::map<K, V> Get(GVariant *v) noexcept
+    {
+        std::map<K, V> ret;
+        const gsize count = g_variant_n_children(v);
+        for (gsize i = 0; i < count; ++i)
+        {
+            GVariant *entry = g_variant_get_child_value(v, i);
+            ret.emplace(Value::Extract<K>(entry, 0), Value::Extract<V>(entry, 1));
+            g_variant_unref(entry);
+        }
+        return ret;
+    }
+};
+
+template <typename T>
+struct Unmarshal<std::optional<T>>
+{
+    static std::optional<T> Get(GVariant *v) noexcept
+    {
+        if (g_variant_n_children(v) == 0)
+        {
+            return std::nullopt;
+        }
+        return Value::Extract<T>(v, 0);
+    }
+};
+
+} // namespace _private
+
+
+/**
+ *  Generic Get<T>() implementation for container types.  The GVariant
+ *  object is parsed in a single pass, without any runtime parsing of
+ *  D-Bus type strings.  The D-Bus data type must match the one given
+ *  by DataType::DBus<T>().
+ *
+ * @tparam T   C++ container type (std::tuple, std::vector, std::map
+ *             or std::optional)
+ * @param v    GVariant object to parse
+ * @return T
+ */
+template <typename T>
+inline T Get(GVariant *v) noexcept
+{
+    return _private::Unmarshal<T>::Get(v);
+}
+
+
+/**
+ *  Generic Extract<T>() implementation for container types, extracting
+ *  the child element at the given position via Get<T>().
+ *
+ * @tparam T   C++ container type
+ * @param v    GVariant object containing the element
+ * @param elm  Element index to extract
+ * @return T
+ */
+template <typename T>
+inline T Extract(GVariant *v, int elm) noexcept
+{
+    GVariant *bv = g_variant_get_child_value(v, elm);
+    T ret = Get<T>(bv);
+    g_variant_unref(bv);
+    return ret;
+}
+
 
 /**
  *  Parses a GVariant object containing a an array/list of a single
  *  D-Bus data type into a C++ std::vector of the same corresponding
  *  data type.
  *
+ *  NOTE: The params object is released with g_variant_unref() when
+ *        parsed.  The glib2::Variant overload below makes this
+ *        ownership transfer explicit.
+ *
  * @tparam T              Data type of the std::vector result type
  * @param params          GVariant pointer to the data to parse
  * @param override_type   (optional) Override the data type. Normally extracted
@@ -642,6 +1240,33 @@ inline std::vector<T> ExtractVector(GVariant *params,
                                     const char *override_type = nullptr,
                                     bool wrapped = true) noexcept
 {
+    static_assert(!std::is_same_v<T, std::string_view>,
+                  "The parsed object is released; use ExtractStringViews()");
+
+    if constexpr (DataType::IsFixedSize<T>())
+    {
+        // Fixed size element types are copied as a single memory block
+        // instead of extracting each element separately
+        const std::string elmtype = (override_type ? override_type : DataType::DBus<T>());
+        GVariant *array = (wrapped && g_variant_is_of_type(params, G_VARIANT_TYPE_TUPLE)
+                                   && g_variant_n_children(params) == 1
+                               ? g_variant_get_child_value(params, 0)
+                               : g_variant_ref(params));
+        if (elmtype == DataType::DBus<T>()
+            && g_variant_is_of_type(array, G_VARIANT_TYPE(("a" + elmtype).c_str())))
+        {
+            gsize count = 0;
+            auto elements = static_cast<const T *>(g_variant_get_fixed_array(array,
+                                                                             &count,
+                                                                             sizeof(T)));
+            std::vector<T> ret(elements, elements + count);
+            g_variant_unref(array);
+            g_variant_unref(params);
+            return ret;
+        }
+        g_variant_unref(array);
+    }
+
     std::stringstream type;
     type << (wrapped ? "(" : "")
          << "a"
@@ -666,6 +1291,97 @@ inline std::vector<T> ExtractVector(GVariant *params,
 }
 
 
+/**
+ *  A variant of ExtractVector() taking the GVariant object from an
+ *  owning glib2::Variant handle.  The ExtractVector() function releases
+ *  the object it parses; this makes the transfer of the ownership
+ *  explicit at the call site.
+ *
+ * @tparam T              Data type of the std::vector result type
+ * @param params          glib2::Variant with the object to parse
+ * @param override_type   D-Bus data type to use instead of the default
+ *                        one for the C++ data type
+ * @param wrapped         Is the result wrapped as a tuple
+ * @return std::vector<T>
+ */
+template <typename T>
+inline std::vector<T> ExtractVector(glib2::Variant &&params,
+                                    const char *override_type = nullptr,
+                                    bool wrapped = true) noexcept
+{
+    return ExtractVector<T>(params.Release(), override_type, wrapped);
+}
+
+
+/**
+ *  List of std::string_view values borrowed from a GVariant string
+ *  array, returned by ExtractStringViews().  It holds a reference to the
+ *  GVariant object, so the views stay valid as long as this object
+ *  exists; also when it is moved.
+ */
+class StringViews
+{
+  public:
+    using const_iterator = std::vector<std::string_view>::const_iterator;
+
+    StringViews(glib2::Variant &&owner_, std::vector<std::string_view> &&views_) noexcept
+        : owner(std::move(owner_)), views(std::move(views_))
+    {
+    }
+
+    const_iterator begin() const noexcept
+    {
+        return views.begin();
+    }
+
+    const_iterator end() const noexcept
+    {
+        return views.end();
+    }
+
+    size_t size() const noexcept
+    {
+        return views.size();
+    }
+
+    bool empty() const noexcept
+    {
+        return views.empty();
+    }
+
+    const std::string_view &operator[](const size_t idx) const noexcept
+    {
+        return views[idx];
+    }
+
+  private:
+    glib2::Variant owner;
+    std::vector<std::string_view> views;
+};
+
+
+/**
+ *  Parses a GVariant object containing an array of strings, object
+ *  paths or signatures, like ExtractVector<std::string>(), but without
+ *  copying the strings.  This is useful when the values are only
+ *  compared or looked up.
+ *
+ * @param params         glib2::Variant with the object to parse.  Pass
+ *                       glib2::Variant::Copy() to keep the handle.
+ * @param override_type  (optional) D-Bus data type of the elements; "s",
+ *                       "o" or "g".  The default is "s".
+ * @param wrapped        Is the array wrapped as a tuple
+ *
+ * @return StringViews holding the views and the GVariant object
+ *
+ * @throws glib2::Utils::Exception if the data type does not match or
+ *         override_type is not a string type
+ */
+StringViews ExtractStringViews(glib2::Variant params,
+                               const char *override_type = nullptr,
+                               bool wrapped = true);
+
+
 /**
  *  Templatized wrapper for g_variant_new() which returns a
  *  GVariant object with the provided D-Bus data type and value
@@ -756,6 +1472,36 @@ inline GVariant *Create(std::string value) noexcept
     return g_variant_new("s", value.c_str());
 }
 
+/**
+ *  Variant of the @Create function above, wrapping the data of a GBytes
+ *  object into a byte array (ay) GVariant object without copying it.
+ *
+ *  The GVariant object takes its own reference to the GBytes object.
+ *
+ * @param value        GBytes object with the data
+ * @return GVariant*
+ */
+template <>
+inline GVariant *Create(GBytes *value) noexcept
+{
+    return g_variant_new_from_bytes(G_VARIANT_TYPE_BYTESTRING, value, true);
+}
+
+
+// Container variants of Create(), declared up-front so they can
+// be nested inside each other
+template <typename... Ts>
+inline GVariant *Create(const std::tuple<Ts...> &value) noexcept;
+
+template <typename T>
+inline GVariant *Create(const std::vector<T> &value) noexcept;
+
+template <typename K, typename V>
+inline GVariant *Create(const std::map<K, V> &value) noexcept;
+
+template <typename T>
+inline GVariant *Create(const std::optional<T> &value) noexcept;
+
 
 /**
  *  Converts a std::vector<T> to a D-Bus compliant
@@ -772,11 +1518,118 @@ template <typename T>
 inline GVariant *CreateVector(const std::vector<T> &input,
                               const char *override_type = nullptr) noexcept
 {
-    GVariantBuilder *bld = Builder::FromVector(input, override_type);
-    GVariant *ret = g_variant_builder_end(bld);
-    g_variant_builder_unref(bld);
+    if constexpr (DataType::IsFixedSize<T>())
+    {
+        // Fixed size element types are copied as a single memory block
+        if (!override_type || std::string(override_type) == DataType::DBus<T>())
+        {
+            return g_variant_new_fixed_array(G_VARIANT_TYPE(DataType::DBus<T>()),
+                                             input.data(),
+                                             input.size(),
+                                             sizeof(T));
+        }
+    }
 
-    return ret;
+    if constexpr (!DataType::IsBasic<T>())
+    {
+        // Container element types are created directly as child
+        // values, without parsing the D-Bus type string
+        std::vector<GVariant *> children;
+        children.reserve(input.size());
+        for (const auto &elm : input)
+        {
+            children.push_back(Create(elm));
+        }
+        return g_variant_new_array(G_VARIANT_TYPE(override_type ? override_type : DataType::DBus<T>()),
+                                   children.data(),
+                                   children.size());
+    }
+    else
+    {
+        GVariantBuilder *bld = Builder::FromVector(input, override_type);
+        GVariant *ret = g_variant_builder_end(bld);
+        g_variant_builder_unref(bld);
+
+        return ret;
+    }
+}
+
+
+/**
+ *  Variant of the @Create function, creating a D-Bus struct of a
+ *  std::tuple.  Each element is created through its own Create()
+ *  call, the D-Bus type is DataType::DBus<std::tuple<Ts...>>().
+ *
+ * @param value        std::tuple with the values to store in GVariant
+ * @return GVariant*
+ */
+template <typename... Ts>
+inline GVariant *Create(const std::tuple<Ts...> &value) noexcept
+{
+    GVariant *children[sizeof...(Ts) > 0 ? sizeof...(Ts) : 1] = {};
+    std::apply([&children](const auto &...elm)
+               {
+                   std::size_t i = 0;
+                   ((children[i++] = Create(elm)), ...);
+               },
+               value);
+    return g_variant_new_tuple(children, sizeof...(Ts));
+}
+
+
+/**
+ *  Variant of the @Create function, creating a D-Bus array of a
+ *  std::vector.  This is the same as CreateVector() without an
+ *  override type.
+ *
+ * @param value        std::vector with the values to store in GVariant
+ * @return GVariant*
+ */
+template <typename T>
+inline GVariant *Create(const std::vector<T> &value) noexcept
+{
+    return CreateVector(value);
+}
+
+
+/**
+ *  Variant of the @Create function, creating a D-Bus dictionary
+ *  (a{KV}) of a std::map.
+ *
+ * @param value        std::map with the values to store in GVariant
+ * @return GVariant*
+ */
+template <typename K, typename V>
+inline GVariant *Create(const std::map<K, V> &value) noexcept
+{
+    std::vector<GVariant *> entries;
+    entries.reserve(value.size());
+    for (const auto &[key, val] : value)
+    {
+        entries.push_back(g_variant_new_dict_entry(Create(key), Create(val)));
+    }
+    // Skip the leading 'a' of the dictionary type to get the entry type
+    const char *entrytype = DataType::DBus<std::map<K, V>>() + 1;
+    return g_variant_new_array(G_VARIANT_TYPE(entrytype),
+                               entries.data(),
+                               entries.size());
+}
+
+
+/**
+ *  Variant of the @Create function, creating a D-Bus array with
+ *  zero or one element of a std::optional.
+ *
+ * @param value        std::optional with the value to store in GVariant
+ * @return GVariant*
+ */
+template <typename T>
+inline GVariant *Create(const std::optional<T> &value) noexcept
+{
+    GVariant *child = (value.has_value() ? Create(*value) : nullptr);
+    return g_variant_new_array(G_VARIANT_TYPE(DataType::DBus<T>()),
+                               (child ? &child : nullptr),
+                               (child ? 1 : 0));
 }
 
 
@@ -860,6 +1713,223 @@ T Lookup(GVariant *dict, const std::string &key)
     return ret;
 }
 
+
+/**
+ *  Declarative mapping between the members of a C++ struct and the keys
+ *  of a GVariant based 'a{sv}' dictionary.
+ *
+ *  Each struct member is bound to a dictionary key and the D-Bus data
+ *  type derived from the C++ type of the member.  Decoding walks the
+ *  dictionary once and looks up each key in a precomputed index, instead
+ *  of searching the dictionary once per key as Dict::Lookup() does.
+ *
+ *  The result of org.freedesktop.DBus.Properties.GetAll, both as 'a{sv}'
+ *  and wrapped in a '(a{sv})' tuple, can be decoded directly.
+ *
+ *  Example:
+ *
+ *     struct Config { std::string name; uint32_t port = 0; bool enabled = false; };
+ *
+ *     glib2::Value::Dict::Mapping<Config> map;
+ *     map.Field("name", &Config::name)
+ *        .Field("port", &Config::port)
+ *        .Field("enabled", &Config::enabled);
+ *
+ *     Config cfg = map.Decode(dict);
+ *     GVariant *d = map.Encode(cfg);
+ *
+ * @tparam S  C++ struct type the dictionary is mapped to
+ */
+template <typename S>
+class Mapping
+{
+  public:
+    Mapping() = default;
+
+    Mapping(const Mapping &orig)
+        : bindings(orig.bindings)
+    {
+        rebuild_index();
+    }
+
+    Mapping &operator=(const Mapping &orig)
+    {
+        bindings = orig.bindings;
+        rebuild_index();
+        return *this;
+    }
+
+    /**
+     *  Bind a struct member to a dictionary key
+     *
+     * @tparam T      C++ data type of the struct member
+     * @param key     std::string with the dictionary key
+     * @param member  Pointer to the struct member
+     * @return Mapping<S>& to allow chaining more Field() calls
+     */
+    template <typename T>
+    Mapping &Field(const std::string &key, T S::*member)
+    {
+        if (index.find(key) != index.end())
+        {
+            throw glib2::Utils::Exception("Dict::Mapping",
+                                          "Duplicated key '" + key + "'");
+        }
+        Binding b;
+        b.key = key;
+        b.type = DataType::DBus<T>();
+        b.decode = [member](S &target, GVariant *v)
+        {
+            target.*member = Value::Get<T>(v);
+        };
+        b.encode = [member](const S &source) -> GVariant *
+        {
+            return Value::Create(source.*member);
+        };
+        bindings.push_back(std::move(b));
+        rebuild_index();
+        return *this;
+    }
+
+
+    /**
+     *  Decode a dictionary into an existing struct.  Keys without a
+     *  binding are ignored and members without a matching key in the
+     *  dictionary are left untouched.
+     *
+     * @param dict    GVariant object containing the 'a{sv}' or
+     *                '(a{sv})' dictionary
+     * @param target  Struct to update with the dictionary values
+     * @throw glib2::Utils::Exception if the dictionary is invalid or
+     *        a value has a different data type than its member
+     */
+    void Decode(GVariant *dict, S &target) const
+    {
+        if (!dict)
+        {
+            throw glib2::Utils::Exception("Dict::Mapping",
+                                          "No dictionary to decode");
+        }
+        GVariant *d = dict;
+        if (g_variant_is_of_type(dict, G_VARIANT_TYPE("(a{sv})")))
+        {
+            d = g_variant_get_child_value(dict, 0);
+        }
+        else if (!g_variant_is_of_type(dict, G_VARIANT_TYPE("a{sv}")))
+        {
+            throw glib2::Utils::Exception("Dict::Mapping",
+                                          std::string("Unexpected data type '")
+                                              + g_variant_get_type_string(dict)
+                                              + "', expected 'a{sv}'");
+        }
+
+        GVariantIter iter;
+        g_variant_iter_init(&iter, d);
+        const gchar *key = nullptr;
+        GVariant *value = nullptr;
+        try
+        {
+            while (g_variant_iter_next(&iter, "{&sv}", &key, &value))
+            {
+                auto it = index.find(std::string_view(key));
+                if (it != index.end())
+                {
+                    const Binding &b = bindings[it->second];
+                    if (!g_variant_is_of_type(value, G_VARIANT_TYPE(b.type)))
+                    {
+                        throw glib2::Utils::Exception("Dict::Mapping",
+                                                      "Key '" + b.key + "' has data type '"
+                                                          + g_variant_get_type_string(value)
+                                                          + "', expected '" + b.type + "'");
+                    }
+                    b.decode(target, value);
+                }
+                g_variant_unref(value);
+                value = nullptr;
+            }
+        }
+        catch (...)
+        {
+            g_variant_unref(value);
+            if (d != dict)
+            {
+                g_variant_unref(d);
+            }
+            throw;
+        }
+        if (d != dict)
+        {
+            g_variant_unref(d);
+        }
+    }
+
+
+    /**
+     *  Decode a dictionary into a new struct.  Members without a matching
+     *  key in the dictionary keep their default values.
+     *
+     * @param dict  GVariant object containing the 'a{sv}' or '(a{sv})'
+     *              dictionary
+     * @return S    New struct with the dictionary values
+     * @throw glib2::Utils::Exception if the dictionary is invalid or
+     *        a value has a different data type than its member
+     */
+    S Decode(GVariant *dict) const
+    {
+        S ret{};
+        Decode(dict, ret);
+        return ret;
+    }
+
+
+    /**
+     *  Encode all the bound members of a struct into a new 'a{sv}'
+     *  dictionary
+     *
+     * @param source  Struct to encode
+     * @return GVariant* with the floating 'a{sv}' dictionary
+     */
+    GVariant *Encode(const S &source) const
+    {
+        std::vector<GVariant *> entries;
+        entries.reserve(bindings.size());
+        for (const auto &b : bindings)
+        {
+            entries.push_back(g_variant_new_dict_entry(g_variant_new_string(b.key.c_str()),
+                                                       g_variant_new_variant(b.encode(source))));
+        }
+        return g_variant_new_array(G_VARIANT_TYPE("{sv}"),
+                                   entries.data(),
+                                   entries.size());
+    }
+
+
+  private:
+    struct Binding
+    {
+        std::string key;
+        const char *type;
+        std::function<void(S &, GVariant *)> decode;
+        std::function<GVariant *(const S &)> encode;
+    };
+
+    std::vector<Binding> bindings{};
+    std::unordered_map<std::string_view, size_t> index{};
+
+    /**
+     *  The index refers to the keys stored in the bindings, which may
+     *  have moved when the bindings vector grew or was copied
+     */
+    void rebuild_index()
+    {
+        index.clear();
+        for (size_t i = 0; i < bindings.size(); ++i)
+        {
+            index.emplace(bindings[i].key, i);
+        }
+    }
+};
+
 } // namespace Dict
 
 } // namespace Value
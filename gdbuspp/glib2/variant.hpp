@@ -0,0 +1,183 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file   glib2/variant.hpp
+ *
+ * @brief  Declaration of glib2::Variant, a move-only owning handle of
+ *         a GVariant object
+ */
+
+#pragma once
+
+#include <string>
+#include <glib.h>
+
+
+namespace glib2 {
+
+/**
+ *  Move-only handle owning a single reference of a GVariant object.
+ *  The reference is released when the handle goes out of scope.
+ *
+ *  The handle is aware of floating references.  A floating GVariant
+ *  object, such as those returned by g_variant_new() and
+ *  glib2::Value::Create(), is sunk when taken over, which does not add
+ *  any reference.  A non-floating object, such as those returned by
+ *  DBus::Proxy::Client::Call(), is taken over as is.
+ *
+ *  Functions taking a raw GVariant pointer can be given the object via
+ *  get() or Release(), depending on whether they take over the
+ *  reference or not.
+ */
+class Variant
+{
+  public:
+    /**
+     *  An empty handle, not owning any GVariant object
+     */
+    Variant() noexcept = default;
+
+    /**
+     *  Take over the ownership of a GVariant object.  A floating
+     *  reference is sunk, any other reference is adopted as is.
+     *
+     * @param v  GVariant object to own, may be nullptr
+     */
+    explicit Variant(GVariant *v) noexcept
+        : value(v)
+    {
+        if (value && g_variant_is_floating(value))
+        {
+            g_variant_ref_sink(value);
+        }
+    }
+
+    /**
+     *  Create a handle with a new reference to a GVariant object the
+     *  caller keeps owning, such as a child value or an object passed
+     *  to a callback.
+     *
+     * @param v        GVariant object to reference, may be nullptr
+     * @return Variant owning the new reference
+     */
+    static Variant Borrow(GVariant *v) noexcept
+    {
+        return Variant(v ? g_variant_ref(v) : nullptr, true);
+    }
+
+    ~Variant() noexcept
+    {
+        reset();
+    }
+
+    Variant(const Variant &) = delete;
+    Variant &operator=(const Variant &) = delete;
+
+    Variant(Variant &&orig) noexcept
+        : value(orig.value)
+    {
+        orig.value = nullptr;
+    }
+
+    Variant &operator=(Variant &&orig) noexcept
+    {
+        if (this != &orig)
+        {
+            reset();
+            value = orig.value;
+            orig.value = nullptr;
+        }
+        return *this;
+    }
+
+    /**
+     *  Create a new handle with its own reference to the same
+     *  GVariant object.  GVariant objects are immutable, so this does
+     *  not copy any data.
+     */
+    Variant Copy() const noexcept
+    {
+        return Borrow(value);
+    }
+
+    /**
+     * @return GVariant* owned by this handle, or nullptr.  The handle
+     *         keeps the ownership.
+     */
+    GVariant *get() const noexcept
+    {
+        return value;
+    }
+
+    /**
+     *  Give up the ownership of the GVariant object.  The caller
+     *  becomes responsible for releasing it with g_variant_unref().
+     *
+     * @return GVariant* previously owned by this handle, or nullptr
+     */
+    GVariant *Release() noexcept
+    {
+        GVariant *ret = value;
+        value = nullptr;
+        return ret;
+    }
+
+    /**
+     *  Release the owned GVariant object, leaving the handle empty
+     */
+    void reset() noexcept
+    {
+        if (value)
+        {
+            g_variant_unref(value);
+            value = nullptr;
+        }
+    }
+
+    explicit operator bool() const noexcept
+    {
+        return value != nullptr;
+    }
+
+    /**
+     * @return std::string with the D-Bus data type of the owned
+     *         GVariant object.  Empty if the handle is empty.
+     */
+    std::string GetTypeString() const
+    {
+        return (value ? g_variant_get_type_string(value) : "");
+    }
+
+    /**
+     * @return std::string with a human readable representation of the
+     *         owned GVariant object
+     */
+    std::string Print(bool type_annotate = false) const
+    {
+        if (!value)
+        {
+            return "(none)";
+        }
+        gchar *str = g_variant_print(value, type_annotate);
+        std::string ret(str ? str : "");
+        g_free(str);
+        return ret;
+    }
+
+
+  private:
+    GVariant *value = nullptr;
+
+    Variant(GVariant *v, bool) noexcept
+        : value(v)
+    {
+    }
+};
+
+} // namespace glib2
@@ -13,6 +13,10 @@
  */
 
 
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <thread>
 #include <glib.h>
 #include <glib-unix.h>
 
@@ -34,7 +38,7 @@ namespace _private {
 
 /**
  *  Internal mainloop object.  One process can only have one active
- *  mainloop
+ *  mainloop on the default main context
  */
 GMainLoop *_int_glib2_mainloop = nullptr;
 } // namespace _private
@@ -46,8 +50,161 @@ MainLoop::Exception::Exception(const std::string &errm)
 }
 
 
+/**
+ *  Run state of a main loop on a private main context.  This is shared
+ *  between the MainLoop object and the thread running the loop, so the
+ *  thread never depends on the MainLoop object still existing.
+ */
+struct MainLoop::LoopState
+{
+    GMainContext *context = nullptr; ///< Private main context
+    GMainLoop *loop = nullptr;       ///< The main loop, while running
+    std::thread::id loop_thread{};   ///< Thread running the loop
+    std::mutex mtx;
+    std::condition_variable stopped;
+
+    LoopState()
+        : context(g_main_context_new())
+    {
+    }
+
+    ~LoopState() noexcept
+    {
+        g_main_context_unref(context);
+    }
+
+    /**
+     *  Prepare a new main loop on this context
+     *
+     * @return GMainLoop* with a new reference, for the thread running it
+     * @throws DBus::MainLoop::Exception if the loop is already running
+     */
+    GMainLoop *prepare()
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        if (loop)
+        {
+            throw MainLoop::Exception("This main loop is already running");
+        }
+        loop = g_main_loop_new(context, false);
+        return g_main_loop_ref(loop);
+    }
+
+    /**
+     *  Run a main loop prepared by prepare() in the calling thread
+     *
+     * @param ml  GMainLoop* to run; the reference is consumed
+     */
+    void run(GMainLoop *ml)
+    {
+        {
+            std::lock_guard<std::mutex> guard(mtx);
+            loop_thread = std::this_thread::get_id();
+        }
+        g_main_context_push_thread_default(context);
+        g_main_loop_run(ml);
+        g_main_context_pop_thread_default(context);
+
+        std::lock_guard<std::mutex> guard(mtx);
+        if (loop == ml)
+        {
+            g_main_loop_unref(loop);
+            loop = nullptr;
+        }
+        loop_thread = std::thread::id();
+        g_main_loop_unref(ml);
+        stopped.notify_all();
+    }
+
+    /**
+     *  Request the main loop to quit.  This is done from within the main
+     *  loop itself, which also covers a loop not yet being run by its
+     *  thread.
+     *
+     * @return true if a running loop was found, otherwise false
+     */
+    bool quit()
+    {
+        std::lock_guard<std::mutex> guard(mtx);
+        if (!loop)
+        {
+            return false;
+        }
+        GSource *src = g_idle_source_new();
+        g_source_set_callback(src,
+                              [](gpointer ml) -> gboolean
+                              {
+                                  g_main_loop_quit(static_cast<GMainLoop *>(ml));
+                                  return G_SOURCE_REMOVE;
+                              },
+                              g_main_loop_ref(loop),
+                              (GDestroyNotify)g_main_loop_unref);
+        g_source_attach(src, context);
+        g_source_unref(src);
+        return true;
+    }
+};
+
+
+MainLoop::ContextScope::ContextScope(const MainLoop::Ptr loop) noexcept
+    : context(loop ? loop->GetContext() : nullptr)
+{
+    if (context)
+    {
+        g_main_context_push_thread_default(context);
+    }
+}
+
+
+MainLoop::ContextScope::~ContextScope() noexcept
+{
+    if (context)
+    {
+        g_main_context_pop_thread_default(context);
+    }
+}
+
+
+MainLoop::MainLoop(const bool private_context)
+    : state(private_context ? std::make_shared<LoopState>() : nullptr)
+{
+}
+
+
+MainLoop::~MainLoop() noexcept
+{
+    ReleaseExternal();
+    if (!loop_thread.joinable())
+    {
+        return;
+    }
+    if (state)
+    {
+        state->quit();
+    }
+    if (std::this_thread::get_id() == loop_thread.get_id())
+    {
+        // The last reference was released by the loop thread itself;
+        // it will exit on its own once the quit request is processed
+        loop_thread.detach();
+        return;
+    }
+    if (!state && _private::_int_glib2_mainloop)
+    {
+        g_main_loop_quit(_private::_int_glib2_mainloop);
+    }
+    loop_thread.join();
+}
+
+
 void MainLoop::Run()
 {
+    if (state)
+    {
+        state->run(state->prepare());
+        return;
+    }
+
     if (_private::_int_glib2_mainloop)
     {
         throw MainLoop::Exception("A main loop is already running");
@@ -61,8 +218,62 @@ void MainLoop::Run()
 }
 
 
+void MainLoop::Start()
+{
+    if (loop_thread.joinable())
+    {
+        if (Running())
+        {
+            throw MainLoop::Exception("This main loop is already running");
+        }
+        loop_thread.join();
+    }
+
+    if (state)
+    {
+        GMainLoop *ml = state->prepare();
+        loop_thread = std::thread([st = state, ml]()
+                                  {
+                                      st->run(ml);
+                                  });
+        return;
+    }
+
+    if (_private::_int_glib2_mainloop)
+    {
+        throw MainLoop::Exception("A main loop is already running");
+    }
+    loop_thread = std::thread([this]()
+                              {
+                                  Run();
+                              });
+}
+
+
 void MainLoop::Wait()
 {
+    if (loop_thread.joinable()
+        && std::this_thread::get_id() != loop_thread.get_id())
+    {
+        loop_thread.join();
+        return;
+    }
+
+    if (state)
+    {
+        std::unique_lock<std::mutex> lock(state->mtx);
+        if (std::this_thread::get_id() == state->loop_thread)
+        {
+            // Waiting from within the main loop would never return
+            return;
+        }
+        state->stopped.wait(lock, [st = state.get()]()
+                            {
+                                return nullptr == st->loop;
+                            });
+        return;
+    }
+
     if (_private::_int_glib2_mainloop)
     {
         g_main_loop_run(_private::_int_glib2_mainloop);
@@ -72,12 +283,26 @@ void MainLoop::Wait()
 
 bool MainLoop::Running() const
 {
+    if (state)
+    {
+        std::lock_guard<std::mutex> guard(state->mtx);
+        return state->loop != nullptr;
+    }
     return _private::_int_glib2_mainloop != nullptr;
 }
 
 
 void MainLoop::Stop()
 {
+    if (state)
+    {
+        if (!state->quit())
+        {
+            throw MainLoop::Exception("No main loop is running");
+        }
+        return;
+    }
+
     if (!_private::_int_glib2_mainloop)
     {
         throw MainLoop::Exception("No main loop is running");
@@ -87,4 +312,105 @@ void MainLoop::Stop()
 }
 
 
+GMainContext *MainLoop::GetContext() const noexcept
+{
+    return (state ? state->context : nullptr);
+}
+
+
+void MainLoop::PrepareExternal()
+{
+    if (external_ctx)
+    {
+        return;
+    }
+    if (Running())
+    {
+        throw MainLoop::Exception("The main loop is already running");
+    }
+
+    GMainContext *ctx = (state ? state->context : g_main_context_default());
+    if (!g_main_context_acquire(ctx))
+    {
+        throw MainLoop::Exception("The main context is owned by another thread");
+    }
+    external_ctx = ctx;
+}
+
+
+std::vector<GPollFD> MainLoop::GetPollFDs(int &timeout_ms)
+{
+    if (!external_ctx)
+    {
+        throw MainLoop::Exception("PrepareExternal() has not been called");
+    }
+
+    const bool ready = g_main_context_prepare(external_ctx, &external_priority);
+
+    std::vector<GPollFD> fds(8);
+    gint needed = 0;
+    while (true)
+    {
+        needed = g_main_context_query(external_ctx,
+                                      external_priority,
+                                      &timeout_ms,
+                                      fds.data(),
+                                      static_cast<gint>(fds.size()));
+        if (needed <= static_cast<gint>(fds.size()))
+        {
+            break;
+        }
+        fds.resize(needed);
+    }
+    fds.resize(needed);
+    if (ready)
+    {
+        timeout_ms = 0;
+    }
+    return fds;
+}
+
+
+bool MainLoop::Dispatch(std::vector<GPollFD> &fds)
+{
+    if (!external_ctx)
+    {
+        throw MainLoop::Exception("PrepareExternal() has not been called");
+    }
+
+    if (!g_main_context_check(external_ctx,
+                              external_priority,
+                              fds.data(),
+                              static_cast<gint>(fds.size())))
+    {
+        return false;
+    }
+    g_main_context_dispatch(external_ctx);
+    return true;
+}
+
+
+bool MainLoop::ReleaseExternal() noexcept
+{
+    if (!external_ctx)
+    {
+        return true;
+    }
+
+    // g_main_context_release() must be called by the thread owning the
+    // main context.  Releasing it from another thread would corrupt the
+    // ownership counter of the thread which acquired it.
+    if (!g_main_context_is_owner(external_ctx))
+    {
+        std::cerr << "** ERROR **  MainLoop::ReleaseExternal() called from a "
+                  << "thread not owning the main context; not released"
+                  << std::endl;
+        return false;
+    }
+    g_main_context_release(external_ctx);
+    external_ctx = nullptr;
+    return true;
+}
+
+
 } // namespace DBus
@@ -15,6 +15,9 @@
 #pragma once
 
 #include <memory>
+#include <thread>
+#include <vector>
+#include <glib.h>
 
 #include "exceptions.hpp"
 
@@ -33,7 +36,12 @@ namespace DBus {
  *  in the D-Bus service handler (the DBus::Object passed to the
  *  DBus::Service::AssignServiceHandler() method).
  *
- *  NOTE: Only one MainLoop can run per process (pid).
+ *  NOTE: Only one MainLoop on the default glib2 main context can run
+ *        per process (pid).  Additional main loops can be created on
+ *        their own main context via MainLoop::CreatePrivate(), which can
+ *        run in parallel in dedicated threads.  D-Bus objects, bus names
+ *        and signal subscriptions are dispatched in the main loop their
+ *        DBus::Connection is bound to; see Connection::BindMainLoop().
  *
  */
 class MainLoop
@@ -54,10 +62,46 @@ class MainLoop
      */
     [[nodiscard]] static MainLoop::Ptr Create()
     {
-        return MainLoop::Ptr(new MainLoop());
+        return MainLoop::Ptr(new MainLoop(false));
     }
 
-    ~MainLoop() noexcept = default;
+    /**
+     *  Creates a DBus Mainloop object running on its own glib2 main
+     *  context.  This main loop does not respond to SIGINT and SIGTERM
+     *  signals; those are handled by the main loop on the default
+     *  main context.
+     *
+     *  @returns DBus::MainLoop::Ptr to the main loop object
+     */
+    [[nodiscard]] static MainLoop::Ptr CreatePrivate()
+    {
+        return MainLoop::Ptr(new MainLoop(true));
+    }
+
+    ~MainLoop() noexcept;
+
+
+    /**
+     *  Makes the main context of a MainLoop the thread-default context
+     *  for as long as this object exists.  glib2 dispatches D-Bus
+     *  callbacks to the thread-default context at the time the object,
+     *  bus name or signal subscription was registered.
+     *
+     *  A MainLoop::Ptr being nullptr or using the default main context
+     *  makes this a no-op.
+     */
+    class ContextScope
+    {
+      public:
+        ContextScope(const MainLoop::Ptr loop) noexcept;
+        ~ContextScope() noexcept;
+
+        ContextScope(const ContextScope &) = delete;
+        ContextScope &operator=(const ContextScope &) = delete;
+
+      private:
+        GMainContext *context = nullptr;
+    };
 
     /**
      *  Start the main loop and let it run until the service wants to
@@ -71,6 +115,15 @@ class MainLoop
     void Run();
 
 
+    /**
+     *  Start the main loop in a dedicated thread and return instantly.
+     *  Use Stop() to stop it and Wait() to wait for the thread to exit.
+     *
+     *  @throws DBus::MainLoop::Exception if this main loop is already running
+     */
+    void Start();
+
+
     /**
      *  This will wait until the main loop stops running.  If no main loop
      *  us running, it will return instantly.
@@ -90,9 +143,99 @@ class MainLoop
      */
     void Stop();
 
+    /**
+     *  Retrieve the glib2 main context this main loop runs on
+     *
+     * @return GMainContext* of this main loop, nullptr for the default
+     *         main context
+     */
+    GMainContext *GetContext() const noexcept;
+
+
+    /**
+     *  Prepare this main loop to be driven by an external event loop,
+     *  such as an epoll, asio or libuv based reactor, instead of running
+     *  Run() or Start().  The calling thread becomes the owner of the
+     *  glib2 main context; GetPollFDs() and Dispatch() must be called
+     *  from this thread only.
+     *
+     *  A single reactor iteration looks like this:
+     *
+     *  @code
+     *
+     *  loop->PrepareExternal();
+     *  while (running)
+     *  {
+     *      int timeout = -1;
+     *      std::vector<GPollFD> fds = loop->GetPollFDs(timeout);
+     *      // ... wait for the fds and timeout in the reactor,
+     *      //     filling in the revents field of each GPollFD ...
+     *      loop->Dispatch(fds);
+     *  }
+     *  loop->ReleaseExternal();
+     *
+     *  @endcode
+     *
+     * @throws DBus::MainLoop::Exception if the main loop is already running
+     *         or the main context is owned by another thread
+     */
+    void PrepareExternal();
+
+    /**
+     *  Retrieve the file descriptors and timeout the external event loop
+     *  needs to wait for before calling Dispatch().
+     *
+     * @param timeout_ms  int returning the maximum time to wait, in
+     *                    milliseconds.  Set to -1 if there is no timeout
+     *                    and 0 if there are events ready for dispatching.
+     *
+     * @return std::vector<GPollFD> with the file descriptors to watch
+     * @throws DBus::MainLoop::Exception if PrepareExternal() is not called
+     */
+    std::vector<GPollFD> GetPollFDs(int &timeout_ms);
+
+    /**
+     *  Dispatch all the events which are ready, based on the revents
+     *  field of the file descriptors returned by GetPollFDs().
+     *
+     * @param fds  std::vector<GPollFD> from GetPollFDs(), with the revents
+     *             fields updated by the external event loop
+     *
+     * @return true if any events were dispatched
+     * @throws DBus::MainLoop::Exception if PrepareExternal() is not called
+     */
+    bool Dispatch(std::vector<GPollFD> &fds);
+
+    /**
+     *  Release the main context ownership taken by PrepareExternal().
+     *  This must be called from the same thread which called
+     *  PrepareExternal(), before the MainLoop object is destroyed.  If
+     *  called from any other thread, the main context is not released
+     *  and an error is reported.  The destructor calls this as well, so
+     *  a MainLoop object driven by an external event loop must not be
+     *  destroyed by another thread while still prepared.
+     *
+     * @return true if the main context was released or never acquired,
+     *         false if the calling thread does not own the main context
+     */
+    bool ReleaseExternal() noexcept;
+
 
   private:
-    MainLoop() = default;
+    /// Main context acquired by PrepareExternal(), nullptr if not used
+    GMainContext *external_ctx = nullptr;
+
+    /// Highest priority received from glib2 in the last GetPollFDs() call
+    gint external_priority = 0;
+
+    /// Run state of a private main loop, shared with the loop thread
+    struct LoopState;
+    std::shared_ptr<LoopState> state{};
+
+    /// Thread running the main loop when started via Start()
+    std::thread loop_thread{};
+
+    MainLoop(const bool private_context);
 };
 
 }; // namespace DBus
@@ -21,7 +21,6 @@
  */
 
 
-#include <sstream>
 #include <string>
 #include <glib.h>
 
@@ -29,8 +28,10 @@
 #include "../glib2/utils.hpp"
 #include "../signals/group.hpp"
 #include "exceptions.hpp"
+#include "property-batch.hpp"
 #include "property.hpp"
 #include "base.hpp"
+#include "manager.hpp"
 
 
 namespace DBus {
@@ -131,6 +132,121 @@ Object::Property::Update::Ptr Object::Base::SetProperty(const std::string &propn
 }
 
 
+void Object::Base::NotifyPropertyChanged(const std::vector<std::string> &property_names)
+{
+    if (!dbus_connection)
+    {
+        throw Object::Exception(this, "Object is not registered on the D-Bus");
+    }
+    if (property_names.empty())
+    {
+        return;
+    }
+
+    for (const auto &name : property_names)
+    {
+        MarkPropertyDirty(name);
+    }
+
+    // Retrieve all the values first, so nothing is sent if any of
+    // the properties does not exist
+    std::vector<GVariant *> values{};
+    values.reserve(property_names.size());
+    try
+    {
+        for (const auto &name : property_names)
+        {
+            values.push_back(g_variant_ref_sink(GetProperty(name)));
+        }
+    }
+    catch (const Property::Exception &)
+    {
+        for (auto &v : values)
+        {
+            g_variant_unref(v);
+        }
+        throw;
+    }
+
+    if (coalesce_property_changes)
+    {
+        auto batch = Property::ChangeBatch::Get(dbus_connection->ConnPtr(), GetMainContext());
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            batch->Queue(object_path,
+                         interface,
+                         property_names[i],
+                         values[i],
+                         property_change_delay);
+            g_variant_unref(values[i]);
+        }
+        return;
+    }
+
+    glib2::Builder::Scoped changed("a{sv}");
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        changed.AddFormatted("{sv}", property_names[i].c_str(), values[i]);
+        g_variant_unref(values[i]);
+    }
+
+    GError *error = nullptr;
+    Connection::Cork::EmitSignal(dbus_connection->ConnPtr(),
+                                 nullptr,
+                                 object_path.c_str(),
+                                 "org.freedesktop.DBus.Properties",
+                                 "PropertiesChanged",
+                                 g_variant_new("(s@a{sv}as)",
+                                               interface.c_str(),
+                                               changed.Finish(),
+                                               nullptr),
+                                 &error);
+    if (error)
+    {
+        throw Object::Exception(this,
+                                "Failed sending PropertiesChanged signal",
+                                error);
+    }
+}
+
+
+void Object::Base::NotifyPropertyChanged(const std::string &property_name)
+{
+    NotifyPropertyChanged(std::vector<std::string>{property_name});
+}
+
+
+void Object::Base::MarkPropertyDirty(const std::string &propname)
+{
+    if (!properties->MarkDirty(propname))
+    {
+        throw Property::Exception(this, propname, "Property not found");
+    }
+}
+
+
+void Object::Base::CachePropertyValue(const std::string &propname, const bool enable)
+{
+    if (!properties->EnableValueCache(propname, enable))
+    {
+        throw Property::Exception(this, propname, "Property not found");
+    }
+}
+
+
+GVariant *Object::Base::GetAllProperties(const std::function<bool(const std::string &)> &include) const
+{
+    try
+    {
+        return properties->GetAllValues(include);
+    }
+    catch (const DBus::Exception &excp)
+    {
+        throw Property::Exception(this, "", excp.GetRawError());
+    }
+}
+
+
 Object::Method::Arguments::Ptr Object::Base::AddMethod(const std::string &method_name,
                                                        Method::CallbackFnc method_callback)
 {
@@ -138,6 +254,13 @@ Object::Method::Arguments::Ptr Object::Base::AddMethod(const std::string &method
 }
 
 
+Object::Method::Arguments::Ptr Object::Base::AddRawMethod(const std::string &method_name,
+                                                          Method::RawCallbackFnc raw_callback)
+{
+    return methods->AddRawMethod(method_name, std::move(raw_callback));
+}
+
+
 void Object::Base::RegisterSignals(const Signals::Group::Ptr signal_group)
 {
     if (signals)
@@ -148,17 +271,61 @@ void Object::Base::RegisterSignals(const Signals::Group::Ptr signal_group)
 }
 
 
+Object::Method::Arguments::Ptr Object::Base::AddLastValuesMethod(const std::string &method_name)
+{
+    if (!signals)
+    {
+        throw Object::Exception(this, "No signals registered");
+    }
+    Signals::Group::Ptr grp = signals;
+    auto args = AddMethod(method_name,
+                          [grp](Object::Method::Arguments::Ptr args)
+                          {
+                              args->SetMethodReturn(g_variant_new("(@a{sv})",
+                                                                  grp->GetLastValues()));
+                          });
+    args->AddOutput("values", "a{sv}");
+    return args;
+}
+
+
+void Object::Base::share_declarations()
+{
+    methods->Share(interface);
+    properties->Share(interface);
+}
+
+
 const std::string Object::Base::GenerateIntrospection() const
 {
-    std::ostringstream xml;
-    xml << "<node name='" << object_path << "'>"
-        << "  <interface name='" << interface << "'>"
-        << methods->GenerateIntrospection()
-        << properties->GenerateIntrospection()
-        << (signals ? signals->GenerateIntrospection() : "")
-        << "  </interface>"
-        << "</node>";
-    return std::string(xml.str());
+    return "<node name='" + std::string(object_path) + "'>"
+           + GenerateInterfaceIntrospection()
+           + "</node>";
+}
+
+
+const std::string Object::Base::GenerateInterfaceIntrospection() const
+{
+    // The method, property and signal fragments are cached in their
+    // collections until something new is declared
+    std::string xml = "  <interface name='" + interface + "'>";
+    xml += methods->GenerateIntrospection();
+    xml += properties->GenerateIntrospection();
+    if (signals)
+    {
+        xml += signals->GenerateIntrospection();
+    }
+    xml += "  </interface>";
+    return xml;
+}
+
+
+void Object::Base::AuthorizeAsync(const Authz::Request::Ptr request,
+                                  Authz::Decision::Ptr decision)
+{
+    // Authorize() may block; it is called by the worker thread
+    // processing the request instead of the dispatching thread
+    decision->Defer();
 }
 
 
@@ -177,6 +344,19 @@ const bool Object::Base::MethodExists(const std::string &meth_name) const
 }
 
 
+AsyncProcess::Priority Object::Base::GetMethodPriority(const std::string &meth_name) const noexcept
+{
+    return methods->GetPriority(meth_name);
+}
+
+
+bool Object::Base::MethodRunsInline(const std::string &meth_name) const noexcept
+{
+    // Serialized objects run all their requests via the request pool
+    return !serialize_requests && methods->IsInline(meth_name);
+}
+
+
 void Object::Base::MethodCall(AsyncProcess::Request::UPtr &req)
 {
     methods->Execute(req);
@@ -185,13 +365,98 @@ void Object::Base::MethodCall(AsyncProcess::Request::UPtr &req)
 
 void Object::Base::DisableIdleDetector(const bool disable)
 {
+    auto mgr = idle_tracker.lock();
+    if (mgr)
+    {
+        mgr->idle_object_update(this, disable);
+        return;
+    }
     disable_idle_detection = disable;
 }
 
 
+void Object::Base::AsyncPropertyAccess(const bool enable)
+{
+    async_property_access = enable;
+}
+
+
+const bool Object::Base::GetAsyncPropertyAccess() const
+{
+    return async_property_access;
+}
+
+
+void Object::Base::AsyncAuthorization(const bool enable)
+{
+    async_authorization = enable;
+}
+
+
+const bool Object::Base::GetAsyncAuthorization() const
+{
+    return async_authorization;
+}
+
+
+void Object::Base::EnableAuthorizationCache(const std::chrono::milliseconds ttl)
+{
+    authz_cache_ttl = ttl;
+}
+
+
+const std::chrono::milliseconds Object::Base::GetAuthorizationCacheTTL() const
+{
+    return authz_cache_ttl;
+}
+
+
+void Object::Base::CoalescePropertyChanges(const bool enable,
+                                           const std::chrono::milliseconds delay)
+{
+    coalesce_property_changes = enable;
+    property_change_delay = delay;
+}
+
+
+const bool Object::Base::GetPropertyChangeCoalescing() const
+{
+    return coalesce_property_changes;
+}
+
+
+const std::chrono::milliseconds Object::Base::GetPropertyChangeDelay() const
+{
+    return property_change_delay;
+}
+
+
+GMainContext *Object::Base::GetMainContext() const noexcept
+{
+    if (!dbus_connection)
+    {
+        return nullptr;
+    }
+    auto loop = dbus_connection->GetMainLoop();
+    return (loop ? loop->GetContext() : nullptr);
+}
+
+
 const bool Object::Base::GetIdleDetectorDisabled() const
 {
     return disable_idle_detection;
 }
 
+
+bool Object::Base::RequestsSerialized() const noexcept
+{
+    return serialize_requests;
+}
+
+
+void Object::Base::SerializeRequests(const bool enable)
+{
+    serialize_requests = enable;
+}
+
 } // namespace DBus
@@ -19,11 +19,14 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "../authz-request.hpp"
+#include "../connection.hpp"
 #include "../glib2/utils.hpp"
 #include "../signals/group.hpp"
 #include "exceptions.hpp"
@@ -35,6 +38,9 @@
 namespace DBus {
 namespace Object {
 
+class Manager; // forward declaration; declared in object/manager.hpp
+class Subtree; // forward declaration; declared in object/subtree.hpp
+
 class Base : public std::enable_shared_from_this<Base>
 {
   public:
@@ -151,6 +157,35 @@ class Base : public std::enable_shared_from_this<Base>
     }
 
 
+    /**
+     *  Adds a new D-Bus object property bound to a thread-safe
+     *  Property::Atomic<T> value.  Use this when the value is changed
+     *  by other threads than the glib2 main loop thread reading it.
+     *
+     * @tparam T                  C++ data type of the value
+     * @param propname            std::string with the property name
+     * @param variable            Property::Atomic<T> value storage
+     * @param readwrite           bool flag, if true the property can be
+     *                            changed by D-Bus callers
+     * @param override_dbus_type  (optional) D-Bus data type string to use
+     *                            instead of the C++ derived type
+     */
+    template <typename T>
+    void AddProperty(const std::string &propname,
+                     Property::Atomic<T> &variable,
+                     bool readwrite,
+                     const std::string &override_dbus_type = "")
+    {
+        Property::Interface::Ptr prop;
+        prop = std::make_shared<AtomicPropertyType<T>>(interface,
+                                                       propname,
+                                                       readwrite,
+                                                       variable,
+                                                       override_dbus_type);
+        properties->AddBinding(prop);
+    }
+
+
     /**
      *  This is similar method to @AddProperty() but instead of linking
      *  the D-Bus property to a C++ variable, C++ functors are used as
@@ -227,6 +262,117 @@ class Base : public std::enable_shared_from_this<Base>
      */
     Property::Update::Ptr SetProperty(const std::string &propname, GVariant *value);
 
+    /**
+     *  Retrieve the values of all the properties in this object
+     *
+     * @param include  Function deciding if a property, by its name, is
+     *                 included.  If nullptr, all properties are included.
+     *
+     * @return GVariant* with an a{sv} dictionary of all the property
+     *         names and values
+     */
+    GVariant *GetAllProperties(const std::function<bool(const std::string &)> &include = nullptr) const;
+
+    /**
+     *  Send the org.freedesktop.DBus.Properties.PropertiesChanged signal
+     *  for properties changed directly by the service, for example by
+     *  modifying a variable bound via AddProperty().  All the properties
+     *  are sent with their current values in a single signal.
+     *
+     *  If CoalescePropertyChanges() is enabled, the changes are queued
+     *  up with other pending changes to this object instead.
+     *
+     *  @code
+     *
+     *    counter++;
+     *    last_update = now;
+     *    NotifyPropertyChanged({"counter", "last_update"});
+     *
+     *  @endcode
+     *
+     * @param property_names  std::vector<std::string> of the changed
+     *                        property names
+     *
+     * @throws Property::Exception if a property does not exist,
+     *         Object::Exception if the object is not registered on the
+     *         D-Bus or the signal could not be sent
+     */
+    void NotifyPropertyChanged(const std::vector<std::string> &property_names);
+
+    /**
+     *  Send the org.freedesktop.DBus.Properties.PropertiesChanged signal
+     *  for a single property; see the method above for details.
+     *
+     * @param property_name  std::string with the changed property name
+     */
+    void NotifyPropertyChanged(const std::string &property_name);
+
+    /**
+     *  Throw away the cached value of a property, which must be done
+     *  when a property with CachePropertyValue() enabled is changed
+     *  directly by the service.  NotifyPropertyChanged() does this
+     *  implicitly.
+     *
+     * @param propname  std::string with the property name
+     *
+     * @throws Property::Exception if the property does not exist
+     */
+    void MarkPropertyDirty(const std::string &propname);
+
+    /**
+     *  Retrieve the object setting if D-Bus property access should be
+     *  processed asynchronously via the AsyncProcess::Pool.
+     *
+     * @return Returns true if property reads and changes are processed
+     *         by the request thread pool, otherwise false.
+     */
+    const bool GetAsyncPropertyAccess() const;
+
+    /**
+     *  Retrieve the object setting if the authorization is evaluated via
+     *  AuthorizeAsync().  See AsyncAuthorization() for details.
+     *
+     * @return true if AuthorizeAsync() is used, otherwise false
+     */
+    const bool GetAsyncAuthorization() const;
+
+    /**
+     *  Retrieve for how long granted authorization decisions for this
+     *  object are cached.  See EnableAuthorizationCache() for details.
+     *
+     * @return std::chrono::milliseconds with the time-to-live of cached
+     *         decisions.  If 0, the authorization cache is disabled.
+     */
+    const std::chrono::milliseconds GetAuthorizationCacheTTL() const;
+
+    /**
+     *  Check if property changes are coalesced into fewer
+     *  PropertiesChanged signals.  See CoalescePropertyChanges() for
+     *  details.
+     *
+     * @return true if property changes are coalesced
+     */
+    const bool GetPropertyChangeCoalescing() const;
+
+    /**
+     *  Retrieve for how long coalesced property changes are collected
+     *  before the PropertiesChanged signal is sent.
+     *
+     * @return std::chrono::milliseconds with the delay.  If 0, the signal
+     *         is sent when the main loop becomes idle.
+     */
+    const std::chrono::milliseconds GetPropertyChangeDelay() const;
+
+    /**
+     *  Retrieve the glib2 main context of the main loop the D-Bus
+     *  connection of this object is bound to.  See
+     *  Connection::BindMainLoop().
+     *
+     * @return GMainContext* of the main loop, nullptr for the default
+     *         main context or if the object is not registered
+     */
+    GMainContext *GetMainContext() const noexcept;
+
 
 
     /**
@@ -252,6 +398,38 @@ class Base : public std::enable_shared_from_this<Base>
     Method::Arguments::Ptr AddMethod(const std::string &method_name,
                                      Method::CallbackFnc method_callback);
 
+    /**
+     *  Adds a D-Bus method forwarding opaque binary data.  The method
+     *  takes a single byte array (ay) argument and returns a single byte
+     *  array.  The callback receives the data as GBytes referring to the
+     *  received D-Bus message and the returned GBytes is sent back as-is,
+     *  so the bytes are never decoded or copied element by element.
+     *
+     *  @code
+     *
+     *    AddRawMethod("Forward",
+     *                 [backend](const std::string &caller, GBytes *data) -> GBytes *
+     *                 {
+     *                     return backend->Process(data);
+     *                 });
+     *
+     *  @endcode
+     *
+     *  Authorization, the request pool and the error handling work as
+     *  for methods added via @AddMethod().  The method has no access to
+     *  the Method::Arguments features, such as file descriptor passing
+     *  or deferred replies.
+     *
+     * @param method_name   std::string with the method name
+     * @param raw_callback  Method::RawCallbackFnc to call
+     *
+     * @return Method::Arguments::Ptr to the method argument declaration,
+     *         where the priority and inline processing can be set.  The
+     *         argument list must not be changed.
+     */
+    Method::Arguments::Ptr AddRawMethod(const std::string &method_name,
+                                        Method::RawCallbackFnc raw_callback);
+
 
     /**
      *  Register all signals prepared in a Signals::Group based object
@@ -263,6 +441,23 @@ class Base : public std::enable_shared_from_this<Base>
      */
     void RegisterSignals(const Signals::Group::Ptr signal_group);
 
+    /**
+     *  Add a D-Bus method returning the last values of the signals in
+     *  the registered Signals::Group, enabled via
+     *  Signals::Group::RetainLastValue().  Late subscribers can learn
+     *  the current state with this single call, instead of reading
+     *  each related property.
+     *
+     *  The method returns an a{sv} dictionary; the key is the signal
+     *  name and the value the tuple with the signal values.
+     *
+     * @param method_name  std::string with the D-Bus method name
+     *                     (default: GetLastValues)
+     * @return Method::Arguments::Ptr to the method declaration
+     * @throws Object::Exception if no signals are registered
+     */
+    Method::Arguments::Ptr AddLastValuesMethod(const std::string &method_name = "GetLastValues");
+
 
     /**
      *  This provides the complete introspection XML document needed
@@ -273,6 +468,17 @@ class Base : public std::enable_shared_from_this<Base>
      */
     const std::string GenerateIntrospection() const;
 
+    /**
+     *  This provides only the <interface/> element of the introspection
+     *  XML document.  This does not depend on the object path, so objects
+     *  providing the same interface with the same methods, properties and
+     *  signals will generate identical results.
+     *
+     * @return const std::string containing the XML <interface/> element
+     *               describing this object
+     */
+    const std::string GenerateInterfaceIntrospection() const;
+
 
     /**
      *  Before any of the method or get/set property callbacks happens,
@@ -291,6 +497,37 @@ class Base : public std::enable_shared_from_this<Base>
     virtual const bool Authorize(const Authz::Request::Ptr request) = 0;
 
 
+    /**
+     *  Asynchronous variant of Authorize(), used instead of Authorize()
+     *  for D-Bus method calls and asynchronous property access when
+     *  enabled via AsyncAuthorization().
+     *
+     *  The implementation starts the evaluation and returns right away,
+     *  completing the decision via Authz::Decision::Grant() or
+     *  Authz::Decision::Deny() when the result is available.  No thread
+     *  is kept waiting meanwhile.  This is called by the thread
+     *  dispatching the D-Bus calls and must not block.
+     *
+     *  The requests stay counted against the AsyncProcess::Pool queue
+     *  limits while the decision is pending.  If the caller disconnects
+     *  meanwhile, Authz::Decision::IsCancelled() returns true and the
+     *  request is dropped whatever the outcome.
+     *
+     *  An org.freedesktop.DBus.Properties.GetAll call arrives here as a
+     *  single request for all the properties; see AsyncAuthorization().
+     *
+     *  The default implementation leaves the decision to Authorize(),
+     *  called by the AsyncProcess::Pool worker thread processing the
+     *  request, via Authz::Decision::Defer().
+     *
+     * @param request   Authz::Request::Ptr with information about the
+     *                  caller and object target
+     * @param decision  Authz::Decision::Ptr to complete with the result
+     */
+    virtual void AuthorizeAsync(const Authz::Request::Ptr request,
+                                Authz::Decision::Ptr decision);
+
+
     /**
      *  Optional callback function when an authorization was rejected.
      *  This can be used to trigger specific actions outside of the
@@ -316,6 +553,27 @@ class Base : public std::enable_shared_from_this<Base>
      */
     const bool MethodExists(const std::string &meth_name) const;
 
+    /**
+     *  Retrieve the processing priority of a specific D-Bus method in
+     *  this D-Bus object.  This is set via Method::Arguments::SetPriority()
+     *
+     *  @param meth_name   std::string with the method name to look up
+     *
+     *  @return AsyncProcess::Priority of the method
+     */
+    AsyncProcess::Priority GetMethodPriority(const std::string &meth_name) const noexcept;
+
+    /**
+     *  Check if a specific D-Bus method in this D-Bus object runs directly
+     *  on the thread dispatching the call.  This is set via
+     *  Method::Arguments::SetInline()
+     *
+     *  @param meth_name   std::string with the method name to look up
+     *
+     *  @return true if the method runs inline, otherwise false
+     */
+    bool MethodRunsInline(const std::string &meth_name) const noexcept;
+
 
     /**
      *  Run a specific callback in the object.  This method is expected
@@ -349,6 +607,14 @@ class Base : public std::enable_shared_from_this<Base>
      */
     const bool GetIdleDetectorDisabled() const;
 
+    /**
+     *  Check if the requests to this object are processed one at a time.
+     *  See SerializeRequests()
+     *
+     * @return true if the requests are serialized
+     */
+    bool RequestsSerialized() const noexcept;
+
 
     friend std::ostream &operator<<(std::ostream &os, const Base &object)
     {
@@ -404,6 +670,135 @@ class Base : public std::enable_shared_from_this<Base>
      */
     void DisableIdleDetector(const bool enable);
 
+    /**
+     *  By default, D-Bus property reads and changes are processed directly
+     *  by the thread dispatching the D-Bus calls.  A slow
+     *  Property::BySpec callback will then block all other D-Bus calls in
+     *  the service while running.
+     *
+     *  Via this method, the property access can be processed by the
+     *  AsyncProcess::Pool worker threads instead, similar to D-Bus method
+     *  calls.  The response is sent to the D-Bus caller once the property
+     *  callback has completed.
+     *
+     *  This must be set before the object is registered on the D-Bus, which
+     *  happens when the object is created via Object::Manager::CreateObject().
+     *  This flag is false by default.
+     *
+     * @param enable  bool flag to process property access asynchronously
+     */
+    void AsyncPropertyAccess(const bool enable);
+
+    /**
+     *  Process the requests to this object one at a time, while requests
+     *  to other objects are still processed in parallel by the
+     *  AsyncProcess::Pool.  The object data does then not need any
+     *  locking against concurrent D-Bus calls.  The waiting requests are
+     *  processed by their method priority, and then in the order they
+     *  arrived.
+     *
+     *  The following requests to the object are preferably processed by
+     *  the same worker thread.  Methods declared to run inline via
+     *  Method::Arguments::SetInline() are queued as well.  Property
+     *  access is only serialized if AsyncPropertyAccess() is enabled.
+     *
+     *  Calls made via Object::BatchObject are not serialized; they are
+     *  processed directly by the thread processing the batch request.
+     *
+     *  This flag is false by default.
+     *
+     * @param enable  bool flag to serialize the requests to this object
+     */
+    void SerializeRequests(const bool enable);
+
+    /**
+     *  By default, Authorize() is called by the AsyncProcess::Pool worker
+     *  thread processing the request, keeping that thread busy until the
+     *  evaluation completes.  For expensive checks, like a polkit
+     *  lookup, this limits how many requests can be processed.
+     *
+     *  When enabled, AuthorizeAsync() is called by the thread dispatching
+     *  the D-Bus call before the request is queued.  The request is only
+     *  passed on to the request pool once the decision has been granted.
+     *  Rejected requests never reach the pool.
+     *
+     *  This applies to D-Bus method calls and, if enabled via
+     *  AsyncPropertyAccess(), property access.  Property access processed
+     *  directly by the dispatching thread still uses Authorize().
+     *
+     *  An org.freedesktop.DBus.Properties.GetAll call is authorized once,
+     *  via an Object::Operation::PROPERTY_GET request without a property
+     *  name; the target is the interface name followed by a single dot.
+     *  Granting it returns all the readable properties.  If the decision
+     *  is deferred via Authz::Decision::Defer(), Authorize() is called for
+     *  each property by the worker thread instead, leaving out the
+     *  properties not granted.
+     *
+     *  This flag is false by default.
+     *
+     * @param enable  bool flag to evaluate authorization via AuthorizeAsync()
+     */
+    void AsyncAuthorization(const bool enable);
+
+    /**
+     *  By default, the Authorize() method is called for every D-Bus method
+     *  call and property access to this object.  If the authorization
+     *  evaluation is expensive, granted decisions can be cached.
+     *
+     *  When enabled, a granted request is remembered for the given
+     *  time-to-live, keyed by the caller's unique bus name, the operation,
+     *  the object path and the method or property.  Identical requests
+     *  from the same caller are then granted without calling Authorize()
+     *  again.  All the cached decisions for a caller are removed when the
+     *  caller disconnects from the bus.  Rejected requests are never cached.
+     *
+     *  The cache is disabled by default.
+     *
+     * @param ttl   std::chrono::milliseconds for how long a granted decision
+     *              is valid.  If 0, the cache is disabled.
+     */
+    void EnableAuthorizationCache(const std::chrono::milliseconds ttl);
+
+    /**
+     *  By default, each property change via the
+     *  org.freedesktop.DBus.Properties.Set method sends a separate
+     *  PropertiesChanged signal.  When many properties are changed in
+     *  a burst, these changes can be coalesced into a single signal.
+     *
+     *  When enabled, the changed properties are collected and sent in a
+     *  single PropertiesChanged signal when the main loop becomes idle,
+     *  or after the given delay.  If a property changes more times in
+     *  this period, only the last value is sent.  Errors sending the
+     *  signal can then not be reported back to the caller changing the
+     *  property.
+     *
+     *  This is disabled by default.
+     *
+     * @param enable  bool flag enabling coalescing of property changes
+     * @param delay   std::chrono::milliseconds to collect changes before
+     *                sending the signal.  If 0, the signal is sent when
+     *                the main loop becomes idle.
+     */
+    void CoalescePropertyChanges(const bool enable,
+                                 const std::chrono::milliseconds delay = std::chrono::milliseconds(0));
+
+    /**
+     *  By default, the property value is serialized into a new GVariant
+     *  object on each read.  For large values which rarely change, such
+     *  as big arrays, the serialized value can be cached instead.
+     *
+     *  The cached value is thrown away when the property is changed via
+     *  the org.freedesktop.DBus.Properties.Set method.  If the service
+     *  changes the value directly, it must call MarkPropertyDirty() or
+     *  NotifyPropertyChanged(); otherwise the old value is returned.
+     *
+     * @param propname  std::string with the property name
+     * @param enable    bool flag enabling the value cache
+     *
+     * @throws Property::Exception if the property does not exist
+     */
+    void CachePropertyValue(const std::string &propname, const bool enable = true);
+
 
   private:
     //
@@ -564,7 +959,11 @@ class Base : public std::enable_shared_from_this<Base>
          */
         GVariant *GetValue() const override
         {
-            return glib2::Value::CreateType(GetDBusType(), PropertyTypeBase<T>::variable_ref);
+            return Property::Interface::GetCachedValue(
+                [this]()
+                {
+                    return glib2::Value::CreateType(GetDBusType(), PropertyTypeBase<T>::variable_ref);
+                });
         }
 
         /**
@@ -585,6 +984,7 @@ class Base : public std::enable_shared_from_this<Base>
         Property::Update::Ptr SetValue(GVariant *value_arg) override
         {
             PropertyTypeBase<T>::variable_ref = glib2::Value::Get<T>(value_arg);
+            Property::Interface::MarkDirty();
             Property::Update::Ptr resp = Property::Interface::PrepareUpdate();
             resp->AddValue(PropertyTypeBase<T>::variable_ref);
             return resp;
@@ -646,7 +1046,11 @@ class Base : public std::enable_shared_from_this<Base>
          */
         GVariant *GetValue() const override
         {
-            return glib2::Value::CreateVector(this->variable_ref);
+            return Property::Interface::GetCachedValue(
+                [this]()
+                {
+                    return glib2::Value::CreateVector(this->variable_ref);
+                });
         }
 
 
@@ -671,6 +1075,7 @@ class Base : public std::enable_shared_from_this<Base>
             g_variant_ref_sink(value);
             std::vector<T> newvalue = glib2::Value::ExtractVector<T>(value, glib2::DataType::DBus<T>(), false);
             this->variable_ref = newvalue;
+            Property::Interface::MarkDirty();
 
             auto upd = Property::Interface::PrepareUpdate();
             upd->AddValue(newvalue);
@@ -681,6 +1086,64 @@ class Base : public std::enable_shared_from_this<Base>
       private:
         const std::string dbus_array_type; ///< D-Bus data type of the array
     };
+
+
+    /**
+     *  Implementation of a D-Bus object property bound to a
+     *  Property::Atomic<T> value.  Reads are done on a snapshot of the
+     *  value and never wait for writers.
+     *
+     * @tparam T   C++ data type of the value
+     */
+    template <typename T>
+    class AtomicPropertyType : public PropertyTypeBase<Property::Atomic<T>>
+    {
+      public:
+        AtomicPropertyType(const std::string &interface_arg,
+                           const std::string &name_arg,
+                           const bool readwr_arg,
+                           Property::Atomic<T> &variable,
+                           const std::string &override_dbus_type)
+            : PropertyTypeBase<Property::Atomic<T>>(interface_arg, name_arg, readwr_arg, variable),
+              dbus_type(override_dbus_type.empty()
+                            ? Property::_private::AtomicValue<T>::DBusType()
+                            : override_dbus_type)
+        {
+        }
+
+        virtual ~AtomicPropertyType() noexcept = default;
+
+        const char *GetDBusType() const noexcept override
+        {
+            return dbus_type.c_str();
+        }
+
+        GVariant *GetValue() const override
+        {
+            return Property::Interface::GetCachedValue(
+                [this]()
+                {
+                    auto snapshot = this->variable_ref.Load();
+                    return Property::_private::AtomicValue<T>::Create(dbus_type.c_str(), *snapshot);
+                });
+        }
+
+        Property::Update::Ptr SetValue(GVariant *value_arg) override
+        {
+            T newvalue = Property::_private::AtomicValue<T>::Extract(value_arg);
+            auto upd = Property::Interface::PrepareUpdate();
+            upd->AddValue(newvalue);
+            Property::Interface::StoreValue(
+                [this, &newvalue]()
+                {
+                    this->variable_ref.Store(std::move(newvalue));
+                });
+            return upd;
+        }
+
+      private:
+        const std::string dbus_type; ///< D-Bus data type of the property
+    };
     // End of DBus::Object::PropertyType/PropertyTypeBase related classes
 
     //
@@ -694,7 +1157,42 @@ class Base : public std::enable_shared_from_this<Base>
     const std::string interface;
 
     /// Disable the idle detection checks, see DisableIdleDetector() for details
-    bool disable_idle_detection = false;
+    std::atomic<bool> disable_idle_detection{false};
+
+    /// Object::Manager tracking this object in its idle detection
+    /// active-object counter.  Set by the Object::Manager on registration.
+    std::weak_ptr<Manager> idle_tracker{};
+
+    /// Is this object currently registered in the idle_tracker?
+    /// Protected by the Object::Manager idle_mtx lock.
+    bool idle_registered = false;
+
+    /// Process property access in the request pool, see AsyncPropertyAccess()
+    bool async_property_access = false;
+
+    /// Process one request at a time, see SerializeRequests()
+    std::atomic<bool> serialize_requests{false};
+
+    /// Authorize via AuthorizeAsync(), see AsyncAuthorization()
+    bool async_authorization = false;
+
+    /// Time-to-live of cached authorizations, see EnableAuthorizationCache()
+    std::chrono::milliseconds authz_cache_ttl{0};
+
+    /// Coalesce PropertiesChanged signals, see CoalescePropertyChanges()
+    bool coalesce_property_changes = false;
+
+    /// Delay before sending coalesced PropertiesChanged signals
+    std::chrono::milliseconds property_change_delay{0};
+
+    /// D-Bus connection the object is registered on, used by
+    /// NotifyPropertyChanged().  Set by the Object::Manager.
+    DBus::Connection::Ptr dbus_connection{nullptr};
+
+    /// The Object::Manager and Object::Subtree set the dbus_connection
+    /// when registering or materializing the object
+    friend class Manager;
+    friend class Subtree;
 
     /**
      *  D-Bus properties stored within this object.
@@ -714,6 +1212,14 @@ class Base : public std::enable_shared_from_this<Base>
      *  the Object::Base::RegisterSignals() method.
      */
     Signals::Group::Ptr signals{};
+
+    /**
+     *  Share the method and property declarations of this object with
+     *  all other objects of the same D-Bus interface declaring the same
+     *  methods and properties, like the Signals::Specification does for
+     *  signals.  This is called by the Object::Manager on registration.
+     */
+    void share_declarations();
 };
 
 
@@ -0,0 +1,218 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file object/batch.cpp
+ *
+ * @brief Implementation of DBus::Object::BatchObject
+ */
+
+#include <string>
+#include <glib.h>
+
+#define GDBUSPP_LOG_CATEGORY OBJECTS
+#include "../async-process.hpp"
+#include "../authz-cache.hpp"
+#include "../authz-request.hpp"
+#include "../features/debug-log.hpp"
+#include "../glib2/utils.hpp"
+#include "batch.hpp"
+#include "exceptions.hpp"
+#include "manager.hpp"
+#include "method.hpp"
+
+
+namespace DBus {
+namespace Object {
+
+BatchObject::BatchObject(const Object::Path &path,
+                         DBus::Connection::Ptr connection_,
+                         std::weak_ptr<Manager> manager_)
+    : Object::Base(path, "net.openvpn.gdbuspp.Batch"),
+      connection(connection_), manager(manager_)
+{
+    DisableIdleDetector(true);
+
+    auto exec = AddMethod(
+        "Execute",
+        [this](Object::Method::Arguments::Ptr args)
+        {
+            const std::string caller = args->GetCallerBusName();
+
+            GVariantIter *calls = nullptr;
+            g_variant_get(args->GetMethodParameters(), "(a(ossv))", &calls);
+            if (g_variant_iter_n_children(calls) > GDBUSPP_BATCH_MAX_CALLS)
+            {
+                g_variant_iter_free(calls);
+                throw Object::Method::Exception("Too many calls in the batch request; maximum is "
+                                                + std::to_string(GDBUSPP_BATCH_MAX_CALLS));
+            }
+
+            glib2::Builder::Scoped results("a(ssv)");
+            const gchar *path = nullptr;
+            const gchar *interface = nullptr;
+            const gchar *member = nullptr;
+            GVariant *call_args = nullptr;
+            while (g_variant_iter_next(calls, "(&o&s&sv)", &path, &interface, &member, &call_args))
+            {
+                std::string error_domain{};
+                std::string error{};
+                GVariant *response = nullptr;
+                try
+                {
+                    response = execute_call(caller, path, interface, member, call_args);
+                }
+                catch (const DBus::Exception &excp)
+                {
+                    GDBUSPP_LOG("Batch call FAIL: " << path << " "
+                                                    << interface << "." << member
+                                                    << ": " << excp.what());
+                    error_domain = excp.DBusErrorDomain();
+                    error = excp.GetRawError();
+                }
+                g_variant_unref(call_args);
+
+                results.AddFormatted("(ssv)",
+                                     error_domain.c_str(),
+                                     error.c_str(),
+                                     (response ? response : g_variant_new("()")));
+                if (response)
+                {
+                    g_variant_unref(response);
+                }
+            }
+            g_variant_iter_free(calls);
+
+            args->SetMethodReturn(results.FinishWrapped());
+        });
+    exec->AddInput("calls", "a(ossv)");
+    exec->AddOutput("results", "a(ssv)");
+}
+
+
+const bool BatchObject::Authorize(const Authz::Request::Ptr request)
+{
+    return true;
+}
+
+
+GVariant *BatchObject::execute_call(const std::string &caller,
+                                    const Object::Path &path,
+                                    const std::string &interface,
+                                    const std::string &member,
+                                    GVariant *args) const
+{
+    auto mgr = manager.lock();
+    if (!mgr)
+    {
+        throw Object::Exception(path, interface, "Object manager unavailable");
+    }
+    if (path == GetPath())
+    {
+        throw Object::Method::Exception("Batch requests cannot be nested");
+    }
+    auto object = mgr->GetObject<Object::Base>(path);
+    if (!object)
+    {
+        throw Object::Exception(path, interface, "Object not found");
+    }
+    if (object->RequestsSerialized() || object->GetAsyncAuthorization())
+    {
+        throw Object::Exception(path, interface, "Object cannot be called via a batch request");
+    }
+
+    // The request is authorized and run against the interface of the
+    // object; a call naming another interface would otherwise be
+    // authorized for a different interface than the one it runs in
+    const bool property_get = ("org.freedesktop.DBus.Properties" == interface);
+    if (property_get && "Get" != member)
+    {
+        throw Object::Exception(path, interface, "Only property reads are supported");
+    }
+    if (!property_get && object->GetInterface() != interface)
+    {
+        throw Object::Exception(path, interface, "Interface not found");
+    }
+
+    std::string property{};
+    AsyncProcess::Request::UPtr req{};
+    if (property_get)
+    {
+        const gchar *prop_intf = nullptr;
+        const gchar *prop_name = nullptr;
+        if (!g_variant_is_of_type(args, G_VARIANT_TYPE("(ss)")))
+        {
+            throw Object::Exception(path, interface, "Invalid Get arguments");
+        }
+        g_variant_get(args, "(&s&s)", &prop_intf, &prop_name);
+        if (object->GetInterface() != prop_intf)
+        {
+            throw Object::Exception(path, prop_intf, "Interface not found");
+        }
+        property = prop_name;
+        req = AsyncProcess::Request::Create(connection->ConnPtr(),
+                                            object,
+                                            caller,
+                                            path,
+                                            prop_intf);
+        req->GetProperty(property);
+    }
+    else
+    {
+        req = AsyncProcess::Request::Create(connection->ConnPtr(),
+                                            object,
+                                            caller,
+                                            path,
+                                            interface);
+        req->MethodCall(member, args, nullptr);
+    }
+
+    // Authorize the call the same way as a call arriving directly
+    auto azreq = Authz::Request::Create(req);
+    const auto cache_ttl = object->GetAuthorizationCacheTTL();
+    Authz::Cache::Ptr cache = nullptr;
+    if (cache_ttl.count() > 0)
+    {
+        cache = Authz::Cache::Get(connection->ConnPtr());
+    }
+    if (!cache || !cache->Lookup(azreq))
+    {
+        if (!object->Authorize(azreq))
+        {
+            throw Authz::Exception(azreq, object->AuthorizationRejected(azreq));
+        }
+        if (cache)
+        {
+            cache->Store(azreq, cache_ttl);
+        }
+    }
+
+    if (property_get)
+    {
+        if (!object->PropertyExists(property))
+        {
+            throw Object::Property::Exception(object, property, "Property not found");
+        }
+        GVariant *value = object->GetProperty(property);
+        if (!value)
+        {
+            throw Object::Property::Exception(object,
+                                              property,
+                                              "NULL/nullptr value is not allowed");
+        }
+        return g_variant_ref_sink(g_variant_new("(v)", value));
+    }
+
+    object->MethodCall(req);
+    GVariant *response = req->response;
+    req->response = nullptr;
+    return response;
+}
+
+} // namespace Object
+} // namespace DBus
@@ -0,0 +1,122 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file object/batch.hpp
+ *
+ * @brief Declaration of DBus::Object::BatchObject, running several
+ *        method calls and property reads on other objects in a single
+ *        D-Bus request
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <glib.h>
+
+#include "../connection.hpp"
+#include "base.hpp"
+#include "path.hpp"
+
+
+/**
+ *  Maximum number of calls in a single net.openvpn.gdbuspp.Batch request
+ */
+#define GDBUSPP_BATCH_MAX_CALLS 256
+
+
+namespace DBus {
+namespace Object {
+
+class Manager; // forward declaration; declared in object/manager.hpp
+
+/**
+ *  D-Bus object running a list of method calls and property reads
+ *  against other objects in the same service, within a single D-Bus
+ *  request.  It is enabled via Object::Manager::EnableBatchInterface().
+ *
+ *  Interface net.openvpn.gdbuspp.Batch:
+ *
+ *    - Execute(a(ossv) calls) -> (a(ssv) results)
+ *
+ *  Each call is given as the object path, interface, method and the
+ *  method arguments wrapped in a variant.  Property values are read by
+ *  calling the org.freedesktop.DBus.Properties.Get method with its
+ *  usual (ss) arguments.
+ *
+ *  The results are in the same order as the calls.  Each result carries
+ *  the D-Bus error domain, the error message and the returned values
+ *  wrapped in a variant; the same values a regular D-Bus call would
+ *  return.  The error domain is empty if the call succeeded.
+ *
+ *  Each call is authorized via the DBus::Object::Base::Authorize()
+ *  method of the object being called, as if it was called directly.
+ *  The interface of each call must be the interface of the object being
+ *  called; for property reads, the interface argument of the Get call.
+ *  A failing call does not stop the rest of the calls.  A request with
+ *  more than GDBUSPP_BATCH_MAX_CALLS calls is rejected as a whole.
+ *
+ *  The calls are run directly by the thread processing the batch
+ *  request.  Objects which need the regular request processing cannot
+ *  be called this way; those are objects with
+ *  Object::Base::SerializeRequests() or Object::Base::AsyncAuthorization()
+ *  enabled, objects in a subtree registered via
+ *  Object::Manager::RegisterSubtree() and methods passing file
+ *  descriptors or deferring their reply.
+ */
+class BatchObject : public Object::Base
+{
+  public:
+    /**
+     *  Create the batch object.  This is normally done via
+     *  Object::Manager::EnableBatchInterface().
+     *
+     * @param path        DBus::Object::Path of the batch object
+     * @param connection  DBus::Connection::Ptr the service runs on
+     * @param manager     std::weak_ptr to the Object::Manager owning the
+     *                    objects being called
+     */
+    BatchObject(const Object::Path &path,
+                DBus::Connection::Ptr connection,
+                std::weak_ptr<Manager> manager);
+
+    /**
+     *  The batch call itself is granted to all callers; each call in
+     *  the batch is authorized by the object being called
+     */
+    const bool Authorize(const Authz::Request::Ptr request) override;
+
+
+  private:
+    DBus::Connection::Ptr connection;
+    std::weak_ptr<Manager> manager;
+
+    /**
+     *  Authorize and run a single call from a batch request
+     *
+     * @param caller     std::string with the unique bus name of the caller
+     * @param path       DBus::Object::Path of the object to call
+     * @param interface  std::string with the D-Bus interface of the call
+     * @param member     std::string with the method name
+     * @param args       GVariant* with the method arguments
+     *
+     * @return GVariant* with the values returned by the call.  The caller
+     *         must release it with g_variant_unref().
+     *
+     * @throws DBus::Exception based exceptions if the call failed
+     */
+    GVariant *execute_call(const std::string &caller,
+                           const Object::Path &path,
+                           const std::string &interface,
+                           const std::string &member,
+                           GVariant *args) const;
+};
+
+} // namespace Object
+} // namespace DBus
@@ -106,6 +106,25 @@ void CallbackLink::QueueOperation(AsyncProcess::Request::UPtr &req)
 }
 
 
+void CallbackLink::ReserveOperation(AsyncProcess::Request::UPtr &req)
+{
+    if (!request_pool)
+    {
+        throw CallbackLink::Exception(req, "Request Pool is nullptr");
+    }
+    request_pool->Reserve(req);
+}
+
+
+void CallbackLink::ReleaseOperation(AsyncProcess::Request::UPtr &req) noexcept
+{
+    if (request_pool)
+    {
+        request_pool->Unreserve(req);
+    }
+}
+
+
 ///////////////////////////////////////////////////////////////
 
 
@@ -21,6 +21,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <memory>
 
 #include "../async-process.hpp"
@@ -38,7 +39,7 @@ namespace Object {
  *  is triggered when a D-Bus proxy (client) accesses a D-Bus object on
  *  a service provided over the D-Bus.
  */
-class CallbackLink
+class CallbackLink : public std::enable_shared_from_this<CallbackLink>
 {
   public:
     using Ptr = std::shared_ptr<CallbackLink>;
@@ -110,6 +111,22 @@ class CallbackLink
      */
     void QueueOperation(AsyncProcess::Request::UPtr &req);
 
+    /**
+     *  Count a request waiting for an asynchronous authorization decision
+     *  against the request queue limits.  See AsyncProcess::Pool::Reserve()
+     *
+     * @param req  AsyncProcess::Request object to count
+     */
+    void ReserveOperation(AsyncProcess::Request::UPtr &req);
+
+    /**
+     *  Release the reservation of a request which will not be queued.
+     *  See AsyncProcess::Pool::Unreserve()
+     *
+     * @param req  AsyncProcess::Request object to release
+     */
+    void ReleaseOperation(AsyncProcess::Request::UPtr &req) noexcept;
+
 
     ///< DBus::Object this CallbackLink is related to
     Object::Base::Ptr object;
@@ -121,8 +138,9 @@ class CallbackLink
   private:
     /**
      *  The request_pool is not intended to be used outside of the
-     *  CallbackLink object; the CallbackLink::QueueOperation() method
-     *  is the only method which should have this access
+     *  CallbackLink object; only the CallbackLink::QueueOperation(),
+     *  ReserveOperation() and ReleaseOperation() methods should have
+     *  this access
      */
     AsyncProcess::Pool::Ptr request_pool;
 
@@ -13,40 +13,52 @@
  * @brief  Implements the non-template based methods for the DBus::ObjectManager
  */
 
+#include <cstring>
 #include <iostream>
 #include <string>
 #include <map>
 #include <mutex>
+#include <shared_mutex>
 #include <gio/gio.h>
 
 #include "../async-process.hpp"
+#include "../authz-cache.hpp"
+#include "../authz-request.hpp"
+#define GDBUSPP_LOG_CATEGORY OBJECTS
+#include "../features/debug-log.hpp"
+#include "../features/capture.hpp"
 #include "../features/idle-detect.hpp"
 #include "../glib2/callbacks.hpp"
+#include "../glib2/utils.hpp"
 #include "manager.hpp"
+#include "batch.hpp"
 #include "callbacklink.hpp"
+#include "subtree.hpp"
 
 
-namespace DBus {
-namespace Object {
-
 /**
- *  This namespace is only used for holding library internal data.
- *
- *  The intention is to avoid hiding information useful while debugging,
- *  but at the same time keep it in a separate namespace indicating it
- *  is not to be directly exposed to the users of the library.
+ *  Introspection data of the org.freedesktop.DBus.ObjectManager interface
  */
-namespace _private::Manager {
+static const char *objmgr_introspection =
+    "<node>"
+    "  <interface name='org.freedesktop.DBus.ObjectManager'>"
+    "    <method name='GetManagedObjects'>"
+    "      <arg type='a{oa{sa{sv}}}' name='object_paths_interfaces_and_properties' direction='out'/>"
+    "    </method>"
+    "    <signal name='InterfacesAdded'>"
+    "      <arg type='o' name='object_path'/>"
+    "      <arg type='a{sa{sv}}' name='interfaces_and_properties'/>"
+    "    </signal>"
+    "    <signal name='InterfacesRemoved'>"
+    "      <arg type='o' name='object_path'/>"
+    "      <arg type='as' name='interfaces'/>"
+    "    </signal>"
+    "  </interface>"
+    "</node>";
 
-/**
- *  Mutex to avoid multiple callers to modify the object indices in parallel.
- *
- *  This is used by the Manager::_destructObjectCallback() and
- *  Manager::register_object() methods.
- */
-std::mutex objectmgr_update_mtx;
-} // namespace _private::Manager
 
+namespace DBus {
+namespace Object {
 
 Manager::Exception::Exception(const std::string &errmsg, GError *gliberr)
     : DBus::Exception("ObjectManager", errmsg, gliberr)
@@ -73,13 +85,43 @@ Manager::Manager(DBus::Connection::Ptr conn)
         glib2::Callbacks::_int_dbusobject_callback_method_call,
         glib2::Callbacks::_int_dbusobject_callback_get_property,
         glib2::Callbacks::_int_dbusobject_callback_set_property};
+    _int_dbusobj_interface_vtable_async = {
+        glib2::Callbacks::_int_dbusobject_callback_method_call,
+        nullptr,
+        nullptr};
 
     request_pool = AsyncProcess::Pool::Create();
+    authz_cache = Authz::Cache::Create(connection);
+    watch_request_senders();
+    register_pool_metrics();
+}
+
+
+Manager::~Manager() noexcept
+{
+    if (capture_filter_id > 0)
+    {
+        g_dbus_connection_remove_filter(connection->ConnPtr(), capture_filter_id);
+    }
+    if (objmgr_id > 0)
+    {
+        g_dbus_connection_unregister_object(connection->ConnPtr(), objmgr_id);
+    }
+    for (const auto &[root, id] : subtrees)
+    {
+        g_dbus_connection_unregister_subtree(connection->ConnPtr(), id);
+    }
+    for (auto &[xml, info] : interface_cache)
+    {
+        g_dbus_interface_info_cache_release(info);
+        g_dbus_interface_info_unref(info);
+    }
 }
 
 
 void Manager::PrepareIdleDetector(const std::chrono::duration<uint32_t> timeout,
-                                  std::shared_ptr<DBus::MainLoop> mainloop)
+                                  std::shared_ptr<DBus::MainLoop> mainloop,
+                                  const bool wait_for_requests)
 {
     if (idle_detector)
     {
@@ -101,7 +143,8 @@ void Manager::PrepareIdleDetector(const std::chrono::duration<uint32_t> timeout,
     {
         idle_detector = Features::IdleDetect::Create(mainloop,
                                                      timeout,
-                                                     shared_from_this());
+                                                     shared_from_this(),
+                                                     wait_for_requests);
     }
     catch (const std::bad_weak_ptr &)
     {
@@ -112,6 +155,75 @@ void Manager::PrepareIdleDetector(const std::chrono::duration<uint32_t> timeout,
 }
 
 
+void Manager::ConfigureRequestPool(const AsyncProcess::Pool::Config &cfg)
+{
+    std::unique_lock<std::shared_mutex> lg(objects_mtx);
+    if (!object_map.empty())
+    {
+        throw Manager::Exception("ConfigureRequestPool: "
+                                 "The request pool cannot be changed "
+                                 "after objects have been created");
+    }
+
+    try
+    {
+        request_pool = AsyncProcess::Pool::Create(cfg);
+    }
+    catch (const DBus::Exception &excp)
+    {
+        throw Manager::Exception("ConfigureRequestPool: "
+                                 + std::string(excp.GetRawError()));
+    }
+    watch_request_senders();
+    register_pool_metrics();
+}
+
+
+void Manager::register_pool_metrics()
+{
+    const std::string labels = "connection=\"" + connection->GetUniqueBusName() + "\"";
+    std::weak_ptr<AsyncProcess::Pool> pool = request_pool;
+
+    pool_gauges.clear();
+    pool_gauges.push_back(Features::Metrics::Gauge::Create(
+        "gdbuspp_request_pool_queued",
+        labels,
+        [pool]()
+        {
+            auto p = pool.lock();
+            return (p ? p->GetQueued() : 0);
+        }));
+    pool_gauges.push_back(Features::Metrics::Gauge::Create(
+        "gdbuspp_request_pool_in_flight",
+        labels,
+        [pool]()
+        {
+            auto p = pool.lock();
+            return (p ? p->GetInFlight() : 0);
+        }));
+    pool_gauges.push_back(Features::Metrics::Gauge::Create(
+        "gdbuspp_request_pool_threads",
+        labels,
+        [pool]()
+        {
+            auto p = pool.lock();
+            return (p ? p->GetThreads() : 0);
+        }));
+}
+
+
+void Manager::watch_request_senders()
+{
+    // Peer-to-peer connections have no bus daemon reporting callers
+    // disconnecting; the single peer is the connection itself
+    if (BusType::PEER == connection->GetBusType())
+    {
+        return;
+    }
+    request_pool->WatchSenders(connection);
+}
+
+
 void Manager::RunIdleDetector(const bool run)
 {
     if (idle_detector)
@@ -128,6 +240,12 @@ void Manager::RunIdleDetector(const bool run)
 }
 
 
+bool Manager::DrainRequests(const std::chrono::milliseconds deadline)
+{
+    return request_pool->Drain(deadline);
+}
+
+
 void Manager::IdleActivityUpdate() const noexcept
 {
     if (idle_detector)
@@ -137,166 +255,713 @@ void Manager::IdleActivityUpdate() const noexcept
 }
 
 
+void Manager::idle_object_track(Object::Base *object, const bool tracked)
+{
+    std::lock_guard<std::mutex> lg(idle_mtx);
+    if (object->idle_registered == tracked)
+    {
+        return;
+    }
+    object->idle_registered = tracked;
+    if (!object->disable_idle_detection)
+    {
+        if (tracked)
+        {
+            ++idle_active_objects;
+        }
+        else
+        {
+            --idle_active_objects;
+        }
+    }
+}
+
+
+void Manager::idle_object_update(Object::Base *object, const bool disable)
+{
+    std::lock_guard<std::mutex> lg(idle_mtx);
+    const bool previous = object->disable_idle_detection.exchange(disable);
+    if (!object->idle_registered || previous == disable)
+    {
+        return;
+    }
+    if (disable)
+    {
+        --idle_active_objects;
+    }
+    else
+    {
+        ++idle_active_objects;
+    }
+}
+
+
 void Manager::RemoveObject(const Object::Path &path)
 {
-    try
+    unsigned int obj_id = 0;
+    RemoveObjectCallback remove_cb = nullptr;
     {
-        unsigned int obj_id = path_index.at(path);
+        std::shared_lock<std::shared_mutex> lg(objects_mtx);
+        const PathIndexEntry *entry = lookup_path(path);
+        if (!entry)
+        {
+            throw Manager::Exception("RemoveObject: "
+                                     "Object path not found: "
+                                     + path);
+        }
+        obj_id = entry->object_id;
         const auto rm_callback_it = remove_callbacks.find(obj_id);
         if (remove_callbacks.end() != rm_callback_it)
         {
-            // Call the remove callback when found
-            remove_callbacks.at(obj_id)(path);
+            remove_cb = rm_callback_it->second;
         }
+    }
 
-        g_dbus_connection_unregister_object(connection->ConnPtr(), obj_id);
+    // The lock is released before calling the remove callback and
+    // unregistering the object, as both may end up in methods modifying
+    // the object indices; the unregistering calls _destructObjectCallback()
+    if (remove_cb)
+    {
+        remove_cb(path);
     }
-    catch (const std::out_of_range &)
+    g_dbus_connection_unregister_object(connection->ConnPtr(), obj_id);
+}
+
+
+size_t Manager::RemoveObjectsUnder(const Object::Path &prefix)
+{
+    struct Removal
     {
-        throw Manager::Exception("RemoveObject: "
-                                 "Object path not found: "
-                                 + path);
+        Object::Path path;
+        unsigned int object_id;
+        RemoveObjectCallback remove_cb;
+        Object::Base::Ptr object;
+    };
+    std::vector<Removal> removals{};
+
+    {
+        std::unique_lock<std::shared_mutex> lg(objects_mtx);
+        auto collect = [&](std::map<Object::Path, PathIndexEntry>::iterator it)
+        {
+            it->second.bulk_removed = true;
+            const auto rm_callback_it = remove_callbacks.find(it->second.object_id);
+            removals.push_back({it->first,
+                                it->second.object_id,
+                                (remove_callbacks.end() != rm_callback_it
+                                     ? rm_callback_it->second
+                                     : nullptr),
+                                it->second.link->object});
+        };
+
+        // The path_index is sorted by the D-Bus path, so all the child
+        // objects are found in a single range starting at "prefix/".
+        // The object at the prefix itself is looked up separately, as
+        // paths like "prefix-suffix" are sorted between the two.
+        const std::string child_prefix = ("/" == prefix ? std::string(prefix) : prefix + "/");
+        auto it = path_index.find(prefix);
+        if (path_index.end() != it)
+        {
+            collect(it);
+        }
+        for (it = path_index.lower_bound(child_prefix);
+             path_index.end() != it
+             && 0 == it->first.compare(0, child_prefix.size(), child_prefix);
+             ++it)
+        {
+            if (it->first != prefix)
+            {
+                collect(it);
+            }
+        }
+    }
+
+    // As with RemoveObject(), the lock is released before the remove
+    // callbacks are called and the objects are unregistered.  The
+    // _destructObjectCallback() skips the ObjectManager signal of the
+    // objects flagged as bulk_removed; these are sent below instead.
+    for (const auto &rm : removals)
+    {
+        if (rm.remove_cb)
+        {
+            rm.remove_cb(rm.path);
+        }
+    }
+    for (const auto &rm : removals)
+    {
+        g_dbus_connection_unregister_object(connection->ConnPtr(), rm.object_id);
     }
+    for (const auto &rm : removals)
+    {
+        if (is_objmgr_managed(rm.path))
+        {
+            emit_objmgr_signal(rm.object, false);
+        }
+    }
+    return removals.size();
 }
 
 
 void Manager::AttachRemoveCallback(const Object::Path &path,
                                    RemoveObjectCallback remove_cb)
 {
-    try
-    {
-        unsigned int obj_id = path_index.at(path);
-        remove_callbacks[obj_id] = std::move(remove_cb);
-    }
-    catch (const std::out_of_range &)
+    std::unique_lock<std::shared_mutex> lg(objects_mtx);
+    const PathIndexEntry *entry = lookup_path(path);
+    if (!entry)
     {
         throw Manager::Exception("AttachRemoveCallback: "
                                  "Object path not found: "
                                  + path);
     }
+    remove_callbacks[entry->object_id] = std::move(remove_cb);
 }
 
 
 const std::map<Object::Path, Object::Base::Ptr> Manager::GetAllObjects() const
 {
-    // Loop through all object managed by this Object::Manager
+    // The path_index is already sorted by the D-Bus path, so each
+    // new element can be appended at the end of the result
+    std::shared_lock<std::shared_mutex> lg(objects_mtx);
     std::map<Object::Path, Object::Base::Ptr> ret{};
-    for (const auto &[obj_id, cbl] : object_map)
+    for (const auto &[path, entry] : path_index)
+    {
+        ret.emplace_hint(ret.end(), path, entry.link->object);
+    }
+    return ret;
+}
+
+
+void Manager::ForEachObject(std::function<void(const Object::Path &, Object::Base::Ptr)> fn) const
+{
+    std::shared_lock<std::shared_mutex> lg(objects_mtx);
+    for (const auto &[path, entry] : path_index)
+    {
+        fn(path, entry.link->object);
+    }
+}
+
+
+void Manager::EnableObjectManager(const Object::Path &root)
+{
+    std::unique_lock<std::shared_mutex> lg(objects_mtx);
+    if (objmgr_id > 0)
     {
-        // Look up the D-Bus object path from the object path/object ID index
-        for (const auto &[map_path, map_id] : path_index)
+        throw Manager::Exception("EnableObjectManager: "
+                                 "Already enabled on " + objmgr_root);
+    }
+
+    GError *error = nullptr;
+    GDBusNodeInfo *introsp = g_dbus_node_info_new_for_xml(objmgr_introspection,
+                                                          &error);
+    if (nullptr == introsp || error)
+    {
+        throw Manager::Exception("EnableObjectManager: "
+                                 "Failed to parse introspection XML",
+                                 error);
+    }
+
+    static const GDBusInterfaceVTable objmgr_vtable = {
+        glib2::Callbacks::_int_objectmanager_callback_method_call,
+        nullptr,
+        nullptr};
+    MainLoop::ContextScope scope(connection->GetMainLoop());
+    objmgr_id = g_dbus_connection_register_object(connection->ConnPtr(),
+                                                  root.c_str(),
+                                                  introsp->interfaces[0],
+                                                  &objmgr_vtable,
+                                                  this,
+                                                  nullptr,
+                                                  &error);
+    g_dbus_node_info_unref(introsp);
+    if (objmgr_id < 1)
+    {
+        throw Manager::Exception("EnableObjectManager: "
+                                 "Failed registering "
+                                 "org.freedesktop.DBus.ObjectManager on "
+                                 + root,
+                                 error);
+    }
+    objmgr_root = root;
+}
+
+
+void Manager::EnableBatchInterface(const Object::Path &path)
+{
+    CreateObject<BatchObject>(path, connection, GetWPtr());
+}
+
+
+void Manager::RegisterSubtree(const Object::Path &root,
+                              SubtreeFactory factory,
+                              SubtreeEnumerator enumerator)
+{
+    if (!factory)
+    {
+        throw Manager::Exception("RegisterSubtree: "
+                                 "A factory function is required");
+    }
+
+    install_capture_filter();
+    std::unique_lock<std::shared_mutex> lg(objects_mtx);
+    if (subtrees.find(root) != subtrees.end())
+    {
+        throw Manager::Exception("RegisterSubtree: "
+                                 "Subtree already registered: " + root);
+    }
+
+    static const GDBusSubtreeVTable subtree_vtable = {
+        glib2::Callbacks::_int_subtree_callback_enumerate,
+        glib2::Callbacks::_int_subtree_callback_introspect,
+        glib2::Callbacks::_int_subtree_callback_dispatch,
+        {}};
+
+    // The Subtree object is owned by the glib2 registration, which
+    // keeps it until all pending calls in this subtree are completed
+    MainLoop::Ptr loop = connection->GetMainLoop();
+    auto subtree = new Subtree::Ptr(Subtree::Create(root,
+                                                    std::move(factory),
+                                                    std::move(enumerator),
+                                                    GetWPtr(),
+                                                    request_pool,
+                                                    (loop ? loop->GetContext() : nullptr)));
+    GError *error = nullptr;
+    MainLoop::ContextScope scope(loop);
+    unsigned int id = g_dbus_connection_register_subtree(connection->ConnPtr(),
+                                                         root.c_str(),
+                                                         &subtree_vtable,
+                                                         G_DBUS_SUBTREE_FLAGS_DISPATCH_TO_UNENUMERATED_NODES,
+                                                         subtree,
+                                                         glib2::Callbacks::_int_subtree_callback_destruct,
+                                                         &error);
+    if (id < 1)
+    {
+        throw Manager::Exception("RegisterSubtree: "
+                                 "Failed registering subtree "
+                                 + root,
+                                 error);
+    }
+    subtrees[root] = id;
+}
+
+
+void Manager::RemoveSubtree(const Object::Path &root)
+{
+    unsigned int id = 0;
+    {
+        std::unique_lock<std::shared_mutex> lg(objects_mtx);
+        auto it = subtrees.find(root);
+        if (subtrees.end() == it)
         {
-            // When there is a match between the object ID in the object_map
-            // with the object ID in the path_index, the path_index will point
-            // at the correct D-Bus path ...
-            if (map_id == obj_id)
+            throw Manager::Exception("RemoveSubtree: "
+                                     "Subtree not found: " + root);
+        }
+        id = it->second;
+        subtrees.erase(it);
+    }
+    g_dbus_connection_unregister_subtree(connection->ConnPtr(), id);
+}
+
+
+GVariant *Manager::_getManagedObjects(const std::string &caller) const
+{
+    // Collect the managed objects first, as the authorization and
+    // property lookups must not be done while holding the lock
+    std::vector<Object::Base::Ptr> managed{};
+    {
+        std::shared_lock<std::shared_mutex> lg(objects_mtx);
+        for (const auto &[path, entry] : path_index)
+        {
+            if (is_objmgr_managed(path))
             {
-                // And we can extract the Base::Ptr to the D-Bus object.
-                ret[map_path] = cbl->object;
+                managed.push_back(entry.link->object);
             }
         }
     }
-    return ret;
+
+    glib2::Builder::Scoped bld("a{oa{sa{sv}}}");
+    for (const auto &object : managed)
+    {
+        // Objects where the caller is not allowed to read all the
+        // properties are silently skipped
+        auto azreq = Authz::Request::Create(caller,
+                                            Object::Operation::PROPERTY_GET,
+                                            object->GetPath(),
+                                            object->GetInterface(),
+                                            object->GetInterface() + ".");
+        try
+        {
+            if (!object->Authorize(azreq))
+            {
+                continue;
+            }
+            GVariant *props = object->GetAllProperties();
+            glib2::Builder::Scoped intfs("a{sa{sv}}");
+            intfs.AddFormatted("{s@a{sv}}", object->GetInterface().c_str(), props);
+            bld.AddFormatted("{o@a{sa{sv}}}",
+                             object->GetPath().c_str(),
+                             intfs.Finish());
+        }
+        catch (const DBus::Exception &excp)
+        {
+            GDBUSPP_LOG("GetManagedObjects: Skipping " << object->GetPath()
+                                                       << ": " << excp.what());
+        }
+    }
+    return bld.Finish();
+}
+
+
+bool Manager::is_objmgr_managed(const Object::Path &path) const noexcept
+{
+    if (0 == objmgr_id || path == objmgr_root)
+    {
+        return false;
+    }
+    if ("/" == objmgr_root)
+    {
+        return true;
+    }
+    return path.compare(0, objmgr_root.size(), objmgr_root) == 0
+           && '/' == path[objmgr_root.size()];
+}
+
+
+void Manager::emit_objmgr_signal(const Object::Base::Ptr object, const bool added) const
+{
+    GVariant *params = nullptr;
+    if (added)
+    {
+        glib2::Builder::Scoped intfs("a{sa{sv}}");
+        intfs.AddFormatted("{s@a{sv}}",
+                           object->GetInterface().c_str(),
+                           g_variant_new_array(G_VARIANT_TYPE("{sv}"), nullptr, 0));
+        params = g_variant_new("(o@a{sa{sv}})",
+                               object->GetPath().c_str(),
+                               intfs.Finish());
+    }
+    else
+    {
+        glib2::Builder::Scoped intfs("as");
+        intfs.Add(object->GetInterface());
+        params = g_variant_new("(o@as)",
+                               object->GetPath().c_str(),
+                               intfs.Finish());
+    }
+
+    GError *error = nullptr;
+    if (!Connection::Cork::EmitSignal(connection->ConnPtr(),
+                                      nullptr,
+                                      objmgr_root.c_str(),
+                                      "org.freedesktop.DBus.ObjectManager",
+                                      (added ? "InterfacesAdded" : "InterfacesRemoved"),
+                                      params,
+                                      &error))
+    {
+        GDBUSPP_LOG("Failed emitting ObjectManager signal for "
+                    << object->GetPath() << ": "
+                    << (error ? error->message : "(unknown)"));
+        if (error)
+        {
+            g_error_free(error);
+        }
+    }
 }
 
 
 void Manager::_destructObjectCallback(const Object::Path &path)
 {
-    std::lock_guard<std::mutex> lg(_private::Manager::objectmgr_update_mtx);
+    // The object is released after the lock has been released, as
+    // the object destructor may look up other objects
+    CallbackLink::Ptr released = nullptr;
+    std::unique_lock<std::shared_mutex> lg(objects_mtx);
 
-    const auto path_it = path_index.find(path);
-    if (path_index.end() == path_it)
+    const auto lookup_it = path_lookup.find(path);
+    if (path_lookup.end() == lookup_it)
     {
         throw Manager::Exception("DestructObject: Object path not found: " + path);
     }
+    const auto path_it = lookup_it->second;
 
-    const auto obj_it = object_map.find(path_it->second);
+    const auto obj_it = object_map.find(path_it->second.object_id);
     if (object_map.end() == obj_it)
     {
         throw Manager::Exception("DestructObject: Object index "
-                                 + std::to_string(path_it->second)
+                                 + std::to_string(path_it->second.object_id)
                                  + " not found for path: " + path);
     }
+    released = std::move(obj_it->second);
+    idle_object_track(released->object.get(), false);
+    remove_callbacks.erase(obj_it->first);
     object_map.erase(obj_it);
+    const bool objmgr_notify = !path_it->second.bulk_removed
+                               && is_objmgr_managed(path);
+    path_lookup.erase(lookup_it);
     path_index.erase(path_it);
+    lg.unlock();
+
+    if (objmgr_notify)
+    {
+        emit_objmgr_signal(released->object, false);
+    }
 }
 
 
-void Manager::register_object(const DBus::Object::Base::Ptr object)
+void Manager::RegisterObjects(const std::vector<Object::Base::Ptr> &objects)
 {
-    // Parse the XML introepsection data each D-Bus object must provide
-    GError *error = nullptr;
-    GDBusNodeInfo *introsp = nullptr;
+    install_capture_filter();
+
+    // Retrieve the parsed XML introspection data each D-Bus object
+    // must provide.  Objects sharing the same interface declaration
+    // will only be parsed once, and their method and property
+    // declarations are only kept once.
+    std::vector<GDBusInterfaceInfo *> intf_infos{};
+    intf_infos.reserve(objects.size());
     try
     {
-        std::string xml = object->GenerateIntrospection();
-        introsp = g_dbus_node_info_new_for_xml(xml.c_str(), &error);
+        for (const auto &object : objects)
+        {
+            object->share_declarations();
+            intf_infos.push_back(get_interface_info(object));
+        }
+    }
+    catch (const Manager::Exception &)
+    {
+        for (auto &info : intf_infos)
+        {
+            g_dbus_interface_info_unref(info);
+        }
+        throw;
+    }
 
-        if (nullptr == introsp || error)
+    std::vector<unsigned int> registered{};
+    registered.reserve(objects.size());
+    std::unique_lock<std::shared_mutex> lg(objects_mtx);
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+        const auto &object = objects[i];
+
+        // Prepare a CallbackLink which provides access to this new object,
+        // this object manager and the AsyncProcess based request pool
+        CallbackLink::Ptr cblink = CallbackLink::Create(object, GetWPtr(), request_pool);
+        object->dbus_connection = connection;
+        object->idle_tracker = GetWPtr();
+
+        // Register the new object, via the CallbackLink object, on the D-Bus.
+        //
+        // This will register all the needed C based callback functions
+        // to respond to D-Bus proxy requests on this object.
+        //
+        // A destruction callback function is also setup, which will be
+        // used when the D-Bus object is requested deleted from the D-Bus.
+        //
+        // Since glib2 is C based, there are a few jumps back and forth
+        // before the _destructObjectCallback() method in the ObjectManager
+        // is called to release and delete object
+        //
+        GError *error = nullptr;
+        unsigned int oid = 0;
+        MainLoop::ContextScope scope(connection->GetMainLoop());
+        oid = g_dbus_connection_register_object(connection->ConnPtr(),
+                                                object->GetPath().c_str(),
+                                                intf_infos[i],
+                                                (object->GetAsyncPropertyAccess()
+                                                     ? &_int_dbusobj_interface_vtable_async
+                                                     : &_int_dbusobj_interface_vtable),
+                                                cblink.get(),
+                                                glib2::Callbacks::_int_dbusobject_callback_destruct,
+                                                &error);
+        if (oid < 1)
         {
+            for (size_t r = i; r < intf_infos.size(); ++r)
+            {
+                g_dbus_interface_info_unref(intf_infos[r]);
+            }
+
+            // Roll back the objects already registered in this call.
+            // The lock must be released first, as unregistering the
+            // objects ends up in _destructObjectCallback()
+            lg.unlock();
+            for (const auto &id : registered)
+            {
+                g_dbus_connection_unregister_object(connection->ConnPtr(), id);
+            }
             throw Manager::Exception(object,
-                                     "Failed to parse introspection XML",
+                                     "Failed registering object",
                                      error);
         }
+        g_dbus_interface_info_unref(intf_infos[i]);
+        registered.push_back(oid);
+
+        // Put this object into our internal object container.  This will
+        // be used when a D-Bus object wants to be removed from the D-Bus service.
+        object_map[oid] = cblink;
+        idle_object_track(object.get(), true);
+        auto index_it = path_index.emplace_hint(path_index.end(),
+                                                object->GetPath(),
+                                                PathIndexEntry{oid, cblink});
+        path_lookup.emplace(index_it->first, index_it);
     }
-    catch (...)
+
+    // Signals are emitted after the lock has been released, listeners
+    // will most likely look up the new objects right away
+    std::vector<Object::Base::Ptr> announce{};
+    for (const auto &object : objects)
     {
-        throw;
+        if (is_objmgr_managed(object->GetPath()))
+        {
+            announce.push_back(object);
+        }
+    }
+    lg.unlock();
+    for (const auto &object : announce)
+    {
+        emit_objmgr_signal(object, true);
     }
+}
 
 
-    // Prepare a CallbackLink which provides access to this new object,
-    // this object manager and the AsyncProcess based request pool
-    std::lock_guard<std::mutex> lg(_private::Manager::objectmgr_update_mtx);
-    CallbackLink::Ptr cblink = CallbackLink::Create(object, GetWPtr(), request_pool);
-
-    // Register the new object, via the CallbackLink object, on the D-Bus.
-    //
-    // This will register all the needed C based callback functions
-    // to respond to D-Bus proxy requests on this object.
-    //
-    // A destruction callback function is also setup, which will be
-    // used when the D-Bus object is requested deleted from the D-Bus.
-    //
-    // Since glib2 is C based, there are a few jumps back and forth
-    // before the _destructObjectCallback() method in the ObjectManager
-    // is called to release and delete object
-    //
-    unsigned int oid = 0;
-    oid = g_dbus_connection_register_object(connection->ConnPtr(),
-                                            object->GetPath().c_str(),
-                                            introsp->interfaces[0],
-                                            &_int_dbusobj_interface_vtable,
-                                            cblink.get(),
-                                            glib2::Callbacks::_int_dbusobject_callback_destruct,
-                                            &error);
-    g_dbus_node_info_unref(introsp);
-    if (oid < 1)
+void Manager::register_object(const DBus::Object::Base::Ptr object)
+{
+    RegisterObjects({object});
+}
+
+
+GDBusInterfaceInfo *Manager::get_interface_info(const DBus::Object::Base::Ptr object)
+{
+    std::string xml = object->GenerateInterfaceIntrospection();
+
+    std::lock_guard<std::mutex> lg(interface_cache_mtx);
+    auto it = interface_cache.find(xml);
+    if (interface_cache.end() != it)
     {
+        return g_dbus_interface_info_ref(it->second);
+    }
+
+    GError *error = nullptr;
+    GDBusNodeInfo *introsp = g_dbus_node_info_new_for_xml(("<node>" + xml + "</node>").c_str(),
+                                                          &error);
+    if (nullptr == introsp || error || nullptr == introsp->interfaces[0])
+    {
+        if (introsp)
+        {
+            g_dbus_node_info_unref(introsp);
+        }
         throw Manager::Exception(object,
-                                 "Failed registering object",
+                                 "Failed to parse introspection XML",
                                  error);
     }
+    GDBusInterfaceInfo *info = g_dbus_interface_info_ref(introsp->interfaces[0]);
+    g_dbus_node_info_unref(introsp);
+
+    // Prepares the method, property and signal lookup tables glib2
+    // uses when dispatching calls; done once for all objects sharing it
+    g_dbus_interface_info_cache_build(info);
+
+    // Release declarations no longer used by any registered object,
+    // only referenced by this cache
+    for (auto c = interface_cache.begin(); c != interface_cache.end();)
+    {
+        if (1 == g_atomic_int_get(&c->second->ref_count))
+        {
+            g_dbus_interface_info_cache_release(c->second);
+            g_dbus_interface_info_unref(c->second);
+            c = interface_cache.erase(c);
+        }
+        else
+        {
+            ++c;
+        }
+    }
 
-    // Put this object into our internal object container.  This will
-    // be used when a D-Bus object wants to be removed from the D-Bus service.
-    object_map[oid] = cblink;
-    path_index[object->GetPath()] = oid;
+    interface_cache[xml] = g_dbus_interface_info_ref(info);
+    return info;
 }
 
 
 Object::Base::Ptr Manager::get_object(const Object::Path &path) const
 {
-    try
+    std::shared_lock<std::shared_mutex> lg(objects_mtx);
+    const PathIndexEntry *entry = lookup_path(path);
+    return (entry ? entry->link->object : nullptr);
+}
+
+
+Manager::PathIndexEntry *Manager::lookup_path(std::string_view path) const noexcept
+{
+    const auto it = path_lookup.find(path);
+    return (path_lookup.end() != it ? &it->second->second : nullptr);
+}
+
+
+
+void Manager::install_capture_filter()
+{
+    std::call_once(capture_filter_once,
+                   [this]()
+                   {
+                       // The filter runs in the glib2 D-Bus worker thread
+                       // and may still run after it has been removed, so
+                       // it only keeps a weak reference to this manager
+                       capture_filter_id = g_dbus_connection_add_filter(
+                           connection->ConnPtr(),
+                           capture_filter,
+                           new std::weak_ptr<Manager>(weak_from_this()),
+                           [](gpointer data)
+                           {
+                               delete static_cast<std::weak_ptr<Manager> *>(data);
+                           });
+                   });
+}
+
+
+bool Manager::serves_path(const char *path) const noexcept
+{
+    if (!path)
     {
-        unsigned int id = path_index.at(path);
-        CallbackLink::Ptr cbl = object_map.at(id);
-        return cbl->object;
+        return false;
     }
-    catch (const std::out_of_range &)
+    std::shared_lock<std::shared_mutex> lg(objects_mtx);
+    if (lookup_path(path))
+    {
+        return true;
+    }
+    for (const auto &[root, id] : subtrees)
+    {
+        const size_t len = root.size();
+        if (0 == strncmp(path, root.c_str(), len)
+            && ('\0' == path[len] || '/' == path[len]))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+GDBusMessage *Manager::capture_filter(GDBusConnection *conn,
+                                      GDBusMessage *msg,
+                                      gboolean incoming,
+                                      gpointer user_data)
+{
+    if (!incoming
+        || !Features::Capture::Enabled()
+        || G_DBUS_MESSAGE_TYPE_METHOD_CALL != g_dbus_message_get_message_type(msg)
+        || 0 != g_strcmp0(g_dbus_message_get_interface(msg), "org.freedesktop.DBus.Properties"))
+    {
+        return msg;
+    }
+
+    auto self = static_cast<std::weak_ptr<Manager> *>(user_data)->lock();
+    const char *path = g_dbus_message_get_path(msg);
+    if (self && self->serves_path(path))
     {
-        return nullptr;
+        const char *sender = g_dbus_message_get_sender(msg);
+        Features::Capture::Store((sender ? sender : ""),
+                                 path,
+                                 "org.freedesktop.DBus.Properties",
+                                 g_dbus_message_get_member(msg),
+                                 g_dbus_message_get_body(msg));
     }
+    return msg;
 }
 
 } // namespace Object
@@ -16,8 +16,16 @@
 
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 #include <glib.h>
 
 #include "../connection.hpp"
@@ -26,6 +34,10 @@
 
 namespace DBus {
 
+namespace Authz {
+class Cache; // Forward declaration; see authz-cache.hpp
+}
+
 namespace Features {
 class IdleDetect; // Forward declaration; see features/idle-detect.hpp
 }
@@ -36,6 +48,7 @@ namespace Object {
 
 
 class CallbackLink; // forward declaration; declared in object/callbacklink.hpp
+class Subtree;      // forward declaration; declared in object/subtree.hpp
 
 using RemoveObjectCallback = std::function<void(const Object::Path &)>;
 
@@ -52,6 +65,19 @@ class Manager : public std::enable_shared_from_this<Manager>
     using Ptr = std::shared_ptr<Manager>;
     using WPtr = std::weak_ptr<Manager>;
 
+    /**
+     *  Function creating the DBus::Object::Base object for a D-Bus path
+     *  in a subtree; see RegisterSubtree().  It returns nullptr if
+     *  no such object exists.
+     */
+    using SubtreeFactory = std::function<Object::Base::Ptr(const Object::Path &path)>;
+
+    /**
+     *  Function listing the node names, relative to the subtree root,
+     *  of all the objects in a subtree; see RegisterSubtree()
+     */
+    using SubtreeEnumerator = std::function<std::vector<std::string>()>;
+
     class Exception : public DBus::Exception
     {
       public:
@@ -78,7 +104,7 @@ class Manager : public std::enable_shared_from_this<Manager>
         return Manager::Ptr(new Manager(conn));
     }
 
-    ~Manager() noexcept = default;
+    ~Manager() noexcept;
 
 
     /**
@@ -136,15 +162,48 @@ class Manager : public std::enable_shared_from_this<Manager>
     }
 
 
+    /**
+     *  Registers many already created DBus::Object::Base based objects
+     *  on the D-Bus at once.  This is considerably faster than calling
+     *  @CreateObject() for each object, as the object indices are only
+     *  locked once and identical interface declarations are only parsed
+     *  once.
+     *
+     *  Either all the objects get registered, or none of them.
+     *
+     *  @code
+     *
+     *    std::vector<DBus::Object::Base::Ptr> objects;
+     *    for (const auto &name : names)
+     *    {
+     *        objects.push_back(DBus::Object::Base::Create<MyObject>(name));
+     *    }
+     *    object_mgr->RegisterObjects(objects);
+     *
+     *  @endcode
+     *
+     * @param objects  std::vector<Object::Base::Ptr> of objects to register
+     *
+     * @throws Manager::Exception if any of the objects could not be
+     *         registered
+     */
+    void RegisterObjects(const std::vector<Object::Base::Ptr> &objects);
+
+
     /**
      *  Activate the idle-exit mechanism.  If no objects are active in the
      *  service, the service will shutdown after the given timeout value.
      *
      * @param timeout  std::chrono::duration describing the idle timeout
      *                 of the service
+     * @param mainloop DBus::MainLoop to stop when the service is idling
+     * @param wait_for_requests  bool flag, if true (default) the service is
+     *                 not considered idle while the request pool has
+     *                 queued or in-flight requests
      */
     void PrepareIdleDetector(const std::chrono::duration<uint32_t> timeout,
-                             std::shared_ptr<DBus::MainLoop> mainloop);
+                             std::shared_ptr<DBus::MainLoop> mainloop,
+                             const bool wait_for_requests = true);
 
     /**
      *  Control if the idle detector should run or not.
@@ -155,14 +214,38 @@ class Manager : public std::enable_shared_from_this<Manager>
      *  the D-Bus.
      *
      *  The DBus::Service object can also call this method, as part of the
-     *  shutdown logic; to ensure it does not leave any threads behind.
+     *  shutdown logic; to ensure it does not leave any timers behind.
      *
      * @param run   bool flag to start or stop the Features::IdleDetect
-     *              functionality.  When true, the idle detector thread is
-     *              started, otherwise the thread is stopped.
+     *              functionality.  When true, the idle detector timer is
+     *              armed on the main loop, otherwise the timer is removed.
      */
     void RunIdleDetector(const bool run);
 
+    /**
+     *  Replace the thread pool processing the D-Bus method calls with
+     *  a new one using the given settings.  This must be done before
+     *  any D-Bus objects are created by this Object::Manager.
+     *
+     * @param cfg   AsyncProcess::Pool::Config with the thread pool settings
+     *
+     * @throws Manager::Exception if objects have already been created or
+     *         the thread pool could not be created
+     */
+    void ConfigureRequestPool(const AsyncProcess::Pool::Config &cfg);
+
+    /**
+     *  Stop accepting new D-Bus method calls and property requests which
+     *  are processed by the request pool, and wait for the queued and
+     *  in-flight requests to complete.
+     *
+     * @param deadline  std::chrono::milliseconds of the maximum time to wait
+     *
+     * @return true if all the requests completed before the deadline,
+     *         otherwise false
+     */
+    bool DrainRequests(const std::chrono::milliseconds deadline);
+
     /**
      *  This is primarily called via functions in the glib2::Callbacks scope,
      *  to just update the internal IdleDetect last activity timestamp.  As
@@ -182,6 +265,24 @@ class Manager : public std::enable_shared_from_this<Manager>
      */
     void RemoveObject(const Object::Path &path);
 
+    /**
+     *  Remove an object and all objects below it in the D-Bus path
+     *  hierarchy in a single pass.  This is more efficient than calling
+     *  RemoveObject() for each object when tearing down a larger tree of
+     *  objects.
+     *
+     *  Attached remove callbacks are called for each object before
+     *  any of the objects are unregistered.  If the org.freedesktop.DBus.ObjectManager
+     *  interface is enabled, the InterfacesRemoved signals of all the
+     *  removed objects are sent together once all objects are unregistered.
+     *
+     * @param prefix  DBus::Object::Path to the top of the object tree to
+     *                remove.  The object at this path does not need to exist.
+     *
+     * @return size_t with the number of objects removed
+     */
+    size_t RemoveObjectsUnder(const Object::Path &prefix);
+
     /**
      *  Attaches a remove callback which will be called right before a given
      *  D-Bus object will be removed from the D-Bus.
@@ -227,6 +328,104 @@ class Manager : public std::enable_shared_from_this<Manager>
 
     const std::map<Object::Path, Object::Base::Ptr> GetAllObjects() const;
 
+    /**
+     *  Call a function for each DBus::Object::Base managed object, sorted
+     *  by the D-Bus object path, without making a copy of the object
+     *  index first.
+     *
+     *  The object index is locked while iterating, so the function must
+     *  not create or remove any objects in this Object::Manager.
+     *
+     * @param fn  Function receiving the D-Bus path and the object
+     */
+    void ForEachObject(std::function<void(const Object::Path &, Object::Base::Ptr)> fn) const;
+
+    /**
+     *  Export the org.freedesktop.DBus.ObjectManager interface on the
+     *  given root path.  All objects below this root path are then
+     *  reported via the GetManagedObjects method in a single reply,
+     *  and the InterfacesAdded and InterfacesRemoved signals are
+     *  emitted whenever objects below the root are created or removed.
+     *
+     *  GetManagedObjects only reports objects where the caller is
+     *  granted reading all properties via DBus::Object::Base::Authorize().
+     *  The InterfacesAdded signal is a broadcast signal which cannot be
+     *  authorized per recipient; it will therefore not carry any
+     *  property values.
+     *
+     * @param root  DBus::Object::Path where the interface is exported
+     *
+     * @throws Manager::Exception if the interface is already exported
+     *         or could not be registered
+     */
+    void EnableObjectManager(const Object::Path &root);
+
+    /**
+     *  Export the net.openvpn.gdbuspp.Batch interface, which runs a list
+     *  of method calls and property reads on the objects in this service
+     *  within a single D-Bus request.  Clients with many small operations
+     *  then only pay for one D-Bus message and one request pool dispatch.
+     *  See DBus::Object::BatchObject for details and
+     *  DBus::Proxy::Client::ExecuteBatch() for the client side.
+     *
+     *  Each call in a batch is authorized via the
+     *  DBus::Object::Base::Authorize() method of the called object.
+     *
+     * @param path  DBus::Object::Path where the interface is exported
+     *
+     * @throws Manager::Exception if the object could not be registered
+     */
+    void EnableBatchInterface(const Object::Path &path = "/net/openvpn/gdbuspp/Batch");
+
+    /**
+     *  Register a subtree of D-Bus objects which are only created when
+     *  a D-Bus call arrives for them.  This is intended for very large
+     *  object sets, where registering each object separately would
+     *  require too much memory and time.
+     *
+     *  When a call arrives for a direct child of the root path, the
+     *  factory function is called to create the DBus::Object::Base
+     *  object for it.  Such objects are processed exactly like objects
+     *  created via CreateObject(), but they are released again when
+     *  they have not been used for a few seconds.  They are not
+     *  available via GetObject(), GetAllObjects() or RemoveObject().
+     *
+     *  @code
+     *
+     *    object_mgr->RegisterSubtree(
+     *        "/net/example/peers",
+     *        [](const DBus::Object::Path &path) -> DBus::Object::Base::Ptr
+     *        {
+     *            return DBus::Object::Base::Create<PeerStats>(path);
+     *        },
+     *        []() -> std::vector<std::string>
+     *        {
+     *            return list_peer_ids();
+     *        });
+     *
+     *  @endcode
+     *
+     * @param root        DBus::Object::Path of the subtree root
+     * @param factory     SubtreeFactory creating the objects on demand
+     * @param enumerator  SubtreeEnumerator listing the objects for
+     *                    introspection.  If nullptr, no objects are listed
+     *                    but they can still be accessed.
+     *
+     * @throws Manager::Exception if the subtree could not be registered
+     */
+    void RegisterSubtree(const Object::Path &root,
+                         SubtreeFactory factory,
+                         SubtreeEnumerator enumerator = nullptr);
+
+    /**
+     *  Remove a subtree registered via RegisterSubtree()
+     *
+     * @param root  DBus::Object::Path of the subtree root
+     *
+     * @throws Manager::Exception if the subtree is not found
+     */
+    void RemoveSubtree(const Object::Path &root);
+
 
   private:
     //
@@ -243,12 +442,30 @@ class Manager : public std::enable_shared_from_this<Manager>
      */
     AsyncProcess::Pool::Ptr request_pool{};
 
+    /**
+     *  Cache of granted authorization decisions for the objects which
+     *  have enabled it.  This is shared with other Manager objects on
+     *  the same connection and kept for as long as one of them exists.
+     */
+    std::shared_ptr<Authz::Cache> authz_cache{};
+
     /**
      *  The Idle Detector object.  This is activated via the
      *  PrepareIdleDetector() method.
      */
     std::shared_ptr<Features::IdleDetect> idle_detector{nullptr};
 
+    /**
+     *  Number of registered objects which have not disabled the idle
+     *  detector.  This is updated when objects are registered, removed or
+     *  toggle their DisableIdleDetector() flag, so the idle detector never
+     *  needs to walk through all the objects.
+     */
+    std::atomic<uint32_t> idle_active_objects{0};
+
+    /// Serializes updates of idle_active_objects and Base::idle_registered
+    std::mutex idle_mtx{};
+
     /**
      *  The main object map, which owns the DBus::Object::Base objects.
      *  Via the Object::CallbackLink object, this map keeps a link to
@@ -258,10 +475,59 @@ class Manager : public std::enable_shared_from_this<Manager>
     std::map<unsigned int, std::shared_ptr<CallbackLink>> object_map = {};
 
     /**
-     *  Lookup index to quickly find the glib2 GDBus object id for
-     *  a specific D-Bus path
+     *  Entry in the path_index lookup index
      */
-    std::map<Object::Path, unsigned int> path_index = {};
+    struct PathIndexEntry
+    {
+        unsigned int object_id;             ///< glib2 GDBus object id
+        std::shared_ptr<CallbackLink> link; ///< The object_map entry of the object
+        bool bulk_removed = false;          ///< Removed via RemoveObjectsUnder()
+    };
+
+    /**
+     *  Lookup index to quickly find the glib2 GDBus object id and the
+     *  object for a specific D-Bus path
+     */
+    std::map<Object::Path, PathIndexEntry> path_index = {};
+
+    /**
+     *  Hash index into the path_index, keyed by a view of the path_index
+     *  key, which is valid as long as the path_index entry exists.  Single
+     *  objects are looked up here, avoiding the string comparisons of the
+     *  sorted path_index.  This is protected by the objects_mtx lock.
+     */
+    std::unordered_map<std::string_view,
+                       std::map<Object::Path, PathIndexEntry>::iterator>
+        path_lookup = {};
+
+    /**
+     *  Look up a registered object in the path_index via the path_lookup
+     *  index.  The caller must hold the objects_mtx lock.
+     *
+     * @param path  std::string_view with the D-Bus path of the object
+     *
+     * @return PathIndexEntry pointer, nullptr if the path is not registered
+     */
+    PathIndexEntry *lookup_path(std::string_view path) const noexcept;
+
+    /**
+     *  Install the Features::Capture message filter, if not done already
+     */
+    void install_capture_filter();
+
+    /**
+     *  Check if a D-Bus object path is served by this manager, either
+     *  as a registered object or within a registered subtree
+     *
+     * @param path  C string with the D-Bus object path
+     * @return true if the path belongs to this manager
+     */
+    bool serves_path(const char *path) const noexcept;
+
+    static GDBusMessage *capture_filter(GDBusConnection *conn,
+                                        GDBusMessage *msg,
+                                        gboolean incoming,
+                                        gpointer user_data);
 
     /**
      *  All attached object remove callbacks
@@ -271,12 +537,62 @@ class Manager : public std::enable_shared_from_this<Manager>
      */
     std::map<unsigned int, RemoveObjectCallback> remove_callbacks = {};
 
+    /**
+     *  Reader/writer lock protecting the object_map, path_index, path_lookup and
+     *  remove_callbacks indices.  Lookups take a shared lock, while
+     *  registering and removing objects take an exclusive lock.
+     */
+    mutable std::shared_mutex objects_mtx{};
+
+    /**
+     *  Parsed D-Bus interface declarations, shared between all objects
+     *  providing an identical interface.  The key is the XML <interface/>
+     *  element the declaration was parsed from.  Each entry holds a
+     *  reference to the GDBusInterfaceInfo object.
+     */
+    std::unordered_map<std::string, GDBusInterfaceInfo *> interface_cache = {};
+    std::mutex interface_cache_mtx{};
+
     /**
      *  Callback function table for D-Bus; used by the private
      *  Object::Manager::register_object() method
      */
     GDBusInterfaceVTable _int_dbusobj_interface_vtable;
 
+    /**
+     *  Callback function table for D-Bus objects processing property
+     *  access asynchronously.  Without get/set property callbacks, glib2
+     *  passes org.freedesktop.DBus.Properties calls to the method call
+     *  callback.
+     */
+    GDBusInterfaceVTable _int_dbusobj_interface_vtable_async;
+
+    /**
+     *  Root path of the exported org.freedesktop.DBus.ObjectManager
+     *  interface and its glib2 GDBus object id.  The object id is 0
+     *  when the interface is not exported.
+     */
+    Object::Path objmgr_root{};
+    unsigned int objmgr_id = 0;
+
+    /**
+     *  Subtrees registered via RegisterSubtree().  The key is the subtree
+     *  root path and the value the glib2 GDBus subtree registration id.
+     *  Protected by the objects_mtx lock.
+     */
+    std::map<Object::Path, unsigned int> subtrees = {};
+
+    /**
+     *  glib2 message filter recording org.freedesktop.DBus.Properties
+     *  requests to the objects of this manager for Features::Capture.
+     *  glib2 splits a GetAll call into one get_property callback per
+     *  property, so these requests are recorded as they arrive instead.
+     *  The filter is installed when the first object or subtree is
+     *  registered; the id is 0 until then.
+     */
+    unsigned int capture_filter_id = 0;
+    std::once_flag capture_filter_once{};
+
     //
     //  private methods
     //
@@ -296,6 +612,20 @@ class Manager : public std::enable_shared_from_this<Manager>
      */
     void register_object(const DBus::Object::Base::Ptr object);
 
+    /**
+     *  Retrieve the parsed D-Bus interface declaration of an object.  If
+     *  an identical interface has been parsed before, that result is
+     *  reused.
+     *
+     * @param object  DBus::Object::Base::Ptr to the object
+     *
+     * @return GDBusInterfaceInfo* with a new reference the caller must
+     *         release with g_dbus_interface_info_unref()
+     *
+     * @throws Manager::Exception if the introspection XML could not be parsed
+     */
+    GDBusInterfaceInfo *get_interface_info(const DBus::Object::Base::Ptr object);
+
     /**
      *  Internal method to retrieve the shared_ptr to a DBus::Object::Base
      *  object by D-Bus path
@@ -306,6 +636,65 @@ class Manager : public std::enable_shared_from_this<Manager>
      */
     Object::Base::Ptr get_object(const Object::Path &path) const;
 
+    /**
+     *  Checks if a D-Bus path is below the root path of the exported
+     *  org.freedesktop.DBus.ObjectManager interface.  The objmgr_root
+     *  must not be modified while calling this method.
+     *
+     * @param path  DBus::Object::Path to check
+     * @return true if the object is managed by the ObjectManager interface
+     */
+    bool is_objmgr_managed(const Object::Path &path) const noexcept;
+
+    /**
+     *  Emits the org.freedesktop.DBus.ObjectManager InterfacesAdded or
+     *  InterfacesRemoved signal for an object
+     *
+     * @param object  DBus::Object::Base::Ptr to the added or removed object
+     * @param added   true if the object was added, false if it was removed
+     */
+    void emit_objmgr_signal(const Object::Base::Ptr object, const bool added) const;
+
+    /**
+     *  Let the request pool cancel the requests of callers disconnecting
+     *  from the bus
+     */
+    void watch_request_senders();
+
+    /// Features::Metrics gauges of the request pool; see register_pool_metrics()
+    std::vector<Features::Metrics::Gauge::Ptr> pool_gauges{};
+
+    /**
+     *  Register the Features::Metrics gauges reporting the queue depth,
+     *  in-flight requests and threads of the request pool
+     */
+    void register_pool_metrics();
+
+    /**
+     *  Internal callback method preparing the reply to the
+     *  org.freedesktop.DBus.ObjectManager.GetManagedObjects method.
+     *
+     *  This is only exposed like this for the
+     *  @glib2::Callbacks::_int_objectmanager_callback_method_call function
+     *  to be able to access it.
+     *
+     * @param caller  std::string with the unique bus name of the caller
+     *
+     * @return GVariant* with the a{oa{sa{sv}}} formatted result
+     */
+    GVariant *_getManagedObjects(const std::string &caller) const;
+
+    /// glib2 callback function granted access to this private section,
+    /// used to reply to org.freedesktop.DBus.ObjectManager method calls
+    friend void glib2::Callbacks::_int_objectmanager_callback_method_call(GDBusConnection *conn,
+                                                                          const gchar *sender,
+                                                                          const gchar *obj_path,
+                                                                          const gchar *intf_name,
+                                                                          const gchar *meth_name,
+                                                                          GVariant *params,
+                                                                          GDBusMethodInvocation *invoc,
+                                                                          void *this_ptr);
+
     /**
      *  Internal callback method which deletes the DBus::Object::Base object
      *  from memory.  The object will be removed from the internal object
@@ -323,20 +712,51 @@ class Manager : public std::enable_shared_from_this<Manager>
      */
     void _destructObjectCallback(const Object::Path &path);
 
+    /**
+     *  Add or remove an object from the idle detection active-object
+     *  counter.  Objects which have disabled the idle detector are not
+     *  counted.
+     *
+     * @param object   Object::Base to track
+     * @param tracked  bool flag, true when the object has been registered
+     *                 and false when it has been removed
+     */
+    void idle_object_track(Object::Base *object, const bool tracked);
+
+    /**
+     *  Called by Object::Base::DisableIdleDetector() for registered objects,
+     *  to keep the idle detection active-object counter in sync with the
+     *  object flag.
+     *
+     * @param object   Object::Base changing its idle detector setting
+     * @param disable  bool flag with the new DisableIdleDetector() setting
+     */
+    void idle_object_update(Object::Base *object, const bool disable);
+
+    /// Object::Base::DisableIdleDetector() updates the idle detection
+    /// active-object counter via idle_object_update()
+    friend class Base;
+
     /// glib2 callback function granted access to this private section,
     /// used to delete an Object::Base object via _destructObjectCallback()
     friend void glib2::Callbacks::_int_dbusobject_callback_destruct(void *this_ptr);
 
     /**
-     *  The DBus::Features::IdleDetect::__idle_detector_thread() method
-     *  will be running in a separate thread and need access to loop through
-     *  all the available objects and check if they should be considered in the
-     *  idle detection logic.
+     *  The DBus::Features::IdleDetect timer callback needs access to the
+     *  idle_active_objects counter to check if any objects should keep
+     *  the service running.
      *
      *  The IdleDetect() class is an internal object, not to be exposed to
      *  any external users.
      */
     friend class DBus::Features::IdleDetect;
+
+    /**
+     *  The Object::Subtree needs access to the parsed interface
+     *  declarations and the callback function tables when materializing
+     *  objects.
+     */
+    friend class Subtree;
 };
 
 
@@ -16,11 +16,25 @@
  *         callback function being executed in the running D-Bus service.
  */
 
-#include <algorithm>
-
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+#include <unistd.h>
+
+#define GDBUSPP_LOG_CATEGORY OBJECTS
+#include "../connection.hpp"
 #include "../features/debug-log.hpp"
 #include "../glib2/utils.hpp"
 #include "method.hpp"
+#include "shared-registry.hpp"
+
+
+/**
+ *  Maximum number of released per-invocation Arguments objects
+ *  each method keeps around for reuse
+ */
+#define DBUS_METHOD_ARGS_POOL_SIZE 16
 
 namespace DBus {
 namespace Object {
@@ -59,12 +73,56 @@ class CallbackArguments : public Arguments
 
     ~CallbackArguments() noexcept = default;
 
+    /**
+     *  Create a new Arguments object for a single invocation of the
+     *  method.  It shares the argument declaration with this object,
+     *  but has its own request information and return values.
+     *
+     * @return CallbackArguments::Ptr
+     */
+    CallbackArguments::Ptr Clone() const
+    {
+        // Only the declaration is taken over; the request information
+        // is set up by each invocation
+        CallbackArguments::Ptr args(new CallbackArguments());
+        args->declaration = std::atomic_load(&declaration);
+        args->pass_fd_mode = pass_fd_mode;
+        return args;
+    }
+
+    /**
+     *  Reset all the request related information, preparing this object
+     *  to be reused by another invocation.  File descriptors which were
+     *  never sent back to the caller are closed.
+     */
+    void Reset() noexcept;
+
     void SetRequestInfo(AsyncProcess::Request::UPtr &req);
 
     void PrepareResponse(AsyncProcess::Request::UPtr &req);
 
     GVariant *GetReturnArgs() const noexcept;
 
+    /**
+     *  Check if the method callback deferred its reply
+     *
+     * @return true if Arguments::Defer() was called
+     */
+    bool IsDeferred() const noexcept
+    {
+        return nullptr != deferred;
+    }
+
+    /**
+     *  Take back the reply responsibility from a deferred reply
+     *
+     * @return true if no reply has been sent via the deferred reply
+     */
+    bool RevokeDeferred() noexcept
+    {
+        return deferred && deferred->revoke();
+    }
+
     /**
      *  Generates the XML snippet tags of all declared arguments to a method
      *
@@ -74,6 +132,7 @@ class CallbackArguments : public Arguments
 
   private:
     CallbackArguments() = default;
+    CallbackArguments(const CallbackArguments &) = delete;
 };
 
 
@@ -105,7 +164,7 @@ Exception::Exception(const std::string &errm, GError *gliberr)
  * @param arglist
  * @return const std::string
  */
-static const std::string _arguments_gen_dbus_type(std::vector<struct _method_argument> arglist)
+static const std::string _arguments_gen_dbus_type(const std::vector<struct _method_argument> &arglist)
 {
     std::ostringstream ret;
     ret << "(";
@@ -123,9 +182,12 @@ static const std::string _arguments_gen_dbus_type(std::vector<struct _method_arg
  *  data variables provided in a GVariant * object.
  *
  * @param arglist
+ * @param type     Precompiled data type of the argument list
  * @param params
  */
-static void _arguments_validate_arguments(std::vector<struct _method_argument> arglist, GVariant *params)
+static void _arguments_validate_arguments(const std::vector<struct _method_argument> &arglist,
+                                          const glib2::Utils::VariantType &type,
+                                          GVariant *params)
 {
     if (0 == arglist.size() && nullptr == params)
     {
@@ -134,8 +196,38 @@ static void _arguments_validate_arguments(std::vector<struct _method_argument> a
         // are passed
         return;
     }
-    std::string expect = _arguments_gen_dbus_type(arglist);
-    glib2::Utils::checkParams(__func__, params, expect.c_str(), arglist.size());
+    glib2::Utils::checkParams(__func__, params, type, arglist.size());
+}
+
+
+/**
+ *  Validate the D-Bus data type of a single argument.  The data type
+ *  of the complete argument list is only compiled once the object is
+ *  registered; see Arguments::compile_types()
+ *
+ * @param dbustype  std::string with the D-Bus data type of the argument
+ * @throws Method::Exception if the argument data type is invalid
+ */
+static void _arguments_validate_type(const std::string &dbustype)
+{
+    if (!g_variant_type_string_is_valid(("(" + dbustype + ")").c_str()))
+    {
+        throw Method::Exception("Invalid D-Bus data type: '" + dbustype + "'");
+    }
+}
+
+
+/**
+ *  Compile the data type of an argument list.  This is done once the
+ *  object is registered; objects not registered compile it on each use.
+ *
+ * @param arglist
+ * @return glib2::Utils::VariantType
+ */
+static glib2::Utils::VariantType _arguments_compile_type(const std::vector<struct _method_argument> &arglist)
+{
+    // Each argument data type was validated when it was declared
+    return glib2::Utils::VariantType(_arguments_gen_dbus_type(arglist));
 }
 
 
@@ -150,13 +242,23 @@ static void _arguments_validate_arguments(std::vector<struct _method_argument> a
 
 void Arguments::AddInput(const std::string &name, const std::string &dbustype)
 {
-    input.push_back({name, dbustype});
+    _arguments_validate_type(dbustype);
+    modify_declaration([&name, &dbustype](Declaration &decl)
+                       {
+                           decl.input.push_back({name, dbustype});
+                           ++decl.revision;
+                       });
 }
 
 
 void Arguments::AddOutput(const std::string &name, const std::string &dbustype)
 {
-    output.push_back({name, dbustype});
+    _arguments_validate_type(dbustype);
+    modify_declaration([&name, &dbustype](Declaration &decl)
+                       {
+                           decl.output.push_back({name, dbustype});
+                           ++decl.revision;
+                       });
 }
 
 
@@ -174,7 +276,15 @@ void Arguments::ValidateInputType(GVariant *params) const
 {
     try
     {
-        _arguments_validate_arguments(input, params);
+        const auto decl = get_declaration();
+        if (decl->input_type)
+        {
+            _arguments_validate_arguments(decl->input, *decl->input_type, params);
+        }
+        else
+        {
+            _arguments_validate_arguments(decl->input, _arguments_compile_type(decl->input), params);
+        }
     }
     catch (const glib2::Utils::Exception &excp)
     {
@@ -187,7 +297,15 @@ void Arguments::ValidateOutputType(GVariant *params) const
 {
     try
     {
-        _arguments_validate_arguments(output, params);
+        const auto decl = get_declaration();
+        if (decl->output_type)
+        {
+            _arguments_validate_arguments(decl->output, *decl->output_type, params);
+        }
+        else
+        {
+            _arguments_validate_arguments(decl->output, _arguments_compile_type(decl->output), params);
+        }
     }
     catch (const glib2::Utils::Exception &excp)
     {
@@ -205,7 +323,13 @@ GVariant *Arguments::GetMethodParameters() const noexcept
 
 int Arguments::ReceiveFD() const
 {
-    if (PassFDmode::RECEIVE != pass_fd_mode)
+    return (!ReceiveFDs().empty() ? fd_receive[0] : -1);
+}
+
+
+const std::vector<int> &Arguments::ReceiveFDs() const
+{
+    if (PassFDmode::RECEIVE != pass_fd_mode && PassFDmode::BOTH != pass_fd_mode)
     {
         throw Method::Exception("Method is not setup up for receiving file descriptors");
     }
@@ -213,6 +337,21 @@ int Arguments::ReceiveFD() const
 }
 
 
+Payload::Ptr Arguments::ReceivePayload()
+{
+    const bool fd_receive_enabled = (PassFDmode::RECEIVE == pass_fd_mode
+                                     || PassFDmode::BOTH == pass_fd_mode);
+    const int fd = (fd_receive_enabled && !fd_receive.empty() ? fd_receive[0] : -1);
+    Payload::Ptr payload = Payload::Parse(call_params, fd);
+    if (payload->IsMapped())
+    {
+        close(fd);
+        fd_receive.erase(fd_receive.begin());
+    }
+    return payload;
+}
+
+
 void Arguments::SetMethodReturn(GVariant *result) noexcept
 {
     return_params = result;
@@ -221,11 +360,43 @@ void Arguments::SetMethodReturn(GVariant *result) noexcept
 
 void Arguments::SendFD(int &fd)
 {
-    if (PassFDmode::SEND != pass_fd_mode)
+    if (PassFDmode::SEND != pass_fd_mode && PassFDmode::BOTH != pass_fd_mode)
     {
         throw Method::Exception("Method is not setup up for sending file descriptors");
     }
-    fd_send = fd;
+    fd_send.push_back(fd);
+}
+
+
+void Arguments::SendFDs(const std::vector<int> &fds)
+{
+    for (int fd : fds)
+    {
+        SendFD(fd);
+    }
+}
+
+
+void Arguments::SendPayload(const void *data,
+                            const size_t size,
+                            const size_t threshold)
+{
+    const bool fd_send_enabled = (PassFDmode::SEND == pass_fd_mode
+                                  || PassFDmode::BOTH == pass_fd_mode);
+    const bool fd_capable = (dbusconn
+                             && (g_dbus_connection_get_capabilities(const_cast<GDBusConnection *>(dbusconn))
+                                 & G_DBUS_CAPABILITY_FLAGS_UNIX_FD_PASSING));
+    int fd = -1;
+    GVariant *result = Payload::Prepare(data,
+                                        size,
+                                        fd,
+                                        (fd_send_enabled && fd_capable ? threshold : SIZE_MAX));
+    SetMethodReturn(result);
+    if (fd >= 0)
+    {
+        // The file descriptor is closed once the response has been sent
+        SendFD(fd);
+    }
 }
 
 
@@ -235,22 +406,90 @@ const std::string Arguments::GetCallerBusName() const noexcept
 }
 
 
+bool Arguments::IsCancelled() const noexcept
+{
+    return cancellable && g_cancellable_is_cancelled(cancellable);
+}
+
+
+GCancellable *Arguments::GetCancellable() const noexcept
+{
+    return cancellable;
+}
+
+
+DeferredReply::Ptr Arguments::Defer()
+{
+    if (!invocation)
+    {
+        throw Method::Exception("No method call to defer the reply for");
+    }
+    if (deferred)
+    {
+        throw Method::Exception("Method reply is already deferred");
+    }
+    const auto decl = get_declaration();
+    deferred = DeferredReply::Ptr(new DeferredReply(invocation,
+                                                    cancellable,
+                                                    dbusconn,
+                                                    (decl->output_type
+                                                         ? *decl->output_type
+                                                         : _arguments_compile_type(decl->output)),
+                                                    (PassFDmode::SEND == pass_fd_mode
+                                                     || PassFDmode::BOTH == pass_fd_mode),
+                                                    error_domain));
+    return deferred;
+}
+
+
+void Arguments::SetPriority(const AsyncProcess::Priority prio) noexcept
+{
+    modify_declaration([prio](Declaration &decl)
+                       {
+                           decl.priority = prio;
+                       });
+}
+
+
+AsyncProcess::Priority Arguments::GetPriority() const noexcept
+{
+    return get_declaration()->priority;
+}
+
+
+void Arguments::SetInline(const bool run_inline) noexcept
+{
+    modify_declaration([run_inline](Declaration &decl)
+                       {
+                           decl.run_inline = run_inline;
+                       });
+}
+
+
+bool Arguments::IsInline() const noexcept
+{
+    return get_declaration()->run_inline;
+}
+
+
 const bool Arguments::empty() const
 {
-    return input.empty() && output.empty();
+    const auto decl = get_declaration();
+    return decl->input.empty() && decl->output.empty();
 }
 
 
 const std::string Arguments::GenerateIntrospection() const
 {
+    const auto decl = get_declaration();
     std::ostringstream ret;
-    for (const auto &ia : input)
+    for (const auto &ia : decl->input)
     {
         ret << " <arg type='" << ia.dbustype << "'"
             << " name='" << ia.name << "' "
             << " direction='in'/>" << std::endl;
     }
-    for (const auto &oa : output)
+    for (const auto &oa : decl->output)
     {
         ret << " <arg type='" << oa.dbustype << "'"
             << " name='" << oa.name << "' "
@@ -260,6 +499,34 @@ const std::string Arguments::GenerateIntrospection() const
 }
 
 
+void Arguments::modify_declaration(const std::function<void(Declaration &)> &modify)
+{
+    auto decl = std::atomic_load(&declaration);
+    if (!decl->registered)
+    {
+        // Not yet used by any method call or other objects
+        modify(*decl);
+        return;
+    }
+
+    // Method calls and other objects may use this declaration; only
+    // this method should see the change, once it is complete
+    auto own = std::make_shared<Declaration>(*decl);
+    own->shared = false;
+    own->introspection.clear();
+    modify(*own);
+    compile_types(*own);
+    set_declaration(std::move(own));
+}
+
+
+void Arguments::compile_types(Declaration &decl)
+{
+    decl.input_type = _arguments_compile_type(decl.input);
+    decl.output_type = _arguments_compile_type(decl.output);
+}
+
+
 
 ///////////////////////////////////////////////////////////////////////////
 //
@@ -274,24 +541,43 @@ void CallbackArguments::SetRequestInfo(AsyncProcess::Request::UPtr &req)
     ValidateInputType(req->params);
     call_params = req->params;
     sender = req->sender;
-
-    if (PassFDmode::RECEIVE == pass_fd_mode)
+    invocation = req->invocation;
+    cancellable = req->cancellable;
+    dbusconn = req->dbusconn;
+    error_domain = req->error_domain;
+    deferred.reset();
+    fd_receive.clear();
+    fd_send.clear();
+
+    if (req->invocation
+        && (PassFDmode::RECEIVE == pass_fd_mode || PassFDmode::BOTH == pass_fd_mode))
     {
         glib2::Utils::CheckCapabilityFD(req->dbusconn);
 
-        // It might be the file descriptor is available in the D-Bus invocation
-        // object; attempt to retrieve it from there first
+        // It might be the file descriptors are available in the D-Bus
+        // invocation object; attempt to retrieve them from there first
         GDBusMessage *dmsg = g_dbus_method_invocation_get_message(req->invocation);
         GUnixFDList *fdlist = g_dbus_message_get_unix_fd_list(dmsg);
         if (fdlist != nullptr)
         {
-            GError *error = nullptr;
-            fd_receive = g_unix_fd_list_get(fdlist, 0, &error);
-            if (fd_receive < 0 || error)
+            const int count = g_unix_fd_list_get_length(fdlist);
+            fd_receive.reserve(count);
+            for (int i = 0; i < count; ++i)
             {
-                throw Object::Exception(req->object,
-                                        "Could not retrieve file descriptors from D-Bus call",
-                                        error);
+                GError *error = nullptr;
+                int fd = g_unix_fd_list_get(fdlist, i, &error);
+                if (fd < 0 || error)
+                {
+                    for (int f : fd_receive)
+                    {
+                        close(f);
+                    }
+                    fd_receive.clear();
+                    throw Object::Exception(req->object,
+                                            "Could not retrieve file descriptors from D-Bus call",
+                                            error);
+                }
+                fd_receive.push_back(fd);
             }
         }
     }
@@ -302,7 +588,23 @@ void CallbackArguments::PrepareResponse(AsyncProcess::Request::UPtr &req)
 {
     ValidateOutputType(return_params);
 
-    if (PassFDmode::SEND == pass_fd_mode && -1 < fd_send)
+    if (!req->invocation)
+    {
+        // Called without a D-Bus method call, via Object::BatchObject;
+        // the caller picks up the result from the request
+        if (!fd_send.empty())
+        {
+            throw Object::Exception(req->object,
+                                    "File descriptors cannot be returned "
+                                    "without a D-Bus method call");
+        }
+        req->response = g_variant_ref_sink(return_params
+                                               ? return_params
+                                               : g_variant_new("()"));
+        return;
+    }
+
+    if (!fd_send.empty())
     {
         glib2::Utils::CheckCapabilityFD(req->dbusconn);
 
@@ -312,23 +614,48 @@ void CallbackArguments::PrepareResponse(AsyncProcess::Request::UPtr &req)
             throw Object::Exception(req->object,
                                     "Failed allocating file descriptor return list");
         }
-        GError *error = nullptr;
-        if (g_unix_fd_list_append(fdlist, fd_send, &error) < 0)
+        for (int fd : fd_send)
         {
-            throw Object::Exception(req->object,
-                                    "Failed preparing file descriptor return list",
-                                    error);
+            GError *error = nullptr;
+            if (g_unix_fd_list_append(fdlist, fd, &error) < 0)
+            {
+                glib2::Utils::unref_fdlist(fdlist);
+                throw Object::Exception(req->object,
+                                        "Failed preparing file descriptor return list",
+                                        error);
+            }
+        }
+        for (int fd : fd_send)
+        {
+            close(fd);
         }
-        close(fd_send);
-        g_dbus_method_invocation_return_value_with_unix_fd_list(req->invocation,
-                                                                return_params,
-                                                                fdlist);
+        fd_send.clear();
+        Connection::Cork::ReturnValue(req->invocation, return_params, fdlist);
         glib2::Utils::unref_fdlist(fdlist);
     }
     else
     {
-        g_dbus_method_invocation_return_value(req->invocation, return_params);
+        Connection::Cork::ReturnValue(req->invocation, return_params);
+    }
+}
+
+
+void CallbackArguments::Reset() noexcept
+{
+    for (int fd : fd_send)
+    {
+        close(fd);
     }
+    fd_send.clear();
+    fd_receive.clear();
+    sender.clear();
+    call_params = nullptr;
+    return_params = nullptr;
+    invocation = nullptr;
+    cancellable = nullptr;
+    dbusconn = nullptr;
+    error_domain.clear();
+    deferred.reset();
 }
 
 
@@ -345,6 +672,177 @@ const std::string CallbackArguments::GenerateIntrospection() const
 
 
 
+///////////////////////////////////////////////////////////////////////////
+//
+//  class Method::DeferredReply
+//
+///////////////////////////////////////////////////////////////////////////
+
+
+
+DeferredReply::DeferredReply(GDBusMethodInvocation *invoc,
+                             GCancellable *cancel,
+                             const GDBusConnection *conn,
+                             const glib2::Utils::VariantType &output_type_,
+                             const bool fd_send_enabled_,
+                             const std::string &error_domain_)
+    : invocation(invoc), dbusconn(conn), output_type(output_type_),
+      fd_send_enabled(fd_send_enabled_), error_domain(error_domain_),
+      cancellable(cancel ? G_CANCELLABLE(g_object_ref(cancel)) : nullptr)
+{
+}
+
+
+DeferredReply::~DeferredReply() noexcept
+{
+    if (invocation)
+    {
+        std::cerr << "** ERROR **  DBus::Object::Method::DeferredReply "
+                  << "released without reply" << std::endl;
+        return_error("Method call was not completed");
+    }
+    for (int fd : fd_send)
+    {
+        close(fd);
+    }
+    if (cancellable)
+    {
+        g_object_unref(cancellable);
+    }
+}
+
+
+void DeferredReply::SendFD(int fd)
+{
+    std::lock_guard<std::mutex> lg(mtx);
+    if (!invocation)
+    {
+        throw Method::Exception("Method reply has already been sent");
+    }
+    if (!fd_send_enabled)
+    {
+        throw Method::Exception("Method is not declared to send file descriptors");
+    }
+    fd_send.push_back(fd);
+}
+
+
+void DeferredReply::SendFDs(const std::vector<int> &fds)
+{
+    for (int fd : fds)
+    {
+        SendFD(fd);
+    }
+}
+
+
+void DeferredReply::Return(GVariant *result)
+{
+    std::lock_guard<std::mutex> lg(mtx);
+    if (!invocation)
+    {
+        throw Method::Exception("Method reply has already been sent");
+    }
+    if (result)
+    {
+        g_variant_take_ref(result);
+    }
+    if (!(result ? output_type.Matches(result) : "()" == output_type.str()))
+    {
+        std::string received = (result ? g_variant_get_type_string(result) : "()");
+        if (result)
+        {
+            g_variant_unref(result);
+        }
+        throw Method::Exception("Invalid data type for the deferred reply, "
+                                "expected '"
+                                + output_type.str() + "' but received '"
+                                + received + "'");
+    }
+
+    if (!fd_send.empty())
+    {
+        glib2::Utils::CheckCapabilityFD(dbusconn);
+
+        GUnixFDList *fdlist = g_unix_fd_list_new();
+        for (int fd : fd_send)
+        {
+            GError *error = nullptr;
+            if (g_unix_fd_list_append(fdlist, fd, &error) < 0)
+            {
+                glib2::Utils::unref_fdlist(fdlist);
+                if (result)
+                {
+                    g_variant_unref(result);
+                }
+                throw Method::Exception("Failed preparing file descriptor return list",
+                                        error);
+            }
+        }
+        for (int fd : fd_send)
+        {
+            close(fd);
+        }
+        fd_send.clear();
+        Connection::Cork::ReturnValue(invocation, result, fdlist);
+        glib2::Utils::unref_fdlist(fdlist);
+    }
+    else
+    {
+        Connection::Cork::ReturnValue(invocation, result);
+    }
+    if (result)
+    {
+        g_variant_unref(result);
+    }
+    invocation = nullptr;
+}
+
+
+void DeferredReply::ReturnError(const std::string &errmsg)
+{
+    std::lock_guard<std::mutex> lg(mtx);
+    if (!invocation)
+    {
+        throw Method::Exception("Method reply has already been sent");
+    }
+    return_error(errmsg);
+}
+
+
+bool DeferredReply::Replied() const noexcept
+{
+    std::lock_guard<std::mutex> lg(mtx);
+    return nullptr == invocation;
+}
+
+
+bool DeferredReply::IsCancelled() const noexcept
+{
+    return cancellable && g_cancellable_is_cancelled(cancellable);
+}
+
+
+bool DeferredReply::revoke() noexcept
+{
+    std::lock_guard<std::mutex> lg(mtx);
+    if (!invocation)
+    {
+        return false;
+    }
+    invocation = nullptr;
+    return true;
+}
+
+
+void DeferredReply::return_error(const std::string &errmsg) noexcept
+{
+    DBus::Exception::ReturnMethodError(invocation, error_domain, errmsg);
+    invocation = nullptr;
+}
+
+
+
 ///////////////////////////////////////////////////////////////////////////
 //
 //  class Method::Callback
@@ -361,6 +859,12 @@ Arguments::Ptr Callback::GetArgsList() const
 
 const std::string Callback::GenerateIntrospection() const
 {
+    const auto decl = method_args->get_declaration();
+    if (decl->shared)
+    {
+        return decl->introspection;
+    }
+
     std::ostringstream ret;
     if (method_args->empty())
     {
@@ -376,6 +880,12 @@ const std::string Callback::GenerateIntrospection() const
 }
 
 
+unsigned int Callback::GetRevision() const noexcept
+{
+    return method_args->get_declaration()->revision;
+}
+
+
 const std::string Callback::GetMethodName() const
 {
     return method_name;
@@ -384,17 +894,66 @@ const std::string Callback::GetMethodName() const
 
 void Callback::Execute(AsyncProcess::Request::UPtr &req)
 {
-    method_args->SetRequestInfo(req);
-    callback_fn(static_cast<Arguments::Ptr>(method_args));
+    if (raw_callback_fn)
+    {
+        execute_raw(req);
+        return;
+    }
+
+    // Each invocation has its own Arguments object, so the same
+    // method can be run by several threads at the same time
+    auto args = acquire_args();
+    try
+    {
+        args->SetRequestInfo(req);
+        const int64_t exec_start = (req->metrics ? g_get_monotonic_time() : 0);
+        try
+        {
+            callback_fn(static_cast<Arguments::Ptr>(args));
+            if (req->metrics)
+            {
+                req->metrics->execution.Record(g_get_monotonic_time() - exec_start);
+            }
+        }
+        catch (...)
+        {
+            if (req->metrics)
+            {
+                req->metrics->execution.Record(g_get_monotonic_time() - exec_start);
+                ++req->metrics->errors;
+            }
+
+            // If the reply was deferred, the caller must only get a single
+            // reply; if the deferred reply was sent already, the error is
+            // dropped
+            if (args->IsDeferred() && !args->RevokeDeferred())
+            {
+                release_args(args);
+                return;
+            }
+            throw;
+        }
 
-#ifdef GDBUSPP_INTERNAL_DEBUG
-    GVariant *result = method_args->GetReturnArgs();
-    GDBUSPP_LOG("Callback::Execute (return) - "
-                << req << " - Result: "
-                << (result ? g_variant_print(result, true) : "(n/a)"));
-#endif
+        if (args->IsDeferred())
+        {
+            // The reply is sent later via the DeferredReply handle
+            GDBUSPP_LOG("Callback::Execute (deferred) - " << req);
+            release_args(args);
+            return;
+        }
+
+        GDBUSPP_LOG("Callback::Execute (return) - "
+                    << req << " - Result: "
+                    << Features::Trace::VariantString(args->GetReturnArgs()));
 
-    method_args->PrepareResponse(req);
+        args->PrepareResponse(req);
+    }
+    catch (...)
+    {
+        release_args(args);
+        throw;
+    }
+    release_args(args);
 }
 
 
@@ -406,6 +965,176 @@ Callback::Callback(const std::string &method_name_, CallbackFnc callback)
 }
 
 
+Callback::Callback(const std::string &method_name_, RawCallbackFnc raw_callback)
+    : method_name(method_name_),
+      raw_callback_fn(std::move(raw_callback))
+{
+    method_args = CallbackArguments::Create();
+    method_args->AddInput("data", "ay");
+    method_args->AddOutput("data", "ay");
+}
+
+
+void Callback::execute_raw(AsyncProcess::Request::UPtr &req)
+{
+    if (!req->params || !g_variant_is_of_type(req->params, G_VARIANT_TYPE("(ay)")))
+    {
+        throw Method::Exception("Unexpected input type - expected (ay)");
+    }
+
+    // The byte array is handed over as a reference into the received
+    // message, without decoding the elements
+    GVariant *blob = g_variant_get_child_value(req->params, 0);
+    GBytes *input = g_variant_get_data_as_bytes(blob);
+    g_variant_unref(blob);
+
+    const int64_t exec_start = (req->metrics ? g_get_monotonic_time() : 0);
+    GBytes *output = nullptr;
+    try
+    {
+        output = raw_callback_fn(req->sender, input);
+    }
+    catch (...)
+    {
+        g_bytes_unref(input);
+        if (req->metrics)
+        {
+            req->metrics->execution.Record(g_get_monotonic_time() - exec_start);
+            ++req->metrics->errors;
+        }
+        throw;
+    }
+    g_bytes_unref(input);
+    if (req->metrics)
+    {
+        req->metrics->execution.Record(g_get_monotonic_time() - exec_start);
+    }
+
+    GVariant *data = nullptr;
+    if (output)
+    {
+        data = g_variant_new_from_bytes(G_VARIANT_TYPE_BYTESTRING, output, TRUE);
+        g_bytes_unref(output);
+    }
+    else
+    {
+        data = g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, nullptr, 0, sizeof(guchar));
+    }
+    GVariant *reply = g_variant_new("(@ay)", data);
+
+    if (!req->invocation)
+    {
+        // Called via Object::BatchObject
+        req->response = g_variant_ref_sink(reply);
+        return;
+    }
+    Connection::Cork::ReturnValue(req->invocation, reply);
+}
+
+
+AsyncProcess::Priority Callback::GetPriority() const noexcept
+{
+    return method_args->GetPriority();
+}
+
+
+bool Callback::IsInline() const noexcept
+{
+    return method_args->IsInline();
+}
+
+
+std::shared_ptr<CallbackArguments> Callback::acquire_args()
+{
+    {
+        std::lock_guard<std::mutex> lg(args_pool_mtx);
+        if (!args_pool.empty())
+        {
+            auto args = std::move(args_pool.back());
+            args_pool.pop_back();
+
+            // The method declaration may have been replaced since
+            // this object was released
+            auto decl = std::atomic_load(&method_args->declaration);
+            if (args->declaration != decl)
+            {
+                args->declaration = std::move(decl);
+            }
+            return args;
+        }
+    }
+    return method_args->Clone();
+}
+
+
+void Callback::release_args(std::shared_ptr<CallbackArguments> &args) noexcept
+{
+    if (1 != args.use_count())
+    {
+        // The callback function or a deferred reply kept a reference;
+        // it is still in use and must not be reset or reused
+        args.reset();
+        return;
+    }
+    args->Reset();
+    std::lock_guard<std::mutex> lg(args_pool_mtx);
+    if (args_pool.size() < DBUS_METHOD_ARGS_POOL_SIZE)
+    {
+        args_pool.push_back(std::move(args));
+    }
+}
+
+
+size_t Callback::shared_declarations() noexcept
+{
+    return _private::SharedRegistry<Arguments::Declaration>::Instance()->size();
+}
+
+
+void Callback::share_declaration(const std::string &interface)
+{
+    auto decl = std::atomic_load(&method_args->declaration);
+    if (decl->shared)
+    {
+        return;
+    }
+
+    // The key is built from the declaration itself; the introspection
+    // fragment is only generated for the first object sharing it
+    std::ostringstream key;
+    key << interface << "\n"
+        << method_name << "\n";
+    for (const auto &arg : decl->input)
+    {
+        key << "i:" << arg.name << ":" << arg.dbustype << "\n";
+    }
+    for (const auto &arg : decl->output)
+    {
+        key << "o:" << arg.name << ":" << arg.dbustype << "\n";
+    }
+    key << static_cast<int>(decl->priority)
+        << (decl->run_inline ? ":inline" : "");
+
+    auto registry = _private::SharedRegistry<Arguments::Declaration>::Instance();
+    method_args->set_declaration(registry->Share(
+        key.str(),
+        [this, &decl]()
+        {
+            auto shared = std::make_shared<Arguments::Declaration>(*decl);
+            Arguments::compile_types(*shared);
+            shared->registered = true;
+            shared->shared = true;
+            shared->introspection = GenerateIntrospection();
+            return shared;
+        }));
+
+    // Released invocation objects would otherwise keep the
+    // previous declaration alive
+    std::lock_guard<std::mutex> lg(args_pool_mtx);
+    args_pool.clear();
+}
+
+
 
 ///////////////////////////////////////////////////////////////////////////
 //
@@ -421,46 +1150,118 @@ Arguments::Ptr Collection::AddMethod(const std::string &method_name,
     Callback::Ptr meth = Callback::Create(method_name,
                                           method_callback);
     methods.push_back(meth);
+
+    // If the same method name is declared more than once,
+    // the first declaration is the one being called
+    dispatch.emplace(method_name, meth);
+    return meth->GetArgsList();
+}
+
+
+Arguments::Ptr Collection::AddRawMethod(const std::string &method_name,
+                                        Method::RawCallbackFnc raw_callback)
+{
+    Callback::Ptr meth = Callback::CreateRaw(method_name,
+                                             std::move(raw_callback));
+    methods.push_back(meth);
+    dispatch.emplace(method_name, meth);
     return meth->GetArgsList();
 }
 
 
 const std::string Collection::GenerateIntrospection() const
 {
-    std::ostringstream xml;
+    std::lock_guard<std::mutex> lg(introspection_mtx);
+    const std::size_t rev = revision();
+    if (!introspection_cache || rev != introspection_revision)
+    {
+        std::ostringstream xml;
+        for (const auto &meth : methods)
+        {
+            xml << meth->GenerateIntrospection();
+        }
+        introspection_cache = std::make_shared<const std::string>(xml.str());
+        introspection_revision = rev;
+    }
+    return *introspection_cache;
+}
+
+
+void Collection::Share(const std::string &interface)
+{
     for (const auto &meth : methods)
     {
-        xml << meth->GenerateIntrospection();
+        meth->share_declaration(interface);
     }
-    return xml.str();
+
+    // The fragment is prepared here, before it is shared.  It is
+    // composed of the fragments of the shared method declarations.
+    GenerateIntrospection();
+
+    std::lock_guard<std::mutex> lg(introspection_mtx);
+    auto registry = _private::SharedRegistry<const std::string>::Instance();
+    auto fragment = introspection_cache;
+    introspection_cache = registry->Share(interface + "\n" + *fragment,
+                                          [fragment]()
+                                          {
+                                              return fragment;
+                                          });
+}
+
+
+size_t Collection::SharedDeclarations() noexcept
+{
+    return Callback::shared_declarations();
 }
 
 
 const bool Collection::Exists(const std::string &method_name) const
 {
-    const auto it = std::find_if(methods.begin(),
-                                 methods.end(),
-                                 [method_name](const Method::Callback::Ptr &ep)
-                                 {
-                                     return method_name == ep->GetMethodName();
-                                 });
-    return (methods.end() != it);
+    return nullptr != lookup(method_name);
 }
 
 
 void Collection::Execute(AsyncProcess::Request::UPtr &req)
 {
-    auto it = std::find_if(methods.begin(),
-                           methods.end(),
-                           [method_name = req->method](Method::Callback::Ptr &meth)
-                           {
-                               return method_name == meth->GetMethodName();
-                           });
-    if (methods.end() == it)
+    Method::Callback *meth = lookup(req->method);
+    if (!meth)
     {
         throw Method::Exception("Method '" + req->method + "' does not exist");
     }
-    it->get()->Execute(req);
+    meth->Execute(req);
+}
+
+
+AsyncProcess::Priority Collection::GetPriority(const std::string &method_name) const noexcept
+{
+    Method::Callback *meth = lookup(method_name);
+    return (meth ? meth->GetPriority() : AsyncProcess::Priority::NORMAL);
+}
+
+
+bool Collection::IsInline(const std::string &method_name) const noexcept
+{
+    Method::Callback *meth = lookup(method_name);
+    return (meth ? meth->IsInline() : false);
+}
+
+
+std::size_t Collection::revision() const noexcept
+{
+    // Arguments are only ever added, so this sum only grows
+    std::size_t rev = methods.size();
+    for (const auto &meth : methods)
+    {
+        rev += meth->GetRevision();
+    }
+    return rev;
+}
+
+
+Method::Callback *Collection::lookup(const std::string &method_name) const noexcept
+{
+    const auto it = dispatch.find(method_name);
+    return (dispatch.end() != it ? it->second.get() : nullptr);
 }
 
 } // namespace Method
@@ -20,9 +20,15 @@
 
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <sstream>
+#include <unordered_map>
+#include <vector>
 
 #include "../async-process.hpp"
+#include "../glib2/utils.hpp"
+#include "../payload.hpp"
 #include "exceptions.hpp"
 
 
@@ -65,14 +71,119 @@ struct _method_argument
 
 
 /**
- *  Used to flag if a D-Bus method is expected to send or receive a
- *  file descriptor to/from the caller
+ *  Used to flag if a D-Bus method is expected to send or receive
+ *  file descriptors to/from the caller
  */
 enum class PassFDmode
 {
     NONE,
     SEND,
-    RECEIVE
+    RECEIVE,
+    BOTH
+};
+
+
+/**
+ *  A handle to a D-Bus method call which is replied to after the method
+ *  callback function has returned.  See @Arguments::Defer().
+ *
+ *  The reply can be sent from any thread.  If the handle is released
+ *  without a reply being sent, an error is returned to the caller.
+ */
+class DeferredReply
+{
+  public:
+    using Ptr = std::shared_ptr<DeferredReply>;
+
+    ~DeferredReply() noexcept;
+
+    DeferredReply(const DeferredReply &) = delete;
+    DeferredReply &operator=(const DeferredReply &) = delete;
+
+    /**
+     *  Send a file descriptor back to the D-Bus method caller together
+     *  with the reply.  This requires the method to be declared with
+     *  PassFDmode::SEND or PassFDmode::BOTH.  The file descriptors are
+     *  closed when the reply has been sent.
+     *
+     * @param fd  File descriptor to pass back to the caller
+     * @throws Method::Exception if file descriptor passing is not enabled
+     *         or the reply has already been sent
+     */
+    void SendFD(int fd);
+
+    /**
+     *  Similar to @SendFD(), taking a std::vector of file descriptors
+     *
+     * @param fds  std::vector<int> with the file descriptors to pass
+     *             back to the caller
+     */
+    void SendFDs(const std::vector<int> &fds);
+
+    /**
+     *  Send the method results back to the D-Bus method caller
+     *
+     * @param result  GVariant object with all the value arguments
+     *                to be returned to the method caller.  The
+     *                reference is consumed.
+     * @throws Method::Exception if the result does not match the declared
+     *         output arguments or the reply has already been sent
+     */
+    void Return(GVariant *result);
+
+    /**
+     *  Send an error back to the D-Bus method caller
+     *
+     * @param errmsg  std::string with the error message
+     * @throws Method::Exception if the reply has already been sent
+     */
+    void ReturnError(const std::string &errmsg);
+
+    /**
+     *  Check if a reply has been sent to the method caller
+     *
+     * @return true if the reply or error has been sent
+     */
+    bool Replied() const noexcept;
+
+    /**
+     *  Check if the method caller has disconnected, in which case
+     *  there is no need to complete the work for this reply
+     *
+     * @return true if the method call has been cancelled
+     */
+    bool IsCancelled() const noexcept;
+
+
+  private:
+    friend class CallbackArguments;
+    friend class Arguments;
+
+    mutable std::mutex mtx{};
+    GDBusMethodInvocation *invocation = nullptr; ///< Invocation to reply to
+    const GDBusConnection *dbusconn = nullptr;   ///< Connection of the call
+    const glib2::Utils::VariantType output_type; ///< Declared reply type
+    const bool fd_send_enabled;                  ///< PassFDmode allows sending
+    const std::string error_domain;              ///< Default D-Bus error domain
+    std::vector<int> fd_send{};                  ///< File descriptors to send
+    GCancellable *cancellable = nullptr;         ///< Cancelled on disconnect
+
+    DeferredReply(GDBusMethodInvocation *invoc,
+                  GCancellable *cancel,
+                  const GDBusConnection *conn,
+                  const glib2::Utils::VariantType &output_type_,
+                  const bool fd_send_enabled_,
+                  const std::string &error_domain_);
+
+    /**
+     *  Take back the responsibility to reply, used when the method
+     *  callback throws an exception after deferring its reply.
+     *
+     * @return true if no reply has been sent yet
+     */
+    bool revoke() noexcept;
+
+    void return_error(const std::string &errmsg) noexcept;
 };
 
 
@@ -110,8 +221,9 @@ class Arguments
     /**
      *  Sets the file descriptor method mode for this D-Bus method
      *
-     *  This enables sending or receiving a file descriptor to/from
-     *  the D-Bus method caller.
+     *  This enables sending and/or receiving file descriptors to/from
+     *  the D-Bus method caller.  Several file descriptors may be passed
+     *  in each direction in a single method call.
      *
      *  The default mode is PassFDmode::NONE, which does not allow
      *  any kind of file descriptor passing.
@@ -120,6 +232,44 @@ class Arguments
      */
     void PassFileDescriptor(const PassFDmode &mode);
 
+    /**
+     *  Sets the processing priority of this D-Bus method.  Calls to
+     *  methods with a higher priority are processed before queued calls
+     *  to methods with a lower priority.
+     *
+     *  The default priority is AsyncProcess::Priority::NORMAL.
+     *
+     * @param prio   AsyncProcess::Priority for the D-Bus method
+     */
+    void SetPriority(const AsyncProcess::Priority prio) noexcept;
+
+    /**
+     *  Retrieve the processing priority of this D-Bus method
+     *
+     * @return AsyncProcess::Priority
+     */
+    AsyncProcess::Priority GetPriority() const noexcept;
+
+    /**
+     *  Run this D-Bus method directly on the thread dispatching the
+     *  D-Bus method call, instead of queuing it in the AsyncProcess::Pool.
+     *
+     *  This is intended for trivial methods, like simple getters, where
+     *  passing the call to a worker thread costs more than the work itself.
+     *  Inline methods block the dispatching main loop while running, so
+     *  they must never do any blocking or long running operations.
+     *
+     * @param run_inline  bool flag enabling or disabling inline execution
+     */
+    void SetInline(const bool run_inline = true) noexcept;
+
+    /**
+     *  Check if this D-Bus method runs directly on the dispatching thread
+     *
+     * @return true if the method runs inline, otherwise false
+     */
+    bool IsInline() const noexcept;
+
     /**
      *  Checks if any arguments has been declared or not
      *
@@ -150,31 +300,95 @@ class Arguments
      *  with the D-Bus method call.
      *
      *  This requires PassFileDescriptor() to have been called setting
-     *  the file descriptor passing mode to PassFDmode::RECEIVE when
-     *  declaring the D-Bus method.
+     *  the file descriptor passing mode to PassFDmode::RECEIVE or
+     *  PassFDmode::BOTH when declaring the D-Bus method.
      *
      *  This is only available in the callback functor when a
-     *  a D-Bus proxy client has called this method.
+     *  a D-Bus proxy client has called this method.  If the caller sent
+     *  more than one file descriptor, only the first one is returned;
+     *  see @ReceiveFDs().
      *
-     * @return int  File descriptor provided by the caller
+     * @return int  File descriptor provided by the caller, -1 if none
+     *              were sent
      */
     int ReceiveFD() const;
 
+    /**
+     *  Retrieve all the file descriptors the caller sent with the D-Bus
+     *  method call, in the same order as the caller sent them.  The
+     *  callback function is responsible for closing all of them.
+     *
+     *  This requires PassFileDescriptor() to have been called setting
+     *  the file descriptor passing mode to PassFDmode::RECEIVE or
+     *  PassFDmode::BOTH when declaring the D-Bus method.
+     *
+     * @return const std::vector<int>& with the received file descriptors
+     */
+    const std::vector<int> &ReceiveFDs() const;
+
+    /**
+     *  Retrieve the binary payload the caller sent via
+     *  Proxy::Client::SendPayload().  The D-Bus method must be declared
+     *  to take a single "ay" argument.
+     *
+     *  To receive larger payloads passed via a memfd, PassFileDescriptor()
+     *  must have been called setting the file descriptor passing mode to
+     *  PassFDmode::RECEIVE or PassFDmode::BOTH.  The memfd is mapped and
+     *  closed; it is no longer available via @ReceiveFDs().
+     *
+     * @return Payload::Ptr with the received payload
+     * @throws Payload::Exception if the caller did not send a payload
+     */
+    Payload::Ptr ReceivePayload();
+
 
     /**
      *  Send a file descriptor back to the D-Bus method caller
      *
      *  This requires PassFileDescriptor() to have been called setting
-     *  the file descriptor passing mode to PassFDmode::SEND when
-     *  declaring the D-Bus method.
+     *  the file descriptor passing mode to PassFDmode::SEND or
+     *  PassFDmode::BOTH when declaring the D-Bus method.
      *
      *  This is only available in the callback functor when a
-     *  a D-Bus proxy client has called this method.
+     *  a D-Bus proxy client has called this method.  This may be called
+     *  several times to send more file descriptors; they are all sent
+     *  back in the same order as they were added.  The file descriptors
+     *  are closed when the response has been sent.
      *
      * @param fd  File descriptor to pass back to the caller
      */
     void SendFD(int &fd);
 
+    /**
+     *  Send several file descriptors back to the D-Bus method caller.
+     *  This is the same as calling @SendFD() for each of them.
+     *
+     * @param fds  std::vector<int> with the file descriptors to pass
+     *             back to the caller
+     */
+    void SendFDs(const std::vector<int> &fds);
+
+    /**
+     *  Provide a binary payload as the method result back to the D-Bus
+     *  method caller, which retrieves it via Proxy::Client::GetPayload().
+     *  The D-Bus method must be declared to return a single "ay" argument.
+     *
+     *  Payloads of the threshold size and larger are passed via a sealed
+     *  memfd if PassFileDescriptor() has been called setting the file
+     *  descriptor passing mode to PassFDmode::SEND or PassFDmode::BOTH
+     *  and the connection supports it; otherwise they are sent inline.
+     *
+     * @param data       Pointer to the payload data
+     * @param size       size_t with the length of the payload data
+     * @param threshold  size_t with the smallest payload passed via a
+     *                   memfd (optional)
+     *
+     * @throws Payload::Exception if the memfd could not be prepared
+     */
+    void SendPayload(const void *data,
+                     const size_t size,
+                     const size_t threshold = GDBUSPP_PAYLOAD_MEMFD_THRESHOLD);
+
 
     /**
      *  Provide the method results back to the D-Bus method caller
@@ -195,6 +409,45 @@ class Arguments
      */
     const std::string GetCallerBusName() const noexcept;
 
+    /**
+     *  Check if the caller of this method has disconnected from the bus.
+     *  Long running method callbacks can check this to stop processing
+     *  requests where nobody will receive the result.
+     *
+     * @return true if the method call has been cancelled
+     */
+    bool IsCancelled() const noexcept;
+
+    /**
+     *  Retrieve the glib2 cancellation token of this method call, which
+     *  is cancelled when the caller disconnects.  This can be passed on
+     *  to other glib2 functions, like Proxy::CallOptions based calls to
+     *  other services.
+     *
+     * @return GCancellable* valid while the callback runs, may be nullptr
+     */
+    GCancellable *GetCancellable() const noexcept;
+
+
+    /**
+     *  Defer the reply of this method call.  The callback function can
+     *  return right away, releasing the AsyncProcess::Pool worker thread,
+     *  and the reply is sent later via the returned handle - typically
+     *  when a downstream service has responded.
+     *
+     *  The method call parameters must be extracted before the callback
+     *  function returns.  SetMethodReturn() and SendFD() on this Arguments
+     *  object are ignored once the reply has been deferred.
+     *
+     *  This is only available in the callback functor when a
+     *  a D-Bus proxy client has called this method.
+     *
+     * @return DeferredReply::Ptr used to send the reply later
+     * @throws Method::Exception if called outside a method call or called
+     *         more than once
+     */
+    DeferredReply::Ptr Defer();
+
 
     friend std::ostream &operator<<(std::ostream &os, const Arguments::Ptr &args)
     {
@@ -214,8 +467,13 @@ class Arguments
     GVariant *call_params = nullptr;
     GVariant *return_params = nullptr;
     PassFDmode pass_fd_mode = PassFDmode::NONE;
-    int fd_receive = -1;
-    int fd_send = -1;
+    std::vector<int> fd_receive{};
+    std::vector<int> fd_send{};
+    GDBusMethodInvocation *invocation = nullptr;
+    GCancellable *cancellable = nullptr;
+    const GDBusConnection *dbusconn = nullptr;
+    std::string error_domain{};
+    DeferredReply::Ptr deferred{};
 
 
     /**
@@ -251,8 +509,73 @@ class Arguments
     Arguments() = default;
 
   private:
-    std::vector<struct _method_argument> input = {};  //<< Collection of all input arguments
-    std::vector<struct _method_argument> output = {}; //<< Collection of all output arguments
+    friend class Callback;
+    friend class CallbackArguments;
+
+    /**
+     *  The declared arguments of the method.  This is shared between
+     *  the method declaration and all the Arguments objects used by
+     *  each invocation of the method.
+     *
+     *  Once the object is registered, identical method declarations of
+     *  objects using the same D-Bus interface share a single Declaration;
+     *  see Method::Collection::Share().  A registered Declaration is never
+     *  modified; it is copied and replaced instead, as it may be in use by
+     *  method calls running in other threads.
+     */
+    struct Declaration
+    {
+        std::vector<struct _method_argument> input = {};  //<< Collection of all input arguments
+        std::vector<struct _method_argument> output = {}; //<< Collection of all output arguments
+        std::optional<glib2::Utils::VariantType> input_type{};  //<< Input data type, compiled when registered
+        std::optional<glib2::Utils::VariantType> output_type{}; //<< Output data type, compiled when registered
+        AsyncProcess::Priority priority = AsyncProcess::Priority::NORMAL; //<< Processing priority
+        bool run_inline = false;                                          //<< Skip the thread pool
+        unsigned int revision = 0;                                        //<< Bumped on each added argument
+        bool registered = false;                                          //<< Used by a registered object
+        bool shared = false;                                              //<< Shared between several objects
+        std::string introspection{};                                      //<< Method XML fragment, set when shared
+    };
+
+    /// Only accessed via get_declaration() and modify_declaration()
+    std::shared_ptr<Declaration> declaration = std::make_shared<Declaration>();
+
+    /**
+     *  Retrieve the current argument declaration
+     *
+     * @return std::shared_ptr<const Declaration>
+     */
+    std::shared_ptr<const Declaration> get_declaration() const noexcept
+    {
+        return std::atomic_load(&declaration);
+    }
+
+    /**
+     *  Replace the argument declaration
+     *
+     * @param decl  std::shared_ptr<Declaration> to use from now on
+     */
+    void set_declaration(std::shared_ptr<Declaration> decl) noexcept
+    {
+        std::atomic_store(&declaration, std::move(decl));
+    }
+
+    /**
+     *  Modify the argument declaration.  A declaration used by a
+     *  registered object is copied first, and the modified copy
+     *  replaces it once complete.
+     *
+     * @param modify  Function modifying the Declaration
+     */
+    void modify_declaration(const std::function<void(Declaration &)> &modify);
+
+    /**
+     *  Compile the input and output data types of a declaration, used
+     *  by the method calls
+     *
+     * @param decl  Declaration to update
+     */
+    static void compile_types(Declaration &decl);
 
 
     /**
@@ -270,6 +593,8 @@ class Arguments
             return "PassFDmode::SEND";
         case PassFDmode::RECEIVE:
             return "PassFDmode::RECEIVE";
+        case PassFDmode::BOTH:
+            return "PassFDmode::BOTH";
         default:
             return "[INVALID]";
         }
@@ -284,6 +609,16 @@ class Arguments
  */
 using CallbackFnc = std::function<void(Arguments::Ptr args)>;
 
+/**
+ *  Callback function of methods declared via Object::Base::AddRawMethod().
+ *  It receives the unique bus name of the caller and the content of the
+ *  byte array (ay) argument, and returns the byte array to send back.
+ *
+ *  The data argument is only valid while the callback runs.  The returned
+ *  GBytes reference is taken over; nullptr sends back an empty byte array.
+ */
+using RawCallbackFnc = std::function<GBytes *(const std::string &caller, GBytes *data)>;
+
 
 
 /**
@@ -310,6 +645,24 @@ class Callback
                                           callback));
     }
 
+    /**
+     *  Create a new Method::Callback object for a method passing a single
+     *  byte array (ay) in each direction without decoding it.  The data
+     *  is passed as GBytes referring to the received D-Bus message, and
+     *  the reply is built from the returned GBytes without copying it.
+     *
+     * @param method_name     std::string containing the D-Bus exposed method name
+     * @param raw_callback    RawCallbackFnc code being executed through the D-Bus service
+     *
+     * @return Callback::Ptr  Returns a shared_ptr<Callback> to the new callback mapping
+     */
+    static Callback::Ptr CreateRaw(const std::string &method_name,
+                                   RawCallbackFnc raw_callback)
+    {
+        return Callback::Ptr(new Callback(method_name,
+                                          std::move(raw_callback)));
+    }
+
     ~Callback() noexcept = default;
 
 
@@ -329,6 +682,14 @@ class Callback
      */
     const std::string GenerateIntrospection() const;
 
+    /**
+     *  Retrieve the revision of the argument declaration of this method.
+     *  This changes each time an input or output argument is added.
+     *
+     * @return unsigned int
+     */
+    unsigned int GetRevision() const noexcept;
+
     /**
      *  Retrieve the D-Bus method name this callback is declared with
      *
@@ -336,6 +697,20 @@ class Callback
      */
     const std::string GetMethodName() const;
 
+    /**
+     *  Retrieve the processing priority of this method
+     *
+     * @return AsyncProcess::Priority
+     */
+    AsyncProcess::Priority GetPriority() const noexcept;
+
+    /**
+     *  Check if this method runs directly on the dispatching thread
+     *
+     * @return true if the method runs inline, otherwise false
+     */
+    bool IsInline() const noexcept;
+
     /**
      *  Execute this callback method with all the needed arguments
      *  provided via the AsyncProcess::Request object
@@ -359,11 +734,65 @@ class Callback
 
 
   private:
+    friend class Collection;
+
     const std::string method_name;                  ///< D-Bus exposed method name
-    std::shared_ptr<CallbackArguments> method_args; ///< Argument collection for the method
+    std::shared_ptr<CallbackArguments> method_args; ///< Argument declaration for the method
     CallbackFnc callback_fn;                        ///< Callback function being executed
+    RawCallbackFnc raw_callback_fn;                 ///< Set for methods passing raw bytes
+
+    /// Released per-invocation argument objects, ready to be reused
+    std::vector<std::shared_ptr<CallbackArguments>> args_pool{};
+    std::mutex args_pool_mtx{};
 
     Callback(const std::string &method_name_, CallbackFnc callback);
+    Callback(const std::string &method_name_, RawCallbackFnc raw_callback);
+
+    /**
+     *  Execute a method declared via @CreateRaw().  This passes the byte
+     *  array on as-is, bypassing the Arguments handling.
+     *
+     * @param req   ASyncProcess::Request::Ptr with the method call
+     *
+     * @throws Method::Exception if the input is not a single byte array
+     */
+    void execute_raw(AsyncProcess::Request::UPtr &req);
+
+    /**
+     *  Retrieve an Arguments object for a single method invocation,
+     *  reusing a released one if available.
+     *
+     * @return std::shared_ptr<CallbackArguments>
+     */
+    std::shared_ptr<CallbackArguments> acquire_args();
+
+    /**
+     *  Release an Arguments object used by an invocation.  Only if
+     *  this is the last reference, it is reset and kept for later
+     *  invocations; objects still referenced elsewhere are left
+     *  untouched.
+     *
+     * @param args  std::shared_ptr<CallbackArguments> to release
+     */
+    void release_args(std::shared_ptr<CallbackArguments> &args) noexcept;
+
+    /**
+     *  Replace the argument declaration of this method with the one
+     *  shared by identical methods of other objects using the same
+     *  D-Bus interface.  If none is shared yet, this declaration
+     *  becomes the shared one.
+     *
+     * @param interface  std::string with the D-Bus interface of the object
+     */
+    void share_declaration(const std::string &interface);
+
+    /**
+     *  Retrieve the number of method declarations currently shared
+     *  between objects; see Collection::SharedDeclarations()
+     *
+     * @return size_t
+     */
+    static size_t shared_declarations() noexcept;
 };
 
 
@@ -406,10 +835,25 @@ class Collection
     Arguments::Ptr AddMethod(const std::string &method_name,
                              Method::CallbackFnc method_callback);
 
+    /**
+     *  Add a new D-Bus method passing a single byte array (ay) in each
+     *  direction as raw bytes; see Callback::CreateRaw()
+     *
+     * @param method_name   std::string with the D-Bus exposed method name
+     * @param raw_callback  Method::RawCallbackFnc callback function to execute
+     *
+     * @return Arguments::Ptr  Returns the Arguments object of the method.
+     *                         The arguments are already declared and must
+     *                         not be changed.
+     */
+    Arguments::Ptr AddRawMethod(const std::string &method_name,
+                                Method::RawCallbackFnc raw_callback);
+
     /**
      *  Generate the XML Introspection fragment containing all the
      *  declared D-Bus methods and their arguments in this collection
-     *  object
+     *  object.  The result is cached until another method or method
+     *  argument is declared.
      *
      * @return const std::string
      */
@@ -424,6 +868,26 @@ class Collection
      */
     const bool Exists(const std::string &method_name) const;
 
+    /**
+     *  Retrieve the processing priority of a method
+     *
+     * @param method_name  std::string of the D-Bus exposed method name
+     *
+     * @return AsyncProcess::Priority.  If the method is not declared,
+     *         AsyncProcess::Priority::NORMAL is returned.
+     */
+    AsyncProcess::Priority GetPriority(const std::string &method_name) const noexcept;
+
+    /**
+     *  Check if a method runs directly on the dispatching thread
+     *
+     * @param method_name  std::string of the D-Bus exposed method name
+     *
+     * @return true if the method is declared and runs inline,
+     *         otherwise false
+     */
+    bool IsInline(const std::string &method_name) const noexcept;
+
     /**
      *  Execute the D-Bus method based on the information provided in the
      *  AsyncProcess::Request object.
@@ -439,10 +903,62 @@ class Collection
      */
     void Execute(AsyncProcess::Request::UPtr &req);
 
+    /**
+     *  Share the method declarations and the introspection data of this
+     *  collection with all other objects using the same D-Bus interface
+     *  and identical method declarations.  Only the callback functions
+     *  are kept per object.
+     *
+     *  This is called by the Object::Manager when an object is
+     *  registered.  Methods declared or modified afterwards get their
+     *  own declaration again.
+     *
+     * @param interface  std::string with the D-Bus interface of the object
+     */
+    void Share(const std::string &interface);
+
+    /**
+     *  Retrieve the number of distinct method declarations currently
+     *  shared by registered objects in this process.  A declaration is
+     *  released when the last object using it is destroyed.
+     *
+     * @return size_t
+     */
+    static size_t SharedDeclarations() noexcept;
+
   private:
     Collection() = default;
 
+    /// All declared methods, in the order they were added
     std::vector<Method::Callback::Ptr> methods;
+
+    /// Method name to callback lookup index, used when dispatching calls
+    std::unordered_map<std::string, Method::Callback::Ptr> dispatch;
+
+    /// Cached result of GenerateIntrospection(), may be shared by
+    /// several objects; see Share()
+    mutable std::shared_ptr<const std::string> introspection_cache{};
+
+    /// Declaration revision the introspection_cache was generated from
+    mutable std::size_t introspection_revision = 0;
+    mutable std::mutex introspection_mtx{};
+
+    /**
+     *  Calculate the revision of all method declarations.  This increases
+     *  each time a method or a method argument is declared.
+     *
+     * @return std::size_t
+     */
+    std::size_t revision() const noexcept;
+
+    /**
+     *  Look up a declared method by its name
+     *
+     * @param method_name  std::string of the D-Bus exposed method name
+     *
+     * @return Method::Callback pointer, nullptr if the method is not declared
+     */
+    Method::Callback *lookup(const std::string &method_name) const noexcept;
 };
 
 } // namespace Method
@@ -15,7 +15,11 @@
  */
 
 
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include "exceptions.hpp"
@@ -57,4 +61,97 @@ const std::string Path::process_str(const char *str) const
 }
 
 
+
+namespace _private {
+
+/**
+ *  All interned paths, keyed by the path string of the shared Path
+ *  object.  Entries are removed when the last InternedPath of a path
+ *  is released.
+ */
+struct InternRegistry
+{
+    std::mutex mtx;
+    std::unordered_map<std::string_view, std::weak_ptr<const Path>> paths;
+};
+
+static std::shared_ptr<InternRegistry> intern_registry()
+{
+    // The registry is kept alive by each interned path, as these may
+    // be released during the static destruction
+    static auto registry = std::make_shared<InternRegistry>();
+    return registry;
+}
+
+} // namespace _private
+
+
+InternedPath::InternedPath(const Path &path)
+{
+    if (path.empty())
+    {
+        return;
+    }
+
+    auto registry = _private::intern_registry();
+    std::lock_guard<std::mutex> lg(registry->mtx);
+    auto it = registry->paths.find(path);
+    if (registry->paths.end() != it)
+    {
+        entry = it->second.lock();
+        if (entry)
+        {
+            return;
+        }
+        // Released, but the entry is not yet removed by the deleter
+        registry->paths.erase(it);
+    }
+
+    entry = std::shared_ptr<const Path>(
+        new Path(path),
+        [registry](const Path *released)
+        {
+            {
+                std::lock_guard<std::mutex> lg(registry->mtx);
+                auto it = registry->paths.find(*released);
+                if (registry->paths.end() != it && it->second.expired())
+                {
+                    registry->paths.erase(it);
+                }
+            }
+            delete released;
+        });
+    registry->paths.emplace(*entry, entry);
+}
+
+
+InternedPath::InternedPath(const std::string &str)
+    : InternedPath(Path(str))
+{
+}
+
+
+InternedPath::InternedPath(const char *str)
+    : InternedPath(Path(str))
+{
+}
+
+
+InternedPath InternedPath::Find(const std::string &path) noexcept
+{
+    auto registry = _private::intern_registry();
+    std::lock_guard<std::mutex> lg(registry->mtx);
+    auto it = registry->paths.find(path);
+    return InternedPath(registry->paths.end() != it
+                            ? it->second.lock()
+                            : nullptr);
+}
+
+
+const Path &InternedPath::GetPath() const noexcept
+{
+    static const Path empty_path{};
+    return (entry ? *entry : empty_path);
+}
+
 } // namespace DBus::Object
@@ -21,6 +21,8 @@
 
 #pragma once
 
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -62,4 +64,92 @@ class Path : public std::string
     const std::string process_str(const char *str) const;
 };
 
+
+
+/**
+ *  Interned D-Bus object path.  All InternedPath objects carrying the
+ *  same path share a single Path object, which is kept as long as any
+ *  InternedPath refers to it.  Comparing two InternedPath objects and
+ *  calculating their hash values only looks at this shared pointer,
+ *  so these are cheap keys in a std::unordered_map.
+ *
+ *  Interning an already validated Path does not validate it again.
+ *  An InternedPath converts implicitly to a const Path reference, so
+ *  it can be passed on to all the APIs expecting a Path.
+ */
+class InternedPath
+{
+  public:
+    /**
+     *  An empty path; equal to InternedPath("")
+     */
+    InternedPath() = default;
+
+    InternedPath(const Path &path);
+    InternedPath(const std::string &str);
+    InternedPath(const char *str);
+
+    /**
+     *  Look up an already interned path, without interning it
+     *
+     * @param path  std::string with the D-Bus object path
+     *
+     * @return InternedPath referring to the interned path, or an
+     *         empty InternedPath if this path is not interned
+     */
+    [[nodiscard]] static InternedPath Find(const std::string &path) noexcept;
+
+    operator const Path &() const noexcept
+    {
+        return GetPath();
+    }
+
+    const Path &GetPath() const noexcept;
+
+    bool empty() const noexcept
+    {
+        return nullptr == entry;
+    }
+
+    std::size_t Hash() const noexcept
+    {
+        return std::hash<const Path *>()(entry.get());
+    }
+
+    bool operator==(const InternedPath &other) const noexcept
+    {
+        return entry == other.entry;
+    }
+
+    bool operator!=(const InternedPath &other) const noexcept
+    {
+        return entry != other.entry;
+    }
+
+    /// Ordering follows the path strings, as with Path
+    bool operator<(const InternedPath &other) const noexcept
+    {
+        return entry != other.entry && GetPath() < other.GetPath();
+    }
+
+
+  private:
+    std::shared_ptr<const Path> entry = nullptr;
+
+    InternedPath(std::shared_ptr<const Path> entry_) noexcept
+        : entry(std::move(entry_))
+    {
+    }
+};
+
 } // namespace DBus::Object
+
+
+template <>
+struct std::hash<DBus::Object::InternedPath>
+{
+    std::size_t operator()(const DBus::Object::InternedPath &path) const noexcept
+    {
+        return path.Hash();
+    }
+};
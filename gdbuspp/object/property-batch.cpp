@@ -0,0 +1,220 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file object/property-batch.cpp
+ *
+ * @brief  Implementation of the internal Object::Property::ChangeBatch
+ */
+
+#include <iostream>
+#include <string>
+#include <gio/gio.h>
+
+#define GDBUSPP_LOG_CATEGORY OBJECTS
+#include "../connection.hpp"
+#include "../features/debug-log.hpp"
+#include "../glib2/utils.hpp"
+#include "property-batch.hpp"
+
+
+namespace DBus {
+namespace Object {
+namespace Property {
+
+namespace _private {
+
+/**
+ *  Context of a scheduled ChangeBatch::Flush() call.  This keeps the
+ *  ChangeBatch object alive until the pending changes have been sent.
+ */
+struct FlushContext
+{
+    ChangeBatch::Ptr batch;
+    Object::Path path;
+    std::string interface;
+};
+
+
+static gboolean flush_callback(void *user_data)
+{
+    auto ctx = static_cast<FlushContext *>(user_data);
+    ctx->batch->Flush(ctx->path, ctx->interface);
+    return G_SOURCE_REMOVE;
+}
+
+
+static void destroy_flush_context(void *user_data)
+{
+    delete static_cast<FlushContext *>(user_data);
+}
+
+} // namespace _private
+
+
+std::mutex ChangeBatch::registry_mtx;
+std::map<GDBusConnection *, std::weak_ptr<ChangeBatch>> ChangeBatch::registry;
+
+
+ChangeBatch::Ptr ChangeBatch::Get(GDBusConnection *conn, GMainContext *context)
+{
+    std::lock_guard<std::mutex> lg(registry_mtx);
+    auto &entry = registry[conn];
+    auto batch = entry.lock();
+    if (!batch)
+    {
+        batch = ChangeBatch::Ptr(new ChangeBatch(conn, context));
+        entry = batch;
+    }
+    return batch;
+}
+
+
+ChangeBatch::ChangeBatch(GDBusConnection *conn, GMainContext *context_)
+    : connection(conn), context(context_)
+{
+    g_object_ref(connection);
+    if (context)
+    {
+        g_main_context_ref(context);
+    }
+}
+
+
+ChangeBatch::~ChangeBatch() noexcept
+{
+    for (auto &[key, values] : pending)
+    {
+        for (auto &[name, value] : values)
+        {
+            g_variant_unref(value);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lg(registry_mtx);
+        auto it = registry.find(connection);
+        if (registry.end() != it && it->second.expired())
+        {
+            registry.erase(it);
+        }
+    }
+    g_object_unref(connection);
+    if (context)
+    {
+        g_main_context_unref(context);
+    }
+}
+
+
+void ChangeBatch::Queue(const Object::Path &path,
+                        Update::Ptr update,
+                        const std::chrono::milliseconds delay)
+{
+    const Property::Interface &prop = update->GetProperty();
+    Queue(path, prop.GetInterface(), prop.GetName(), update->FinalizeValue(), delay);
+}
+
+
+void ChangeBatch::Queue(const Object::Path &path,
+                        const std::string &interface,
+                        const std::string &property,
+                        GVariant *value,
+                        const std::chrono::milliseconds delay)
+{
+    value = g_variant_ref_sink(value);
+
+    std::lock_guard<std::mutex> lg(mtx);
+    Key key{path, interface};
+    auto [entry, first] = pending.try_emplace(key);
+    auto [val, inserted] = entry->second.try_emplace(property, value);
+    if (!inserted)
+    {
+        // Only the last value of a property is sent
+        g_variant_unref(val->second);
+        val->second = value;
+    }
+    if (first)
+    {
+        schedule(key, delay);
+    }
+}
+
+
+void ChangeBatch::Flush(const Object::Path &path, const std::string &interface) noexcept
+{
+    std::map<std::string, GVariant *> values{};
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        auto it = pending.find(Key{path, interface});
+        if (pending.end() == it)
+        {
+            return;
+        }
+        values = std::move(it->second);
+        pending.erase(it);
+    }
+
+    glib2::Builder::Scoped changed("a{sv}");
+    for (auto &[name, value] : values)
+    {
+        changed.AddFormatted("{sv}", name.c_str(), value);
+        g_variant_unref(value);
+    }
+
+    GError *error = nullptr;
+    Connection::Cork::EmitSignal(connection,
+                                 nullptr,
+                                 path.c_str(),
+                                 "org.freedesktop.DBus.Properties",
+                                 "PropertiesChanged",
+                                 g_variant_new("(s@a{sv}as)",
+                                               interface.c_str(),
+                                               changed.Finish(),
+                                               nullptr),
+                                 &error);
+    if (error)
+    {
+        std::cerr << "** ERROR **  Property::ChangeBatch: "
+                  << "Failed sending PropertiesChanged for " << path
+                  << ": " << error->message << std::endl;
+        g_error_free(error);
+        return;
+    }
+    GDBUSPP_LOG("Property::ChangeBatch: Sent " << values.size()
+                                               << " changes for " << path);
+}
+
+
+void ChangeBatch::schedule(const Key &key, const std::chrono::milliseconds delay)
+{
+    // The flush is run by the main loop dispatching this connection,
+    // which is not necessarily the default main context
+    auto ctx = new _private::FlushContext{shared_from_this(), key.first, key.second};
+    GSource *src = nullptr;
+    if (delay.count() > 0)
+    {
+        src = g_timeout_source_new(static_cast<guint>(delay.count()));
+        g_source_set_priority(src, G_PRIORITY_DEFAULT);
+    }
+    else
+    {
+        src = g_idle_source_new();
+        g_source_set_priority(src, G_PRIORITY_DEFAULT_IDLE);
+    }
+    g_source_set_callback(src,
+                          _private::flush_callback,
+                          ctx,
+                          _private::destroy_flush_context);
+    g_source_attach(src, context);
+    g_source_unref(src);
+}
+
+} // namespace Property
+} // namespace Object
+} // namespace DBus
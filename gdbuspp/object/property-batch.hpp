@@ -0,0 +1,137 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file object/property-batch.hpp
+ *
+ * @brief  Declaration of the internal Object::Property::ChangeBatch,
+ *         coalescing property changes into fewer PropertiesChanged signals
+ */
+
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <gio/gio.h>
+
+#include "path.hpp"
+#include "property.hpp"
+
+
+namespace DBus {
+namespace Object {
+namespace Property {
+
+/**
+ *  Collects changed property values per D-Bus object and interface,
+ *  shared by all the D-Bus objects on the same D-Bus connection.  This
+ *  is used for objects which have enabled it via
+ *  Object::Base::CoalescePropertyChanges().
+ *
+ *  Instead of sending one org.freedesktop.DBus.Properties.PropertiesChanged
+ *  signal per property change, the changes are queued up and sent as a
+ *  single signal, either when the main loop becomes idle or after a
+ *  configured delay.  If the same property changes more times before the
+ *  signal is sent, only the last value is sent.
+ */
+class ChangeBatch : public std::enable_shared_from_this<ChangeBatch>
+{
+  public:
+    using Ptr = std::shared_ptr<ChangeBatch>;
+
+    /**
+     *  Retrieve the Property::ChangeBatch object for a D-Bus connection.
+     *  If one does not exist already, it is created.
+     *
+     * @param conn     GDBusConnection pointer to the connection
+     * @param context  GMainContext pointer of the main loop the connection
+     *                 is dispatched in, nullptr for the default main context.
+     *                 Only used when the object is created.
+     *
+     * @return ChangeBatch::Ptr
+     */
+    static ChangeBatch::Ptr Get(GDBusConnection *conn, GMainContext *context);
+
+    ~ChangeBatch() noexcept;
+
+    /**
+     *  Queue a property change.  If no changes are pending for this
+     *  object and interface, a flush of the changes is scheduled.
+     *
+     * @param path     DBus::Object::Path of the object being changed
+     * @param update   Property::Update::Ptr with the new property value
+     * @param delay    std::chrono::milliseconds to wait before sending
+     *                 the signal.  If 0, it is sent when the main loop
+     *                 becomes idle.
+     */
+    void Queue(const Object::Path &path,
+               Update::Ptr update,
+               const std::chrono::milliseconds delay);
+
+    /**
+     *  Queue a property change, with the new value already prepared.
+     *
+     * @param path       DBus::Object::Path of the object being changed
+     * @param interface  std::string with the D-Bus interface of the property
+     * @param property   std::string with the property name
+     * @param value      GVariant* with the new property value.  A floating
+     *                   reference is consumed.
+     * @param delay      std::chrono::milliseconds to wait before sending
+     *                   the signal.  If 0, it is sent when the main loop
+     *                   becomes idle.
+     */
+    void Queue(const Object::Path &path,
+               const std::string &interface,
+               const std::string &property,
+               GVariant *value,
+               const std::chrono::milliseconds delay);
+
+    /**
+     *  Send a single PropertiesChanged signal with all the pending
+     *  changes for a D-Bus object and interface.
+     *
+     * @param path       DBus::Object::Path of the changed object
+     * @param interface  std::string with the D-Bus interface of the changes
+     */
+    void Flush(const Object::Path &path, const std::string &interface) noexcept;
+
+
+  private:
+    /// Object path and interface the changes belong to
+    using Key = std::pair<Object::Path, std::string>;
+
+    GDBusConnection *connection = nullptr;
+
+    /// Main context the flushes are scheduled in, nullptr for the default
+    GMainContext *context = nullptr;
+    std::mutex mtx{};
+
+    /// Pending changed values, keyed by the property name
+    std::map<Key, std::map<std::string, GVariant *>> pending{};
+
+    static std::mutex registry_mtx;
+    static std::map<GDBusConnection *, std::weak_ptr<ChangeBatch>> registry;
+
+    ChangeBatch(GDBusConnection *conn, GMainContext *context_);
+
+    /**
+     *  Schedule a Flush() call in the main loop
+     *
+     * @param key    Key of the pending changes to flush
+     * @param delay  std::chrono::milliseconds to wait before flushing
+     */
+    void schedule(const Key &key, const std::chrono::milliseconds delay);
+};
+
+} // namespace Property
+} // namespace Object
+} // namespace DBus
@@ -16,13 +16,17 @@
  *        DBus::Object::Base object
  */
 
+#include <map>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <glib.h>
 
 #include "../glib2/utils.hpp"
 #include "base.hpp"
 #include "exceptions.hpp"
 #include "property.hpp"
+#include "shared-registry.hpp"
 
 
 namespace DBus {
@@ -34,7 +38,7 @@ namespace DBus {
 
 
 
-GVariant *Object::Property::Update::Finalize()
+GVariant *Object::Property::Update::FinalizeValue()
 {
     // Finalize all the collected value elements
     GVariant *vals = nullptr;
@@ -48,31 +52,33 @@ GVariant *Object::Property::Update::Finalize()
     }
     else
     {
-        GVariantBuilder *arvals = glib2::Builder::Create(property.GetDBusType());
+        glib2::Builder::Scoped arvals(property.GetDBusType());
         for (auto &val : updated_vals)
         {
-            glib2::Builder::Add(arvals, val);
+            arvals.Add(val);
         }
-        vals = glib2::Builder::Finish(arvals);
+        vals = arvals.Finish();
     }
+    updated_vals = {};
+    return vals;
+}
+
+
+GVariant *Object::Property::Update::Finalize()
+{
+    GVariant *vals = FinalizeValue();
 
     // Build a single element array containing all updates
     // for this single property
-    GVariantBuilder *msg = glib2::Builder::Create("a*");
-    glib2::Builder::Add(msg,
-                        g_variant_new("{sv}",
-                                      property.GetName().c_str(),
-                                      vals));
+    glib2::Builder::Scoped msg("a*");
+    msg.AddFormatted("{sv}", property.GetName().c_str(), vals);
 
     // Wrap this up into the needed format needed when sending the
     // org.freedesktop.DBus.Properties.PropertiesChanged signal
-    GVariant *update_msg = g_variant_new("(sa{sv}as)",
+    GVariant *update_msg = g_variant_new("(s@a{sv}as)",
                                          property.GetInterface().c_str(),
-                                         msg,
+                                         msg.Finish(),
                                          nullptr);
-    // This is "finished" by g_variant_new() above; we only need to clean up
-    g_variant_builder_unref(msg);
-    updated_vals = {};
 
     // Return this to the glib2 set-property callback method
     // which will emit the signal and do the needed error handling
@@ -120,12 +126,16 @@ const char *Object::Property::BySpec::GetDBusType() const noexcept
 
 GVariant *Object::Property::BySpec::GetValue() const
 {
-    return get_callback(*this);
+    return GetCachedValue([this]()
+                          {
+                              return get_callback(*this);
+                          });
 }
 
 
 Object::Property::Update::Ptr Object::Property::BySpec::SetValue(GVariant *value)
 {
+    MarkDirty();
     return set_callback(*this, value);
 }
 
@@ -143,6 +153,112 @@ const std::string &Object::Property::BySpec::GetInterface() const noexcept
 
 
 
+//
+//   DBus::Object::Property::Interface
+//
+
+
+
+Object::Property::Interface::~Interface() noexcept
+{
+    if (cached_value)
+    {
+        g_variant_unref(cached_value);
+    }
+}
+
+
+void Object::Property::Interface::EnableValueCache(const bool enable) noexcept
+{
+    std::lock_guard<std::mutex> lg(cache_mtx);
+    value_cache_enabled = enable;
+    ++cache_generation;
+    if (!enable && cached_value)
+    {
+        g_variant_unref(cached_value);
+        cached_value = nullptr;
+    }
+}
+
+
+void Object::Property::Interface::MarkDirty() noexcept
+{
+    std::lock_guard<std::mutex> lg(cache_mtx);
+    ++cache_generation;
+    if (cached_value)
+    {
+        g_variant_unref(cached_value);
+        cached_value = nullptr;
+    }
+}
+
+
+void Object::Property::Interface::StoreValue(const std::function<void()> &store)
+{
+    store();
+    MarkDirty();
+}
+
+
+/**
+ *  Wrap the already serialized data of a GVariant value in a new GVariant
+ *  object, which avoids serializing the value again
+ *
+ * @param value  GVariant* to share the serialized data with
+ * @return GVariant* (floating reference) sharing the data of value
+ */
+static GVariant *_int_share_serialized(GVariant *value)
+{
+    GBytes *data = g_variant_get_data_as_bytes(value);
+    GVariant *ret = g_variant_new_from_bytes(g_variant_get_type(value),
+                                             data,
+                                             true);
+    g_bytes_unref(data);
+    return ret;
+}
+
+
+GVariant *Object::Property::Interface::GetCachedValue(const std::function<GVariant *()> &create) const
+{
+    // Properties without the value cache never wait for the lock
+    if (!value_cache_enabled.load(std::memory_order_acquire))
+    {
+        return create();
+    }
+
+    uint64_t generation = 0;
+    {
+        std::lock_guard<std::mutex> lg(cache_mtx);
+        if (cached_value)
+        {
+            return _int_share_serialized(cached_value);
+        }
+        generation = cache_generation;
+    }
+
+    // The value is created without holding the lock, as the create
+    // function may be slow or call back into this object.  If the value
+    // was changed meanwhile, the created value is still returned to this
+    // caller but not cached.
+    GVariant *value = create();
+    if (!value)
+    {
+        return nullptr;
+    }
+    value = g_variant_ref_sink(value);
+
+    std::lock_guard<std::mutex> lg(cache_mtx);
+    if (!cached_value && generation == cache_generation)
+    {
+        cached_value = g_variant_ref(value);
+    }
+    GVariant *ret = _int_share_serialized(value);
+    g_variant_unref(value);
+    return ret;
+}
+
+
+
 //
 //   DBus::Object::PropertyCollection
 //
@@ -156,7 +272,27 @@ Object::Property::Collection::Collection()
 
 void Object::Property::Collection::AddBinding(Property::Interface::Ptr prop)
 {
+    std::lock_guard<std::mutex> lg(introspection_mtx);
+    auto decl = declaration;
+    if (decl->registered)
+    {
+        // Other objects or property calls may use the declarations;
+        // this object diverges once the change is complete
+        decl = std::make_shared<Declaration>(*declaration);
+        decl->shared = false;
+    }
+    try
+    {
+        decl->types.emplace(prop->GetName(), glib2::Utils::VariantType(prop->GetDBusType()));
+    }
+    catch (const glib2::Utils::Exception &excp)
+    {
+        throw Object::Exception("Property '" + prop->GetName() + "': "
+                                + excp.GetRawError());
+    }
     properties.insert(std::pair<std::string, Property::Interface::Ptr>(prop->GetName(), prop));
+    decl->introspection_valid = false;
+    std::atomic_store(&declaration, std::move(decl));
 }
 
 bool Object::Property::Collection::Exists(const std::string &name) const noexcept
@@ -167,15 +303,75 @@ bool Object::Property::Collection::Exists(const std::string &name) const noexcep
 
 const std::string Object::Property::Collection::GenerateIntrospection() const noexcept
 {
-    if (properties.empty())
+    std::lock_guard<std::mutex> lg(introspection_mtx);
+    if (!declaration->introspection_valid)
+    {
+        std::string xml = "";
+        for (auto &prop : properties)
+            xml += prop.second->GenerateIntrospection();
+
+        declaration->introspection = std::move(xml);
+        declaration->introspection_valid = true;
+    }
+    return declaration->introspection;
+}
+
+
+void Object::Property::Collection::Share(const std::string &interface)
+{
+    // The introspection data is prepared here, before it is shared
+    GenerateIntrospection();
+
+    std::lock_guard<std::mutex> lg(introspection_mtx);
+    if (declaration->shared)
+    {
+        return;
+    }
+
+    // Indexed by the D-Bus interface and the introspection data, which
+    // covers the name, data type and access mode of each property
+    auto registry = Object::_private::SharedRegistry<Declaration>::Instance();
+    auto decl = declaration;
+    std::atomic_store(&declaration,
+                      registry->Share(interface + "\n" + decl->introspection,
+                                      [decl]()
+                                      {
+                                          auto shared = std::make_shared<Declaration>(*decl);
+                                          shared->registered = true;
+                                          shared->shared = true;
+                                          return shared;
+                                      }));
+}
+
+
+size_t Object::Property::Collection::SharedDeclarations() noexcept
+{
+    return Object::_private::SharedRegistry<Declaration>::Instance()->size();
+}
+
+
+bool Object::Property::Collection::EnableValueCache(const std::string &property_name,
+                                                    const bool enable)
+{
+    auto prop = properties.find(property_name);
+    if (prop == properties.end())
     {
-        return "";
+        return false;
     }
-    std::string xml = "";
-    for (auto &prop : properties)
-        xml += prop.second->GenerateIntrospection();
+    prop->second->EnableValueCache(enable);
+    return true;
+}
 
-    return xml;
+
+bool Object::Property::Collection::MarkDirty(const std::string &property_name) noexcept
+{
+    auto prop = properties.find(property_name);
+    if (prop == properties.end())
+    {
+        return false;
+    }
+    prop->second->MarkDirty();
+    return true;
 }
 
 
@@ -191,6 +387,26 @@ GVariant *Object::Property::Collection::GetValue(const std::string &property_nam
 }
 
 
+GVariant *Object::Property::Collection::GetAllValues(const std::function<bool(const std::string &)> &include) const
+{
+    glib2::Builder::Scoped b("a{sv}");
+    for (const auto &[name, prop] : properties)
+    {
+        if (include && !include(name))
+        {
+            continue;
+        }
+        GVariant *value = prop->GetValue();
+        if (!value)
+        {
+            throw Object::Exception("Property '" + name + "' returned no value");
+        }
+        b.AddFormatted("{sv}", name.c_str(), value);
+    }
+    return b.Finish();
+}
+
+
 Object::Property::Update::Ptr Object::Property::Collection::SetValue(const std::string &property_name,
                                                                      GVariant *value)
 {
@@ -201,8 +417,7 @@ Object::Property::Update::Ptr Object::Property::Collection::SetValue(const std::
     }
 
     auto property = prop->second;
-    std::string value_type(g_variant_get_type_string(value));
-    if (property->GetDBusType() != value_type)
+    if (!std::atomic_load(&declaration)->types.at(property_name).Matches(value))
     {
         throw Object::Exception("Invalid data type for the property value");
     }
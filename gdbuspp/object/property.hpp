@@ -18,9 +18,13 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <string>
 
 #include "../glib2/utils.hpp"
 #include "exceptions.hpp"
@@ -82,6 +86,20 @@ class Update
     }
 
 
+    /**
+     *  Add the new value of the property as an already prepared
+     *  GVariant object, like the one returned by the get property
+     *  callback of a PropertyBySpec object.
+     *
+     * @param val   GVariant object with the new value.  A floating
+     *              reference is consumed.
+     */
+    void AddValue(GVariant *val)
+    {
+        updated_vals.push_back(val);
+    }
+
+
     /**
      *  This is similar to the @AddValue() method above, but this
      *  is used when processing properties storing array/vector values.
@@ -92,12 +110,12 @@ class Update
     template <typename T>
     void AddValue(const std::vector<T> &vals)
     {
-        GVariantBuilder *val_array = glib2::Builder::Create("a*");
+        glib2::Builder::Scoped val_array("a*");
         for (const auto &v : vals)
         {
-            glib2::Builder::Add(val_array, v);
+            val_array.Add(v);
         }
-        updated_vals.push_back(glib2::Builder::Finish(val_array));
+        updated_vals.push_back(val_array.Finish());
     }
 
 
@@ -113,6 +131,26 @@ class Update
      */
     GVariant *Finalize();
 
+    /**
+     *  Similar to @Finalize(), but only returns the new value of the
+     *  property.  This is used when several property changes are sent
+     *  in a single PropertiesChanged signal.
+     *
+     * @return GVariant*   Pointer to a GVariant object containing the new
+     *                     property value
+     */
+    GVariant *FinalizeValue();
+
+    /**
+     *  Retrieve the property this update belongs to
+     *
+     * @return const Property::Interface&
+     */
+    const Property::Interface &GetProperty() const noexcept
+    {
+        return property;
+    }
+
 
 
   private:
@@ -139,7 +177,7 @@ class Interface
     using Ptr = std::shared_ptr<Interface>;
 
     Interface() = default;
-    virtual ~Interface() noexcept = default;
+    virtual ~Interface() noexcept;
 
     /**
      *  Generates the XML introspection fragment for this property
@@ -208,6 +246,62 @@ class Interface
     {
         return Update::Create(*this);
     }
+
+    /**
+     *  Enable or disable caching of the serialized property value.  When
+     *  enabled, the GVariant value is only created on the first read and
+     *  reused by later reads until the value is changed via SetValue() or
+     *  marked as changed via MarkDirty().
+     *
+     *  This is useful for large values which rarely change.  If the value
+     *  is changed directly by the service, MarkDirty() must be called.
+     *
+     * @param enable  bool flag enabling the value cache
+     */
+    void EnableValueCache(const bool enable) noexcept;
+
+    /**
+     *  Throw away the cached serialized property value, if any.  The
+     *  next read will create it again from the current value.
+     */
+    void MarkDirty() noexcept;
+
+
+  protected:
+    /**
+     *  Used by the GetValue() implementations to retrieve the property
+     *  value via the value cache, if enabled.
+     *
+     *  The returned GVariant object shares the serialized data with the
+     *  cached value, so this does not copy the value.  The create
+     *  function is called without holding the cache lock; a value
+     *  created while the property is changed is not cached.
+     *
+     * @param create   Function creating a new GVariant object with the
+     *                 current property value
+     *
+     * @return GVariant* (floating reference) with the property value
+     */
+    GVariant *GetCachedValue(const std::function<GVariant *()> &create) const;
+
+    /**
+     *  Used by the SetValue() implementations to change the property
+     *  value and throw away the cached serialized value.  The value is
+     *  changed before the cache generation is bumped, so a concurrent
+     *  read which retrieved the old value does not cache it.  The
+     *  GetValue() implementation must retrieve the value inside its
+     *  create function for this to be effective.
+     *
+     * @param store  Function changing the property value
+     */
+    void StoreValue(const std::function<void()> &store);
+
+
+  private:
+    std::atomic<bool> value_cache_enabled{false};
+    mutable GVariant *cached_value = nullptr;
+    uint64_t cache_generation = 0; ///< Bumped on each value change
+    mutable std::mutex cache_mtx{};
 };
 
 
@@ -338,6 +432,175 @@ class BySpec : public Interface
 };
 
 
+
+/**
+ *  Thread-safe storage for property values, to be used with
+ *  Object::Base::AddProperty() when the value is changed by other threads
+ *  than the one reading the property, for example by D-Bus method
+ *  callbacks running in the AsyncProcess::Pool.
+ *
+ *  The value is kept as an immutable snapshot.  Readers get a reference
+ *  to the current snapshot without waiting for writers, while writers
+ *  publish a complete new snapshot atomically.  A reader will thus never
+ *  see a partially updated std::string or std::vector value.
+ *
+ *  @code
+ *
+ *    DBus::Object::Property::Atomic<std::vector<std::string>> routes;
+ *    AddProperty("routes", routes, false);
+ *
+ *    // In a method callback
+ *    routes.Update([&](std::vector<std::string> &r)
+ *                  {
+ *                      r.push_back(new_route);
+ *                  });
+ *
+ *  @endcode
+ *
+ * @tparam T  C++ data type of the property value
+ */
+template <typename T>
+class Atomic
+{
+  public:
+    using Snapshot = std::shared_ptr<const T>;
+
+    Atomic()
+        : value(std::make_shared<const T>())
+    {
+    }
+
+    Atomic(T initial)
+        : value(std::make_shared<const T>(std::move(initial)))
+    {
+    }
+
+    Atomic(const Atomic &) = delete;
+    Atomic &operator=(const Atomic &) = delete;
+
+    /**
+     *  Retrieve the current value snapshot.  The snapshot stays valid
+     *  and unchanged even if a new value is stored.
+     *
+     * @return Snapshot (std::shared_ptr<const T>) to the current value
+     */
+    Snapshot Load() const noexcept
+    {
+        return std::atomic_load_explicit(&value, std::memory_order_acquire);
+    }
+
+    /**
+     *  Retrieve a copy of the current value
+     *
+     * @return T
+     */
+    T Get() const
+    {
+        return *Load();
+    }
+
+    /**
+     *  Replace the current value
+     *
+     * @param newvalue  The new value to store
+     */
+    void Store(T newvalue)
+    {
+        std::atomic_store_explicit(&value,
+                                   Snapshot(std::make_shared<const T>(std::move(newvalue))),
+                                   std::memory_order_release);
+    }
+
+    /**
+     *  Modify a copy of the current value and store it.  If another
+     *  thread stores a new value in the mean time, the modification is
+     *  done again on that value, so no changes are lost.
+     *
+     * @tparam Fn       Function type, called as void(T &)
+     * @param modify    Function modifying the value; it may be called
+     *                  more than once
+     */
+    template <typename Fn>
+    void Update(Fn &&modify)
+    {
+        Snapshot current = Load();
+        Snapshot updated = nullptr;
+        do
+        {
+            T copy(*current);
+            modify(copy);
+            updated = std::make_shared<const T>(std::move(copy));
+        } while (!std::atomic_compare_exchange_weak_explicit(&value,
+                                                             &current,
+                                                             updated,
+                                                             std::memory_order_acq_rel,
+                                                             std::memory_order_acquire));
+    }
+
+    Atomic &operator=(T newvalue)
+    {
+        Store(std::move(newvalue));
+        return *this;
+    }
+
+  private:
+    Snapshot value;
+};
+
+
+namespace _private {
+
+/**
+ *  Conversion helpers used by the property implementation binding a
+ *  Property::Atomic<T> value.
+ *
+ * @tparam T  C++ data type of the property value
+ */
+template <typename T>
+struct AtomicValue
+{
+    static std::string DBusType()
+    {
+        return glib2::DataType::DBus<T>();
+    }
+
+    static GVariant *Create(const char *dbustype, const T &value)
+    {
+        return glib2::Value::CreateType(dbustype, value);
+    }
+
+    static T Extract(GVariant *value)
+    {
+        return glib2::Value::Get<T>(value);
+    }
+};
+
+
+template <typename T>
+struct AtomicValue<std::vector<T>>
+{
+    static std::string DBusType()
+    {
+        return "a" + std::string(glib2::DataType::DBus<T>());
+    }
+
+    static GVariant *Create(const char *dbustype, const std::vector<T> &value)
+    {
+        return glib2::Value::CreateVector(value);
+    }
+
+    static std::vector<T> Extract(GVariant *value)
+    {
+        // ExtractVector() will unref value, which is also unref'd by
+        // the caller; see Object::Base::PropertyType<std::vector<T>>
+        g_variant_ref_sink(value);
+        return glib2::Value::ExtractVector<T>(value, glib2::DataType::DBus<T>(), false);
+    }
+};
+
+} // namespace _private
+
+
 /**
  *   This is the main class used by DBus::Object to store and manage all
  *   properties in a D-Bus object.  The data types supported by this
@@ -374,6 +637,8 @@ class Collection
      *  elements based on all the properties being managed by this
      *  collection object
      *
+     *  The result is cached until another property is added.
+     *
      * @return const std::string  String containing just the <property/>
      *         fragments declaring all known properties.
      */
@@ -392,6 +657,20 @@ class Collection
      */
     GVariant *GetValue(const std::string &property_name) const;
 
+    /**
+     *  Retrieve the values of all the properties managed by this
+     *  collection.  This is used to respond to the
+     *  org.freedesktop.DBus.Properties.GetAll D-Bus method call.
+     *
+     * @param include  Function deciding if a property, by its name, is
+     *                 included in the result.  If nullptr, all the
+     *                 properties are included.
+     *
+     * @return GVariant*  Returns a pointer to a populated a{sv} dictionary
+     *         GVariant object with the property names and values
+     */
+    GVariant *GetAllValues(const std::function<bool(const std::string &)> &include = nullptr) const;
+
     /**
      *  Extracts a new value from a GVariant object for a named property
      *  and changes the property value in the C++ variable bound to the
@@ -407,8 +686,76 @@ class Collection
     Property::Update::Ptr SetValue(const std::string &property_name,
                                    GVariant *value);
 
+    /**
+     *  Enable or disable the value cache of a property; see
+     *  Property::Interface::EnableValueCache()
+     *
+     * @param property_name  std::string with the property name
+     * @param enable         bool flag enabling the value cache
+     *
+     * @return true if the property was found, otherwise false
+     */
+    bool EnableValueCache(const std::string &property_name, const bool enable);
+
+    /**
+     *  Throw away the cached value of a property; see
+     *  Property::Interface::MarkDirty()
+     *
+     * @param property_name  std::string with the property name
+     *
+     * @return true if the property was found, otherwise false
+     */
+    bool MarkDirty(const std::string &property_name) noexcept;
+
+    /**
+     *  Share the property data types and the introspection data of this
+     *  collection with all other objects using the same D-Bus interface
+     *  and identical property declarations.  The property objects
+     *  holding the values are kept per object.
+     *
+     *  This is called by the Object::Manager when an object is
+     *  registered.  Adding a property afterwards gives this collection
+     *  its own declarations again.
+     *
+     * @param interface  std::string with the D-Bus interface of the object
+     */
+    void Share(const std::string &interface);
+
+    /**
+     *  Retrieve the number of distinct property declarations currently
+     *  shared by registered objects in this process.  A declaration is
+     *  released when the last object using it is destroyed.
+     *
+     * @return size_t
+     */
+    static size_t SharedDeclarations() noexcept;
+
   private:
+    /**
+     *  Property declarations, shared by objects with identical properties
+     *  once registered.  A registered Declaration is copied before it is
+     *  modified, as SetValue() may use it from other threads.
+     */
+    struct Declaration
+    {
+        /// Precompiled D-Bus data types of all properties, used by SetValue()
+        std::map<std::string, glib2::Utils::VariantType> types{};
+
+        /// Cached result of GenerateIntrospection(), reset by AddBinding()
+        std::string introspection{};
+        bool introspection_valid = false;
+
+        /// Set when this declaration is used by a registered object
+        bool registered = false;
+
+        /// Set when this declaration is shared between several objects
+        bool shared = false;
+    };
+
     std::map<std::string, Property::Interface::Ptr> properties;
+    /// Modified under introspection_mtx; SetValue() reads it atomically
+    std::shared_ptr<Declaration> declaration = std::make_shared<Declaration>();
+    mutable std::mutex introspection_mtx{};
 
     Collection();
 };
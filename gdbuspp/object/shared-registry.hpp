@@ -0,0 +1,125 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file object/shared-registry.hpp
+ *
+ * @brief Declaration of DBus::Object::_private::SharedRegistry, the
+ *        process wide registry of the method and property declarations
+ *        shared between objects with identical declarations.
+ */
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+
+namespace DBus {
+namespace Object {
+namespace _private {
+
+/**
+ *  Registry of objects of type T shared between D-Bus objects, indexed
+ *  by a key describing the shared object.  Only weak references are
+ *  kept; an entry is removed when the last reference to the shared
+ *  object is released.
+ *
+ *  The registry is kept alive by each shared object, as these may be
+ *  released during the static destruction.
+ */
+template <typename T>
+class SharedRegistry : public std::enable_shared_from_this<SharedRegistry<T>>
+{
+  public:
+    using Ptr = std::shared_ptr<SharedRegistry<T>>;
+
+    /**
+     *  Retrieve the process wide registry of objects of type T
+     *
+     * @return SharedRegistry<T>::Ptr
+     */
+    static Ptr Instance()
+    {
+        static Ptr registry(new SharedRegistry<T>());
+        return registry;
+    }
+
+    /**
+     *  Retrieve the object shared for a key.  If none is shared yet,
+     *  the object prepared by the create function is registered.
+     *
+     * @param key     std::string describing the shared object
+     * @param create  Function preparing the object to share; only called
+     *                if the key is not registered
+     *
+     * @return std::shared_ptr<T> to the shared object
+     */
+    std::shared_ptr<T> Share(const std::string &key,
+                             const std::function<std::shared_ptr<T>()> &create)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        auto it = entries.find(key);
+        if (entries.end() != it)
+        {
+            if (auto shared = it->second.lock())
+            {
+                return shared;
+            }
+            // Released, but the entry is not yet removed by the deleter
+            entries.erase(it);
+        }
+
+        // The shared handle keeps the prepared object alive and
+        // removes the entry when the last reference is released
+        std::shared_ptr<T> obj = create();
+        auto self = this->shared_from_this();
+        std::shared_ptr<T> handle(obj.get(),
+                                  [self, key, obj](T *) mutable
+                                  {
+                                      self->release(key);
+                                      obj.reset();
+                                  });
+        entries.emplace(key, handle);
+        return handle;
+    }
+
+    /**
+     *  Retrieve the number of registered objects
+     *
+     * @return size_t
+     */
+    size_t size() const noexcept
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        return entries.size();
+    }
+
+  private:
+    mutable std::mutex mtx;
+    std::unordered_map<std::string, std::weak_ptr<T>> entries;
+
+    SharedRegistry() = default;
+
+    void release(const std::string &key) noexcept
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        auto it = entries.find(key);
+        if (entries.end() != it && it->second.expired())
+        {
+            entries.erase(it);
+        }
+    }
+};
+
+} // namespace _private
+} // namespace Object
+} // namespace DBus
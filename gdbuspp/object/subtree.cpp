@@ -0,0 +1,244 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file object/subtree.cpp
+ *
+ * @brief Implementation of DBus::Object::Subtree.
+ */
+
+#include <iostream>
+#include <string>
+
+#define GDBUSPP_LOG_CATEGORY OBJECTS
+#include "../features/debug-log.hpp"
+#include "../glib2/callbacks.hpp"
+#include "subtree.hpp"
+
+
+/**
+ *  How long a materialized object is kept after its last use, in
+ *  milliseconds, so following calls to the same object can reuse it
+ */
+#define DBUS_SUBTREE_LINGER_MS 5000
+
+
+namespace DBus {
+namespace Object {
+
+Subtree::Subtree(const Object::Path &root_,
+                 Manager::SubtreeFactory factory_,
+                 Manager::SubtreeEnumerator enumerator_,
+                 Manager::WPtr manager_,
+                 AsyncProcess::Pool::Ptr async_pool,
+                 GMainContext *context_)
+    : root(root_), factory(std::move(factory_)),
+      enumerator(std::move(enumerator_)), manager(manager_),
+      request_pool(async_pool), context(context_),
+      keep_alive(std::make_shared<KeepAliveList>())
+{
+    if (context)
+    {
+        g_main_context_ref(context);
+    }
+}
+
+
+Subtree::~Subtree() noexcept
+{
+    // A pending idle source keeps its own reference to the
+    // KeepAliveList, so the objects are still released by it
+    if (context)
+    {
+        g_main_context_unref(context);
+    }
+}
+
+
+const Object::Path &Subtree::GetRoot() const noexcept
+{
+    return root;
+}
+
+
+std::vector<std::string> Subtree::Enumerate() const
+{
+    if (!enumerator)
+    {
+        return {};
+    }
+    return enumerator();
+}
+
+
+CallbackLink::Ptr Subtree::Materialize(const Object::Path &path)
+{
+    // Evicted objects are released after the lock has been released,
+    // as the object destructors may do more work
+    std::vector<CallbackLink::Ptr> evicted{};
+    const auto now = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lg(materialized_mtx);
+        evicted = evict(now);
+        auto it = materialized.find(path);
+        if (materialized.end() != it)
+        {
+            it->second.last_used = now;
+            return it->second.link;
+        }
+    }
+
+    // The factory is called without holding the lock, as it may
+    // need some time to look up the data for the object
+    Object::Base::Ptr object = nullptr;
+    try
+    {
+        object = factory(path);
+    }
+    catch (const std::exception &excp)
+    {
+        std::cerr << "** ERROR **  Subtree " << root
+                  << ": Failed creating object " << path
+                  << ": " << excp.what() << std::endl;
+        return nullptr;
+    }
+    if (!object)
+    {
+        return nullptr;
+    }
+    if (object->GetPath() != path)
+    {
+        std::cerr << "** ERROR **  Subtree " << root
+                  << ": Factory created object " << object->GetPath()
+                  << " for path " << path << std::endl;
+        return nullptr;
+    }
+    GDBUSPP_LOG("Subtree " << root << ": Materialized " << object);
+
+    std::lock_guard<std::mutex> lg(materialized_mtx);
+    auto [it, inserted] = materialized.emplace(path,
+                                               Entry{nullptr, now});
+    if (inserted)
+    {
+        Manager::Ptr om = manager.lock();
+        if (om)
+        {
+            object->dbus_connection = om->connection;
+        }
+        object->share_declarations();
+        it->second.link = CallbackLink::Create(object, manager, request_pool);
+    }
+    return it->second.link;
+}
+
+
+GDBusInterfaceInfo *Subtree::GetInterfaceInfo(const CallbackLink::Ptr link) const
+{
+    Manager::Ptr om = manager.lock();
+    if (!om)
+    {
+        return nullptr;
+    }
+    return om->get_interface_info(link->object);
+}
+
+
+const GDBusInterfaceVTable *Subtree::GetVTable(const CallbackLink::Ptr link) const
+{
+    static const GDBusInterfaceVTable vtable = {
+        glib2::Callbacks::_int_subtree_callback_method_call,
+        glib2::Callbacks::_int_subtree_callback_get_property,
+        glib2::Callbacks::_int_subtree_callback_set_property};
+    static const GDBusInterfaceVTable vtable_async = {
+        glib2::Callbacks::_int_subtree_callback_method_call,
+        nullptr,
+        nullptr};
+
+    if (manager.expired())
+    {
+        return nullptr;
+    }
+    return (link->object->GetAsyncPropertyAccess() ? &vtable_async : &vtable);
+}
+
+
+void Subtree::KeepAlive(CallbackLink::Ptr link)
+{
+    std::lock_guard<std::mutex> lg(keep_alive->mtx);
+    keep_alive->links.push_back(std::move(link));
+    if (keep_alive->release_scheduled)
+    {
+        // glib2 queues the processing of this call before the pending
+        // release can run, as that has a lower priority
+        return;
+    }
+    keep_alive->release_scheduled = true;
+
+    GSource *src = g_idle_source_new();
+    g_source_set_priority(src, G_PRIORITY_LOW);
+    g_source_set_callback(src,
+                          release_keep_alive,
+                          new std::shared_ptr<KeepAliveList>(keep_alive),
+                          destroy_keep_alive);
+    g_source_attach(src, context);
+    g_source_unref(src);
+}
+
+
+gboolean Subtree::release_keep_alive(void *user_data)
+{
+    auto list = *static_cast<std::shared_ptr<KeepAliveList> *>(user_data);
+
+    // The objects are released after unlocking, as the object
+    // destructors may do more work
+    std::vector<CallbackLink::Ptr> released{};
+    {
+        std::lock_guard<std::mutex> lg(list->mtx);
+        released.swap(list->links);
+        list->release_scheduled = false;
+    }
+    return G_SOURCE_REMOVE;
+}
+
+
+void Subtree::destroy_keep_alive(void *user_data)
+{
+    delete static_cast<std::shared_ptr<KeepAliveList> *>(user_data);
+}
+
+
+std::vector<CallbackLink::Ptr> Subtree::evict(const std::chrono::steady_clock::time_point &now)
+{
+    static const auto linger = std::chrono::milliseconds(DBUS_SUBTREE_LINGER_MS);
+
+    // Only scan for unused objects once per linger period, to avoid
+    // going through all materialized objects on each call
+    std::vector<CallbackLink::Ptr> ret{};
+    if (now - last_eviction < linger)
+    {
+        return ret;
+    }
+    last_eviction = now;
+
+    for (auto it = materialized.begin(); it != materialized.end();)
+    {
+        if (now - it->second.last_used >= linger)
+        {
+            ret.push_back(std::move(it->second.link));
+            it = materialized.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    return ret;
+}
+
+} // namespace Object
+} // namespace DBus
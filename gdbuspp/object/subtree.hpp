@@ -0,0 +1,220 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file object/subtree.hpp
+ *
+ * @brief Declaration of DBus::Object::Subtree.  This keeps track of
+ *        D-Bus objects in a subtree registered via
+ *        DBus::Object::Manager::RegisterSubtree(), which are only
+ *        materialized when a D-Bus call arrives for them.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <gio/gio.h>
+
+#include "../async-process.hpp"
+#include "callbacklink.hpp"
+#include "manager.hpp"
+#include "path.hpp"
+
+
+namespace DBus {
+namespace Object {
+
+/**
+ *  A Subtree object provides the lazily created DBus::Object::Base objects
+ *  below a single D-Bus path.  Objects are created by the user provided
+ *  factory function when a D-Bus call arrives and released again when
+ *  they have not been used for a little while.
+ *
+ *  The materialized objects use the same Object::CallbackLink and glib2
+ *  callback functions as regular objects registered via the
+ *  Object::Manager, so method and property calls are processed the same
+ *  way.
+ */
+class Subtree
+{
+  public:
+    using Ptr = std::shared_ptr<Subtree>;
+
+    /**
+     *  Create a new Subtree object
+     *
+     * @param root          DBus::Object::Path of the subtree root
+     * @param factory       Manager::SubtreeFactory creating the objects
+     * @param enumerator    Manager::SubtreeEnumerator listing the objects,
+     *                      may be nullptr
+     * @param manager       DBus::Object::Manager::WPtr the subtree belongs to
+     * @param async_pool    DBus::AsyncProcess::Pool::Ptr processing the calls
+     * @param context       GMainContext pointer of the main loop the
+     *                      subtree is registered in, nullptr for the
+     *                      default main context
+     *
+     * @return Subtree::Ptr (shared_ptr) to the new Subtree object
+     */
+    [[nodiscard]] static Subtree::Ptr Create(const Object::Path &root,
+                                             Manager::SubtreeFactory factory,
+                                             Manager::SubtreeEnumerator enumerator,
+                                             Manager::WPtr manager,
+                                             AsyncProcess::Pool::Ptr async_pool,
+                                             GMainContext *context)
+    {
+        return Subtree::Ptr(new Subtree(root,
+                                        std::move(factory),
+                                        std::move(enumerator),
+                                        manager,
+                                        async_pool,
+                                        context));
+    }
+
+    ~Subtree() noexcept;
+
+    /**
+     *  Retrieve the D-Bus path of the subtree root
+     *
+     * @return const Object::Path&
+     */
+    const Object::Path &GetRoot() const noexcept;
+
+    /**
+     *  List the child node names available in this subtree, as
+     *  provided by the Manager::SubtreeEnumerator function.
+     *
+     * @return std::vector<std::string> with the node names relative to
+     *         the subtree root
+     */
+    std::vector<std::string> Enumerate() const;
+
+    /**
+     *  Retrieve the CallbackLink for a D-Bus object in the subtree.  If
+     *  the object has not been used recently, it is created via the
+     *  Manager::SubtreeFactory function.
+     *
+     * @param path  DBus::Object::Path of the requested object
+     *
+     * @return CallbackLink::Ptr to the object, nullptr if the factory
+     *         did not provide an object for this path
+     */
+    CallbackLink::Ptr Materialize(const Object::Path &path);
+
+    /**
+     *  Retrieve the parsed D-Bus interface declaration of a materialized
+     *  object.
+     *
+     * @param link  CallbackLink::Ptr returned by Materialize()
+     *
+     * @return GDBusInterfaceInfo* with a new reference the caller must
+     *         release with g_dbus_interface_info_unref(), or nullptr if
+     *         the Object::Manager is gone
+     */
+    GDBusInterfaceInfo *GetInterfaceInfo(const CallbackLink::Ptr link) const;
+
+    /**
+     *  Retrieve the glib2 callback function table to use for a
+     *  materialized object
+     *
+     * @param link  CallbackLink::Ptr returned by Materialize()
+     *
+     * @return const GDBusInterfaceVTable*, or nullptr if the
+     *         Object::Manager is gone
+     */
+    const GDBusInterfaceVTable *GetVTable(const CallbackLink::Ptr link) const;
+
+    /**
+     *  Keep a materialized object alive until glib2 has called the
+     *  GDBusInterfaceVTable functions for a dispatched call.  glib2 does
+     *  not tell when it is done with the user data of a dispatch, so the
+     *  object is released by a G_PRIORITY_LOW idle source, which runs
+     *  after the glib2 call processing in the same main context.  This
+     *  also covers calls glib2 rejects without calling the object.
+     *
+     * @param link  CallbackLink::Ptr returned by Materialize()
+     */
+    void KeepAlive(CallbackLink::Ptr link);
+
+
+  private:
+    /**
+     *  A materialized object in the subtree
+     */
+    struct Entry
+    {
+        CallbackLink::Ptr link;
+        std::chrono::steady_clock::time_point last_used;
+    };
+
+    /**
+     *  Objects kept alive via KeepAlive().  This is shared with the
+     *  pending idle source releasing them, which may run after the
+     *  Subtree object is gone.
+     */
+    struct KeepAliveList
+    {
+        std::mutex mtx{};
+        std::vector<CallbackLink::Ptr> links{};
+        bool release_scheduled = false;
+    };
+
+    const Object::Path root;
+    const Manager::SubtreeFactory factory;
+    const Manager::SubtreeEnumerator enumerator;
+    Manager::WPtr manager;
+    AsyncProcess::Pool::Ptr request_pool;
+    GMainContext *context = nullptr;
+
+    std::map<Object::Path, Entry> materialized = {};
+    std::chrono::steady_clock::time_point last_eviction{};
+    std::mutex materialized_mtx{};
+    std::shared_ptr<KeepAliveList> keep_alive;
+
+    Subtree(const Object::Path &root_,
+            Manager::SubtreeFactory factory_,
+            Manager::SubtreeEnumerator enumerator_,
+            Manager::WPtr manager_,
+            AsyncProcess::Pool::Ptr async_pool,
+            GMainContext *context_);
+
+    /**
+     *  glib2 idle callback releasing the objects in a KeepAliveList
+     *
+     * @param user_data  Raw pointer to a std::shared_ptr<KeepAliveList>
+     *
+     * @return G_SOURCE_REMOVE, this is only run once
+     */
+    static gboolean release_keep_alive(void *user_data);
+
+    /**
+     *  glib2 destroy notification of the idle source releasing the
+     *  KeepAliveList reference
+     *
+     * @param user_data  Raw pointer to a std::shared_ptr<KeepAliveList>
+     */
+    static void destroy_keep_alive(void *user_data);
+
+    /**
+     *  Remove all the materialized objects not used recently.  The
+     *  materialized_mtx must be locked by the caller.
+     *
+     * @param now  Current std::chrono::steady_clock time
+     *
+     * @return std::vector<CallbackLink::Ptr> with the removed objects,
+     *         to be released by the caller after unlocking
+     */
+    std::vector<CallbackLink::Ptr> evict(const std::chrono::steady_clock::time_point &now);
+};
+
+} // namespace Object
+} // namespace DBus
@@ -0,0 +1,222 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file payload.cpp
+ *
+ * @brief  Implementation of DBus::Payload
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <glib.h>
+
+#include "payload.hpp"
+
+
+namespace DBus {
+
+/**
+ *  Seals required on a received memfd.  This ensures the sender can
+ *  neither modify the payload nor truncate the memfd while it is mapped,
+ *  which would result in a SIGBUS in the receiver.
+ */
+#define GDBUSPP_PAYLOAD_SEALS (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE)
+
+
+namespace {
+
+/**
+ *  Create the "(ay)" D-Bus arguments carrying an inline payload
+ */
+static GVariant *payload_args(const void *data, const size_t size)
+{
+    GVariant *bytes = (size > 0
+                           ? g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE,
+                                                       data,
+                                                       size,
+                                                       sizeof(uint8_t))
+                           : g_variant_new_array(G_VARIANT_TYPE_BYTE, nullptr, 0));
+    return g_variant_new_tuple(&bytes, 1);
+}
+
+} // anonymous namespace
+
+
+
+Payload::Exception::Exception(const std::string &errm, GError *gliberr)
+    : DBus::Exception("DBus::Payload", errm, gliberr)
+{
+}
+
+
+
+GVariant *Payload::Prepare(const void *data,
+                           const size_t size,
+                           int &fd,
+                           const size_t threshold)
+{
+    fd = -1;
+    if (size < threshold)
+    {
+        return payload_args(data, size);
+    }
+
+    int memfd = memfd_create("gdbuspp-payload", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (memfd < 0)
+    {
+        throw Payload::Exception("Could not create memfd: "
+                                 + std::string(strerror(errno)));
+    }
+
+    const uint8_t *pos = static_cast<const uint8_t *>(data);
+    size_t remaining = size;
+    while (remaining > 0)
+    {
+        ssize_t r = write(memfd, pos, remaining);
+        if (r < 0)
+        {
+            if (EINTR == errno)
+            {
+                continue;
+            }
+            const std::string err(strerror(errno));
+            close(memfd);
+            throw Payload::Exception("Could not write the payload to memfd: " + err);
+        }
+        pos += r;
+        remaining -= static_cast<size_t>(r);
+    }
+
+    if (fcntl(memfd, F_ADD_SEALS, GDBUSPP_PAYLOAD_SEALS | F_SEAL_SEAL) < 0)
+    {
+        const std::string err(strerror(errno));
+        close(memfd);
+        throw Payload::Exception("Could not seal the payload memfd: " + err);
+    }
+
+    fd = memfd;
+    return payload_args(nullptr, 0);
+}
+
+
+Payload::Ptr Payload::Parse(GVariant *params, const int fd)
+{
+    if (!params || !g_variant_is_of_type(params, G_VARIANT_TYPE("(ay)")))
+    {
+        throw Payload::Exception("Arguments do not carry a payload, expected (ay), got "
+                                 + std::string(params ? g_variant_get_type_string(params)
+                                                      : "nothing"));
+    }
+
+    Payload::Ptr payload(new Payload());
+    payload->value = g_variant_get_child_value(params, 0);
+
+    gsize elements = 0;
+    const void *bytes = g_variant_get_fixed_array(payload->value,
+                                                  &elements,
+                                                  sizeof(uint8_t));
+    if (elements == 0 && fd >= 0)
+    {
+        g_variant_unref(payload->value);
+        payload->value = nullptr;
+        payload->map_memfd(fd);
+    }
+    else
+    {
+        payload->ptr = static_cast<const uint8_t *>(bytes);
+        payload->length = elements;
+    }
+    return payload;
+}
+
+
+Payload::~Payload() noexcept
+{
+    if (mapping)
+    {
+        munmap(mapping, length);
+    }
+    if (value)
+    {
+        g_variant_unref(value);
+    }
+}
+
+
+const uint8_t *Payload::data() const noexcept
+{
+    return (length > 0 ? ptr : nullptr);
+}
+
+
+size_t Payload::size() const noexcept
+{
+    return length;
+}
+
+
+bool Payload::IsMapped() const noexcept
+{
+    return mapping != nullptr;
+}
+
+
+std::string_view Payload::View() const noexcept
+{
+    return std::string_view(reinterpret_cast<const char *>(ptr), length);
+}
+
+
+std::vector<uint8_t> Payload::Copy() const
+{
+    return std::vector<uint8_t>(ptr, ptr + length);
+}
+
+
+void Payload::map_memfd(const int fd)
+{
+    int seals = fcntl(fd, F_GET_SEALS);
+    if (seals < 0)
+    {
+        throw Payload::Exception("Payload file descriptor is not a memfd: "
+                                 + std::string(strerror(errno)));
+    }
+    if ((seals & GDBUSPP_PAYLOAD_SEALS) != GDBUSPP_PAYLOAD_SEALS)
+    {
+        throw Payload::Exception("Payload memfd is not sealed");
+    }
+
+    struct stat st = {};
+    if (fstat(fd, &st) < 0)
+    {
+        throw Payload::Exception("Could not retrieve the payload size: "
+                                 + std::string(strerror(errno)));
+    }
+    if (st.st_size == 0)
+    {
+        return;
+    }
+
+    void *m = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (MAP_FAILED == m)
+    {
+        throw Payload::Exception("Could not map the payload memfd: "
+                                 + std::string(strerror(errno)));
+    }
+    mapping = m;
+    ptr = static_cast<const uint8_t *>(m);
+    length = static_cast<size_t>(st.st_size);
+}
+
+} // namespace DBus
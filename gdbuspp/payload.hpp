@@ -0,0 +1,167 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+#pragma once
+
+/**
+ * @file payload.hpp
+ *
+ * @brief  Declaration of DBus::Payload, transparently passing larger
+ *         binary payloads via a sealed memfd instead of the D-Bus message
+ */
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <glib.h>
+
+#include "exceptions.hpp"
+
+
+/**
+ *  Payloads of this size (in bytes) and larger are passed via a
+ *  sealed memfd by default; smaller payloads are sent inline in the
+ *  D-Bus message.
+ */
+#define GDBUSPP_PAYLOAD_MEMFD_THRESHOLD (64 * 1024)
+
+
+namespace DBus {
+
+/**
+ *  A binary payload of a D-Bus method call or method reply.
+ *
+ *  The payload is always the only argument of the D-Bus method call or
+ *  reply, declared with the "ay" D-Bus data type.  Smaller payloads are
+ *  sent inline in this byte array.  Payloads above a size threshold are
+ *  copied once into a memfd which is sealed against any further changes
+ *  and passed as a file descriptor, leaving the byte array empty.  The
+ *  receiver maps that memfd read-only, without copying the data again
+ *  and without the message bus having to process it.
+ *
+ *  Passing a payload via a memfd requires the D-Bus method to be set up
+ *  via Object::Method::Arguments::PassFileDescriptor() in the direction
+ *  the payload is passed.  If the connection or the D-Bus method does
+ *  not support passing file descriptors, the payload is sent inline.
+ *
+ *  On the sender side, use Proxy::Client::SendPayload() and
+ *  Object::Method::Arguments::SendPayload().  On the receiving side,
+ *  use Object::Method::Arguments::ReceivePayload() and
+ *  Proxy::Client::GetPayload().
+ */
+class Payload
+{
+  public:
+    using Ptr = std::shared_ptr<Payload>;
+
+    class Exception : public DBus::Exception
+    {
+      public:
+        Exception(const std::string &errm, GError *gliberr = nullptr);
+    };
+
+
+    /**
+     *  Prepare the D-Bus arguments carrying a payload
+     *
+     * @param data       Pointer to the payload data
+     * @param size       size_t with the length of the payload data
+     * @param fd         int where the memfd carrying the payload is
+     *                   stored; -1 if the payload is sent inline.  The
+     *                   caller is responsible for closing the memfd.
+     * @param threshold  size_t with the smallest payload passed via a
+     *                   memfd (optional)
+     *
+     * @return GVariant* with the "(ay)" arguments to send
+     * @throws Payload::Exception if the memfd could not be prepared
+     */
+    static GVariant *Prepare(const void *data,
+                             const size_t size,
+                             int &fd,
+                             const size_t threshold = GDBUSPP_PAYLOAD_MEMFD_THRESHOLD);
+
+    /**
+     *  Retrieve the payload from received D-Bus arguments
+     *
+     * @param params  GVariant* with the received "(ay)" arguments
+     * @param fd      int with the first file descriptor received with
+     *                the arguments, -1 if none were received.  The
+     *                file descriptor is not closed.
+     *
+     * @return Payload::Ptr
+     * @throws Payload::Exception if the arguments do not carry a payload
+     *         or the memfd could not be mapped
+     */
+    [[nodiscard]] static Payload::Ptr Parse(GVariant *params, const int fd);
+
+    ~Payload() noexcept;
+
+    Payload(const Payload &) = delete;
+    Payload &operator=(const Payload &) = delete;
+
+    /**
+     *  Retrieve the payload data.  This is valid as long as this
+     *  Payload object exists.
+     *
+     * @return const uint8_t* to the payload data, nullptr if empty
+     */
+    const uint8_t *data() const noexcept;
+
+    /**
+     *  Retrieve the length of the payload data
+     *
+     * @return size_t
+     */
+    size_t size() const noexcept;
+
+    /**
+     *  Check if the payload was received via a memory mapped memfd
+     *
+     * @return true if the payload is memory mapped, false if it was
+     *         sent inline in the D-Bus message
+     */
+    bool IsMapped() const noexcept;
+
+    /**
+     *  Retrieve the payload data as a std::string_view
+     *
+     * @return std::string_view, valid as long as this Payload object exists
+     */
+    std::string_view View() const noexcept;
+
+    /**
+     *  Copy the payload data
+     *
+     * @return std::vector<uint8_t>
+     */
+    std::vector<uint8_t> Copy() const;
+
+
+  private:
+    GVariant *value = nullptr;
+    void *mapping = nullptr;
+    const uint8_t *ptr = nullptr;
+    size_t length = 0;
+
+    Payload() = default;
+
+    /**
+     *  Map a received memfd read-only.  The memfd must be sealed
+     *  against writing, growing and shrinking.
+     *
+     * @param fd  File descriptor to the memfd
+     *
+     * @throws Payload::Exception if the memfd is not properly sealed or
+     *         could not be mapped
+     */
+    void map_memfd(const int fd);
+};
+
+} // namespace DBus
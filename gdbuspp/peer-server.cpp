@@ -0,0 +1,145 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file peer-server.cpp
+ *
+ * @brief  Implementation of DBus::PeerServer
+ */
+
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "connection.hpp"
+#include "peer-server.hpp"
+
+
+namespace DBus {
+
+PeerServer::Exception::Exception(const std::string &err, GError *gliberr)
+    : DBus::Exception("DBus::PeerServer", err, gliberr)
+{
+}
+
+
+PeerServer::PeerServer(const std::string &address, NewConnectionFnc callback)
+    : new_connection_cb(std::move(callback))
+{
+    if (!new_connection_cb)
+    {
+        throw PeerServer::Exception("No new connection callback provided");
+    }
+
+    observer = g_dbus_auth_observer_new();
+    g_signal_connect(observer,
+                     "authorize-authenticated-peer",
+                     G_CALLBACK(on_authorize_peer),
+                     this);
+
+    gchar *guid = g_dbus_generate_guid();
+    GError *error = nullptr;
+    server = g_dbus_server_new_sync(address.c_str(),
+                                    G_DBUS_SERVER_FLAGS_NONE,
+                                    guid,
+                                    observer,
+                                    nullptr, // GCancellable
+                                    &error);
+    g_free(guid);
+    if (!server || error)
+    {
+        if (server)
+        {
+            g_object_unref(server);
+            server = nullptr;
+        }
+        g_object_unref(observer);
+        observer = nullptr;
+        throw PeerServer::Exception("Could not listen on " + address, error);
+    }
+
+    g_signal_connect(server,
+                     "new-connection",
+                     G_CALLBACK(on_new_connection),
+                     this);
+    g_dbus_server_start(server);
+}
+
+
+PeerServer::~PeerServer() noexcept
+{
+    Stop();
+    if (server)
+    {
+        g_signal_handlers_disconnect_by_data(server, this);
+        g_object_unref(server);
+    }
+    if (observer)
+    {
+        g_signal_handlers_disconnect_by_data(observer, this);
+        g_object_unref(observer);
+    }
+}
+
+
+const std::string PeerServer::GetClientAddress() const
+{
+    return std::string(g_dbus_server_get_client_address(server));
+}
+
+
+void PeerServer::Stop() noexcept
+{
+    if (server && g_dbus_server_is_active(server))
+    {
+        g_dbus_server_stop(server);
+    }
+}
+
+
+gboolean PeerServer::on_authorize_peer(GDBusAuthObserver *observer,
+                                       GIOStream *stream,
+                                       GCredentials *credentials,
+                                       gpointer this_ptr)
+{
+    if (!credentials)
+    {
+        return FALSE;
+    }
+    GError *error = nullptr;
+    uid_t peer_uid = g_credentials_get_unix_user(credentials, &error);
+    if (error)
+    {
+        g_error_free(error);
+        return FALSE;
+    }
+    return (getuid() == peer_uid);
+}
+
+
+gboolean PeerServer::on_new_connection(GDBusServer *server,
+                                       GDBusConnection *conn,
+                                       gpointer this_ptr)
+{
+    auto self = static_cast<PeerServer *>(this_ptr);
+    try
+    {
+        self->new_connection_cb(Connection::Create(conn, BusType::PEER));
+        return TRUE;
+    }
+    catch (const std::exception &excp)
+    {
+        std::cerr << "** ERROR **  DBus::PeerServer: "
+                  << "New connection failed: " << excp.what() << std::endl;
+    }
+    return FALSE;
+}
+
+} // namespace DBus
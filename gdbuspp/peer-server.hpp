@@ -0,0 +1,114 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file peer-server.hpp
+ *
+ * @brief  Declaration of DBus::PeerServer, accepting direct peer-to-peer
+ *         D-Bus connections without going through the D-Bus daemon
+ */
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <gio/gio.h>
+
+#include "connection.hpp"
+#include "exceptions.hpp"
+
+
+namespace DBus {
+
+/**
+ *  Listens for direct peer-to-peer D-Bus connections on a D-Bus address,
+ *  using the glib2 GDBusServer.  Each accepted connection is handed over
+ *  as a DBus::Connection object with the BusType::PEER bus type, which
+ *  can be used with DBus::Service, DBus::Object::Manager and
+ *  DBus::Proxy::Client like any other connection.
+ *
+ *  Only peers running as the same user as this process are accepted.
+ *
+ *  The new connection callback is called from the glib2 main loop;
+ *  a main loop must be running for connections to be accepted.
+ */
+class PeerServer
+{
+  public:
+    using Ptr = std::shared_ptr<PeerServer>;
+
+    /**
+     *  Called for each new accepted peer-to-peer connection.  The callback
+     *  must keep the Connection::Ptr for as long as the connection
+     *  should stay open.
+     */
+    using NewConnectionFnc = std::function<void(Connection::Ptr conn)>;
+
+    class Exception : public DBus::Exception
+    {
+      public:
+        Exception(const std::string &err, GError *gliberr = nullptr);
+        virtual ~Exception() noexcept = default;
+    };
+
+
+    /**
+     *  Start listening for peer-to-peer connections
+     *
+     * @param address   std::string with the D-Bus address to listen on,
+     *                  such as "unix:path=/run/my-service/socket" or
+     *                  "unix:tmpdir=/tmp"
+     * @param callback  NewConnectionFnc called for each new connection
+     *
+     * @return PeerServer::Ptr to the listening server
+     * @throws PeerServer::Exception if the server could not be started
+     */
+    [[nodiscard]] static PeerServer::Ptr Create(const std::string &address,
+                                                NewConnectionFnc callback)
+    {
+        return Ptr(new PeerServer(address, std::move(callback)));
+    }
+
+    ~PeerServer() noexcept;
+
+    PeerServer(const PeerServer &) = delete;
+    PeerServer &operator=(const PeerServer &) = delete;
+
+    /**
+     *  Retrieve the D-Bus address clients should use with
+     *  DBus::Connection::CreatePeer() to connect to this server
+     *
+     * @return const std::string with the client address
+     */
+    const std::string GetClientAddress() const;
+
+    /**
+     *  Stop accepting new connections.  Already established connections
+     *  are not affected.
+     */
+    void Stop() noexcept;
+
+
+  private:
+    GDBusServer *server = nullptr;           ///< The glib2 server object
+    GDBusAuthObserver *observer = nullptr;   ///< Peer credentials check
+    NewConnectionFnc new_connection_cb;      ///< User callback
+
+    PeerServer(const std::string &address, NewConnectionFnc callback);
+
+    static gboolean on_authorize_peer(GDBusAuthObserver *observer,
+                                      GIOStream *stream,
+                                      GCredentials *credentials,
+                                      gpointer this_ptr);
+    static gboolean on_new_connection(GDBusServer *server,
+                                      GDBusConnection *conn,
+                                      gpointer this_ptr);
+};
+
+} // namespace DBus
@@ -14,33 +14,50 @@
  *        with a D-Bus service from C++
  */
 
+#include <algorithm>
+#include <atomic>
 #include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
 #include <string>
 #include <sstream>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <unistd.h>
 #include <glib.h>
 #include <gio/gio.h>
 
 #include "connection.hpp"
 #include "proxy.hpp"
+#define GDBUSPP_LOG_CATEGORY PROXY
 #include "features/debug-log.hpp"
+#include "features/probes.hpp"
 #include "glib2/utils.hpp"
 #include "object/path.hpp"
 #include "proxy/utils.hpp"
 
 #define DBUS_PROXY_CALL_TIMEOUT 5000
+#define DBUS_PROXY_CACHE_SIZE 32
 
 
 namespace glib2 {
 
 namespace proxy_callbacks {
 
-void result_handler(GDBusProxy *proxy, GAsyncResult *res, gpointer user_data)
+void result_handler(GDBusConnection *conn, GAsyncResult *res, gpointer user_data)
 {
     GError *error = nullptr;
-    GVariant *result = g_dbus_proxy_call_finish(proxy,
-                                                res,
-                                                &error);
-    g_variant_unref(result);
+    GVariant *result = g_dbus_connection_call_finish(conn,
+                                                     res,
+                                                     &error);
+    if (result)
+    {
+        g_variant_unref(result);
+    }
+    g_clear_error(&error);
 }
 
 } // namespace proxy_callbacks
@@ -56,72 +73,123 @@ void result_handler(GDBusProxy *proxy, GAsyncResult *res, gpointer user_data)
  *  NOTE: The expected use case is that one Proxy object only does one
  *        single D-Bus call before being torn down.  Doing more calls
  *        with the same may cause undefined behaviour due to state values
- *        left behind from prior calls.
+ *        left behind from prior calls.  The GDBusProxy object itself
+ *        is not bound to this state and can be reused by several
+ *        Proxy objects; see DBus::Proxy::_private::ProxyCache.
  */
 class Proxy
 {
   public:
     /**
-     *  Prepares the glib2 GDBProxy object and handles all the error management
+     *  Prepares the call context around an already prepared glib2
+     *  GDBusProxy object.  This object takes over the ownership of
+     *  the reference passed to it and will release it when destructed.
+     *
+     * @param proxy_   GDBusProxy object to use for the D-Bus call
+     * @param options  DBus::Proxy::CallOptions with the call timeout and
+     *                 cancellation token to use.  May be nullptr.
+     * @param stale_   Function called with the GDBusProxy object if it
+     *                 turns out to target a previous owner of the
+     *                 destination name.  May be nullptr.
+     */
+    Proxy(GDBusProxy *proxy_,
+          const DBus::Proxy::CallOptions::Ptr options = nullptr,
+          std::function<void(GDBusProxy *)> stale_ = nullptr)
+        : proxy(proxy_), stale(std::move(stale_)),
+          destination(g_dbus_proxy_get_name(proxy_) ? g_dbus_proxy_get_name(proxy_) : ""),
+          object_path(g_dbus_proxy_get_object_path(proxy_)),
+          interface(g_dbus_proxy_get_interface_name(proxy_))
+    {
+        if (options)
+        {
+            timeout = options->GetTimeout(DBUS_PROXY_CALL_TIMEOUT);
+            cancellable = G_CANCELLABLE(g_object_ref(options->GetCancellable()));
+        }
+    }
+
+    Proxy(const Proxy &) = delete;
+    Proxy &operator=(const Proxy &) = delete;
+
+
+    /**
+     *  Prepares a new glib2 GDBusProxy object and handles all the
+     *  error management
      *
      * @param connection    DBus::Connection with the main D-Bus connection
-     * @param destination_  std::string with the D-Bus service to connect to
-     * @param path_         std::string with the target D-Bus object path
-     * @param interface_    std::string with the interface within the object
+     * @param destination   std::string with the D-Bus service to connect to
+     * @param path          std::string with the target D-Bus object path
+     * @param interface     std::string with the interface within the object
      *                      we want to interact with
+     * @param error_details std::string with additional details used if
+     *                      an exception is thrown
+     *
+     * @return GDBusProxy* to the new proxy object.  The caller is
+     *         responsible for calling g_object_unref() on this object
+     * @throws DBus::Proxy::Exception on errors
      */
-    Proxy(DBus::Connection::Ptr connection,
-          const std::string &destination_,
-          const DBus::Object::Path &path_,
-          const std::string &interface_,
-          const std::string &error_details_ = "")
-        : destination(destination_), object_path(path_), interface(interface_)
+    static GDBusProxy *Prepare(DBus::Connection::Ptr connection,
+                               const std::string &destination,
+                               const DBus::Object::Path &path,
+                               const std::string &interface,
+                               const std::string &error_details = "")
     {
         if (!connection || !connection->Check())
         {
             throw DBus::Proxy::Exception(destination,
-                                         object_path,
+                                         path,
                                          interface,
-                                         error_details_,
+                                         error_details,
                                          "DBus::Connection is not valid");
         }
         GError *err = nullptr;
-        proxy = g_dbus_proxy_new_sync(connection->ConnPtr(),
-                                      G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES,
-                                      nullptr, // GDBusInterfaceInfo
-                                      destination.c_str(),
-                                      object_path.c_str(),
-                                      interface.c_str(),
-                                      nullptr, // GCancellable
-                                      &err);
+        GDBusProxy *proxy = g_dbus_proxy_new_sync(connection->ConnPtr(),
+                                                  static_cast<GDBusProxyFlags>(
+                                                      G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES
+                                                      | G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS),
+                                                  nullptr, // GDBusInterfaceInfo
+                                                  (destination.empty() ? nullptr : destination.c_str()),
+                                                  path.c_str(),
+                                                  interface.c_str(),
+                                                  nullptr, // GCancellable
+                                                  &err);
         if (!proxy || err)
         {
+            if (proxy)
+            {
+                g_object_unref(proxy);
+            }
             if (err)
             {
                 throw DBus::Proxy::Exception(destination,
-                                             object_path,
+                                             path,
                                              interface,
-                                             error_details_,
-                                             "Failed preparing proxy: "
-                                                 + std::string(err->message));
+                                             error_details,
+                                             "Failed preparing proxy:",
+                                             err);
             }
             else
             {
                 throw DBus::Proxy::Exception(destination,
-                                             object_path,
+                                             path,
                                              interface,
-                                             error_details_,
+                                             error_details,
                                              "Failed preparing proxy");
             }
         }
+        return proxy;
     }
 
 
     /**
-     *  Destructing the Proxy requires to clean up the glib2 GDBusProxy object
+     *  Destructing the Proxy releases the reference to the glib2
+     *  GDBusProxy object
      */
     ~Proxy() noexcept
     {
+        if (cancellable)
+        {
+            g_object_unref(cancellable);
+        }
         if (proxy)
         {
             g_object_unref(proxy);
@@ -144,6 +212,7 @@ class Proxy
      */
     GVariant *Call(const std::string &method, GVariant *params, bool no_response)
     {
+        check_deadline(method, params);
         if (!no_response)
         {
             return do_call(method, params);
@@ -161,7 +230,9 @@ class Proxy
      *  reply.
      *
      *  File descriptors are passed in a "side-channel" and is not part of
-     *  of the return signature or response itself (via GVariant*).
+     *  of the return signature or response itself (via GVariant*).  If the
+     *  service sends more than one file descriptor, only the first one is
+     *  kept; the rest are closed.
      *
      * @param ret_fd       The file descriptor sent back from the service
      * @param method       std::string of the D-Bus method to call
@@ -172,13 +243,10 @@ class Proxy
      */
     GVariant *CallGetFD(int *ret_fd, const std::string &method, GVariant *params)
     {
-        GVariant *ret = do_call_with_fdlist(method, params, nullptr);
-
-        // The returned file descriptor is extracted in the do_call_with_fdlist()
-        // method and preserved in this object as return_fd for
-        // code simplicity.  This object is designed to be short-lived
-        // (only one object per D-Bus call), so this is fine
-        *ret_fd = return_fd;
+        std::vector<int> fds{};
+        GVariant *ret = CallWithFDs(method, params, {}, fds);
+        *ret_fd = (!fds.empty() ? fds[0] : -1);
+        close_fds(fds, 1);
         return ret;
     }
 
@@ -201,49 +269,212 @@ class Proxy
                          GVariant *params,
                          int &fd)
     {
-        // File descriptor passed on by the caller
-        GUnixFDList *caller_fdlist = g_unix_fd_list_new();
-        if (!caller_fdlist)
-        {
-            std::ostringstream erm;
-            erm << "Failed allocating file descriptor list for "
-                << "'" << method << "'";
-            throw DBus::Proxy::Exception(destination,
-                                         object_path,
-                                         interface,
-                                         method,
-                                         erm.str());
-        }
+        std::vector<int> fds{};
+        GVariant *ret = CallWithFDs(method, params, {fd}, fds);
+        close_fds(fds, 0);
+        return ret;
+    }
 
-        GError *error = nullptr;
-        if (g_unix_fd_list_append(caller_fdlist, fd, &error) < 0)
-        {
-            std::ostringstream erm;
-            erm << "Failed preparing file descriptor for "
-                << "'" << method << "'";
-            throw DBus::Proxy::Exception(destination,
-                                         object_path,
-                                         interface,
-                                         method,
-                                         erm.str(),
-                                         error);
-        }
-        return do_call_with_fdlist(method, params, caller_fdlist);
+
+    /**
+     *  Do a D-Bus method call passing any number of file descriptors
+     *  in both directions.
+     *
+     * @param method     std::string of the D-Bus method to call
+     * @param params     GVariant * containing all the method arguments
+     * @param send_fds   std::vector<int> with the file descriptors to send
+     *                   to the service.  These are duplicated and remain
+     *                   owned by the caller.
+     * @param recv_fds   std::vector<int> where the file descriptors sent
+     *                   back by the service are stored.  The caller is
+     *                   responsible for closing them.
+     *
+     * @return GVariant* is returned containing the arguments from the D-Bus
+     *         method as the response
+     */
+    GVariant *CallWithFDs(const std::string &method,
+                          GVariant *params,
+                          const std::vector<int> &send_fds,
+                          std::vector<int> &recv_fds)
+    {
+        check_deadline(method, params);
+        GUnixFDList *caller_fdlist = prepare_fdlist(method, send_fds);
+        GVariant *ret = do_call_with_fdlist(method, params, caller_fdlist);
+        recv_fds = std::move(return_fds);
+        return_fds.clear();
+        return ret;
+    }
+
+
+    /**
+     *  Record the calls done via this object in the call statistics
+     *
+     * @param stats       DBus::Proxy::CallStats to record to; may be nullptr
+     * @param key_intf    std::string with the interface to record the call
+     *                    as.  If empty, the proxy interface is used
+     * @param key_method  std::string with the method to record the call as.
+     *                    If empty, the called method is used
+     */
+    void RecordStats(DBus::Proxy::CallStats::Ptr stats,
+                     const std::string &key_intf = "",
+                     const std::string &key_method = "")
+    {
+        call_stats = std::move(stats);
+        stats_interface = key_intf;
+        stats_method = key_method;
     }
 
 
   private:
     GDBusProxy *proxy = nullptr;
+    std::function<void(GDBusProxy *)> stale = nullptr;
     const std::string destination;
     const DBus::Object::Path object_path;
     const std::string interface;
-    int return_fd = -1;
+    std::vector<int> return_fds{};
+    int timeout = DBUS_PROXY_CALL_TIMEOUT;
+    GCancellable *cancellable = nullptr;
+    DBus::Proxy::CallStats::Ptr call_stats = nullptr;
+    std::string stats_interface{};
+    std::string stats_method{};
+
+
+    /**
+     *  Prepare measuring a call for the call statistics and the
+     *  proxy_call_begin/proxy_call_end probes
+     *
+     * @param method  std::string with the method being called
+     *
+     * @return int64_t with the monotonic time the call started; 0 if
+     *         the call is not measured
+     */
+    int64_t call_begin(const std::string &method)
+    {
+        if (GDBUSPP_PROBE_ENABLED(proxy_call_begin) || GDBUSPP_PROBE_ENABLED(proxy_call_end))
+        {
+            GDBUSPP_PROBE(proxy_call_begin,
+                          object_path.c_str(),
+                          interface.c_str(),
+                          method.c_str(),
+                          destination.c_str());
+            return g_get_monotonic_time();
+        }
+        const bool trace = DBus::Features::Trace::Enabled(DBus::Features::Trace::Category::PROXY,
+                                                          DBus::Features::Trace::Level::DEBUG);
+        return ((call_stats || trace) ? g_get_monotonic_time() : 0);
+    }
+
+
+    /**
+     *  Record a completed call in the call statistics, if enabled
+     *
+     * @param method  std::string with the called method
+     * @param start   int64_t with the monotonic time the call started
+     * @param error   GError * from the call; nullptr if it succeeded
+     */
+    void record_call(const std::string &method, const int64_t start, const GError *error)
+    {
+        if (0 == start)
+        {
+            return;
+        }
+        GDBUSPP_TRACE(PROXY, DEBUG, "Call completed: duration={} usec, failed={}",
+                      g_get_monotonic_time() - start, (error ? 1 : 0));
+        GDBUSPP_PROBE(proxy_call_end,
+                      object_path.c_str(),
+                      interface.c_str(),
+                      method.c_str(),
+                      g_get_monotonic_time() - start,
+                      (error ? 1 : 0));
+        if (!call_stats)
+        {
+            return;
+        }
+        call_stats->Record(object_path,
+                           (stats_interface.empty() ? interface : stats_interface),
+                           (stats_method.empty() ? method : stats_method),
+                           g_get_monotonic_time() - start,
+                           error);
+    }
+
+
+    /**
+     *  Check if a failed call was sent to a previous owner of the
+     *  destination name.  The GDBusProxy object only learns about a new
+     *  name owner via the NameOwnerChanged signal, which is never
+     *  processed without a running main loop in the caller.  Such a call
+     *  is never delivered to the service, so it is safe to send again.
+     *
+     *  If so, the GDBusProxy object is reported as stale and the error
+     *  is released.
+     *
+     * @param err  GError * from the failed call
+     *
+     * @return true if the call should be sent again via the destination
+     *         name itself
+     */
+    bool owner_vanished(GError *&err)
+    {
+        if (!err || destination.empty() || ':' == destination[0]
+            || !(g_error_matches(err, G_DBUS_ERROR, G_DBUS_ERROR_SERVICE_UNKNOWN)
+                 || g_error_matches(err, G_DBUS_ERROR, G_DBUS_ERROR_NAME_HAS_NO_OWNER)))
+        {
+            return false;
+        }
+
+        // Without a known owner, the call was already sent to the
+        // destination name; sending it again would fail the same way
+        gchar *owner = g_dbus_proxy_get_name_owner(proxy);
+        if (!owner)
+        {
+            return false;
+        }
+        g_free(owner);
+
+        GDBUSPP_LOG("Proxy::Client('" << destination << "', "
+                    << "'" << object_path << "', "
+                    << "'" << interface << "') "
+                    << "Name owner vanished, resending via the destination name");
+        if (stale)
+        {
+            stale(proxy);
+        }
+        g_clear_error(&err);
+        return true;
+    }
+
+
+    /**
+     *  Ensure the call deadline has not already passed before starting
+     *  the call.  If it has, the call arguments are released.
+     *
+     * @param method  std::string with the method being called
+     * @param params  GVariant * with the method arguments, may be nullptr
+     *
+     * @throws DBus::Proxy::Exception if the deadline has passed
+     */
+    void check_deadline(const std::string &method, GVariant *params)
+    {
+        if (timeout > 0)
+        {
+            return;
+        }
+        if (params)
+        {
+            g_variant_unref(g_variant_ref_sink(params));
+        }
+        throw DBus::Proxy::Exception(destination,
+                                     object_path,
+                                     interface,
+                                     method,
+                                     "Call deadline exceeded");
+    }
 
 
     /**
      *  Do an ordinary synchronous D-Bus method call in a D-Bus service
      *  This will wait until the serivce has responded or until the
-     *  DBUS_PROXY_CALL_TIMEOUT (in ms) timeout hits.
+     *  call timeout hits; by default DBUS_PROXY_CALL_TIMEOUT (in ms).
      *
      * @param method       std::string of the method to call
      * @param params       GVariant * containing the arugments to the method
@@ -257,16 +488,41 @@ class Proxy
                     << "'" << object_path << "', "
                     << "'" << interface << "', "
                     << "'" << method << "', "
-                    << "params=" << (params ? g_variant_print(params, true) : "(none)")
+                    << "params=" << DBus::Features::Trace::VariantString(params)
                     << ")");
+        // Keep the arguments around in case the call must be sent again
+        if (params)
+        {
+            g_variant_ref_sink(params);
+        }
         GError *err = nullptr;
+        const int64_t start = call_begin(method);
         GVariant *ret = g_dbus_proxy_call_sync(proxy,
                                                method.c_str(),
                                                params,
                                                G_DBUS_CALL_FLAGS_NONE,
-                                               DBUS_PROXY_CALL_TIMEOUT,
-                                               nullptr,
+                                               timeout,
+                                               cancellable,
                                                &err);
+        if (!ret && owner_vanished(err))
+        {
+            ret = g_dbus_connection_call_sync(g_dbus_proxy_get_connection(proxy),
+                                              destination.c_str(),
+                                              object_path.c_str(),
+                                              interface.c_str(),
+                                              method.c_str(),
+                                              params,
+                                              nullptr, // GVariantType reply_type
+                                              G_DBUS_CALL_FLAGS_NONE,
+                                              timeout,
+                                              cancellable,
+                                              &err);
+        }
+        if (params)
+        {
+            g_variant_unref(params);
+        }
+        record_call(method, start, err);
         validate_call_response(ret, err, method);
         return ret;
     }
@@ -279,7 +535,9 @@ class Proxy
      *
      *  The downside of this approach is that there will also be no
      *  error checking of the D-Bus method call.  If the method call fails,
-     *  no error messages can be retrieved.
+     *  no error messages can be retrieved.  The call is therefore sent
+     *  via the destination name, as a call sent to a previous owner of
+     *  the name would be lost without notice.
      *
      * @param method       std::string of the method to call
      * @param params       GVariant * containing the arugments to the method
@@ -291,17 +549,21 @@ class Proxy
                     << "'" << object_path << "', "
                     << "'" << interface << "', "
                     << "'" << method << "', "
-                    << "params=" << (params ? g_variant_print(params, true) : "(none)")
+                    << "params=" << DBus::Features::Trace::VariantString(params)
                     << ") [NO RESPONSE CALL]");
 
-        g_dbus_proxy_call(proxy,
-                          method.c_str(),
-                          params,
-                          G_DBUS_CALL_FLAGS_NONE,
-                          DBUS_PROXY_CALL_TIMEOUT,
-                          nullptr, // GCancellable
-                          (GAsyncReadyCallback)proxy_callbacks::result_handler,
-                          nullptr // user_data, not needed - no callback used
+        g_dbus_connection_call(g_dbus_proxy_get_connection(proxy),
+                               (destination.empty() ? nullptr : destination.c_str()),
+                               object_path.c_str(),
+                               interface.c_str(),
+                               method.c_str(),
+                               params,
+                               nullptr, // GVariantType reply_type
+                               G_DBUS_CALL_FLAGS_NONE,
+                               timeout,
+                               cancellable,
+                               (GAsyncReadyCallback)proxy_callbacks::result_handler,
+                               nullptr // user_data, not needed - no callback used
         );
     }
 
@@ -310,20 +572,17 @@ class Proxy
      *  Similar to the @do_call method, but it also handles sending and
      *  receiving file descriptors to/from the D-Bus method being called
      *
-     *  If the method call returns a file descriptor, this is extracted and
-     *  stored in the private return_fd variable.  The glib2 implementation
+     *  If the method call returns file descriptors, these are extracted and
+     *  stored in the private return_fds variable.  The glib2 implementation
      *  does not put the file descriptors in the GVariant * responses, but
      *  is sent via a "side-channel".
      *
-     *  The D-Bus protocol supports passing multiple file descriptors in
-     *  both directions.  This implementation will only consider a single
-     *  file descriptor in each direction, and only one direction per call.
-     *
      * @param method         std::string of the method to call
      * @param params         GVariant * containing the arugments to the method
-     * @param caller_fdlist  GUnixFDList * containing the file descriptor to
+     * @param caller_fdlist  GUnixFDList * containing the file descriptors to
      *                       send to the D-Bus method.  Can be nullptr if no
-     *                       file descriptors is being sent.
+     *                       file descriptors is being sent.  This method
+     *                       takes over the ownership of this list.
      *
      * @return GVariant* containing the result of the D-Bus method call
      */
@@ -334,6 +593,10 @@ class Proxy
         GDBusConnection *conn = g_dbus_proxy_get_connection(proxy);
         if (!(g_dbus_connection_get_capabilities(conn) & G_DBUS_CAPABILITY_FLAGS_UNIX_FD_PASSING))
         {
+            if (caller_fdlist)
+            {
+                glib2::Utils::unref_fdlist(caller_fdlist);
+            }
             throw DBus::Proxy::Exception(destination,
                                          object_path,
                                          interface,
@@ -341,36 +604,118 @@ class Proxy
                                          "D-Bus connection does not support file descriptor passing");
         }
 
-        GDBUSPP_LOG("Proxy::Client::"
-                    << (caller_fdlist ? "SendFD" : "GetFD")
-                    << "("
+        GDBUSPP_LOG("Proxy::Client::CallWithFDs("
                     << "'" << destination << "', "
                     << "'" << object_path << "', "
                     << "'" << interface << "', "
                     << "'" << method << "', "
-                    << "params=" << (params ? g_variant_print(params, true) : "(none)")
+                    << "params=" << DBus::Features::Trace::VariantString(params) << ", "
+                    << "send_fds="
+                    << (caller_fdlist ? g_unix_fd_list_get_length(caller_fdlist) : 0)
                     << ") ");
 
+        // Keep the arguments around in case the call must be sent again
+        if (params)
+        {
+            g_variant_ref_sink(params);
+        }
         GUnixFDList *ret_fd = nullptr;
         GError *error = nullptr;
+        const int64_t start = call_begin(method);
         GVariant *ret = g_dbus_proxy_call_with_unix_fd_list_sync(proxy,
                                                                  method.c_str(),
                                                                  params, // parameters to method
                                                                  G_DBUS_CALL_FLAGS_NONE,
-                                                                 DBUS_PROXY_CALL_TIMEOUT,
+                                                                 timeout,
                                                                  caller_fdlist, // fd_list (to send)
                                                                  &ret_fd,       // fd from the service
-                                                                 nullptr,       // GCancellable
+                                                                 cancellable,
                                                                  &error);
-        validate_call_response(ret, error, method);
+        if (!ret && owner_vanished(error))
+        {
+            ret = g_dbus_connection_call_with_unix_fd_list_sync(conn,
+                                                                destination.c_str(),
+                                                                object_path.c_str(),
+                                                                interface.c_str(),
+                                                                method.c_str(),
+                                                                params,
+                                                                nullptr, // GVariantType reply_type
+                                                                G_DBUS_CALL_FLAGS_NONE,
+                                                                timeout,
+                                                                caller_fdlist,
+                                                                &ret_fd,
+                                                                cancellable,
+                                                                &error);
+        }
+        if (params)
+        {
+            g_variant_unref(params);
+        }
+        record_call(method, start, error);
+        if (caller_fdlist)
+        {
+            glib2::Utils::unref_fdlist(caller_fdlist);
+        }
         if (ret_fd)
         {
-            return_fd = g_unix_fd_list_get(ret_fd, 0, &error);
-            if (return_fd < 0 || error)
+            // Take over all the file descriptors, to avoid them being
+            // closed when the GUnixFDList is released
+            gint count = 0;
+            gint *fds = g_unix_fd_list_steal_fds(ret_fd, &count);
+            return_fds.assign(fds, fds + count);
+            g_free(fds);
+            glib2::Utils::unref_fdlist(ret_fd);
+        }
+        if (!ret || error)
+        {
+            close_fds(return_fds, 0);
+        }
+        validate_call_response(ret, error, method);
+        return ret;
+    }
+
+
+    /**
+     *  Prepare the GUnixFDList used to send file descriptors to the
+     *  D-Bus service
+     *
+     * @param method  std::string of the method to call, used in errors
+     * @param fds     std::vector<int> of all the file descriptors to send
+     *
+     * @return GUnixFDList* with a copy of all the file descriptors, or
+     *         nullptr if there are no file descriptors to send
+     * @throws DBus::Proxy::Exception on errors
+     */
+    GUnixFDList *prepare_fdlist(const std::string &method,
+                                const std::vector<int> &fds)
+    {
+        if (fds.empty())
+        {
+            return nullptr;
+        }
+
+        GUnixFDList *fdlist = g_unix_fd_list_new();
+        if (!fdlist)
+        {
+            std::ostringstream erm;
+            erm << "Failed allocating file descriptor list for "
+                << "'" << method << "'";
+            throw DBus::Proxy::Exception(destination,
+                                         object_path,
+                                         interface,
+                                         method,
+                                         erm.str());
+        }
+
+        for (int fd : fds)
+        {
+            GError *error = nullptr;
+            if (g_unix_fd_list_append(fdlist, fd, &error) < 0)
             {
+                glib2::Utils::unref_fdlist(fdlist);
                 std::ostringstream erm;
-                erm << "Error retrieving file descriptor from "
-                    << "'" + method + "'";
+                erm << "Failed preparing file descriptor for "
+                    << "'" << method << "'";
                 throw DBus::Proxy::Exception(destination,
                                              object_path,
                                              interface,
@@ -378,9 +723,25 @@ class Proxy
                                              erm.str(),
                                              error);
             }
-            glib2::Utils::unref_fdlist(ret_fd);
         }
-        return ret;
+        return fdlist;
+    }
+
+
+    /**
+     *  Close file descriptors received from the service which are not
+     *  passed on to the caller
+     *
+     * @param fds    std::vector<int> with the file descriptors
+     * @param first  size_t index of the first file descriptor to close
+     */
+    static void close_fds(std::vector<int> &fds, const size_t first) noexcept
+    {
+        for (size_t i = first; i < fds.size(); ++i)
+        {
+            close(fds[i]);
+        }
+        fds.resize(std::min(first, fds.size()));
     }
 
 
@@ -429,7 +790,7 @@ class Proxy
                     << "'" << method << "'"
                     << ") "
                     << "Result: "
-                    << (res ? g_variant_print(res, true) : "(none)"));
+                    << DBus::Features::Trace::VariantString(res));
     }
 };
 
@@ -464,121 +825,1678 @@ const std::string Exception::compose_error(const std::string &destination,
                                            const std::string &interface,
                                            const std::string &method) const
 {
-    std::ostringstream err;
-    std::ostringstream method_info{};
+    std::string err;
+    err.reserve(destination.size() + path.size() + interface.size()
+                + method.size() + 32);
+    err.append("Proxy::Client('")
+        .append(destination)
+        .append("', '")
+        .append(path)
+        .append("', '")
+        .append(interface);
     if (!method.empty())
     {
-        method_info << "', '" << method;
+        err.append("', '").append(method);
     }
-    err << "Proxy::Client("
-        << "'" << destination << "', "
-        << "'" << path << "', "
-        << "'" << interface << method_info.str()
-        << "')";
-    return err.str();
+    err.append("')");
+    return err;
 }
 
 
-TargetPreset::TargetPreset(const Object::Path &object_path_,
-                           const std::string &interface_)
-    : object_path(object_path_), interface(interface_)
+namespace _private {
+
+/**
+ *  Keeps a limited set of prepared GDBusProxy objects for a single
+ *  D-Bus destination, keyed by the object path and interface.
+ *
+ *  Preparing a GDBusProxy object requires a blocking round-trip to
+ *  the D-Bus daemon.  By reusing these objects, only the first call
+ *  against an object path and interface pays this price.  When the
+ *  cache is full, the least recently used proxy is released.
+ */
+class ProxyCache
 {
-}
+  public:
+    ProxyCache(Connection::Ptr conn, const std::string &dest, size_t max_size_)
+        : connection(conn), destination(dest), max_size(max_size_)
+    {
+    }
 
+    ~ProxyCache() noexcept
+    {
+        Clear();
+    }
 
 
-Client::Client(Connection::Ptr conn, const std::string &dest, uint8_t timeout)
-    : connection(conn), destination(dest)
-{
-    if ("org.freedesktop.DBus" != dest)
+    /**
+     *  Retrieve a GDBusProxy object for the given object path and
+     *  interface.  If it is not found in the cache, a new one will be
+     *  prepared and added to the cache.
+     *
+     * @param path           DBus::Object::Path of the object to access
+     * @param interface      std::string with the interface in the object
+     * @param error_details  std::string with additional details used if
+     *                       an exception is thrown
+     *
+     * @return GDBusProxy* with a new reference.  The caller must
+     *         call g_object_unref() on this object when done.
+     * @throws DBus::Proxy::Exception on errors
+     */
+    GDBusProxy *Get(const Object::Path &path,
+                    const std::string &interface,
+                    const std::string &error_details)
     {
-        // Don't do this if querying org.freedesktop.DBus.
-        // First, this need to be running anyhow - and it would
-        // result in a recursion, since DBusServiceQuery uses this Client
-        // implementation
-        auto srvqry = Proxy::Utils::DBusServiceQuery::Create(connection);
-        if (!srvqry->CheckServiceAvail(destination, timeout))
+        const Key key{path, interface};
         {
-            throw DBus::Proxy::Exception("Service '"
-                                         + destination
-                                         + "' cannot be reached");
+            std::lock_guard<std::mutex> lg(mtx);
+            auto it = index.find(key);
+            if (index.end() != it)
+            {
+                // Move it to the front of the list, as the
+                // most recently used proxy
+                lru.splice(lru.begin(), lru, it->second);
+                return G_DBUS_PROXY(g_object_ref(it->second->second));
+            }
         }
+
+        // Prepare the new proxy without holding the lock, to not block
+        // other callers while waiting for the D-Bus daemon
+        GDBusProxy *prx = glib2::Proxy::Prepare(connection,
+                                                destination,
+                                                path,
+                                                interface,
+                                                error_details);
+
+        std::lock_guard<std::mutex> lg(mtx);
+        auto it = index.find(key);
+        if (index.end() != it)
+        {
+            // Another thread added the same proxy in the mean time,
+            // use that one instead.
+            g_object_unref(prx);
+            lru.splice(lru.begin(), lru, it->second);
+            return G_DBUS_PROXY(g_object_ref(it->second->second));
+        }
+
+        if (max_size > 0)
+        {
+            lru.emplace_front(key, G_DBUS_PROXY(g_object_ref(prx)));
+            index[key] = lru.begin();
+            evict();
+        }
+        return prx;
     }
-}
 
 
-const std::string &Client::GetDestination() const noexcept
-{
-    return destination;
-}
+    /**
+     *  Prepare the call context for a D-Bus call against the given
+     *  object path and interface, using a cached GDBusProxy object.
+     *  If the cached object turns out to target a previous owner of
+     *  the destination name, it is removed from the cache.
+     *
+     * @param path           DBus::Object::Path of the object to access
+     * @param interface      std::string with the interface in the object
+     * @param error_details  std::string with additional details used if
+     *                       an exception is thrown
+     * @param options        DBus::Proxy::CallOptions for the call.
+     *                       May be nullptr.
+     *
+     * @return glib2::Proxy
+     * @throws DBus::Proxy::Exception on errors
+     */
+    glib2::Proxy Open(const Object::Path &path,
+                      const std::string &interface,
+                      const std::string &error_details,
+                      const CallOptions::Ptr options)
+    {
+        return glib2::Proxy(Get(path, interface, error_details),
+                            options,
+                            [this](GDBusProxy *stale)
+                            {
+                                Invalidate(stale);
+                            });
+    }
 
 
-GVariant *Client::Call(const Object::Path &object_path,
-                       const std::string &interface,
-                       const std::string &method,
-                       GVariant *params,
-                       const bool no_response) const
-{
-    glib2::Proxy prx(connection,
-                     destination,
-                     object_path,
-                     interface,
-                     method);
-    return prx.Call(method, params, no_response);
-}
+    /**
+     *  Remove a GDBusProxy object from the cache, if it is still cached.
+     *  The next call against the same object path and interface will
+     *  prepare a new one.
+     *
+     * @param prx  GDBusProxy object to remove
+     */
+    void Invalidate(GDBusProxy *prx) noexcept
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        auto it = index.find(Key{g_dbus_proxy_get_object_path(prx),
+                                 g_dbus_proxy_get_interface_name(prx)});
+        if (index.end() != it && prx == it->second->second)
+        {
+            g_object_unref(prx);
+            lru.erase(it->second);
+            index.erase(it);
+        }
+    }
 
 
-GVariant *Client::Call(const TargetPreset::Ptr preset,
-                       const std::string &method,
-                       GVariant *params,
-                       const bool no_response) const
-{
-    glib2::Proxy prx(connection,
-                     destination,
-                     preset->object_path,
-                     preset->interface,
-                     method);
-    return prx.Call(method, params, no_response);
-}
+    /**
+     *  Change the maximum number of GDBusProxy objects to keep
+     *
+     * @param size  size_t with the new maximum size.  If 0, the cache
+     *              is disabled.
+     */
+    void SetMaxSize(const size_t size)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        max_size = size;
+        evict();
+    }
 
 
-GVariant *Client::GetFD(int &fd,
-                        const TargetPreset::Ptr preset,
-                        const std::string &method,
-                        GVariant *params) const
-{
-    glib2::Proxy prx(connection,
-                     destination,
-                     preset->object_path,
-                     preset->interface,
-                     method);
-    return prx.CallGetFD(&fd, method, params);
-}
+    /**
+     *  Release all the GDBusProxy objects in the cache
+     */
+    void Clear() noexcept
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        for (auto &e : lru)
+        {
+            g_object_unref(e.second);
+        }
+        lru.clear();
+        index.clear();
+    }
 
 
-GVariant *Client::SendFD(const TargetPreset::Ptr preset,
-                         const std::string &method,
+  private:
+    using Key = std::pair<std::string, std::string>;
+    using Entry = std::pair<Key, GDBusProxy *>;
+
+    Connection::Ptr connection = nullptr;
+    const std::string destination;
+    size_t max_size = 0;
+    std::mutex mtx{};
+    std::list<Entry> lru{};
+    std::map<Key, std::list<Entry>::iterator> index{};
+
+
+    /**
+     *  Remove the least recently used entries until the cache size
+     *  is within the limit.  The caller must hold the mtx lock.
+     */
+    void evict() noexcept
+    {
+        while (lru.size() > max_size)
+        {
+            Entry &e = lru.back();
+            index.erase(e.first);
+            g_object_unref(e.second);
+            lru.pop_back();
+        }
+    }
+};
+
+/**
+ *  Contains all the information needed to process one asynchronous
+ *  D-Bus call and deliver its result.  These objects are owned by
+ *  the AsyncWorker from the call is queued until the result has been
+ *  delivered.
+ */
+struct AsyncCall
+{
+    enum class Type
+    {
+        METHOD,       ///< Ordinary D-Bus method call
+        GET_FD,       ///< Method call receiving a file descriptor
+        SEND_FD,      ///< Method call sending a file descriptor
+        PROPERTY_GET, ///< Property Get call; the result is unwrapped
+        PROPERTY_SET  ///< Property Set call; no result is returned
+    };
+
+    AsyncCall(Type type_,
+              GDBusConnection *conn,
+              const std::string &destination_,
+              const Object::Path &object_path_,
+              const std::string &interface_,
+              const std::string &method_,
+              GVariant *params_,
+              const std::string &error_details_)
+        : type(type_), connection(conn ? G_DBUS_CONNECTION(g_object_ref(conn)) : nullptr),
+          destination(destination_), object_path(object_path_),
+          interface(interface_), method(method_), error_details(error_details_),
+          params(params_ ? g_variant_ref_sink(params_) : nullptr),
+          cancellable(g_cancellable_new())
+    {
+        if (!connection)
+        {
+            if (params)
+            {
+                g_variant_unref(params);
+            }
+            g_object_unref(cancellable);
+            throw DBus::Proxy::Exception(destination,
+                                         object_path,
+                                         interface,
+                                         error_details,
+                                         "DBus::Connection is not valid");
+        }
+    }
+
+    ~AsyncCall() noexcept
+    {
+        for (auto &lnk : links)
+        {
+            g_cancellable_disconnect(lnk.first, lnk.second);
+            g_object_unref(lnk.first);
+        }
+        g_object_unref(cancellable);
+        if (params)
+        {
+            g_variant_unref(params);
+        }
+        if (send_fd >= 0)
+        {
+            close(send_fd);
+        }
+        g_object_unref(connection);
+    }
+
+    AsyncCall(const AsyncCall &) = delete;
+    AsyncCall &operator=(const AsyncCall &) = delete;
+
+
+    /**
+     *  Apply the timeout and cancellation token from the caller provided
+     *  call options
+     *
+     * @param options  CallOptions::Ptr to use; may be nullptr
+     */
+    void SetOptions(const CallOptions::Ptr options) noexcept
+    {
+        if (!options)
+        {
+            return;
+        }
+        timeout = options->GetTimeout(DBUS_PROXY_CALL_TIMEOUT);
+        Link(options->GetCancellable());
+    }
+
+
+    /**
+     *  Record this call in the call statistics when it completes
+     *
+     * @param stats       DBus::Proxy::CallStats to record to; may be nullptr
+     * @param key_intf    std::string with the interface to record the call as
+     * @param key_method  std::string with the method to record the call as
+     */
+    void RecordStats(DBus::Proxy::CallStats::Ptr stats,
+                     const std::string &key_intf,
+                     const std::string &key_method)
+    {
+        call_stats = std::move(stats);
+        stats_interface = key_intf;
+        stats_method = key_method;
+    }
+
+
+    /**
+     *  Mark the start of the D-Bus call, used by the call statistics
+     */
+    void Started() noexcept
+    {
+        if (call_stats)
+        {
+            start = g_get_monotonic_time();
+        }
+    }
+
+
+    /**
+     *  Record the completed call in the call statistics, if enabled
+     *
+     * @param error  GError * from the call; nullptr if it succeeded
+     */
+    void RecordCompleted(const GError *error) noexcept
+    {
+        if (!call_stats || 0 == start)
+        {
+            return;
+        }
+        try
+        {
+            call_stats->Record(object_path,
+                               stats_interface,
+                               stats_method,
+                               g_get_monotonic_time() - start,
+                               error);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "** ERROR ** Proxy::Client call statistics for '"
+                      << method << "' failed: " << e.what() << std::endl;
+        }
+    }
+
+
+    /**
+     *  Cancel this call when another cancellation token is cancelled.
+     *  Each call has its own GCancellable, which makes it possible to
+     *  cancel the call from several sources without affecting other
+     *  calls sharing one of them.
+     *
+     * @param source  GCancellable * to follow
+     */
+    void Link(GCancellable *source) noexcept
+    {
+        gulong id = g_cancellable_connect(source,
+                                          G_CALLBACK(cancel_linked),
+                                          cancellable,
+                                          nullptr);
+        links.emplace_back(G_CANCELLABLE(g_object_ref(source)), id);
+    }
+
+
+    /**
+     *  Process the result of the D-Bus call and pass it on to the
+     *  callback function provided by the caller.
+     *
+     * @param response  GVariant * with the D-Bus method response, may be
+     *                  nullptr on errors
+     * @param fdlist    GUnixFDList * with file descriptors sent by the
+     *                  service, may be nullptr
+     * @param error     GError * with error details, may be nullptr
+     */
+    void Complete(GVariant *response, GUnixFDList *fdlist, GError *error) noexcept
+    {
+        GVariant *result = nullptr;
+        int fd = -1;
+        std::exception_ptr excp = nullptr;
+
+        try
+        {
+            if (!response || error)
+            {
+                if (response)
+                {
+                    g_variant_unref(response);
+                }
+                GDBUSPP_LOG("Proxy::Client async call result ("
+                            << "'" << destination << "', "
+                            << "'" << object_path << "', "
+                            << "'" << interface << "', "
+                            << "'" << method << "'"
+                            << ") ERROR:"
+                            << (error ? error->message : "(n/a)"));
+                std::string err = (!error ? "Failed calling D-Bus method '" + method + "'" : "");
+                throw DBus::Proxy::Exception(destination,
+                                             object_path,
+                                             interface,
+                                             error_details,
+                                             err,
+                                             error);
+            }
+
+            switch (type)
+            {
+            case Type::PROPERTY_GET:
+                {
+                    // Property results are wrapped into a "variant" type,
+                    // which needs to be unpacked
+                    GVariant *child = g_variant_get_child_value(response, 0);
+                    result = g_variant_get_variant(child);
+                    g_variant_unref(child);
+                    g_variant_unref(response);
+                }
+                break;
+
+            case Type::PROPERTY_SET:
+                g_variant_unref(response);
+                break;
+
+            case Type::GET_FD:
+                result = response;
+                if (fdlist)
+                {
+                    GError *fderr = nullptr;
+                    fd = g_unix_fd_list_get(fdlist, 0, &fderr);
+                    if (fd < 0 || fderr)
+                    {
+                        g_variant_unref(result);
+                        result = nullptr;
+                        throw DBus::Proxy::Exception(destination,
+                                                     object_path,
+                                                     interface,
+                                                     error_details,
+                                                     "Error retrieving file descriptor from '"
+                                                         + method + "'",
+                                                     fderr);
+                    }
+                }
+                break;
+
+            default:
+                result = response;
+                break;
+            }
+        }
+        catch (const DBus::Proxy::Exception &)
+        {
+            excp = std::current_exception();
+        }
+        if (fdlist)
+        {
+            glib2::Utils::unref_fdlist(fdlist);
+        }
+
+        try
+        {
+            if (fd_callback)
+            {
+                fd_callback(result, fd, excp);
+            }
+            else if (callback)
+            {
+                callback(result, excp);
+            }
+            else if (result)
+            {
+                g_variant_unref(result);
+            }
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "** ERROR ** Proxy::Client async callback for '"
+                      << method << "' failed: " << e.what() << std::endl;
+        }
+    }
+
+
+    const Type type;
+    GDBusConnection *connection = nullptr;
+    const std::string destination;
+    const Object::Path object_path;
+    const std::string interface;
+    const std::string method;
+    const std::string error_details;
+    GVariant *params = nullptr;
+    int send_fd = -1;
+    int timeout = DBUS_PROXY_CALL_TIMEOUT;
+    GCancellable *cancellable = nullptr;
+    Client::AsyncCallback callback = nullptr;
+    Client::AsyncFDCallback fd_callback = nullptr;
+    AsyncWorker *worker = nullptr;
+
+  private:
+    std::vector<std::pair<GCancellable *, gulong>> links{};
+    DBus::Proxy::CallStats::Ptr call_stats = nullptr;
+    std::string stats_interface{};
+    std::string stats_method{};
+    int64_t start = 0; ///< Monotonic time the call started, see Started()
+
+    static void cancel_linked(GCancellable *source, gpointer data)
+    {
+        g_cancellable_cancel(G_CANCELLABLE(data));
+    }
+};
+
+
+
+/**
+ *  Runs a dedicated glib2 main context in a separate thread which is
+ *  used to start all asynchronous D-Bus calls for a Client and to
+ *  deliver their results.  This way the caller does not need to run
+ *  its own main loop to make use of the asynchronous calls.
+ *
+ *  The worker thread is only started when the first call is queued.
+ */
+class AsyncWorker : public std::enable_shared_from_this<AsyncWorker>
+{
+  public:
+    AsyncWorker()
+        : context(g_main_context_new()),
+          loop(g_main_loop_new(context, false)),
+          cancellable(g_cancellable_new())
+    {
+    }
+
+    ~AsyncWorker() noexcept
+    {
+        g_object_unref(cancellable);
+        g_main_loop_unref(loop);
+        g_main_context_unref(context);
+    }
+
+
+    /**
+     *  Queue a new asynchronous call.  The AsyncWorker takes over the
+     *  ownership of the AsyncCall object.
+     *
+     * @param call  AsyncCall * to start
+     */
+    void Queue(AsyncCall *call)
+    {
+        {
+            std::lock_guard<std::mutex> lg(mtx);
+            if (stopped)
+            {
+                delete call;
+                throw DBus::Proxy::Exception("The asynchronous call worker has been stopped");
+            }
+            if (!thread.joinable())
+            {
+                // The thread keeps a reference to this object, to ensure
+                // it is valid until the thread has completed.
+                auto self = shared_from_this();
+                thread = std::thread([self]()
+                                     { self->run(); });
+            }
+        }
+        call->worker = this;
+        call->Link(cancellable);
+        ++pending;
+        g_main_context_invoke(context, start_call, call);
+    }
+
+
+    /**
+     *  Cancel all pending calls and stop the worker thread.  The
+     *  callbacks of the cancelled calls are still called, with an error.
+     */
+    void Stop() noexcept
+    {
+        {
+            std::lock_guard<std::mutex> lg(mtx);
+            if (stopped)
+            {
+                return;
+            }
+            stopped = true;
+        }
+        if (!thread.joinable())
+        {
+            return;
+        }
+        g_cancellable_cancel(cancellable);
+        g_main_context_invoke(context, quit_loop, loop);
+        if (std::this_thread::get_id() == thread.get_id())
+        {
+            // Called from a callback within the worker thread itself
+            thread.detach();
+        }
+        else
+        {
+            thread.join();
+        }
+    }
+
+
+  private:
+    GMainContext *context = nullptr;
+    GMainLoop *loop = nullptr;
+    GCancellable *cancellable = nullptr;
+    std::mutex mtx{};
+    std::thread thread{};
+    std::atomic<unsigned int> pending{0};
+    bool stopped = false;
+
+
+    void run()
+    {
+        g_main_context_push_thread_default(context);
+        g_main_loop_run(loop);
+
+        // Ensure all the cancelled calls have been completed
+        while (pending > 0)
+        {
+            g_main_context_iteration(context, true);
+        }
+        g_main_context_pop_thread_default(context);
+    }
+
+
+    static gboolean quit_loop(gpointer loop)
+    {
+        g_main_loop_quit(static_cast<GMainLoop *>(loop));
+        return G_SOURCE_REMOVE;
+    }
+
+
+    static gboolean start_call(gpointer data)
+    {
+        auto call = static_cast<AsyncCall *>(data);
+        call->Started();
+        if (call->timeout <= 0)
+        {
+            call_completed(call,
+                           nullptr,
+                           nullptr,
+                           g_error_new_literal(G_IO_ERROR,
+                                               G_IO_ERROR_TIMED_OUT,
+                                               "Call deadline exceeded"));
+            return G_SOURCE_REMOVE;
+        }
+
+        switch (call->type)
+        {
+        case AsyncCall::Type::GET_FD:
+        case AsyncCall::Type::SEND_FD:
+            {
+                GUnixFDList *fdlist = nullptr;
+                if (call->send_fd >= 0)
+                {
+                    GError *error = nullptr;
+                    fdlist = g_unix_fd_list_new();
+                    if (g_unix_fd_list_append(fdlist, call->send_fd, &error) < 0)
+                    {
+                        glib2::Utils::unref_fdlist(fdlist);
+                        call_completed(call, nullptr, nullptr, error);
+                        return G_SOURCE_REMOVE;
+                    }
+                }
+                g_dbus_connection_call_with_unix_fd_list(call->connection,
+                                                         (call->destination.empty() ? nullptr : call->destination.c_str()),
+                                                         call->object_path.c_str(),
+                                                         call->interface.c_str(),
+                                                         call->method.c_str(),
+                                                         call->params,
+                                                         nullptr, // reply type, not checked
+                                                         G_DBUS_CALL_FLAGS_NONE,
+                                                         call->timeout,
+                                                         fdlist,
+                                                         call->cancellable,
+                                                         (GAsyncReadyCallback)fd_call_result,
+                                                         call);
+                if (fdlist)
+                {
+                    glib2::Utils::unref_fdlist(fdlist);
+                }
+            }
+            break;
+
+        default:
+            g_dbus_connection_call(call->connection,
+                                   (call->destination.empty() ? nullptr : call->destination.c_str()),
+                                   call->object_path.c_str(),
+                                   call->interface.c_str(),
+                                   call->method.c_str(),
+                                   call->params,
+                                   nullptr, // reply type, not checked
+                                   G_DBUS_CALL_FLAGS_NONE,
+                                   call->timeout,
+                                   call->cancellable,
+                                   (GAsyncReadyCallback)call_result,
+                                   call);
+            break;
+        }
+        return G_SOURCE_REMOVE;
+    }
+
+
+    static void call_result(GDBusConnection *conn, GAsyncResult *res, gpointer data)
+    {
+        GError *error = nullptr;
+        GVariant *ret = g_dbus_connection_call_finish(conn, res, &error);
+        call_completed(static_cast<AsyncCall *>(data), ret, nullptr, error);
+    }
+
+
+    static void fd_call_result(GDBusConnection *conn, GAsyncResult *res, gpointer data)
+    {
+        GError *error = nullptr;
+        GUnixFDList *fdlist = nullptr;
+        GVariant *ret = g_dbus_connection_call_with_unix_fd_list_finish(conn,
+                                                                        &fdlist,
+                                                                        res,
+                                                                        &error);
+        call_completed(static_cast<AsyncCall *>(data), ret, fdlist, error);
+    }
+
+
+    static void call_completed(AsyncCall *call,
+                               GVariant *response,
+                               GUnixFDList *fdlist,
+                               GError *error)
+    {
+        AsyncWorker *worker = call->worker;
+        call->RecordCompleted(error);
+        call->Complete(response, fdlist, error);
+        delete call;
+        --worker->pending;
+    }
+};
+
+
+
+/**
+ *  Lets concurrent identical read-only requests share a single D-Bus
+ *  call.  The first caller does the call; callers arriving with the same
+ *  request while it is in progress wait for it and receive the same
+ *  result, each with their own GVariant reference.
+ *
+ *  Requests in progress when @Invalidate() is called are not shared with
+ *  later callers, as their result may predate a modification.
+ */
+class SingleFlight
+{
+  public:
+    SingleFlight() = default;
+
+    /**
+     *  Run a request, or wait for an identical request already in progress
+     *
+     * @param key  std::string identifying the request
+     * @param fn   Function doing the request if none is in progress.
+     *             Exceptions thrown are passed on to all waiting callers.
+     *
+     * @return GVariant* owned by the caller, may be nullptr
+     */
+    GVariant *Run(const std::string &key, std::function<GVariant *()> fn)
+    {
+        std::promise<Result> leader{};
+        uint64_t started = 0;
+        {
+            std::unique_lock<std::mutex> lg(mtx);
+            auto it = in_flight.find(key);
+            if (in_flight.end() != it && generation == it->second.generation)
+            {
+                std::shared_future<Result> waiting = it->second.result;
+                lg.unlock();
+                return take_ref(waiting.get());
+            }
+            // A request started before the last modification is left to
+            // its current waiters; this caller starts a new one
+            started = generation;
+            in_flight[key] = {started, leader.get_future().share()};
+        }
+
+        Result result = nullptr;
+        try
+        {
+            GVariant *ret = fn();
+            if (ret)
+            {
+                result = Result(ret, g_variant_unref);
+            }
+        }
+        catch (...)
+        {
+            complete(key, started);
+            leader.set_exception(std::current_exception());
+            throw;
+        }
+        complete(key, started);
+        leader.set_value(result);
+        return take_ref(result);
+    }
+
+    /**
+     *  Run a D-Bus method call, or wait for an identical one in progress.
+     *  The call is identified by the object path, interface, method and
+     *  the method arguments.
+     *
+     * @param object_path  DBus::Object::Path of the object to call
+     * @param interface    std::string with the interface in the object
+     * @param method       std::string with the D-Bus method to call
+     * @param params       GVariant * with the method arguments, may be
+     *                     nullptr.  A floating reference is consumed.
+     * @param fn           Function doing the D-Bus call with the given
+     *                     arguments
+     *
+     * @return GVariant* owned by the caller
+     */
+    GVariant *Call(const Object::Path &object_path,
+                   const std::string &interface,
+                   const std::string &method,
+                   GVariant *params,
+                   std::function<GVariant *(GVariant *)> fn)
+    {
+        std::string key = object_path + '\0' + interface + '\0' + method + '\0';
+        if (params)
+        {
+            g_variant_ref_sink(params);
+            key += g_variant_get_type_string(params);
+            key += '\0';
+            key.append(static_cast<const char *>(g_variant_get_data(params)),
+                       g_variant_get_size(params));
+        }
+
+        GVariant *ret = nullptr;
+        try
+        {
+            ret = Run(key,
+                      [&fn, params]()
+                      {
+                          return fn(params);
+                      });
+        }
+        catch (...)
+        {
+            if (params)
+            {
+                g_variant_unref(params);
+            }
+            throw;
+        }
+        if (params)
+        {
+            g_variant_unref(params);
+        }
+        return ret;
+    }
+
+    /**
+     *  Stop sharing the requests in progress with new callers.  Called
+     *  when a modification is sent, so a request done after it never
+     *  receives a result read before it.
+     */
+    void Invalidate() noexcept
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        ++generation;
+    }
+
+    void SetIdempotent(const std::string &interface,
+                       const std::string &method,
+                       const bool idempotent)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        if (idempotent)
+        {
+            idempotent_methods.insert(interface + '\0' + method);
+        }
+        else
+        {
+            idempotent_methods.erase(interface + '\0' + method);
+        }
+    }
+
+    bool IsIdempotent(const std::string &interface, const std::string &method) const
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        return idempotent_methods.find(interface + '\0' + method)
+               != idempotent_methods.end();
+    }
+
+
+  private:
+    /// Shared result of a request; releases the GVariant with the last user
+    using Result = std::shared_ptr<GVariant>;
+
+    /// A request in progress and the generation it was started in
+    struct InFlight
+    {
+        uint64_t generation;
+        std::shared_future<Result> result;
+    };
+
+    mutable std::mutex mtx{};
+
+    /// Incremented by Invalidate()
+    uint64_t generation = 0;
+
+    /// Requests in progress, the key is provided by the caller of Run()
+    std::map<std::string, InFlight> in_flight{};
+
+    /// Methods which may be shared, as interface + "\0" + method
+    std::set<std::string> idempotent_methods{};
+
+    void complete(const std::string &key, const uint64_t started)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        auto it = in_flight.find(key);
+        if (in_flight.end() != it && started == it->second.generation)
+        {
+            in_flight.erase(it);
+        }
+    }
+
+    static GVariant *take_ref(const Result &result) noexcept
+    {
+        return (result ? g_variant_ref(result.get()) : nullptr);
+    }
+};
+
+} // namespace _private
+
+
+
+TargetPreset::TargetPreset(const Object::Path &object_path_,
+                           const std::string &interface_)
+    : object_path(object_path_), interface(interface_)
+{
+}
+
+
+
+CallOptions::CallOptions(const std::chrono::milliseconds timeout_)
+    : cancellable(g_cancellable_new()), timeout(timeout_)
+{
+}
+
+
+CallOptions::~CallOptions() noexcept
+{
+    g_object_unref(cancellable);
+}
+
+
+void CallOptions::SetTimeout(const std::chrono::milliseconds tmout) noexcept
+{
+    timeout = tmout;
+}
+
+
+void CallOptions::SetDeadline(const std::chrono::steady_clock::time_point dl) noexcept
+{
+    deadline = dl;
+    has_deadline = true;
+}
+
+
+int CallOptions::GetTimeout(const int default_timeout) const noexcept
+{
+    using namespace std::chrono;
+
+    int64_t ret = (timeout > milliseconds::zero() ? timeout.count() : default_timeout);
+    if (has_deadline)
+    {
+        auto remaining = duration_cast<milliseconds>(deadline - steady_clock::now());
+        if (remaining <= milliseconds::zero())
+        {
+            return 0;
+        }
+        if (remaining.count() < ret || timeout <= milliseconds::zero())
+        {
+            ret = remaining.count();
+        }
+    }
+    return static_cast<int>(std::min<int64_t>(ret, G_MAXINT));
+}
+
+
+void CallOptions::Cancel() noexcept
+{
+    g_cancellable_cancel(cancellable);
+}
+
+
+bool CallOptions::IsCancelled() const noexcept
+{
+    return g_cancellable_is_cancelled(cancellable);
+}
+
+
+GCancellable *CallOptions::GetCancellable() const noexcept
+{
+    return cancellable;
+}
+
+
+
+Client::Client(Connection::Ptr conn, const std::string &dest, uint8_t timeout)
+    : connection(conn), destination(dest),
+      proxy_cache(std::make_shared<_private::ProxyCache>(conn,
+                                                         dest,
+                                                         DBUS_PROXY_CACHE_SIZE)),
+      single_flight(std::make_shared<_private::SingleFlight>())
+{
+    if ("org.freedesktop.DBus" != dest && BusType::PEER != conn->GetBusType())
+    {
+        // Don't do this if querying org.freedesktop.DBus.
+        // First, this need to be running anyhow - and it would
+        // result in a recursion, since DBusServiceQuery uses this Client
+        // implementation.  Peer-to-peer connections have no bus daemon
+        // to query.
+        auto srvqry = Proxy::Utils::DBusServiceQuery::Create(connection);
+        if (!srvqry->CheckServiceAvail(destination, timeout))
+        {
+            throw DBus::Proxy::Exception("Service '"
+                                         + destination
+                                         + "' cannot be reached");
+        }
+    }
+}
+
+
+Client::~Client() noexcept
+{
+    std::lock_guard<std::mutex> lg(async_worker_mtx);
+    if (async_worker)
+    {
+        async_worker->Stop();
+    }
+}
+
+
+std::shared_ptr<_private::AsyncWorker> Client::get_async_worker() const
+{
+    std::lock_guard<std::mutex> lg(async_worker_mtx);
+    if (!async_worker)
+    {
+        async_worker = std::make_shared<_private::AsyncWorker>();
+    }
+    return async_worker;
+}
+
+
+
+PooledClient::PooledClient(Connection::Pool::Ptr pool_,
+                           const std::string &destination,
+                           uint8_t timeout)
+    : pool(pool_)
+{
+    if (!pool)
+    {
+        throw DBus::Proxy::Exception("No connection pool provided");
+    }
+    for (size_t i = 0; i < pool->Size(); ++i)
+    {
+        clients.push_back(Client::Create(pool->Get(i), destination, timeout));
+    }
+}
+
+
+Client::Ptr PooledClient::Get() const noexcept
+{
+    return clients[pool->Shard()];
+}
+
+
+const std::string &Client::GetDestination() const noexcept
+{
+    return destination;
+}
+
+
+Connection::Ptr Client::GetConnection() const noexcept
+{
+    return connection;
+}
+
+
+void Client::SetProxyCacheSize(const size_t size)
+{
+    proxy_cache->SetMaxSize(size);
+}
+
+
+void Client::ClearProxyCache() noexcept
+{
+    proxy_cache->Clear();
+}
+
+
+void Client::EnableCallStats(const bool enable)
+{
+    std::atomic_store(&call_stats, (enable ? CallStats::Create() : nullptr));
+}
+
+
+void Client::EnableSingleFlight(const bool enable) noexcept
+{
+    single_flight_enabled = enable;
+}
+
+
+void Client::SetIdempotent(const std::string &interface,
+                           const std::string &method,
+                           const bool idempotent)
+{
+    single_flight->SetIdempotent(interface, method, idempotent);
+}
+
+
+CallStats::Snapshot Client::GetCallStats() const
+{
+    auto stats = std::atomic_load(&call_stats);
+    return (stats ? stats->GetSnapshot() : CallStats::Snapshot{});
+}
+
+
+void Client::ResetCallStats() noexcept
+{
+    auto stats = std::atomic_load(&call_stats);
+    if (stats)
+    {
+        stats->Reset();
+    }
+}
+
+
+
+//
+//  DBus::Proxy::CallStats
+//
+
+void CallStats::Record(const Object::Path &path,
+                       const std::string &interface,
+                       const std::string &method,
+                       const int64_t usec,
+                       const GError *error)
+{
+    Key key{path, interface, method};
+    Counters *cnt = nullptr;
+    {
+        std::shared_lock<std::shared_mutex> lg(mtx);
+        auto it = counters.find(key);
+        if (counters.end() != it)
+        {
+            cnt = it->second.get();
+        }
+    }
+    if (!cnt)
+    {
+        std::unique_lock<std::shared_mutex> lg(mtx);
+        auto &c = counters[key];
+        if (!c)
+        {
+            c = std::make_unique<Counters>();
+        }
+        cnt = c.get();
+    }
+
+    // The counters are never removed from the map, so they can be
+    // updated without holding the lock
+    cnt->calls.fetch_add(1, std::memory_order_relaxed);
+    cnt->latency.Record(usec);
+    if (error)
+    {
+        cnt->errors.fetch_add(1, std::memory_order_relaxed);
+        if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT))
+        {
+            cnt->timeouts.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+
+CallStats::Snapshot CallStats::GetSnapshot() const
+{
+    std::shared_lock<std::shared_mutex> lg(mtx);
+    Snapshot snap;
+    snap.reserve(counters.size());
+    for (const auto &[key, cnt] : counters)
+    {
+        Entry e;
+        e.path = std::get<0>(key);
+        e.interface = std::get<1>(key);
+        e.method = std::get<2>(key);
+        e.calls = cnt->calls.load(std::memory_order_relaxed);
+        e.errors = cnt->errors.load(std::memory_order_relaxed);
+        e.timeouts = cnt->timeouts.load(std::memory_order_relaxed);
+        e.latency = cnt->latency.GetSnapshot();
+        snap.push_back(std::move(e));
+    }
+    return snap;
+}
+
+
+void CallStats::Reset() noexcept
+{
+    std::shared_lock<std::shared_mutex> lg(mtx);
+    for (auto &[key, cnt] : counters)
+    {
+        cnt->calls = 0;
+        cnt->errors = 0;
+        cnt->timeouts = 0;
+        cnt->latency.Reset();
+    }
+}
+
+
+GVariant *Client::Call(const Object::Path &object_path,
+                       const std::string &interface,
+                       const std::string &method,
+                       GVariant *params,
+                       const bool no_response,
+                       const CallOptions::Ptr options) const
+{
+    // Calls with their own timeout or cancellation token are never
+    // shared, as these settings would then apply to the other callers
+    if (!no_response && !options && single_flight_enabled
+        && single_flight->IsIdempotent(interface, method))
+    {
+        return single_flight->Call(object_path,
+                                   interface,
+                                   method,
+                                   params,
+                                   [&](GVariant *args)
+                                   {
+                                       glib2::Proxy prx(proxy_cache->Open(object_path,
+                                                                          interface,
+                                                                          method,
+                                                                          nullptr));
+                                       prx.RecordStats(std::atomic_load(&call_stats));
+                                       return prx.Call(method, args, false);
+                                   });
+    }
+
+    glib2::Proxy prx(proxy_cache->Open(object_path,
+                                       interface,
+                                       method,
+                                       options));
+    prx.RecordStats(std::atomic_load(&call_stats));
+    return prx.Call(method, params, no_response);
+}
+
+
+GVariant *Client::Call(const TargetPreset::Ptr preset,
+                       const std::string &method,
+                       GVariant *params,
+                       const bool no_response,
+                       const CallOptions::Ptr options) const
+{
+    return Call(preset->object_path,
+                preset->interface,
+                method,
+                params,
+                no_response,
+                options);
+}
+
+
+GVariant *Client::GetFD(int &fd,
+                        const TargetPreset::Ptr preset,
+                        const std::string &method,
+                        GVariant *params,
+                        const CallOptions::Ptr options) const
+{
+    glib2::Proxy prx(proxy_cache->Open(preset->object_path,
+                                       preset->interface,
+                                       method,
+                                       options));
+    prx.RecordStats(std::atomic_load(&call_stats));
+    return prx.CallGetFD(&fd, method, params);
+}
+
+
+GVariant *Client::SendFD(const TargetPreset::Ptr preset,
+                         const std::string &method,
                          GVariant *params,
-                         int &fd) const
+                         int &fd,
+                         const CallOptions::Ptr options) const
 {
-    glib2::Proxy prx(connection,
-                     destination,
-                     preset->object_path,
-                     preset->interface,
-                     method);
+    glib2::Proxy prx(proxy_cache->Open(preset->object_path,
+                                       preset->interface,
+                                       method,
+                                       options));
+    prx.RecordStats(std::atomic_load(&call_stats));
     return prx.CallSendFD(method, params, fd);
 }
 
 
+GVariant *Client::CallWithFDs(const TargetPreset::Ptr preset,
+                              const std::string &method,
+                              GVariant *params,
+                              const std::vector<int> &send_fds,
+                              std::vector<int> &recv_fds,
+                              const CallOptions::Ptr options) const
+{
+    glib2::Proxy prx(proxy_cache->Open(preset->object_path,
+                                       preset->interface,
+                                       method,
+                                       options));
+    prx.RecordStats(std::atomic_load(&call_stats));
+    return prx.CallWithFDs(method, params, send_fds, recv_fds);
+}
+
+
+GVariant *Client::SendPayload(const TargetPreset::Ptr preset,
+                              const std::string &method,
+                              const void *data,
+                              const size_t size,
+                              const CallOptions::Ptr options,
+                              const size_t threshold) const
+{
+    // Without file descriptor passing, the payload can only go inline
+    const bool fd_capable = (g_dbus_connection_get_capabilities(connection->ConnPtr())
+                             & G_DBUS_CAPABILITY_FLAGS_UNIX_FD_PASSING);
+    int fd = -1;
+    GVariant *params = Payload::Prepare(data,
+                                        size,
+                                        fd,
+                                        (fd_capable ? threshold : SIZE_MAX));
+    if (fd < 0)
+    {
+        return Call(preset, method, params, false, options);
+    }
+
+    try
+    {
+        GVariant *ret = SendFD(preset, method, params, fd, options);
+        close(fd);
+        return ret;
+    }
+    catch (...)
+    {
+        close(fd);
+        throw;
+    }
+}
+
+
+Payload::Ptr Client::GetPayload(const TargetPreset::Ptr preset,
+                                const std::string &method,
+                                GVariant *params,
+                                const CallOptions::Ptr options) const
+{
+    std::vector<int> recv_fds;
+    GVariant *response = CallWithFDs(preset, method, params, {}, recv_fds, options);
+    try
+    {
+        Payload::Ptr payload = Payload::Parse(response,
+                                              (!recv_fds.empty() ? recv_fds[0] : -1));
+        for (int fd : recv_fds)
+        {
+            close(fd);
+        }
+        g_variant_unref(response);
+        return payload;
+    }
+    catch (...)
+    {
+        for (int fd : recv_fds)
+        {
+            close(fd);
+        }
+        g_variant_unref(response);
+        throw;
+    }
+}
+
+
+void Client::CallAsync(const Object::Path &object_path,
+                       const std::string &interface,
+                       const std::string &method,
+                       GVariant *params,
+                       AsyncCallback callback,
+                       const CallOptions::Ptr options) const
+{
+    auto call = new _private::AsyncCall(_private::AsyncCall::Type::METHOD,
+                                        connection->ConnPtr(),
+                                        destination,
+                                        object_path,
+                                        interface,
+                                        method,
+                                        params,
+                                        method);
+    call->SetOptions(options);
+    call->RecordStats(std::atomic_load(&call_stats), interface, method);
+    call->callback = std::move(callback);
+    get_async_worker()->Queue(call);
+}
+
+
+void Client::CallAsync(const TargetPreset::Ptr preset,
+                       const std::string &method,
+                       GVariant *params,
+                       AsyncCallback callback,
+                       const CallOptions::Ptr options) const
+{
+    CallAsync(preset->object_path,
+              preset->interface,
+              method,
+              params,
+              std::move(callback),
+              options);
+}
+
+
+std::future<GVariant *> Client::CallAsync(const Object::Path &object_path,
+                                          const std::string &interface,
+                                          const std::string &method,
+                                          GVariant *params,
+                                          const CallOptions::Ptr options) const
+{
+    auto result = std::make_shared<std::promise<GVariant *>>();
+    CallAsync(object_path,
+              interface,
+              method,
+              params,
+              [result](GVariant *response, std::exception_ptr error)
+              {
+                  if (error)
+                  {
+                      result->set_exception(error);
+                  }
+                  else
+                  {
+                      result->set_value(response);
+                  }
+              },
+              options);
+    return result->get_future();
+}
+
+
+std::future<GVariant *> Client::CallAsync(const TargetPreset::Ptr preset,
+                                          const std::string &method,
+                                          GVariant *params,
+                                          const CallOptions::Ptr options) const
+{
+    return CallAsync(preset->object_path, preset->interface, method, params, options);
+}
+
+
+std::vector<Client::BatchResult> Client::CallBatch(const std::vector<BatchCall> &calls,
+                                                 const CallOptions::Ptr options) const
+{
+    std::vector<std::future<GVariant *>> pending;
+    std::vector<BatchResult> results(calls.size(), BatchResult{nullptr, nullptr});
+
+    // Queue all the calls first, then collect the results
+    pending.reserve(calls.size());
+    for (size_t i = 0; i < calls.size(); ++i)
+    {
+        try
+        {
+            pending.push_back(CallAsync(calls[i].preset,
+                                        calls[i].method,
+                                        calls[i].params,
+                                        options));
+        }
+        catch (const DBus::Proxy::Exception &)
+        {
+            results[i].error = std::current_exception();
+            pending.push_back(std::future<GVariant *>{});
+        }
+    }
+
+    for (size_t i = 0; i < calls.size(); ++i)
+    {
+        if (!pending[i].valid())
+        {
+            continue;
+        }
+        try
+        {
+            results[i].response = pending[i].get();
+        }
+        catch (const DBus::Proxy::Exception &)
+        {
+            results[i].error = std::current_exception();
+        }
+    }
+    return results;
+}
+
+
+std::vector<Client::BatchResult> Client::ExecuteBatch(const std::vector<BatchCall> &calls,
+                                                    const Object::Path &batch_path,
+                                                    const CallOptions::Ptr options) const
+{
+    glib2::Builder::Scoped bld("a(ossv)");
+    for (const auto &call : calls)
+    {
+        bld.AddFormatted("(ossv)",
+                         call.preset->object_path.c_str(),
+                         call.preset->interface.c_str(),
+                         call.method.c_str(),
+                         (call.params ? call.params : g_variant_new("()")));
+    }
+    GVariant *res = Call(batch_path,
+                         "net.openvpn.gdbuspp.Batch",
+                         "Execute",
+                         bld.FinishWrapped(),
+                         false,
+                         options);
+
+    std::vector<BatchResult> results;
+    results.reserve(calls.size());
+
+    GVariantIter *iter = nullptr;
+    g_variant_get(res, "(a(ssv))", &iter);
+    const gchar *error_domain = nullptr;
+    const gchar *error = nullptr;
+    GVariant *response = nullptr;
+    while (results.size() < calls.size()
+           && g_variant_iter_next(iter, "(&s&sv)", &error_domain, &error, &response))
+    {
+        const BatchCall &call = calls[results.size()];
+        if ('\0' == error_domain[0])
+        {
+            results.push_back(BatchResult{response, nullptr});
+            continue;
+        }
+        g_variant_unref(response);
+
+        // Same formatting as errors received from the service directly
+        const std::string errmsg = std::string("GDBus.Error:") + error_domain + ": " + error;
+        results.push_back(BatchResult{
+            nullptr,
+            std::make_exception_ptr(DBus::Proxy::Exception(destination,
+                                                           call.preset->object_path,
+                                                           call.preset->interface,
+                                                           call.method,
+                                                           errmsg))});
+    }
+    g_variant_iter_free(iter);
+    g_variant_unref(res);
+
+    if (results.size() != calls.size())
+    {
+        for (auto &r : results)
+        {
+            if (r.response)
+            {
+                g_variant_unref(r.response);
+            }
+        }
+        throw DBus::Proxy::Exception(destination,
+                                     batch_path,
+                                     "net.openvpn.gdbuspp.Batch",
+                                     "Execute",
+                                     "Incomplete batch response");
+    }
+    return results;
+}
+
+
+void Client::SendFDAsync(const TargetPreset::Ptr preset,
+                         const std::string &method,
+                         GVariant *params,
+                         int fd,
+                         AsyncCallback callback,
+                         const CallOptions::Ptr options) const
+{
+    if (!(g_dbus_connection_get_capabilities(connection->ConnPtr()) & G_DBUS_CAPABILITY_FLAGS_UNIX_FD_PASSING))
+    {
+        throw DBus::Proxy::Exception(destination,
+                                     preset->object_path,
+                                     preset->interface,
+                                     method,
+                                     "D-Bus connection does not support file descriptor passing");
+    }
+
+    auto call = new _private::AsyncCall(_private::AsyncCall::Type::SEND_FD,
+                                        connection->ConnPtr(),
+                                        destination,
+                                        preset->object_path,
+                                        preset->interface,
+                                        method,
+                                        params,
+                                        method);
+    int dupfd = dup(fd);
+    if (dupfd < 0)
+    {
+        delete call;
+        throw DBus::Proxy::Exception(destination,
+                                     preset->object_path,
+                                     preset->interface,
+                                     method,
+                                     "Failed preparing file descriptor for '"
+                                         + method + "'");
+    }
+    call->send_fd = dupfd;
+    call->SetOptions(options);
+    call->RecordStats(std::atomic_load(&call_stats), preset->interface, method);
+    call->callback = std::move(callback);
+    get_async_worker()->Queue(call);
+}
+
+
+void Client::GetFDAsync(const TargetPreset::Ptr preset,
+                        const std::string &method,
+                        GVariant *params,
+                        AsyncFDCallback callback,
+                        const CallOptions::Ptr options) const
+{
+    if (!(g_dbus_connection_get_capabilities(connection->ConnPtr()) & G_DBUS_CAPABILITY_FLAGS_UNIX_FD_PASSING))
+    {
+        throw DBus::Proxy::Exception(destination,
+                                     preset->object_path,
+                                     preset->interface,
+                                     method,
+                                     "D-Bus connection does not support file descriptor passing");
+    }
+
+    auto call = new _private::AsyncCall(_private::AsyncCall::Type::GET_FD,
+                                        connection->ConnPtr(),
+                                        destination,
+                                        preset->object_path,
+                                        preset->interface,
+                                        method,
+                                        params,
+                                        method);
+    call->SetOptions(options);
+    call->RecordStats(std::atomic_load(&call_stats), preset->interface, method);
+    call->fd_callback = std::move(callback);
+    get_async_worker()->Queue(call);
+}
+
+
 GVariant *Client::GetPropertyGVariant(const Object::Path &object_path,
                                       const std::string &interface,
-                                      const std::string &property_name) const
+                                      const std::string &property_name,
+                                      const CallOptions::Ptr options) const
+{
+    if (!options && single_flight_enabled)
+    {
+        return single_flight->Run(std::string("Get") + '\0' + object_path + '\0'
+                                      + interface + '\0' + property_name,
+                                  [&]()
+                                  {
+                                      return get_property(object_path, interface, property_name, nullptr);
+                                  });
+    }
+    return get_property(object_path, interface, property_name, options);
+}
+
+
+GVariant *Client::get_property(const Object::Path &object_path,
+                               const std::string &interface,
+                               const std::string &property_name,
+                               const CallOptions::Ptr options) const
 {
-    glib2::Proxy prx(connection,
-                     destination,
-                     object_path,
-                     "org.freedesktop.DBus.Properties",
-                     "Get(" + property_name + ")");
+    glib2::Proxy prx(proxy_cache->Open(object_path,
+                                       "org.freedesktop.DBus.Properties",
+                                       "Get(" + property_name + ")",
+                                       options));
+    auto stats = std::atomic_load(&call_stats);
+    if (stats)
+    {
+        prx.RecordStats(stats, interface, "Get(" + property_name + ")");
+    }
 
     // The Get method needs the property interface scope of the property
     // and the property name
@@ -600,22 +2518,60 @@ GVariant *Client::GetPropertyGVariant(const Object::Path &object_path,
 
 
 GVariant *Client::GetPropertyGVariant(const TargetPreset::Ptr preset,
-                                      const std::string &property_name) const
+                                      const std::string &property_name,
+                                      const CallOptions::Ptr options) const
+{
+    return GetPropertyGVariant(preset->object_path,
+                               preset->interface,
+                               property_name,
+                               options);
+}
+
+
+GVariant *Client::GetAllProperties(const Object::Path &object_path,
+                                   const std::string &interface,
+                                   const CallOptions::Ptr options) const
+{
+    glib2::Proxy prx(proxy_cache->Open(object_path,
+                                       "org.freedesktop.DBus.Properties",
+                                       "GetAll(" + interface + ")",
+                                       options));
+    prx.RecordStats(std::atomic_load(&call_stats), interface, "GetAll");
+
+    GVariant *resp = prx.Call("GetAll",
+                              g_variant_new("(s)", interface.c_str()),
+                              false);
+
+    // The response is wrapped into a tuple, (a{sv}); only the
+    // dictionary is returned
+    GVariant *ret = g_variant_get_child_value(resp, 0);
+    g_variant_unref(resp);
+    return ret;
+}
+
+
+GVariant *Client::GetAllProperties(const TargetPreset::Ptr preset,
+                                   const CallOptions::Ptr options) const
 {
-    return GetPropertyGVariant(preset->object_path, preset->interface, property_name);
+    return GetAllProperties(preset->object_path, preset->interface, options);
 }
 
 
 void Client::SetPropertyGVariant(const Object::Path &object_path,
                                  const std::string &interface,
                                  const std::string &property_name,
-                                 GVariant *value) const
+                                 GVariant *value,
+                                 const CallOptions::Ptr options) const
 {
-    glib2::Proxy prx(connection,
-                     destination,
-                     object_path,
-                     "org.freedesktop.DBus.Properties",
-                     "Set(" + property_name + ")");
+    glib2::Proxy prx(proxy_cache->Open(object_path,
+                                       "org.freedesktop.DBus.Properties",
+                                       "Set(" + property_name + ")",
+                                       options));
+    auto stats = std::atomic_load(&call_stats);
+    if (stats)
+    {
+        prx.RecordStats(stats, interface, "Set(" + property_name + ")");
+    }
 
     // The Set method needs the property interface scope of the property
     // and the property name
@@ -629,17 +2585,127 @@ void Client::SetPropertyGVariant(const Object::Path &object_path,
     // exiting will experience the property often not be modified at all.
     // Doing this synchronously ensures we wait until the request has been
     // processed by the service.
-    GVariant *r = prx.Call("Set", params, false);
+    //
+    // Property reads in progress are not shared with the reads done
+    // once the new value is set, also if the Set call failed
+    single_flight->Invalidate();
+    GVariant *r = nullptr;
+    try
+    {
+        r = prx.Call("Set", params, false);
+    }
+    catch (...)
+    {
+        single_flight->Invalidate();
+        throw;
+    }
+    single_flight->Invalidate();
     g_variant_unref(r);
 }
 
 
 void Client::SetPropertyGVariant(const TargetPreset::Ptr preset,
                                  const std::string &property_name,
-                                 GVariant *params) const
+                                 GVariant *params,
+                                 const CallOptions::Ptr options) const
+{
+    SetPropertyGVariant(preset->object_path,
+                        preset->interface,
+                        property_name,
+                        params,
+                        options);
+}
+
+void Client::GetPropertyGVariantAsync(const Object::Path &object_path,
+                                      const std::string &interface,
+                                      const std::string &property_name,
+                                      AsyncCallback callback,
+                                      const CallOptions::Ptr options) const
+{
+    const std::string details = "Get(" + property_name + ")";
+    auto call = new _private::AsyncCall(_private::AsyncCall::Type::PROPERTY_GET,
+                                        connection->ConnPtr(),
+                                        destination,
+                                        object_path,
+                                        "org.freedesktop.DBus.Properties",
+                                        "Get",
+                                        g_variant_new("(ss)",
+                                                      interface.c_str(),
+                                                      property_name.c_str()),
+                                        details);
+    call->SetOptions(options);
+    call->RecordStats(std::atomic_load(&call_stats), interface, details);
+    call->callback = std::move(callback);
+    get_async_worker()->Queue(call);
+}
+
+
+void Client::GetPropertyGVariantAsync(const TargetPreset::Ptr preset,
+                                      const std::string &property_name,
+                                      AsyncCallback callback,
+                                      const CallOptions::Ptr options) const
+{
+    GetPropertyGVariantAsync(preset->object_path,
+                             preset->interface,
+                             property_name,
+                             std::move(callback),
+                             options);
+}
+
+
+void Client::SetPropertyGVariantAsync(const Object::Path &object_path,
+                                      const std::string &interface,
+                                      const std::string &property_name,
+                                      GVariant *params,
+                                      AsyncCallback callback,
+                                      const CallOptions::Ptr options) const
+{
+    const std::string details = "Set(" + property_name + ")";
+    auto call = new _private::AsyncCall(_private::AsyncCall::Type::PROPERTY_SET,
+                                        connection->ConnPtr(),
+                                        destination,
+                                        object_path,
+                                        "org.freedesktop.DBus.Properties",
+                                        "Set",
+                                        g_variant_new("(ssv)",
+                                                      interface.c_str(),
+                                                      property_name.c_str(),
+                                                      params),
+                                        details);
+    call->SetOptions(options);
+    call->RecordStats(std::atomic_load(&call_stats), interface, details);
+    single_flight->Invalidate();
+    call->callback = [sf = single_flight, callback = std::move(callback)](GVariant *result,
+                                                                          std::exception_ptr error)
+    {
+        sf->Invalidate();
+        if (callback)
+        {
+            callback(result, error);
+        }
+        else if (result)
+        {
+            g_variant_unref(result);
+        }
+    };
+    get_async_worker()->Queue(call);
+}
+
+
+void Client::SetPropertyGVariantAsync(const TargetPreset::Ptr preset,
+                                      const std::string &property_name,
+                                      GVariant *params,
+                                      AsyncCallback callback,
+                                      const CallOptions::Ptr options) const
 {
-    SetPropertyGVariant(preset->object_path, preset->interface, property_name, params);
+    SetPropertyGVariantAsync(preset->object_path,
+                             preset->interface,
+                             property_name,
+                             params,
+                             std::move(callback),
+                             options);
 }
 
+
 } // namespace Proxy
 } // namespace DBus
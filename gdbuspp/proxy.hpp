@@ -16,19 +16,39 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <future>
 #include <iostream> // DEBUG: Remove with std::cout
+#include <map>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <tuple>
+#include <utility>
+#include <vector>
 #include <glib.h>
 
 #include "connection.hpp"
 #include "exceptions.hpp"
+#include "features/metrics.hpp"
 #include "glib2/utils.hpp"
 #include "object/path.hpp"
+#include "payload.hpp"
 
 
 namespace DBus {
 namespace Proxy {
 
+namespace _private {
+class ProxyCache;
+class AsyncWorker;
+class SingleFlight;
+} // namespace _private
+
+
 class Exception : public DBus::Exception
 {
   public:
@@ -89,6 +109,182 @@ class TargetPreset
 
 
 
+/**
+ *  Optional per-call settings for the @Proxy::Client methods.
+ *
+ *  This controls how long to wait for the D-Bus service to respond and
+ *  provides a cancellation token which can abort calls in progress.
+ *  The same CallOptions object may be used by several calls at the
+ *  same time; calling @Cancel() aborts all of them.  A cancelled
+ *  CallOptions object cannot be reused.
+ */
+class CallOptions
+{
+  public:
+    using Ptr = std::shared_ptr<CallOptions>;
+
+    /**
+     *  Prepare a new set of call options
+     *
+     * @param timeout  std::chrono::milliseconds with the maximum time to
+     *                 wait for each call to complete.  If not set, the
+     *                 default Proxy::Client call timeout is used.
+     *
+     * @return CallOptions::Ptr
+     */
+    [[nodiscard]] static Ptr Create(const std::chrono::milliseconds timeout = std::chrono::milliseconds::zero())
+    {
+        return Ptr(new CallOptions(timeout));
+    }
+
+    ~CallOptions() noexcept;
+
+    CallOptions(const CallOptions &) = delete;
+    CallOptions &operator=(const CallOptions &) = delete;
+
+    /**
+     *  Change the maximum time to wait for each call to complete
+     *
+     * @param timeout  std::chrono::milliseconds with the new timeout.
+     *                 If zero, the default call timeout is used.
+     */
+    void SetTimeout(const std::chrono::milliseconds timeout) noexcept;
+
+    /**
+     *  Set an absolute point in time where all calls using these options
+     *  must have completed.  Calls started after the deadline has passed
+     *  will fail instantly.  If a timeout is set as well, the shortest of
+     *  them applies.
+     *
+     * @param deadline  std::chrono::steady_clock::time_point of the deadline
+     */
+    void SetDeadline(const std::chrono::steady_clock::time_point deadline) noexcept;
+
+    /**
+     *  Calculate the timeout to give to the D-Bus call being started now
+     *
+     * @param default_timeout  int with the timeout (in ms) to use if
+     *                         neither a timeout nor a deadline is set
+     *
+     * @return int with the timeout in milliseconds.  Returns 0 if the
+     *         deadline has already passed.
+     */
+    int GetTimeout(const int default_timeout) const noexcept;
+
+    /**
+     *  Cancel all the calls in progress using these options.  Calls
+     *  started later on will fail as well.
+     */
+    void Cancel() noexcept;
+
+    /**
+     *  Check if @Cancel() has been called
+     *
+     * @return bool
+     */
+    bool IsCancelled() const noexcept;
+
+    /**
+     *  Retrieve the glib2 cancellation token passed on to the D-Bus calls
+     *
+     * @return GCancellable* owned by this object
+     */
+    GCancellable *GetCancellable() const noexcept;
+
+
+  private:
+    GCancellable *cancellable = nullptr;
+    std::chrono::milliseconds timeout;
+    bool has_deadline = false;
+    std::chrono::steady_clock::time_point deadline{};
+
+    CallOptions(const std::chrono::milliseconds timeout_);
+};
+
+
+
+/**
+ *  Client side statistics of the synchronous D-Bus calls and property
+ *  accesses done by a Proxy::Client, per D-Bus object path, interface
+ *  and method.  Property accesses are recorded with the property
+ *  interface and "Get(property)", "Set(property)" or "GetAll" as
+ *  the method.
+ *
+ *  Recording a call takes a shared lock and a few relaxed atomic
+ *  increments.
+ */
+class CallStats
+{
+  public:
+    using Ptr = std::shared_ptr<CallStats>;
+
+    /**
+     *  The statistics of a single D-Bus method
+     */
+    struct Entry
+    {
+        Object::Path path;
+        std::string interface;
+        std::string method;
+        uint64_t calls = 0;    ///< Number of calls done
+        uint64_t errors = 0;   ///< Number of failed calls, including timeouts
+        uint64_t timeouts = 0; ///< Number of calls failing due to time-outs
+        Features::Metrics::Histogram::Snapshot latency{}; ///< Call latency
+    };
+    using Snapshot = std::vector<Entry>;
+
+    [[nodiscard]] static CallStats::Ptr Create()
+    {
+        return CallStats::Ptr(new CallStats());
+    }
+
+    /**
+     *  Record a completed call
+     *
+     * @param path       DBus::Object::Path of the called object
+     * @param interface  std::string with the called interface
+     * @param method     std::string with the called method
+     * @param usec       int64_t with the call latency in microseconds
+     * @param error      GError * from the call; nullptr if it succeeded
+     */
+    void Record(const Object::Path &path,
+                const std::string &interface,
+                const std::string &method,
+                const int64_t usec,
+                const GError *error);
+
+    /**
+     *  Copy the current statistics
+     *
+     * @return CallStats::Snapshot
+     */
+    Snapshot GetSnapshot() const;
+
+    /**
+     *  Reset all the statistics
+     */
+    void Reset() noexcept;
+
+  private:
+    /// The counters of a single D-Bus method
+    struct Counters
+    {
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> errors{0};
+        std::atomic<uint64_t> timeouts{0};
+        Features::Metrics::Histogram latency{};
+    };
+
+    using Key = std::tuple<std::string, std::string, std::string>;
+
+    mutable std::shared_mutex mtx{};
+    std::map<Key, std::unique_ptr<Counters>> counters{};
+
+    CallStats() = default;
+};
+
+
+
 /**
  *   D-Bus Proxy client
  *
@@ -100,6 +296,45 @@ class Client
   public:
     using Ptr = std::shared_ptr<Client>;
 
+    /**
+     *  Callback function used by the asynchronous Client methods when
+     *  the D-Bus call has completed.
+     *
+     *  The first argument is the GVariant * result of the call; the
+     *  callback function is responsible for releasing it with
+     *  g_variant_unref().  This is nullptr if the call failed or if the
+     *  call does not provide a response.  If the call failed, the
+     *  second argument will carry the DBus::Proxy::Exception.
+     */
+    using AsyncCallback = std::function<void(GVariant *, std::exception_ptr)>;
+
+    /**
+     *  Similar to @AsyncCallback, but used by @GetFDAsync() where the
+     *  file descriptor sent by the service is provided as the second
+     *  argument.  It is -1 if no file descriptor was received.
+     */
+    using AsyncFDCallback = std::function<void(GVariant *, int, std::exception_ptr)>;
+
+    /**
+     *  Describes a single D-Bus method call in a @CallBatch() request
+     */
+    struct BatchCall
+    {
+        TargetPreset::Ptr preset;  ///< Object path and interface to call
+        std::string method;        ///< D-Bus method to call
+        GVariant *params;          ///< Method arguments, may be nullptr
+    };
+
+    /**
+     *  Result of a single D-Bus method call in a @CallBatch() request
+     */
+    struct BatchResult
+    {
+        GVariant *response;       ///< Method response; nullptr on errors
+        std::exception_ptr error; ///< Set if this method call failed
+    };
+
+
     /**
      *  Prepare a new proxy client.  It will need an existing D-Bus
      *  connection and the service name to connect to
@@ -118,7 +353,15 @@ class Client
     {
         return Client::Ptr(new Client(connection, destination, timeout));
     }
-    ~Client() noexcept = default;
+
+    /**
+     *  Any asynchronous calls still pending when the Client is destructed
+     *  will be cancelled; their callbacks are called with an error.
+     *
+     *  The Client must not be destructed from within one of the
+     *  asynchronous callbacks, as these are run by the Client itself.
+     */
+    ~Client() noexcept;
 
 
     /**
@@ -128,6 +371,95 @@ class Client
      */
     const std::string &GetDestination() const noexcept;
 
+    /**
+     *  Retrieve the D-Bus connection this proxy is using
+     *
+     * @return Connection::Ptr
+     */
+    Connection::Ptr GetConnection() const noexcept;
+
+    /**
+     *  Each Client keeps a cache of the glib2 proxy objects used to
+     *  access the D-Bus objects in the service, to avoid preparing
+     *  a new one for each call.  This sets the maximum number of
+     *  D-Bus object path and interface combinations to keep; the least
+     *  recently used entries are released first.
+     *
+     *  The glib2 proxy objects only learn about a new owner of the
+     *  destination name while a main loop is running.  Without one, a
+     *  call may reach a cached proxy still targeting the previous owner.
+     *  Such a call is never delivered, so it is sent again via the
+     *  destination name and the cached proxy is released.
+     *
+     * @param size  size_t with the maximum cache size.  If 0, the cache
+     *              is disabled.
+     */
+    void SetProxyCacheSize(const size_t size);
+
+    /**
+     *  Release all the cached glib2 proxy objects
+     */
+    void ClearProxyCache() noexcept;
+
+    /**
+     *  Enable or disable recording statistics of the synchronous and
+     *  asynchronous calls and property accesses done via this Client.
+     *  Disabling discards the statistics collected so far.  Asynchronous
+     *  calls are recorded when their result arrives, before the callback
+     *  is called.
+     *
+     * @param enable  bool flag
+     */
+    void EnableCallStats(const bool enable);
+
+    /**
+     *  Enable or disable sharing identical concurrent read-only requests.
+     *
+     *  When enabled, a property read or a call to a method marked via
+     *  @SetIdempotent() which is identical to one already in progress
+     *  does not go on the bus.  It waits for the request in progress
+     *  and is given the same result, or the same exception.  Requests
+     *  are identical when the object path, interface, method or
+     *  property name and the method arguments are the same.
+     *
+     *  Requests using their own CallOptions are never shared.  A property
+     *  Set done via this Client, synchronous or asynchronous, stops the
+     *  reads in progress from being shared with later reads, so a read
+     *  done after a Set never receives a value read before it.
+     *  Modifications done by other means, such as method calls, do not.
+     *
+     * @param enable  bool flag
+     */
+    void EnableSingleFlight(const bool enable) noexcept;
+
+    /**
+     *  Mark a D-Bus method as idempotent; calling it several times with
+     *  the same arguments gives the same result without side effects.
+     *  Only calls to such methods are shared when @EnableSingleFlight()
+     *  is enabled.
+     *
+     * @param interface   std::string with the interface scope of the method
+     * @param method      std::string with the D-Bus method name
+     * @param idempotent  bool flag (default true).  If false, the method
+     *                    is no longer marked idempotent.
+     */
+    void SetIdempotent(const std::string &interface,
+                       const std::string &method,
+                       const bool idempotent = true);
+
+    /**
+     *  Retrieve the call statistics recorded by this Client
+     *
+     * @return CallStats::Snapshot; empty if the statistics are disabled
+     */
+    CallStats::Snapshot GetCallStats() const;
+
+    /**
+     *  Reset the call statistics recorded by this Client
+     */
+    void ResetCallStats() noexcept;
+
+
     /**
      *  Call a D-Bus method in a D-Bus object on the D-Bus service this
      *  proxy is configured against
@@ -141,6 +473,8 @@ class Client
      *                     wait for a response.  This will also disable any
      *                     error checking possibilities, to verify if the
      *                     call was successfully executed by the service.
+     * @param options      CallOptions::Ptr with the timeout and cancellation
+     *                     settings for this call (optional)
      *
      * @return GVariant*   GVariant object with the results provided by the
      *                     D-Bus method.  Will be nullptr if no_response is
@@ -151,7 +485,8 @@ class Client
                    const std::string &interface,
                    const std::string &method,
                    GVariant *params = nullptr,
-                   const bool no_response = false) const;
+                   const bool no_response = false,
+                   const CallOptions::Ptr options = nullptr) const;
 
     /**
      *  A variant of the prior @Proxy::Client::Call() method which
@@ -167,6 +502,8 @@ class Client
      *                     wait for a response.  This will also disable any
      *                     error checking possibilities, to verify if the
      *                     call was successfully executed by the service.
+     * @param options      CallOptions::Ptr with the timeout and cancellation
+     *                     settings for this call (optional)
      *
      * @return GVariant*   GVariant object with the results provided by the
      *                     D-Bus method.  Will be nullptr if no_response is
@@ -176,7 +513,59 @@ class Client
     GVariant *Call(const TargetPreset::Ptr preset,
                    const std::string &method,
                    GVariant *params = nullptr,
-                   const bool no_response = false) const;
+                   const bool no_response = false,
+                   const CallOptions::Ptr options = nullptr) const;
+
+    /**
+     *  A variant of @Proxy::Client::Call() where both the call arguments
+     *  and the result are passed via owning glib2::Variant handles.
+     *
+     * @param object_path  DBus::Object::Path to the D-Bus object
+     * @param interface    std::string with the interface of the method
+     * @param method       std::string with the D-Bus method to call
+     * @param params       glib2::Variant with the call arguments; an
+     *                     empty handle if the method takes none
+     * @param no_response  bool flag (default false), see Call()
+     * @param options      CallOptions::Ptr with the timeout and cancellation
+     *                     settings for this call (optional)
+     *
+     * @return glib2::Variant owning the results provided by the D-Bus
+     *         method.  Empty if no_response is set to true.
+     * @throws DBus::Proxy::Exception if the D-Bus call failed
+     */
+    glib2::Variant Call(const Object::Path &object_path,
+                        const std::string &interface,
+                        const std::string &method,
+                        glib2::Variant params,
+                        const bool no_response = false,
+                        const CallOptions::Ptr options = nullptr) const
+    {
+        return glib2::Variant(Call(object_path,
+                                   interface,
+                                   method,
+                                   params.get(),
+                                   no_response,
+                                   options));
+    }
+
+    /**
+     *  A variant of the prior glib2::Variant based Call() method which
+     *  extracts the D-Bus object path and interface from a TargetPreset
+     *  object.
+     */
+    glib2::Variant Call(const TargetPreset::Ptr preset,
+                        const std::string &method,
+                        glib2::Variant params,
+                        const bool no_response = false,
+                        const CallOptions::Ptr options = nullptr) const
+    {
+        return Call(preset->object_path,
+                    preset->interface,
+                    method,
+                    std::move(params),
+                    no_response,
+                    options);
+    }
 
     /**
      *  Do a D-Bus call and attach a file descriptor to be sent together
@@ -189,6 +578,8 @@ class Client
      * @param params       GVariant * with the arguments to used in the
      *                     D-Bus method call
      * @param fd           File descriptor to pass to the D-Bus method
+     * @param options      CallOptions::Ptr with the timeout and cancellation
+     *                     settings for this call (optional)
      *
      * @return GVariant*   GVariant object with the results provided by the
      *                     D-Bus method.
@@ -197,7 +588,8 @@ class Client
     GVariant *SendFD(const TargetPreset::Ptr preset,
                      const std::string &method,
                      GVariant *params,
-                     int &fd) const;
+                     int &fd,
+                     const CallOptions::Ptr options = nullptr) const;
 
     /**
      *  Do a D-Bus call and retrieve aa attached a file descriptor sent
@@ -210,6 +602,8 @@ class Client
      * @param method       std::string with the D-Bus method to call
      * @param params       GVariant * with the arguments to used in the
      *                     D-Bus method call
+     * @param options      CallOptions::Ptr with the timeout and cancellation
+     *                     settings for this call (optional)
      *
      * @return GVariant*   GVariant object with the results provided by the
      *                     D-Bus method.  The file descriptor is available
@@ -219,7 +613,283 @@ class Client
     GVariant *GetFD(int &fd,
                     const TargetPreset::Ptr preset,
                     const std::string &method,
-                    GVariant *params) const;
+                    GVariant *params,
+                    const CallOptions::Ptr options = nullptr) const;
+
+    /**
+     *  Do a D-Bus call passing any number of file descriptors in both
+     *  directions.  This makes it possible to hand over several file
+     *  descriptors to the D-Bus service and retrieve several back in
+     *  a single round trip.
+     *
+     * @param preset       TargetPreset::Ptr containing the object path
+     *                     and interface to perform the method call against
+     * @param method       std::string with the D-Bus method to call
+     * @param params       GVariant * with the arguments to used in the
+     *                     D-Bus method call
+     * @param send_fds     std::vector<int> with the file descriptors to pass
+     *                     to the D-Bus method, in order.  The caller still
+     *                     owns these file descriptors.
+     * @param recv_fds     std::vector<int> where the file descriptors
+     *                     returned by the D-Bus method are stored.  The
+     *                     caller is responsible for closing these.
+     * @param options      CallOptions::Ptr with the timeout and cancellation
+     *                     settings for this call (optional)
+     *
+     * @return GVariant*   GVariant object with the results provided by the
+     *                     D-Bus method.
+     * @throws DBus::Proxy::Exception if the D-Bus call failed
+     */
+    GVariant *CallWithFDs(const TargetPreset::Ptr preset,
+                          const std::string &method,
+                          GVariant *params,
+                          const std::vector<int> &send_fds,
+                          std::vector<int> &recv_fds,
+                          const CallOptions::Ptr options = nullptr) const;
+
+    /**
+     *  Do a D-Bus call passing a binary payload as the only argument,
+     *  using the "(ay)" D-Bus data type.  Payloads of the threshold size
+     *  and larger are passed via a sealed memfd instead of inline in the
+     *  D-Bus message.  See DBus::Payload for details.
+     *
+     *  The D-Bus method must retrieve the payload via
+     *  Object::Method::Arguments::ReceivePayload().
+     *
+     * @param preset       TargetPreset::Ptr containing the object path
+     *                     and interface to perform the method call against
+     * @param method       std::string with the D-Bus method to call
+     * @param data         Pointer to the payload data
+     * @param size         size_t with the length of the payload data
+     * @param options      CallOptions::Ptr with the timeout and cancellation
+     *                     settings for this call (optional)
+     * @param threshold    size_t with the smallest payload passed via
+     *                     a memfd (optional)
+     *
+     * @return GVariant*   GVariant object with the results provided by the
+     *                     D-Bus method.
+     * @throws DBus::Proxy::Exception if the D-Bus call failed
+     * @throws DBus::Payload::Exception if the memfd could not be prepared
+     */
+    GVariant *SendPayload(const TargetPreset::Ptr preset,
+                          const std::string &method,
+                          const void *data,
+                          const size_t size,
+                          const CallOptions::Ptr options = nullptr,
+                          const size_t threshold = GDBUSPP_PAYLOAD_MEMFD_THRESHOLD) const;
+
+    /**
+     *  Do a D-Bus call returning a binary payload, sent by the D-Bus
+     *  method via Object::Method::Arguments::SendPayload().  Larger
+     *  payloads are memory mapped directly from the memfd the D-Bus
+     *  service passed back.
+     *
+     * @param preset       TargetPreset::Ptr containing the object path
+     *                     and interface to perform the method call against
+     * @param method       std::string with the D-Bus method to call
+     * @param params       GVariant * with the arguments to used in the
+     *                     D-Bus method call
+     * @param options      CallOptions::Ptr with the timeout and cancellation
+     *                     settings for this call (optional)
+     *
+     * @return Payload::Ptr with the payload returned by the D-Bus method
+     * @throws DBus::Proxy::Exception if the D-Bus call failed
+     * @throws DBus::Payload::Exception if the D-Bus method did not return
+     *         a payload
+     */
+    Payload::Ptr GetPayload(const TargetPreset::Ptr preset,
+                            const std::string &method,
+                            GVariant *params = nullptr,
+                            const CallOptions::Ptr options = nullptr) const;
+
+    /**
+     *  Call a D-Bus method asynchronously in a D-Bus object on the D-Bus
+     *  service this proxy is configured against.  This method returns
+     *  when the call has been queued; the result is passed to the
+     *  callback function when it is available.
+     *
+     *  The callback function is run by a worker thread owned by this
+     *  Client, which processes all the asynchronous calls this Client
+     *  has started.  The worker is created by the first asynchronous
+     *  call.  The callback should not block for longer periods.
+     *
+     * @param object_path  DBus::Object::Path with the D-Bus object path
+     * @param interface    std::string with the interface scope in the object
+     * @param method       std::string with the D-Bus method to call
+     * @param params       GVariant * with the arguments to used in the
+     *                     D-Bus method call
+     * @param callback     AsyncCallback to call with the result
+     * @param options      CallOptions::Ptr with the timeout and cancellation
+     *                     settings for this call (optional)
+     *
+     * @throws DBus::Proxy::Exception if the D-Bus call could not be queued
+     */
+    void CallAsync(const Object::Path &object_path,
+                   const std::string &interface,
+                   const std::string &method,
+                   GVariant *params,
+                   AsyncCallback callback,
+                   const CallOptions::Ptr options = nullptr) const;
+
+    /**
+     *  A variant of the prior @Proxy::Client::CallAsync() method which
+     *  extracts the D-Bus object path and interface from a TargetPreset
+     *  object.
+     *
+     * @param preset       TargetPreset::Ptr containing the object path
+     *                     and interface to perform the method call against
+     * @param method       std::string with the D-Bus method to call
+     * @param params       GVariant * with the arguments to used in the
+     *                     D-Bus method call
+     * @param callback     AsyncCallback to call with the result
+     * @param options      CallOptions::Ptr with the timeout and cancellation
+     *                     settings for this call (optional)
+     *
+     * @throws DBus::Proxy::Exception if the D-Bus call could not be queued
+     */
+    void CallAsync(const TargetPreset::Ptr preset,
+                   const std::string &method,
+                   GVariant *params,
+                   AsyncCallback callback,
+                   const CallOptions::Ptr options = nullptr) const;
+
+    /**
+     *  Call a D-Bus method asynchronously and retrieve the result via
+     *  a std::future.  The caller is responsible for releasing the
+     *  GVariant * result.  If the D-Bus call failed, the future will
+     *  throw a DBus::Proxy::Exception when the result is retrieved.
+     *
+     * @param object_path  DBus::Object::Path with the D-Bus object path
+     * @param interface    std::string with the interface scope in the object
+     * @param method       std::string with the D-Bus method to call
+     * @param params       GVariant * with the arguments to used in the
+     *                     D-Bus method call
+     * @param options      CallOptions::Ptr with the timeout and cancellation
+     *                     settings for this call (optional)
+     *
+     * @return std::future<GVariant *> which will carry the call result
+     * @throws DBus::Proxy::Exception if the D-Bus call could not be queued
+     */
+    std::future<GVariant *> CallAsync(const Object::Path &object_path,
+                                      const std::string &interface,
+                                      const std::string &method,
+                                      GVariant *params = nullptr,
+                                      const CallOptions::Ptr options = nullptr) const;
+
+    /**
+     *  A variant of the prior @Proxy::Client::CallAsync() method which
+     *  extracts the D-Bus object path and interface from a TargetPreset
+     *  object.
+     *
+     * @param preset       TargetPreset::Ptr containing the object path
+     *                     and interface to perform the method call against
+     * @param method       std::string with the D-Bus method to call
+     * @param params       GVariant * with the arguments to used in the
+     *                     D-Bus method call
+     * @param options      CallOptions::Ptr with the timeout and cancellation
+     *                     settings for this call (optional)
+     *
+     * @return std::future<GVariant *> which will carry the call result
+     * @throws DBus::Proxy::Exception if the D-Bus call could not be queued
+     */
+    std::future<GVariant *> CallAsync(const TargetPreset::Ptr preset,
+                                      const std::string &method,
+                                      GVariant *params = nullptr,
+                                      const CallOptions::Ptr options = nullptr) const;
+
+    /**
+     *  Call several D-Bus methods in the D-Bus service this proxy is
+     *  configured against.  All the calls are sent before waiting for
+     *  any of the replies, so the service can process them while the
+     *  rest are in transit.  This method returns when all the calls
+     *  have completed.
+     *
+     *  An error in one call does not stop the other calls; each call
+     *  has its own result.  The caller is responsible for releasing
+     *  all the GVariant * responses.
+     *
+     * @param calls    std::vector<BatchCall> with all the calls to perform
+     * @param options  CallOptions::Ptr with the timeout and cancellation
+     *                 settings used by all the calls (optional)
+     *
+     * @return std::vector<BatchResult> with the results of each call,
+     *         in the same order as the calls were given.
+     */
+    std::vector<BatchResult> CallBatch(const std::vector<BatchCall> &calls,
+                                       const CallOptions::Ptr options = nullptr) const;
+
+    /**
+     *  Perform several D-Bus method calls in a single D-Bus request via
+     *  the net.openvpn.gdbuspp.Batch interface of the service; see
+     *  DBus::Object::Manager::EnableBatchInterface().  Unlike @CallBatch(),
+     *  this only needs a single D-Bus message in each direction.
+     *
+     *  Property values are retrieved by calling the
+     *  org.freedesktop.DBus.Properties.Get method with the (ss) arguments
+     *  of the interface and property name.
+     *
+     *  An error in one call does not stop the other calls; each call
+     *  has its own result.  The caller is responsible for releasing
+     *  all the GVariant * responses.
+     *
+     * @param calls       std::vector<BatchCall> with all the calls to perform
+     * @param batch_path  DBus::Object::Path of the batch object in the service
+     * @param options     CallOptions::Ptr with the timeout and cancellation
+     *                    settings for the batch request (optional)
+     *
+     * @return std::vector<BatchResult> with the results of each call,
+     *         in the same order as the calls were given.
+     *
+     * @throws DBus::Proxy::Exception if the batch request itself failed
+     */
+    std::vector<BatchResult> ExecuteBatch(const std::vector<BatchCall> &calls,
+                                          const Object::Path &batch_path = "/net/openvpn/gdbuspp/Batch",
+                                          const CallOptions::Ptr options = nullptr) const;
+
+    /**
+     *  Asynchronous variant of @Proxy::Client::SendFD()
+     *
+     * @param preset       TargetPreset::Ptr containing the object path
+     *                     and interface to perform the method call against
+     * @param method       std::string with the D-Bus method to call
+     * @param params       GVariant * with the arguments to used in the
+     *                     D-Bus method call
+     * @param fd           File descriptor to pass to the D-Bus method.  It
+     *                     is duplicated when the call is queued, so the
+     *                     caller may close it when this method returns.
+     * @param callback     AsyncCallback to call with the result
+     * @param options      CallOptions::Ptr with the timeout and cancellation
+     *                     settings for this call (optional)
+     *
+     * @throws DBus::Proxy::Exception if the D-Bus call could not be queued
+     */
+    void SendFDAsync(const TargetPreset::Ptr preset,
+                     const std::string &method,
+                     GVariant *params,
+                     int fd,
+                     AsyncCallback callback,
+                     const CallOptions::Ptr options = nullptr) const;
+
+    /**
+     *  Asynchronous variant of @Proxy::Client::GetFD()
+     *
+     * @param preset       TargetPreset::Ptr containing the object path
+     *                     and interface to perform the method call against
+     * @param method       std::string with the D-Bus method to call
+     * @param params       GVariant * with the arguments to used in the
+     *                     D-Bus method call
+     * @param callback     AsyncFDCallback to call with the result and
+     *                     the received file descriptor
+     * @param options      CallOptions::Ptr with the timeout and cancellation
+     *                     settings for this call (optional)
+     *
+     * @throws DBus::Proxy::Exception if the D-Bus call could not be queued
+     */
+    void GetFDAsync(const TargetPreset::Ptr preset,
+                    const std::string &method,
+                    GVariant *params,
+                    AsyncFDCallback callback,
+                    const CallOptions::Ptr options = nullptr) const;
 
     /**
      *  Retrieve the property value of a given property in an object in
@@ -229,13 +899,16 @@ class Client
      * @param interface      std::string with the interface scope in the
      *                       D-Bus object
      * @param property_name  std::string with the D-Bus object property name
+     * @param options        CallOptions::Ptr with the timeout and
+     *                       cancellation settings for this call (optional)
      *
      * @return GVariant* object containing the D-Bus property value
      * @throws DBus::Proxy::Exception if the D-Bus call failed
      */
     GVariant *GetPropertyGVariant(const Object::Path &object_path,
                                   const std::string &interface,
-                                  const std::string &property_name) const;
+                                  const std::string &property_name,
+                                  const CallOptions::Ptr options = nullptr) const;
 
     /**
      *  A variant of @Proxy::Client::GetPropertyGVariant() which
@@ -245,13 +918,57 @@ class Client
      * @param preset         TargetPreset::Ptr containing the object path
      *                       and interface of the property
      * @param property_name  std::string with the D-Bus object property name
+     * @param options        CallOptions::Ptr with the timeout and
+     *                       cancellation settings for this call (optional)
      *
      * @return GVariant* object containing the D-Bus property value
      * @throws DBus::Proxy::Exception if the D-Bus call failed
      */
     GVariant *GetPropertyGVariant(const TargetPreset::Ptr preset,
-                                  const std::string &property_name) const;
+                                  const std::string &property_name,
+                                  const CallOptions::Ptr options = nullptr) const;
+
+
+
+    /**
+     *  Retrieve all the property values in an object interface scope
+     *  with a single D-Bus call, using the
+     *  org.freedesktop.DBus.Properties.GetAll method.
+     *
+     *  The result is a dictionary (a{sv}) with the property name as
+     *  the key.  Individual values can be extracted with the
+     *  glib2::Value::Dict::Lookup<T>() function, or all of them at once
+     *  into a struct via glib2::Value::Dict::Mapping<S>.
+     *
+     * @param object_path    DBus::Object::Path with the D-Bus object path
+     * @param interface      std::string with the interface scope in the
+     *                       D-Bus object
+     * @param options        CallOptions::Ptr with the timeout and
+     *                       cancellation settings for this call (optional)
+     *
+     * @return GVariant* dictionary with all properties.  The caller is
+     *         responsible for releasing it with g_variant_unref().
+     * @throws DBus::Proxy::Exception if the D-Bus call failed
+     */
+    GVariant *GetAllProperties(const Object::Path &object_path,
+                               const std::string &interface,
+                               const CallOptions::Ptr options = nullptr) const;
 
+    /**
+     *  A variant of @Proxy::Client::GetAllProperties() which uses a
+     *  TargetPreset::Ptr to provide the object path and interface
+     *
+     * @param preset         TargetPreset::Ptr containing the object path
+     *                       and interface of the properties
+     * @param options        CallOptions::Ptr with the timeout and
+     *                       cancellation settings for this call (optional)
+     *
+     * @return GVariant* dictionary with all properties.  The caller is
+     *         responsible for releasing it with g_variant_unref().
+     * @throws DBus::Proxy::Exception if the D-Bus call failed
+     */
+    GVariant *GetAllProperties(const TargetPreset::Ptr preset,
+                               const CallOptions::Ptr options = nullptr) const;
 
 
     /**
@@ -378,12 +1095,15 @@ class Client
      *                       property.  The data type in this container MUST
      *                       match the data type of the D-bus property data
      *                       type.
+     * @param options        CallOptions::Ptr with the timeout and
+     *                       cancellation settings for this call (optional)
      * @throws DBus::Proxy::Exception if the D-Bus call failed
      */
     void SetPropertyGVariant(const Object::Path &object_path,
                              const std::string &interface,
                              const std::string &property_name,
-                             GVariant *params) const;
+                             GVariant *params,
+                             const CallOptions::Ptr options = nullptr) const;
 
 
     /**
@@ -397,11 +1117,102 @@ class Client
      *                       property.  The data type in this container MUST
      *                       match the data type of the D-bus property data
      *                       type.
+     * @param options        CallOptions::Ptr with the timeout and
+     *                       cancellation settings for this call (optional)
      * @throws DBus::Proxy::Exception if the D-Bus call failed
      */
     void SetPropertyGVariant(const TargetPreset::Ptr preset,
                              const std::string &property_name,
-                             GVariant *params) const;
+                             GVariant *params,
+                             const CallOptions::Ptr options = nullptr) const;
+
+
+    /**
+     *  Asynchronous variant of @Proxy::Client::GetPropertyGVariant()
+     *  The callback receives the property value.
+     *
+     * @param object_path    DBus::Object::Path with the D-Bus object path
+     * @param interface      std::string with the interface scope in the
+     *                       D-Bus object
+     * @param property_name  std::string with the D-Bus object property name
+     * @param callback       AsyncCallback to call with the property value
+     * @param options        CallOptions::Ptr with the timeout and
+     *                       cancellation settings for this call (optional)
+     *
+     * @throws DBus::Proxy::Exception if the D-Bus call could not be queued
+     */
+    void GetPropertyGVariantAsync(const Object::Path &object_path,
+                                  const std::string &interface,
+                                  const std::string &property_name,
+                                  AsyncCallback callback,
+                                  const CallOptions::Ptr options = nullptr) const;
+
+    /**
+     *  Asynchronous variant of @Proxy::Client::GetPropertyGVariant()
+     *  using a TargetPreset::Ptr.  The callback receives the property value.
+     *
+     * @param preset         TargetPreset::Ptr containing the object path
+     *                       and interface of the property
+     * @param property_name  std::string with the D-Bus object property name
+     * @param callback       AsyncCallback to call with the property value
+     * @param options        CallOptions::Ptr with the timeout and
+     *                       cancellation settings for this call (optional)
+     *
+     * @throws DBus::Proxy::Exception if the D-Bus call could not be queued
+     */
+    void GetPropertyGVariantAsync(const TargetPreset::Ptr preset,
+                                  const std::string &property_name,
+                                  AsyncCallback callback,
+                                  const CallOptions::Ptr options = nullptr) const;
+
+    /**
+     *  Asynchronous variant of @Proxy::Client::SetPropertyGVariant()
+     *  The callback is called with a nullptr response when the service
+     *  has processed the request, or with an error if it failed.
+     *
+     * @param object_path    DBus::Object::Path with the D-Bus object path
+     * @param interface      std::string with the interface scope in the
+     *                       D-Bus object
+     * @param property_name  std::string with the D-Bus object property name
+     *                       which is to be modified
+     * @param params         GVariant object containing the new value of the
+     *                       property.
+     * @param callback       AsyncCallback to call when completed.  May be
+     *                       nullptr if the result is not needed.
+     * @param options        CallOptions::Ptr with the timeout and
+     *                       cancellation settings for this call (optional)
+     *
+     * @throws DBus::Proxy::Exception if the D-Bus call could not be queued
+     */
+    void SetPropertyGVariantAsync(const Object::Path &object_path,
+                                  const std::string &interface,
+                                  const std::string &property_name,
+                                  GVariant *params,
+                                  AsyncCallback callback = nullptr,
+                                  const CallOptions::Ptr options = nullptr) const;
+
+    /**
+     *  Asynchronous variant of @Proxy::Client::SetPropertyGVariant()
+     *  using a TargetPreset::Ptr.
+     *
+     * @param preset         TargetPreset::Ptr containing the object path and
+     *                       interface of the property
+     * @param property_name  std::string with the D-Bus object property name
+     *                       which is to be modified
+     * @param params         GVariant object containing the new value of the
+     *                       property.
+     * @param callback       AsyncCallback to call when completed.  May be
+     *                       nullptr if the result is not needed.
+     * @param options        CallOptions::Ptr with the timeout and
+     *                       cancellation settings for this call (optional)
+     *
+     * @throws DBus::Proxy::Exception if the D-Bus call could not be queued
+     */
+    void SetPropertyGVariantAsync(const TargetPreset::Ptr preset,
+                                  const std::string &property_name,
+                                  GVariant *params,
+                                  AsyncCallback callback = nullptr,
+                                  const CallOptions::Ptr options = nullptr) const;
 
 
     /**
@@ -478,7 +1289,115 @@ class Client
     Connection::Ptr connection = nullptr; ///< D-Bus connection object
     const std::string destination;        ///< D-Bus service bus name to use
 
+    /// Cache of prepared GDBusProxy objects, per object path and interface
+    std::shared_ptr<_private::ProxyCache> proxy_cache = nullptr;
+
+    /// Processes the asynchronous calls started by this Client; created
+    /// by the first asynchronous call, see get_async_worker()
+    mutable std::shared_ptr<_private::AsyncWorker> async_worker = nullptr;
+    mutable std::mutex async_worker_mtx{};
+
+    /// Call statistics; nullptr unless enabled via EnableCallStats().
+    /// Accessed via std::atomic_load()/std::atomic_store()
+    CallStats::Ptr call_stats = nullptr;
+
+    /// Requests in progress shared between identical callers and the
+    /// methods marked via SetIdempotent()
+    std::shared_ptr<_private::SingleFlight> single_flight = nullptr;
+
+    /// Share identical requests, see EnableSingleFlight()
+    std::atomic<bool> single_flight_enabled{false};
+
     Client(Connection::Ptr conn, const std::string &dest, uint8_t timeout);
+
+    /**
+     *  Retrieve the worker processing the asynchronous calls, creating
+     *  it on the first use.  Clients only doing synchronous calls never
+     *  allocate the worker main context.
+     *
+     * @return std::shared_ptr<_private::AsyncWorker>
+     */
+    std::shared_ptr<_private::AsyncWorker> get_async_worker() const;
+
+    /**
+     *  Retrieve a property value from the D-Bus service.  This is the
+     *  implementation of @GetPropertyGVariant(), without sharing
+     *  identical requests.
+     */
+    GVariant *get_property(const Object::Path &object_path,
+                           const std::string &interface,
+                           const std::string &property_name,
+                           const CallOptions::Ptr options) const;
+};
+
+
+
+/**
+ *  D-Bus Proxy client using a DBus::Connection::Pool.  It keeps one
+ *  Proxy::Client per pooled connection, and each calling thread is given
+ *  the Client of the connection the pool assigns to that thread.
+ *
+ *  See DBus::Connection::Pool for the ordering guarantees.
+ *
+ *  @code
+ *
+ *  auto pool = DBus::Connection::Pool::Create(DBus::BusType::SESSION, 4);
+ *  auto prx = DBus::Proxy::PooledClient::Create(pool, "net.example.service");
+ *  auto preset = DBus::Proxy::TargetPreset::Create("/net/example/object",
+ *                                                   "net.example.interface");
+ *  GVariant *r = prx->Call(preset, "Method");  // from any thread
+ *
+ *  @endcode
+ */
+class PooledClient
+{
+  public:
+    using Ptr = std::shared_ptr<PooledClient>;
+
+    /**
+     *  Prepare a new pooled proxy client.
+     *
+     * @param pool         DBus::Connection::Pool to use
+     * @param destination  std::string containing the D-Bus service to
+     *                     connect to
+     * @param timeout      How long to wait for the proxy creation to complete.
+     *                     Defaults to approx. 10 seconds.
+     *
+     * @return PooledClient::Ptr Returns a shared_ptr with the prepared
+     *         pooled Proxy client
+     */
+    [[nodiscard]] static PooledClient::Ptr Create(Connection::Pool::Ptr pool,
+                                                  const std::string &destination,
+                                                  uint8_t timeout = 10)
+    {
+        return PooledClient::Ptr(new PooledClient(pool, destination, timeout));
+    }
+
+    /**
+     *  Retrieve the Proxy::Client for the calling thread
+     *
+     * @return Client::Ptr
+     */
+    Client::Ptr Get() const noexcept;
+
+    /**
+     *  Access the Proxy::Client of the calling thread directly
+     *
+     * @return Client*
+     */
+    Client *operator->() const noexcept
+    {
+        return Get().get();
+    }
+
+
+  private:
+    Connection::Pool::Ptr pool = nullptr; ///< Connections used by the clients
+    std::vector<Client::Ptr> clients{};   ///< One client per pool connection
+
+    PooledClient(Connection::Pool::Ptr pool_,
+                 const std::string &destination,
+                 uint8_t timeout);
 };
 
 } // namespace Proxy
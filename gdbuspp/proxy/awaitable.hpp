@@ -0,0 +1,284 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file proxy/awaitable.hpp
+ *
+ * @brief  Optional C++20 coroutine awaitables on top of the asynchronous
+ *         DBus::Proxy::Client API.  The library itself is built as C++17;
+ *         this header is only usable by C++20 code.
+ *
+ *         Only the client side is covered.  D-Bus object method callbacks
+ *         cannot be coroutines; use Object::Method::Arguments::Defer() to
+ *         reply to a method call after the callback has returned.
+ */
+
+#pragma once
+
+#if !defined(__cpp_impl_coroutine) || !__has_include(<coroutine>)
+#error "gdbuspp/proxy/awaitable.hpp requires C++20 coroutine support"
+#endif
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <string>
+#include <utility>
+
+#include "../glib2/utils.hpp"
+#include "../proxy.hpp"
+
+
+namespace DBus {
+namespace Proxy {
+namespace Awaitable {
+
+/**
+ *  Awaitable wrapping one of the DBus::Proxy::Client asynchronous
+ *  methods taking an AsyncCallback.  The coroutine is resumed from the
+ *  Client's asynchronous worker thread when the call completes.  If the
+ *  call completes before the coroutine has been suspended, the coroutine
+ *  continues directly without being suspended.
+ *
+ *  The Client must be kept alive by the caller until the awaiting
+ *  coroutine has been resumed.
+ *
+ * @tparam Starter  Callable starting the asynchronous call, taking the
+ *                  Client::AsyncCallback to call on completion
+ */
+template <typename Starter>
+class Operation
+{
+  public:
+    explicit Operation(Starter &&start_)
+        : start(std::move(start_))
+    {
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+        // Whichever of this thread and the completion callback comes
+        // last continues the coroutine.  The coroutine frame, including
+        // this object, may be gone once the callback has resumed it.
+        start([this, handle](GVariant *response, std::exception_ptr excp)
+              {
+                  result = response;
+                  error = excp;
+                  if (completed.exchange(true, std::memory_order_acq_rel))
+                  {
+                      handle.resume();
+                  }
+              });
+        return !completed.exchange(true, std::memory_order_acq_rel);
+    }
+
+    /**
+     * @return GVariant* with the call result.  The caller is responsible
+     *         for releasing it with g_variant_unref().  May be nullptr if
+     *         the call does not provide a response.
+     * @throws DBus::Proxy::Exception if the D-Bus call failed
+     */
+    GVariant *await_resume()
+    {
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+        return result;
+    }
+
+  private:
+    Starter start;
+    GVariant *result = nullptr;
+    std::exception_ptr error = nullptr;
+    std::atomic<bool> completed{false};
+};
+
+
+/**
+ *  co_await'able variant of @Proxy::Client::CallAsync()
+ *
+ *  @code
+ *
+ *  GVariant *r = co_await DBus::Proxy::Awaitable::Call(prx, preset, "Method");
+ *
+ *  @endcode
+ *
+ * @param client   Proxy::Client::Ptr to perform the call with
+ * @param preset   TargetPreset::Ptr with the object path and interface
+ * @param method   std::string with the D-Bus method to call
+ * @param params   GVariant * with the method arguments, may be nullptr
+ * @param options  CallOptions::Ptr with the timeout and cancellation
+ *                 settings for this call (optional)
+ *
+ * @return Awaitable returning the GVariant * call result
+ */
+inline auto Call(const Client::Ptr &client,
+                 const TargetPreset::Ptr preset,
+                 const std::string &method,
+                 GVariant *params = nullptr,
+                 const CallOptions::Ptr options = nullptr)
+{
+    const Client *prx = client.get();
+    return Operation([prx, preset, method, params, options](Client::AsyncCallback cb)
+                     {
+                         prx->CallAsync(preset, method, params, std::move(cb), options);
+                     });
+}
+
+
+/**
+ *  co_await'able variant of @Proxy::Client::GetPropertyGVariantAsync()
+ *
+ * @param client         Proxy::Client::Ptr to perform the call with
+ * @param preset         TargetPreset::Ptr with the object path and interface
+ * @param property_name  std::string with the D-Bus object property name
+ * @param options        CallOptions::Ptr with the timeout and cancellation
+ *                       settings for this call (optional)
+ *
+ * @return Awaitable returning the GVariant * property value
+ */
+inline auto GetPropertyGVariant(const Client::Ptr &client,
+                                const TargetPreset::Ptr preset,
+                                const std::string &property_name,
+                                const CallOptions::Ptr options = nullptr)
+{
+    const Client *prx = client.get();
+    return Operation([prx, preset, property_name, options](Client::AsyncCallback cb)
+                     {
+                         prx->GetPropertyGVariantAsync(preset, property_name, std::move(cb), options);
+                     });
+}
+
+
+/**
+ *  co_await'able variant of @Proxy::Client::SetPropertyGVariantAsync().
+ *  The awaitable returns nullptr when the property has been set.
+ *
+ * @param client         Proxy::Client::Ptr to perform the call with
+ * @param preset         TargetPreset::Ptr with the object path and interface
+ * @param property_name  std::string with the D-Bus object property name
+ * @param value          GVariant * with the new property value
+ * @param options        CallOptions::Ptr with the timeout and cancellation
+ *                       settings for this call (optional)
+ *
+ * @return Awaitable returning nullptr on success
+ */
+inline auto SetPropertyGVariant(const Client::Ptr &client,
+                                const TargetPreset::Ptr preset,
+                                const std::string &property_name,
+                                GVariant *value,
+                                const CallOptions::Ptr options = nullptr)
+{
+    const Client *prx = client.get();
+    return Operation([prx, preset, property_name, value, options](Client::AsyncCallback cb)
+                     {
+                         prx->SetPropertyGVariantAsync(preset, property_name, value, std::move(cb), options);
+                     });
+}
+
+
+/**
+ *  co_await'able variant of @Proxy::Client::SetProperty(), using the
+ *  C++ value data type to the corresponding D-Bus data type
+ *
+ * @tparam T             C++ data type of the property value
+ * @param client         Proxy::Client::Ptr to perform the call with
+ * @param preset         TargetPreset::Ptr with the object path and interface
+ * @param property_name  std::string with the D-Bus object property name
+ * @param value          The new property value
+ *
+ * @return Awaitable returning nullptr on success
+ */
+template <typename T>
+inline auto SetProperty(const Client::Ptr &client,
+                        const TargetPreset::Ptr preset,
+                        const std::string &property_name,
+                        const T &value)
+{
+    return SetPropertyGVariant(client, preset, property_name, glib2::Value::Create<T>(value));
+}
+
+
+/**
+ *  Awaitable retrieving a D-Bus object property as a C++ value
+ *
+ * @tparam T  C++ data type of the property value
+ */
+template <typename T>
+class PropertyValue
+{
+  public:
+    PropertyValue(const Client::Ptr &client,
+                  const TargetPreset::Ptr preset,
+                  const std::string &property_name)
+        : op(GetPropertyGVariant(client, preset, property_name))
+    {
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+        return op.await_suspend(handle);
+    }
+
+    /**
+     * @return T with the property value
+     * @throws DBus::Proxy::Exception if the D-Bus call failed
+     */
+    T await_resume()
+    {
+        GVariant *v = op.await_resume();
+        T ret = glib2::Value::Get<T>(v);
+        g_variant_unref(v);
+        return ret;
+    }
+
+  private:
+    decltype(GetPropertyGVariant(std::declval<Client::Ptr>(),
+                                 std::declval<TargetPreset::Ptr>(),
+                                 std::declval<std::string>())) op;
+};
+
+
+/**
+ *  co_await'able variant of @Proxy::Client::GetProperty()
+ *
+ *  @code
+ *
+ *  auto version = co_await DBus::Proxy::Awaitable::GetProperty<std::string>(prx, preset, "version");
+ *
+ *  @endcode
+ *
+ * @tparam T             C++ data type of the property value
+ * @param client         Proxy::Client::Ptr to perform the call with
+ * @param preset         TargetPreset::Ptr with the object path and interface
+ * @param property_name  std::string with the D-Bus object property name
+ *
+ * @return Awaitable returning the T property value
+ */
+template <typename T>
+inline PropertyValue<T> GetProperty(const Client::Ptr &client,
+                                    const TargetPreset::Ptr preset,
+                                    const std::string &property_name)
+{
+    return PropertyValue<T>(client, preset, property_name);
+}
+
+} // namespace Awaitable
+} // namespace Proxy
+} // namespace DBus
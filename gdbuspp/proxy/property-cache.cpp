@@ -0,0 +1,189 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file proxy/property-cache.cpp
+ *
+ * @brief  Implementation of DBus::Proxy::PropertyCache
+ */
+
+#include <string>
+#include <glib.h>
+
+#define GDBUSPP_LOG_CATEGORY PROXY
+#include "../features/debug-log.hpp"
+#include "property-cache.hpp"
+
+
+namespace DBus {
+namespace Proxy {
+
+PropertyCache::PropertyCache(Client::Ptr proxy_,
+                             TargetPreset::Ptr preset_,
+                             Signals::SubscriptionManager::Ptr subscriptions_)
+    : proxy(proxy_), preset(preset_), subscriptions(subscriptions_)
+{
+    if (!proxy || !preset)
+    {
+        throw DBus::Proxy::Exception("Invalid Proxy::Client or TargetPreset object");
+    }
+    if (!subscriptions)
+    {
+        subscriptions = Signals::SubscriptionManager::Create(proxy->GetConnection());
+    }
+
+    // Subscribe to property changes before retrieving the values,
+    // to not lose any updates happening in between
+    signal_target = Signals::Target::Create(proxy->GetDestination(),
+                                            preset->object_path,
+                                            "org.freedesktop.DBus.Properties");
+    subscriptions->Subscribe(signal_target,
+                             "PropertiesChanged",
+                             [this](Signals::Event::Ptr &event)
+                             {
+                                 properties_changed(event);
+                             });
+    try
+    {
+        Refresh();
+    }
+    catch (...)
+    {
+        subscriptions->Unsubscribe(signal_target, "PropertiesChanged");
+        throw;
+    }
+}
+
+
+PropertyCache::~PropertyCache() noexcept
+{
+    try
+    {
+        subscriptions->Unsubscribe(signal_target, "PropertiesChanged");
+    }
+    catch (const DBus::Exception &excp)
+    {
+        GDBUSPP_LOG("PropertyCache::~PropertyCache(): " << excp.what());
+    }
+
+    std::lock_guard<std::mutex> lg(cache_mtx);
+    for (auto &[name, value] : cache)
+    {
+        g_variant_unref(value);
+    }
+    cache.clear();
+}
+
+
+GVariant *PropertyCache::GetPropertyGVariant(const std::string &property_name)
+{
+    {
+        std::lock_guard<std::mutex> lg(cache_mtx);
+        auto it = cache.find(property_name);
+        if (cache.end() != it)
+        {
+            return g_variant_ref(it->second);
+        }
+    }
+
+    // Not cached or invalidated; retrieve it from the service
+    GVariant *value = proxy->GetPropertyGVariant(preset, property_name);
+    update_value(property_name, value);
+    return value;
+}
+
+
+bool PropertyCache::IsCached(const std::string &property_name) const
+{
+    std::lock_guard<std::mutex> lg(cache_mtx);
+    return cache.find(property_name) != cache.end();
+}
+
+
+void PropertyCache::Refresh()
+{
+    GVariant *props = proxy->GetAllProperties(preset);
+
+    GVariantIter iter;
+    g_variant_iter_init(&iter, props);
+    const gchar *name = nullptr;
+    GVariant *value = nullptr;
+    while (g_variant_iter_next(&iter, "{&sv}", &name, &value))
+    {
+        update_value(name, value);
+        g_variant_unref(value);
+    }
+    g_variant_unref(props);
+}
+
+
+void PropertyCache::update_value(const std::string &property_name, GVariant *value)
+{
+    std::lock_guard<std::mutex> lg(cache_mtx);
+    auto it = cache.find(property_name);
+    if (cache.end() != it)
+    {
+        g_variant_unref(it->second);
+        it->second = g_variant_ref(value);
+    }
+    else
+    {
+        cache[property_name] = g_variant_ref(value);
+    }
+}
+
+
+void PropertyCache::invalidate_value(const std::string &property_name)
+{
+    std::lock_guard<std::mutex> lg(cache_mtx);
+    auto it = cache.find(property_name);
+    if (cache.end() != it)
+    {
+        g_variant_unref(it->second);
+        cache.erase(it);
+    }
+}
+
+
+void PropertyCache::properties_changed(Signals::Event::Ptr &event)
+{
+    // PropertiesChanged (sa{sv}as):
+    //    interface_name, changed_properties, invalidated_properties
+    if (!event->params
+        || !g_variant_is_of_type(event->params, G_VARIANT_TYPE("(sa{sv}as)")))
+    {
+        return;
+    }
+    if (glib2::Value::Extract<std::string_view>(event->params, 0) != preset->interface)
+    {
+        return;
+    }
+
+    GVariantIter *changed = nullptr;
+    GVariantIter *invalidated = nullptr;
+    g_variant_get(event->params, "(&sa{sv}as)", nullptr, &changed, &invalidated);
+
+    const gchar *name = nullptr;
+    GVariant *value = nullptr;
+    while (g_variant_iter_next(changed, "{&sv}", &name, &value))
+    {
+        GDBUSPP_LOG("PropertyCache: Updated " << preset.get() << ", property=" << name);
+        update_value(name, value);
+        g_variant_unref(value);
+    }
+    while (g_variant_iter_next(invalidated, "&s", &name))
+    {
+        GDBUSPP_LOG("PropertyCache: Invalidated " << preset.get() << ", property=" << name);
+        invalidate_value(name);
+    }
+    g_variant_iter_free(changed);
+    g_variant_iter_free(invalidated);
+}
+
+} // namespace Proxy
+} // namespace DBus
@@ -0,0 +1,170 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file proxy/property-cache.hpp
+ *
+ * @brief  Declaration of DBus::Proxy::PropertyCache, a locally cached
+ *         view of the properties in a D-Bus object interface
+ */
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <glib.h>
+
+#include "../proxy.hpp"
+#include "../glib2/utils.hpp"
+#include "../signals/event.hpp"
+#include "../signals/subscriptionmgr.hpp"
+#include "../signals/target.hpp"
+
+
+namespace DBus {
+namespace Proxy {
+
+/**
+ *  Keeps a local copy of all the properties in a D-Bus object interface.
+ *
+ *  All the property values are retrieved when this object is created.
+ *  They are kept up-to-date via the org.freedesktop.DBus.Properties
+ *  PropertiesChanged signal emitted by the service, so reading the
+ *  property values does not cause any D-Bus traffic.  Properties
+ *  which are invalidated without a new value are retrieved from the
+ *  service the next time they are read.
+ *
+ *  The PropertiesChanged signals are processed via the main loop
+ *  of the thread creating the PropertyCache object; which needs to run
+ *  for the cached values to be updated.
+ */
+class PropertyCache
+{
+  public:
+    using Ptr = std::shared_ptr<PropertyCache>;
+
+    /**
+     *  Prepare a new property cache for an object interface in the
+     *  D-Bus service the Proxy::Client is configured against.
+     *
+     * @param proxy          Proxy::Client::Ptr to use for retrieving the
+     *                       property values
+     * @param preset         TargetPreset::Ptr with the object path and
+     *                       interface of the properties to cache
+     * @param subscriptions  Signals::SubscriptionManager::Ptr to use for the
+     *                       PropertiesChanged signal subscription.  If not
+     *                       provided, a new one is created.
+     *
+     * @return PropertyCache::Ptr
+     * @throws DBus::Proxy::Exception if the properties could not be retrieved
+     */
+    [[nodiscard]] static PropertyCache::Ptr Create(Client::Ptr proxy,
+                                                   TargetPreset::Ptr preset,
+                                                   Signals::SubscriptionManager::Ptr subscriptions = nullptr)
+    {
+        return PropertyCache::Ptr(new PropertyCache(proxy, preset, subscriptions));
+    }
+
+    ~PropertyCache() noexcept;
+
+
+    /**
+     *  Retrieve a property value from the cache.  If the property value
+     *  has been invalidated by the service, it is retrieved again.
+     *
+     * @param property_name  std::string with the D-Bus object property name
+     *
+     * @return GVariant* with the property value.  The caller is
+     *         responsible for releasing it with g_variant_unref().
+     * @throws DBus::Proxy::Exception if the property could not be retrieved
+     */
+    GVariant *GetPropertyGVariant(const std::string &property_name);
+
+
+    /**
+     *  Retrieve a property value from the cache as a C++ variable with
+     *  the expected data type.
+     *
+     *  NOTE: The C++ data type MUST match the D-Bus property data type
+     *
+     * @tparam T             C++ data type to retrieve the data as
+     * @param property_name  std::string with the D-Bus object property name
+     *
+     * @return Returns the value as T
+     * @throws DBus::Proxy::Exception if the property could not be retrieved
+     */
+    template <typename T>
+    T GetProperty(const std::string &property_name)
+    {
+        GVariant *res = GetPropertyGVariant(property_name);
+        T ret = glib2::Value::Get<T>(res);
+        g_variant_unref(res);
+        return ret;
+    }
+
+
+    /**
+     *  Retrieve an array property value from the cache as a C++ vector
+     *  with the expected data type.
+     *
+     *  NOTE: The C++ data type MUST match the D-Bus property data type
+     *
+     * @tparam T             C++ vector data type to retrieve the data as
+     * @param property_name  std::string with the D-Bus object property name
+     *
+     * @return Returns the value as std::vector<T>
+     * @throws DBus::Proxy::Exception if the property could not be retrieved
+     */
+    template <typename T>
+    std::vector<T> GetPropertyArray(const std::string &property_name)
+    {
+        GVariant *res = GetPropertyGVariant(property_name);
+        return glib2::Value::ExtractVector<T>(res, nullptr, false);
+    }
+
+
+    /**
+     *  Check if a property is currently available in the cache
+     *
+     * @param property_name  std::string with the D-Bus object property name
+     *
+     * @return true if the property value is cached, otherwise false
+     */
+    bool IsCached(const std::string &property_name) const;
+
+
+    /**
+     *  Reload all the property values from the service
+     *
+     * @throws DBus::Proxy::Exception if the properties could not be retrieved
+     */
+    void Refresh();
+
+
+  private:
+    Client::Ptr proxy = nullptr;
+    TargetPreset::Ptr preset = nullptr;
+    Signals::SubscriptionManager::Ptr subscriptions = nullptr;
+    Signals::Target::Ptr signal_target = nullptr;
+    mutable std::mutex cache_mtx{};
+    std::map<std::string, GVariant *> cache{};
+
+    PropertyCache(Client::Ptr proxy_,
+                  TargetPreset::Ptr preset_,
+                  Signals::SubscriptionManager::Ptr subscriptions_);
+
+    void update_value(const std::string &property_name, GVariant *value);
+    void invalidate_value(const std::string &property_name);
+    void properties_changed(Signals::Event::Ptr &event);
+};
+
+} // namespace Proxy
+} // namespace DBus
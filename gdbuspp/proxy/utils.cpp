@@ -13,6 +13,16 @@
  */
 
 
+#include <map>
+#include <mutex>
+#include <set>
+#include <utility>
+#include <vector>
+#include <glib.h>
+#include <gio/gio.h>
+
+#define GDBUSPP_LOG_CATEGORY PROXY
+#include "../features/debug-log.hpp"
 #include "../object/path.hpp"
 #include "utils.hpp"
 
@@ -22,6 +32,484 @@ namespace Proxy {
 namespace Utils {
 
 
+namespace _private {
+
+/**
+ *  Cache of the unique bus names of well-known bus names.  The cache is
+ *  updated by a D-Bus connection message filter which processes the
+ *  org.freedesktop.DBus.NameOwnerChanged signals for the names being
+ *  tracked.  Message filters are run in the glib2 D-Bus worker thread,
+ *  so this works without any main loop running.
+ *
+ *  Other caches tied to bus names are notified about the owner changes
+ *  via listeners, see DBusServiceQuery::AddNameOwnerListener().
+ */
+class NameOwnerCache
+{
+  public:
+    using Listener = DBusServiceQuery::NameOwnerListener;
+
+    /**
+     *  Look up a bus name in the cache
+     *
+     * @param name    std::string with the bus name to look up
+     * @param owner   std::string where the unique bus name will be stored
+     * @param gen     uint64_t where the current update generation of the
+     *                bus name is stored.  Used with @Store()
+     *
+     * @return true if the name was found in the cache, otherwise false
+     */
+    bool Lookup(const std::string &name, std::string &owner, uint64_t &gen)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        gen = generation[name];
+        auto it = owners.find(name);
+        if (owners.end() == it)
+        {
+            return false;
+        }
+        owner = it->second;
+        return true;
+    }
+
+
+    /**
+     *  Store a looked up unique bus name in the cache, unless a
+     *  NameOwnerChanged signal for the same name has been processed since
+     *  the @Lookup() call; the result might then already be outdated.
+     *
+     * @param name    std::string with the well-known bus name
+     * @param owner   std::string with the unique bus name
+     * @param gen     uint64_t with the generation provided by @Lookup()
+     */
+    void Store(const std::string &name, const std::string &owner, uint64_t gen)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        if (generation[name] == gen)
+        {
+            owners[name] = owner;
+        }
+    }
+
+
+    /**
+     *  Mark a bus name as being tracked
+     *
+     * @param name   std::string with the bus name
+     *
+     * @return true if the name was not tracked earlier.  The caller is
+     *         then responsible for adding the D-Bus match rule for the
+     *         NameOwnerChanged signal for this name.
+     */
+    bool Track(const std::string &name)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        return tracked.insert(name).second;
+    }
+
+
+    /**
+     *  Stop tracking a unique bus name.  Well-known bus names stay
+     *  tracked, as their owners are cached.
+     *
+     * @param name          std::string with the bus name
+     * @param remove_match  bool flag; if true, the D-Bus match rule for
+     *                      this name is to be removed.  See @TakeStale()
+     */
+    void Untrack(const std::string &name, const bool remove_match = true)
+    {
+        if (name.empty() || ':' != name[0])
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lg(mtx);
+        if (tracked.erase(name) > 0 && remove_match)
+        {
+            stale.push_back(name);
+        }
+    }
+
+
+    /**
+     *  Retrieve all the tracked names
+     *
+     * @return std::vector<std::string> of bus names
+     */
+    std::vector<std::string> GetTracked()
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        return std::vector<std::string>(tracked.begin(), tracked.end());
+    }
+
+
+    /**
+     *  Retrieve the names not tracked any more, where the D-Bus match
+     *  rule has not yet been removed.  The caller is responsible for
+     *  removing these match rules.
+     *
+     * @return std::vector<std::string> of bus names
+     */
+    std::vector<std::string> TakeStale()
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        std::vector<std::string> ret{};
+        ret.swap(stale);
+        return ret;
+    }
+
+
+    uint64_t AddListener(Listener listener)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        listeners[++last_listener_id] = std::move(listener);
+        return last_listener_id;
+    }
+
+
+    void RemoveListener(const uint64_t id)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        listeners.erase(id);
+    }
+
+
+    static GDBusMessage *message_filter(GDBusConnection *conn,
+                                        GDBusMessage *msg,
+                                        gboolean incoming,
+                                        gpointer user_data)
+    {
+        if (!incoming
+            || G_DBUS_MESSAGE_TYPE_SIGNAL != g_dbus_message_get_message_type(msg)
+            || g_strcmp0(g_dbus_message_get_member(msg), "NameOwnerChanged") != 0
+            || g_strcmp0(g_dbus_message_get_interface(msg), "org.freedesktop.DBus") != 0
+            || g_strcmp0(g_dbus_message_get_sender(msg), "org.freedesktop.DBus") != 0)
+        {
+            return msg;
+        }
+
+        GVariant *body = g_dbus_message_get_body(msg);
+        if (!body || !g_variant_is_of_type(body, G_VARIANT_TYPE("(sss)")))
+        {
+            return msg;
+        }
+        const gchar *name = nullptr;
+        const gchar *new_owner = nullptr;
+        g_variant_get(body, "(&s&s&s)", &name, nullptr, &new_owner);
+
+        auto self = *static_cast<std::shared_ptr<NameOwnerCache> *>(user_data);
+        self->owner_changed(name, new_owner);
+        return msg;
+    }
+
+
+    static void destroy_filter_data(gpointer user_data)
+    {
+        delete static_cast<std::shared_ptr<NameOwnerCache> *>(user_data);
+    }
+
+
+  private:
+    std::mutex mtx{};
+    std::map<std::string, std::string> owners{};
+    std::map<std::string, uint64_t> generation{};
+    std::set<std::string> tracked{};
+    std::vector<std::string> stale{};
+    std::map<uint64_t, Listener> listeners{};
+    uint64_t last_listener_id = 0;
+
+
+    void owner_changed(const std::string &name, const std::string &new_owner)
+    {
+        std::vector<Listener> notify{};
+        {
+            std::lock_guard<std::mutex> lg(mtx);
+            if (tracked.find(name) == tracked.end())
+            {
+                return;
+            }
+            ++generation[name];
+            if (new_owner.empty())
+            {
+                owners.erase(name);
+                if (':' == name[0])
+                {
+                    // Unique bus names are never reused; the match
+                    // rule is not needed any more
+                    tracked.erase(name);
+                    generation.erase(name);
+                    stale.push_back(name);
+                }
+            }
+            else
+            {
+                owners[name] = new_owner;
+            }
+            for (const auto &l : listeners)
+            {
+                notify.push_back(l.second);
+            }
+        }
+
+        // The listeners may use their own locks; call them without
+        // holding this lock
+        for (const auto &listener : notify)
+        {
+            listener(name, new_owner);
+        }
+    }
+};
+
+
+/**
+ *  Cache of the parsed introspection data of the objects in a single
+ *  D-Bus service.  The cached data is tied to the unique bus name of the
+ *  service; it is flushed once the service has a new owner.
+ */
+class IntrospectionCache
+{
+  public:
+    using NodeInfo = std::shared_ptr<GDBusNodeInfo>;
+
+    IntrospectionCache(DBus::Connection::Ptr conn, const std::string &dest)
+        : connection(conn), destination(dest)
+    {
+    }
+
+
+    /**
+     *  Retrieve the current unique bus name of the service.  For
+     *  well-known bus names, this is looked up via the DBusServiceQuery
+     *  object of the connection, which caches the result until a
+     *  NameOwnerChanged signal is received for the name.
+     *
+     * @return std::string with the unique bus name
+     * @throws DBusServiceQuery::Exception if the name has no owner
+     */
+    std::string GetOwner()
+    {
+        if (!destination.empty() && ':' == destination[0])
+        {
+            return destination;
+        }
+
+        DBusServiceQuery::Ptr srvqry = nullptr;
+        {
+            std::lock_guard<std::mutex> lg(mtx);
+            if (!service_query)
+            {
+                service_query = DBusServiceQuery::Create(connection);
+            }
+            srvqry = service_query;
+        }
+        return srvqry->GetNameOwner(destination);
+    }
+
+
+    /**
+     *  Look up the introspection data of an object path.  If the
+     *  service has changed owner since the data was cached, the
+     *  whole cache is flushed.
+     *
+     * @param owner   std::string with the current unique bus name
+     * @param path    std::string with the object path
+     *
+     * @return NodeInfo with the cached data, nullptr if not cached
+     */
+    NodeInfo Lookup(const std::string &owner, const std::string &path)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        if (owner != cached_owner)
+        {
+            nodes.clear();
+            cached_owner = owner;
+            return nullptr;
+        }
+        auto it = nodes.find(path);
+        return (nodes.end() != it ? it->second : nullptr);
+    }
+
+
+    /**
+     *  Store the introspection data of an object path, unless the
+     *  service has changed owner since the data was retrieved
+     *
+     * @param owner   std::string with the unique bus name the data
+     *                was retrieved from
+     * @param path    std::string with the object path
+     * @param node    NodeInfo with the parsed data
+     */
+    void Store(const std::string &owner, const std::string &path, NodeInfo node)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        if (owner == cached_owner)
+        {
+            nodes[path] = node;
+        }
+    }
+
+
+    void Clear() noexcept
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        nodes.clear();
+        cached_owner.clear();
+    }
+
+
+  private:
+    DBus::Connection::Ptr connection = nullptr;
+    const std::string destination;
+    std::mutex mtx{};
+    DBusServiceQuery::Ptr service_query = nullptr;
+    std::string cached_owner{};
+    std::map<std::string, NodeInfo> nodes{};
+};
+
+
+/**
+ *  Registry of the IntrospectionCache objects per D-Bus connection
+ *  and destination
+ */
+std::mutex introsp_registry_mtx;
+std::map<std::pair<GDBusConnection *, std::string>, std::weak_ptr<IntrospectionCache>> introsp_registry;
+
+
+/**
+ *  Registry of the DBusServiceQuery object used by each D-Bus connection
+ */
+std::mutex srvqry_registry_mtx;
+std::map<GDBusConnection *, std::weak_ptr<DBusServiceQuery>> srvqry_registry;
+
+
+/**
+ *  Generate the D-Bus match rule for the NameOwnerChanged signal of
+ *  a specific bus name
+ *
+ * @param name   std::string of the bus name
+ * @return std::string with the match rule
+ */
+static std::string name_owner_match_rule(const std::string &name)
+{
+    return "type='signal',"
+           "sender='org.freedesktop.DBus',"
+           "interface='org.freedesktop.DBus',"
+           "member='NameOwnerChanged',"
+           "path='/org/freedesktop/DBus',"
+           "arg0='"
+           + name + "'";
+}
+
+
+/**
+ *  Waits for a D-Bus name to get an owner, by listening for the
+ *  org.freedesktop.DBus.NameOwnerChanged signal for this name.
+ *
+ *  The signal is processed via a private glib2 main context, so this
+ *  works regardless of any other main loop running in the program.
+ *  The subscription is active from the moment this object is created.
+ */
+class NameOwnerWait
+{
+  public:
+    NameOwnerWait(DBus::Connection::Ptr conn, const std::string &service)
+        : connection(conn), context(g_main_context_new())
+    {
+        g_main_context_push_thread_default(context);
+        signal_id = g_dbus_connection_signal_subscribe(connection->ConnPtr(),
+                                                       "org.freedesktop.DBus",
+                                                       "org.freedesktop.DBus",
+                                                       "NameOwnerChanged",
+                                                       "/org/freedesktop/DBus",
+                                                       service.c_str(), // arg0
+                                                       G_DBUS_SIGNAL_FLAGS_NONE,
+                                                       name_owner_changed,
+                                                       this,
+                                                       nullptr);
+        g_main_context_pop_thread_default(context);
+    }
+
+    ~NameOwnerWait() noexcept
+    {
+        if (signal_id > 0)
+        {
+            g_dbus_connection_signal_unsubscribe(connection->ConnPtr(), signal_id);
+        }
+        // Flush out any pending events, which will be ignored
+        // since the subscription is gone
+        while (g_main_context_iteration(context, false))
+        {
+        }
+        g_main_context_unref(context);
+    }
+
+    NameOwnerWait(const NameOwnerWait &) = delete;
+    NameOwnerWait &operator=(const NameOwnerWait &) = delete;
+
+
+    /**
+     *  Wait until the name has an owner or the timeout is reached
+     *
+     * @param timeout  Number of seconds to wait
+     *
+     * @return true if the name got an owner, false on timeout
+     */
+    bool Wait(const uint8_t timeout)
+    {
+        if (0 == signal_id)
+        {
+            return false;
+        }
+        GSource *timer = g_timeout_source_new(timeout * 1000);
+        g_source_set_callback(timer, timeout_reached, this, nullptr);
+        g_source_attach(timer, context);
+
+        while (!appeared && !timed_out)
+        {
+            g_main_context_iteration(context, true);
+        }
+        g_source_destroy(timer);
+        g_source_unref(timer);
+        return appeared;
+    }
+
+
+  private:
+    DBus::Connection::Ptr connection = nullptr;
+    GMainContext *context = nullptr;
+    guint signal_id = 0;
+    bool appeared = false;
+    bool timed_out = false;
+
+
+    static void name_owner_changed(GDBusConnection *conn,
+                                   const gchar *sender,
+                                   const gchar *obj_path,
+                                   const gchar *intf_name,
+                                   const gchar *sign_name,
+                                   GVariant *params,
+                                   gpointer this_ptr)
+    {
+        auto self = static_cast<NameOwnerWait *>(this_ptr);
+        const gchar *new_owner = nullptr;
+        g_variant_get(params, "(&s&s&s)", nullptr, nullptr, &new_owner);
+        if (new_owner && new_owner[0] != '\0')
+        {
+            self->appeared = true;
+        }
+    }
+
+
+    static gboolean timeout_reached(gpointer this_ptr)
+    {
+        static_cast<NameOwnerWait *>(this_ptr)->timed_out = true;
+        return G_SOURCE_REMOVE;
+    }
+};
+
+} // namespace _private
+
+
+
 Query::Ptr Query::Create(Proxy::Client::Ptr proxy)
 {
     if (!proxy)
@@ -64,23 +552,108 @@ const std::string Query::Introspect(const Object::Path &path) const
 }
 
 
+std::shared_ptr<GDBusNodeInfo> Query::IntrospectNode(const Object::Path &path) const
+{
+    std::string owner;
+    try
+    {
+        owner = introsp_cache->GetOwner();
+    }
+    catch (const DBusServiceQuery::Exception &excp)
+    {
+        throw Proxy::Exception(proxy->GetDestination(),
+                               path,
+                               "org.freedesktop.DBus.Introspectable",
+                               "Introspect",
+                               excp.GetRawError());
+    }
+
+    auto node = introsp_cache->Lookup(owner, path);
+    return (node ? node : introspect_uncached(path, owner));
+}
+
+
+std::vector<Object::Path> Query::GetChildNodes(const Object::Path &path) const
+{
+    auto node = IntrospectNode(path);
+    const std::string prefix = ("/" == path ? "/" : path + "/");
+
+    std::vector<Object::Path> ret;
+    for (size_t i = 0; node->nodes && node->nodes[i]; ++i)
+    {
+        const gchar *child = node->nodes[i]->path;
+        if (child && '\0' != child[0])
+        {
+            ret.emplace_back('/' == child[0] ? std::string(child) : prefix + child);
+        }
+    }
+    return ret;
+}
+
+
+void Query::InvalidateIntrospection() const noexcept
+{
+    introsp_cache->Clear();
+}
+
+
+std::shared_ptr<GDBusNodeInfo> Query::introspect_uncached(const Object::Path &path,
+                                                          const std::string &owner) const
+{
+    const std::string xml = Introspect(path);
+    GError *err = nullptr;
+    GDBusNodeInfo *info = g_dbus_node_info_new_for_xml(xml.c_str(), &err);
+    if (!info)
+    {
+        throw Proxy::Exception(proxy->GetDestination(),
+                               path,
+                               "org.freedesktop.DBus.Introspectable",
+                               "Introspect",
+                               "Could not parse the introspection data",
+                               err);
+    }
+
+    std::shared_ptr<GDBusNodeInfo> node(info, g_dbus_node_info_unref);
+    if (!owner.empty())
+    {
+        introsp_cache->Store(owner, path, node);
+    }
+    return node;
+}
+
+
 const bool Query::CheckObjectExists(const Object::Path &path,
                                     const std::string interface) const noexcept
 {
-    auto target = Proxy::TargetPreset::Create(path,
-                                              "org.freedesktop.DBus.Properties");
     for (int i = 15; i > 0; --i)
     {
         try
         {
-            GVariant *ignore = proxy->Call(target,
-                                           "GetAll",
-                                           glib2::Value::CreateTupleWrapped(interface));
-            if (ignore)
+            std::string owner{};
+            try
             {
-                g_variant_unref(ignore);
+                owner = introsp_cache->GetOwner();
             }
-            return true;
+            catch (const DBusServiceQuery::Exception &)
+            {
+                // The service is not on the bus (yet).  Introspecting
+                // it via its bus name below lets the bus start a D-Bus
+                // activatable service; the result is not cached.
+            }
+
+            if (!owner.empty())
+            {
+                auto node = introsp_cache->Lookup(owner, path);
+                if (node && g_dbus_node_info_lookup_interface(node.get(), interface.c_str()))
+                {
+                    return true;
+                }
+            }
+
+            // Not cached yet, or the interface might have been
+            // added after the data was cached
+            auto node = introspect_uncached(path, owner);
+            return nullptr != g_dbus_node_info_lookup_interface(node.get(), interface.c_str());
         }
         catch (const Proxy::Exception &excp)
         {
@@ -94,6 +667,11 @@ const bool Query::CheckObjectExists(const Object::Path &path,
             {
                 return false;
             }
+            if (err.find("org.freedesktop.DBus.Error.ServiceUnknown") != std::string::npos)
+            {
+                // Not on the bus and not D-Bus activatable
+                return false;
+            }
             usleep(100000);
         }
     }
@@ -101,6 +679,19 @@ const bool Query::CheckObjectExists(const Object::Path &path,
 }
 
 
+GVariant *Query::GetManagedObjects(const Object::Path &root) const
+{
+    GVariant *res = proxy->Call(root,
+                                "org.freedesktop.DBus.ObjectManager",
+                                "GetManagedObjects",
+                                nullptr);
+    glib2::Utils::checkParams(__func__, res, "(a{oa{sa{sv}}})", 1);
+    GVariant *ret = g_variant_get_child_value(res, 0);
+    g_variant_unref(res);
+    return ret;
+}
+
+
 const std::string Query::ServiceVersion(const Object::Path &path,
                                         const std::string interface) const
 {
@@ -144,6 +735,22 @@ const std::string Query::ServiceVersion(const Object::Path &path,
 Query::Query(Proxy::Client::Ptr proxy_)
     : proxy(proxy_)
 {
+    // Share the introspection cache with the other Query objects
+    // for the same service on the same connection
+    auto conn = proxy->GetConnection();
+    std::lock_guard<std::mutex> lg(_private::introsp_registry_mtx);
+    for (auto it = _private::introsp_registry.begin(); it != _private::introsp_registry.end();)
+    {
+        it = (it->second.expired() ? _private::introsp_registry.erase(it) : std::next(it));
+    }
+    auto &entry = _private::introsp_registry[{conn->ConnPtr(), proxy->GetDestination()}];
+    introsp_cache = entry.lock();
+    if (!introsp_cache)
+    {
+        introsp_cache = std::make_shared<_private::IntrospectionCache>(conn,
+                                                                      proxy->GetDestination());
+        entry = introsp_cache;
+    }
 }
 
 
@@ -165,7 +772,16 @@ DBusServiceQuery::Ptr DBusServiceQuery::Create(DBus::Connection::Ptr connection)
     {
         throw DBus::Proxy::Exception("Invalid DBus::Connection object");
     }
-    return DBusServiceQuery::Ptr(new DBusServiceQuery(connection));
+
+    std::lock_guard<std::mutex> lg(_private::srvqry_registry_mtx);
+    auto &entry = _private::srvqry_registry[connection->ConnPtr()];
+    DBusServiceQuery::Ptr srvqry = entry.lock();
+    if (!srvqry)
+    {
+        srvqry = DBusServiceQuery::Ptr(new DBusServiceQuery(connection));
+        entry = srvqry;
+    }
+    return srvqry;
 }
 
 
@@ -190,14 +806,43 @@ const uint32_t DBusServiceQuery::StartServiceByName(const std::string &service)
 
 const std::string DBusServiceQuery::GetNameOwner(const std::string &service) const
 {
+    // Unique bus names never change owner; only cache well-known names
+    const bool cacheable = (!service.empty() && ':' != service[0]);
+    std::string owner{};
+    uint64_t gen = 0;
+    if (cacheable && name_cache->Lookup(service, owner, gen))
+    {
+        return owner;
+    }
+
     try
     {
+        if (cacheable && name_cache->Track(service))
+        {
+            // Ensure the D-Bus daemon sends us the NameOwnerChanged
+            // signals for this name, to keep the cache current.
+            GVariant *r = proxy->Call("/org/freedesktop/DBus",
+                                      "org.freedesktop.DBus",
+                                      "AddMatch",
+                                      glib2::Value::CreateTupleWrapped(
+                                          _private::name_owner_match_rule(service)));
+            g_variant_unref(r);
+
+            // Signals may have been processed while adding the match;
+            // refresh the generation counter
+            (void)name_cache->Lookup(service, owner, gen);
+        }
+
         GVariant *res = proxy->Call("/",
                                     "org.freedesktop.DBus",
                                     "GetNameOwner",
                                     glib2::Value::CreateTupleWrapped(service));
         auto ret = glib2::Value::Extract<std::string>(res, 0);
         g_variant_unref(res);
+        if (cacheable)
+        {
+            name_cache->Store(service, ret, gen);
+        }
         return ret;
     }
     catch (const Proxy::Exception &excp)
@@ -207,24 +852,121 @@ const std::string DBusServiceQuery::GetNameOwner(const std::string &service) con
 }
 
 
-const bool DBusServiceQuery::LookupService(const std::string &service) const
+void DBusServiceQuery::TrackName(const std::string &name) const
+{
+    remove_matches(name_cache->TakeStale());
+    if (!name_cache->Track(name))
+    {
+        return;
+    }
+
+    try
+    {
+        GVariant *r = proxy->Call("/org/freedesktop/DBus",
+                                  "org.freedesktop.DBus",
+                                  "AddMatch",
+                                  glib2::Value::CreateTupleWrapped(
+                                      _private::name_owner_match_rule(name)));
+        g_variant_unref(r);
+    }
+    catch (const Proxy::Exception &excp)
+    {
+        name_cache->Untrack(name, false);
+        throw DBusServiceQuery::Exception(name, excp.GetRawError());
+    }
+}
+
+
+void DBusServiceQuery::UntrackName(const std::string &name) const noexcept
+{
+    name_cache->Untrack(name);
+}
+
+
+uint64_t DBusServiceQuery::AddNameOwnerListener(NameOwnerListener listener) const
+{
+    return name_cache->AddListener(std::move(listener));
+}
+
+
+void DBusServiceQuery::RemoveNameOwnerListener(const uint64_t id) const noexcept
+{
+    name_cache->RemoveListener(id);
+}
+
+
+void DBusServiceQuery::PrefetchNameOwner(const std::string &service) const noexcept
+{
+    if (service.empty() || ':' == service[0])
+    {
+        return;
+    }
+
+    std::string owner{};
+    uint64_t gen = 0;
+    if (name_cache->Lookup(service, owner, gen) || !name_cache->Track(service))
+    {
+        // Already cached or a lookup has been started earlier
+        return;
+    }
+
+    try
+    {
+        // The D-Bus daemon processes the calls in order, so the
+        // match rule is active before the owner is looked up.  Any
+        // NameOwnerChanged signal processed in between bumps the
+        // generation, and the lookup result is then not stored.
+        proxy->CallAsync("/org/freedesktop/DBus",
+                         "org.freedesktop.DBus",
+                         "AddMatch",
+                         glib2::Value::CreateTupleWrapped(_private::name_owner_match_rule(service)),
+                         [](GVariant *res, std::exception_ptr)
+                         {
+                             if (res)
+                             {
+                                 g_variant_unref(res);
+                             }
+                         });
+
+        auto cache = name_cache;
+        proxy->CallAsync("/",
+                         "org.freedesktop.DBus",
+                         "GetNameOwner",
+                         glib2::Value::CreateTupleWrapped(service),
+                         [cache, service, gen](GVariant *res, std::exception_ptr error)
+                         {
+                             if (!res)
+                             {
+                                 return;
+                             }
+                             if (!error)
+                             {
+                                 cache->Store(service,
+                                              glib2::Value::Extract<std::string>(res, 0),
+                                              gen);
+                             }
+                             g_variant_unref(res);
+                         });
+    }
+    catch (const DBus::Exception &excp)
+    {
+        GDBUSPP_LOG("DBusServiceQuery::PrefetchNameOwner(" << service << ") failed: "
+                                                           << excp.GetRawError());
+    }
+}
+
+
+const bool DBusServiceQuery::NameHasOwner(const std::string &service) const
 {
     try
     {
         GVariant *res = proxy->Call("/",
                                     "org.freedesktop.DBus",
-                                    "ListNames",
-                                    nullptr);
-        auto list = glib2::Value::ExtractVector<std::string>(res, 0);
-
-        for (const auto &srv : list)
-        {
-            if (srv == service)
-            {
-                return true;
-            }
-        }
-        return false;
+                                    "NameHasOwner",
+                                    glib2::Value::CreateTupleWrapped(service));
+        auto ret = glib2::Value::Extract<bool>(res, 0);
+        g_variant_unref(res);
+        return ret;
     }
     catch (const Proxy::Exception &excp)
     {
@@ -233,13 +975,19 @@ const bool DBusServiceQuery::LookupService(const std::string &service) const
 }
 
 
+const bool DBusServiceQuery::LookupService(const std::string &service) const
+{
+    return NameHasOwner(service);
+}
+
+
 const bool DBusServiceQuery::LookupActivatable(const std::string &service) const
 {
-    GVariant *res = proxy->Call("/",
-                                "org.freedesktop.DBus",
-                                "ListActivatableNames",
-                                nullptr);
-    auto list = glib2::Value::ExtractVector<std::string>(res, 0);
+    glib2::Variant res(proxy->Call("/",
+                                   "org.freedesktop.DBus",
+                                   "ListActivatableNames",
+                                   nullptr));
+    auto list = glib2::Value::ExtractStringViews(std::move(res));
 
     for (const auto &srv : list)
     {
@@ -255,71 +1003,116 @@ const bool DBusServiceQuery::LookupActivatable(const std::string &service) const
 const bool DBusServiceQuery::CheckServiceAvail(const std::string &service,
                                                uint8_t timeout) const noexcept
 {
-    // Check if the service is already running
-    if (LookupService(service))
-    {
-        return true;
-    }
-
-    // If not, identify if this service can be started via the
-    // org.freedesktop.DBus.StartServiceByName() call to the D-Bus daemon
-    bool activatable = true;
     try
     {
-        activatable = LookupActivatable(service);
-    }
-    catch (const DBus::Exception &)
-    {
-        // If this lookup failed, presume it is possible to activate the
-        // service.  If it is completely impossible to start the service,
-        // that will be caught in by the StartServiveByName() call below.
-    }
+        // Check if the service is already running
+        if (NameHasOwner(service))
+        {
+            return true;
+        }
 
-    int iterations = timeout * 3; // 3 iterations takes about 1 second
-    for (int i = iterations; i > 0; --i)
-    {
+        // Start watching for the service to appear before trying to
+        // start it, to not lose the NameOwnerChanged signal
+        _private::NameOwnerWait waiter(proxy->GetConnection(), service);
+
+        // If not, identify if this service can be started via the
+        // org.freedesktop.DBus.StartServiceByName() call to the D-Bus daemon
+        bool activatable = true;
         try
         {
-            // If the service is listed as an activatable service,
-            // The org.freedesktop.DBus.StartServiceByName() can be called
-            // without getting an error.  This indicates the service has
-            // a /usr/share/dbus-1/{services,system-services}/*.service file
-            // configured.
-            if (activatable)
+            activatable = LookupActivatable(service);
+        }
+        catch (const DBus::Exception &)
+        {
+            // If this lookup failed, presume it is possible to activate the
+            // service.  If it is completely impossible to start the service,
+            // that will be caught in by the StartServiveByName() call below.
+        }
+
+        if (activatable)
+        {
+            try
             {
+                // If the service is listed as an activatable service,
+                // The org.freedesktop.DBus.StartServiceByName() can be called
+                // without getting an error.  This indicates the service has
+                // a /usr/share/dbus-1/{services,system-services}/*.service
+                // file configured.
                 (void)StartServiceByName(service);
             }
-
-            if (LookupService(service))
+            catch (const DBusServiceQuery::Exception &)
             {
-                return true;
+                // The service may still appear by other means; wait for it
             }
-            usleep(300000);
         }
-        catch (const DBusServiceQuery::Exception &)
-        {
-            if (!activatable)
-            {
-                // Quick exit - if the service can't be auto-started
-                // via org.freedesktop.DBus.StartServiceByName(), there
-                // are no point retrying the same loop more times.
-                return false;
-            }
 
-            // If the service can be auto-started, the GetNameOwner()
-            // call failed - which can mean the service did respond to
-            // the auto-start request but hasn't settled yet - just wait
-            // a little bit before retrying.
-            usleep(300000);
+        // The service might have appeared while the watch was set up
+        if (NameHasOwner(service))
+        {
+            return true;
         }
+        return waiter.Wait(timeout);
+    }
+    catch (const DBus::Exception &)
+    {
+        return false;
     }
-    return false;
 }
 
 
 DBusServiceQuery::DBusServiceQuery(DBus::Connection::Ptr connection)
-    : proxy(Proxy::Client::Create(connection, "org.freedesktop.DBus"))
+    : proxy(Proxy::Client::Create(connection, "org.freedesktop.DBus")),
+      name_cache(std::make_shared<_private::NameOwnerCache>())
+{
+    filter_id = g_dbus_connection_add_filter(connection->ConnPtr(),
+                                             _private::NameOwnerCache::message_filter,
+                                             new std::shared_ptr<_private::NameOwnerCache>(name_cache),
+                                             _private::NameOwnerCache::destroy_filter_data);
+}
+
+
+DBusServiceQuery::~DBusServiceQuery() noexcept
+{
+    auto conn = proxy->GetConnection();
+    if (filter_id > 0)
+    {
+        g_dbus_connection_remove_filter(conn->ConnPtr(), filter_id);
+    }
+
+    remove_matches(name_cache->GetTracked());
+    remove_matches(name_cache->TakeStale());
+
+    std::lock_guard<std::mutex> lg(_private::srvqry_registry_mtx);
+    auto it = _private::srvqry_registry.find(conn->ConnPtr());
+    if (_private::srvqry_registry.end() != it && it->second.expired())
+    {
+        _private::srvqry_registry.erase(it);
+    }
+}
+
+
+void DBusServiceQuery::remove_matches(const std::vector<std::string> &names) const noexcept
 {
+    if (names.empty() || !proxy->GetConnection()->Check())
+    {
+        return;
+    }
+    for (const auto &name : names)
+    {
+        try
+        {
+            proxy->Call("/org/freedesktop/DBus",
+                        "org.freedesktop.DBus",
+                        "RemoveMatch",
+                        glib2::Value::CreateTupleWrapped(
+                            _private::name_owner_match_rule(name)),
+                        true);
+        }
+        catch (const DBus::Exception &)
+        {
+            // Ignore errors; the connection might be closing down
+        }
+    }
 }
 
 
@@ -16,8 +16,11 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <string>
+#include <vector>
+#include <gio/gio.h>
 
 #include "../connection.hpp"
 #include "../object/path.hpp"
@@ -28,6 +31,11 @@ namespace DBus {
 namespace Proxy {
 namespace Utils {
 
+namespace _private {
+class IntrospectionCache;
+class NameOwnerCache;
+} // namespace _private
+
 
 /**
  *  Provides some generic functionality to test if a D-Bus service is
@@ -69,9 +77,51 @@ class Query
      */
     const std::string Introspect(const Object::Path &path) const;
 
+    /**
+     *  Retrieve the parsed introspection data of a D-Bus object.
+     *
+     *  The parsed data is cached per D-Bus service, shared by all the
+     *  Query objects for the same service on the same connection.  The
+     *  cache is flushed when the service changes owner on the bus, which
+     *  is tracked via the org.freedesktop.DBus.NameOwnerChanged signal
+     *  by the DBusServiceQuery object of the connection.  Objects added
+     *  or removed by the running service are not noticed; see
+     *  @InvalidateIntrospection().
+     *
+     * @param path    DBus::Object::Path to introspect in the service
+     *
+     * @return std::shared_ptr<GDBusNodeInfo> with the parsed data
+     * @throws DBus::Proxy::Exception if the introspection failed
+     */
+    std::shared_ptr<GDBusNodeInfo> IntrospectNode(const Object::Path &path) const;
+
+    /**
+     *  Retrieve the object paths of the child nodes of a D-Bus object,
+     *  based on the cached introspection data from @IntrospectNode()
+     *
+     * @param path    DBus::Object::Path of the parent object
+     *
+     * @return std::vector<Object::Path> with the full object paths
+     * @throws DBus::Proxy::Exception if the introspection failed
+     */
+    std::vector<Object::Path> GetChildNodes(const Object::Path &path) const;
+
+    /**
+     *  Flush the cached introspection data of this D-Bus service
+     */
+    void InvalidateIntrospection() const noexcept;
+
     /**
      *  Does a few checks to try to reach a D-Bus object in the service.
      *
+     *  The check is done via the cached introspection data of the
+     *  object, see @IntrospectNode().  If the interface is not found
+     *  in the cached data, the object is introspected once more before
+     *  giving up, in case it was added after the data was cached.
+     *
+     *  If the service bus name has no owner, the object is introspected
+     *  via the bus name, which starts a D-Bus activatable service.
+     *
      * @param path        D-Bus object path to look for
      * @param interface   D-Bus interface in the object
      *
@@ -95,10 +145,34 @@ class Query
     const std::string ServiceVersion(const Object::Path &path,
                                      const std::string interface) const;
 
+    /**
+     *  Retrieve all the D-Bus objects, their interfaces and properties
+     *  in a single call via the org.freedesktop.DBus.ObjectManager
+     *  interface.  The service must export this interface on the root
+     *  path, see DBus::Object::Manager::EnableObjectManager().
+     *
+     * @param root   DBus::Object::Path where the service exports the
+     *               org.freedesktop.DBus.ObjectManager interface
+     *
+     * @return GVariant* with the a{oa{sa{sv}}} formatted result from
+     *         GetManagedObjects.  The caller must release it with
+     *         g_variant_unref()
+     *
+     * @throws DBus::Proxy::Exception if the call failed
+     */
+    GVariant *GetManagedObjects(const Object::Path &root) const;
+
   private:
     Proxy::Client::Ptr proxy{nullptr};
+    std::shared_ptr<_private::IntrospectionCache> introsp_cache{nullptr};
 
     Query(Proxy::Client::Ptr proxy_);
+
+    /**
+     *  Introspect a D-Bus object and store the parsed data in the cache
+     */
+    std::shared_ptr<GDBusNodeInfo> introspect_uncached(const Object::Path &path,
+                                                       const std::string &owner) const;
 };
 
 
@@ -106,6 +180,12 @@ class Query
 /**
  *  A generic set of selected methods provided by the org.freedesktop.DBus
  *  service.
+ *
+ *  There is only one DBusServiceQuery object per DBus::Connection; it is
+ *  shared by all its users.  This object also keeps a cache of the
+ *  unique bus names of the well-known bus names looked up via
+ *  @GetNameOwner(), which is kept current by tracking the
+ *  org.freedesktop.DBus.NameOwnerChanged signal for these names.
  */
 class DBusServiceQuery
 {
@@ -120,7 +200,8 @@ class DBusServiceQuery
 
 
     /**
-     *  Prepare a DBusServiceQuery object
+     *  Retrieve the DBusServiceQuery object for a D-Bus connection.  If
+     *  one does not exist already, it is created.
      *
      * @param connection   DBus::Connection::Ptr with the bus connection to use
      *
@@ -128,6 +209,8 @@ class DBusServiceQuery
      */
     [[nodiscard]] static DBusServiceQuery::Ptr Create(DBus::Connection::Ptr connection);
 
+    ~DBusServiceQuery() noexcept;
+
     /**
      *  Calls the org.freedesktop.DBus.StartServiceByName method
      *
@@ -147,6 +230,9 @@ class DBusServiceQuery
      *  This functionality is also available via the
      *  DBus::Credentials::Query::GetUniqueBusName() method
      *
+     *  The result is cached until the bus name changes owner or
+     *  disappears from the bus.
+     *
      *  https://dbus.freedesktop.org/doc/dbus-specification.html#bus-messages-get-name-owner
      *
      * @param service              D-Bus service name to query for
@@ -154,11 +240,88 @@ class DBusServiceQuery
      */
     const std::string GetNameOwner(const std::string &service) const;
 
+    /**
+     *  Start tracking the unique bus name of a well-known bus name in the
+     *  background.  This returns without waiting for the D-Bus daemon;
+     *  the result is stored in the same cache as used by @GetNameOwner().
+     *  Several names can be prefetched in parallel this way, instead of
+     *  doing one round trip to the D-Bus daemon per name.
+     *
+     *  Errors are ignored; a later @GetNameOwner() call for the same name
+     *  will then do a regular lookup.
+     *
+     * @param service   std::string with the well-known bus name
+     */
+    void PrefetchNameOwner(const std::string &service) const noexcept;
+
+
+    /**
+     *  Called for each org.freedesktop.DBus.NameOwnerChanged signal of
+     *  the tracked bus names.  This is called from the glib2 D-Bus worker
+     *  thread and must not block.
+     *
+     *  Arguments: the bus name and its new owner; empty if the bus name
+     *  disappeared.
+     */
+    using NameOwnerListener = std::function<void(const std::string &, const std::string &)>;
+
+    /**
+     *  Start tracking the owner changes of a bus name, which are reported
+     *  to the listeners added via @AddNameOwnerListener().  The D-Bus match
+     *  rule for the org.freedesktop.DBus.NameOwnerChanged signal of the
+     *  name is active when this returns.
+     *
+     *  Unique bus names are tracked until they disappear from the bus or
+     *  @UntrackName() is called.  Well-known bus names stay tracked.
+     *
+     * @param name   std::string with the bus name to track
+     *
+     * @throws DBusServiceQuery::Exception if the match rule could not be added
+     */
+    void TrackName(const std::string &name) const;
+
+    /**
+     *  Stop tracking a unique bus name tracked via @TrackName()
+     *
+     * @param name   std::string with the unique bus name
+     */
+    void UntrackName(const std::string &name) const noexcept;
+
+    /**
+     *  Add a listener for the owner changes of the tracked bus names
+     *
+     * @param listener  NameOwnerListener function to call
+     *
+     * @return uint64_t with the listener ID, used by @RemoveNameOwnerListener()
+     */
+    uint64_t AddNameOwnerListener(NameOwnerListener listener) const;
+
+    /**
+     *  Remove a listener added via @AddNameOwnerListener()
+     *
+     * @param id  uint64_t with the listener ID
+     */
+    void RemoveNameOwnerListener(const uint64_t id) const noexcept;
+
+
+    /**
+     *  Calls the org.freedesktop.DBus.NameHasOwner method, to check if
+     *  a bus name currently has an owner on the bus.
+     *
+     *  https://dbus.freedesktop.org/doc/dbus-specification.html#bus-messages-name-has-owner
+     *
+     * @param service  std::string with the bus name to check
+     * @return true if the bus name has an owner, otherwise false
+     *
+     * @throws DBusServiceQuery::Exception on errors
+     */
+    const bool NameHasOwner(const std::string &service) const;
+
 
     /**
      *  Looks up a specific busname of a service to see if it
-     *  is running.  This will use the org.freedesktop.DBus.ListNames method
-     *  for the lookup search.
+     *  is running.  This will use the org.freedesktop.DBus.NameHasOwner
+     *  method for the lookup.
      *
      * @param service  std::string with the bus name of the service.
      * @return true if the the service was found enlisted, otherwise false.
@@ -180,8 +343,10 @@ class DBusServiceQuery
 
     /**
      *  A more vigorous attempt of ensuring that a D-Bus service is alive and
-     *  available.  This will try 5 times before giving up, sleeping for a short
-     *  while in between each attempt.
+     *  available.  If the service is not running, it will try to start it
+     *  if it is activatable and then wait for the service name to appear
+     *  on the bus, via the org.freedesktop.DBus.NameOwnerChanged signal.
+     *  This returns as soon as the service appears.
 
      * @param service   D-Bus service well-known bus name to check for
      * @param timeout   How many seconds to wait for the service to respond.
@@ -194,8 +359,15 @@ class DBusServiceQuery
 
   private:
     Proxy::Client::Ptr proxy{nullptr};
+    std::shared_ptr<_private::NameOwnerCache> name_cache{nullptr};
+    guint filter_id = 0;
 
     DBusServiceQuery(DBus::Connection::Ptr connection);
+
+    /**
+     *  Remove the NameOwnerChanged match rules of the given bus names
+     */
+    void remove_matches(const std::vector<std::string> &names) const noexcept;
 };
 
 } // namespace Utils
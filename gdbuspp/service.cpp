@@ -13,11 +13,18 @@
  *         applications providing a service on the D-Bus.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
 #include <iostream>
 #include <string>
+#include <system_error>
+#include <thread>
 #include <glib.h>
 
+#define GDBUSPP_LOG_CATEGORY OBJECTS
 #include "connection.hpp"
+#include "features/debug-log.hpp"
 #include "glib2/callbacks.hpp"
 #include "mainloop.hpp"
 #include "service.hpp"
@@ -43,7 +50,8 @@ Object::Manager::Ptr Service::GetObjectManager() const noexcept
 }
 
 
-void Service::PrepareIdleDetector(const std::chrono::duration<uint32_t> timeout)
+void Service::PrepareIdleDetector(const std::chrono::duration<uint32_t> timeout,
+                                  const bool wait_for_requests)
 {
     if (std::chrono::duration<uint32_t>(0) == timeout)
     {
@@ -55,8 +63,8 @@ void Service::PrepareIdleDetector(const std::chrono::duration<uint32_t> timeout)
     {
         throw Service::Exception("Idle detection must be enabled before the main loop is created");
     }
-    service_mainloop = MainLoop::Create();
-    object_manager->PrepareIdleDetector(timeout, service_mainloop);
+    service_mainloop = service_mainloop_create();
+    object_manager->PrepareIdleDetector(timeout, service_mainloop, wait_for_requests);
 }
 
 
@@ -66,12 +74,86 @@ void Service::RunIdleDetector(const bool run)
 }
 
 
+void Service::ConfigureRequestPool(const AsyncProcess::Pool::Config &cfg)
+{
+    object_manager->ConfigureRequestPool(cfg);
+}
+
+
+void Service::AddStartupTask(StartupTask task)
+{
+    if (started)
+    {
+        throw Service::Exception("Startup tasks must be added before the service is started");
+    }
+    startup_tasks.push_back(std::move(task));
+}
+
+
+void Service::Start()
+{
+    if (started)
+    {
+        throw Service::Exception("The service has already been started");
+    }
+    started = true;
+
+    const auto begin = std::chrono::steady_clock::now();
+    std::vector<Object::Base::Ptr> objects = run_startup_tasks();
+    const auto built = std::chrono::steady_clock::now();
+    if (!objects.empty())
+    {
+        object_manager->RegisterObjects(objects);
+    }
+    const auto registered = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lg(startup_mtx);
+        startup_timings.build = std::chrono::duration_cast<std::chrono::microseconds>(built - begin);
+        startup_timings.registration = std::chrono::duration_cast<std::chrono::microseconds>(registered - built);
+    }
+    GDBUSPP_LOG("Service startup: " << objects.size() << " objects built in "
+                                    << startup_timings.build.count() << "us, "
+                                    << "registered in "
+                                    << startup_timings.registration.count() << "us");
+
+    if (Startup::DEFERRED == startup_mode
+        && BusType::PEER != buscon->GetBusType())
+    {
+        acquire_busname();
+    }
+}
+
+
+Service::StartupTimings Service::GetStartupTimings() const
+{
+    std::lock_guard<std::mutex> lg(startup_mtx);
+    return startup_timings;
+}
+
+
 void Service::Run()
 {
     if (!service_mainloop)
     {
         // If not created via PrepareIdleDetection(), create it now
-        service_mainloop = MainLoop::Create();
+        service_mainloop = service_mainloop_create();
+    }
+    if (!started)
+    {
+        Start();
+    }
+    if (BusType::PEER == buscon->GetBusType())
+    {
+        // There is no bus name to acquire on peer-to-peer connections;
+        // the service is ready as soon as it runs
+        BusNameAcquired(busname);
+        object_manager->RunIdleDetector(true);
+    }
+    if (service_mainloop->Running())
+    {
+        // A private main loop already running in its own thread
+        service_mainloop->Wait();
+        return;
     }
     service_mainloop->Run();
 }
@@ -88,6 +170,19 @@ void Service::Stop()
 }
 
 
+bool Service::Stop(const std::chrono::milliseconds drain_deadline)
+{
+    if (!service_mainloop)
+    {
+        throw Service::Exception("No main loop started by this service object");
+    }
+    object_manager->RunIdleDetector(false);
+    const bool drained = object_manager->DrainRequests(drain_deadline);
+    service_mainloop->Stop();
+    return drained;
+}
+
+
 
 Service::Service(Connection::Ptr busc, const std::string &busname_)
     : buscon(busc), busname(busname_)
@@ -96,6 +191,15 @@ Service::Service(Connection::Ptr busc, const std::string &busname_)
 }
 
 
+Service::Service(Connection::Ptr busc,
+                 const std::string &busname_,
+                 const Startup startup)
+    : buscon(busc), busname(busname_), startup_mode(startup)
+{
+    service_register();
+}
+
+
 Service::~Service() noexcept
 {
     try
@@ -116,7 +220,27 @@ Service::~Service() noexcept
 
 void Service::service_register()
 {
+    object_manager = Object::Manager::CreateManager(buscon);
+    if (BusType::PEER == buscon->GetBusType()
+        || Startup::DEFERRED == startup_mode)
+    {
+        // No bus name on peer-to-peer connections; deferred services
+        // request it via Start()
+        return;
+    }
+    acquire_busname();
+}
+
+
+void Service::acquire_busname()
+{
+    {
+        std::lock_guard<std::mutex> lg(startup_mtx);
+        name_requested = std::chrono::steady_clock::now();
+    }
+
     // Acquire the requested bus name
+    MainLoop::ContextScope scope(buscon->GetMainLoop());
     busid = g_bus_own_name_on_connection(buscon->ConnPtr(),
                                          busname.c_str(),
                                          G_BUS_NAME_OWNER_FLAGS_REPLACE,
@@ -128,7 +252,89 @@ void Service::service_register()
     {
         throw Service::Exception("Could not own bus name for " + busname);
     }
-    object_manager = Object::Manager::CreateManager(buscon);
+}
+
+
+std::vector<Object::Base::Ptr> Service::run_startup_tasks()
+{
+    std::vector<StartupTask> tasks;
+    tasks.swap(startup_tasks);
+    if (tasks.empty())
+    {
+        return {};
+    }
+
+    std::vector<std::vector<Object::Base::Ptr>> results(tasks.size());
+    std::vector<std::exception_ptr> errors(tasks.size());
+    std::atomic<size_t> next{0};
+    auto worker = [&]()
+    {
+        for (size_t i = next++; i < tasks.size(); i = next++)
+        {
+            try
+            {
+                results[i] = tasks[i]();
+            }
+            catch (...)
+            {
+                errors[i] = std::current_exception();
+            }
+        }
+    };
+
+    // The calling thread is one of the workers
+    const size_t nthreads = std::min<size_t>(tasks.size(),
+                                             std::max(1U, std::thread::hardware_concurrency()));
+    std::vector<std::thread> threads;
+    threads.reserve(nthreads - 1);
+    for (size_t t = 1; t < nthreads; ++t)
+    {
+        try
+        {
+            threads.emplace_back(worker);
+        }
+        catch (const std::system_error &)
+        {
+            // Continue with the threads already running
+            break;
+        }
+    }
+    worker();
+    for (auto &thr : threads)
+    {
+        thr.join();
+    }
+
+    for (const auto &err : errors)
+    {
+        if (err)
+        {
+            std::rethrow_exception(err);
+        }
+    }
+
+    std::vector<Object::Base::Ptr> objects;
+    for (auto &res : results)
+    {
+        objects.insert(objects.end(), res.begin(), res.end());
+    }
+    return objects;
+}
+
+
+void Service::name_acquired() noexcept
+{
+    std::lock_guard<std::mutex> lg(startup_mtx);
+    startup_timings.name_acquisition = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - name_requested);
+}
+
+
+MainLoop::Ptr Service::service_mainloop_create() const
+{
+    // Services on a connection bound to a specific main loop run there
+    MainLoop::Ptr bound = buscon->GetMainLoop();
+    return (bound ? bound : MainLoop::Create());
 }
 
 
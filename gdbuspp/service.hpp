@@ -17,10 +17,14 @@
 
 #include <cstdint>
 #include <chrono>
+#include <functional>
+#include <mutex>
 #include <string>
+#include <vector>
 #include <glib.h>
 
 #include "exceptions.hpp"
+#include "glib2/callbacks.hpp"
 #include "mainloop.hpp"
 #include "object/manager.hpp"
 
@@ -68,6 +72,42 @@ class Service : public std::enable_shared_from_this<Service>
         virtual ~Exception() = default;
     };
 
+    /**
+     *  When the well-known bus name of the service is requested
+     */
+    enum class Startup
+    {
+        /// The bus name is requested when the service object is created
+        IMMEDIATE,
+
+        /// The bus name is requested by @Start(), once all the startup
+        /// tasks have completed and their objects are registered.  Clients
+        /// waiting for the bus name will then find all the objects ready.
+        DEFERRED
+    };
+
+    /**
+     *  Task building D-Bus objects while the service starts; see
+     *  @AddStartupTask().  The returned objects are registered by the
+     *  service.
+     */
+    using StartupTask = std::function<std::vector<Object::Base::Ptr>()>;
+
+    /**
+     *  Time spent in each phase of the service startup
+     */
+    struct StartupTimings
+    {
+        /// Running all the startup tasks
+        std::chrono::microseconds build{0};
+
+        /// Registering the objects built by the startup tasks
+        std::chrono::microseconds registration{0};
+
+        /// From requesting the bus name until it was acquired
+        std::chrono::microseconds name_acquisition{0};
+    };
+
     /**
      *  Prepare a new  D-Bus service with a given well-known bus name.
      *
@@ -161,8 +201,12 @@ class Service : public std::enable_shared_from_this<Service>
      *
      * @param timeout  std::chrono::duration describing the idle timeout
      *                 of the service
+     * @param wait_for_requests  bool flag, if true (default) the service is
+     *                 not shut down while D-Bus requests are queued or
+     *                 being processed by the request pool
      */
-    void PrepareIdleDetector(const std::chrono::duration<uint32_t> timeout);
+    void PrepareIdleDetector(const std::chrono::duration<uint32_t> timeout,
+                             const bool wait_for_requests = true);
 
 
     /**
@@ -179,6 +223,68 @@ class Service : public std::enable_shared_from_this<Service>
     void RunIdleDetector(const bool run);
 
 
+    /**
+     *  Configure the thread pool processing the D-Bus method calls for
+     *  all the D-Bus objects in this service.  This must be called before
+     *  the service handler or any other D-Bus objects are created.
+     *
+     * @param cfg   AsyncProcess::Pool::Config with the thread pool settings
+     *
+     * @throws Object::Manager::Exception if objects have already been
+     *         created or the thread pool could not be created
+     */
+    void ConfigureRequestPool(const AsyncProcess::Pool::Config &cfg);
+
+
+    /**
+     *  Add a task building D-Bus objects during the service startup.  All
+     *  the tasks are run in parallel by @Start(), so objects which are
+     *  expensive to prepare do not need to be built one by one.  The tasks
+     *  must be thread-safe and should only create the objects, for example
+     *  via DBus::Object::Base::Create(); the service registers all the
+     *  returned objects in one go.
+     *
+     *  @code
+     *
+     *    my_service->AddStartupTask(
+     *        []()
+     *        {
+     *            std::vector<DBus::Object::Base::Ptr> objs;
+     *            objs.push_back(DBus::Object::Base::Create<Catalogue>("/example/catalogue"));
+     *            return objs;
+     *        });
+     *
+     *  @endcode
+     *
+     * @param task  StartupTask to run
+     *
+     * @throws Service::Exception if the service has already been started
+     */
+    void AddStartupTask(StartupTask task);
+
+    /**
+     *  Start the service.  This runs all the tasks added via
+     *  @AddStartupTask() in parallel, registers the objects they returned
+     *  and, if the service uses Startup::DEFERRED, requests the bus name.
+     *
+     *  This is called by @Run() if not called already.  Services running
+     *  their own DBus::MainLoop must call this method themselves.
+     *
+     * @throws Service::Exception if the service has already been started.
+     *         Exceptions thrown by the startup tasks are passed on, after
+     *         all the tasks have completed; no objects are registered then.
+     */
+    void Start();
+
+    /**
+     *  Retrieve how long each phase of the service startup took.  The
+     *  name acquisition time is only available once the bus name has
+     *  been acquired.
+     *
+     * @return StartupTimings
+     */
+    StartupTimings GetStartupTimings() const;
+
     /**
      *  Very simple DBus::MainLoop to get a D-Bus service running
      *
@@ -195,6 +301,24 @@ class Service : public std::enable_shared_from_this<Service>
      */
     void Stop();
 
+    /**
+     *  Gracefully stops the DBus::MainLoop managed by this object.  New
+     *  D-Bus requests are rejected, and the queued and in-flight requests
+     *  are given until the deadline to complete before the main loop is
+     *  stopped.
+     *
+     *  Can be called by another thread, to stop the service main loop.
+     *  When called from a D-Bus method callback, the request of that
+     *  method call is not waited for.
+     *
+     * @param drain_deadline  std::chrono::milliseconds of the maximum time
+     *                        to wait for pending requests
+     *
+     * @return true if all the pending requests completed before the main
+     *         loop was stopped, otherwise false
+     */
+    bool Stop(const std::chrono::milliseconds drain_deadline);
+
     /**
      *  Called when the requested bus name has been successfully acquired.
      *
@@ -225,6 +349,19 @@ class Service : public std::enable_shared_from_this<Service>
      */
     Service(Connection::Ptr busc, const std::string &busname);
 
+    /**
+     *  Constructor for the DBus::Service part of the class inheritance,
+     *  controlling when the bus name is requested
+     *
+     * @param busc      DBus::Connection::Ptr to use for this service.
+     * @param busname   std::string containing the well-known bus name it
+     *                  will be visible as on the D-Bus
+     * @param startup   Startup mode of the service
+     */
+    Service(Connection::Ptr busc,
+            const std::string &busname,
+            const Startup startup);
+
 
   private:
     ///  D-Bus connection object
@@ -236,6 +373,20 @@ class Service : public std::enable_shared_from_this<Service>
     /// Bus ID reference assigned by the glib2 GDBus interface
     unsigned int busid = 0;
 
+    /// When the bus name is requested
+    const Startup startup_mode = Startup::IMMEDIATE;
+
+    /// Tasks to run by Start(); see AddStartupTask()
+    std::vector<StartupTask> startup_tasks{};
+
+    /// Set once Start() has been called
+    bool started = false;
+
+    /// Timings of the startup phases and when the bus name was requested
+    StartupTimings startup_timings{};
+    std::chrono::steady_clock::time_point name_requested{};
+    mutable std::mutex startup_mtx{};
+
     /**
      *  The ObjectManager keeps track of all the D-Bus objects created
      *  by this D-Bus service and links them to the appropriate C++
@@ -262,6 +413,39 @@ class Service : public std::enable_shared_from_this<Service>
      */
     void service_register();
 
+    /**
+     *  Request the well-known bus name of this service from the D-Bus
+     *  daemon
+     */
+    void acquire_busname();
+
+    /**
+     *  Runs all the startup tasks in parallel
+     *
+     * @return std::vector<Object::Base::Ptr> with all the objects returned
+     *         by the tasks
+     */
+    std::vector<Object::Base::Ptr> run_startup_tasks();
+
+    /**
+     *  Records the time it took to acquire the bus name.  Called by
+     *  glib2::Callbacks::_int_callback_name_acquired()
+     */
+    void name_acquired() noexcept;
+
+    /// glib2 callback function granted access to name_acquired()
+    friend void glib2::Callbacks::_int_callback_name_acquired(GDBusConnection *conn,
+                                                              const char *name,
+                                                              void *this_ptr);
+
+    /**
+     *  Creates the main loop for this service, which is the main loop the
+     *  D-Bus connection is bound to if set
+     *
+     * @return MainLoop::Ptr
+     */
+    MainLoop::Ptr service_mainloop_create() const;
+
     /**
      *  Calls the right glib2 GDBus functions to remove this service
      *  from the D-Bus.
@@ -0,0 +1,235 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file signals/coalescing.cpp
+ *
+ * @brief  Implementation of DBus::Signals::Coalescing, a rate limiting
+ *         Signals::Emit implementation
+ */
+
+#include <iostream>
+#include <string>
+#include <glib.h>
+
+#define GDBUSPP_LOG_CATEGORY SIGNALS
+#include "../features/debug-log.hpp"
+#include "coalescing.hpp"
+
+
+namespace DBus {
+namespace Signals {
+
+namespace _private {
+
+struct CoalescingContext
+{
+    Coalescing::Ptr emitter;
+    std::string signal_name;
+    std::string key;
+};
+
+
+static gboolean coalescing_flush_callback(void *user_data)
+{
+    auto ctx = static_cast<CoalescingContext *>(user_data);
+    ctx->emitter->Flush(ctx->signal_name, ctx->key);
+    return G_SOURCE_REMOVE;
+}
+
+
+static void destroy_coalescing_context(void *user_data)
+{
+    delete static_cast<CoalescingContext *>(user_data);
+}
+
+} // namespace _private
+
+
+
+Coalescing::Coalescing(DBus::Connection::Ptr conn,
+                       const std::chrono::milliseconds min_interval)
+    : Emit(conn), dbus_connection(conn), default_interval(min_interval)
+{
+}
+
+
+Coalescing::~Coalescing() noexcept
+{
+    for (auto &[key, slot] : slots)
+    {
+        if (slot.pending)
+        {
+            g_variant_unref(slot.pending);
+        }
+    }
+}
+
+
+void Coalescing::SetInterval(const std::string &signal_name,
+                             const std::chrono::milliseconds interval)
+{
+    std::lock_guard<std::mutex> lg(mtx);
+    intervals[signal_name] = interval;
+}
+
+
+void Coalescing::SetKeyArgument(const std::string &signal_name, const unsigned int argidx)
+{
+    std::lock_guard<std::mutex> lg(mtx);
+    key_arguments[signal_name] = argidx;
+}
+
+
+bool Coalescing::SendGVariant(const std::string &signal_name, GVariant *params) const
+{
+    std::unique_lock<std::mutex> lock(mtx);
+    const auto interval = get_interval(signal_name);
+    if (interval.count() <= 0)
+    {
+        lock.unlock();
+        return Emit::SendGVariant(signal_name, params);
+    }
+
+    const Key key{signal_name, get_key(signal_name, params)};
+    auto &slot = slots[key];
+    const auto now = std::chrono::steady_clock::now();
+    if (!slot.scheduled && (now - slot.last_sent) >= interval)
+    {
+        slot.last_sent = now;
+        lock.unlock();
+        return Emit::SendGVariant(signal_name, params);
+    }
+
+    // Hold back the signal; replacing any older pending signal.  The
+    // caller keeps the reference it passed in, as with Emit::SendGVariant()
+    g_variant_take_ref(params);
+    g_variant_ref(params);
+    if (slot.pending)
+    {
+        g_variant_unref(slot.pending);
+    }
+    slot.pending = params;
+
+    if (!slot.scheduled)
+    {
+        slot.scheduled = true;
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            slot.last_sent + interval - now);
+        GDBUSPP_LOG("Signals::Coalescing -- holding back '" << signal_name << "'"
+                    << (key.second.empty() ? "" : " [" + key.second + "]")
+                    << " for " << remaining.count() << "ms");
+
+        auto ctx = new _private::CoalescingContext{
+            std::const_pointer_cast<Coalescing>(shared_from_this()),
+            key.first,
+            key.second};
+        GSource *src = g_timeout_source_new(static_cast<guint>(remaining.count() > 0 ? remaining.count() : 0));
+        g_source_set_priority(src, G_PRIORITY_DEFAULT);
+        g_source_set_callback(src,
+                              _private::coalescing_flush_callback,
+                              ctx,
+                              _private::destroy_coalescing_context);
+        auto loop = dbus_connection->GetMainLoop();
+        g_source_attach(src, (loop ? loop->GetContext() : nullptr));
+        g_source_unref(src);
+    }
+    return true;
+}
+
+
+void Coalescing::Flush(const std::string &signal_name, const std::string &key) const noexcept
+{
+    GVariant *params = nullptr;
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        const auto now = std::chrono::steady_clock::now();
+        auto it = slots.find({signal_name, key});
+        if (slots.end() != it)
+        {
+            params = it->second.pending;
+            it->second.pending = nullptr;
+            it->second.scheduled = false;
+            if (params)
+            {
+                it->second.last_sent = now;
+            }
+        }
+
+        // Slots with nothing pending and an expired interval behaves
+        // the same as a missing slot; clean those up
+        for (auto s = slots.begin(); s != slots.end();)
+        {
+            if (!s->second.scheduled
+                && (now - s->second.last_sent) >= get_interval(s->first.first))
+            {
+                s = slots.erase(s);
+            }
+            else
+            {
+                ++s;
+            }
+        }
+    }
+
+    if (!params)
+    {
+        return;
+    }
+
+    try
+    {
+        Emit::SendGVariant(signal_name, params);
+    }
+    catch (const DBus::Exception &excp)
+    {
+        std::cerr << "** ERROR **  Signals::Coalescing: Failed sending '"
+                  << signal_name << "': " << excp.what() << std::endl;
+    }
+    g_variant_unref(params);
+}
+
+
+std::chrono::milliseconds Coalescing::get_interval(const std::string &signal_name) const noexcept
+{
+    auto it = intervals.find(signal_name);
+    return (intervals.end() != it ? it->second : default_interval);
+}
+
+
+std::string Coalescing::get_key(const std::string &signal_name, GVariant *params) const noexcept
+{
+    auto it = key_arguments.find(signal_name);
+    if (key_arguments.end() == it
+        || !params
+        || !g_variant_is_container(params)
+        || g_variant_n_children(params) <= it->second)
+    {
+        return "";
+    }
+
+    GVariant *arg = g_variant_get_child_value(params, it->second);
+    std::string ret;
+    if (g_variant_is_of_type(arg, G_VARIANT_TYPE_STRING)
+        || g_variant_is_of_type(arg, G_VARIANT_TYPE_OBJECT_PATH)
+        || g_variant_is_of_type(arg, G_VARIANT_TYPE_SIGNATURE))
+    {
+        ret = g_variant_get_string(arg, nullptr);
+    }
+    else
+    {
+        gchar *str = g_variant_print(arg, false);
+        ret = str;
+        g_free(str);
+    }
+    g_variant_unref(arg);
+    return ret;
+}
+
+} // namespace Signals
+} // namespace DBus
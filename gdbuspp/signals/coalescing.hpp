@@ -0,0 +1,149 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file signals/coalescing.hpp
+ *
+ * @brief  Declaration of DBus::Signals::Coalescing, a rate limiting
+ *         Signals::Emit implementation
+ */
+
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <glib.h>
+
+#include "../connection.hpp"
+#include "emit.hpp"
+
+
+namespace DBus {
+namespace Signals {
+
+/**
+ *  Signals::Emit implementation limiting how often each signal is sent.
+ *
+ *  A signal is sent right away if the minimum interval since the last
+ *  time it was sent has passed.  Otherwise the signal is held back and
+ *  sent when the interval expires.  If the same signal is sent more
+ *  times within the interval, only the latest signal is sent.
+ *
+ *  Signals can be tracked separately per value of one of the signal
+ *  arguments, such as a session object path; see SetKeyArgument().
+ *
+ *  This can be used anywhere a Signals::Emit object is used, such as
+ *  with Signals::Signal objects or via Signals::Group::GroupCreate().
+ *  Delayed signals are sent from the main loop.
+ */
+class Coalescing : public Emit,
+                   public std::enable_shared_from_this<Coalescing>
+{
+  public:
+    using Ptr = std::shared_ptr<Coalescing>;
+
+    /**
+     *  Create a new rate limiting signal emitter
+     *
+     * @param conn          DBus::Connection::Ptr where signals will be sent
+     * @param min_interval  std::chrono::milliseconds of the default minimum
+     *                      time between each time a signal is sent.
+     *
+     * @return Coalescing::Ptr
+     */
+    [[nodiscard]] static Coalescing::Ptr Create(DBus::Connection::Ptr conn,
+                                                const std::chrono::milliseconds min_interval)
+    {
+        return Coalescing::Ptr(new Coalescing(conn, min_interval));
+    }
+
+    ~Coalescing() noexcept;
+
+    /**
+     *  Change the minimum interval for a specific signal.  An interval
+     *  of 0 disables the rate limiting for this signal.
+     *
+     * @param signal_name   std::string with the signal name
+     * @param interval      std::chrono::milliseconds with the new interval
+     */
+    void SetInterval(const std::string &signal_name,
+                     const std::chrono::milliseconds interval);
+
+    /**
+     *  Track the signal separately per value of one of its arguments.
+     *  Signals with different values of this argument do not replace
+     *  each other.
+     *
+     * @param signal_name   std::string with the signal name
+     * @param argidx        Argument position of the key value, the
+     *                      first argument is 0.
+     */
+    void SetKeyArgument(const std::string &signal_name, const unsigned int argidx);
+
+    /**
+     *  Send a D-Bus signal to all registered targets, limited by the
+     *  configured minimum interval.
+     *
+     * @param signal_name   std::string with the signal name to use
+     * @param params        GVariant object with data values to
+     *                      provide with the signal
+     *
+     * @return Returns true if the signal was sent or queued, otherwise
+     *         false.
+     */
+    bool SendGVariant(const std::string &signal_name, GVariant *params) const override;
+    using Emit::SendGVariant;
+
+    /**
+     *  Send a held back signal right away.  This is called from the main
+     *  loop when the minimum interval expires.
+     *
+     * @param signal_name   std::string with the signal name
+     * @param key           std::string with the key argument value, empty
+     *                      if the signal is not tracked per key
+     */
+    void Flush(const std::string &signal_name, const std::string &key) const noexcept;
+
+
+  protected:
+    Coalescing(DBus::Connection::Ptr conn, const std::chrono::milliseconds min_interval);
+
+
+  private:
+    /// Signal name and key argument value
+    using Key = std::pair<std::string, std::string>;
+
+    /// Tracking of a single signal
+    struct Slot
+    {
+        std::chrono::steady_clock::time_point last_sent{};
+        GVariant *pending = nullptr;
+        bool scheduled = false;
+    };
+
+    /// Connection the signals are sent on; held back signals are
+    /// flushed by the main loop this connection is bound to
+    DBus::Connection::Ptr dbus_connection = nullptr;
+
+    const std::chrono::milliseconds default_interval;
+    std::map<std::string, std::chrono::milliseconds> intervals{};
+    std::map<std::string, unsigned int> key_arguments{};
+
+    mutable std::mutex mtx{};
+    mutable std::map<Key, Slot> slots{};
+
+    std::chrono::milliseconds get_interval(const std::string &signal_name) const noexcept;
+    std::string get_key(const std::string &signal_name, GVariant *params) const noexcept;
+};
+
+} // namespace Signals
+} // namespace DBus
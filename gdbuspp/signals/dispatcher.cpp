@@ -0,0 +1,199 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file signals/dispatcher.cpp
+ *
+ * @brief  Implementation of DBus::Signals::Dispatcher, processing signal
+ *         subscription callbacks in worker threads
+ */
+
+#include <iostream>
+
+#include "../exceptions.hpp"
+#define GDBUSPP_LOG_CATEGORY SIGNALS
+#include "../features/debug-log.hpp"
+#include "dispatcher.hpp"
+
+
+namespace DBus {
+namespace Signals {
+
+Dispatcher::Channel::Channel(Signals::CallbackFnc cb, const DispatchOptions &opts)
+    : callback(std::move(cb)), options(opts)
+{
+}
+
+
+void Dispatcher::Channel::Close() noexcept
+{
+    closed = true;
+}
+
+
+uint64_t Dispatcher::Channel::GetDropped() const noexcept
+{
+    return dropped.load();
+}
+
+
+
+Dispatcher::Dispatcher(const unsigned int threads)
+{
+    const unsigned int count = (threads > 0 ? threads : 1);
+    workers.reserve(count);
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        workers.emplace_back(&Dispatcher::worker, queue);
+    }
+}
+
+
+Dispatcher::~Dispatcher() noexcept
+{
+    {
+        std::lock_guard<std::mutex> lg(queue->mtx);
+        queue->shutdown = true;
+        queue->ready.clear();
+    }
+    queue->cv.notify_all();
+    for (auto &thr : workers)
+    {
+        if (thr.get_id() == std::this_thread::get_id())
+        {
+            // The last reference was released by a callback running
+            // in this worker thread; it exits on its own when the
+            // callback returns
+            thr.detach();
+        }
+        else if (thr.joinable())
+        {
+            thr.join();
+        }
+    }
+}
+
+
+Dispatcher::Channel::Ptr Dispatcher::NewChannel(Signals::CallbackFnc callback,
+                                                const DispatchOptions &options)
+{
+    return Channel::Ptr(new Channel(std::move(callback), options));
+}
+
+
+void Dispatcher::Push(Channel::Ptr channel, Event::Ptr event)
+{
+    if (channel->closed)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lg(queue->mtx);
+        const size_t max_queue = channel->options.max_queue;
+        if (max_queue > 0 && channel->events.size() >= max_queue)
+        {
+            ++channel->dropped;
+            GDBUSPP_LOG("Signals::Dispatcher -- queue full, dropping "
+                        << (DropPolicy::DROP_NEWEST == channel->options.drop_policy
+                                ? "newest"
+                                : "oldest")
+                        << " event: " << event);
+            if (DropPolicy::DROP_NEWEST == channel->options.drop_policy)
+            {
+                return;
+            }
+            channel->events.pop_front();
+        }
+        channel->events.push_back(event);
+
+        if (!channel->options.ordered)
+        {
+            // Each event can be processed independently
+            queue->ready.push_back(channel);
+        }
+        else if (!channel->active)
+        {
+            // Only one worker processes an ordered channel at a time
+            channel->active = true;
+            queue->ready.push_back(channel);
+        }
+        else
+        {
+            // The worker processing this channel picks up the event
+            return;
+        }
+    }
+    queue->cv.notify_one();
+}
+
+
+void Dispatcher::worker(std::shared_ptr<WorkQueue> queue) noexcept
+{
+    std::unique_lock<std::mutex> lock(queue->mtx);
+    while (true)
+    {
+        queue->cv.wait(lock,
+                       [&queue]()
+                       {
+                           return queue->shutdown || !queue->ready.empty();
+                       });
+        if (queue->shutdown)
+        {
+            return;
+        }
+
+        Channel::Ptr channel = queue->ready.front();
+        queue->ready.pop_front();
+        if (channel->events.empty())
+        {
+            // Events of unordered channels may have been dropped
+            continue;
+        }
+        Event::Ptr event = channel->events.front();
+        channel->events.pop_front();
+
+        lock.unlock();
+        if (!channel->closed)
+        {
+            try
+            {
+                channel->callback(event);
+            }
+            catch (const DBus::Exception &excp)
+            {
+                std::cerr << "** ERROR **  Signals::Dispatcher: " << excp.what()
+                          << std::endl;
+            }
+            catch (const std::exception &excp)
+            {
+                std::cerr << "** ERROR **  Signals::Dispatcher: " << excp.what()
+                          << std::endl;
+            }
+        }
+        event.reset();
+        lock.lock();
+
+        if (channel->options.ordered)
+        {
+            if (!channel->events.empty() && !queue->shutdown)
+            {
+                // Give other channels a chance before continuing
+                queue->ready.push_back(channel);
+                queue->cv.notify_one();
+            }
+            else
+            {
+                channel->active = false;
+            }
+        }
+    }
+}
+
+} // namespace Signals
+} // namespace DBus
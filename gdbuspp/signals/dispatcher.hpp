@@ -0,0 +1,166 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file signals/dispatcher.hpp
+ *
+ * @brief  Declaration of DBus::Signals::Dispatcher, processing signal
+ *         subscription callbacks in worker threads
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "event.hpp"
+
+
+namespace DBus {
+namespace Signals {
+
+/**
+ *  What to do when the event queue of a subscription is full
+ */
+enum class DropPolicy : uint8_t
+{
+    DROP_OLDEST, ///< Throw away the oldest queued event
+    DROP_NEWEST  ///< Throw away the newly received event
+};
+
+
+/**
+ *  Options for signal subscriptions processing the callbacks in
+ *  worker threads; see SubscriptionManager::Subscribe()
+ */
+struct DispatchOptions
+{
+    /// Maximum number of queued events for the subscription; 0 is unbounded
+    size_t max_queue = 1024;
+
+    /// What to do with events when the queue is full
+    DropPolicy drop_policy = DropPolicy::DROP_OLDEST;
+
+    /// If true, the callbacks of this subscription are called one
+    /// at a time, in the order the signals were received.  Otherwise
+    /// callbacks may run in parallel in several worker threads.
+    bool ordered = true;
+};
+
+
+/**
+ *  Thread pool processing signal callbacks outside of the thread
+ *  running the main loop, so slow signal handlers does not delay
+ *  other signals or method calls on the same D-Bus connection.
+ *
+ *  Each subscription has its own bounded event queue, a Channel,
+ *  where each queue is processed according to its DispatchOptions.
+ */
+class Dispatcher
+{
+  public:
+    using Ptr = std::shared_ptr<Dispatcher>;
+
+    /**
+     *  Event queue of a single subscription
+     */
+    class Channel
+    {
+      public:
+        using Ptr = std::shared_ptr<Channel>;
+
+        /**
+         *  Stop calling the callback for this channel.  Already queued
+         *  events are thrown away.  A callback already running in a worker
+         *  thread will still complete.
+         */
+        void Close() noexcept;
+
+        /**
+         * @return Number of events thrown away due to a full queue
+         */
+        uint64_t GetDropped() const noexcept;
+
+      private:
+        friend class Dispatcher;
+
+        Channel(Signals::CallbackFnc cb, const DispatchOptions &opts);
+
+        const Signals::CallbackFnc callback;
+        const DispatchOptions options;
+        std::deque<Event::Ptr> events{};
+        bool active = false;
+        std::atomic<bool> closed{false};
+        std::atomic<uint64_t> dropped{0};
+    };
+
+
+    /**
+     *  Create a new signal callback thread pool
+     *
+     * @param threads  Number of worker threads to use
+     *
+     * @return Dispatcher::Ptr
+     */
+    [[nodiscard]] static Dispatcher::Ptr Create(const unsigned int threads)
+    {
+        return Dispatcher::Ptr(new Dispatcher(threads));
+    }
+
+    ~Dispatcher() noexcept;
+
+
+    /**
+     *  Prepare a new event queue for a subscription
+     *
+     * @param callback   Signals::CallbackFnc to call for each event
+     * @param options    DispatchOptions for the processing of this queue
+     *
+     * @return Channel::Ptr
+     */
+    Channel::Ptr NewChannel(Signals::CallbackFnc callback, const DispatchOptions &options);
+
+    /**
+     *  Queue a received signal for processing in a worker thread
+     *
+     * @param channel   Channel::Ptr of the subscription receiving the event
+     * @param event     Event::Ptr with the received signal
+     */
+    void Push(Channel::Ptr channel, Event::Ptr event);
+
+
+  private:
+    /**
+     *  Work queue shared by all worker threads.  This is kept separate
+     *  from the Dispatcher object, as a callback may release the last
+     *  Dispatcher reference from within a worker thread.
+     */
+    struct WorkQueue
+    {
+        std::mutex mtx{};
+        std::condition_variable cv{};
+        std::deque<Channel::Ptr> ready{};
+        bool shutdown = false;
+    };
+
+    std::shared_ptr<WorkQueue> queue = std::make_shared<WorkQueue>();
+    std::vector<std::thread> workers{};
+
+    Dispatcher(const unsigned int threads);
+
+    static void worker(std::shared_ptr<WorkQueue> queue) noexcept;
+};
+
+} // namespace Signals
+} // namespace DBus
@@ -17,7 +17,9 @@
 #include <string>
 #include <glib.h>
 
+#define GDBUSPP_LOG_CATEGORY SIGNALS
 #include "../features/debug-log.hpp"
+#include "../features/probes.hpp"
 #include "../glib2/strings.hpp"
 #include "../object/path.hpp"
 #include "exceptions.hpp"
@@ -61,20 +63,33 @@ bool Emit::SendGVariant(const std::string &signal_name, GVariant *params) const
     }
 
 
+    // Take over a floating reference, where the caller is responsible
+    // to release it; a reference already owned by the caller is left as is
+    g_variant_take_ref(params);
+    GDBUSPP_TRACE(SIGNALS, DEBUG, "Signal sent to {} target(s)", targets.size());
+    if (targets.size() > 1)
+    {
+        return send_fanout(signal_name, params);
+    }
+
     GError *err = nullptr;
-    g_variant_ref_sink(params);
     for (const auto &tgt : targets)
     {
         GDBUSPP_LOG("Signals::Emit -- " << tgt << "; "
                                         << "signal_name='" << signal_name << "'"
-                                        << ", params=" << g_variant_print(params, true));
-        if (!g_dbus_connection_emit_signal(connection->ConnPtr(),
-                                           str2gchar(tgt->busname),
-                                           str2gchar(tgt->object_path),
-                                           str2gchar(tgt->object_interface),
-                                           str2gchar(signal_name),
-                                           params,
-                                           &err))
+                                        << ", params=" << Features::Trace::VariantString(params));
+        GDBUSPP_PROBE(signal_emit,
+                      tgt->object_path.c_str(),
+                      tgt->object_interface.c_str(),
+                      signal_name.c_str(),
+                      tgt->busname.c_str());
+        if (!Connection::Cork::EmitSignal(connection->ConnPtr(),
+                                          str2gchar(tgt->busname),
+                                          str2gchar(tgt->object_path),
+                                          str2gchar(tgt->object_interface),
+                                          str2gchar(signal_name),
+                                          params,
+                                          &err))
         {
             std::cerr << "[GDBus++ Error: " << tgt << "] "
                       << "Failed to send signal '" << signal_name << "' ";
@@ -90,6 +105,81 @@ bool Emit::SendGVariant(const std::string &signal_name, GVariant *params) const
 }
 
 
+bool Emit::send_fanout(const std::string &signal_name, GVariant *params) const
+{
+    // Serialize the signal parameters once; the serialized data is
+    // kept by the GVariant object and shared by all the message copies
+    (void)g_variant_get_data(params);
+
+    // A template message is prepared per object path and interface;
+    // consecutive targets normally share the same
+    GDBusMessage *tmpl = nullptr;
+    Target::Ptr tmpl_tgt = nullptr;
+    bool ret = true;
+
+    for (const auto &tgt : targets)
+    {
+        GDBUSPP_LOG("Signals::Emit [fan-out] -- " << tgt << "; "
+                                                  << "signal_name='" << signal_name << "'");
+        if (!tmpl
+            || tmpl_tgt->object_path != tgt->object_path
+            || tmpl_tgt->object_interface != tgt->object_interface)
+        {
+            if (tmpl)
+            {
+                g_object_unref(tmpl);
+            }
+            tmpl = g_dbus_message_new_signal(tgt->object_path.c_str(),
+                                             tgt->object_interface.c_str(),
+                                             signal_name.c_str());
+            g_dbus_message_set_body(tmpl, params);
+            tmpl_tgt = tgt;
+        }
+
+        GError *err = nullptr;
+        GDBusMessage *msg = g_dbus_message_copy(tmpl, &err);
+        GDBUSPP_PROBE(signal_emit,
+                      tgt->object_path.c_str(),
+                      tgt->object_interface.c_str(),
+                      signal_name.c_str(),
+                      tgt->busname.c_str());
+        if (msg)
+        {
+            if (!tgt->busname.empty())
+            {
+                g_dbus_message_set_destination(msg, tgt->busname.c_str());
+            }
+            if (!Connection::Cork::SendMessage(connection->ConnPtr(), msg, &err))
+            {
+                g_object_unref(msg);
+                msg = nullptr;
+            }
+        }
+
+        if (!msg)
+        {
+            std::cerr << "[GDBus++ Error: " << tgt << "] "
+                      << "Failed to send signal '" << signal_name << "' ";
+            if (err)
+            {
+                std::cerr << "glib2 Error: " << err->message;
+                g_error_free(err);
+            }
+            std::cerr << std::endl;
+            ret = false;
+            break;
+        }
+        g_object_unref(msg);
+    }
+
+    if (tmpl)
+    {
+        g_object_unref(tmpl);
+    }
+    return ret;
+}
+
+
 Emit::Emit(Connection::Ptr conn)
     : connection(conn)
 {
@@ -19,6 +19,7 @@
 #include <glib.h>
 
 #include "../connection.hpp"
+#include "../glib2/variant.hpp"
 #include "../object/path.hpp"
 #include "exceptions.hpp"
 #include "target.hpp"
@@ -97,9 +98,29 @@ class Emit
      * @return Returns true if emitting the signal was successfully,
      *         otherwise false.  This method will return instantly on
      *         error if more signal targets have been set up.
+     *
+     *  With more than one target, the signal is sent in fan-out mode;
+     *  the signal parameters are serialized only once into a template
+     *  GDBusMessage and each target receives a copy of it where only the
+     *  message header is changed.
      */
     virtual bool SendGVariant(const std::string &signal_name, GVariant *params) const;
 
+    /**
+     *  A variant of SendGVariant() taking the signal parameters from an
+     *  owning glib2::Variant handle, which releases them once sent.
+     *
+     * @param signal_name   std::string with the signal name to use
+     * @param params        glib2::Variant with the signal data values
+     *
+     * @return Returns true if emitting the signal was successfully,
+     *         otherwise false.
+     */
+    bool SendGVariant(const std::string &signal_name, glib2::Variant params) const
+    {
+        return SendGVariant(signal_name, params.get());
+    }
+
 
   protected:
     Emit(Connection::Ptr conn);
@@ -107,6 +128,17 @@ class Emit
   private:
     Connection::Ptr connection = nullptr;
     Target::Collection targets{};
+
+    /**
+     *  Sends the signal to all targets via copies of a single
+     *  pre-serialized signal message.  See SendGVariant() for details.
+     *
+     * @param signal_name   std::string with the signal name to use
+     * @param params        GVariant object with the signal values
+     *
+     * @return Returns true if all the signals were sent, otherwise false.
+     */
+    bool send_fanout(const std::string &signal_name, GVariant *params) const;
 };
 
 } // namespace Signals
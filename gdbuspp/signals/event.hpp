@@ -20,9 +20,12 @@
 #include <memory>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <glib.h>
 
+#include "../glib2/utils.hpp"
 #include "../object/path.hpp"
+#include "exceptions.hpp"
 
 namespace DBus {
 namespace Signals {
@@ -56,7 +59,16 @@ class Event
         return Event::Ptr(new Event(sender, object_path, object_interface, signal_name, params));
     }
 
-    ~Event() noexcept = default;
+    ~Event() noexcept
+    {
+        if (params)
+        {
+            g_variant_unref(params);
+        }
+    }
+
+    Event(const Event &) = delete;
+    Event &operator=(const Event &) = delete;
 
 
     friend std::ostream &operator<<(std::ostream &os, const Event::Ptr &ev)
@@ -75,6 +87,26 @@ class Event
     }
 
 
+    /**
+     *  Retrieve a single signal argument
+     *
+     * @tparam T      C++ data type of the argument
+     * @param index   Argument position, the first argument is 0
+     * @return T
+     *
+     * @throws Signals::Exception if the argument does not exist
+     */
+    template <typename T>
+    T Get(const unsigned int index) const
+    {
+        if (!params || index >= g_variant_n_children(params))
+        {
+            throw Signals::Exception("Signal '" + signal_name + "' has no argument "
+                                     + std::to_string(index));
+        }
+        return glib2::Value::Extract<T>(params, index);
+    }
+
     const std::string sender;
     const Object::Path object_path;
     const std::string object_interface;
@@ -89,8 +121,10 @@ class Event
           GVariant *params_)
         : sender(sender_), object_path(object_path_),
           object_interface(object_interface_), signal_name(signal_name_),
-          params(params_)
+          params(params_ ? g_variant_ref(params_) : nullptr)
     {
+        // The params reference is kept, as the event may be processed
+        // after the glib2 signal callback has returned
     }
 };
 
@@ -100,5 +134,104 @@ class Event
 using CallbackFnc = std::function<void(DBus::Signals::Event::Ptr &event)>;
 
 
+
+/**
+ *  Non-owning view of a received signal.  This is passed to signal
+ *  callbacks subscribed via SubscriptionManager::SubscribeView() and is
+ *  only valid while the callback runs; nothing is allocated or copied
+ *  for it.  The signal arguments are only decoded when accessed via
+ *  @Get().
+ *
+ *  Use @ToEvent() to get an owning Signals::Event object if the
+ *  signal information needs to be kept.
+ */
+class EventView
+{
+  public:
+    EventView(const char *sender_,
+              const char *object_path_,
+              const char *object_interface_,
+              const char *signal_name_,
+              GVariant *params_) noexcept
+        : sender(sender_ ? sender_ : ""),
+          object_path(object_path_ ? object_path_ : ""),
+          object_interface(object_interface_ ? object_interface_ : ""),
+          signal_name(signal_name_ ? signal_name_ : ""),
+          params(params_)
+    {
+    }
+
+    EventView(const EventView &) = delete;
+    EventView &operator=(const EventView &) = delete;
+
+
+    /**
+     * @return Number of arguments in the signal
+     */
+    size_t Size() const noexcept
+    {
+        return (params ? g_variant_n_children(params) : 0);
+    }
+
+
+    /**
+     *  Retrieve a single signal argument
+     *
+     * @tparam T      C++ data type of the argument
+     * @param index   Argument position, the first argument is 0
+     * @return T
+     *
+     * @throws Signals::Exception if the argument does not exist
+     */
+    template <typename T>
+    T Get(const unsigned int index) const
+    {
+        if (index >= Size())
+        {
+            throw Signals::Exception("Signal '" + std::string(signal_name)
+                                     + "' has no argument " + std::to_string(index));
+        }
+        return glib2::Value::Extract<T>(params, index);
+    }
+
+
+    /**
+     *  Create an owning copy of this signal event
+     *
+     * @return Event::Ptr
+     */
+    Event::Ptr ToEvent() const
+    {
+        return Event::Create(std::string(sender),
+                             Object::Path(std::string(object_path)),
+                             std::string(object_interface),
+                             std::string(signal_name),
+                             params);
+    }
+
+
+    friend std::ostream &operator<<(std::ostream &os, const EventView &ev)
+    {
+        return os << "Signal::EventView("
+                  << "sender=" << ev.sender << ", "
+                  << "path=" << ev.object_path << ", "
+                  << "signal_name=" << ev.signal_name << ")";
+    }
+
+
+    const std::string_view sender;
+    const std::string_view object_path;
+    const std::string_view object_interface;
+    const std::string_view signal_name;
+    GVariant *const params;
+};
+
+/**
+ *  Declaration of the signal callback function API receiving
+ *  an EventView object
+ */
+using ViewCallbackFnc = std::function<void(const DBus::Signals::EventView &event)>;
+
+
 } // namespace Signals
 } // namespace DBus
@@ -12,9 +12,11 @@
  * @brief  Implementation of the DBus::Signals::Group
  */
 
+#include <mutex>
 #include <string>
 #include <glib.h>
 
+#include "../glib2/utils.hpp"
 #include "../object/path.hpp"
 #include "exceptions.hpp"
 #include "group.hpp"
@@ -23,6 +25,29 @@
 namespace DBus {
 namespace Signals {
 
+namespace _private {
+
+/**
+ *  Process wide registry of the shared signal specifications, indexed
+ *  by the D-Bus interface name and the introspection data of all the
+ *  signals.  Only weak references are kept, so a specification is
+ *  released when the last object using it is removed.
+ */
+struct SpecificationRegistry
+{
+    std::mutex mtx;
+    std::map<std::string, std::weak_ptr<const Specification>> specs;
+};
+
+static SpecificationRegistry &spec_registry()
+{
+    static SpecificationRegistry registry;
+    return registry;
+}
+
+} // namespace _private
+
+
 const std::string SignalArgSignature(const SignalArgList &list)
 {
     std::string typestr = "(";
@@ -35,46 +60,104 @@ const std::string SignalArgSignature(const SignalArgList &list)
 }
 
 
-void Group::RegisterSignal(const std::string &signal_name, const SignalArgList &signal_type)
+Specification::Ptr Specification::Lookup(const std::string &interface)
 {
-    try
+    return intern(Ptr(new Specification(interface)));
+}
+
+
+Specification::Ptr Specification::Add(const std::string &signal_name,
+                                      const SignalArgList &args) const
+{
+    if (signals.end() != signals.find(signal_name))
     {
-        (void)registered_signals.at(signal_name);
         throw Signals::Exception("Signal '" + signal_name + "' is already registered");
     }
-    catch (const std::out_of_range &)
+
+    auto updated = std::shared_ptr<Specification>(new Specification(*this));
+    try
     {
-        registered_signals[signal_name] = signal_type;
-    };
-};
+        updated->types.emplace(signal_name,
+                               glib2::Utils::VariantType(SignalArgSignature(args)));
+    }
+    catch (const glib2::Utils::Exception &excp)
+    {
+        throw Signals::Exception("Signal '" + signal_name + "': "
+                                 + excp.GetRawError());
+    }
+    updated->signals[signal_name] = args;
+
+    // A Specification is never modified after this point, so the
+    // introspection data is prepared once here
+    std::ostringstream xml;
+    for (const auto &sig : updated->signals)
+    {
+        xml << "    <signal name='" << sig.first << "'>" << std::endl;
+        for (const auto &arg : sig.second)
+        {
+            xml << "      <arg type='" << arg.type << "' "
+                << "name='" << arg.name << "'/>" << std::endl;
+        }
+        xml << "    </signal>" << std::endl;
+    }
+    updated->introspection = xml.str();
+    return intern(updated);
+}
 
 
-const std::string Group::GenerateIntrospection()
+Specification::Ptr Specification::intern(Ptr spec)
 {
-    std::ostringstream ret;
+    // The introspection data contains all the signal names, argument
+    // names and data types, so it identifies the specification
+    const std::string key = spec->interface + "\n" + spec->introspection;
+
+    auto &registry = _private::spec_registry();
+    std::lock_guard<std::mutex> guard(registry.mtx);
+    auto &entry = registry.specs[key];
+    if (auto shared = entry.lock())
+    {
+        return shared;
+    }
+    entry = spec;
 
-    for (const auto &sig : registered_signals)
+    // Drop the entries of specifications no longer in use
+    for (auto it = registry.specs.begin(); it != registry.specs.end();)
     {
-        // Prepare a temp storage to use for the D-Bus data type cache
-        std::ostringstream type;
+        it = (it->second.expired() ? registry.specs.erase(it) : std::next(it));
+    }
+    return spec;
+}
 
-        type << "(";
-        ret << "    <signal name='" << sig.first << "'>" << std::endl;
-        for (const auto &spec : sig.second)
-        {
-            ret << "      <arg type='" << spec.type << "' "
-                << "name='" << spec.name << "'/>" << std::endl;
 
-            // Collect data type for the argument for the type cache
-            type << spec.type;
-        }
-        ret << "    </signal>" << std::endl;
+const glib2::Utils::VariantType *Specification::GetType(const std::string &signal_name) const noexcept
+{
+    const auto it = types.find(signal_name);
+    return (types.end() != it ? &it->second : nullptr);
+}
 
-        // Save the gathered type into the type cache
-        type << ")";
-        type_cache[sig.first] = type.str();
-    }
-    return ret.str();
+
+const std::string Specification::GenerateIntrospection() const
+{
+    return introspection;
+}
+
+
+Specification::Specification(const std::string &interface_)
+    : interface(interface_)
+{
+}
+
+
+
+void Group::RegisterSignal(const std::string &signal_name, const SignalArgList &signal_type)
+{
+    spec = spec->Add(signal_name, signal_type);
+}
+
+
+const std::string Group::GenerateIntrospection() const
+{
+    return spec->GenerateIntrospection();
 }
 
 
@@ -105,6 +188,19 @@ void Group::GroupCreate(const std::string &groupname)
 }
 
 
+Coalescing::Ptr Group::GroupCreate(const std::string &groupname,
+                                   const std::chrono::milliseconds min_interval)
+{
+    if (signal_groups.find(groupname) != signal_groups.end())
+    {
+        throw Signals::Exception("Group name '" + groupname + "' exists");
+    }
+    auto emitter = Signals::Coalescing::Create(connection, min_interval);
+    signal_groups[groupname] = emitter;
+    return emitter;
+}
+
+
 void Group::GroupRemove(const std::string &groupname)
 {
     if ("__default__" == groupname)
@@ -155,38 +251,71 @@ void Group::GroupSendGVariant(const std::string &groupname,
                               const std::string &signal_name,
                               GVariant *param)
 {
-    // If the type cache is empty, run the introspection generation
-    // to build the cache
-    if (type_cache.empty())
-    {
-        (void)GenerateIntrospection();
-    }
+    send_gvariant(groupname, signal_name, param);
+    g_variant_unref(param);
+}
 
-    std::string exp_type{};
-    try
-    {
-        // Retrieve the expected type from the type cache for the signal ...
-        exp_type = type_cache.at(signal_name);
-    }
-    catch (const std::out_of_range &)
+
+void Group::send_gvariant(const std::string &groupname,
+                          const std::string &signal_name,
+                          GVariant *param)
+{
+    // Retrieve the expected type from the type cache for the signal ...
+    const auto exp_type = spec->GetType(signal_name);
+    if (!exp_type)
     {
         throw Signals::Exception("Not a registered signal: " + signal_name);
     }
 
     // ... and validate it with what we have recevied
-    std::string param_type(g_variant_get_type_string(param));
-    if (exp_type != param_type)
+    if (!exp_type->Matches(param))
     {
         std::ostringstream err;
         err << "Invalid data type for '" << signal_name << "' "
-            << "Expected '" << exp_type << "' "
-            << "but received '" << param_type << "'";
+            << "Expected '" << exp_type->str() << "' "
+            << "but received '"
+            << (param ? g_variant_get_type_string(param) : "<null>") << "'";
         throw Signals::Exception(err.str());
     }
 
     auto emitter = get_group_emitter(groupname, true);
-    emitter->SendGVariant(signal_name, param);
-    g_variant_unref(param);
+    if (emitter->SendGVariant(signal_name, param))
+    {
+        // Only signals sent to the default recipients are retained;
+        // the values sent to a named group are meant for that group only
+        std::lock_guard<std::mutex> lg(last_values_mtx);
+        if (retained.find(signal_name) != retained.end())
+        {
+            // Keep our own reference to the sent values
+            last_values[{groupname, signal_name}] = glib2::Variant::Borrow(param);
+        }
+    }
+}
+
+
+void Group::RetainLastValue(const std::string &signal_name)
+{
+    if (!spec->GetType(signal_name))
+    {
+        throw Signals::Exception("Not a registered signal: " + signal_name);
+    }
+    std::lock_guard<std::mutex> lg(last_values_mtx);
+    retained.insert(signal_name);
+}
+
+
+GVariant *Group::GetLastValues() const
+{
+    std::lock_guard<std::mutex> lg(last_values_mtx);
+    glib2::Builder::Scoped b("a{sv}");
+    for (const auto &[key, value] : last_values)
+    {
+        if ("__default__" == key.first)
+        {
+            b.AddFormatted("{sv}", key.second.c_str(), value.get());
+        }
+    }
+    return b.Finish();
 }
 
 
@@ -194,6 +323,7 @@ Group::Group(DBus::Connection::Ptr conn,
              const Object::Path &object_path_,
              const std::string &object_interface_)
     : connection(conn),
+      spec(Specification::Lookup(object_interface_)),
       object_path(object_path_), object_interface(object_interface_)
 {
     // Create a default target group
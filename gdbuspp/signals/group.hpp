@@ -17,12 +17,19 @@
 
 #pragma once
 
+#include <chrono>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
 #include <vector>
 
 #include "../connection.hpp"
+#include "../glib2/utils.hpp"
 #include "../object/path.hpp"
+#include "coalescing.hpp"
 #include "emit.hpp"
 
 
@@ -57,6 +64,92 @@ using SignalArgList = std::vector<struct SignalArgument>;
 const std::string SignalArgSignature(const SignalArgList &list);
 
 
+/**
+ *  Immutable description of all the signals provided by a D-Bus interface.
+ *
+ *  Signals::Group objects using the same D-Bus interface and registering
+ *  the same signals share the same Specification object, which keeps the
+ *  signal argument lists and the precompiled data types.  Only the signal
+ *  targets are kept per Signals::Group object.
+ *
+ *  A Specification is never modified once created.  Adding a signal
+ *  creates a new Specification, which is shared with any other
+ *  Signals::Group having registered exactly the same signals.  A
+ *  Signals::Group never sees signals registered by another group.
+ */
+class Specification : public std::enable_shared_from_this<Specification>
+{
+  public:
+    using Ptr = std::shared_ptr<const Specification>;
+
+    /**
+     *  Retrieve the empty Specification for a D-Bus interface, which
+     *  signals are added to via Add()
+     *
+     * @param interface  std::string with the D-Bus interface name
+     * @return Specification::Ptr
+     */
+    [[nodiscard]] static Ptr Lookup(const std::string &interface);
+
+    /**
+     *  Create a new Specification containing all the signals of this
+     *  object together with a new signal.  If an identical specification
+     *  is already in use, that object is returned instead.
+     *
+     * @param signal_name  std::string with the signal name to add
+     * @param args         SignalArgList with the arguments of the signal
+     *
+     * @return Specification::Ptr to the specification to use
+     * @throws Signals::Exception if the signal is already present or
+     *         the data type is invalid
+     */
+    Ptr Add(const std::string &signal_name, const SignalArgList &args) const;
+
+    /**
+     *  Look up the precompiled D-Bus data type of a signal
+     *
+     * @param signal_name  std::string with the signal name
+     * @return const glib2::Utils::VariantType* or nullptr if the signal
+     *         is not present
+     */
+    const glib2::Utils::VariantType *GetType(const std::string &signal_name) const noexcept;
+
+    /**
+     *  Retrieve the D-Bus introspection data for all the signals
+     *  in this specification.  This is generated once, when the
+     *  specification is created.
+     *
+     * @return const std::string containing the XML introspection data
+     */
+    const std::string GenerateIntrospection() const;
+
+
+  private:
+    /// D-Bus interface this specification describes
+    const std::string interface;
+
+    /// Registered signals, used for the D-Bus introspection generation
+    std::map<std::string, SignalArgList> signals{};
+
+    /// Precompiled D-Bus data types of each registered signal
+    std::map<std::string, glib2::Utils::VariantType> types{};
+
+    /// Introspection XML fragment of all the registered signals
+    std::string introspection{};
+
+    Specification(const std::string &interface_);
+
+    /**
+     *  Retrieve the shared object of a specification identical to
+     *  a newly created one.  If none exists, the new one is shared.
+     *
+     * @param spec  Specification::Ptr to the new specification
+     * @return Specification::Ptr to the specification to use
+     */
+    static Ptr intern(Ptr spec);
+};
+
+
 /**
  *  The Signals::Group class is a helper class to easily create
  *  an API in other classes to map C++ methods to sending specific
@@ -133,6 +226,10 @@ class Group
      *  via this object, where it takes two arguments - arg1 (string) and
      *  arg2 (int)
      *
+     *  The signal specification is shared between all objects using
+     *  the same D-Bus interface.  Registering a signal already provided
+     *  by the shared specification with the same arguments is accepted.
+     *
      * @param signal_name std::string of the signal name to register
      * @param signal_type SignalArgList containing all the arguments this signal
      *                    will contain
@@ -174,7 +271,7 @@ class Group
      *
      * @return const std::string containing the XML introspection data
      */
-    const std::string GenerateIntrospection();
+    const std::string GenerateIntrospection() const;
 
 
     /**
@@ -214,6 +311,19 @@ class Group
      */
     void SendGVariant(const std::string &signal_name, GVariant *param);
 
+    /**
+     *  A variant of SendGVariant() taking over the signal data payload
+     *  from an owning glib2::Variant handle.  The payload is released
+     *  when the call returns, also if the signal could not be sent.
+     *
+     * @param signal_name   std::string of the D-Bus signal to send
+     * @param param         glib2::Variant with the signal data payload
+     */
+    void SendGVariant(const std::string &signal_name, glib2::Variant param)
+    {
+        send_gvariant("__default__", signal_name, param.get());
+    }
+
 
     /**
      *  Create a separate distribution list for a group of signal targets
@@ -222,6 +332,21 @@ class Group
      */
     void GroupCreate(const std::string &groupname);
 
+    /**
+     *  Create a separate distribution list for a group of signal targets,
+     *  where each signal is sent at most once within the minimum interval.
+     *  See @Signals::Coalescing for details.
+     *
+     * @param groupname     std::string with a name for the distribution list
+     * @param min_interval  std::chrono::milliseconds with the minimum time
+     *                      between sending the same signal
+     *
+     * @return Coalescing::Ptr to the emitter of this group, which can be
+     *         used to tune the rate limiting per signal
+     */
+    Coalescing::Ptr GroupCreate(const std::string &groupname,
+                                const std::chrono::milliseconds min_interval);
+
 
     /**
      *  Deletes a specific distribution list
@@ -302,6 +427,31 @@ class Group
                            GVariant *param);
 
 
+    /**
+     *  Keep the values of the last sent signal with the given name.
+     *  Subscribers joining late can then retrieve the current state of
+     *  all these signals in a single call via GetLastValues(), instead
+     *  of querying each related property.  See also
+     *  Object::Base::AddLastValuesMethod().
+     *
+     * @param signal_name  std::string with the registered signal name
+     * @throws Signals::Exception if the signal is not registered
+     */
+    void RetainLastValue(const std::string &signal_name);
+
+    /**
+     *  Retrieve the values of the last sent signals enabled via
+     *  RetainLastValue().  Only the signals sent successfully to the
+     *  default recipients are included; signals sent to a named group
+     *  via GroupSendGVariant() or not sent yet are not.
+     *
+     * @return GVariant* with an a{sv} dictionary, where the key is the
+     *         signal name and the value is the tuple with the signal
+     *         values.
+     */
+    GVariant *GetLastValues() const;
+
+
   protected:
     /**
      * Signals::Group contructor
@@ -319,18 +469,12 @@ class Group
     DBus::Connection::Ptr connection{};
 
     /**
-     *  All signals registered via RegisterSignal ends up here.  This is
-     *  used to gather all the needed information for the D-Bus introspection
-     *  generation
+     *  All signals registered via RegisterSignal ends up here, together
+     *  with the precompiled D-Bus data type of each signal.  This object
+     *  is shared with all the other Signals::Group objects using the same
+     *  D-Bus interface.
      */
-    std::map<std::string, SignalArgList> registered_signals;
-
-    /**
-     * This is a look-up cache of all the D-Bus type string used for a
-     * specific signal.  This is created based on the data collected in
-     * registered_signals.
-     */
-    std::map<std::string, std::string> type_cache;
+    Specification::Ptr spec{};
 
     /// D-Bus object path these signals are sent from from
     Object::Path object_path;
@@ -348,6 +492,12 @@ class Group
      */
     std::map<std::string, Signals::Emit::Ptr> signal_groups{};
 
+    /// Signals with their last sent values kept, see RetainLastValue().
+    /// The values are keyed by the group name and the signal name.
+    std::set<std::string> retained{};
+    std::map<std::pair<std::string, std::string>, glib2::Variant> last_values{};
+    mutable std::mutex last_values_mtx{};
+
 
     /**
      *  Private: Retrieve the Signals::Emit object for a specific signal
@@ -362,6 +512,19 @@ class Group
      */
     Signals::Emit::Ptr get_group_emitter(const std::string &groupname,
                                          const bool internal = false) const;
+
+    /**
+     *  Private: Validate and send a signal to a signal target group.
+     *  The caller keeps the ownership of the signal data payload.
+     *
+     * @param groupname    std::string with the group name of recipients to signal
+     * @param signal_name  std::string of the D-Bus signal to send
+     * @param param        GVariant glib2 object containing the signal
+     *                     data payload
+     */
+    void send_gvariant(const std::string &groupname,
+                       const std::string &signal_name,
+                       GVariant *param);
 };
 
 } // namespace Signals
@@ -0,0 +1,272 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ *  @file signals/multiplexer.cpp
+ *
+ *  @brief Implementation of DBus::Signals::Multiplexer
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <glib.h>
+
+#define GDBUSPP_LOG_CATEGORY SIGNALS
+#include "../features/debug-log.hpp"
+#include "../glib2/callbacks.hpp"
+#include "../mainloop.hpp"
+#include "exceptions.hpp"
+#include "multiplexer.hpp"
+
+
+namespace DBus {
+namespace Signals {
+
+namespace _private {
+
+/**
+ *  Build the lookup key of a signal filter.  Unset (nullptr) and empty
+ *  values are kept apart, as glib2 treats them differently.
+ */
+static std::string filter_key(const char *busname,
+                              const char *interface,
+                              const char *member,
+                              const char *object_path,
+                              const char *arg0,
+                              const GDBusSignalFlags flags,
+                              const std::string &match_rule)
+{
+    std::string key = std::to_string(static_cast<int>(flags));
+    for (const char *field : {busname, interface, member, object_path, arg0})
+    {
+        key += (field ? std::string("|") + field : std::string("|\x01"));
+    }
+    return key + "|" + match_rule;
+}
+
+} // namespace _private
+
+
+std::mutex Multiplexer::registry_mtx;
+std::map<GDBusConnection *, std::weak_ptr<Multiplexer>> Multiplexer::registry;
+
+
+Multiplexer::Ptr Multiplexer::Get(DBus::Connection::Ptr conn)
+{
+    std::lock_guard<std::mutex> lg(registry_mtx);
+    auto &entry = registry[conn->ConnPtr()];
+    auto mux = entry.lock();
+    if (!mux)
+    {
+        mux = Multiplexer::Ptr(new Multiplexer(conn));
+        entry = mux;
+    }
+    return mux;
+}
+
+
+Multiplexer::Multiplexer(DBus::Connection::Ptr conn)
+    : connection(conn)
+{
+}
+
+
+Multiplexer::~Multiplexer() noexcept
+{
+    for (const auto &[key, filter] : filters)
+    {
+        g_dbus_connection_signal_unsubscribe(connection->ConnPtr(), filter->signal_id);
+        if (!filter->match_rule.empty())
+        {
+            add_match(filter->match_rule, false);
+        }
+    }
+
+    std::lock_guard<std::mutex> lg(registry_mtx);
+    auto it = registry.find(connection->ConnPtr());
+    if (registry.end() != it && it->second.expired())
+    {
+        registry.erase(it);
+    }
+}
+
+
+void Multiplexer::Add(SingleSubscription::Ptr sub,
+                      const char *busname,
+                      const char *interface,
+                      const char *member,
+                      const char *object_path,
+                      const char *arg0,
+                      const GDBusSignalFlags flags,
+                      const std::string &match_rule)
+{
+    const std::string key = _private::filter_key(busname,
+                                                 interface,
+                                                 member,
+                                                 object_path,
+                                                 arg0,
+                                                 flags,
+                                                 match_rule);
+
+    std::lock_guard<std::mutex> lg(mtx);
+    auto it = filters.find(key);
+    if (filters.end() == it)
+    {
+        auto filter = std::make_shared<Filter>();
+        filter->match_rule = match_rule;
+        if (!match_rule.empty())
+        {
+            add_match(match_rule, true);
+        }
+
+        // glib2 keeps a reference to the filter until the
+        // subscription is fully removed
+        MainLoop::ContextScope scope(connection->GetMainLoop());
+        filter->signal_id = g_dbus_connection_signal_subscribe(connection->ConnPtr(),
+                                                               busname,
+                                                               interface,
+                                                               member,
+                                                               object_path,
+                                                               arg0,
+                                                               flags,
+                                                               dispatch,
+                                                               new std::shared_ptr<Filter>(filter),
+                                                               destroy_filter);
+        if (0 == filter->signal_id)
+        {
+            if (!match_rule.empty())
+            {
+                add_match(match_rule, false);
+            }
+            throw Signals::Exception(sub->target,
+                                     "Failed to subscribe to '" + sub->signal_name + "'");
+        }
+        it = filters.emplace(key, filter).first;
+        GDBUSPP_LOG("Signals::Multiplexer: New filter " << key);
+    }
+
+    {
+        std::lock_guard<std::mutex> flg(it->second->mtx);
+        it->second->subscribers.push_back(sub);
+    }
+    filter_keys[sub.get()] = key;
+    sub->SetSignalID(it->second->signal_id);
+}
+
+
+void Multiplexer::Remove(SingleSubscription::Ptr sub) noexcept
+{
+    std::lock_guard<std::mutex> lg(mtx);
+    auto key = filter_keys.find(sub.get());
+    if (filter_keys.end() == key)
+    {
+        return;
+    }
+    auto it = filters.find(key->second);
+    filter_keys.erase(key);
+    if (filters.end() == it)
+    {
+        return;
+    }
+
+    auto &filter = it->second;
+    bool unused = false;
+    {
+        std::lock_guard<std::mutex> flg(filter->mtx);
+        auto &subs = filter->subscribers;
+        subs.erase(std::remove(subs.begin(), subs.end(), sub), subs.end());
+        unused = subs.empty();
+    }
+    if (unused)
+    {
+        g_dbus_connection_signal_unsubscribe(connection->ConnPtr(), filter->signal_id);
+        if (!filter->match_rule.empty())
+        {
+            add_match(filter->match_rule, false);
+        }
+        GDBUSPP_LOG("Signals::Multiplexer: Removed filter " << it->first);
+        filters.erase(it);
+    }
+}
+
+
+size_t Multiplexer::GetFilterCount() const noexcept
+{
+    std::lock_guard<std::mutex> lg(mtx);
+    return filters.size();
+}
+
+
+void Multiplexer::add_match(const std::string &rule, const bool add) noexcept
+{
+    // The reply is not needed; the D-Bus daemon processes the calls
+    // in order, before any later signal subscription calls
+    g_dbus_connection_call(connection->ConnPtr(),
+                           "org.freedesktop.DBus",
+                           "/org/freedesktop/DBus",
+                           "org.freedesktop.DBus",
+                           (add ? "AddMatch" : "RemoveMatch"),
+                           g_variant_new("(s)", rule.c_str()),
+                           nullptr,
+                           G_DBUS_CALL_FLAGS_NONE,
+                           -1,
+                           nullptr,
+                           nullptr,
+                           nullptr);
+}
+
+
+void Multiplexer::destroy_filter(gpointer filter_ptr)
+{
+    delete static_cast<std::shared_ptr<Filter> *>(filter_ptr);
+}
+
+
+void Multiplexer::dispatch(GDBusConnection *conn,
+                           const gchar *sender,
+                           const gchar *obj_path,
+                           const gchar *intf_name,
+                           const gchar *sign_name,
+                           GVariant *params,
+                           gpointer filter_ptr)
+{
+    auto filter = *static_cast<std::shared_ptr<Filter> *>(filter_ptr);
+
+    // The callbacks may subscribe or unsubscribe, so they are called
+    // on a copy of the subscriber list
+    std::vector<SingleSubscription::Ptr> subscribers;
+    {
+        std::lock_guard<std::mutex> lg(filter->mtx);
+        subscribers = filter->subscribers;
+    }
+    GDBUSPP_TRACE(SIGNALS, DEBUG, "Signal dispatched to {} subscriber(s)", subscribers.size());
+    for (const auto &sub : subscribers)
+    {
+        // A failing subscriber must not prevent the others from
+        // receiving the signal, nor unwind through glib2
+        try
+        {
+            glib2::Callbacks::_int_dbus_connection_signal_handler(conn,
+                                                                  sender,
+                                                                  obj_path,
+                                                                  intf_name,
+                                                                  sign_name,
+                                                                  params,
+                                                                  sub.get());
+        }
+        catch (const std::exception &excp)
+        {
+            std::cerr << "** ERROR ** Signal callback for '" << sign_name
+                      << "' failed: " << excp.what() << std::endl;
+        }
+    }
+}
+
+} // namespace Signals
+} // namespace DBus
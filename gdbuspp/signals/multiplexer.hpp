@@ -0,0 +1,157 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ *  @file signals/multiplexer.hpp
+ *
+ *  @brief Declaration of DBus::Signals::Multiplexer, sharing identical
+ *         D-Bus signal subscriptions between all the
+ *         Signals::SubscriptionManager objects on the same connection
+ */
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <glib.h>
+
+#include "../connection.hpp"
+#include "single-subscription.hpp"
+
+
+namespace DBus {
+namespace Signals {
+
+/**
+ *  Keeps a single glib2 signal subscription, and a single D-Bus match
+ *  rule, per distinct set of sender, object path, interface, signal
+ *  name and first argument filter on a D-Bus connection.  Each received
+ *  signal is passed on to all the Signals::SingleSubscription objects
+ *  using the same filter, within a single main loop dispatch.
+ *
+ *  All Signals::SubscriptionManager objects on the same D-Bus connection
+ *  share the same Multiplexer object.
+ */
+class Multiplexer
+{
+  public:
+    using Ptr = std::shared_ptr<Multiplexer>;
+
+    /**
+     *  Retrieve the Multiplexer object for a D-Bus connection.
+     *  If one does not exist already, it is created.
+     *
+     * @param conn  DBus::Connection::Ptr to the connection
+     *
+     * @return Multiplexer::Ptr
+     */
+    static Multiplexer::Ptr Get(DBus::Connection::Ptr conn);
+
+    ~Multiplexer() noexcept;
+
+    /**
+     *  Pass on signals matching a filter to a subscription.  The filter
+     *  arguments are the same as for g_dbus_connection_signal_subscribe().
+     *  The glib2 signal subscription ID shared by all the subscriptions
+     *  using the same filter is set in the SingleSubscription object.
+     *
+     * @param sub          SingleSubscription::Ptr to receive the signals
+     * @param busname      C string with the sender bus name, may be nullptr
+     * @param interface    C string with the D-Bus interface, may be nullptr
+     * @param member       C string with the signal name, may be nullptr
+     * @param object_path  C string with the object path, may be nullptr
+     * @param arg0         C string with the first argument filter, may
+     *                     be nullptr
+     * @param flags        GDBusSignalFlags for the glib2 subscription
+     * @param match_rule   std::string with a D-Bus match rule to add when
+     *                     G_DBUS_SIGNAL_FLAGS_NO_MATCH_RULE is set
+     *
+     * @throws Signals::Exception if the glib2 subscription failed
+     */
+    void Add(SingleSubscription::Ptr sub,
+             const char *busname,
+             const char *interface,
+             const char *member,
+             const char *object_path,
+             const char *arg0,
+             const GDBusSignalFlags flags,
+             const std::string &match_rule);
+
+    /**
+     *  Stop passing on signals to a subscription.  When the last
+     *  subscription using a filter is removed, the glib2 subscription and
+     *  the D-Bus match rule is removed.
+     *
+     * @param sub  SingleSubscription::Ptr to remove
+     */
+    void Remove(SingleSubscription::Ptr sub) noexcept;
+
+    /**
+     *  Retrieve the number of distinct signal filters in use
+     *
+     * @return size_t
+     */
+    size_t GetFilterCount() const noexcept;
+
+
+  private:
+    /**
+     *  A single glib2 signal subscription with all the subscriptions
+     *  receiving its signals
+     */
+    struct Filter
+    {
+        guint signal_id = 0;
+        std::string match_rule{};
+        std::mutex mtx{};
+        std::vector<SingleSubscription::Ptr> subscribers{};
+    };
+
+    DBus::Connection::Ptr connection;
+    mutable std::mutex mtx{};
+    std::map<std::string, std::shared_ptr<Filter>> filters{};
+    std::map<const SingleSubscription *, std::string> filter_keys{};
+
+    static std::mutex registry_mtx;
+    static std::map<GDBusConnection *, std::weak_ptr<Multiplexer>> registry;
+
+    Multiplexer(DBus::Connection::Ptr conn);
+
+    /**
+     *  Add or remove a D-Bus match rule on the connection
+     *
+     * @param rule  std::string with the match rule
+     * @param add   bool, true to add the rule, false to remove it
+     */
+    void add_match(const std::string &rule, const bool add) noexcept;
+
+    /**
+     *  glib2 signal callback, passing the signal on to all the
+     *  subscriptions of a Filter.  Exceptions thrown by a subscription
+     *  are reported and do not stop the signal from being passed on to
+     *  the remaining subscriptions.
+     */
+    static void dispatch(GDBusConnection *conn,
+                         const gchar *sender,
+                         const gchar *obj_path,
+                         const gchar *intf_name,
+                         const gchar *sign_name,
+                         GVariant *params,
+                         gpointer filter_ptr);
+
+    /**
+     *  Release the Filter reference held by a glib2 signal subscription
+     */
+    static void destroy_filter(gpointer filter_ptr);
+};
+
+} // namespace Signals
+} // namespace DBus
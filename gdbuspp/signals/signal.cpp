@@ -80,6 +80,12 @@ const bool Signal::EmitSignal(GVariant *params) const
         throw Signals::Exception(err.str());
     }
 
+    return EmitSignalUnchecked(params);
+}
+
+
+const bool Signal::EmitSignalUnchecked(GVariant *params) const
+{
     // Send the signal via the Signals::Emit object
     const bool ret = emitter->SendGVariant(signal_name, params);
     g_variant_unref(params);
@@ -17,11 +17,13 @@
 
 #pragma once
 
+#include <array>
 #include <memory>
 #include <string>
 #include <utility>
 #include <glib.h>
 
+#include "../glib2/utils.hpp"
 #include "emit.hpp"
 #include "group.hpp"
 
@@ -100,6 +102,17 @@ class Signal
      */
     const bool EmitSignal(GVariant *params) const;
 
+    /**
+     *  Send (emit) the signal without validating the D-Bus data type of
+     *  the data.  This is only to be used when the data type is already
+     *  guaranteed to be correct, such as by @TypedSignal.
+     *
+     * @param params   GVariant value container with all the signal data as
+     *                 a wrapped tuple.
+     * @return true if sending was successful, otherwise false.
+     */
+    const bool EmitSignalUnchecked(GVariant *params) const;
+
 
   private:
     /**
@@ -121,4 +134,66 @@ class Signal
      */
     std::string dbustype{};
 };
+
+
+
+/**
+ *  Signal where the signal arguments are declared via C++ data types.
+ *  The D-Bus signature, the SignalArgList and the introspection data are
+ *  derived from the C++ data types, and the signal data is created
+ *  directly from the C++ values given to @Emit().  Sending data of the
+ *  wrong data type fails at compile time instead of at runtime.
+ *
+ *  Example:
+ *
+ *      auto sig = sig_group->CreateSignal<Signals::TypedSignal<uint32_t, std::string>>(
+ *          "StatusChange", {"code", "message"});
+ *      sig->Emit(1, "Connected");
+ *
+ * @tparam Args   C++ data types of the signal arguments
+ */
+template <typename... Args>
+class TypedSignal : public Signal
+{
+  public:
+    using Ptr = std::shared_ptr<TypedSignal<Args...>>;
+
+    /**
+     * @param emitter    Signals::Emit::Ptr used to send the signal
+     * @param sig_name   std::string with the signal name
+     * @param argnames   Names of each of the signal arguments
+     */
+    TypedSignal(Signals::Emit::Ptr emitter,
+                const std::string &sig_name,
+                const std::array<std::string, sizeof...(Args)> &argnames)
+        : Signal(emitter, sig_name)
+    {
+        SignalArgList args;
+        args.reserve(sizeof...(Args));
+        size_t idx = 0;
+        ((args.push_back({argnames[idx++], glib2::DataType::DBus<Args>()})), ...);
+        SetArguments(args);
+    }
+
+    /**
+     *  Send (emit) the signal with the given values
+     *
+     * @param values   Values of all the signal arguments
+     * @return true if sending was successful, otherwise false.
+     */
+    const bool Emit(const Args &...values) const
+    {
+        return EmitSignalUnchecked(glib2::Value::Create(std::tuple<Args...>(values...)));
+    }
+
+    /**
+     * @return The D-Bus signature of the signal data, resolved at
+     *         compile time
+     */
+    static constexpr const char *Signature() noexcept
+    {
+        return glib2::DataType::DBus<std::tuple<Args...>>();
+    }
+};
+
 } // namespace DBus::Signals
@@ -18,6 +18,7 @@
 #include <memory>
 #include <glib.h>
 
+#include "dispatcher.hpp"
 #include "event.hpp"
 #include "exceptions.hpp"
 #include "target.hpp"
@@ -87,6 +88,15 @@ class SingleSubscription
     const std::string signal_name;
     Signals::CallbackFnc callback;
 
+    /// Used instead of callback for subscriptions via SubscribeView()
+    Signals::ViewCallbackFnc view_callback = nullptr;
+
+    /// Event queue used when the callback is processed in worker threads
+    Dispatcher::Channel::Ptr channel = nullptr;
+
+    /// D-Bus match rule added for this subscription, if not handled by glib2
+    std::string match_rule{};
+
   private:
     guint signal_id = 0;
 
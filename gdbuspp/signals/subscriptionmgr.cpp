@@ -14,58 +14,275 @@
  *         callback methods to be called when they occurs
  */
 
-#include <algorithm>
+#include <sstream>
 
 #include "subscriptionmgr.hpp"
-#include "../glib2/callbacks.hpp"
 #include "../glib2/strings.hpp"
 
 
+/**
+ *  Number of worker threads processing the signal callbacks of
+ *  subscriptions using Signals::DispatchOptions
+ */
+#define DBUS_SIGNAL_DISPATCH_THREADS 4
+
+
 namespace DBus {
 namespace Signals {
 
+/**
+ *  Generate a D-Bus match rule for a signal subscription, used when
+ *  glib2 cannot generate the match rule itself
+ *
+ * @param busname       C string with the sender bus name, may be nullptr
+ * @param target        Signals::Target::Ptr with the signal source
+ * @param signal_name   std::string with the signal name
+ * @param match         Signals::ArgMatch with the argument filter
+ *
+ * @return std::string with the match rule
+ */
+static std::string signal_match_rule(const char *busname,
+                                     Signals::Target::Ptr target,
+                                     const std::string &signal_name,
+                                     const Signals::ArgMatch &match)
+{
+    std::ostringstream rule;
+    rule << "type='signal'";
+    if (busname)
+    {
+        rule << ",sender='" << busname << "'";
+    }
+    if (!target->object_interface.empty())
+    {
+        rule << ",interface='" << target->object_interface << "'";
+    }
+    if (!signal_name.empty())
+    {
+        rule << ",member='" << signal_name << "'";
+    }
+    rule << ",path_namespace='" << target->object_path << "'";
+    if (!match.arg0.empty())
+    {
+        switch (match.mode)
+        {
+        case Arg0Mode::NAMESPACE:
+            rule << ",arg0namespace='" << match.arg0 << "'";
+            break;
+        case Arg0Mode::PATH:
+            rule << ",arg0path='" << match.arg0 << "'";
+            break;
+        case Arg0Mode::EXACT:
+            rule << ",arg0='" << match.arg0 << "'";
+            break;
+        }
+    }
+    return rule.str();
+}
+
+
 void SubscriptionManager::Subscribe(Signals::Target::Ptr target,
                                     const std::string &signal_name,
                                     Signals::CallbackFnc callback)
 {
-    SingleSubscription::Ptr sub = SingleSubscription::Create(target, signal_name, callback);
+    (void)subscribe(target, signal_name, callback, {});
+}
 
-    guint sigid = g_dbus_connection_signal_subscribe(connection->ConnPtr(),
-                                                     target->GetBusName(srvqry),
-                                                     str2gchar(target->object_interface),
-                                                     str2gchar(signal_name),
-                                                     str2gchar(target->object_path),
-                                                     nullptr,
-                                                     G_DBUS_SIGNAL_FLAGS_NONE,
-                                                     glib2::Callbacks::_int_dbus_connection_signal_handler,
-                                                     sub.get(),
-                                                     nullptr /* destructor */);
-    if (0 == sigid)
+
+void SubscriptionManager::Subscribe(Signals::Target::Ptr target,
+                                    const std::string &signal_name,
+                                    Signals::CallbackFnc callback,
+                                    const Signals::DispatchOptions &options)
+{
+    Subscribe(target, signal_name, callback, Signals::ArgMatch{}, options);
+}
+
+
+void SubscriptionManager::Subscribe(Signals::Target::Ptr target,
+                                    const std::string &signal_name,
+                                    Signals::CallbackFnc callback,
+                                    const Signals::ArgMatch &match)
+{
+    (void)subscribe(target, signal_name, callback, match);
+}
+
+
+void SubscriptionManager::Subscribe(Signals::Target::Ptr target,
+                                    const std::string &signal_name,
+                                    Signals::CallbackFnc callback,
+                                    const Signals::ArgMatch &match,
+                                    const Signals::DispatchOptions &options)
+{
+    if (!dispatcher)
     {
-        throw Signals::Exception(target,
-                                 "Failed to subscribe to '" + signal_name + "'");
+        dispatcher = Signals::Dispatcher::Create(DBUS_SIGNAL_DISPATCH_THREADS);
     }
-    sub->SetSignalID(sigid);
-    subscription_list.push_back(sub);
+    auto channel = dispatcher->NewChannel(callback, options);
+
+    // The main loop only queues the event; the real callback
+    // is called by the dispatcher worker threads
+    auto disp = dispatcher;
+    auto sub = subscribe(target,
+                         signal_name,
+                         [disp, channel](Signals::Event::Ptr &event)
+                         {
+                             disp->Push(channel, event);
+                         },
+                         match);
+    sub->channel = channel;
+}
+
+
+void SubscriptionManager::SubscribeView(Signals::Target::Ptr target,
+                                        const std::string &signal_name,
+                                        Signals::ViewCallbackFnc callback,
+                                        const Signals::ArgMatch &match)
+{
+    (void)subscribe(target, signal_name, nullptr, match, callback);
 }
 
 
 void SubscriptionManager::Unsubscribe(Signals::Target::Ptr target, const std::string &signal_name)
 {
-    auto it = std::find_if(subscription_list.begin(),
-                           subscription_list.end(),
-                           [&target, &signal_name](const SingleSubscription::Ptr sub)
-                           {
-                               return (signal_name == sub->signal_name) && (target == sub->target);
-                           });
-    if (subscription_list.end() == it)
+    auto tgt = subscriptions.find(target.get());
+    if (subscriptions.end() == tgt
+        || tgt->second.signals.find(signal_name) == tgt->second.signals.end())
     {
         throw Signals::Exception(target,
                                  "No subscription for '" + signal_name + "'");
     }
-    g_dbus_connection_signal_unsubscribe(connection->ConnPtr(),
-                                         it->get()->GetSignalID());
-    subscription_list.erase(it);
+    auto sig = tgt->second.signals.find(signal_name);
+
+    // If subscribed more times to the same signal, the
+    // oldest subscription is removed first
+    auto &list = sig->second;
+    unsubscribe(list.front());
+    list.erase(list.begin());
+    if (list.empty())
+    {
+        tgt->second.signals.erase(sig);
+    }
+    if (tgt->second.signals.empty())
+    {
+        subscriptions.erase(tgt);
+    }
+}
+
+
+size_t SubscriptionManager::UnsubscribeAll(Signals::Target::Ptr target) noexcept
+{
+    auto tgt = subscriptions.find(target.get());
+    if (subscriptions.end() == tgt)
+    {
+        return 0;
+    }
+    size_t count = unsubscribe_target(tgt->second);
+    subscriptions.erase(tgt);
+    return count;
+}
+
+
+size_t SubscriptionManager::UnsubscribePathPrefix(const Object::Path &prefix) noexcept
+{
+    size_t count = 0;
+    for (auto tgt = subscriptions.begin(); tgt != subscriptions.end();)
+    {
+        const std::string &path = tgt->second.target->object_path;
+        if (0 == path.compare(0, prefix.size(), prefix)
+            && (path.size() == prefix.size()
+                || prefix.empty()
+                || '/' == prefix.back()
+                || '/' == path[prefix.size()]))
+        {
+            count += unsubscribe_target(tgt->second);
+            tgt = subscriptions.erase(tgt);
+        }
+        else
+        {
+            ++tgt;
+        }
+    }
+    return count;
+}
+
+
+SingleSubscription::Ptr SubscriptionManager::subscribe(Signals::Target::Ptr target,
+                                                       const std::string &signal_name,
+                                                       Signals::CallbackFnc callback,
+                                                       const Signals::ArgMatch &match,
+                                                       Signals::ViewCallbackFnc view_callback)
+{
+    SingleSubscription::Ptr sub = SingleSubscription::Create(target, signal_name, callback);
+    sub->view_callback = std::move(view_callback);
+
+    int flags = G_DBUS_SIGNAL_FLAGS_NONE;
+    if (!match.arg0.empty())
+    {
+        switch (match.mode)
+        {
+        case Arg0Mode::NAMESPACE:
+            flags |= G_DBUS_SIGNAL_FLAGS_MATCH_ARG0_NAMESPACE;
+            break;
+        case Arg0Mode::PATH:
+            flags |= G_DBUS_SIGNAL_FLAGS_MATCH_ARG0_PATH;
+            break;
+        case Arg0Mode::EXACT:
+            break;
+        }
+    }
+
+    const char *busname = target->GetMatchBusName(srvqry);
+    if (target->path_namespace && !target->object_path.empty())
+    {
+        // glib2 cannot express path_namespace match rules; the
+        // match rule is handled here and the object path is checked in
+        // the signal handler
+        flags |= G_DBUS_SIGNAL_FLAGS_NO_MATCH_RULE;
+        sub->match_rule = signal_match_rule(busname, target, signal_name, match);
+    }
+
+    // Identical subscriptions on this connection, also from other
+    // subscription managers, share a single glib2 subscription
+    mux->Add(sub,
+             busname,
+             str2gchar(target->object_interface),
+             str2gchar(signal_name),
+             (target->path_namespace
+                  ? nullptr
+                  : str2gchar(target->object_path)),
+             str2gchar(match.arg0),
+             static_cast<GDBusSignalFlags>(flags),
+             sub->match_rule);
+
+    auto &entry = subscriptions[target.get()];
+    entry.target = target;
+    entry.signals[signal_name].push_back(sub);
+    return sub;
+}
+
+
+void SubscriptionManager::unsubscribe(SingleSubscription::Ptr sub) noexcept
+{
+    mux->Remove(sub);
+    if (sub->channel)
+    {
+        sub->channel->Close();
+    }
+}
+
+
+size_t SubscriptionManager::unsubscribe_target(TargetSubscriptions &entry) noexcept
+{
+    size_t count = 0;
+    for (const auto &[name, list] : entry.signals)
+    {
+        for (const auto &sub : list)
+        {
+            unsubscribe(sub);
+            ++count;
+        }
+    }
+    entry.signals.clear();
+    return count;
 }
 
 
@@ -74,6 +291,7 @@ SubscriptionManager::SubscriptionManager(DBus::Connection::Ptr conn)
     : connection(conn)
 {
     srvqry = DBus::Proxy::Utils::DBusServiceQuery::Create(conn);
+    mux = Signals::Multiplexer::Get(conn);
 }
 
 
@@ -83,12 +301,11 @@ SubscriptionManager::~SubscriptionManager() noexcept
     // manager is deleted, otherwise the D-Bus service will continue to
     // trigger the callback method for these signals - and the callbacks
     // defined via this subscription manager will be deleted.
-    for (const auto &sub : subscription_list)
+    for (auto &[tgt, entry] : subscriptions)
     {
-        g_dbus_connection_signal_unsubscribe(connection->ConnPtr(),
-                                             sub->GetSignalID());
+        (void)unsubscribe_target(entry);
     }
-    subscription_list.clear();
+    subscriptions.clear();
 }
 
 } // namespace Signals
@@ -16,11 +16,17 @@
 
 #pragma once
 
+#include <cstdint>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include <glib.h>
 
 #include "../connection.hpp"
 #include "../proxy/utils.hpp"
+#include "dispatcher.hpp"
+#include "multiplexer.hpp"
 #include "single-subscription.hpp"
 #include "target.hpp"
 
@@ -28,6 +34,29 @@
 namespace DBus {
 namespace Signals {
 
+/**
+ *  How the first signal argument is matched by @Signals::ArgMatch
+ */
+enum class Arg0Mode : uint8_t
+{
+    EXACT,     ///< The argument must be identical to the match value
+    NAMESPACE, ///< The argument is a bus name in the match value namespace
+    PATH       ///< The argument is an object path at or below the match value
+};
+
+
+/**
+ *  Filter on the value of the first signal argument, which must be a
+ *  string.  The filtering is done by the D-Bus daemon, so signals not
+ *  matching are not sent to this process.
+ */
+struct ArgMatch
+{
+    std::string arg0{};              ///< Match value; empty disables the filter
+    Arg0Mode mode = Arg0Mode::EXACT; ///< How the value is matched
+};
+
+
 class SubscriptionManager
 {
   public:
@@ -61,6 +90,24 @@ class SubscriptionManager
                    const std::string &signal_name,
                    Signals::CallbackFnc callback);
 
+    /**
+     *  Add a subscription for a specific D-Bus signal name, where the
+     *  callback is processed in a worker thread instead of the thread
+     *  running the main loop.  The worker threads are shared by all
+     *  subscriptions in this subscription manager.
+     *
+     * @param target        Signals::Target::Ptr object with the match filter
+     * @param signal_name   std::string with the signal name to subscribe to
+     * @param callback      Signals::CallbackFnc being called when matching
+     *                      signals occurs
+     * @param options       Signals::DispatchOptions with the ordering and
+     *                      queue limits for this subscription
+     */
+    void Subscribe(Signals::Target::Ptr target,
+                   const std::string &signal_name,
+                   Signals::CallbackFnc callback,
+                   const Signals::DispatchOptions &options);
+
     /**
      *  Unsubscribe from a D-Bus signal subscription
      *
@@ -69,10 +116,100 @@ class SubscriptionManager
      */
     void Unsubscribe(Signals::Target::Ptr target, const std::string &signal_name);
 
+    /**
+     *  Unsubscribe from all signals subscribed to via a Signals::Target
+     *
+     * @param target      Signals::Target::Ptr object of the subscriptions
+     *
+     * @return Number of removed subscriptions
+     */
+    size_t UnsubscribeAll(Signals::Target::Ptr target) noexcept;
+
+    /**
+     *  Unsubscribe from all signals where the object path of the
+     *  Signals::Target is the given path or a path below it.
+     *
+     * @param prefix      DBus::Object::Path with the object path prefix
+     *
+     * @return Number of removed subscriptions
+     */
+    size_t UnsubscribePathPrefix(const Object::Path &prefix) noexcept;
+
+    /**
+     *  Add a subscription for a specific D-Bus signal name, only matching
+     *  signals where the first argument matches a given value
+     *
+     * @param target        Signals::Target::Ptr object with the match filter
+     * @param signal_name   std::string with the signal name to subscribe to
+     * @param callback      Signals::CallbackFnc being called when matching
+     *                      signals occurs
+     * @param match         Signals::ArgMatch with the argument filter
+     */
+    void Subscribe(Signals::Target::Ptr target,
+                   const std::string &signal_name,
+                   Signals::CallbackFnc callback,
+                   const Signals::ArgMatch &match);
+
+    /**
+     *  Combination of the argument filtered @Subscribe() and the worker
+     *  thread variant of @Subscribe()
+     *
+     * @param target        Signals::Target::Ptr object with the match filter
+     * @param signal_name   std::string with the signal name to subscribe to
+     * @param callback      Signals::CallbackFnc being called when matching
+     *                      signals occurs
+     * @param match         Signals::ArgMatch with the argument filter
+     * @param options       Signals::DispatchOptions with the ordering and
+     *                      queue limits for this subscription
+     */
+    void Subscribe(Signals::Target::Ptr target,
+                   const std::string &signal_name,
+                   Signals::CallbackFnc callback,
+                   const Signals::ArgMatch &match,
+                   const Signals::DispatchOptions &options);
+
+    /**
+     *  Add a subscription for a specific D-Bus signal name, where the
+     *  callback receives a non-owning Signals::EventView instead of a
+     *  Signals::Event object.  This avoids any allocations per
+     *  received signal.  The callback is always called from the thread
+     *  running the main loop.
+     *
+     * @param target        Signals::Target::Ptr object with the match filter
+     * @param signal_name   std::string with the signal name to subscribe to
+     * @param callback      Signals::ViewCallbackFnc being called when
+     *                      matching signals occurs
+     * @param match         Signals::ArgMatch with an optional argument filter
+     */
+    void SubscribeView(Signals::Target::Ptr target,
+                       const std::string &signal_name,
+                       Signals::ViewCallbackFnc callback,
+                       const Signals::ArgMatch &match = {});
+
   private:
+    /**
+     *  All subscriptions of a single Signals::Target, indexed
+     *  by the signal name
+     */
+    struct TargetSubscriptions
+    {
+        Signals::Target::Ptr target = nullptr;
+        std::unordered_map<std::string, std::vector<SingleSubscription::Ptr>> signals{};
+    };
+
     DBus::Connection::Ptr connection;
     DBus::Proxy::Utils::DBusServiceQuery::Ptr srvqry = nullptr;
-    std::vector<SingleSubscription::Ptr> subscription_list;
+    std::unordered_map<const Signals::Target *, TargetSubscriptions> subscriptions{};
+    Signals::Dispatcher::Ptr dispatcher = nullptr;
+    Signals::Multiplexer::Ptr mux = nullptr;
+
+    SingleSubscription::Ptr subscribe(Signals::Target::Ptr target,
+                                      const std::string &signal_name,
+                                      Signals::CallbackFnc callback,
+                                      const Signals::ArgMatch &match,
+                                      Signals::ViewCallbackFnc view_callback = nullptr);
+    void unsubscribe(SingleSubscription::Ptr sub) noexcept;
+    size_t unsubscribe_target(TargetSubscriptions &entry) noexcept;
 
     SubscriptionManager(DBus::Connection::Ptr conn);
 };
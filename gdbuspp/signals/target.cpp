@@ -13,6 +13,8 @@
  *         target.
  */
 
+#include <cstring>
+#include <mutex>
 #include <string>
 
 #include "../object/path.hpp"
@@ -30,35 +32,113 @@ Target::Ptr Target::Create(const std::string &busname,
 }
 
 
+Target::Ptr Target::Create(const std::string &busname,
+                           const Object::Path &object_path,
+                           const std::string &interface,
+                           const bool path_namespace)
+{
+    return Target::Ptr(new Target(busname, object_path, interface, path_namespace));
+}
+
+
 Target::Target(const std::string &busname_,
                const Object::Path &object_path_,
-               const std::string &interface)
+               const std::string &interface,
+               const bool path_namespace_)
     : busname(busname_), object_path(object_path_),
-      object_interface(interface)
+      object_interface(interface), path_namespace(path_namespace_)
+{
+}
+
+
+bool Target::MatchPath(const char *path) const noexcept
 {
+    if (object_path.empty())
+    {
+        return true;
+    }
+    if (!path)
+    {
+        return false;
+    }
+    if (!path_namespace)
+    {
+        return object_path == path;
+    }
+
+    // Same rules as the D-Bus path_namespace match rule key
+    if ("/" == object_path)
+    {
+        return true;
+    }
+    const size_t len = object_path.size();
+    return (0 == strncmp(path, object_path.c_str(), len)
+            && ('\0' == path[len] || '/' == path[len]));
 }
 
 
-const char *Target::GetBusName(std::shared_ptr<Proxy::Utils::DBusServiceQuery> service_qry)
+std::string Target::GetBusName(std::shared_ptr<Proxy::Utils::DBusServiceQuery> service_qry)
 {
+    // Keep the service query object for later lookups.  It caches
+    // the unique bus names and keeps them current if the owner changes
+    std::shared_ptr<Proxy::Utils::DBusServiceQuery> qry = nullptr;
+    {
+        std::lock_guard<std::mutex> lg(busname_mtx);
+        if (service_qry)
+        {
+            srvqry = service_qry;
+        }
+        qry = srvqry;
+    }
+
     // Only do a unique busname lookup if:
-    //  the busname does not contain a unique bus name (starts with ':1.')
-    //  && a service_qry object is available
+    //  the busname does not contain a unique bus name (starts with ':')
+    //  && a service query object is available
     //  && the well-known busname is not empty (expect matching on a bus name)
-    //  && it has not already looked it up (unique_busname is not empty)
-    if (busname.find(":1.") == std::string::npos
-        && service_qry
-        && !busname.empty()
-        && unique_busname.empty())
+    if (!busname.empty() && ':' != busname[0] && qry)
     {
-        unique_busname = service_qry->GetNameOwner(busname);
+        std::string owner{};
+        try
+        {
+            owner = qry->GetNameOwner(busname);
+        }
+        catch (const DBus::Exception &)
+        {
+            if (service_qry)
+            {
+                // Explicit lookup requests should report errors
+                throw;
+            }
+            // The name has no owner currently; fall back to the
+            // well-known bus name
+        }
+
+        // Signals may be dispatched from several threads; the result
+        // is a copy of the resolved name and not a pointer into it
+        std::lock_guard<std::mutex> lg(busname_mtx);
+        unique_busname = owner;
+        return (!owner.empty() ? owner : busname);
     }
 
     // Only return the unique busname if we have it.  Otherwise use the
-    // well-known busname if set.  If both are unset, nullptr is returned
-    // as that is accepted by the glib2 APIs to not match on bus names
-    return (!unique_busname.empty() ? unique_busname.c_str()
-                                    : (!busname.empty() ? busname.c_str() : nullptr));
+    // well-known busname if set.  If both are unset, an empty string is
+    // returned
+    std::lock_guard<std::mutex> lg(busname_mtx);
+    return (!unique_busname.empty() ? unique_busname : busname);
+}
+
+
+const char *Target::GetMatchBusName(std::shared_ptr<Proxy::Utils::DBusServiceQuery> service_qry)
+{
+    if (service_qry)
+    {
+        {
+            std::lock_guard<std::mutex> lg(busname_mtx);
+            srvqry = service_qry;
+        }
+        service_qry->PrefetchNameOwner(busname);
+    }
+    return (!busname.empty() ? busname.c_str() : nullptr);
 }
 
 
@@ -66,7 +146,8 @@ bool Target::operator==(const Target::Ptr cmp)
 {
     return ((busname == cmp->busname)
             && (object_path == cmp->object_path)
-            && (object_interface == cmp->object_interface));
+            && (object_interface == cmp->object_interface)
+            && (path_namespace == cmp->path_namespace));
 }
 
 
@@ -17,7 +17,9 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
 #include <sstream>
+#include <string>
 #include <vector>
 #include <glib.h>
 
@@ -50,6 +52,10 @@ class Target
     const Object::Path object_path;
     const std::string object_interface;
 
+    /// If true, object_path matches it and all object paths below it.  Only
+    /// used when subscribing to signals
+    const bool path_namespace = false;
+
     /**
      *  Create a new target object
      *
@@ -64,23 +70,69 @@ class Target
                                             const Object::Path &object_path,
                                             const std::string &interface);
 
+    /**
+     *  Create a new target object for signal subscriptions, which can
+     *  match all the object paths in an object path namespace.  The
+     *  matching is done by the D-Bus daemon, so signals from other object
+     *  paths are not sent to this process.
+     *
+     * @param busname         std::string with the D-Bus bus name (unique or
+     *                        well-known)
+     * @param object_path     DBus::Object::Path with the D-Bus object path
+     * @param interface       std::string with the D-Bus object interface scope
+     * @param path_namespace  If true, match signals from object_path and
+     *                        all object paths below it
+     *
+     * @return Target::Ptr
+     */
+    [[nodiscard]] static Target::Ptr Create(const std::string &busname,
+                                            const Object::Path &object_path,
+                                            const std::string &interface,
+                                            const bool path_namespace);
+
+    /**
+     *  Checks if an object path is matched by this target
+     *
+     * @param path   C string with the object path to check
+     * @return true if the object path matches
+     */
+    bool MatchPath(const char *path) const noexcept;
+
     /**
      *  Retrieve the bus name of the target.
      *
      *  If this method is given a DBus::Proxy::Utils::DBusServiceQuery
-     *  object, it will attempt to lookup and cache the unique busname if
-     *  the busname is a a well-known bus name (not starting with ':1.').
+     *  object, it will attempt to lookup the unique busname if the busname
+     *  is a a well-known bus name (not starting with ':').  The service
+     *  query object is preserved and used for later calls as well; it
+     *  keeps track of the unique bus name if the bus name owner changes.
      *
      *  If the lookup has been successful, it will return the unique bus
      *  name of the target bus name.  Otherwise it will return the
      *  well-known bus name instead
      *
-     *  This is aimed to be used directly by glib2 signal functions, so if
-     *  both unique and well-known bus names are empty, it will return nullptr
+     *  The bus name is returned as a copy, as the unique bus name may be
+     *  updated by other threads.  If both unique and well-known bus names
+     *  are empty, an empty string is returned.
+     *
+     * @return std::string
+     */
+    std::string GetBusName(std::shared_ptr<Proxy::Utils::DBusServiceQuery> = nullptr);
+
+    /**
+     *  Retrieve the bus name to use when subscribing to signals from
+     *  this target.  This is the bus name as it was given, so the D-Bus
+     *  daemon delivers the signals from the current owner of a well-known
+     *  bus name, even after the owner changes.
+     *
+     *  The unique bus name lookup, used by @GetBusName() to check the
+     *  sender of received signals, is started in the background without
+     *  waiting for the result.  The service query object is preserved
+     *  for later @GetBusName() calls.
      *
-     * @return const char*
+     * @return const char*, nullptr if no bus name is set
      */
-    const char *GetBusName(std::shared_ptr<Proxy::Utils::DBusServiceQuery> = nullptr);
+    const char *GetMatchBusName(std::shared_ptr<Proxy::Utils::DBusServiceQuery> service_qry);
 
     bool operator==(const Target::Ptr cmp);
     bool operator!=(const Target::Ptr &cmp);
@@ -95,11 +147,14 @@ class Target
 
 
   private:
+    std::mutex busname_mtx{};
     std::string unique_busname{};
+    std::shared_ptr<Proxy::Utils::DBusServiceQuery> srvqry = nullptr;
 
     Target(const std::string &busname_,
            const Object::Path &object_path_,
-           const std::string &interface);
+           const std::string &interface,
+           const bool path_namespace_ = false);
 };
 
 } // namespace Signals
@@ -0,0 +1,570 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file stream.cpp
+ *
+ * @brief  Implementation of DBus::Stream::Producer and
+ *         DBus::Stream::Consumer
+ */
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <glib.h>
+#include <glib-unix.h>
+
+#include "stream.hpp"
+
+
+/**
+ *  Identifies a GDBus++ stream ring buffer ("GDSR") and its layout version
+ */
+#define GDBUSPP_STREAM_MAGIC 0x52534447
+#define GDBUSPP_STREAM_VERSION 1
+
+/**
+ *  Limits of the ring buffer data area size
+ */
+#define GDBUSPP_STREAM_MIN_CAPACITY 4096
+#define GDBUSPP_STREAM_MAX_CAPACITY (1u << 30)
+
+/**
+ *  Record length marking the rest of the data area as unused; the next
+ *  record starts at the beginning of the data area
+ */
+#define GDBUSPP_STREAM_PAD_RECORD 0xffffffff
+
+
+namespace DBus {
+namespace Stream {
+
+namespace _private {
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "Stream requires lock-free 64-bit atomics");
+
+/**
+ *  The shared memory ring buffer header, followed by the data area.
+ *
+ *  The producer and consumer positions are free running byte counters;
+ *  each of them is only written by one side and kept on its own cache
+ *  line.  Each record is a 32-bit length followed by the record data,
+ *  padded to 8 bytes.  A record never wraps around the end of the data
+ *  area.
+ */
+struct Ring
+{
+    uint32_t magic = GDBUSPP_STREAM_MAGIC;
+    uint32_t version = GDBUSPP_STREAM_VERSION;
+    uint64_t capacity = 0;
+
+    // Written by the producer
+    alignas(64) std::atomic<uint64_t> head{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint32_t> closed{0};
+
+    // Written by the consumer
+    alignas(64) std::atomic<uint64_t> tail{0};
+    std::atomic<uint32_t> consumer_waiting{0};
+
+    uint8_t *data() noexcept
+    {
+        return reinterpret_cast<uint8_t *>(this) + sizeof(Ring);
+    }
+
+    bool available() const noexcept
+    {
+        return head.load(std::memory_order_seq_cst) != tail.load(std::memory_order_relaxed);
+    }
+};
+
+} // namespace _private
+
+
+namespace {
+
+static inline uint64_t record_size(const size_t size) noexcept
+{
+    return (sizeof(uint32_t) + size + 7) & ~uint64_t(7);
+}
+
+} // anonymous namespace
+
+
+
+Exception::Exception(const std::string &errm)
+    : DBus::Exception("DBus::Stream", errm, nullptr)
+{
+}
+
+
+
+//
+//  Stream::Producer
+//
+
+Producer::Ptr Producer::Create(const size_t capacity)
+{
+    return Producer::Ptr(new Producer(capacity));
+}
+
+
+Producer::Producer(const size_t capacity)
+{
+    if (capacity > GDBUSPP_STREAM_MAX_CAPACITY)
+    {
+        throw Stream::Exception("Stream capacity too large");
+    }
+    size_t cap = GDBUSPP_STREAM_MIN_CAPACITY;
+    while (cap < capacity)
+    {
+        cap <<= 1;
+    }
+    mapping_size = sizeof(_private::Ring) + cap;
+
+    memfd = memfd_create("gdbuspp-stream", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (memfd < 0)
+    {
+        throw Stream::Exception("Could not create memfd: "
+                                + std::string(strerror(errno)));
+    }
+    if (ftruncate(memfd, mapping_size) < 0
+        || fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0)
+    {
+        const std::string err(strerror(errno));
+        close(memfd);
+        throw Stream::Exception("Could not prepare the stream memfd: " + err);
+    }
+
+    void *m = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (MAP_FAILED == m)
+    {
+        const std::string err(strerror(errno));
+        close(memfd);
+        throw Stream::Exception("Could not map the stream memfd: " + err);
+    }
+    ring = new (m) _private::Ring();
+    ring->capacity = cap;
+    this->capacity = cap;
+
+    eventfd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (eventfd < 0)
+    {
+        const std::string err(strerror(errno));
+        munmap(ring, mapping_size);
+        close(memfd);
+        throw Stream::Exception("Could not create the stream eventfd: " + err);
+    }
+}
+
+
+Producer::~Producer() noexcept
+{
+    Close();
+    munmap(ring, mapping_size);
+    close(memfd);
+    close(eventfd);
+}
+
+
+std::vector<int> Producer::DuplicateFDs() const
+{
+    std::vector<int> fds;
+    for (int fd : {memfd, eventfd})
+    {
+        int dupfd = dup(fd);
+        if (dupfd < 0)
+        {
+            const std::string err(strerror(errno));
+            for (int f : fds)
+            {
+                close(f);
+            }
+            throw Stream::Exception("Could not duplicate the stream file descriptors: " + err);
+        }
+        fds.push_back(dupfd);
+    }
+    return fds;
+}
+
+
+void Producer::Offer(Object::Method::Arguments::Ptr args)
+{
+    std::vector<int> fds = DuplicateFDs();
+    try
+    {
+        // The file descriptors are closed once the response has been sent
+        args->SendFDs(fds);
+    }
+    catch (const DBus::Exception &excp)
+    {
+        for (int f : fds)
+        {
+            close(f);
+        }
+        throw Stream::Exception(std::string("Could not offer the stream: ")
+                                + excp.GetRawError());
+    }
+}
+
+
+bool Producer::Write(const void *data, const size_t size) noexcept
+{
+    const uint64_t total = record_size(size);
+    if (total > capacity / 2 || size >= GDBUSPP_STREAM_PAD_RECORD)
+    {
+        ring->dropped.store(dropped.fetch_add(1, std::memory_order_relaxed) + 1,
+                            std::memory_order_relaxed);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lg(write_mtx);
+
+    // The tail is written by the consumer and is not trusted.  A tail
+    // which does not fit the records written so far resets the ring to
+    // that position; this only happens with a misbehaving consumer.
+    const uint64_t tail = ring->tail.load(std::memory_order_acquire);
+    if (head - tail > capacity)
+    {
+        head = (tail + 7) & ~uint64_t(7);
+    }
+    const uint64_t used = head - tail;
+    uint64_t pos = head & (capacity - 1);
+    const uint64_t contig = capacity - pos;
+    const uint64_t needed = total + (contig < total ? contig : 0);
+    if (closed || capacity - used < needed)
+    {
+        ring->dropped.store(dropped.fetch_add(1, std::memory_order_relaxed) + 1,
+                            std::memory_order_relaxed);
+        return false;
+    }
+
+    uint8_t *area = ring->data();
+    if (contig < total)
+    {
+        const uint32_t pad = GDBUSPP_STREAM_PAD_RECORD;
+        std::memcpy(area + pos, &pad, sizeof(pad));
+        head += contig;
+        pos = 0;
+    }
+    const uint32_t len = static_cast<uint32_t>(size);
+    std::memcpy(area + pos, &len, sizeof(len));
+    std::memcpy(area + pos + sizeof(len), data, size);
+    head += total;
+    ring->head.store(head, std::memory_order_seq_cst);
+
+    // Only the first record after the consumer started waiting wakes it up
+    if (ring->consumer_waiting.exchange(0, std::memory_order_seq_cst))
+    {
+        wakeup();
+    }
+    return true;
+}
+
+
+uint64_t Producer::GetDropped() const noexcept
+{
+    return dropped.load(std::memory_order_relaxed);
+}
+
+
+size_t Producer::GetCapacity() const noexcept
+{
+    return capacity;
+}
+
+
+void Producer::Close() noexcept
+{
+    std::lock_guard<std::mutex> lg(write_mtx);
+    if (!closed)
+    {
+        closed = true;
+        ring->closed.store(1);
+        wakeup();
+    }
+}
+
+
+void Producer::wakeup() noexcept
+{
+    const uint64_t one = 1;
+    if (write(eventfd, &one, sizeof(one)) < 0 && EAGAIN != errno)
+    {
+        std::cerr << "** ERROR ** Stream::Producer: Could not wake up the consumer: "
+                  << strerror(errno) << std::endl;
+    }
+}
+
+
+
+//
+//  Stream::Consumer
+//
+
+Consumer::Ptr Consumer::Open(Proxy::Client::Ptr proxy,
+                             Proxy::TargetPreset::Ptr preset,
+                             const std::string &method,
+                             GVariant *params)
+{
+    std::vector<int> fds;
+    GVariant *res = proxy->CallWithFDs(preset, method, params, {}, fds);
+    if (res)
+    {
+        g_variant_unref(res);
+    }
+
+    auto close_fds = [&fds]()
+    {
+        for (int fd : fds)
+        {
+            close(fd);
+        }
+    };
+    if (fds.size() != 2)
+    {
+        close_fds();
+        throw Stream::Exception("D-Bus method " + method + " did not provide a stream");
+    }
+
+    try
+    {
+        Consumer::Ptr consumer(new Consumer(fds[0], fds[1]));
+        close_fds();
+        return consumer;
+    }
+    catch (...)
+    {
+        close_fds();
+        throw;
+    }
+}
+
+
+Consumer::Ptr Consumer::Create(const int memfd, const int eventfd)
+{
+    return Consumer::Ptr(new Consumer(memfd, eventfd));
+}
+
+
+Consumer::Consumer(const int memfd, const int evfd)
+{
+    const int seals = fcntl(memfd, F_GET_SEALS);
+    if (seals < 0 || !(seals & F_SEAL_SHRINK))
+    {
+        throw Stream::Exception("Stream memfd is not sealed");
+    }
+
+    struct stat st = {};
+    if (fstat(memfd, &st) < 0)
+    {
+        throw Stream::Exception("Could not retrieve the stream size: "
+                                + std::string(strerror(errno)));
+    }
+    if (st.st_size < static_cast<off_t>(sizeof(_private::Ring) + GDBUSPP_STREAM_MIN_CAPACITY))
+    {
+        throw Stream::Exception("Stream memfd is too small");
+    }
+
+    mapping_size = static_cast<size_t>(st.st_size);
+    void *m = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (MAP_FAILED == m)
+    {
+        throw Stream::Exception("Could not map the stream memfd: "
+                                + std::string(strerror(errno)));
+    }
+    ring = static_cast<_private::Ring *>(m);
+
+    capacity = ring->capacity;
+    if (ring->magic != GDBUSPP_STREAM_MAGIC
+        || ring->version != GDBUSPP_STREAM_VERSION
+        || capacity == 0
+        || (capacity & (capacity - 1)) != 0
+        || sizeof(_private::Ring) + capacity != mapping_size)
+    {
+        munmap(m, mapping_size);
+        throw Stream::Exception("Invalid stream memfd");
+    }
+
+    eventfd = dup(evfd);
+    if (eventfd < 0)
+    {
+        const std::string err(strerror(errno));
+        munmap(m, mapping_size);
+        throw Stream::Exception("Could not duplicate the stream eventfd: " + err);
+    }
+}
+
+
+Consumer::~Consumer() noexcept
+{
+    Unwatch();
+    munmap(ring, mapping_size);
+    close(eventfd);
+}
+
+
+size_t Consumer::Read(RecordFnc fnc)
+{
+    const uint64_t head = ring->head.load(std::memory_order_acquire);
+    uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+    if (head - tail > capacity)
+    {
+        throw Stream::Exception("Stream ring buffer is corrupted");
+    }
+
+    const uint8_t *area = ring->data();
+    size_t count = 0;
+    while (tail != head)
+    {
+        const uint64_t pos = tail & (capacity - 1);
+        const uint64_t contig = capacity - pos;
+        uint32_t len = 0;
+        std::memcpy(&len, area + pos, sizeof(len));
+        if (GDBUSPP_STREAM_PAD_RECORD == len)
+        {
+            tail += contig;
+            ring->tail.store(tail, std::memory_order_release);
+            continue;
+        }
+
+        const uint64_t total = record_size(len);
+        if (total > contig || total > head - tail)
+        {
+            throw Stream::Exception("Stream ring buffer is corrupted");
+        }
+
+        // The record space is only released to the producer after the
+        // callback has processed it, also if it fails
+        try
+        {
+            fnc(area + pos + sizeof(len), len);
+        }
+        catch (...)
+        {
+            ring->tail.store(tail + total, std::memory_order_release);
+            throw;
+        }
+        tail += total;
+        ring->tail.store(tail, std::memory_order_release);
+        ++count;
+    }
+    return count;
+}
+
+
+bool Consumer::Wait(const int timeout_ms) noexcept
+{
+    if (ring->available())
+    {
+        return true;
+    }
+
+    ring->consumer_waiting.store(1, std::memory_order_seq_cst);
+    if (!ring->available() && !ring->closed.load(std::memory_order_seq_cst))
+    {
+        struct pollfd pfd = {eventfd, POLLIN, 0};
+        (void)poll(&pfd, 1, timeout_ms);
+    }
+    ring->consumer_waiting.store(0, std::memory_order_seq_cst);
+    drain_eventfd();
+    return ring->available();
+}
+
+
+void Consumer::Watch(RecordFnc fnc, GMainContext *context)
+{
+    Unwatch();
+    watch_fnc = std::move(fnc);
+    watch = g_unix_fd_source_new(eventfd, G_IO_IN);
+    g_source_set_callback(watch,
+                          reinterpret_cast<GSourceFunc>(watch_cb),
+                          this,
+                          nullptr);
+    g_source_attach(watch, context);
+
+    // Process the records already waiting on the first main loop iteration
+    const uint64_t one = 1;
+    (void)!write(eventfd, &one, sizeof(one));
+}
+
+
+void Consumer::Unwatch() noexcept
+{
+    if (watch)
+    {
+        g_source_destroy(watch);
+        g_source_unref(watch);
+        watch = nullptr;
+    }
+    ring->consumer_waiting.store(0, std::memory_order_seq_cst);
+}
+
+
+bool Consumer::IsClosed() const noexcept
+{
+    return ring->closed.load(std::memory_order_acquire) && !ring->available();
+}
+
+
+uint64_t Consumer::GetDropped() const noexcept
+{
+    return ring->dropped.load(std::memory_order_relaxed);
+}
+
+
+void Consumer::drain_eventfd() noexcept
+{
+    uint64_t count = 0;
+    (void)!read(eventfd, &count, sizeof(count));
+}
+
+
+gboolean Consumer::watch_cb(gint fd, GIOCondition condition, gpointer this_ptr)
+{
+    auto self = static_cast<Consumer *>(this_ptr);
+    self->drain_eventfd();
+    try
+    {
+        do
+        {
+            self->ring->consumer_waiting.store(0, std::memory_order_seq_cst);
+            self->Read(self->watch_fnc);
+            self->ring->consumer_waiting.store(1, std::memory_order_seq_cst);
+        } while (self->ring->available());
+    }
+    catch (const std::exception &excp)
+    {
+        std::cerr << "** ERROR ** Stream::Consumer: " << excp.what() << std::endl;
+        g_source_unref(self->watch);
+        self->watch = nullptr;
+        return G_SOURCE_REMOVE;
+    }
+
+    if (self->IsClosed())
+    {
+        g_source_unref(self->watch);
+        self->watch = nullptr;
+        return G_SOURCE_REMOVE;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+} // namespace Stream
+} // namespace DBus
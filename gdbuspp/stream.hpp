@@ -0,0 +1,312 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+#pragma once
+
+/**
+ * @file stream.hpp
+ *
+ * @brief  Declaration of DBus::Stream, a shared memory ring buffer
+ *         streaming records between processes, negotiated via D-Bus
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <glib.h>
+
+#include "exceptions.hpp"
+#include "object/method.hpp"
+#include "proxy.hpp"
+
+
+/**
+ *  Default size (in bytes) of the DBus::Stream ring buffer data area
+ */
+#define GDBUSPP_STREAM_DEFAULT_CAPACITY (1024 * 1024)
+
+
+namespace DBus {
+
+/**
+ *  A DBus::Stream passes a high rate of small records, like per-packet
+ *  counters or log lines, from a producer to a consumer in another
+ *  process without marshalling each record into a D-Bus message.
+ *
+ *  The records are written into a ring buffer in a memfd shared by both
+ *  processes.  An eventfd wakes up the consumer when new records are
+ *  available; the producer only signals it when the consumer is waiting
+ *  for more records, so a busy stream does not cost a system call per
+ *  record.  D-Bus is only used to hand over these two file descriptors,
+ *  via the D-Bus method file descriptor passing:
+ *
+ *    - The D-Bus service creates a Stream::Producer and passes it to the
+ *      caller in a D-Bus method declared with PassFDmode::SEND, using
+ *      Stream::Producer::Offer() in the method callback.
+ *
+ *    - The proxy client calls this D-Bus method via
+ *      Stream::Consumer::Open() and reads the records via
+ *      Stream::Consumer::Read(), Stream::Consumer::Wait() or
+ *      Stream::Consumer::Watch().
+ *
+ *  A stream has a single consumer.  Several threads in the producing
+ *  process may write to the same Stream::Producer concurrently.  When
+ *  the ring buffer is full, new records are dropped and counted
+ *  instead of blocking the producer.
+ */
+namespace Stream {
+
+namespace _private {
+struct Ring;
+}
+
+
+class Exception : public DBus::Exception
+{
+  public:
+    Exception(const std::string &errm);
+};
+
+
+/**
+ *  The writing side of a stream
+ */
+class Producer
+{
+  public:
+    using Ptr = std::shared_ptr<Producer>;
+
+    /**
+     *  Create a new stream, backed by a new memfd and eventfd
+     *
+     * @param capacity  size_t with the size of the ring buffer data
+     *                  area; rounded up to a power of 2 (optional)
+     *
+     * @return Producer::Ptr
+     * @throws Stream::Exception if the shared memory could not be set up
+     */
+    [[nodiscard]] static Producer::Ptr Create(const size_t capacity = GDBUSPP_STREAM_DEFAULT_CAPACITY);
+
+    ~Producer() noexcept;
+
+    Producer(const Producer &) = delete;
+    Producer &operator=(const Producer &) = delete;
+
+    /**
+     *  Pass this stream to the caller of a D-Bus method.  The method
+     *  must have been declared with PassFDmode::SEND or PassFDmode::BOTH.
+     *  A stream can be offered to a single consumer only.
+     *
+     * @param args  Object::Method::Arguments::Ptr of the ongoing method call
+     *
+     * @throws Stream::Exception if the file descriptors could not
+     *         be prepared
+     */
+    void Offer(Object::Method::Arguments::Ptr args);
+
+    /**
+     *  Duplicate the memfd and eventfd file descriptors of this stream,
+     *  to pass them to a consumer by other means than Offer().  The
+     *  caller owns the returned file descriptors.
+     *
+     * @return std::vector<int> with the memfd and eventfd, in that order
+     * @throws Stream::Exception if the file descriptors could not
+     *         be duplicated
+     */
+    [[nodiscard]] std::vector<int> DuplicateFDs() const;
+
+    /**
+     *  Write a record to the stream
+     *
+     * @param data  Pointer to the record data
+     * @param size  size_t with the length of the record
+     *
+     * @return true if the record was written; false if it was dropped
+     *         because the ring buffer is full or the record is too large
+     */
+    bool Write(const void *data, const size_t size) noexcept;
+
+    /**
+     *  Write a string as a record to the stream
+     *
+     * @param record  std::string with the record data
+     *
+     * @return true if the record was written; false if it was dropped
+     */
+    bool Write(const std::string &record) noexcept
+    {
+        return Write(record.data(), record.size());
+    }
+
+    /**
+     *  Retrieve the number of records dropped so far
+     *
+     * @return uint64_t
+     */
+    uint64_t GetDropped() const noexcept;
+
+    /**
+     *  Retrieve the size of the ring buffer data area
+     *
+     * @return size_t
+     */
+    size_t GetCapacity() const noexcept;
+
+    /**
+     *  Close the stream.  The consumer can read the records already
+     *  written and will then see the stream as closed.  Further writes
+     *  are dropped.
+     */
+    void Close() noexcept;
+
+
+  private:
+    _private::Ring *ring = nullptr;
+    size_t mapping_size = 0;
+    int memfd = -1;
+    int eventfd = -1;
+    std::mutex write_mtx{};
+
+    // The consumer can write to the whole shared memory area.  The ring
+    // positions and limits used when writing are therefore kept here,
+    // and only the consumer tail is read from the shared memory.
+    uint64_t capacity = 0;
+    uint64_t head = 0;
+    bool closed = false;
+    std::atomic<uint64_t> dropped{0};
+
+    Producer(const size_t capacity);
+    void wakeup() noexcept;
+};
+
+
+
+/**
+ *  The reading side of a stream
+ */
+class Consumer
+{
+  public:
+    using Ptr = std::shared_ptr<Consumer>;
+
+    /**
+     *  Callback function processing a single record.  The data is only
+     *  valid while the callback function runs.
+     */
+    using RecordFnc = std::function<void(const uint8_t *data, size_t size)>;
+
+    /**
+     *  Open a stream by calling a D-Bus method in a D-Bus service
+     *  which passes a Stream::Producer via Stream::Producer::Offer()
+     *
+     * @param proxy   Proxy::Client::Ptr to the D-Bus service
+     * @param preset  Proxy::TargetPreset::Ptr with the object path and
+     *                interface of the D-Bus method
+     * @param method  std::string with the D-Bus method to call
+     * @param params  GVariant* with the D-Bus method arguments (optional)
+     *
+     * @return Consumer::Ptr
+     * @throws Stream::Exception if the D-Bus method did not provide a stream
+     * @throws DBus::Proxy::Exception if the D-Bus call failed
+     */
+    [[nodiscard]] static Consumer::Ptr Open(Proxy::Client::Ptr proxy,
+                                            Proxy::TargetPreset::Ptr preset,
+                                            const std::string &method,
+                                            GVariant *params = nullptr);
+
+    /**
+     *  Attach to a stream via its file descriptors.  The file
+     *  descriptors are duplicated; the caller still owns them.
+     *
+     * @param memfd    File descriptor of the shared memory ring buffer
+     * @param eventfd  File descriptor of the wakeup eventfd
+     *
+     * @return Consumer::Ptr
+     * @throws Stream::Exception if the file descriptors are not a valid stream
+     */
+    [[nodiscard]] static Consumer::Ptr Create(const int memfd, const int eventfd);
+
+    ~Consumer() noexcept;
+
+    Consumer(const Consumer &) = delete;
+    Consumer &operator=(const Consumer &) = delete;
+
+    /**
+     *  Process all the records currently available, without waiting
+     *
+     * @param fnc  RecordFnc called for each record
+     *
+     * @return size_t with the number of records processed
+     * @throws Stream::Exception if the ring buffer is corrupted
+     */
+    size_t Read(RecordFnc fnc);
+
+    /**
+     *  Wait for new records to become available
+     *
+     * @param timeout_ms  int with the maximum time to wait in milliseconds;
+     *                    -1 waits until records arrive or the stream closes
+     *
+     * @return true if records are available, false on timeout or if the
+     *         stream has been closed
+     */
+    bool Wait(const int timeout_ms = -1) noexcept;
+
+    /**
+     *  Process the records in a glib2 main loop instead of reading them
+     *  explicitly.  The callback function is called from that main loop
+     *  whenever new records arrive, until the stream closes or
+     *  Unwatch() is called.
+     *
+     * @param fnc      RecordFnc called for each record
+     * @param context  GMainContext* to attach to; nullptr for the
+     *                 default main context (optional)
+     */
+    void Watch(RecordFnc fnc, GMainContext *context = nullptr);
+
+    /**
+     *  Stop processing records in the glib2 main loop
+     */
+    void Unwatch() noexcept;
+
+    /**
+     *  Check if the producer has closed the stream and all the records
+     *  have been read
+     *
+     * @return true if the stream is closed
+     */
+    bool IsClosed() const noexcept;
+
+    /**
+     *  Retrieve the number of records dropped by the producer because
+     *  the ring buffer was full
+     *
+     * @return uint64_t
+     */
+    uint64_t GetDropped() const noexcept;
+
+
+  private:
+    _private::Ring *ring = nullptr;
+    size_t mapping_size = 0;
+    uint64_t capacity = 0; ///< Validated when attaching; never re-read
+    int eventfd = -1;
+    GSource *watch = nullptr;
+    RecordFnc watch_fnc = nullptr;
+
+    Consumer(const int memfd, const int eventfd);
+    void drain_eventfd() noexcept;
+    static gboolean watch_cb(gint fd, GIOCondition condition, gpointer this_ptr);
+};
+
+} // namespace Stream
+} // namespace DBus
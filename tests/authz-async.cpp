@@ -0,0 +1,383 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file   authz-async.cpp
+ *
+ * @brief  Tests asynchronous authorization via Object::Base::AuthorizeAsync().
+ *         The test runs a small service in a separate thread, which parks
+ *         the authorization decisions until the test completes them.  This
+ *         needs a session bus.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glib.h>
+
+#include "../gdbuspp/authz-request.hpp"
+#include "../gdbuspp/connection.hpp"
+#include "../gdbuspp/object/base.hpp"
+#include "../gdbuspp/proxy.hpp"
+#include "../gdbuspp/service.hpp"
+#include "test-constants.hpp"
+#include "test-utils.hpp"
+
+using namespace DBus;
+using namespace Test;
+using TestUtils::run_test;
+using TestUtils::TestResult;
+
+
+/**
+ *  Object parking all the authorization decisions until the test
+ *  completes them
+ */
+class ParkingObject : public Object::Base
+{
+  public:
+    using Ptr = std::shared_ptr<ParkingObject>;
+
+    ParkingObject()
+        : Object::Base(Constants::GenPath("authzasync"),
+                       Constants::GenInterface("authzasync"))
+    {
+        DisableIdleDetector(true);
+        AsyncAuthorization(true);
+        AddMethod("Ping",
+                  [this](Object::Method::Arguments::Ptr args)
+                  {
+                      ++calls;
+                      args->SetMethodReturn(nullptr);
+                  });
+    }
+
+    const bool Authorize(const Authz::Request::Ptr request) override
+    {
+        // Only AuthorizeAsync() is expected to be used
+        return false;
+    }
+
+    void AuthorizeAsync(const Authz::Request::Ptr request,
+                        Authz::Decision::Ptr decision) override
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        parked.push_back(decision);
+        parked_cv.notify_all();
+    }
+
+    /**
+     *  Wait for a number of decisions to be parked
+     *
+     * @param count  Number of decisions to wait for
+     * @return true if the decisions arrived within 5 seconds
+     */
+    bool WaitParked(const size_t count)
+    {
+        std::unique_lock<std::mutex> lk(mtx);
+        return parked_cv.wait_for(lk,
+                                  std::chrono::seconds(5),
+                                  [this, count]()
+                                  {
+                                      return parked.size() >= count;
+                                  });
+    }
+
+    /**
+     *  Take over all the parked decisions
+     */
+    std::vector<Authz::Decision::Ptr> TakeParked()
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        std::vector<Authz::Decision::Ptr> ret;
+        ret.swap(parked);
+        return ret;
+    }
+
+    std::atomic<unsigned int> calls{0};
+
+  private:
+    std::mutex mtx{};
+    std::condition_variable parked_cv{};
+    std::vector<Authz::Decision::Ptr> parked{};
+};
+
+
+/**
+ *  Object using the default AuthorizeAsync() implementation
+ */
+class DefaultObject : public Object::Base
+{
+  public:
+    DefaultObject()
+        : Object::Base(Constants::GenPath("authzasync/default"),
+                       Constants::GenInterface("authzasync"))
+    {
+        DisableIdleDetector(true);
+        AsyncAuthorization(true);
+        AddMethod("Ping",
+                  [](Object::Method::Arguments::Ptr args)
+                  {
+                      args->SetMethodReturn(nullptr);
+                  });
+    }
+
+    const bool Authorize(const Authz::Request::Ptr request) override
+    {
+        authorize_thread = std::this_thread::get_id();
+        return true;
+    }
+
+    std::atomic<std::thread::id> authorize_thread{};
+};
+
+
+/**
+ *  Object with asynchronous property access, where AuthorizeAsync()
+ *  decides on GetAll calls
+ */
+class PropertyObject : public Object::Base
+{
+  public:
+    PropertyObject()
+        : Object::Base(Constants::GenPath("authzasync/properties"),
+                       Constants::GenInterface("authzasync"))
+    {
+        DisableIdleDetector(true);
+        AsyncAuthorization(true);
+        AsyncPropertyAccess(true);
+        AddProperty("first", first, false);
+        AddProperty("second", second, false);
+    }
+
+    const bool Authorize(const Authz::Request::Ptr request) override
+    {
+        // Only AuthorizeAsync() is expected to be used
+        ++authorize_calls;
+        return true;
+    }
+
+    void AuthorizeAsync(const Authz::Request::Ptr request,
+                        Authz::Decision::Ptr decision) override
+    {
+        const bool get_all = (Object::Operation::PROPERTY_GET == request->operation
+                              && GetInterface() + "." == request->target);
+        if (get_all)
+        {
+            ++get_all_requests;
+            if (deny_get_all)
+            {
+                decision->Deny("GetAll not allowed by the test");
+                return;
+            }
+        }
+        decision->Grant();
+    }
+
+    std::atomic<bool> deny_get_all{true};
+    std::atomic<unsigned int> get_all_requests{0};
+    std::atomic<unsigned int> authorize_calls{0};
+
+  private:
+    uint32_t first = 1;
+    uint32_t second = 2;
+};
+
+
+class AuthzAsyncService : public Service
+{
+  public:
+    AuthzAsyncService(Connection::Ptr conn)
+        : Service(conn, Constants::GenServiceName("authzasync"))
+    {
+    }
+
+    void BusNameAcquired(const std::string &busname) override
+    {
+        acquired = true;
+    }
+
+    void BusNameLost(const std::string &busname) override
+    {
+        Stop();
+    }
+
+    std::atomic<bool> acquired{false};
+};
+
+
+static bool call_fails(std::future<GVariant *> &result, const std::string &expect)
+{
+    try
+    {
+        g_variant_unref(result.get());
+        return false;
+    }
+    catch (const DBus::Exception &excp)
+    {
+        return std::string(excp.what()).find(expect) != std::string::npos;
+    }
+}
+
+
+int main()
+{
+    int failures = 0;
+    try
+    {
+        auto srvconn = Connection::Create(BusType::SESSION);
+        auto service = Service::Create<AuthzAsyncService>(srvconn);
+        AsyncProcess::Pool::Config cfg;
+        cfg.max_queued_per_sender = 2;
+        service->ConfigureRequestPool(cfg);
+        auto parking = service->CreateServiceHandler<ParkingObject>();
+        auto dflt = service->GetObjectManager()->CreateObject<DefaultObject>();
+        auto props = service->GetObjectManager()->CreateObject<PropertyObject>();
+
+        std::thread srvthread([service]()
+                              {
+                                  service->Run();
+                              });
+        for (int i = 0; i < 500 && !service->acquired; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        auto conn = Connection::CreateExclusive(BusType::SESSION);
+        auto prx = Proxy::Client::Create(conn, Constants::GenServiceName("authzasync"));
+        const Object::Path path = parking->GetPath();
+        const std::string intf = parking->GetInterface();
+
+        failures += run_test([prx, parking, path, intf]()
+                             {
+                                 auto result = prx->CallAsync(path, intf, "Ping");
+                                 bool ok = parking->WaitParked(1) && 0 == parking->calls;
+                                 for (auto &d : parking->TakeParked())
+                                 {
+                                     d->Grant();
+                                 }
+                                 g_variant_unref(result.get());
+                                 return TestResult("Parked request is processed once granted",
+                                                   ok && 1 == parking->calls);
+                             });
+
+        failures += run_test([prx, parking, path, intf]()
+                             {
+                                 auto result = prx->CallAsync(path, intf, "Ping");
+                                 bool ok = parking->WaitParked(1);
+                                 for (auto &d : parking->TakeParked())
+                                 {
+                                     d->Deny("Not allowed by the test");
+                                 }
+                                 return TestResult("Denied request is rejected",
+                                                   ok && call_fails(result, "Not allowed by the test")
+                                                       && 1 == parking->calls);
+                             });
+
+        failures += run_test([prx, parking, path, intf]()
+                             {
+                                 auto first = prx->CallAsync(path, intf, "Ping");
+                                 auto second = prx->CallAsync(path, intf, "Ping");
+                                 bool ok = parking->WaitParked(2);
+                                 auto third = prx->CallAsync(path, intf, "Ping");
+                                 ok &= call_fails(third, "Too many requests queued");
+                                 for (auto &d : parking->TakeParked())
+                                 {
+                                     d->Grant();
+                                 }
+                                 g_variant_unref(first.get());
+                                 g_variant_unref(second.get());
+                                 return TestResult("Pending decisions count against the queue limits",
+                                                   ok && 3 == parking->calls);
+                             });
+
+        failures += run_test([parking, path, intf]()
+                             {
+                                 auto other = Connection::CreateExclusive(BusType::SESSION);
+                                 auto otherprx = Proxy::Client::Create(other,
+                                                                       Constants::GenServiceName("authzasync"));
+                                 auto result = otherprx->CallAsync(path, intf, "Ping");
+                                 bool ok = parking->WaitParked(1);
+                                 auto decisions = parking->TakeParked();
+                                 other->Disconnect();
+
+                                 // The disconnect is seen by the service thread
+                                 bool cancelled = false;
+                                 for (int i = 0; i < 500 && !cancelled; ++i)
+                                 {
+                                     cancelled = !decisions.empty() && decisions[0]->IsCancelled();
+                                     std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                                 }
+                                 for (auto &d : decisions)
+                                 {
+                                     d->Grant();
+                                 }
+                                 return TestResult("Request of a disconnected caller is dropped",
+                                                   ok && cancelled && 3 == parking->calls);
+                             });
+
+        failures += run_test([prx, props]()
+                             {
+                                 bool rejected = false;
+                                 try
+                                 {
+                                     g_variant_unref(prx->GetAllProperties(props->GetPath(),
+                                                                           props->GetInterface()));
+                                 }
+                                 catch (const Proxy::Exception &excp)
+                                 {
+                                     rejected = std::string(excp.what()).find("GetAll not allowed by the test")
+                                                != std::string::npos;
+                                 }
+                                 return TestResult("GetAll denied by AuthorizeAsync() is rejected",
+                                                   rejected && 1 == props->get_all_requests
+                                                       && 0 == props->authorize_calls);
+                             });
+
+        failures += run_test([prx, props]()
+                             {
+                                 props->deny_get_all = false;
+                                 GVariant *all = prx->GetAllProperties(props->GetPath(),
+                                                                       props->GetInterface());
+                                 const size_t count = g_variant_n_children(all);
+                                 g_variant_unref(all);
+                                 GVariant *first = prx->GetPropertyGVariant(props->GetPath(),
+                                                                            props->GetInterface(),
+                                                                            "first");
+                                 g_variant_unref(first);
+                                 return TestResult("GetAll granted by AuthorizeAsync() returns all properties",
+                                                   2 == count && 2 == props->get_all_requests
+                                                       && 0 == props->authorize_calls);
+                             });
+
+        failures += run_test([prx, dflt, &srvthread]()
+                             {
+                                 GVariant *r = prx->Call(dflt->GetPath(), dflt->GetInterface(), "Ping");
+                                 g_variant_unref(r);
+                                 return TestResult("Default AuthorizeAsync() runs Authorize() in the request pool",
+                                                   std::thread::id() != dflt->authorize_thread
+                                                       && srvthread.get_id() != dflt->authorize_thread);
+                             });
+
+        service->Stop();
+        srvthread.join();
+    }
+    catch (const DBus::Exception &excp)
+    {
+        std::cerr << "** EXCEPTION **  " << excp.what() << std::endl;
+        return 3;
+    }
+
+    return TestUtils::test_summary(failures);
+}
@@ -0,0 +1,163 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file   authz-cache.cpp
+ *
+ * @brief  Tests the internal Authz::Cache of granted authorization
+ *         decisions; cache hits, expiry and removing the decisions of
+ *         a caller disconnecting from the bus, also before its decision
+ *         is stored.  This needs a session bus.
+ */
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <glib.h>
+
+#include "../gdbuspp/authz-cache.hpp"
+#include "../gdbuspp/connection.hpp"
+#include "test-utils.hpp"
+
+using namespace DBus;
+using TestUtils::run_test;
+using TestUtils::TestResult;
+
+
+static Authz::Request::Ptr make_request(const std::string &caller,
+                                        const std::string &interface,
+                                        const std::string &member)
+{
+    return Authz::Request::Create(caller,
+                                  Object::Operation::METHOD_CALL,
+                                  "/net/openvpn/gdbuspp/test/authzcache",
+                                  interface,
+                                  interface + "." + member);
+}
+
+
+int main()
+{
+    int failures = 0;
+    try
+    {
+        auto conn = Connection::Create(BusType::SESSION);
+        auto cache = Authz::Cache::Create(conn);
+        const std::string caller = conn->GetUniqueBusName();
+
+        failures += run_test([conn, cache]()
+                             {
+                                 return TestResult("The connection cache is shared",
+                                                   Authz::Cache::Create(conn) == cache
+                                                       && Authz::Cache::Get(conn->ConnPtr()) == cache);
+                             });
+
+        failures += run_test([cache, caller]()
+                             {
+                                 auto req = make_request(caller, "test.authz.one", "Method");
+                                 const bool before = cache->Lookup(req);
+                                 cache->Store(req, std::chrono::seconds(30));
+                                 return TestResult("Granted request is found",
+                                                   !before && cache->Lookup(req)
+                                                       && cache->Lookup(make_request(caller, "test.authz.one", "Method")));
+                             });
+
+        failures += run_test([cache, caller]()
+                             {
+                                 return TestResult("Other member is not found",
+                                                   !cache->Lookup(make_request(caller, "test.authz.one", "Other")));
+                             });
+
+        failures += run_test([cache, caller]()
+                             {
+                                 // Same target string, but a different interface
+                                 auto req = Authz::Request::Create(caller,
+                                                                   Object::Operation::METHOD_CALL,
+                                                                   "/net/openvpn/gdbuspp/test/authzcache",
+                                                                   "test.authz.two",
+                                                                   "test.authz.one.Method");
+                                 return TestResult("Other interface is not found", !cache->Lookup(req));
+                             });
+
+        failures += run_test([cache]()
+                             {
+                                 return TestResult("Other caller is not found",
+                                                   !cache->Lookup(make_request(":1.0", "test.authz.one", "Method")));
+                             });
+
+        failures += run_test([cache, caller]()
+                             {
+                                 auto req = make_request(caller, "test.authz.one", "Expiring");
+                                 cache->Store(req, std::chrono::milliseconds(200));
+                                 const bool found = cache->Lookup(req);
+                                 std::this_thread::sleep_for(std::chrono::milliseconds(300));
+                                 return TestResult("Granted request expires",
+                                                   found && !cache->Lookup(req));
+                             });
+
+        failures += run_test([cache]()
+                             {
+                                 auto peer = Connection::CreateExclusive(BusType::SESSION);
+                                 auto req = make_request(peer->GetUniqueBusName(), "test.authz.one", "Method");
+                                 cache->Store(req, std::chrono::seconds(30));
+                                 const bool found = cache->Lookup(req);
+
+                                 // The NameOwnerChanged signal is processed
+                                 // via the default main context
+                                 peer->Disconnect();
+                                 const int64_t timeout = g_get_monotonic_time() + 5 * G_USEC_PER_SEC;
+                                 while (cache->Lookup(req) && g_get_monotonic_time() < timeout)
+                                 {
+                                     g_main_context_iteration(nullptr, false);
+                                     std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                                 }
+                                 return TestResult("Disconnected caller is removed",
+                                                   found && !cache->Lookup(req));
+                             });
+
+        failures += run_test([cache]()
+                             {
+                                 auto peer = Connection::CreateExclusive(BusType::SESSION);
+                                 auto req = make_request(peer->GetUniqueBusName(), "test.authz.one", "Method");
+                                 peer->Disconnect();
+
+                                 // The caller lookup is done via the
+                                 // default main context
+                                 cache->Store(req, std::chrono::seconds(30));
+                                 const int64_t timeout = g_get_monotonic_time() + 5 * G_USEC_PER_SEC;
+                                 while (cache->Lookup(req) && g_get_monotonic_time() < timeout)
+                                 {
+                                     g_main_context_iteration(nullptr, false);
+                                     std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                                 }
+                                 return TestResult("Caller disconnected before Store() is removed",
+                                                   !cache->Lookup(req));
+                             });
+
+        failures += run_test([conn]()
+                             {
+                                 auto cache = Authz::Cache::Get(conn->ConnPtr());
+                                 return TestResult("Cache is kept while in use", cache != nullptr);
+                             });
+
+        cache.reset();
+        failures += run_test([conn]()
+                             {
+                                 return TestResult("Cache is released with its owner",
+                                                   Authz::Cache::Get(conn->ConnPtr()) == nullptr);
+                             });
+    }
+    catch (const DBus::Exception &excp)
+    {
+        std::cerr << "** EXCEPTION **  " << excp.what() << std::endl;
+        return 3;
+    }
+
+    return TestUtils::test_summary(failures);
+}
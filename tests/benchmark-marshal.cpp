@@ -0,0 +1,513 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file   benchmark-marshal.cpp
+ *
+ * @brief  In-process microbenchmarks of the glib2::Value and glib2::Builder
+ *         marshalling functions between C++ and GVariant.  This does not
+ *         use any D-Bus connection.
+ *
+ *         For each data type and array size, it reports the time spent
+ *         per element and the number of memory allocations per operation.
+ */
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <getopt.h>
+#include <glib.h>
+
+#include "../gdbuspp/glib2/utils.hpp"
+#include "test-utils.hpp"
+
+
+static std::atomic<uint64_t> allocations{0};
+
+#ifdef __GLIBC__
+// Count all the memory allocations done via malloc() and the aligned
+// allocators, which includes both the C++ operator new (also the aligned
+// variants) and the glib2 g_malloc() and g_aligned_alloc() families
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t nmemb, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+
+void *malloc(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    if (0 == alignment || 0 != (alignment % sizeof(void *))
+        || 0 != (alignment & (alignment - 1)))
+    {
+        return EINVAL;
+    }
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void *ptr = __libc_memalign(alignment, size);
+    if (!ptr)
+    {
+        return ENOMEM;
+    }
+    *memptr = ptr;
+    return 0;
+}
+}
+#define ALLOCATIONS_COUNTED true
+#else
+#define ALLOCATIONS_COUNTED false
+#endif
+
+
+
+class Options : protected TestUtils::OptionParser
+{
+  public:
+    Options(const int argc, char **argv)
+    {
+        static struct option long_opts[] = {
+            // clang-format off
+            {"max-size", required_argument, nullptr, 'm'},
+            {"min-time", required_argument, nullptr, 't'},
+            {"filter",   required_argument, nullptr, 'f'},
+            {"json",     no_argument,       nullptr, 'j'},
+            {"help",     no_argument,       nullptr, 'h'},
+            {nullptr, 0, nullptr, 0}
+            // clang-format on
+        };
+
+        int opt;
+        optind = 1;
+        while ((opt = getopt_long(argc, argv, "m:t:f:jh", long_opts, nullptr)) != -1)
+        {
+            switch (opt)
+            {
+            case 'm':
+                max_size = std::max(1l, ::atol(optarg));
+                break;
+            case 't':
+                min_time_usec = std::max(1l, ::atol(optarg)) * 1000;
+                break;
+            case 'f':
+                filter = std::string(optarg);
+                break;
+            case 'j':
+                json = true;
+                break;
+            case 'h':
+                help(argv[0], long_opts);
+                exit(0);
+            }
+        }
+    }
+
+    size_t max_size = 1000000;
+    int64_t min_time_usec = 100000;
+    std::string filter{};
+    bool json = false;
+};
+
+
+
+/**
+ *  The measured cost of a single marshalling operation
+ */
+struct Result
+{
+    std::string operation{};
+    std::string type{};
+    size_t elements = 0;
+    uint64_t runs = 0;
+    double ns_per_element = 0;
+    double allocs_per_op = 0;
+};
+
+
+class Runner
+{
+  public:
+    Runner(const Options &opts_)
+        : opts(opts_)
+    {
+    }
+
+
+    /**
+     *  Run an operation repeatedly for at least the configured minimum
+     *  time (and at least 3 times), after one warm-up run
+     *
+     * @param operation  std::string with the name of the operation
+     * @param type       std::string with the D-Bus type being processed
+     * @param elements   size_t with the number of elements per run
+     * @param fnc        The operation to measure
+     */
+    void Measure(const std::string &operation,
+                 const std::string &type,
+                 const size_t elements,
+                 std::function<void()> fnc)
+    {
+        if (!opts.filter.empty()
+            && (operation + ":" + type).find(opts.filter) == std::string::npos)
+        {
+            return;
+        }
+
+        fnc();
+
+        Result res;
+        res.operation = operation;
+        res.type = type;
+        res.elements = elements;
+        const uint64_t allocs_start = allocations.load(std::memory_order_relaxed);
+        const int64_t start = g_get_monotonic_time();
+        int64_t elapsed = 0;
+        do
+        {
+            fnc();
+            ++res.runs;
+            elapsed = g_get_monotonic_time() - start;
+        } while (elapsed < opts.min_time_usec || res.runs < 3);
+        const uint64_t allocs = allocations.load(std::memory_order_relaxed) - allocs_start;
+
+        res.ns_per_element = (elapsed * 1000.0) / (res.runs * std::max<size_t>(1, elements));
+        res.allocs_per_op = static_cast<double>(allocs) / res.runs;
+        results.push_back(res);
+
+        if (!opts.json)
+        {
+            std::cout << std::left << std::setw(16) << operation
+                      << std::setw(12) << type
+                      << std::right << std::setw(9) << elements
+                      << std::fixed << std::setprecision(2)
+                      << std::setw(14) << res.ns_per_element
+                      << std::setw(14);
+            if (ALLOCATIONS_COUNTED)
+            {
+                std::cout << res.allocs_per_op;
+            }
+            else
+            {
+                std::cout << "n/a";
+            }
+            std::cout << std::endl;
+        }
+    }
+
+
+    void PrintHeader() const
+    {
+        if (!opts.json)
+        {
+            std::cout << std::left << std::setw(16) << "operation"
+                      << std::setw(12) << "type"
+                      << std::right << std::setw(9) << "elements"
+                      << std::setw(14) << "ns/element"
+                      << std::setw(14) << "allocs/op"
+                      << std::endl;
+        }
+    }
+
+
+    void PrintJSON() const
+    {
+        if (!opts.json)
+        {
+            return;
+        }
+        std::cout << "{\"allocations_counted\": "
+                  << (ALLOCATIONS_COUNTED ? "true" : "false") << ", "
+                  << "\"results\": [";
+        bool first = true;
+        for (const auto &r : results)
+        {
+            std::cout << (first ? "" : ",") << std::endl
+                      << "  {\"operation\": \"" << r.operation << "\", "
+                      << "\"type\": \"" << r.type << "\", "
+                      << "\"elements\": " << r.elements << ", "
+                      << "\"runs\": " << r.runs << ", "
+                      << "\"ns_per_element\": " << r.ns_per_element << ", "
+                      << "\"allocs_per_op\": " << r.allocs_per_op << "}";
+            first = false;
+        }
+        std::cout << std::endl
+                  << "]}" << std::endl;
+    }
+
+
+    const Options &opts;
+
+  private:
+    std::vector<Result> results{};
+};
+
+
+
+template <typename T>
+T sample_value(const size_t i);
+
+template <>
+uint16_t sample_value(const size_t i)
+{
+    return static_cast<uint16_t>(i);
+}
+
+template <>
+int16_t sample_value(const size_t i)
+{
+    return -static_cast<int16_t>(i);
+}
+
+template <>
+uint32_t sample_value(const size_t i)
+{
+    return static_cast<uint32_t>(i);
+}
+
+template <>
+int32_t sample_value(const size_t i)
+{
+    return -static_cast<int32_t>(i);
+}
+
+template <>
+uint64_t sample_value(const size_t i)
+{
+    return i * 3;
+}
+
+template <>
+int64_t sample_value(const size_t i)
+{
+    return -static_cast<int64_t>(i * 3);
+}
+
+template <>
+double sample_value(const size_t i)
+{
+    return i * 1.5;
+}
+
+template <>
+bool sample_value(const size_t i)
+{
+    return (i % 2) == 0;
+}
+
+template <>
+std::byte sample_value(const size_t i)
+{
+    return static_cast<std::byte>(i & 0xff);
+}
+
+template <>
+std::string sample_value(const size_t i)
+{
+    return "benchmark string " + std::to_string(i);
+}
+
+template <>
+DBus::Object::Path sample_value(const size_t i)
+{
+    return DBus::Object::Path("/net/openvpn/gdbuspp/benchmark/obj_" + std::to_string(i));
+}
+
+
+/**
+ *  Run all the array operations of a basic data type, for array sizes
+ *  1, 10, 100, ... up to the configured maximum size
+ */
+template <typename T>
+void bench_type(Runner &runner)
+{
+    const std::string type = glib2::DataType::DBus<T>();
+    for (size_t size = 1; size <= runner.opts.max_size; size *= 10)
+    {
+        std::vector<T> input;
+        input.reserve(size);
+        for (size_t i = 0; i < size; ++i)
+        {
+            input.push_back(sample_value<T>(i));
+        }
+
+        runner.Measure("CreateVector",
+                       type,
+                       size,
+                       [&input]()
+                       {
+                           GVariant *v = g_variant_ref_sink(glib2::Value::CreateVector(input));
+                           g_variant_unref(v);
+                       });
+
+        runner.Measure("FromVector",
+                       type,
+                       size,
+                       [&input]()
+                       {
+                           GVariantBuilder *b = glib2::Builder::FromVector(input);
+                           g_variant_unref(g_variant_ref_sink(glib2::Builder::Finish(b)));
+                       });
+
+        GVariant *array = g_variant_ref_sink(glib2::Value::CreateVector(input));
+        runner.Measure("ExtractVector",
+                       type,
+                       size,
+                       [array]()
+                       {
+                           // ExtractVector() takes over the reference
+                           auto r = glib2::Value::ExtractVector<T>(g_variant_ref(array), nullptr, false);
+                       });
+        g_variant_unref(array);
+
+        std::vector<GVariant *> children;
+        children.reserve(size);
+        for (const auto &e : input)
+        {
+            children.push_back(glib2::Value::Create<T>(e));
+        }
+        GVariant *tuple = g_variant_ref_sink(g_variant_new_tuple(children.data(), children.size()));
+        runner.Measure("Extract",
+                       type,
+                       size,
+                       [tuple, size]()
+                       {
+                           for (size_t i = 0; i < size; ++i)
+                           {
+                               (void)glib2::Value::Extract<T>(tuple, static_cast<int>(i));
+                           }
+                       });
+        g_variant_unref(tuple);
+    }
+}
+
+
+/**
+ *  Run the Create/Get operations of a container data type.  The elements
+ *  are produced by the gen function.
+ */
+template <typename T, typename GEN>
+void bench_container(Runner &runner, GEN &&gen)
+{
+    const std::string type = glib2::DataType::DBus<T>();
+    for (size_t size = 1; size <= runner.opts.max_size; size *= 10)
+    {
+        const T input = gen(size);
+        runner.Measure("Create",
+                       type,
+                       size,
+                       [&input]()
+                       {
+                           g_variant_unref(g_variant_ref_sink(glib2::Value::Create(input)));
+                       });
+
+        GVariant *value = g_variant_ref_sink(glib2::Value::Create(input));
+        runner.Measure("Get",
+                       type,
+                       size,
+                       [value]()
+                       {
+                           auto r = glib2::Value::Get<T>(value);
+                       });
+        g_variant_unref(value);
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    Options opts(argc, argv);
+    Runner runner(opts);
+    runner.PrintHeader();
+
+    bench_type<uint16_t>(runner);
+    bench_type<int16_t>(runner);
+    bench_type<uint32_t>(runner);
+    bench_type<int32_t>(runner);
+    bench_type<uint64_t>(runner);
+    bench_type<int64_t>(runner);
+    bench_type<double>(runner);
+    bench_type<bool>(runner);
+    bench_type<std::byte>(runner);
+    bench_type<std::string>(runner);
+    bench_type<DBus::Object::Path>(runner);
+
+    // Nested containers; the element count is the number of outer elements
+    bench_container<std::vector<std::vector<uint32_t>>>(
+        runner,
+        [](const size_t size)
+        {
+            return std::vector<std::vector<uint32_t>>(size, {1, 2, 3, 4, 5, 6, 7, 8});
+        });
+    bench_container<std::vector<std::vector<std::string>>>(
+        runner,
+        [](const size_t size)
+        {
+            return std::vector<std::vector<std::string>>(size, {"one", "two", "three"});
+        });
+    bench_container<std::map<std::string, uint32_t>>(
+        runner,
+        [](const size_t size)
+        {
+            std::map<std::string, uint32_t> m;
+            for (size_t i = 0; i < size; ++i)
+            {
+                m[sample_value<std::string>(i)] = static_cast<uint32_t>(i);
+            }
+            return m;
+        });
+    bench_container<std::vector<std::tuple<std::string, uint32_t, bool>>>(
+        runner,
+        [](const size_t size)
+        {
+            std::vector<std::tuple<std::string, uint32_t, bool>> v;
+            v.reserve(size);
+            for (size_t i = 0; i < size; ++i)
+            {
+                v.emplace_back(sample_value<std::string>(i), static_cast<uint32_t>(i), i % 2);
+            }
+            return v;
+        });
+
+    runner.PrintJSON();
+    return 0;
+}
@@ -0,0 +1,585 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file   benchmark.cpp
+ *
+ * @brief  Throughput and latency benchmarks of the GDBus++ method call,
+ *         property, signal and file descriptor passing paths.
+ *
+ *         The same program provides both the benchmark service (--service)
+ *         and the client measuring it (--run).  The results are written as
+ *         JSON.  This is normally run via the tests/scripts/run-benchmark
+ *         script, which runs everything on a private session bus.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <glib.h>
+
+#include "../gdbuspp/connection.hpp"
+#include "../gdbuspp/mainloop.hpp"
+#include "../gdbuspp/proxy.hpp"
+#include "../gdbuspp/proxy/utils.hpp"
+#include "../gdbuspp/service.hpp"
+#include "../gdbuspp/signals/group.hpp"
+#include "../gdbuspp/signals/subscriptionmgr.hpp"
+#include "../gdbuspp/signals/target.hpp"
+#include "test-constants.hpp"
+#include "test-utils.hpp"
+
+
+using namespace Test;
+
+
+/// All the benchmarks run by default, in this order
+static const std::vector<std::string> all_benchmarks = {
+    "empty-method",
+    "dict-payload",
+    "bytes-payload",
+    "property-get",
+    "property-set",
+    "signals",
+    "fd-passing"};
+
+
+class Options : protected TestUtils::OptionParser
+{
+  public:
+    Options(const int argc, char **argv)
+    {
+        static struct option long_opts[] = {
+            // clang-format off
+            {"service",      no_argument,       nullptr, 'S'},
+            {"run",          required_argument, nullptr, 'r'},
+            {"iterations",   required_argument, nullptr, 'n'},
+            {"dict-entries", required_argument, nullptr, 'd'},
+            {"bytes",        required_argument, nullptr, 'b'},
+            {"subscribers",  required_argument, nullptr, 's'},
+            {"output",       required_argument, nullptr, 'o'},
+            {"help",         no_argument,       nullptr, 'h'},
+            {nullptr, 0, nullptr, 0}
+            // clang-format on
+        };
+
+        int opt;
+        optind = 1;
+        while ((opt = getopt_long(argc, argv, "Sr:n:d:b:s:o:h", long_opts, nullptr)) != -1)
+        {
+            switch (opt)
+            {
+            case 'S':
+                service = true;
+                break;
+            case 'r':
+                benchmarks.push_back(std::string(optarg));
+                break;
+            case 'n':
+                iterations = std::max(1l, ::atol(optarg));
+                break;
+            case 'd':
+                dict_entries = ::atol(optarg);
+                break;
+            case 'b':
+                bytes = ::atol(optarg);
+                break;
+            case 's':
+                subscribers = std::max(1l, ::atol(optarg));
+                break;
+            case 'o':
+                output = std::string(optarg);
+                break;
+            case 'h':
+                help(argv[0], long_opts);
+                exit(0);
+            }
+        }
+
+        if (benchmarks.empty())
+        {
+            benchmarks = all_benchmarks;
+        }
+        for (const auto &b : benchmarks)
+        {
+            if (all_benchmarks.end() == std::find(all_benchmarks.begin(), all_benchmarks.end(), b))
+            {
+                std::cerr << argv[0] << ":"
+                          << " ** ERROR ** Unknown benchmark '" << b << "'"
+                          << std::endl;
+                exit(1);
+            }
+        }
+    }
+
+    bool service = false;
+    std::vector<std::string> benchmarks{};
+    size_t iterations = 10000;
+    size_t dict_entries = 1000;
+    size_t bytes = 256 * 1024;
+    size_t subscribers = 4;
+    std::string output{};
+};
+
+
+
+/**
+ *  The signal sent by the benchmark service.  The timestamp is the
+ *  g_get_monotonic_time() value when the signal was sent, which is
+ *  comparable between processes on the same host.
+ */
+class BenchmarkSignals : public DBus::Signals::Group
+{
+  public:
+    using Ptr = std::shared_ptr<BenchmarkSignals>;
+
+    BenchmarkSignals(DBus::Connection::Ptr conn)
+        : DBus::Signals::Group(conn,
+                               Constants::GenPath("benchmark"),
+                               Constants::GenInterface("benchmark"))
+    {
+        RegisterSignal("Tick", {{"sequence", "t"}, {"timestamp", "x"}});
+    }
+
+    void Tick(const uint64_t seq)
+    {
+        SendGVariant("Tick", g_variant_new("(tx)", seq, g_get_monotonic_time()));
+    }
+};
+
+
+/**
+ *  The object being benchmarked.  All the methods do as little as
+ *  possible, to measure the overhead of GDBus++ and the D-Bus daemon.
+ *
+ *  Path:      /gdbuspp/tests/benchmark
+ *  Interface: gdbuspp.test.benchmark
+ */
+class BenchmarkObject : public DBus::Object::Base
+{
+  public:
+    BenchmarkObject(DBus::Connection::Ptr conn)
+        : DBus::Object::Base(Constants::GenPath("benchmark"),
+                             Constants::GenInterface("benchmark"))
+    {
+        signals = DBus::Signals::Group::Create<BenchmarkSignals>(conn);
+        RegisterSignals(signals);
+        signals->AddTarget("");
+
+        AddProperty("value", value, true);
+
+        AddMethod("Empty",
+                  [](DBus::Object::Method::Arguments::Ptr args)
+                  {
+                      args->SetMethodReturn(nullptr);
+                  });
+
+        auto dict_args = AddMethod("DictPayload",
+                                   [](DBus::Object::Method::Arguments::Ptr args)
+                                   {
+                                       GVariant *dict = g_variant_get_child_value(args->GetMethodParameters(), 0);
+                                       const gsize count = g_variant_n_children(dict);
+                                       g_variant_unref(dict);
+                                       args->SetMethodReturn(g_variant_new("(u)", count));
+                                   });
+        dict_args->AddInput("payload", "a{sv}");
+        dict_args->AddOutput("entries", "u");
+
+        auto bytes_args = AddMethod("BytesPayload",
+                                    [](DBus::Object::Method::Arguments::Ptr args)
+                                    {
+                                        GVariant *bytes = g_variant_get_child_value(args->GetMethodParameters(), 0);
+                                        const gsize size = g_variant_get_size(bytes);
+                                        g_variant_unref(bytes);
+                                        args->SetMethodReturn(g_variant_new("(u)", size));
+                                    });
+        bytes_args->AddInput("payload", "ay");
+        bytes_args->AddOutput("size", "u");
+
+        auto emit_args = AddMethod("EmitSignals",
+                                   [this](DBus::Object::Method::Arguments::Ptr args)
+                                   {
+                                       uint32_t count = 0;
+                                       g_variant_get(args->GetMethodParameters(), "(u)", &count);
+                                       for (uint64_t i = 0; i < count; ++i)
+                                       {
+                                           this->signals->Tick(i);
+                                       }
+                                       args->SetMethodReturn(nullptr);
+                                   });
+        emit_args->AddInput("count", "u");
+
+        auto fd_args = AddMethod("PassFD",
+                                 [](DBus::Object::Method::Arguments::Ptr args)
+                                 {
+                                     const bool valid = (args->ReceiveFD() >= 0);
+                                     args->SetMethodReturn(g_variant_new("(b)", valid));
+                                 });
+        fd_args->AddOutput("valid", "b");
+        fd_args->PassFileDescriptor(DBus::Object::Method::PassFDmode::RECEIVE);
+    }
+
+
+    const bool Authorize(const DBus::Authz::Request::Ptr req) override
+    {
+        return true;
+    }
+
+
+  private:
+    BenchmarkSignals::Ptr signals = nullptr;
+    uint32_t value = 0;
+};
+
+
+class BenchmarkService : public DBus::Service
+{
+  public:
+    BenchmarkService(DBus::Connection::Ptr con)
+        : DBus::Service(con, Constants::GenServiceName("benchmark"))
+    {
+    }
+
+    void BusNameAcquired(const std::string &busname) override
+    {
+        std::cout << "Bus name acquired: " << busname << std::endl;
+    }
+
+    void BusNameLost(const std::string &busname) override
+    {
+        std::cout << "** WARNING ** Bus name lost: " << busname << std::endl;
+        Stop();
+    }
+};
+
+
+
+/**
+ *  The result of a single benchmark
+ */
+struct Result
+{
+    std::string name{};
+    size_t operations = 0;
+    double duration_sec = 0;
+    std::vector<int64_t> latencies{}; ///< Per operation, in microseconds
+
+    std::string JSON() const
+    {
+        std::vector<int64_t> sorted = latencies;
+        std::sort(sorted.begin(), sorted.end());
+        auto percentile = [&sorted](const size_t pct) -> int64_t
+        {
+            if (sorted.empty())
+            {
+                return 0;
+            }
+            return sorted[std::min(sorted.size() - 1, (sorted.size() * pct) / 100)];
+        };
+
+        std::ostringstream r;
+        r << "{\"name\": \"" << name << "\", "
+          << "\"operations\": " << operations << ", "
+          << "\"duration_sec\": " << duration_sec << ", "
+          << "\"ops_per_sec\": " << (duration_sec > 0 ? operations / duration_sec : 0) << ", "
+          << "\"latency_usec\": {"
+          << "\"min\": " << (sorted.empty() ? 0 : sorted.front()) << ", "
+          << "\"p50\": " << percentile(50) << ", "
+          << "\"p99\": " << percentile(99) << ", "
+          << "\"max\": " << (sorted.empty() ? 0 : sorted.back()) << "}}";
+        return r.str();
+    }
+};
+
+
+/**
+ *  Measure a synchronous operation, called a number of times in a row.
+ *  A tenth of the iterations are run first as a warm-up, not measured.
+ */
+template <typename FNC>
+Result measure(const std::string &name, const size_t iterations, FNC &&fnc)
+{
+    for (size_t i = 0; i < iterations / 10; ++i)
+    {
+        fnc();
+    }
+
+    Result res;
+    res.name = name;
+    res.operations = iterations;
+    res.latencies.reserve(iterations);
+    const int64_t start = g_get_monotonic_time();
+    for (size_t i = 0; i < iterations; ++i)
+    {
+        const int64_t call_start = g_get_monotonic_time();
+        fnc();
+        res.latencies.push_back(g_get_monotonic_time() - call_start);
+    }
+    res.duration_sec = (g_get_monotonic_time() - start) / 1000000.0;
+    return res;
+}
+
+
+/**
+ *  Measure the delivery of signals to several subscribers, each on its
+ *  own D-Bus connection.  The latency is measured from the service
+ *  sending the signal until a subscriber received it.
+ */
+Result measure_signals(DBus::Proxy::Client::Ptr prx,
+                       DBus::Proxy::TargetPreset::Ptr preset,
+                       const Options &opts)
+{
+    std::mutex mtx;
+    std::condition_variable done_cv;
+    size_t received = 0;
+    Result res;
+    res.name = "signals";
+    res.operations = opts.iterations * opts.subscribers;
+    res.latencies.reserve(res.operations);
+
+    auto mainloop = DBus::MainLoop::Create();
+    std::vector<DBus::Signals::SubscriptionManager::Ptr> subscribers;
+    auto target = DBus::Signals::Target::Create("",
+                                                Constants::GenPath("benchmark"),
+                                                Constants::GenInterface("benchmark"));
+    for (size_t i = 0; i < opts.subscribers; ++i)
+    {
+        auto conn = DBus::Connection::CreateExclusive(DBus::BusType::SESSION);
+        auto sigmgr = DBus::Signals::SubscriptionManager::Create(conn);
+        sigmgr->Subscribe(target,
+                          "Tick",
+                          [&](DBus::Signals::Event::Ptr &event)
+                          {
+                              uint64_t seq = 0;
+                              int64_t timestamp = 0;
+                              g_variant_get(event->params, "(tx)", &seq, &timestamp);
+                              const int64_t latency = g_get_monotonic_time() - timestamp;
+
+                              std::lock_guard<std::mutex> lg(mtx);
+                              res.latencies.push_back(latency);
+                              if (++received == res.operations)
+                              {
+                                  done_cv.notify_all();
+                              }
+                          });
+
+        // A round trip to the bus ensures the subscription is in place
+        // before the service starts sending signals
+        auto bus = DBus::Proxy::Client::Create(conn, "org.freedesktop.DBus");
+        g_variant_unref(bus->Call("/org/freedesktop/DBus", "org.freedesktop.DBus", "GetId"));
+        subscribers.push_back(sigmgr);
+    }
+    mainloop->Start();
+
+    const int64_t start = g_get_monotonic_time();
+    GVariant *r = prx->Call(preset,
+                            "EmitSignals",
+                            g_variant_new("(u)", static_cast<uint32_t>(opts.iterations)));
+    g_variant_unref(r);
+
+    std::unique_lock<std::mutex> lk(mtx);
+    const bool completed = done_cv.wait_for(lk,
+                                            std::chrono::seconds(60),
+                                            [&]()
+                                            {
+                                                return received == res.operations;
+                                            });
+    res.duration_sec = (g_get_monotonic_time() - start) / 1000000.0;
+    lk.unlock();
+
+    mainloop->Stop();
+    mainloop->Wait();
+    if (!completed)
+    {
+        throw TestUtils::Exception("signals",
+                                   "Only received " + std::to_string(received)
+                                       + " of " + std::to_string(res.operations) + " signals");
+    }
+    return res;
+}
+
+
+Result run_benchmark(const std::string &name,
+                     DBus::Proxy::Client::Ptr prx,
+                     DBus::Proxy::TargetPreset::Ptr preset,
+                     const Options &opts)
+{
+    if ("empty-method" == name)
+    {
+        return measure(name,
+                       opts.iterations,
+                       [&]()
+                       {
+                           g_variant_unref(prx->Call(preset, "Empty"));
+                       });
+    }
+    else if ("dict-payload" == name)
+    {
+        GVariantBuilder b;
+        g_variant_builder_init(&b, G_VARIANT_TYPE("a{sv}"));
+        for (size_t i = 0; i < opts.dict_entries; ++i)
+        {
+            const std::string key = "key_" + std::to_string(i);
+            g_variant_builder_add(&b,
+                                  "{sv}",
+                                  key.c_str(),
+                                  (i % 2
+                                       ? g_variant_new_string("A benchmark payload string value")
+                                       : g_variant_new_uint64(i)));
+        }
+        GVariant *params = g_variant_ref_sink(g_variant_new("(a{sv})", &b));
+        Result res = measure(name,
+                             opts.iterations,
+                             [&]()
+                             {
+                                 g_variant_unref(prx->Call(preset, "DictPayload", params));
+                             });
+        g_variant_unref(params);
+        return res;
+    }
+    else if ("bytes-payload" == name)
+    {
+        std::vector<guchar> data(opts.bytes, 0x5a);
+        GVariant *bytes = g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE,
+                                                    data.data(),
+                                                    data.size(),
+                                                    sizeof(guchar));
+        GVariant *params = g_variant_ref_sink(g_variant_new_tuple(&bytes, 1));
+        Result res = measure(name,
+                             opts.iterations,
+                             [&]()
+                             {
+                                 g_variant_unref(prx->Call(preset, "BytesPayload", params));
+                             });
+        g_variant_unref(params);
+        return res;
+    }
+    else if ("property-get" == name)
+    {
+        return measure(name,
+                       opts.iterations,
+                       [&]()
+                       {
+                           (void)prx->GetProperty<uint32_t>(preset, "value");
+                       });
+    }
+    else if ("property-set" == name)
+    {
+        uint32_t v = 0;
+        return measure(name,
+                       opts.iterations,
+                       [&]()
+                       {
+                           prx->SetProperty(preset, "value", ++v);
+                       });
+    }
+    else if ("signals" == name)
+    {
+        return measure_signals(prx, preset, opts);
+    }
+    else if ("fd-passing" == name)
+    {
+        return measure(name,
+                       opts.iterations,
+                       [&]()
+                       {
+                           int fd = open("/dev/null", O_RDONLY);
+                           GVariant *r = prx->SendFD(preset, "PassFD", nullptr, fd);
+                           g_variant_unref(r);
+                           close(fd);
+                       });
+    }
+    throw TestUtils::Exception("run_benchmark", "Unknown benchmark: " + name);
+}
+
+
+int run_client(const Options &opts)
+{
+    auto conn = DBus::Connection::Create(DBus::BusType::SESSION);
+    auto srvqry = DBus::Proxy::Utils::DBusServiceQuery::Create(conn);
+    const std::string service = Constants::GenServiceName("benchmark");
+    if (!srvqry->CheckServiceAvail(service))
+    {
+        std::cerr << "** ERROR ** The benchmark service (" << service << ") "
+                  << "is not available" << std::endl;
+        return 2;
+    }
+
+    auto prx = DBus::Proxy::Client::Create(conn, service);
+    auto preset = DBus::Proxy::TargetPreset::Create(Constants::GenPath("benchmark"),
+                                                    Constants::GenInterface("benchmark"));
+
+    std::ostringstream json;
+    json << "{\"iterations\": " << opts.iterations << ", "
+         << "\"dict_entries\": " << opts.dict_entries << ", "
+         << "\"bytes\": " << opts.bytes << ", "
+         << "\"subscribers\": " << opts.subscribers << ", "
+         << "\"results\": [";
+    bool first = true;
+    for (const auto &name : opts.benchmarks)
+    {
+        std::cerr << "Running benchmark: " << name << std::endl;
+        json << (first ? "" : ", ") << std::endl
+             << "  " << run_benchmark(name, prx, preset, opts).JSON();
+        first = false;
+    }
+    json << std::endl
+         << "]}" << std::endl;
+
+    std::cout << json.str();
+    if (!opts.output.empty())
+    {
+        std::ofstream out(opts.output);
+        out << json.str();
+        if (!out.good())
+        {
+            std::cerr << "** ERROR ** Could not write " << opts.output << std::endl;
+            return 2;
+        }
+    }
+    return 0;
+}
+
+
+int main(int argc, char **argv)
+{
+    Options opts(argc, argv);
+    try
+    {
+        if (!opts.service)
+        {
+            return run_client(opts);
+        }
+
+        auto dbuscon = DBus::Connection::Create(DBus::BusType::SESSION);
+        auto service = DBus::Service::Create<BenchmarkService>(dbuscon);
+        service->CreateServiceHandler<BenchmarkObject>(dbuscon);
+        service->Run();
+        return 0;
+    }
+    catch (const DBus::Exception &excp)
+    {
+        std::cerr << "** EXCEPTION **  " << excp.what() << std::endl;
+        return 2;
+    }
+    catch (const TestUtils::Exception &excp)
+    {
+        std::cerr << "** EXCEPTION **  " << excp.what() << std::endl;
+        return 2;
+    }
+}
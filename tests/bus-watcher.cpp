@@ -15,6 +15,7 @@
 
 #include <future>
 #include <iostream>
+#include <string>
 
 #include "../gdbuspp/bus-watcher.hpp"
 #include "../gdbuspp/mainloop.hpp"
@@ -30,6 +31,43 @@ int main(int argc, char **argv)
         auto loop = DBus::MainLoop::Create();
 
         const char busname[] = "net.openvpn.gdbuspp.test.simple";
+
+        if (argc > 1 && std::string(argv[1]) == "--name-set")
+        {
+            // Same test, using the watcher tracking a set of bus names
+            auto conn = DBus::Connection::Create(DBus::BusType::SESSION);
+            auto names = DBus::BusWatcher::NameSet::Create(conn, {busname});
+            names->SetNameDisappearedHandler(
+                busname,
+                [&](const std::string &bus_name)
+                {
+                    std::cout << "Bus name disappeared: " << bus_name << std::endl;
+                    loop->Stop();
+                });
+
+            auto async_mainloop = std::async(std::launch::async,
+                                             [&]
+                                             {
+                                                 loop->Run();
+                                             });
+
+            std::cout << "Waiting for bus name " << busname
+                      << " to appear (name set) ..." << std::endl;
+            if (!names->WaitForAll(10s))
+            {
+                loop->Stop();
+                async_mainloop.get();
+
+                std::cerr << "Timeout waiting for " << busname << " to appear!"
+                          << std::endl;
+                return 1;
+            }
+            std::cout << busname << " appeared, owner: "
+                      << names->GetOwner(busname) << std::endl;
+            async_mainloop.get();
+            return 0;
+        }
+
         DBus::BusWatcher watcher(DBus::BusType::SESSION, busname);
 
         watcher.SetNameDisappearedHandler(
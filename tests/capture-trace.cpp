@@ -0,0 +1,161 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file   capture-trace.cpp
+ *
+ * @brief  Tests writing and reading a DBus::Features::Capture file.
+ *         The records are stored directly; this does not use any
+ *         D-Bus connection.
+ */
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <glib.h>
+
+#include "../gdbuspp/features/capture.hpp"
+#include "test-utils.hpp"
+
+using TestUtils::run_test;
+using TestUtils::TestResult;
+
+using namespace DBus::Features;
+
+
+static std::string capture_file()
+{
+    return g_get_tmp_dir() + std::string("/gdbuspp-capture-test.")
+           + std::to_string(getpid());
+}
+
+
+static bool test_roundtrip()
+{
+    const std::string fname = capture_file();
+    Capture::Start(fname);
+    if (!Capture::Enabled())
+    {
+        return false;
+    }
+    for (int i = 0; i < 3; ++i)
+    {
+        glib2::Variant args(g_variant_new("(si)", "value", i));
+        Capture::Store(":1.42", "/net/example/obj", "net.example.intf", "Method", args.get());
+    }
+    glib2::Variant get(g_variant_new("(ss)", "net.example.intf", "prop"));
+    Capture::Store("", "/net/example/obj", "org.freedesktop.DBus.Properties", "Get", get.get());
+    Capture::Store(":1.43", "/net/example/other", "net.example.intf", "NoArgs", nullptr);
+    Capture::Stop();
+    if (Capture::Enabled())
+    {
+        return false;
+    }
+
+    bool ok = true;
+    Capture::Reader reader(fname);
+    Capture::Entry entry;
+    int64_t last = 0;
+    for (int i = 0; i < 3; ++i)
+    {
+        ok &= reader.Next(entry);
+        ok &= (":1.42" == entry.sender && "/net/example/obj" == entry.path
+               && "net.example.intf" == entry.interface && "Method" == entry.member);
+        ok &= ("(si)" == entry.params.GetTypeString());
+        ok &= ("('value', " + std::to_string(i) + ")" == entry.params.Print());
+        ok &= (entry.timestamp >= last);
+        last = entry.timestamp;
+    }
+    ok &= reader.Next(entry);
+    ok &= ("" == entry.sender && "Get" == entry.member
+           && "('net.example.intf', 'prop')" == entry.params.Print());
+    ok &= reader.Next(entry);
+    ok &= (":1.43" == entry.sender && "/net/example/other" == entry.path
+           && "NoArgs" == entry.member && !entry.params);
+    ok &= !reader.Next(entry);
+
+    unlink(fname.c_str());
+    return ok;
+}
+
+
+static bool test_truncated()
+{
+    const std::string fname = capture_file();
+    Capture::Start(fname);
+    glib2::Variant args(g_variant_new("(s)", "some longer string value"));
+    Capture::Store(":1.42", "/net/example/obj", "net.example.intf", "Method", args.get());
+    Capture::Stop();
+    if (0 != truncate(fname.c_str(), 40))
+    {
+        unlink(fname.c_str());
+        return false;
+    }
+
+    TestResult res = TestUtils::expect_exception<Capture::Exception>(
+        "Truncated record is rejected",
+        [fname]()
+        {
+            Capture::Reader reader(fname);
+            Capture::Entry entry;
+            reader.Next(entry);
+        },
+        "Truncated record");
+    const bool ok = res.result;
+    unlink(fname.c_str());
+    return ok;
+}
+
+
+int main()
+{
+    int failures = 0;
+
+    failures += run_test([]()
+                         {
+                             return TestResult("Records are read back", test_roundtrip());
+                         });
+    failures += run_test([]()
+                         {
+                             return TestResult("Truncated record is rejected", test_truncated());
+                         });
+
+    failures += run_test([]()
+                         {
+                             return TestUtils::expect_exception<Capture::Exception>(
+                                 "Non-capture file is rejected",
+                                 []()
+                                 {
+                                     Capture::Reader reader("/dev/null");
+                                 },
+                                 "is not a capture file");
+                         });
+
+    failures += run_test([]()
+                         {
+                             // An existing file must not be overwritten
+                             const std::string fname = capture_file();
+                             FILE *f = std::fopen(fname.c_str(), "w");
+                             if (f)
+                             {
+                                 std::fclose(f);
+                             }
+                             TestResult res = TestUtils::expect_exception<Capture::Exception>(
+                                 "Existing file is not overwritten",
+                                 [fname]()
+                                 {
+                                     Capture::Start(fname);
+                                 },
+                                 "Could not create");
+                             unlink(fname.c_str());
+                             return TestResult(res.message, res.result && !Capture::Enabled());
+                         });
+
+    return TestUtils::test_summary(failures);
+}
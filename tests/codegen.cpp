@@ -0,0 +1,190 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file   codegen.cpp
+ *
+ * @brief  Tests the code generated by gdbuspp-codegen from
+ *         tests/codegen-test.xml.  This checks the generated marshalling
+ *         helpers and the object skeleton declarations; it does not use
+ *         any D-Bus connection.
+ */
+
+#include <iostream>
+#include <string>
+#include <glib.h>
+
+#include "codegen-test.hpp"
+#include "test-utils.hpp"
+
+using namespace CodegenTest::_codegen_Codegen;
+using TestUtils::run_test;
+using TestUtils::TestResult;
+
+
+/**
+ *  Marshal a value, check the D-Bus data type and parse it back
+ */
+template <typename T>
+static bool roundtrip(const T &value,
+                      GVariant *(*marshal)(const T &),
+                      T (*unmarshal)(GVariant *),
+                      const std::string &dbustype)
+{
+    GVariant *v = g_variant_ref_sink(marshal(value));
+    const bool type_ok = (dbustype == g_variant_get_type_string(v));
+    const T parsed = unmarshal(v);
+    g_variant_unref(v);
+    return type_ok && parsed == value;
+}
+
+
+class CodegenObject : public CodegenTest::CodegenSkeleton
+{
+  public:
+    CodegenObject()
+        : CodegenTest::CodegenSkeleton("/net/openvpn/gdbuspp/test/codegen")
+    {
+    }
+
+    const bool Authorize(const DBus::Authz::Request::Ptr request) override
+    {
+        return true;
+    }
+
+  protected:
+    std::string Echo(const std::string &message) override
+    {
+        return message;
+    }
+
+    std::tuple<uint64_t, std::map<std::string, GVariant *>> Stats(const std::vector<uint32_t> &values,
+                                                                  bool enabled) override
+    {
+        return {0, {}};
+    }
+
+    std::vector<std::tuple<DBus::Object::Path, std::string, int32_t>> Sessions() override
+    {
+        return {};
+    }
+
+    void Ping() override
+    {
+    }
+
+    uint32_t GetCounter() override
+    {
+        return 0;
+    }
+
+    std::map<std::string, std::string> GetLabels() override
+    {
+        return labels;
+    }
+
+    void SetLabels(const std::map<std::string, std::string> &value) override
+    {
+        labels = value;
+    }
+
+  private:
+    std::map<std::string, std::string> labels;
+};
+
+
+int main()
+{
+    int failures = 0;
+
+    failures += run_test([]()
+                         {
+                             return TestResult("String",
+                                               roundtrip<std::string>("hello", marshal_s, unmarshal_s, "s"));
+                         });
+    failures += run_test([]()
+                         {
+                             return TestResult("Fixed size array",
+                                               roundtrip<std::vector<uint32_t>>({1, 2, 3, 0xffffffff},
+                                                                                marshal_au,
+                                                                                unmarshal_au,
+                                                                                "au"));
+                         });
+    failures += run_test([]()
+                         {
+                             return TestResult("Empty array",
+                                               roundtrip<std::vector<uint32_t>>({}, marshal_au, unmarshal_au, "au"));
+                         });
+    failures += run_test([]()
+                         {
+                             return TestResult("Dictionary",
+                                               roundtrip<std::map<std::string, std::string>>(
+                                                   {{"a", "1"}, {"b", "2"}},
+                                                   marshal_aessE, // a{ss}
+                                                   unmarshal_aessE,
+                                                   "a{ss}"));
+                         });
+    failures += run_test([]()
+                         {
+                             return TestResult("Array of structs",
+                                               roundtrip<std::vector<std::tuple<DBus::Object::Path, std::string, int32_t>>>(
+                                                   {{"/net/openvpn/a", "first", -1}, {"/net/openvpn/b", "second", 2}},
+                                                   marshal_arosiR, // a(osi)
+                                                   unmarshal_arosiR,
+                                                   "a(osi)"));
+                         });
+
+    failures += run_test([]()
+                         {
+                             GVariant *dict = g_variant_ref_sink(marshal_aesvE({{"key", g_variant_new_uint32(42)}}));
+                             auto parsed = unmarshal_aesvE(dict);
+                             g_variant_unref(dict);
+                             const bool ok = (parsed.size() == 1
+                                              && g_variant_get_uint32(parsed["key"]) == 42);
+                             for (auto &e : parsed)
+                             {
+                                 g_variant_unref(e.second);
+                             }
+                             return TestResult("Dictionary of variants", ok);
+                         });
+
+    failures += run_test([]()
+                         {
+                             return TestUtils::expect_exception<DBus::Proxy::Exception>(
+                                 "Reply of an unexpected data type is rejected",
+                                 []()
+                                 {
+                                     auto preset = DBus::Proxy::TargetPreset::Create("/net/openvpn/gdbuspp/test/codegen",
+                                                                                     "net.openvpn.gdbuspp.test.codegen");
+                                     check_reply(g_variant_ref_sink(g_variant_new("(u)", 1)),
+                                                 "(s)",
+                                                 "net.openvpn.gdbuspp.test",
+                                                 preset,
+                                                 "Echo");
+                                 },
+                                 "Unexpected reply data type '(u)', expected '(s)'");
+                         });
+
+    auto obj = DBus::Object::Base::Create<CodegenObject>();
+    failures += run_test([obj]()
+                         {
+                             const std::string introsp = obj->GenerateIntrospection();
+                             return TestResult("Skeleton declares methods",
+                                               introsp.find("\"Echo\"") != std::string::npos
+                                                   && introsp.find("\"Stats\"") != std::string::npos
+                                                   && introsp.find("\"Ping\"") != std::string::npos
+                                                   && introsp.find("\"message\"") != std::string::npos);
+                         });
+    failures += run_test([obj]()
+                         {
+                             return TestResult("Skeleton declares properties",
+                                               obj->PropertyExists("counter") && obj->PropertyExists("labels"));
+                         });
+
+    return TestUtils::test_summary(failures);
+}
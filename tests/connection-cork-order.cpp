@@ -0,0 +1,247 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file   connection-cork-order.cpp
+ *
+ * @brief  Tests that DBus::Connection::Cork keeps the order of signals
+ *         and error replies sent within the same scope.  The messages
+ *         arriving at the client are recorded via a glib2 message filter,
+ *         which sees them in the order they were received.  The service
+ *         runs in a separate thread of this test.  This needs a session
+ *         bus.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glib.h>
+
+#include "../gdbuspp/authz-request.hpp"
+#include "../gdbuspp/connection.hpp"
+#include "../gdbuspp/object/base.hpp"
+#include "../gdbuspp/proxy.hpp"
+#include "../gdbuspp/service.hpp"
+#include "../gdbuspp/signals/emit.hpp"
+#include "test-constants.hpp"
+#include "test-utils.hpp"
+
+using namespace DBus;
+using namespace Test;
+using TestUtils::run_test;
+using TestUtils::TestResult;
+
+
+/**
+ *  Object keeping the reply of its method call for the test to send
+ */
+class CorkObject : public Object::Base
+{
+  public:
+    using Ptr = std::shared_ptr<CorkObject>;
+
+    CorkObject()
+        : Object::Base(Constants::GenPath("corkorder"),
+                       Constants::GenInterface("corkorder"))
+    {
+        DisableIdleDetector(true);
+        AddMethod("Park",
+                  [this](Object::Method::Arguments::Ptr args)
+                  {
+                      std::lock_guard<std::mutex> lg(mtx);
+                      parked = args->Defer();
+                      parked_cv.notify_all();
+                  });
+    }
+
+    const bool Authorize(const Authz::Request::Ptr request) override
+    {
+        return true;
+    }
+
+    /**
+     *  Wait for the method call and take over its reply
+     *
+     * @return Object::Method::DeferredReply::Ptr, nullptr if the call
+     *         did not arrive within 5 seconds
+     */
+    Object::Method::DeferredReply::Ptr TakeParked()
+    {
+        std::unique_lock<std::mutex> lk(mtx);
+        parked_cv.wait_for(lk,
+                           std::chrono::seconds(5),
+                           [this]()
+                           {
+                               return nullptr != parked;
+                           });
+        auto ret = parked;
+        parked = nullptr;
+        return ret;
+    }
+
+  private:
+    std::mutex mtx{};
+    std::condition_variable parked_cv{};
+    Object::Method::DeferredReply::Ptr parked = nullptr;
+};
+
+
+class CorkService : public Service
+{
+  public:
+    CorkService(Connection::Ptr conn)
+        : Service(conn, Constants::GenServiceName("corkorder"))
+    {
+    }
+
+    void BusNameAcquired(const std::string &busname) override
+    {
+        acquired = true;
+    }
+
+    void BusNameLost(const std::string &busname) override
+    {
+        Stop();
+    }
+
+    std::atomic<bool> acquired{false};
+};
+
+
+/**
+ *  Records the signals and error replies arriving from the service
+ */
+struct Received
+{
+    std::string service{};
+    std::mutex mtx{};
+    std::vector<std::string> messages{};
+
+    size_t Count()
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        return messages.size();
+    }
+};
+
+
+static GDBusMessage *record_message(GDBusConnection *conn,
+                                    GDBusMessage *msg,
+                                    gboolean incoming,
+                                    gpointer user_data)
+{
+    auto received = static_cast<Received *>(user_data);
+    if (!incoming || received->service != g_dbus_message_get_sender(msg))
+    {
+        return msg;
+    }
+
+    std::lock_guard<std::mutex> lg(received->mtx);
+    switch (g_dbus_message_get_message_type(msg))
+    {
+    case G_DBUS_MESSAGE_TYPE_SIGNAL:
+        received->messages.push_back(g_dbus_message_get_member(msg));
+        break;
+    case G_DBUS_MESSAGE_TYPE_ERROR:
+        received->messages.push_back("error");
+        break;
+    case G_DBUS_MESSAGE_TYPE_METHOD_RETURN:
+        received->messages.push_back("reply");
+        break;
+    default:
+        break;
+    }
+    return msg;
+}
+
+
+int main()
+{
+    int failures = 0;
+    try
+    {
+        auto srvconn = Connection::Create(BusType::SESSION);
+        auto service = Service::Create<CorkService>(srvconn);
+        auto obj = service->CreateServiceHandler<CorkObject>();
+
+        std::thread srvthread([service]()
+                              {
+                                  service->Run();
+                              });
+        for (int i = 0; i < 500 && !service->acquired; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        auto conn = Connection::CreateExclusive(BusType::SESSION);
+        Received received;
+        received.service = srvconn->GetUniqueBusName();
+        guint filter = g_dbus_connection_add_filter(conn->ConnPtr(), record_message, &received, nullptr);
+        auto prx = Proxy::Client::Create(conn, Constants::GenServiceName("corkorder"));
+
+        auto emit = Signals::Emit::Create(srvconn);
+        emit->AddTarget(conn->GetUniqueBusName(), obj->GetPath(), obj->GetInterface());
+
+        failures += run_test([srvconn, prx, obj, emit, &received]()
+                             {
+                                 auto result = prx->CallAsync(obj->GetPath(), obj->GetInterface(), "Park");
+                                 auto reply = obj->TakeParked();
+                                 if (!reply)
+                                 {
+                                     return TestResult("Error reply keeps its order with held back signals",
+                                                       false);
+                                 }
+
+                                 const guint32 start = g_dbus_connection_get_last_serial(srvconn->ConnPtr());
+                                 guint32 held = 0;
+                                 {
+                                     Connection::Cork cork(srvconn);
+                                     emit->SendGVariant("First", g_variant_new("(u)", 1));
+                                     reply->ReturnError("Failed by the test");
+                                     emit->SendGVariant("Last", g_variant_new("(u)", 2));
+                                     held = g_dbus_connection_get_last_serial(srvconn->ConnPtr());
+                                 }
+
+                                 bool failed = false;
+                                 try
+                                 {
+                                     g_variant_unref(result.get());
+                                 }
+                                 catch (const DBus::Exception &excp)
+                                 {
+                                     failed = std::string(excp.what()).find("Failed by the test") != std::string::npos;
+                                 }
+                                 for (int i = 0; i < 500 && received.Count() < 3; ++i)
+                                 {
+                                     std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                                 }
+
+                                 std::lock_guard<std::mutex> lg(received.mtx);
+                                 const std::vector<std::string> expect{"First", "error", "Last"};
+                                 return TestResult("Error reply keeps its order with held back signals",
+                                                   failed && start == held && expect == received.messages);
+                             });
+
+        g_dbus_connection_remove_filter(conn->ConnPtr(), filter);
+        service->Stop();
+        srvthread.join();
+    }
+    catch (const DBus::Exception &excp)
+    {
+        std::cerr << "** EXCEPTION **  " << excp.what() << std::endl;
+        return 3;
+    }
+
+    return TestUtils::test_summary(failures);
+}
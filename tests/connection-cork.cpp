@@ -0,0 +1,123 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file   connection-cork.cpp
+ *
+ * @brief  Tests holding back outgoing signals via DBus::Connection::Cork.
+ *         The messages sent are tracked via the serial glib2 assigned to
+ *         the last message sent by this thread, which is only assigned
+ *         once a held back message is really sent.  This needs a session
+ *         bus.
+ */
+
+#include <iostream>
+#include <string>
+#include <glib.h>
+
+#include "../gdbuspp/connection.hpp"
+#include "../gdbuspp/signals/emit.hpp"
+#include "test-utils.hpp"
+
+using namespace DBus;
+using TestUtils::run_test;
+using TestUtils::TestResult;
+
+
+/**
+ *  Send a number of signals to ourselves
+ *
+ * @param emit   Signals::Emit object to send with
+ * @param count  Number of signals to send
+ * @return true if all signals were sent or held back
+ */
+static bool send_signals(Signals::Emit::Ptr emit, const unsigned int count)
+{
+    bool ret = true;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        ret &= emit->SendGVariant("Counter", g_variant_new("(u)", i));
+    }
+    return ret;
+}
+
+
+int main()
+{
+    int failures = 0;
+    try
+    {
+        auto conn = Connection::Create(BusType::SESSION);
+        auto emit = Signals::Emit::Create(conn);
+        emit->AddTarget(conn->GetUniqueBusName(),
+                        "/net/openvpn/gdbuspp/test/cork",
+                        "net.openvpn.gdbuspp.test.cork");
+
+        failures += run_test([conn, emit]()
+                             {
+                                 const guint32 start = g_dbus_connection_get_last_serial(conn->ConnPtr());
+                                 bool sent = false;
+                                 guint32 held = 0;
+                                 {
+                                     Connection::Cork cork(conn);
+                                     sent = send_signals(emit, 10);
+                                     held = g_dbus_connection_get_last_serial(conn->ConnPtr());
+                                 }
+                                 const guint32 released = g_dbus_connection_get_last_serial(conn->ConnPtr());
+                                 return TestResult("Signals are held back until the scope ends",
+                                                   sent && start == held && start + 10 == released);
+                             });
+
+        failures += run_test([conn, emit]()
+                             {
+                                 const guint32 start = g_dbus_connection_get_last_serial(conn->ConnPtr());
+                                 guint32 inner_end = 0;
+                                 {
+                                     Connection::Cork outer(conn);
+                                     send_signals(emit, 2);
+                                     {
+                                         Connection::Cork inner(conn);
+                                         send_signals(emit, 3);
+                                     }
+                                     inner_end = g_dbus_connection_get_last_serial(conn->ConnPtr());
+                                 }
+                                 const guint32 released = g_dbus_connection_get_last_serial(conn->ConnPtr());
+                                 return TestResult("Nested scopes are released by the outermost scope",
+                                                   start == inner_end && start + 5 == released);
+                             });
+
+        failures += run_test([conn, emit]()
+                             {
+                                 auto other = Connection::CreateExclusive(BusType::SESSION);
+                                 const guint32 start = g_dbus_connection_get_last_serial(conn->ConnPtr());
+                                 guint32 sent = 0;
+                                 {
+                                     Connection::Cork cork(other);
+                                     send_signals(emit, 4);
+                                     sent = g_dbus_connection_get_last_serial(conn->ConnPtr());
+                                 }
+                                 return TestResult("Scope of another connection does not hold back",
+                                                   start + 4 == sent);
+                             });
+
+        failures += run_test([conn, emit]()
+                             {
+                                 const guint32 start = g_dbus_connection_get_last_serial(conn->ConnPtr());
+                                 send_signals(emit, 3);
+                                 return TestResult("Signals are sent without a scope",
+                                                   start + 3 == g_dbus_connection_get_last_serial(conn->ConnPtr()));
+                             });
+    }
+    catch (const DBus::Exception &excp)
+    {
+        std::cerr << "** EXCEPTION **  " << excp.what() << std::endl;
+        return 3;
+    }
+
+    return TestUtils::test_summary(failures);
+}
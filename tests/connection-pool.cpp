@@ -0,0 +1,130 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file   connection-pool.cpp
+ *
+ * @brief  Tests DBus::Connection::Pool and DBus::Proxy::PooledClient.
+ *         The pooled clients call the D-Bus daemon itself from several
+ *         threads.  This needs a session bus.
+ */
+
+#include <atomic>
+#include <iostream>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glib.h>
+
+#include "../gdbuspp/connection.hpp"
+#include "../gdbuspp/proxy.hpp"
+#include "test-utils.hpp"
+
+using namespace DBus;
+using TestUtils::run_test;
+using TestUtils::TestResult;
+
+
+int main()
+{
+    int failures = 0;
+    try
+    {
+        auto pool = Connection::Pool::Create(BusType::SESSION, 3);
+
+        failures += run_test([pool]()
+                             {
+                                 auto shared = Connection::Create(BusType::SESSION);
+                                 std::set<std::string> names;
+                                 for (size_t i = 0; i < pool->Size(); ++i)
+                                 {
+                                     names.insert(pool->Get(i)->GetUniqueBusName());
+                                 }
+                                 return TestResult("Pooled connections are exclusive",
+                                                   3 == pool->Size() && 3 == names.size()
+                                                       && 0 == names.count(shared->GetUniqueBusName()));
+                             });
+
+        failures += run_test([pool]()
+                             {
+                                 const size_t shard = pool->Shard();
+                                 bool stable = true;
+                                 for (int i = 0; i < 10; ++i)
+                                 {
+                                     stable &= (shard == pool->Shard()
+                                                && pool->Get(shard) == pool->Get());
+                                 }
+                                 return TestResult("A thread keeps using the same connection",
+                                                   shard < pool->Size() && stable);
+                             });
+
+        failures += run_test([pool]()
+                             {
+                                 return TestUtils::expect_exception<Connection::Exception>(
+                                     "Index out of range is rejected",
+                                     [pool]()
+                                     {
+                                         (void)pool->Get(pool->Size());
+                                     },
+                                     "out of range");
+                             });
+
+        failures += run_test([]()
+                             {
+                                 return TestUtils::expect_exception<Connection::Exception>(
+                                     "Empty pool is rejected",
+                                     []()
+                                     {
+                                         auto p = Connection::Pool::Create(BusType::SESSION, 0);
+                                     },
+                                     "Invalid connection pool size: 0");
+                             });
+
+        failures += run_test([pool]()
+                             {
+                                 auto client = Proxy::PooledClient::Create(pool, "org.freedesktop.DBus");
+                                 std::atomic<unsigned int> ok{0};
+                                 std::vector<std::thread> threads;
+                                 for (int t = 0; t < 6; ++t)
+                                 {
+                                     threads.emplace_back(
+                                         [pool, client, &ok]()
+                                         {
+                                             // Each thread uses the client of its own connection
+                                             auto prx = client->Get();
+                                             if (prx->GetConnection() != pool->Get())
+                                             {
+                                                 return;
+                                             }
+                                             for (int i = 0; i < 20; ++i)
+                                             {
+                                                 GVariant *r = prx->Call("/org/freedesktop/DBus",
+                                                                         "org.freedesktop.DBus",
+                                                                         "GetId");
+                                                 g_variant_unref(r);
+                                             }
+                                             ++ok;
+                                         });
+                                 }
+                                 for (auto &t : threads)
+                                 {
+                                     t.join();
+                                 }
+                                 return TestResult("PooledClient calls from several threads",
+                                                   6 == ok);
+                             });
+    }
+    catch (const DBus::Exception &excp)
+    {
+        std::cerr << "** EXCEPTION **  " << excp.what() << std::endl;
+        return 3;
+    }
+
+    return TestUtils::test_summary(failures);
+}
@@ -0,0 +1,181 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file   connection-setup.cpp
+ *
+ * @brief  Tests the deferred connection setup via
+ *         DBus::Connection::CreateLazy() and CreateAsync(), and closing
+ *         a connection in the background via Disconnect(false).  The
+ *         first tests use an invalid session bus address, to see if a
+ *         connection attempt is made.  This needs a session bus.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <glib.h>
+
+#include "../gdbuspp/connection.hpp"
+#include "../gdbuspp/mainloop.hpp"
+#include "../gdbuspp/signals/emit.hpp"
+#include "../gdbuspp/signals/subscriptionmgr.hpp"
+#include "../gdbuspp/signals/target.hpp"
+#include "test-utils.hpp"
+
+using namespace DBus;
+using TestUtils::run_test;
+using TestUtils::TestResult;
+
+static const Object::Path path = "/net/openvpn/gdbuspp/test/connsetup";
+static const std::string interface = "net.openvpn.gdbuspp.test.connsetup";
+
+
+int main()
+{
+    int failures = 0;
+    try
+    {
+        // No connection to the session bus must exist in this process
+        // yet, otherwise glib2 reuses it regardless of the address
+        const char *env = getenv("DBUS_SESSION_BUS_ADDRESS");
+        const std::string session_address = (env ? env : "");
+        setenv("DBUS_SESSION_BUS_ADDRESS", "unix:path=/nonexistent/gdbuspp-test", 1);
+
+        failures += run_test([]()
+                             {
+                                 auto conn = Connection::CreateLazy(BusType::SESSION);
+                                 conn->Disconnect();
+                                 bool connected = false;
+                                 try
+                                 {
+                                     conn->WaitReady();
+                                 }
+                                 catch (const Connection::Exception &)
+                                 {
+                                     connected = true;
+                                 }
+                                 return TestResult("Unused lazy connection is not established",
+                                                   !connected);
+                             });
+
+        failures += run_test([]()
+                             {
+                                 auto conn = Connection::CreateLazy(BusType::SESSION);
+                                 return TestUtils::expect_exception<Connection::Exception>(
+                                     "Lazy connection failure is reported on first use",
+                                     [conn]()
+                                     {
+                                         conn->WaitReady();
+                                     },
+                                     "Could not connect to the D-Bus");
+                             });
+
+        failures += run_test([]()
+                             {
+                                 // Shared with the detached connecting thread
+                                 auto failed = std::make_shared<std::promise<bool>>();
+                                 auto conn = Connection::CreateAsync(BusType::SESSION,
+                                                                     [failed](std::exception_ptr error)
+                                                                     {
+                                                                         failed->set_value(nullptr != error);
+                                                                     });
+                                 const bool reported = failed->get_future().get();
+                                 return TestResult("Asynchronous connection failure is passed to the callback",
+                                                   reported && !conn->Check());
+                             });
+
+        if (session_address.empty())
+        {
+            unsetenv("DBUS_SESSION_BUS_ADDRESS");
+        }
+        else
+        {
+            setenv("DBUS_SESSION_BUS_ADDRESS", session_address.c_str(), 1);
+        }
+
+        failures += run_test([]()
+                             {
+                                 auto conn = Connection::CreateLazy(BusType::SESSION);
+                                 const bool connected = conn->Check();
+                                 return TestResult("Lazy connection is established on first use",
+                                                   connected && !conn->GetUniqueBusName().empty());
+                             });
+
+        failures += run_test([]()
+                             {
+                                 // Shared with the detached connecting thread
+                                 auto failed = std::make_shared<std::promise<bool>>();
+                                 auto conn = Connection::CreateAsync(BusType::SESSION,
+                                                                     [failed](std::exception_ptr error)
+                                                                     {
+                                                                         failed->set_value(nullptr != error);
+                                                                     });
+                                 const bool reported = failed->get_future().get();
+                                 conn->WaitReady();
+                                 return TestResult("Asynchronous connection is established",
+                                                   !reported && conn->Check());
+                             });
+
+        failures += run_test([]()
+                             {
+                                 auto loop = MainLoop::Create();
+                                 std::thread loopthread([loop]()
+                                                        {
+                                                            loop->Run();
+                                                        });
+
+                                 auto sender = Connection::CreateExclusive(BusType::SESSION);
+                                 auto receiver = Connection::Create(BusType::SESSION);
+                                 std::atomic<unsigned int> received{0};
+                                 auto subscr = Signals::SubscriptionManager::Create(receiver);
+                                 auto target = Signals::Target::Create(sender->GetUniqueBusName(),
+                                                                       path,
+                                                                       interface);
+                                 subscr->Subscribe(target,
+                                                   "Tick",
+                                                   [&received](Signals::Event::Ptr &event)
+                                                   {
+                                                       ++received;
+                                                   });
+
+                                 // Keep the glib2 connection object, to see it being closed
+                                 GDBusConnection *raw = G_DBUS_CONNECTION(g_object_ref(sender->ConnPtr()));
+                                 auto emit = Signals::Emit::Create(sender);
+                                 emit->AddTarget(receiver->GetUniqueBusName(), path, interface);
+                                 emit->SendGVariant("Tick", g_variant_new("(u)", 1));
+                                 sender->Disconnect(false);
+                                 const bool released = !sender->Check();
+
+                                 for (int i = 0; i < 500 && (!g_dbus_connection_is_closed(raw) || 0 == received); ++i)
+                                 {
+                                     std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                                 }
+                                 const bool closed = g_dbus_connection_is_closed(raw);
+                                 g_object_unref(raw);
+
+                                 subscr->Unsubscribe(target, "Tick");
+                                 loop->Stop();
+                                 loopthread.join();
+                                 return TestResult("Disconnect(false) sends the pending messages and closes",
+                                                   released && closed && 1 == received);
+                             });
+    }
+    catch (const DBus::Exception &excp)
+    {
+        std::cerr << "** EXCEPTION **  " << excp.what() << std::endl;
+        return 3;
+    }
+
+    return TestUtils::test_summary(failures);
+}
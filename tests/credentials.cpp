@@ -154,6 +154,24 @@ int main(int argc, char **argv)
             std::cout << "Owning process ID (pid): " << result << std::endl;
             check_expectations(opts.expect_result, result);
         }
+
+        if (opts.get_ubusname && opts.get_uid && opts.get_pid)
+        {
+            // The combined lookup must be consistent with the
+            // individual lookups above
+            auto info = creds->GetCredentials(opts.destination);
+            std::cout << "Security label: "
+                      << (!info.security_label.empty() ? info.security_label : "(none)")
+                      << std::endl;
+            if (info.unique_name != creds->GetUniqueBusName(opts.destination)
+                || info.uid != creds->GetUID(opts.destination)
+                || info.pid != creds->GetPID(opts.destination))
+            {
+                std::cerr << "GetCredentials() result does not match the "
+                          << "individual lookups" << std::endl;
+                return 3;
+            }
+        }
     }
     catch (const DBus::Exception &excp)
     {
@@ -0,0 +1,133 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file   error-reply.cpp
+ *
+ * @brief  Tests the D-Bus error domain and message of failed method calls
+ *         are received unmodified by the DBus::Proxy::Client
+ *
+ *         This test requires the simple-service.cpp test service to be
+ *         running
+ */
+
+#include <iostream>
+#include <string>
+#include <glib.h>
+
+#include "../gdbuspp/connection.hpp"
+#include "../gdbuspp/proxy.hpp"
+#include "test-constants.hpp"
+#include "test-utils.hpp"
+
+using namespace DBus;
+using namespace Test;
+using TestUtils::run_test;
+using TestUtils::TestResult;
+
+
+/**
+ *  Call the CustomError method and check the error received
+ *
+ * @param prx       Proxy::Client::Ptr to the test service
+ * @param preset    Proxy::TargetPreset::Ptr to the method_failures object
+ * @param domain    std::string with the error domain the service uses
+ * @param message   std::string with the error message the service uses
+ * @param expect_domain  std::string with the error domain expected
+ *
+ * @return TestResult
+ */
+static TestResult check_error(Proxy::Client::Ptr prx,
+                              Proxy::TargetPreset::Ptr preset,
+                              const std::string &domain,
+                              const std::string &message,
+                              const std::string &expect_domain)
+{
+    const std::string descr = "Error domain '" + domain + "'";
+    try
+    {
+        GVariant *r = prx->Call(preset,
+                                "CustomError",
+                                g_variant_new("(ss)", domain.c_str(), message.c_str()));
+        g_variant_unref(r);
+        return TestResult(descr + " - no error received", false);
+    }
+    catch (const DBus::Exception &excp)
+    {
+        const std::string recv_domain(excp.DBusErrorDomain());
+        const std::string recv_msg(excp.GetRawError());
+        const bool res = (expect_domain == recv_domain
+                          && recv_msg.find(message) != std::string::npos);
+        if (!res)
+        {
+            std::cout << "    Received domain: '" << recv_domain << "'" << std::endl
+                      << "    Received error:  '" << recv_msg << "'" << std::endl;
+        }
+        return TestResult(descr, res);
+    }
+}
+
+
+int main()
+{
+    int failures = 0;
+    try
+    {
+        auto conn = Connection::Create(BusType::SESSION);
+        auto prx = Proxy::Client::Create(conn, Constants::GenServiceName("simple"));
+        auto preset = Proxy::TargetPreset::Create(Constants::GenPath("simple1/method_failures"),
+                                                  Constants::GenInterface("simple1"));
+
+        failures += run_test([prx, preset]()
+                             {
+                                 return check_error(prx,
+                                                    preset,
+                                                    "net.openvpn.gdbuspp.test.CustomError",
+                                                    "custom failure",
+                                                    "net.openvpn.gdbuspp.test.CustomError");
+                             });
+
+        // Repeated, using the cached error domain on the service side
+        failures += run_test([prx, preset]()
+                             {
+                                 return check_error(prx,
+                                                    preset,
+                                                    "net.openvpn.gdbuspp.test.CustomError",
+                                                    "second failure",
+                                                    "net.openvpn.gdbuspp.test.CustomError");
+                             });
+
+        // Not a valid D-Bus error name; sent via the GError fallback
+        failures += run_test([prx, preset]()
+                             {
+                                 return check_error(prx,
+                                                    preset,
+                                                    "not-a-dbus-name",
+                                                    "fallback failure",
+                                                    "not-a-dbus-name");
+                             });
+
+        // The client knowing the domain maps it to the same GQuark
+        DBus::Exception::ErrorDomainQuark("net.openvpn.gdbuspp.test.Registered");
+        failures += run_test([prx, preset]()
+                             {
+                                 return check_error(prx,
+                                                    preset,
+                                                    "net.openvpn.gdbuspp.test.Registered",
+                                                    "registered failure",
+                                                    "net.openvpn.gdbuspp.test.Registered");
+                             });
+    }
+    catch (const DBus::Exception &excp)
+    {
+        std::cerr << "** EXCEPTION **  " << excp.what() << std::endl;
+        return 3;
+    }
+
+    return TestUtils::test_summary(failures);
+}
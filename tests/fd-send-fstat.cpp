@@ -46,6 +46,7 @@ class Options : public TestUtils::OptionParser
             {"interface",     required_argument, nullptr, 'i'},
             {"method",        required_argument, nullptr, 'm'},
             {"file",          required_argument, nullptr, 'f'},
+            {"multi",         no_argument,       nullptr, 'M'},
             {"quiet",         no_argument,       nullptr, 'q'},
             {"help",          no_argument,       nullptr, 'h'},
             {nullptr, 0, nullptr, 0}
@@ -54,7 +55,7 @@ class Options : public TestUtils::OptionParser
 
         int opt;
         optind = 1;
-        while ((opt = getopt_long(argc, argv, "YEd:p:i:m:f:o:b:qh", long_opts, nullptr)) != -1)
+        while ((opt = getopt_long(argc, argv, "YEd:p:i:m:f:o:b:Mqh", long_opts, nullptr)) != -1)
         {
             switch (opt)
             {
@@ -79,6 +80,9 @@ class Options : public TestUtils::OptionParser
             case 'f':
                 file = std::string(optarg);
                 break;
+            case 'M':
+                multi = true;
+                break;
             case 'q':
                 quiet = true;
                 break;
@@ -97,6 +101,7 @@ class Options : public TestUtils::OptionParser
     std::string object_interface = Constants::GenInterface("simple1");
     std::string method = {"fstatFileFromFD"};
     std::string file = {};
+    bool multi = false;
     bool quiet = false;
     DBus::Proxy::TargetPreset::Ptr preset = nullptr;
 };
@@ -113,6 +118,36 @@ int main(int argc, char **argv)
         auto preset = DBus::Proxy::TargetPreset::Create(opts.object_path, opts.object_interface);
 
         int fd = open(opts.file.c_str(), O_RDONLY);
+        if (opts.multi)
+        {
+            // Send the same file twice and fstat() the file descriptors
+            // the service sends back; all of them must be returned
+            std::vector<int> recv_fds{};
+            GVariant *r = prx->CallWithFDs(preset, "EchoFDs", nullptr, {fd, fd}, recv_fds);
+            uint32_t count = glib2::Value::Extract<uint32_t>(r, 0);
+            g_variant_unref(r);
+            close(fd);
+
+            struct stat fileinfo = {};
+            bool failed = (2 != count || 2 != recv_fds.size());
+            for (int rfd : recv_fds)
+            {
+                failed |= (fstat(rfd, &fileinfo) < 0);
+                close(rfd);
+            }
+            if (failed)
+            {
+                std::cerr << "** ERROR **  Expected 2 file descriptors, "
+                          << "service received " << count << ", "
+                          << "got back " << recv_fds.size() << std::endl;
+                return 2;
+            }
+            std::cout << "export testresult_uid=" << std::to_string(fileinfo.st_uid) << std::endl;
+            std::cout << "export testresult_gid=" << std::to_string(fileinfo.st_gid) << std::endl;
+            std::cout << "export testresult_size=" << std::to_string(fileinfo.st_size) << std::endl;
+            return 0;
+        }
+
         GVariant *r = prx->SendFD(preset, opts.method, nullptr, fd);
 
         if (!opts.quiet)
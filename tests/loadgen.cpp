@@ -0,0 +1,539 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file   loadgen.cpp
+ *
+ * @brief  Concurrent D-Bus load generator.  Calls a D-Bus method of any
+ *         service over several connections, keeping a number of calls in
+ *         flight on each of them, and reports the throughput, latency
+ *         distribution and errors over time.
+ *
+ *         This is useful to find the saturation point of a service, for
+ *         example when tuning the AsyncProcess::Pool sizing.
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <getopt.h>
+#include <glib.h>
+
+#include "../gdbuspp/connection.hpp"
+#include "../gdbuspp/proxy.hpp"
+#include "test-utils.hpp"
+
+using namespace DBus;
+
+
+class LoadGenOpts : public TestUtils::CallTargetOptions
+{
+  public:
+    LoadGenOpts(const int argc, char **argv)
+    {
+        init_options({
+                         // clang-format off
+                         {"connections",   required_argument, nullptr, 'c'},
+                         {"in-flight",     required_argument, nullptr, 'k'},
+                         {"duration",      required_argument, nullptr, 'D'},
+                         {"interval",      required_argument, nullptr, 'I'},
+                         {"help", no_argument, nullptr, 'h'},
+                         // clang-format on
+                     },
+                     "c:k:D:I:h");
+
+        int opt;
+        optind = 1;
+        while ((opt = getopt_long(argc, argv, short_opts.c_str(), long_opts.data(), nullptr)) != -1)
+        {
+            if (parse_call_target(opt, optarg))
+            {
+                continue;
+            }
+            switch (opt)
+            {
+            case 'c':
+                connections = std::max(1, TestUtils::parse_int_option("--connections", optarg));
+                break;
+            case 'k':
+                in_flight = std::max(1, TestUtils::parse_int_option("--in-flight", optarg));
+                break;
+            case 'D':
+                duration = std::chrono::seconds(std::max(1, TestUtils::parse_int_option("--duration", optarg)));
+                break;
+            case 'I':
+                interval = std::chrono::seconds(std::max(1, TestUtils::parse_int_option("--interval", optarg)));
+                break;
+            case 'h':
+                help(argv[0], long_opts.data());
+                exit(0);
+            }
+        }
+        preset = Proxy::TargetPreset::Create(object_path, object_interface);
+    };
+
+    Proxy::TargetPreset::Ptr preset = nullptr;
+    unsigned int connections = 1;
+    unsigned int in_flight = 1;
+    std::chrono::seconds duration{10};
+    std::chrono::seconds interval{1};
+};
+
+
+
+/**
+ *  Latency histogram with a resolution of 2 significant digits, in the
+ *  same spirit as HdrHistogram.  Values below 128 usec are counted exactly;
+ *  above that, each power of 2 is split into 64 linear buckets.
+ */
+class LatencyHistogram
+{
+  public:
+    void Record(const int64_t usec) noexcept
+    {
+        const uint64_t v = static_cast<uint64_t>(std::max<int64_t>(0, usec));
+        counts[std::min(index(v), BUCKETS - 1)]++;
+        ++total;
+        max = std::max(max, v);
+    }
+
+    void Merge(const LatencyHistogram &other) noexcept
+    {
+        for (size_t i = 0; i < BUCKETS; ++i)
+        {
+            counts[i] += other.counts[i];
+        }
+        total += other.total;
+        max = std::max(max, other.max);
+    }
+
+    void Reset() noexcept
+    {
+        counts.fill(0);
+        total = 0;
+        max = 0;
+    }
+
+    uint64_t Count() const noexcept
+    {
+        return total;
+    }
+
+    /**
+     *  Retrieve the value at a percentile
+     *
+     * @param pct  double with the percentile, 0-100
+     *
+     * @return uint64_t with the highest value of the bucket, in usec
+     */
+    uint64_t Percentile(const double pct) const noexcept
+    {
+        if (0 == total)
+        {
+            return 0;
+        }
+        const uint64_t wanted = std::max<uint64_t>(1, static_cast<uint64_t>(total * pct / 100.0 + 0.5));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; ++i)
+        {
+            seen += counts[i];
+            if (seen >= wanted)
+            {
+                return std::min(upper_bound(i), max);
+            }
+        }
+        return max;
+    }
+
+  private:
+    static constexpr size_t BUCKETS = 128 + 40 * 64;
+    std::array<uint64_t, BUCKETS> counts{};
+    uint64_t total = 0;
+    uint64_t max = 0;
+
+    static size_t index(const uint64_t v) noexcept
+    {
+        if (v < 128)
+        {
+            return static_cast<size_t>(v);
+        }
+        const unsigned int shift = (63 - __builtin_clzll(v)) - 6;
+        return 128 + (shift - 1) * 64 + static_cast<size_t>((v >> shift) - 64);
+    }
+
+    static uint64_t upper_bound(const size_t idx) noexcept
+    {
+        if (idx < 128)
+        {
+            return idx;
+        }
+        const unsigned int shift = static_cast<unsigned int>((idx - 128) / 64) + 1;
+        const uint64_t sub = (idx - 128) % 64 + 64;
+        return ((sub + 1) << shift) - 1;
+    }
+};
+
+
+/**
+ *  Statistics collected by a single connection
+ */
+struct Stats
+{
+    LatencyHistogram latency{};
+    uint64_t calls = 0;
+    std::map<std::string, uint64_t> errors{};
+
+    void Merge(const Stats &other)
+    {
+        latency.Merge(other.latency);
+        calls += other.calls;
+        for (const auto &[err, count] : other.errors)
+        {
+            errors[err] += count;
+        }
+    }
+
+    void Reset()
+    {
+        latency.Reset();
+        calls = 0;
+        errors.clear();
+    }
+};
+
+
+/**
+ *  A single D-Bus connection, keeping a fixed amount of asynchronous
+ *  calls in flight until stopped.  Each completed call issues the next
+ *  one in its slot; a slot is only released once stopped or if the
+ *  call could not be queued.
+ */
+class Worker
+{
+  public:
+    Worker(const LoadGenOpts &opts_, GVariant *params_)
+        : opts(opts_), params(params_)
+    {
+        auto conn = DBus::Connection::CreateExclusive(opts.bustype);
+        proxy = Proxy::Client::Create(conn, opts.destination);
+    }
+
+    ~Worker() noexcept
+    {
+        // Destroying the proxy cancels the calls still in flight and
+        // waits for their callbacks, which update this object.  This
+        // must complete before any other member is destroyed.
+        running = false;
+        proxy.reset();
+    }
+
+    void Start()
+    {
+        {
+            std::lock_guard<std::mutex> lg(mtx);
+            pending += opts.in_flight;
+        }
+        for (unsigned int i = 0; i < opts.in_flight; ++i)
+        {
+            call();
+        }
+    }
+
+    void Stop()
+    {
+        running = false;
+    }
+
+    /**
+     *  Wait for all the calls in flight to complete
+     *
+     * @param timeout  Maximum time to wait
+     * @return true if all calls completed
+     */
+    bool Wait(const std::chrono::seconds timeout)
+    {
+        std::unique_lock<std::mutex> lk(mtx);
+        return idle_cv.wait_for(lk,
+                                timeout,
+                                [this]()
+                                {
+                                    return 0 == pending;
+                                });
+    }
+
+    /**
+     *  Retrieve and reset the statistics collected since the last call
+     */
+    Stats Collect()
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        Stats ret = stats;
+        stats.Reset();
+        return ret;
+    }
+
+  private:
+    const LoadGenOpts &opts;
+    GVariant *params = nullptr;
+    std::atomic<bool> running{true};
+    std::mutex mtx{};
+    std::condition_variable idle_cv{};
+    unsigned int pending = 0; ///< Call slots in use
+    Stats stats{};
+
+    // Declared last, so the proxy is destroyed first; see ~Worker()
+    Proxy::Client::Ptr proxy = nullptr;
+
+    /**
+     *  Start a call in a slot already counted in pending
+     */
+    void call()
+    {
+        const int64_t start = g_get_monotonic_time();
+        try
+        {
+            proxy->CallAsync(opts.preset,
+                             opts.method,
+                             params,
+                             [this, start](GVariant *result, std::exception_ptr error)
+                             {
+                                 completed(start, result, error);
+                             },
+                             opts.call_options);
+        }
+        catch (const DBus::Exception &excp)
+        {
+            // The call could not be queued; count it as an error and
+            // release the slot instead of retrying, which would just
+            // fail again right away
+            std::lock_guard<std::mutex> lg(mtx);
+            ++stats.calls;
+            ++stats.errors[error_name(std::current_exception())];
+            if (0 == --pending)
+            {
+                idle_cv.notify_all();
+            }
+        }
+    }
+
+    void completed(const int64_t start, GVariant *result, std::exception_ptr error)
+    {
+        const int64_t latency = g_get_monotonic_time() - start;
+        if (result)
+        {
+            g_variant_unref(result);
+        }
+
+        bool again = false;
+        {
+            std::lock_guard<std::mutex> lg(mtx);
+            ++stats.calls;
+            if (error)
+            {
+                ++stats.errors[error_name(error)];
+            }
+            else
+            {
+                stats.latency.Record(latency);
+            }
+
+            // The slot is kept for the next call while running, so
+            // Wait() cannot see it released before that call is queued
+            again = running;
+            if (!again && 0 == --pending)
+            {
+                idle_cv.notify_all();
+            }
+        }
+        if (again)
+        {
+            call();
+        }
+    }
+
+    static std::string error_name(std::exception_ptr error)
+    {
+        try
+        {
+            std::rethrow_exception(error);
+        }
+        catch (const DBus::Exception &excp)
+        {
+            const std::string domain(excp.DBusErrorDomain());
+            return (!domain.empty() ? domain : std::string(excp.GetRawError()).substr(0, 60));
+        }
+        catch (const std::exception &excp)
+        {
+            return std::string(excp.what()).substr(0, 60);
+        }
+        return "unknown";
+    }
+};
+
+
+
+static void print_interval(const double elapsed, const double seconds, const Stats &s)
+{
+    uint64_t errors = 0;
+    for (const auto &[err, count] : s.errors)
+    {
+        errors += count;
+    }
+    std::cout << "[" << std::fixed << std::setprecision(1) << std::setw(6) << elapsed << "s] "
+              << "calls/s=" << std::setprecision(0) << std::setw(8) << s.calls / seconds
+              << "  p50=" << std::setw(7) << s.latency.Percentile(50)
+              << "  p90=" << std::setw(7) << s.latency.Percentile(90)
+              << "  p99=" << std::setw(7) << s.latency.Percentile(99)
+              << "  max=" << std::setw(7) << s.latency.Percentile(100) << " usec"
+              << "  errors=" << errors;
+    for (const auto &[err, count] : s.errors)
+    {
+        std::cout << " [" << err << ": " << count << "]";
+    }
+    std::cout << std::endl;
+}
+
+
+static void print_summary(const double seconds, const Stats &s)
+{
+    std::cout << std::endl
+              << "Total calls:     " << s.calls << std::endl
+              << "Throughput:      " << std::fixed << std::setprecision(1)
+              << s.calls / seconds << " calls/s" << std::endl
+              << std::endl
+              << "Latency distribution (successful calls):" << std::endl
+              << "     Value (usec)   Percentile   TotalCount" << std::endl;
+    for (const double pct : {0.0, 25.0, 50.0, 75.0, 90.0, 95.0, 99.0, 99.9, 99.99, 100.0})
+    {
+        const uint64_t value = s.latency.Percentile(pct);
+        std::cout << std::setw(15) << value
+                  << std::setw(13) << std::setprecision(4) << pct / 100.0
+                  << std::setw(13) << static_cast<uint64_t>(s.latency.Count() * pct / 100.0)
+                  << std::endl;
+    }
+
+    std::cout << std::endl
+              << "Errors:" << (s.errors.empty() ? " none" : "") << std::endl;
+    for (const auto &[err, count] : s.errors)
+    {
+        std::cout << "    " << std::setw(10) << count << "  " << err << std::endl;
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    std::ostringstream log;
+    try
+    {
+        LoadGenOpts opts(argc, argv);
+
+        if (opts.missing_call_target(true))
+        {
+            return 2;
+        }
+
+        GVariant *params = nullptr;
+        try
+        {
+            params = TestUtils::generate_gvariant(log, opts.data_type, opts.data_values, true);
+        }
+        catch (const TestUtils::Exception &excp)
+        {
+            std::cerr << "** ERROR ** " << excp.what() << std::endl;
+            return 2;
+        }
+        if (params)
+        {
+            // The same arguments are used by all calls
+            g_variant_ref_sink(params);
+        }
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        for (unsigned int i = 0; i < opts.connections; ++i)
+        {
+            workers.push_back(std::make_unique<Worker>(opts, params));
+        }
+        std::cout << "Calling " << opts.preset << ", method=" << opts.method
+                  << " on " << opts.destination << std::endl
+                  << opts.connections << " connection(s), "
+                  << opts.in_flight << " call(s) in flight per connection, "
+                  << opts.duration.count() << " seconds" << std::endl
+                  << std::endl;
+
+        const auto start = std::chrono::steady_clock::now();
+        const auto end = start + opts.duration;
+        for (auto &w : workers)
+        {
+            w->Start();
+        }
+
+        Stats total;
+        auto last = start;
+        while (std::chrono::steady_clock::now() < end)
+        {
+            std::this_thread::sleep_until(std::min(last + opts.interval, end));
+            const auto now = std::chrono::steady_clock::now();
+
+            Stats interval;
+            for (auto &w : workers)
+            {
+                interval.Merge(w->Collect());
+            }
+            print_interval(std::chrono::duration<double>(now - start).count(),
+                           std::chrono::duration<double>(now - last).count(),
+                           interval);
+            total.Merge(interval);
+            last = now;
+        }
+        const double seconds = std::chrono::duration<double>(last - start).count();
+
+        for (auto &w : workers)
+        {
+            w->Stop();
+        }
+        for (auto &w : workers)
+        {
+            if (!w->Wait(std::chrono::seconds(30)))
+            {
+                // The calls still in flight are cancelled when the
+                // Worker object is destroyed
+                std::cerr << "** WARNING ** Calls still in flight after 30 seconds"
+                          << std::endl;
+            }
+        }
+        print_summary(seconds, total);
+        workers.clear();
+
+        if (params)
+        {
+            g_variant_unref(params);
+        }
+        return 0;
+    }
+    catch (const TestUtils::Exception &excp)
+    {
+        std::cerr << "** ERROR ** " << excp.what() << std::endl;
+        return 2;
+    }
+    catch (const DBus::Exception &excp)
+    {
+        std::cout << log.str() << std::endl;
+        std::cerr << "** EXCEPTION **  " << excp.what() << std::endl;
+        return 2;
+    }
+}
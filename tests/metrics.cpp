@@ -0,0 +1,111 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file   metrics.cpp
+ *
+ * @brief  Tests the DBus::Features::Metrics method statistics registry
+ *         and the authorization of DBus::Features::MetricsObject.  This
+ *         does not use any D-Bus connection.
+ */
+
+#include <iostream>
+#include <string>
+
+#include "../gdbuspp/authz-request.hpp"
+#include "../gdbuspp/features/metrics.hpp"
+#include "../gdbuspp/features/metrics-object.hpp"
+#include "test-utils.hpp"
+
+using namespace DBus;
+using namespace DBus::Features;
+using TestUtils::run_test;
+using TestUtils::TestResult;
+
+
+static Authz::Request::Ptr metrics_request(const std::string &caller)
+{
+    return Authz::Request::Create(caller,
+                                  Object::Operation::METHOD_CALL,
+                                  "/net/openvpn/gdbuspp/Metrics",
+                                  "net.openvpn.gdbuspp.Metrics",
+                                  "net.openvpn.gdbuspp.Metrics.GetPrometheus");
+}
+
+
+int main()
+{
+    int failures = 0;
+
+    failures += run_test([]()
+                         {
+                             auto obj = Object::Base::Create<MetricsObject>(nullptr);
+                             return TestResult("MetricsObject does not enable the metrics",
+                                               !Metrics::Enabled());
+                         });
+
+    failures += run_test([]()
+                         {
+                             auto obj = Object::Base::Create<MetricsObject>(nullptr);
+                             return TestResult("MetricsObject denies by default",
+                                               !obj->Authorize(metrics_request(":1.42")));
+                         });
+
+    failures += run_test([]()
+                         {
+                             auto obj = Object::Base::Create<MetricsObject>(
+                                 [](const Authz::Request::Ptr req)
+                                 {
+                                     return ":1.42" == req->caller;
+                                 });
+                             return TestResult("MetricsObject uses the authorization callback",
+                                               obj->Authorize(metrics_request(":1.42"))
+                                                   && !obj->Authorize(metrics_request(":1.43")));
+                         });
+
+    failures += run_test([]()
+                         {
+                             auto a = Metrics::GetMethodStats("/test/obj", "test.intf", "Method");
+                             auto b = Metrics::GetMethodStats("/test/obj", "test.intf", "Method");
+                             auto c = Metrics::GetMethodStats("/test/obj", "test.intf", "Other");
+                             return TestResult("Method statistics are kept per method",
+                                               a == b && a != c);
+                         });
+
+    failures += run_test([]()
+                         {
+                             for (unsigned int i = 0; i < GDBUSPP_METRICS_MAX_METHODS + 10; ++i)
+                             {
+                                 Metrics::GetMethodStats("/test/obj" + std::to_string(i), "test.intf", "Method");
+                             }
+                             auto a = Metrics::GetMethodStats("/test/overflow/a", "test.intf", "Method");
+                             auto b = Metrics::GetMethodStats("/test/overflow/b", "test.intf", "Method");
+
+                             bool overflow_entry = false;
+                             const auto snap = Metrics::GetSnapshot();
+                             for (const auto &m : snap.methods)
+                             {
+                                 overflow_entry |= (m.path.empty() && m.interface.empty() && m.method.empty());
+                             }
+                             return TestResult("Number of tracked methods is bounded",
+                                               a == b && overflow_entry
+                                                   && snap.methods.size() == GDBUSPP_METRICS_MAX_METHODS + 1);
+                         });
+
+    failures += run_test([]()
+                         {
+                             auto stats = Metrics::GetMethodStats("/test/obj", "test.intf", "Method");
+                             Metrics::Reset();
+                             const bool empty = Metrics::GetSnapshot().methods.empty();
+                             auto again = Metrics::GetMethodStats("/test/obj", "test.intf", "Method");
+                             return TestResult("Reset removes the tracked methods",
+                                               empty && stats != again);
+                         });
+
+    return TestUtils::test_summary(failures);
+}
@@ -0,0 +1,159 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file   payload-memfd.cpp
+ *
+ * @brief  Tests preparing and parsing DBus::Payload arguments, both
+ *         inline and passed via a sealed memfd.  This does not use any
+ *         D-Bus connection.
+ */
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <glib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "../gdbuspp/payload.hpp"
+#include "test-utils.hpp"
+
+using TestUtils::run_test;
+using TestUtils::TestResult;
+
+
+static std::vector<uint8_t> test_data(const size_t size)
+{
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; ++i)
+    {
+        data[i] = static_cast<uint8_t>((i * 7) & 0xff);
+    }
+    return data;
+}
+
+
+/**
+ *  Prepare and parse the payload arguments of a given size
+ *
+ * @return true if the parsed payload matches the input and was passed
+ *         the expected way
+ */
+static bool roundtrip(const size_t size, const size_t threshold, const bool expect_memfd)
+{
+    const std::vector<uint8_t> input = test_data(size);
+    int fd = -1;
+    GVariant *params = g_variant_ref_sink(DBus::Payload::Prepare(input.data(),
+                                                                 input.size(),
+                                                                 fd,
+                                                                 threshold));
+
+    DBus::Payload::Ptr payload = DBus::Payload::Parse(params, fd);
+    g_variant_unref(params);
+    if (fd >= 0)
+    {
+        // The mapping must remain valid after the memfd is closed
+        close(fd);
+    }
+
+    return (expect_memfd == (fd >= 0))
+           && payload->IsMapped() == (expect_memfd && size > 0)
+           && payload->size() == size
+           && payload->Copy() == input;
+}
+
+
+int main()
+{
+    int failures = 0;
+
+    failures += run_test([]()
+                         {
+                             return TestResult("Empty payload, inline",
+                                               roundtrip(0, GDBUSPP_PAYLOAD_MEMFD_THRESHOLD, false));
+                         });
+    failures += run_test([]()
+                         {
+                             return TestResult("Small payload, inline",
+                                               roundtrip(100, GDBUSPP_PAYLOAD_MEMFD_THRESHOLD, false));
+                         });
+    failures += run_test([]()
+                         {
+                             return TestResult("Below threshold, inline",
+                                               roundtrip(GDBUSPP_PAYLOAD_MEMFD_THRESHOLD - 1,
+                                                         GDBUSPP_PAYLOAD_MEMFD_THRESHOLD,
+                                                         false));
+                         });
+    failures += run_test([]()
+                         {
+                             return TestResult("At threshold, memfd",
+                                               roundtrip(GDBUSPP_PAYLOAD_MEMFD_THRESHOLD,
+                                                         GDBUSPP_PAYLOAD_MEMFD_THRESHOLD,
+                                                         true));
+                         });
+    failures += run_test([]()
+                         {
+                             return TestResult("Large payload, memfd",
+                                               roundtrip(8 * 1024 * 1024, GDBUSPP_PAYLOAD_MEMFD_THRESHOLD, true));
+                         });
+    failures += run_test([]()
+                         {
+                             return TestResult("Empty payload, memfd", roundtrip(0, 0, true));
+                         });
+
+    failures += run_test([]()
+                         {
+                             return TestUtils::expect_exception<DBus::Payload::Exception>(
+                                 "Unsealed memfd is rejected",
+                                 []()
+                                 {
+                                     int fd = memfd_create("test", MFD_CLOEXEC);
+                                     (void)!write(fd, "unsealed", 8);
+                                     GVariant *params = g_variant_ref_sink(
+                                         g_variant_new_parsed("(@ay [],)"));
+                                     try
+                                     {
+                                         (void)DBus::Payload::Parse(params, fd);
+                                     }
+                                     catch (...)
+                                     {
+                                         g_variant_unref(params);
+                                         close(fd);
+                                         throw;
+                                     }
+                                     g_variant_unref(params);
+                                     close(fd);
+                                 },
+                                 "Payload memfd is not sealed");
+                         });
+
+    failures += run_test([]()
+                         {
+                             return TestUtils::expect_exception<DBus::Payload::Exception>(
+                                 "Non-payload arguments are rejected",
+                                 []()
+                                 {
+                                     GVariant *params = g_variant_ref_sink(g_variant_new("(s)", "text"));
+                                     try
+                                     {
+                                         (void)DBus::Payload::Parse(params, -1);
+                                     }
+                                     catch (...)
+                                     {
+                                         g_variant_unref(params);
+                                         throw;
+                                     }
+                                     g_variant_unref(params);
+                                 },
+                                 "expected (ay), got (s)");
+                         });
+
+    return TestUtils::test_summary(failures);
+}
@@ -0,0 +1,213 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file   peer-connection.cpp
+ *
+ * @brief  Tests direct peer-to-peer D-Bus connections via DBus::PeerServer
+ *         and DBus::Connection::CreatePeer().  Method calls and property
+ *         reads are done over a peer connection, where the requests carry
+ *         no sender bus name.  This does not need any D-Bus bus daemon.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glib.h>
+
+#include "../gdbuspp/authz-request.hpp"
+#include "../gdbuspp/connection.hpp"
+#include "../gdbuspp/mainloop.hpp"
+#include "../gdbuspp/object/base.hpp"
+#include "../gdbuspp/object/manager.hpp"
+#include "../gdbuspp/peer-server.hpp"
+#include "../gdbuspp/proxy.hpp"
+#include "test-utils.hpp"
+
+using namespace DBus;
+using TestUtils::run_test;
+using TestUtils::TestResult;
+
+static const Object::Path peer_path = "/net/openvpn/gdbuspp/test/peer";
+static const std::string peer_interface = "net.openvpn.gdbuspp.test.peer";
+
+
+class PeerObject : public Object::Base
+{
+  public:
+    PeerObject()
+        : Object::Base(peer_path, peer_interface)
+    {
+        DisableIdleDetector(true);
+        AddProperty("counter", counter, false);
+        auto args = AddMethod("Echo",
+                              [](Object::Method::Arguments::Ptr args)
+                              {
+                                  GVariant *params = args->GetMethodParameters();
+                                  const std::string msg = glib2::Value::Extract<std::string>(params, 0);
+                                  args->SetMethodReturn(glib2::Value::CreateTupleWrapped(msg));
+                              });
+        args->AddInput("message", "s");
+        args->AddOutput("reply", "s");
+    }
+
+    const bool Authorize(const Authz::Request::Ptr request) override
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        callers.push_back(request->caller);
+        return true;
+    }
+
+    std::vector<std::string> GetCallers()
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        return callers;
+    }
+
+  private:
+    uint32_t counter = 3;
+    std::mutex mtx{};
+    std::vector<std::string> callers{};
+};
+
+
+/**
+ *  Keeps the accepted peer connections with the D-Bus objects
+ *  provided on each of them
+ */
+class PeerHandler
+{
+  public:
+    void NewConnection(Connection::Ptr conn)
+    {
+        auto mgr = Object::Manager::CreateManager(conn);
+        auto obj = mgr->CreateObject<PeerObject>();
+        std::lock_guard<std::mutex> lg(mtx);
+        peers.push_back({conn, mgr, obj});
+    }
+
+    std::shared_ptr<PeerObject> WaitObject()
+    {
+        for (int i = 0; i < 500; ++i)
+        {
+            {
+                std::lock_guard<std::mutex> lg(mtx);
+                if (!peers.empty())
+                {
+                    return peers.back().object;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return nullptr;
+    }
+
+  private:
+    struct Peer
+    {
+        Connection::Ptr connection;
+        Object::Manager::Ptr manager;
+        std::shared_ptr<PeerObject> object;
+    };
+    std::mutex mtx{};
+    std::vector<Peer> peers{};
+};
+
+
+int main()
+{
+    int failures = 0;
+    try
+    {
+        auto loop = MainLoop::Create();
+        std::thread loopthread([loop]()
+                               {
+                                   loop->Run();
+                               });
+
+        PeerHandler handler;
+        auto server = PeerServer::Create("unix:tmpdir=/tmp",
+                                         [&handler](Connection::Ptr conn)
+                                         {
+                                             handler.NewConnection(conn);
+                                         });
+
+        auto conn = Connection::CreatePeer(server->GetClientAddress());
+        auto obj = handler.WaitObject();
+        auto prx = Proxy::Client::Create(conn, "");
+
+        failures += run_test([conn, obj]()
+                             {
+                                 return TestResult("Peer connection is accepted",
+                                                   obj && BusType::PEER == conn->GetBusType()
+                                                       && conn->GetUniqueBusName().empty());
+                             });
+
+        failures += run_test([prx]()
+                             {
+                                 GVariant *r = prx->Call(peer_path,
+                                                         peer_interface,
+                                                         "Echo",
+                                                         glib2::Value::CreateTupleWrapped(std::string("hello")));
+                                 const std::string reply = glib2::Value::Extract<std::string>(r, 0);
+                                 g_variant_unref(r);
+                                 return TestResult("Method call over a peer connection",
+                                                   "hello" == reply);
+                             });
+
+        failures += run_test([prx]()
+                             {
+                                 GVariant *r = prx->GetPropertyGVariant(peer_path, peer_interface, "counter");
+                                 const uint32_t counter = g_variant_get_uint32(r);
+                                 g_variant_unref(r);
+                                 return TestResult("Property read over a peer connection",
+                                                   3 == counter);
+                             });
+
+        failures += run_test([obj]()
+                             {
+                                 auto callers = obj->GetCallers();
+                                 bool empty = !callers.empty();
+                                 for (const auto &c : callers)
+                                 {
+                                     empty &= c.empty();
+                                 }
+                                 return TestResult("Requests without a sender bus name are authorized",
+                                                   empty);
+                             });
+
+        failures += run_test([]()
+                             {
+                                 return TestUtils::expect_exception<PeerServer::Exception>(
+                                     "Invalid listening address is rejected",
+                                     []()
+                                     {
+                                         auto bad = PeerServer::Create("bogus:",
+                                                                       [](Connection::Ptr)
+                                                                       {
+                                                                       });
+                                     },
+                                     "");
+                             });
+
+        server->Stop();
+        loop->Stop();
+        loopthread.join();
+    }
+    catch (const DBus::Exception &excp)
+    {
+        std::cerr << "** EXCEPTION **  " << excp.what() << std::endl;
+        return 3;
+    }
+
+    return TestUtils::test_summary(failures);
+}
@@ -0,0 +1,166 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file   proxy-awaitable.cpp
+ *
+ * @brief  Tests the C++20 coroutine awaitables in proxy/awaitable.hpp
+ *         against the tests/simple-service.cpp test service.  This
+ *         program must be built as C++20.
+ */
+
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <future>
+#include <iostream>
+#include <string>
+
+#include "../gdbuspp/connection.hpp"
+#include "../gdbuspp/proxy.hpp"
+#include "../gdbuspp/proxy/awaitable.hpp"
+#include "test-constants.hpp"
+#include "test-utils.hpp"
+
+using namespace DBus;
+using namespace Test;
+using TestUtils::run_test;
+using TestUtils::TestResult;
+
+
+/**
+ *  Minimal coroutine type; the coroutine starts running directly and
+ *  is not awaited by anyone
+ */
+struct Task
+{
+    struct promise_type
+    {
+        Task get_return_object() noexcept
+        {
+            return {};
+        }
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+        void return_void() noexcept
+        {
+        }
+        void unhandled_exception() noexcept
+        {
+            std::terminate();
+        }
+    };
+};
+
+
+Task run_tests(Connection::Ptr conn, Proxy::Client::Ptr prx, std::promise<int> &done)
+{
+    int failures = 0;
+    auto methods = Proxy::TargetPreset::Create(Constants::GenPath("simple1/methods"),
+                                               Constants::GenInterface("simple1"));
+    auto props = Proxy::TargetPreset::Create(Constants::GenPath("simple1/properties"),
+                                             Constants::GenInterface("simple1"));
+
+    GVariant *r = co_await Proxy::Awaitable::Call(prx,
+                                                  methods,
+                                                  "StringLength",
+                                                  g_variant_new("(s)", "coroutine"));
+    const int len = glib2::Value::Extract<int>(r, 0);
+    g_variant_unref(r);
+    failures += run_test([len]()
+                         {
+                             return TestResult("Call() result", 9 == len);
+                         });
+
+    r = co_await Proxy::Awaitable::Call(prx, methods, "GetCallerBusName");
+    const std::string caller = glib2::Value::Extract<std::string>(r, 0);
+    g_variant_unref(r);
+    failures += run_test([&caller, conn]()
+                         {
+                             return TestResult("Call() without arguments",
+                                               conn->GetUniqueBusName() == caller);
+                         });
+
+    auto str = co_await Proxy::Awaitable::GetProperty<std::string>(prx, props, "string_val");
+    failures += run_test([&str]()
+                         {
+                             return TestResult("GetProperty()", "Initial string" == str);
+                         });
+
+    co_await Proxy::Awaitable::SetProperty<std::string>(prx, props, "string_val", "awaited");
+    str = co_await Proxy::Awaitable::GetProperty<std::string>(prx, props, "string_val");
+    failures += run_test([&str]()
+                         {
+                             return TestResult("SetProperty()", "awaited" == str);
+                         });
+
+    bool rejected = false;
+    try
+    {
+        r = co_await Proxy::Awaitable::Call(prx, methods, "NoSuchMethod");
+        g_variant_unref(r);
+    }
+    catch (const DBus::Exception &)
+    {
+        rejected = true;
+    }
+    failures += run_test([rejected]()
+                         {
+                             return TestResult("Failed call throws", rejected);
+                         });
+
+    // Many short calls, where the reply may arrive before the
+    // coroutine has been suspended
+    int sum = 0;
+    for (int i = 0; i < 500; ++i)
+    {
+        r = co_await Proxy::Awaitable::Call(prx,
+                                            methods,
+                                            "StringLength",
+                                            g_variant_new("(s)", std::string(i % 10, 'x').c_str()));
+        sum += glib2::Value::Extract<int>(r, 0);
+        g_variant_unref(r);
+    }
+    failures += run_test([sum]()
+                         {
+                             return TestResult("Repeated calls", 50 * 45 == sum);
+                         });
+
+    done.set_value(failures);
+}
+
+
+int main()
+{
+    try
+    {
+        auto conn = Connection::Create(BusType::SESSION);
+        auto prx = Proxy::Client::Create(conn, Constants::GenServiceName("simple"));
+
+        std::promise<int> done;
+        auto result = done.get_future();
+        run_tests(conn, prx, done);
+        if (std::future_status::ready != result.wait_for(std::chrono::seconds(30)))
+        {
+            std::cout << "Coroutine did not complete" << std::endl;
+            return 2;
+        }
+        return TestUtils::test_summary(result.get());
+    }
+    catch (const DBus::Exception &excp)
+    {
+        std::cerr << "** EXCEPTION **  " << excp.what() << std::endl;
+        return 3;
+    }
+}
@@ -0,0 +1,186 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file   proxy-call-stats.cpp
+ *
+ * @brief  Tests the client side call statistics of Proxy::Client, for
+ *         both synchronous and asynchronous calls.  The calls are done
+ *         against the D-Bus daemon itself.  This needs a session bus.
+ */
+
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <string>
+#include <glib.h>
+
+#include "../gdbuspp/connection.hpp"
+#include "../gdbuspp/proxy.hpp"
+#include "test-utils.hpp"
+
+using namespace DBus;
+using TestUtils::run_test;
+using TestUtils::TestResult;
+
+static const Object::Path dbus_path = "/org/freedesktop/DBus";
+static const std::string dbus_interface = "org.freedesktop.DBus";
+
+
+/**
+ *  Look up the statistics of a method in a snapshot
+ *
+ * @param stats   Proxy::CallStats::Snapshot to search
+ * @param method  std::string with the method name
+ *
+ * @return Proxy::CallStats::Entry of the method, with all counters
+ *         set to 0 if not found
+ */
+static Proxy::CallStats::Entry find_entry(const Proxy::CallStats::Snapshot &stats,
+                                          const std::string &method)
+{
+    for (const auto &e : stats)
+    {
+        if (dbus_path == e.path && dbus_interface == e.interface && method == e.method)
+        {
+            return e;
+        }
+    }
+    return Proxy::CallStats::Entry{};
+}
+
+
+/**
+ *  Do an asynchronous call and wait for the result
+ *
+ * @return true if the call succeeded
+ */
+static bool call_async(Proxy::Client::Ptr prx,
+                       const std::string &method,
+                       const Proxy::CallOptions::Ptr options = nullptr)
+{
+    auto result = prx->CallAsync(dbus_path, dbus_interface, method, nullptr, options);
+    try
+    {
+        GVariant *r = result.get();
+        if (r)
+        {
+            g_variant_unref(r);
+        }
+        return true;
+    }
+    catch (const Proxy::Exception &)
+    {
+        return false;
+    }
+}
+
+
+int main()
+{
+    int failures = 0;
+    try
+    {
+        auto conn = Connection::Create(BusType::SESSION);
+        auto prx = Proxy::Client::Create(conn, "org.freedesktop.DBus");
+
+        failures += run_test([prx]()
+                             {
+                                 GVariant *r = prx->Call(dbus_path, dbus_interface, "GetId");
+                                 g_variant_unref(r);
+                                 return TestResult("No statistics while disabled",
+                                                   prx->GetCallStats().empty());
+                             });
+
+        prx->EnableCallStats(true);
+
+        failures += run_test([prx]()
+                             {
+                                 for (int i = 0; i < 3; ++i)
+                                 {
+                                     GVariant *r = prx->Call(dbus_path, dbus_interface, "GetId");
+                                     g_variant_unref(r);
+                                 }
+                                 auto e = find_entry(prx->GetCallStats(), "GetId");
+                                 return TestResult("Synchronous calls are recorded",
+                                                   3 == e.calls && 0 == e.errors
+                                                       && 3 == e.latency.count);
+                             });
+
+        failures += run_test([prx]()
+                             {
+                                 bool failed = false;
+                                 try
+                                 {
+                                     GVariant *r = prx->Call(dbus_path, dbus_interface, "NoSuchMethod");
+                                     g_variant_unref(r);
+                                 }
+                                 catch (const Proxy::Exception &)
+                                 {
+                                     failed = true;
+                                 }
+                                 auto e = find_entry(prx->GetCallStats(), "NoSuchMethod");
+                                 return TestResult("Failed synchronous calls are recorded as errors",
+                                                   failed && 1 == e.calls && 1 == e.errors
+                                                       && 0 == e.timeouts);
+                             });
+
+        failures += run_test([prx]()
+                             {
+                                 bool ok = call_async(prx, "ListNames");
+                                 ok &= call_async(prx, "ListNames");
+                                 auto e = find_entry(prx->GetCallStats(), "ListNames");
+                                 return TestResult("Asynchronous calls are recorded",
+                                                   ok && 2 == e.calls && 0 == e.errors
+                                                       && 2 == e.latency.count);
+                             });
+
+        failures += run_test([prx]()
+                             {
+                                 const bool ok = call_async(prx, "NoSuchAsyncMethod");
+                                 auto e = find_entry(prx->GetCallStats(), "NoSuchAsyncMethod");
+                                 return TestResult("Failed asynchronous calls are recorded as errors",
+                                                   !ok && 1 == e.calls && 1 == e.errors);
+                             });
+
+        failures += run_test([prx]()
+                             {
+                                 auto options = Proxy::CallOptions::Create();
+                                 options->SetDeadline(std::chrono::steady_clock::now()
+                                                      - std::chrono::seconds(1));
+                                 const bool ok = call_async(prx, "GetNameOwner", options);
+                                 auto e = find_entry(prx->GetCallStats(), "GetNameOwner");
+                                 return TestResult("Expired asynchronous calls are recorded as timeouts",
+                                                   !ok && 1 == e.calls && 1 == e.errors
+                                                       && 1 == e.timeouts);
+                             });
+
+        failures += run_test([prx]()
+                             {
+                                 prx->ResetCallStats();
+                                 auto e = find_entry(prx->GetCallStats(), "GetId");
+                                 return TestResult("ResetCallStats() clears the counters",
+                                                   0 == e.calls && 0 == e.latency.count);
+                             });
+
+        failures += run_test([prx]()
+                             {
+                                 prx->EnableCallStats(false);
+                                 call_async(prx, "ListNames");
+                                 return TestResult("Disabling discards the statistics",
+                                                   prx->GetCallStats().empty());
+                             });
+    }
+    catch (const DBus::Exception &excp)
+    {
+        std::cerr << "** EXCEPTION **  " << excp.what() << std::endl;
+        return 3;
+    }
+
+    return TestUtils::test_summary(failures);
+}
@@ -14,6 +14,8 @@
  */
 
 #include <any>
+#include <chrono>
+#include <future>
 #include <iostream>
 #include <limits>
 #include <string>
@@ -28,7 +30,7 @@
 
 using namespace DBus;
 
-class ProxyOpts : protected TestUtils::OptionParser
+class ProxyOpts : public TestUtils::CallTargetOptions
 {
   public:
     enum class PropertyMode
@@ -42,57 +44,39 @@ class ProxyOpts : protected TestUtils::OptionParser
 
     ProxyOpts(const int argc, char **argv)
     {
-        static struct option long_opts[] = {
-            // clang-format off
-            {"system",        no_argument,       nullptr, 'Y'},
-            {"session",       no_argument,       nullptr, 'E'},
-            {"destination",   required_argument, nullptr, 'd'},
-            {"object_path",   required_argument, nullptr, 'p'},
-            {"interface",     required_argument, nullptr, 'i'},
-            {"method-call",   required_argument, nullptr, 'm'},
-            {"property-get",  required_argument, nullptr, 'g'},
-            {"property-set",  required_argument, nullptr, 's'},
-            {"property-set-string", required_argument, nullptr, 'S'},
-            {"property-set-int",    required_argument, nullptr, 'I'},
-            {"property-set-uint",   required_argument, nullptr, 'U'},
-            {"property-set-bool",   required_argument, nullptr, 'B'},
-            {"data-type",     required_argument, nullptr, 't'},
-            {"data-value",    required_argument, nullptr, 'v'},
-            {"expect-type",   required_argument, nullptr, 'X'},
-            {"expect-result", required_argument, nullptr, 'x'},
-            {"quiet",         no_argument,       nullptr, 'q'},
-            {"introspect",    no_argument,       nullptr, 'Q'},
-            {"help", no_argument, nullptr, 'h'},
-            {nullptr, 0, nullptr, 0}
-            // clang-format on
-        };
+        init_options({
+                         // clang-format off
+                         {"property-get",  required_argument, nullptr, 'g'},
+                         {"property-set",  required_argument, nullptr, 's'},
+                         {"property-set-string", required_argument, nullptr, 'S'},
+                         {"property-set-int",    required_argument, nullptr, 'I'},
+                         {"property-set-uint",   required_argument, nullptr, 'U'},
+                         {"property-set-bool",   required_argument, nullptr, 'B'},
+                         {"expect-type",   required_argument, nullptr, 'X'},
+                         {"expect-result", required_argument, nullptr, 'x'},
+                         {"quiet",         no_argument,       nullptr, 'q'},
+                         {"introspect",    no_argument,       nullptr, 'Q'},
+                         {"async",         no_argument,       nullptr, 'A'},
+                         {"help", no_argument, nullptr, 'h'},
+                         // clang-format on
+                     },
+                     "g:s:S:I:U:B:X:x:qQAh");
 
         int opt;
         optind = 1;
-        while ((opt = getopt_long(argc, argv, "YEd:p:i:m:g:s:S:I:U:B:t:v:X:x:qQh", long_opts, nullptr)) != -1)
+        while ((opt = getopt_long(argc, argv, short_opts.c_str(), long_opts.data(), nullptr)) != -1)
         {
+            if (parse_call_target(opt, optarg))
+            {
+                continue;
+            }
             switch (opt)
             {
-            case 'Y':
-                bustype = DBus::BusType::SYSTEM;
-                break;
-            case 'E':
-                bustype = DBus::BusType::SESSION;
-                break;
-            case 'd':
-                destination = std::string(optarg);
-                break;
-            case 'p':
-                object_path = DBus::Object::Path(optarg);
-                break;
-            case 'i':
-                object_interface = std::string(optarg);
-                break;
             case 'Q':
                 introspect = true;
                 break;
-            case 'm':
-                method = std::string(optarg);
+            case 'A':
+                async = true;
                 break;
             case 'g':
                 property = std::string(optarg);
@@ -115,12 +99,6 @@ class ProxyOpts : protected TestUtils::OptionParser
                 property = std::string(optarg);
                 property_mode = PropertyMode::SET_ANY;
                 break;
-            case 't':
-                data_type = std::string(optarg);
-                break;
-            case 'v':
-                data_values.push_back(std::string(optarg));
-                break;
             case 'X':
                 check_type = std::string(optarg);
                 break;
@@ -131,7 +109,7 @@ class ProxyOpts : protected TestUtils::OptionParser
                 quiet = true;
                 break;
             case 'h':
-                help(argv[0], long_opts);
+                help(argv[0], long_opts.data());
                 exit(0);
             }
 
@@ -158,20 +136,14 @@ class ProxyOpts : protected TestUtils::OptionParser
         preset = Proxy::TargetPreset::Create(object_path, object_interface);
     };
 
-    DBus::BusType bustype = DBus::BusType::SESSION;
     Proxy::TargetPreset::Ptr preset = nullptr;
-    std::string destination{};
-    DBus::Object::Path object_path;
-    std::string object_interface{};
-    std::string method{};
     std::string property{};
     std::any prop_val{};
-    std::string data_type{};
     std::string check_type{};
     std::string check_response{};
-    std::vector<std::string> data_values{};
     PropertyMode property_mode = PropertyMode::UNSET;
     bool introspect = false;
+    bool async = false;
     bool quiet = false;
 };
 
@@ -183,19 +155,7 @@ int main(int argc, char **argv)
     try
     {
         ProxyOpts options(argc, argv);
-
-        bool errors = false;
-        if (options.destination.empty())
-        {
-            std::cerr << "** ERROR **  Missing --destination" << std::endl;
-            errors = true;
-        }
-
-        if (options.object_path.empty())
-        {
-            std::cerr << "** ERROR **  Missing --object-path" << std::endl;
-            errors = true;
-        }
+        bool errors = options.missing_call_target(false);
         if (errors)
         {
             return 2;
@@ -252,7 +212,17 @@ int main(int argc, char **argv)
 
             log << "Method call: " << options.preset
                 << ", method=" << options.method << std::endl;
-            GVariant *res = prx->Call(options.preset, options.method, data);
+            GVariant *res = (options.async
+                                 ? prx->CallAsync(options.preset,
+                                                  options.method,
+                                                  data,
+                                                  options.call_options)
+                                       .get()
+                                 : prx->Call(options.preset,
+                                             options.method,
+                                             data,
+                                             false,
+                                             options.call_options));
             TestUtils::dump_gvariant(log, "GVariant response", res);
 
             std::ostringstream check_log;
@@ -293,7 +263,32 @@ int main(int argc, char **argv)
             log << "Get Property: " << options.preset
                 << ", property=" << options.property << std::endl;
 
-            GVariant *res = prx->GetPropertyGVariant(options.preset, options.property);
+            GVariant *res = nullptr;
+            if (options.async)
+            {
+                std::promise<GVariant *> result;
+                prx->GetPropertyGVariantAsync(options.preset,
+                                              options.property,
+                                              [&result](GVariant *value, std::exception_ptr error)
+                                              {
+                                                  if (error)
+                                                  {
+                                                      result.set_exception(error);
+                                                  }
+                                                  else
+                                                  {
+                                                      result.set_value(value);
+                                                  }
+                                              },
+                                              options.call_options);
+                res = result.get_future().get();
+            }
+            else
+            {
+                res = prx->GetPropertyGVariant(options.preset,
+                                               options.property,
+                                               options.call_options);
+            }
             TestUtils::dump_gvariant(log, "GVariant response", res);
 
 
@@ -464,6 +459,11 @@ int main(int argc, char **argv)
         }
         g_thread_pool_stop_unused_threads();
     }
+    catch (const TestUtils::Exception &excp)
+    {
+        std::cerr << "** ERROR ** " << excp.what() << std::endl;
+        return 2;
+    }
     catch (const DBus::Exception &excp)
     {
         std::cout << log.str() << std::endl;
@@ -0,0 +1,273 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file   proxy-single-flight.cpp
+ *
+ * @brief  Tests sharing identical concurrent requests via
+ *         Proxy::Client::EnableSingleFlight().  The test runs a small
+ *         service in a separate thread, which parks the authorization of
+ *         all the reads until the test grants them.  The number of parked
+ *         decisions tells how many requests reached the service.  This
+ *         needs a session bus.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glib.h>
+
+#include "../gdbuspp/authz-request.hpp"
+#include "../gdbuspp/connection.hpp"
+#include "../gdbuspp/object/base.hpp"
+#include "../gdbuspp/proxy.hpp"
+#include "../gdbuspp/service.hpp"
+#include "test-constants.hpp"
+#include "test-utils.hpp"
+
+using namespace DBus;
+using namespace Test;
+using TestUtils::run_test;
+using TestUtils::TestResult;
+
+
+/**
+ *  Object parking the authorization of all requests except property
+ *  changes, which are granted right away
+ */
+class FlightObject : public Object::Base
+{
+  public:
+    using Ptr = std::shared_ptr<FlightObject>;
+
+    FlightObject()
+        : Object::Base(Constants::GenPath("singleflight"),
+                       Constants::GenInterface("singleflight"))
+    {
+        DisableIdleDetector(true);
+        AsyncAuthorization(true);
+        AsyncPropertyAccess(true);
+        AddProperty("value", value, true);
+        AddMethod("Lookup",
+                  [this](Object::Method::Arguments::Ptr args)
+                  {
+                      ++lookups;
+                      args->SetMethodReturn(g_variant_new("(u)", value.Get()));
+                  });
+    }
+
+    const bool Authorize(const Authz::Request::Ptr request) override
+    {
+        // Only AuthorizeAsync() is expected to be used
+        return false;
+    }
+
+    void AuthorizeAsync(const Authz::Request::Ptr request,
+                        Authz::Decision::Ptr decision) override
+    {
+        if (Object::Operation::PROPERTY_SET == request->operation)
+        {
+            decision->Grant();
+            return;
+        }
+        std::lock_guard<std::mutex> lg(mtx);
+        parked.push_back(decision);
+        parked_cv.notify_all();
+    }
+
+    /**
+     *  Wait for a number of decisions to be parked
+     *
+     * @param count  Number of decisions to wait for
+     * @return true if the decisions arrived within 5 seconds
+     */
+    bool WaitParked(const size_t count)
+    {
+        std::unique_lock<std::mutex> lk(mtx);
+        return parked_cv.wait_for(lk,
+                                  std::chrono::seconds(5),
+                                  [this, count]()
+                                  {
+                                      return parked.size() >= count;
+                                  });
+    }
+
+    /**
+     *  Grant all the parked decisions
+     *
+     * @return size_t with the number of granted decisions
+     */
+    size_t GrantParked()
+    {
+        std::vector<Authz::Decision::Ptr> decisions;
+        {
+            std::lock_guard<std::mutex> lg(mtx);
+            decisions.swap(parked);
+        }
+        for (auto &d : decisions)
+        {
+            d->Grant();
+        }
+        return decisions.size();
+    }
+
+    Object::Property::Atomic<uint32_t> value{1};
+    std::atomic<unsigned int> lookups{0};
+
+  private:
+    std::mutex mtx{};
+    std::condition_variable parked_cv{};
+    std::vector<Authz::Decision::Ptr> parked{};
+};
+
+
+class FlightService : public Service
+{
+  public:
+    FlightService(Connection::Ptr conn)
+        : Service(conn, Constants::GenServiceName("singleflight"))
+    {
+    }
+
+    void BusNameAcquired(const std::string &busname) override
+    {
+        acquired = true;
+    }
+
+    void BusNameLost(const std::string &busname) override
+    {
+        Stop();
+    }
+
+    std::atomic<bool> acquired{false};
+};
+
+
+/**
+ *  Read the "value" property in a separate thread
+ */
+static std::future<uint32_t> read_value(Proxy::Client::Ptr prx, Proxy::TargetPreset::Ptr preset)
+{
+    return std::async(std::launch::async,
+                      [prx, preset]()
+                      {
+                          GVariant *r = prx->GetPropertyGVariant(preset, "value");
+                          const uint32_t ret = g_variant_get_uint32(r);
+                          g_variant_unref(r);
+                          return ret;
+                      });
+}
+
+
+/**
+ *  Give the requests started by other threads time to reach the
+ *  service, or to join a request in progress
+ */
+static void settle()
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+}
+
+
+int main()
+{
+    int failures = 0;
+    try
+    {
+        auto srvconn = Connection::Create(BusType::SESSION);
+        auto service = Service::Create<FlightService>(srvconn);
+        auto obj = service->CreateServiceHandler<FlightObject>();
+
+        std::thread srvthread([service]()
+                              {
+                                  service->Run();
+                              });
+        for (int i = 0; i < 500 && !service->acquired; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        auto conn = Connection::CreateExclusive(BusType::SESSION);
+        auto prx = Proxy::Client::Create(conn, Constants::GenServiceName("singleflight"));
+        auto preset = Proxy::TargetPreset::Create(obj->GetPath(), obj->GetInterface());
+        prx->EnableSingleFlight(true);
+        prx->SetIdempotent(obj->GetInterface(), "Lookup");
+
+        failures += run_test([prx, preset, obj]()
+                             {
+                                 auto first = read_value(prx, preset);
+                                 bool ok = obj->WaitParked(1);
+                                 auto second = read_value(prx, preset);
+                                 settle();
+                                 const size_t reads = obj->GrantParked();
+                                 ok &= (1 == first.get() && 1 == second.get());
+                                 return TestResult("Concurrent property reads share one call",
+                                                   ok && 1 == reads);
+                             });
+
+        failures += run_test([prx, preset, obj]()
+                             {
+                                 auto before = read_value(prx, preset);
+                                 bool ok = obj->WaitParked(1);
+                                 prx->SetPropertyGVariant(preset, "value", g_variant_new_uint32(2));
+                                 auto after = read_value(prx, preset);
+                                 ok &= obj->WaitParked(2);
+                                 const size_t reads = obj->GrantParked();
+                                 ok &= (2 == after.get());
+                                 before.get();
+                                 return TestResult("Property read after a Set does not join an older read",
+                                                   ok && 2 == reads);
+                             });
+
+        failures += run_test([prx, preset, obj]()
+                             {
+                                 auto call = [prx, preset]()
+                                 {
+                                     GVariant *r = prx->Call(preset, "Lookup");
+                                     g_variant_unref(r);
+                                 };
+                                 auto first = std::async(std::launch::async, call);
+                                 bool ok = obj->WaitParked(1);
+                                 auto second = std::async(std::launch::async, call);
+                                 settle();
+                                 const size_t calls = obj->GrantParked();
+                                 first.get();
+                                 second.get();
+                                 return TestResult("Concurrent idempotent method calls share one call",
+                                                   ok && 1 == calls && 1 == obj->lookups);
+                             });
+
+        failures += run_test([prx, preset, obj]()
+                             {
+                                 prx->EnableSingleFlight(false);
+                                 auto first = read_value(prx, preset);
+                                 auto second = read_value(prx, preset);
+                                 const bool ok = obj->WaitParked(2);
+                                 obj->GrantParked();
+                                 first.get();
+                                 second.get();
+                                 return TestResult("Reads are not shared when disabled", ok);
+                             });
+
+        service->Stop();
+        srvthread.join();
+    }
+    catch (const DBus::Exception &excp)
+    {
+        std::cerr << "** EXCEPTION **  " << excp.what() << std::endl;
+        return 3;
+    }
+
+    return TestUtils::test_summary(failures);
+}
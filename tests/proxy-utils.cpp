@@ -379,6 +379,73 @@ int main(int argc, char **argv)
                      false);
         }
 
+        // Run Utils::Query::IntrospectNode() and GetChildNodes() tests
+        {
+            auto test_node = [&query, &path, &interface]() -> bool
+            {
+                auto node = query->IntrospectNode(path);
+                return nullptr != g_dbus_node_info_lookup_interface(node.get(),
+                                                                    interface.c_str())
+                       && node == query->IntrospectNode(path);
+            };
+            test_log(log,
+                     "query->IntrospectNode('" + path + "') - cached",
+                     proxy,
+                     test_node,
+                     true);
+
+            const std::string parent = path.substr(0, path.rfind('/'));
+            auto test_children = [&query, &path, &parent]() -> bool
+            {
+                for (const auto &child : query->GetChildNodes(parent))
+                {
+                    if (child == path)
+                    {
+                        return true;
+                    }
+                }
+                return false;
+            };
+            test_log(log,
+                     "query->GetChildNodes('" + parent + "') contains '" + path + "'",
+                     proxy,
+                     test_children,
+                     true);
+
+            auto test_invalidate = [&query, &path]() -> bool
+            {
+                auto node = query->IntrospectNode(path);
+                query->InvalidateIntrospection();
+                return node != query->IntrospectNode(path);
+            };
+            test_log(log,
+                     "query->InvalidateIntrospection()",
+                     proxy,
+                     test_invalidate,
+                     true);
+        }
+
+        // Run Utils::Query::GetManagedObjects() tests
+        auto test_managed = [&query, &path]() -> bool
+        {
+            GVariant *objs = query->GetManagedObjects("/gdbuspp/tests");
+            GVariant *obj = g_variant_lookup_value(objs,
+                                                   path.c_str(),
+                                                   G_VARIANT_TYPE("a{sa{sv}}"));
+            g_variant_unref(objs);
+            if (!obj)
+            {
+                return false;
+            }
+            g_variant_unref(obj);
+            return true;
+        };
+        test_log(log,
+                 "query->GetManagedObjects('/gdbuspp/tests')",
+                 proxy,
+                 test_managed,
+                 true);
+
 
         // Run Proxy::Utils::DBusServiceQuery tests
         {
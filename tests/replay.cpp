@@ -0,0 +1,421 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file   replay.cpp
+ *
+ * @brief  Replays a request capture recorded by DBus::Features::Capture
+ *         against a D-Bus service.  Each recorded call is sent at the same
+ *         time offset as it was recorded, optionally sped up, without
+ *         waiting for the earlier calls to complete.  This keeps the
+ *         concurrency of the recorded traffic.  The calls of each recorded
+ *         sender are sent over the same connection.
+ *
+ *         This is useful to measure changes, such as the AsyncProcess::Pool
+ *         sizing, with the call mix of a production service.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include <getopt.h>
+#include <glib.h>
+
+#include "../gdbuspp/connection.hpp"
+#include "../gdbuspp/features/capture.hpp"
+#include "../gdbuspp/proxy.hpp"
+#include "test-utils.hpp"
+
+using namespace DBus;
+
+
+class ReplayOpts : protected TestUtils::OptionParser
+{
+  public:
+    ReplayOpts(const int argc, char **argv)
+    {
+        static struct option long_opts[] = {
+            // clang-format off
+            {"system",        no_argument,       nullptr, 'Y'},
+            {"session",       no_argument,       nullptr, 'E'},
+            {"destination",   required_argument, nullptr, 'd'},
+            {"capture-file",  required_argument, nullptr, 'f'},
+            {"speed",         required_argument, nullptr, 's'},
+            {"connections",   required_argument, nullptr, 'c'},
+            {"timeout",       required_argument, nullptr, 'T'},
+            {"help", no_argument, nullptr, 'h'},
+            {nullptr, 0, nullptr, 0}
+            // clang-format on
+        };
+
+        int opt;
+        optind = 1;
+        while ((opt = getopt_long(argc, argv, "YEd:f:s:c:T:h", long_opts, nullptr)) != -1)
+        {
+            switch (opt)
+            {
+            case 'Y':
+                bustype = DBus::BusType::SYSTEM;
+                break;
+            case 'E':
+                bustype = DBus::BusType::SESSION;
+                break;
+            case 'd':
+                destination = std::string(optarg);
+                break;
+            case 'f':
+                capture_file = std::string(optarg);
+                break;
+            case 's':
+                speed = std::max(0.0, std::atof(optarg));
+                break;
+            case 'c':
+                connections = std::max(1, std::atoi(optarg));
+                break;
+            case 'T':
+                call_options = Proxy::CallOptions::Create(std::chrono::milliseconds(std::max(0, std::atoi(optarg))));
+                break;
+            case 'h':
+                help(argv[0], long_opts);
+                std::cout << std::endl
+                          << "A --speed of 2 replays the capture twice as fast as "
+                          << "recorded; 0 sends all calls" << std::endl
+                          << "without any delay.  Calls from more senders than "
+                          << "--connections share connections." << std::endl;
+                exit(0);
+            }
+        }
+    };
+
+    DBus::BusType bustype = DBus::BusType::SESSION;
+    std::string destination{};
+    std::string capture_file{};
+    double speed = 1.0;
+    unsigned int connections = 16;
+    Proxy::CallOptions::Ptr call_options = nullptr;
+};
+
+
+
+/**
+ *  Latencies and errors of a single D-Bus method
+ */
+struct MethodStats
+{
+    std::vector<int64_t> latency{};
+    uint64_t errors = 0;
+};
+
+
+/**
+ *  Sends the recorded calls and collects the results
+ */
+class Replay
+{
+  public:
+    Replay(const ReplayOpts &opts_)
+        : opts(opts_)
+    {
+    }
+
+    ~Replay() noexcept
+    {
+        // Destroying the proxies cancels the calls still in flight and
+        // waits for their callbacks, which update this object.  This
+        // must complete before any other member is destroyed.
+        senders.clear();
+        clients.clear();
+    }
+
+    /**
+     *  Send a recorded call over the connection used for its sender,
+     *  without waiting for the result
+     *
+     * @param entry  Features::Capture::Entry with the call to send
+     */
+    void Call(const Features::Capture::Entry &entry)
+    {
+        auto proxy = client(entry.sender);
+        const MethodKey key{entry.path, entry.interface, entry.member};
+        {
+            std::lock_guard<std::mutex> lg(mtx);
+            ++pending;
+        }
+        const int64_t start = g_get_monotonic_time();
+        try
+        {
+            proxy->CallAsync(entry.path,
+                             entry.interface,
+                             entry.member,
+                             entry.params.get(),
+                             [this, key, start](GVariant *result, std::exception_ptr error)
+                             {
+                                 completed(key, start, result, error);
+                             },
+                             opts.call_options);
+        }
+        catch (const DBus::Exception &excp)
+        {
+            completed(key, start, nullptr, std::current_exception());
+        }
+    }
+
+    /**
+     *  Wait for all the calls in flight to complete
+     *
+     * @param timeout  Maximum time to wait
+     * @return true if all calls completed
+     */
+    bool Wait(const std::chrono::seconds timeout)
+    {
+        std::unique_lock<std::mutex> lk(mtx);
+        return idle_cv.wait_for(lk,
+                                timeout,
+                                [this]()
+                                {
+                                    return 0 == pending;
+                                });
+    }
+
+    size_t GetConnectionCount() const
+    {
+        return clients.size();
+    }
+
+    size_t GetSenderCount() const
+    {
+        return senders.size();
+    }
+
+    void PrintSummary()
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        std::cout << std::setw(8) << "Calls" << std::setw(8) << "Errors"
+                  << std::setw(10) << "p50" << std::setw(10) << "p90"
+                  << std::setw(10) << "p99" << std::setw(10) << "max"
+                  << " (usec)  Method" << std::endl;
+        for (auto &[key, s] : methods)
+        {
+            std::sort(s.latency.begin(), s.latency.end());
+            const auto &[path, interface, member] = key;
+            std::cout << std::setw(8) << s.latency.size() + s.errors
+                      << std::setw(8) << s.errors
+                      << std::setw(10) << percentile(s.latency, 50)
+                      << std::setw(10) << percentile(s.latency, 90)
+                      << std::setw(10) << percentile(s.latency, 99)
+                      << std::setw(10) << percentile(s.latency, 100)
+                      << "          " << path << " " << interface << "." << member
+                      << std::endl;
+        }
+
+        std::cout << std::endl
+                  << "Errors:" << (errors.empty() ? " none" : "") << std::endl;
+        for (const auto &[err, count] : errors)
+        {
+            std::cout << "    " << std::setw(10) << count << "  " << err << std::endl;
+        }
+    }
+
+  private:
+    /// Key of the method statistics; path, interface, method
+    using MethodKey = std::tuple<std::string, std::string, std::string>;
+
+    const ReplayOpts &opts;
+    std::mutex mtx{};
+    std::condition_variable idle_cv{};
+    unsigned int pending = 0;
+    std::map<MethodKey, MethodStats> methods{};
+    std::map<std::string, uint64_t> errors{};
+
+    // Declared last, so the proxies are destroyed first; see ~Replay()
+    std::vector<Proxy::Client::Ptr> clients{};
+    std::map<std::string, Proxy::Client::Ptr> senders{};
+
+    /**
+     *  Retrieve the proxy used for the calls of a recorded sender.  A new
+     *  connection is used for each sender until --connections is reached;
+     *  after that, the senders share the existing connections.
+     */
+    Proxy::Client::Ptr client(const std::string &sender)
+    {
+        auto it = senders.find(sender);
+        if (senders.end() != it)
+        {
+            return it->second;
+        }
+
+        Proxy::Client::Ptr proxy = nullptr;
+        if (clients.size() < opts.connections)
+        {
+            auto conn = DBus::Connection::CreateExclusive(opts.bustype);
+            proxy = Proxy::Client::Create(conn, opts.destination);
+            clients.push_back(proxy);
+        }
+        else
+        {
+            proxy = clients[senders.size() % clients.size()];
+        }
+        senders[sender] = proxy;
+        return proxy;
+    }
+
+    void completed(const MethodKey &key,
+                   const int64_t start,
+                   GVariant *result,
+                   std::exception_ptr error)
+    {
+        const int64_t latency = g_get_monotonic_time() - start;
+        if (result)
+        {
+            g_variant_unref(result);
+        }
+
+        std::lock_guard<std::mutex> lg(mtx);
+        MethodStats &s = methods[key];
+        if (error)
+        {
+            ++s.errors;
+            ++errors[error_name(error)];
+        }
+        else
+        {
+            s.latency.push_back(latency);
+        }
+        if (0 == --pending)
+        {
+            idle_cv.notify_all();
+        }
+    }
+
+    static int64_t percentile(const std::vector<int64_t> &sorted, const double pct)
+    {
+        if (sorted.empty())
+        {
+            return 0;
+        }
+        const size_t idx = static_cast<size_t>((sorted.size() - 1) * pct / 100.0 + 0.5);
+        return sorted[std::min(idx, sorted.size() - 1)];
+    }
+
+    static std::string error_name(std::exception_ptr error)
+    {
+        try
+        {
+            std::rethrow_exception(error);
+        }
+        catch (const DBus::Exception &excp)
+        {
+            const std::string domain(excp.DBusErrorDomain());
+            return (!domain.empty() ? domain : std::string(excp.GetRawError()).substr(0, 60));
+        }
+        catch (const std::exception &excp)
+        {
+            return std::string(excp.what()).substr(0, 60);
+        }
+        return "unknown";
+    }
+};
+
+
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        ReplayOpts opts(argc, argv);
+
+        bool errors = false;
+        if (opts.destination.empty())
+        {
+            std::cerr << "** ERROR **  Missing --destination" << std::endl;
+            errors = true;
+        }
+        if (opts.capture_file.empty())
+        {
+            std::cerr << "** ERROR **  Missing --capture-file" << std::endl;
+            errors = true;
+        }
+        if (errors)
+        {
+            return 2;
+        }
+
+        Features::Capture::Reader reader(opts.capture_file);
+        Replay replay(opts);
+        std::cout << "Replaying " << opts.capture_file << " against "
+                  << opts.destination << " at ";
+        if (opts.speed > 0)
+        {
+            std::cout << opts.speed << "x speed" << std::endl;
+        }
+        else
+        {
+            std::cout << "full speed" << std::endl;
+        }
+
+        // How late the calls were sent compared to the schedule
+        std::vector<int64_t> lag{};
+        uint64_t calls = 0;
+        const int64_t start = g_get_monotonic_time();
+        Features::Capture::Entry entry;
+        while (reader.Next(entry))
+        {
+            if (opts.speed > 0)
+            {
+                const int64_t due = start + static_cast<int64_t>(entry.timestamp / opts.speed);
+                const int64_t now = g_get_monotonic_time();
+                if (due > now)
+                {
+                    std::this_thread::sleep_for(std::chrono::microseconds(due - now));
+                }
+                lag.push_back(std::max<int64_t>(0, g_get_monotonic_time() - due));
+            }
+            replay.Call(entry);
+            ++calls;
+        }
+        const double seconds = (g_get_monotonic_time() - start) / 1000000.0;
+
+        if (!replay.Wait(std::chrono::seconds(60)))
+        {
+            // The calls still in flight are cancelled when the
+            // Replay object is destroyed
+            std::cerr << "** WARNING ** Calls still in flight after 60 seconds"
+                      << std::endl;
+        }
+
+        std::cout << std::endl
+                  << "Calls sent:      " << calls << " in " << std::fixed
+                  << std::setprecision(1) << seconds << " seconds" << std::endl
+                  << "Senders:         " << replay.GetSenderCount() << " over "
+                  << replay.GetConnectionCount() << " connection(s)" << std::endl;
+        if (!lag.empty())
+        {
+            std::sort(lag.begin(), lag.end());
+            std::cout << "Schedule lag:    p99=" << lag[(lag.size() - 1) * 99 / 100]
+                      << " max=" << lag.back() << " usec" << std::endl;
+        }
+        std::cout << std::endl;
+        replay.PrintSummary();
+        return 0;
+    }
+    catch (const DBus::Exception &excp)
+    {
+        std::cerr << "** EXCEPTION **  " << excp.what() << std::endl;
+        return 2;
+    }
+}
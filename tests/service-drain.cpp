@@ -0,0 +1,139 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file   service-drain.cpp
+ *
+ * @brief  Tests the draining DBus::Service::Stop() called from a D-Bus
+ *         method callback, which must not wait for the request of that
+ *         method call itself.  This needs a session bus.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <glib.h>
+
+#include "../gdbuspp/authz-request.hpp"
+#include "../gdbuspp/connection.hpp"
+#include "../gdbuspp/object/base.hpp"
+#include "../gdbuspp/proxy.hpp"
+#include "../gdbuspp/service.hpp"
+#include "test-constants.hpp"
+#include "test-utils.hpp"
+
+using namespace DBus;
+using namespace Test;
+using TestUtils::run_test;
+using TestUtils::TestResult;
+
+
+class DrainObject : public Object::Base
+{
+  public:
+    using Ptr = std::shared_ptr<DrainObject>;
+
+    DrainObject()
+        : Object::Base(Constants::GenPath("drain"),
+                       Constants::GenInterface("drain"))
+    {
+        DisableIdleDetector(true);
+        auto args = AddMethod("Shutdown",
+                              [this](Object::Method::Arguments::Ptr args)
+                              {
+                                  const bool drained = stopper();
+                                  args->SetMethodReturn(g_variant_new("(b)", drained));
+                              });
+        args->AddOutput("drained", "b");
+    }
+
+    const bool Authorize(const Authz::Request::Ptr request) override
+    {
+        return true;
+    }
+
+    std::function<bool()> stopper{};
+};
+
+
+class DrainService : public Service
+{
+  public:
+    DrainService(Connection::Ptr conn)
+        : Service(conn, Constants::GenServiceName("drain"))
+    {
+    }
+
+    void BusNameAcquired(const std::string &busname) override
+    {
+        acquired = true;
+    }
+
+    void BusNameLost(const std::string &busname) override
+    {
+        Stop();
+    }
+
+    std::atomic<bool> acquired{false};
+};
+
+
+int main()
+{
+    int failures = 0;
+    try
+    {
+        auto srvconn = Connection::Create(BusType::SESSION);
+        auto service = Service::Create<DrainService>(srvconn);
+        auto obj = service->CreateServiceHandler<DrainObject>();
+        std::weak_ptr<DrainService> weak_service = service;
+        obj->stopper = [weak_service]()
+        {
+            auto srv = weak_service.lock();
+            return srv && srv->Stop(std::chrono::seconds(5));
+        };
+
+        std::thread srvthread([service]()
+                              {
+                                  service->Run();
+                              });
+        for (int i = 0; i < 500 && !service->acquired; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        auto conn = Connection::CreateExclusive(BusType::SESSION);
+        auto prx = Proxy::Client::Create(conn, Constants::GenServiceName("drain"));
+
+        failures += run_test([prx, obj]()
+                             {
+                                 const auto start = std::chrono::steady_clock::now();
+                                 GVariant *r = prx->Call(obj->GetPath(),
+                                                         obj->GetInterface(),
+                                                         "Shutdown");
+                                 const bool drained = glib2::Value::Extract<bool>(r, 0);
+                                 g_variant_unref(r);
+                                 const auto duration = std::chrono::steady_clock::now() - start;
+                                 return TestResult("Stop() from a method callback does not wait for itself",
+                                                   drained && duration < std::chrono::seconds(2));
+                             });
+
+        srvthread.join();
+    }
+    catch (const DBus::Exception &excp)
+    {
+        std::cerr << "** EXCEPTION **  " << excp.what() << std::endl;
+        return 3;
+    }
+
+    return TestUtils::test_summary(failures);
+}
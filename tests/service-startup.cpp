@@ -0,0 +1,242 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file   service-startup.cpp
+ *
+ * @brief  Tests the deferred bus name acquisition of DBus::Service and
+ *         the objects built by DBus::Service::AddStartupTask().  The
+ *         service runs in a separate thread of this test.  This needs a
+ *         session bus.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glib.h>
+
+#include "../gdbuspp/authz-request.hpp"
+#include "../gdbuspp/connection.hpp"
+#include "../gdbuspp/object/base.hpp"
+#include "../gdbuspp/proxy.hpp"
+#include "../gdbuspp/proxy/utils.hpp"
+#include "../gdbuspp/service.hpp"
+#include "test-constants.hpp"
+#include "test-utils.hpp"
+
+using namespace DBus;
+using namespace Test;
+using TestUtils::run_test;
+using TestUtils::TestResult;
+
+static constexpr unsigned int TASKS = 3;
+
+
+class StartupObject : public Object::Base
+{
+  public:
+    StartupObject(const unsigned int id_)
+        : Object::Base(Constants::GenPath("startup/obj") + std::to_string(id_),
+                       Constants::GenInterface("startup")),
+          id(id_)
+    {
+        DisableIdleDetector(true);
+        AddProperty("id", id, false);
+    }
+
+    const bool Authorize(const Authz::Request::Ptr request) override
+    {
+        return true;
+    }
+
+  private:
+    uint32_t id = 0;
+};
+
+
+class StartupService : public Service
+{
+  public:
+    StartupService(Connection::Ptr conn, const std::string &name)
+        : Service(conn, name, Startup::DEFERRED)
+    {
+    }
+
+    void BusNameAcquired(const std::string &busname) override
+    {
+        acquired = true;
+    }
+
+    void BusNameLost(const std::string &busname) override
+    {
+        Stop();
+    }
+
+    std::atomic<bool> acquired{false};
+};
+
+
+/**
+ *  Collects the threads the startup tasks run in
+ */
+class TaskThreads
+{
+  public:
+    void Add()
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        threads.insert(std::this_thread::get_id());
+    }
+
+    size_t Count()
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        return threads.size();
+    }
+
+  private:
+    std::mutex mtx{};
+    std::set<std::thread::id> threads{};
+};
+
+
+int main()
+{
+    int failures = 0;
+    try
+    {
+        const std::string busname = Constants::GenServiceName("startup");
+        auto conn = Connection::Create(BusType::SESSION);
+        auto query = Proxy::Utils::DBusServiceQuery::Create(conn);
+        auto service = Service::Create<StartupService>(conn, busname);
+
+        TaskThreads task_threads;
+        for (unsigned int i = 0; i < TASKS; ++i)
+        {
+            service->AddStartupTask(
+                [i, &task_threads]()
+                {
+                    task_threads.Add();
+                    // Keeps the other workers from taking more than one task
+                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                    std::vector<Object::Base::Ptr> objs;
+                    objs.push_back(Object::Base::Create<StartupObject>(i));
+                    return objs;
+                });
+        }
+
+        failures += run_test([query, busname]()
+                             {
+                                 return TestResult("Deferred bus name is not requested before Start()",
+                                                   !query->NameHasOwner(busname));
+                             });
+
+        std::thread srvthread([service]()
+                              {
+                                  service->Run();
+                              });
+        for (int i = 0; i < 500 && !service->acquired; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        failures += run_test([service, &task_threads]()
+                             {
+                                 const size_t expect = std::min<size_t>(TASKS,
+                                                                        std::max(1U, std::thread::hardware_concurrency()));
+                                 return TestResult("Startup tasks run in parallel",
+                                                   service->acquired && expect == task_threads.Count());
+                             });
+
+        failures += run_test([conn, busname]()
+                             {
+                                 auto prx = Proxy::Client::Create(conn, busname);
+                                 bool ok = true;
+                                 for (unsigned int i = 0; i < TASKS; ++i)
+                                 {
+                                     const Object::Path path{Constants::GenPath("startup/obj") + std::to_string(i)};
+                                     GVariant *r = prx->GetPropertyGVariant(path,
+                                                                            Constants::GenInterface("startup"),
+                                                                            "id");
+                                     ok &= (i == g_variant_get_uint32(r));
+                                     g_variant_unref(r);
+                                 }
+                                 return TestResult("Objects of the startup tasks are registered with the bus name",
+                                                   ok);
+                             });
+
+        failures += run_test([service]()
+                             {
+                                 auto t = service->GetStartupTimings();
+                                 return TestResult("Startup timings are recorded",
+                                                   t.build >= std::chrono::milliseconds(100)
+                                                       && t.name_acquisition.count() > 0);
+                             });
+
+        failures += run_test([service]()
+                             {
+                                 return TestUtils::expect_exception<Service::Exception>(
+                                     "Startup tasks cannot be added after Start()",
+                                     [service]()
+                                     {
+                                         service->AddStartupTask(
+                                             []()
+                                             {
+                                                 return std::vector<Object::Base::Ptr>{};
+                                             });
+                                     },
+                                     "before the service is started");
+                             });
+
+        failures += run_test([conn]()
+                             {
+                                 const std::string failname = Constants::GenServiceName("startup_fail");
+                                 auto failconn = Connection::CreateExclusive(BusType::SESSION);
+                                 auto failsrv = Service::Create<StartupService>(failconn, failname);
+                                 failsrv->AddStartupTask(
+                                     []()
+                                     {
+                                         std::vector<Object::Base::Ptr> objs;
+                                         objs.push_back(Object::Base::Create<StartupObject>(TASKS));
+                                         return objs;
+                                     });
+                                 failsrv->AddStartupTask(
+                                     []() -> std::vector<Object::Base::Ptr>
+                                     {
+                                         throw std::runtime_error("Startup task failure");
+                                     });
+                                 auto query = Proxy::Utils::DBusServiceQuery::Create(conn);
+                                 auto res = TestUtils::expect_exception<std::runtime_error>(
+                                     "A failing startup task fails Start()",
+                                     [failsrv]()
+                                     {
+                                         failsrv->Start();
+                                     },
+                                     "Startup task failure");
+                                 return TestResult(res.message + " without requesting the bus name",
+                                                   res.result && !query->NameHasOwner(failname));
+                             });
+
+        service->Stop();
+        srvthread.join();
+    }
+    catch (const DBus::Exception &excp)
+    {
+        std::cerr << "** EXCEPTION **  " << excp.what() << std::endl;
+        return 3;
+    }
+
+    return TestUtils::test_summary(failures);
+}
@@ -0,0 +1,157 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file   shared-declarations.cpp
+ *
+ * @brief  Tests sharing the method and property declarations between
+ *         objects with identical declarations, as done when the objects
+ *         are registered.  This does not use any D-Bus connection.
+ */
+
+#include <iostream>
+#include <string>
+#include <glib.h>
+
+#include "../gdbuspp/object/method.hpp"
+#include "../gdbuspp/object/property.hpp"
+#include "test-utils.hpp"
+
+using namespace DBus;
+using TestUtils::run_test;
+using TestUtils::TestResult;
+
+static const std::string interface = "net.openvpn.gdbuspp.test.shared";
+
+
+/**
+ *  Create a method collection as an object constructor would
+ *
+ * @param args  Arguments::Ptr to fill in with the arguments of the
+ *              "Hello" method
+ * @return Object::Method::Collection::Ptr
+ */
+static Object::Method::Collection::Ptr create_methods(Object::Method::Arguments::Ptr &args)
+{
+    auto methods = Object::Method::Collection::Create();
+    args = methods->AddMethod("Hello",
+                              [](Object::Method::Arguments::Ptr)
+                              {
+                              });
+    args->AddInput("name", "s");
+    args->AddOutput("greeting", "s");
+    methods->AddMethod("Ping",
+                       [](Object::Method::Arguments::Ptr)
+                       {
+                       });
+    return methods;
+}
+
+
+static Object::Property::Collection::Ptr create_properties()
+{
+    auto props = Object::Property::Collection::Create();
+    props->AddBinding(Object::Property::BySpec::Create(
+        interface,
+        "counter",
+        false,
+        "u",
+        [](const Object::Property::BySpec &)
+        {
+            return g_variant_new_uint32(1);
+        },
+        nullptr));
+    return props;
+}
+
+
+int main()
+{
+    int failures = 0;
+    const size_t methods_start = Object::Method::Collection::SharedDeclarations();
+    const size_t props_start = Object::Property::Collection::SharedDeclarations();
+
+    failures += run_test([methods_start]()
+                         {
+                             Object::Method::Arguments::Ptr args_a, args_b;
+                             auto a = create_methods(args_a);
+                             auto b = create_methods(args_b);
+                             const std::string xml = a->GenerateIntrospection();
+                             a->Share(interface);
+                             b->Share(interface);
+                             return TestResult("Identical method declarations are shared",
+                                               methods_start + 2 == Object::Method::Collection::SharedDeclarations()
+                                                   && xml == a->GenerateIntrospection()
+                                                   && xml == b->GenerateIntrospection());
+                         });
+
+    failures += run_test([methods_start]()
+                         {
+                             return TestResult("Method declarations are released with the objects",
+                                               methods_start == Object::Method::Collection::SharedDeclarations());
+                         });
+
+    failures += run_test([methods_start]()
+                         {
+                             Object::Method::Arguments::Ptr args_a, args_b;
+                             auto a = create_methods(args_a);
+                             auto b = create_methods(args_b);
+                             a->Share(interface);
+                             b->Share(interface + ".other");
+                             return TestResult("Declarations of other interfaces are not shared",
+                                               methods_start + 4 == Object::Method::Collection::SharedDeclarations());
+                         });
+
+    failures += run_test([]()
+                         {
+                             Object::Method::Arguments::Ptr args_a, args_b;
+                             auto a = create_methods(args_a);
+                             auto b = create_methods(args_b);
+                             a->Share(interface);
+                             b->Share(interface);
+                             const std::string xml = b->GenerateIntrospection();
+
+                             args_a->AddInput("extra", "u");
+                             args_a->SetPriority(AsyncProcess::Priority::HIGH);
+                             const std::string modified = a->GenerateIntrospection();
+                             return TestResult("Modifying a shared declaration only changes its own object",
+                                               xml == b->GenerateIntrospection()
+                                                   && modified != xml
+                                                   && std::string::npos != modified.find("'extra'")
+                                                   && AsyncProcess::Priority::HIGH == a->GetPriority("Hello")
+                                                   && AsyncProcess::Priority::NORMAL == b->GetPriority("Hello"));
+                         });
+
+    failures += run_test([]()
+                         {
+                             return TestUtils::expect_exception<Object::Method::Exception>(
+                                 "Invalid argument data type is rejected",
+                                 []()
+                                 {
+                                     Object::Method::Arguments::Ptr args;
+                                     auto m = create_methods(args);
+                                     args->AddInput("broken", "a");
+                                 },
+                                 "Invalid D-Bus data type: 'a'");
+                         });
+
+    failures += run_test([props_start]()
+                         {
+                             auto a = create_properties();
+                             auto b = create_properties();
+                             a->Share(interface);
+                             b->Share(interface);
+                             const bool shared = (props_start + 1 == Object::Property::Collection::SharedDeclarations());
+                             a.reset();
+                             b.reset();
+                             return TestResult("Property declarations are shared and released",
+                                               shared && props_start == Object::Property::Collection::SharedDeclarations());
+                         });
+
+    return TestUtils::test_summary(failures);
+}
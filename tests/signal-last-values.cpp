@@ -0,0 +1,112 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file   signal-last-values.cpp
+ *
+ * @brief  Tests the last values retained by DBus::Signals::Group via
+ *         RetainLastValue() and retrieved via GetLastValues().  This
+ *         needs a session bus.
+ */
+
+#include <iostream>
+#include <string>
+#include <glib.h>
+
+#include "../gdbuspp/connection.hpp"
+#include "../gdbuspp/signals/group.hpp"
+#include "test-utils.hpp"
+
+using namespace DBus;
+using TestUtils::run_test;
+using TestUtils::TestResult;
+
+
+class StatusSignals : public Signals::Group
+{
+  public:
+    StatusSignals(DBus::Connection::Ptr conn)
+        : Signals::Group(conn,
+                         "/net/openvpn/gdbuspp/test/lastvalues",
+                         "net.openvpn.gdbuspp.test.lastvalues")
+    {
+        RegisterSignal("Status", {{"code", "u"}});
+        RetainLastValue("Status");
+        AddTarget("");
+        GroupCreate("private");
+        GroupAddTarget("private", conn->GetUniqueBusName());
+    }
+};
+
+
+/**
+ *  Retrieve the retained value of the Status signal
+ *
+ * @return int with the status code, -1 if not retained
+ */
+static int retained_status(Signals::Group::Ptr grp)
+{
+    GVariant *values = grp->GetLastValues();
+    GVariant *status = g_variant_lookup_value(values, "Status", G_VARIANT_TYPE("(u)"));
+    int ret = -1;
+    if (status)
+    {
+        guint32 code = 0;
+        g_variant_get(status, "(u)", &code);
+        ret = static_cast<int>(code);
+        g_variant_unref(status);
+    }
+    g_variant_unref(values);
+    return ret;
+}
+
+
+int main()
+{
+    int failures = 0;
+    try
+    {
+        auto conn = Connection::Create(BusType::SESSION);
+        auto grp = Signals::Group::Create<StatusSignals>(conn);
+
+        failures += run_test([grp]()
+                             {
+                                 return TestResult("Nothing retained before sending",
+                                                   -1 == retained_status(grp));
+                             });
+
+        failures += run_test([grp]()
+                             {
+                                 grp->SendGVariant("Status", g_variant_new("(u)", 1));
+                                 return TestResult("Default group value is retained",
+                                                   1 == retained_status(grp));
+                             });
+
+        failures += run_test([grp]()
+                             {
+                                 grp->GroupSendGVariant("private", "Status", g_variant_new("(u)", 2));
+                                 return TestResult("Named group value is not returned",
+                                                   1 == retained_status(grp));
+                             });
+
+        failures += run_test([conn, grp]()
+                             {
+                                 conn->Disconnect();
+                                 grp->SendGVariant("Status", g_variant_new("(u)", 3));
+                                 return TestResult("Value not sent is not retained",
+                                                   1 == retained_status(grp));
+                             });
+    }
+    catch (const DBus::Exception &excp)
+    {
+        std::cerr << "** EXCEPTION **  " << excp.what() << std::endl;
+        return 3;
+    }
+
+    return TestUtils::test_summary(failures);
+}
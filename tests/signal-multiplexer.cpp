@@ -0,0 +1,156 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file   signal-multiplexer.cpp
+ *
+ * @brief  Tests sharing identical signal subscriptions between several
+ *         DBus::Signals::SubscriptionManager objects on the same
+ *         connection via DBus::Signals::Multiplexer.  The signals are
+ *         sent to this process itself.  This needs a session bus.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <glib.h>
+
+#include "../gdbuspp/connection.hpp"
+#include "../gdbuspp/mainloop.hpp"
+#include "../gdbuspp/signals/emit.hpp"
+#include "../gdbuspp/signals/multiplexer.hpp"
+#include "../gdbuspp/signals/subscriptionmgr.hpp"
+#include "../gdbuspp/signals/target.hpp"
+#include "test-utils.hpp"
+
+using namespace DBus;
+using TestUtils::run_test;
+using TestUtils::TestResult;
+
+static const Object::Path path = "/net/openvpn/gdbuspp/test/multiplexer";
+static const std::string interface = "net.openvpn.gdbuspp.test.multiplexer";
+
+
+/**
+ *  Counts the signals received by a subscription
+ */
+class Receiver
+{
+  public:
+    Signals::CallbackFnc Callback()
+    {
+        return [this](Signals::Event::Ptr &event)
+        {
+            ++received;
+        };
+    }
+
+    /**
+     *  Wait until a number of signals has been received
+     *
+     * @param count  Number of signals to wait for
+     * @return true if the signals arrived within 5 seconds
+     */
+    bool Wait(const unsigned int count) const
+    {
+        for (int i = 0; i < 500 && received < count; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        return received >= count;
+    }
+
+    std::atomic<unsigned int> received{0};
+};
+
+
+int main()
+{
+    int failures = 0;
+    try
+    {
+        auto conn = Connection::Create(BusType::SESSION);
+        auto loop = MainLoop::Create();
+        std::thread loopthread([loop]()
+                               {
+                                   loop->Run();
+                               });
+
+        auto emit = Signals::Emit::Create(conn);
+        emit->AddTarget(conn->GetUniqueBusName(), path, interface);
+        auto send = [emit]()
+        {
+            emit->SendGVariant("Tick", g_variant_new("(u)", 1));
+        };
+
+        auto mux = Signals::Multiplexer::Get(conn);
+        const size_t filters_start = mux->GetFilterCount();
+        auto target = Signals::Target::Create(conn->GetUniqueBusName(), path, interface);
+        auto mgr_a = Signals::SubscriptionManager::Create(conn);
+        auto mgr_b = Signals::SubscriptionManager::Create(conn);
+        Receiver rcv_a;
+        Receiver rcv_b;
+
+        // Subscribed first, so its exception is seen before the
+        // other subscribers are called
+        auto mgr_throw = Signals::SubscriptionManager::Create(conn);
+        mgr_throw->Subscribe(target,
+                             "Tick",
+                             [](Signals::Event::Ptr &event)
+                             {
+                                 throw std::runtime_error("Subscriber failure");
+                             });
+        mgr_a->Subscribe(target, "Tick", rcv_a.Callback());
+        mgr_b->Subscribe(target, "Tick", rcv_b.Callback());
+
+        failures += run_test([mux, filters_start]()
+                             {
+                                 return TestResult("Subscription managers share one filter",
+                                                   filters_start + 1 == mux->GetFilterCount());
+                             });
+
+        failures += run_test([&send, &rcv_a, &rcv_b]()
+                             {
+                                 send();
+                                 return TestResult("All subscribers receive the signal, also "
+                                                   "after a failing subscriber",
+                                                   rcv_a.Wait(1) && rcv_b.Wait(1));
+                             });
+
+        failures += run_test([&send, &rcv_a, &rcv_b, mgr_a, target, mux, filters_start]()
+                             {
+                                 mgr_a->Unsubscribe(target, "Tick");
+                                 const bool kept = (filters_start + 1 == mux->GetFilterCount());
+                                 send();
+                                 const bool received = rcv_b.Wait(2);
+                                 return TestResult("Removing one subscriber keeps the others",
+                                                   kept && received && 1 == rcv_a.received);
+                             });
+
+        failures += run_test([mgr_b, mgr_throw, target, mux, filters_start]()
+                             {
+                                 mgr_b->Unsubscribe(target, "Tick");
+                                 mgr_throw->Unsubscribe(target, "Tick");
+                                 return TestResult("Filter is removed with the last subscriber",
+                                                   filters_start == mux->GetFilterCount());
+                             });
+
+        loop->Stop();
+        loopthread.join();
+    }
+    catch (const DBus::Exception &excp)
+    {
+        std::cerr << "** EXCEPTION **  " << excp.what() << std::endl;
+        return 3;
+    }
+
+    return TestUtils::test_summary(failures);
+}
@@ -13,6 +13,7 @@
  *         implementation
  */
 
+#include <array>
 #include <iostream>
 #include <limits>
 #include <string>
@@ -44,6 +45,7 @@ class SignalOpts : protected TestUtils::OptionParser
             {"interface",     required_argument, nullptr, 'i'},
             {"repeat-send",   required_argument, nullptr, 'r'},
             {"delay-send",    required_argument, nullptr, 'D'},
+            {"typed",         no_argument,       nullptr, 'T'},
             {"quiet",         no_argument,       nullptr, 'q'},
             {"help",          no_argument,       nullptr, 'h'},
             {nullptr, 0, nullptr, 0}
@@ -56,7 +58,7 @@ class SignalOpts : protected TestUtils::OptionParser
         std::string object_path{Constants::GenPath("signals")};
         std::string object_interface{Constants::GenInterface("signals")};
 
-        while ((opt = getopt_long(argc, argv, "YEd:p:i:r:D:s:t:v:qh", long_opts, nullptr)) != -1)
+        while ((opt = getopt_long(argc, argv, "YEd:p:i:r:D:s:t:v:Tqh", long_opts, nullptr)) != -1)
         {
             switch (opt)
             {
@@ -81,6 +83,9 @@ class SignalOpts : protected TestUtils::OptionParser
             case 'D':
                 delay_send = atoi(optarg);
                 break;
+            case 'T':
+                typed = true;
+                break;
             case 'q':
                 quiet = true;
                 break;
@@ -96,6 +101,7 @@ class SignalOpts : protected TestUtils::OptionParser
     Signals::Target::Ptr target = nullptr;
     uint32_t repeat_send = 1;
     uint32_t delay_send = 0;
+    bool typed = false;
     bool quiet = false;
 };
 
@@ -129,6 +135,22 @@ int main(int argc, char **argv)
     auto sig_emit = Signals::Emit::Create(dbc);
     sig_emit->AddTarget(opts.target);
 
+    if (opts.typed)
+    {
+        using TypedTestSignal = Signals::TypedSignal<std::string, bool, uint32_t>;
+        auto testsig = Signals::Signal::Create<TypedTestSignal>(
+            sig_emit,
+            "TestSignal",
+            std::array<std::string, 3>{"value_1", "value_2", "value_3"});
+        for (uint32_t i = 0; i < opts.repeat_send; ++i)
+        {
+            std::stringstream msg;
+            msg << "Test Signal " << std::to_string(i + 1);
+            testsig->Emit(msg.str(), (i % 2), 101 + i);
+        }
+        return 0;
+    }
+
     auto testsig = Signals::Signal::Create<TestSignal>(sig_emit);
     for (uint32_t i = 0; i < opts.repeat_send; ++i)
     {
@@ -0,0 +1,82 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file   signal-spec.cpp
+ *
+ * @brief  Tests sharing DBus::Signals::Specification objects between
+ *         signal groups registering the same signals.  This does not use
+ *         any D-Bus connection.
+ */
+
+#include <iostream>
+#include <string>
+
+#include "../gdbuspp/signals/exceptions.hpp"
+#include "../gdbuspp/signals/group.hpp"
+#include "test-utils.hpp"
+
+using namespace DBus::Signals;
+using TestUtils::run_test;
+using TestUtils::TestResult;
+
+
+int main()
+{
+    int failures = 0;
+    const SignalArgList log_args = {{"group", "u"}, {"message", "s"}};
+    const SignalArgList status_args = {{"code", "u"}};
+
+    failures += run_test([&]()
+                         {
+                             auto a = Specification::Lookup("test.spec")->Add("Log", log_args);
+                             auto b = Specification::Lookup("test.spec")->Add("Log", log_args);
+                             return TestResult("Identical specifications are shared", a == b);
+                         });
+
+    failures += run_test([&]()
+                         {
+                             auto a = Specification::Lookup("test.spec")->Add("Log", log_args);
+                             auto b = Specification::Lookup("test.spec")->Add("Log", log_args)->Add("Status", status_args);
+                             return TestResult("Signals of another group are not visible",
+                                               a != b
+                                                   && !a->GetType("Status")
+                                                   && a->GenerateIntrospection().find("Status") == std::string::npos
+                                                   && b->GetType("Status") && b->GetType("Log"));
+                         });
+
+    failures += run_test([&]()
+                         {
+                             auto a = Specification::Lookup("test.spec")->Add("Log", log_args);
+                             auto b = Specification::Lookup("test.other")->Add("Log", log_args);
+                             return TestResult("Other interface is not shared", a != b);
+                         });
+
+    failures += run_test([&]()
+                         {
+                             auto a = Specification::Lookup("test.spec")->Add("Log", log_args);
+                             auto b = Specification::Lookup("test.spec")->Add("Log", {{"msg", "s"}});
+                             return TestResult("Different arguments are not shared",
+                                               a != b
+                                                   && std::string("(s)") == b->GetType("Log")->str());
+                         });
+
+    failures += run_test([&]()
+                         {
+                             auto a = Specification::Lookup("test.spec")->Add("Log", log_args);
+                             return TestUtils::expect_exception<DBus::Signals::Exception>(
+                                 "Duplicated signal is rejected",
+                                 [a, log_args]()
+                                 {
+                                     (void)a->Add("Log", log_args);
+                                 },
+                                 "is already registered");
+                         });
+
+    return TestUtils::test_summary(failures);
+}
@@ -46,6 +46,7 @@ class Options : protected TestUtils::OptionParser
             {"expect-type",   required_argument, nullptr, 'X'},
             {"expect-result", required_argument, nullptr, 'x'},
             {"expect-count",  required_argument, nullptr, 'C'},
+            {"threaded",      no_argument,       nullptr, 'T'},
             {"quiet",         no_argument,       nullptr, 'q'},
             {"verbose",       no_argument,       nullptr, 'v'},
             {"help",          no_argument,       nullptr, 'h'},
@@ -59,7 +60,7 @@ class Options : protected TestUtils::OptionParser
         std::string object_path{};
         std::string object_interface{};
 
-        while ((opt = getopt_long(argc, argv, "YEd:p:i:s:X:x:C:qvh", long_opts, nullptr)) != -1)
+        while ((opt = getopt_long(argc, argv, "YEd:p:i:s:X:x:C:Tqvh", long_opts, nullptr)) != -1)
         {
             switch (opt)
             {
@@ -90,6 +91,9 @@ class Options : protected TestUtils::OptionParser
             case 'C':
                 check_count = ::atol(optarg);
                 break;
+            case 'T':
+                threaded = true;
+                break;
             case 'q':
                 quiet = true;
                 break;
@@ -136,6 +140,7 @@ class Options : protected TestUtils::OptionParser
     std::string check_type{};
     std::vector<std::string> check_value{};
     uint64_t check_count = 0;
+    bool threaded = false;
     bool quiet = false;
     bool verbose = false;
 };
@@ -229,12 +234,22 @@ int main(int argc, char **argv)
         auto sigmgr = Signals::SubscriptionManager::Create(dbuscon);
 
         auto mainloop = MainLoop::Create();
-        sigmgr->Subscribe(opts.target,
-                          opts.signal_name,
-                          [&opts, mainloop](Signals::Event::Ptr &event)
-                          {
-                              signal_handler(mainloop, opts, event);
-                          });
+        auto handler = [&opts, mainloop](Signals::Event::Ptr &event)
+        {
+            signal_handler(mainloop, opts, event);
+        };
+        if (opts.threaded)
+        {
+            // Keep all signals in order, without dropping any
+            Signals::DispatchOptions dispatch;
+            dispatch.max_queue = 0;
+            dispatch.ordered = true;
+            sigmgr->Subscribe(opts.target, opts.signal_name, handler, dispatch);
+        }
+        else
+        {
+            sigmgr->Subscribe(opts.target, opts.signal_name, handler);
+        }
 
         std::cout << "This process' unique D-Bus name:" << dbuscon->GetUniqueBusName() << std::endl;
         mainloop->Run();
@@ -15,9 +15,11 @@
  *
  */
 
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <limits>
+#include <thread>
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -91,6 +93,8 @@ class SimpleObject : public DBus::Object::Base
         : DBus::Object::Base(path, Constants::GenInterface("simple1.child")),
           object_manager(obj_mgr), my_path(path), my_name(name)
     {
+        // Process property reads in the request pool
+        AsyncPropertyAccess(true);
         AddProperty("my_path", my_path, false);
 
         auto getmyname_args = AddMethod("GetMyName",
@@ -101,6 +105,7 @@ class SimpleObject : public DBus::Object::Base
                                             args->SetMethodReturn(ret);
                                         });
         getmyname_args->AddOutput("name", "s");
+        getmyname_args->SetInline();
 
         AddMethod("RemoveMe",
                   [this](DBus::Object::Method::Arguments::Ptr args)
@@ -132,6 +137,47 @@ class SimpleObject : public DBus::Object::Base
 
 
 
+/**
+ *  Objects in the subtree registered via RegisterSubtree(), which are
+ *  only created when a D-Bus call arrives for them.  Only the node names
+ *  listed in SubtreeNode::Names exist.
+ *
+ *  Path:      /gdbuspp/tests/simple1/subtree/{name}
+ *  Interface: gdbuspp.test.simple1.subtree
+ */
+class SubtreeNode : public DBus::Object::Base
+{
+  public:
+    static inline const std::vector<std::string> Names{"node0", "node1", "node2"};
+
+    SubtreeNode(const DBus::Object::Path &path, const std::string &name)
+        : DBus::Object::Base(path, Constants::GenInterface("simple1.subtree")),
+          node_name(name)
+    {
+        // Use both the regular and the asynchronous property access
+        AsyncPropertyAccess("node1" == name);
+        AddProperty("node_name", node_name, false);
+
+        auto getmyname_args = AddMethod("GetMyName",
+                                        [this](DBus::Object::Method::Arguments::Ptr args)
+                                        {
+                                            args->SetMethodReturn(g_variant_new("(s)",
+                                                                                this->node_name.c_str()));
+                                        });
+        getmyname_args->AddOutput("name", "s");
+    }
+
+    const bool Authorize(const DBus::Authz::Request::Ptr req) override
+    {
+        return true;
+    }
+
+  private:
+    std::string node_name;
+};
+
+
+
 /**
  *  Separate object to test various property interfaces in
  *  DBus::Object::Property
@@ -163,6 +209,10 @@ class PropertyTests : public DBus::Object::Base
         AddProperty("ulonglong_val", ulonglong_val, true);
         AddProperty("bool_val", bool_val, true);
 
+        // Serialize the array values only when they have been changed
+        CachePropertyValue("string_array");
+        CachePropertyValue("uint_array");
+
 
         //  These two lambda functions wraps the call to methods in this
         //  object to read and update a more complex property data type.
@@ -320,8 +370,12 @@ class MethodTests : public DBus::Object::Base
           object_manager(obj_mgr_), log(log_)
     {
         DisableIdleDetector(true);
+        EnableAuthorizationCache(std::chrono::seconds(5));
         RegisterSignals(log);
 
+        // Process the method calls to this object one at a time
+        SerializeRequests(true);
+
         // Just a simple D-Bus method not requiring any input arguments nor
         // giving anything back to the caller.
         AddMethod("MethodNoArgs",
@@ -344,6 +398,39 @@ class MethodTests : public DBus::Object::Base
         stringlen_args->AddOutput("length", "i");
 
 
+        //  Same as StringLength, but the reply is deferred and sent
+        //  from a separate thread after the callback has returned
+        auto deferred_stringlen_args = AddMethod(
+            "DeferredStringLength",
+            [](DBus::Object::Method::Arguments::Ptr args)
+            {
+                GVariant *params = args->GetMethodParameters();
+                auto str = glib2::Value::Extract<std::string>(params, 0);
+                auto reply = args->Defer();
+                std::thread(
+                    [reply, str]()
+                    {
+                        int len = static_cast<int>(str.length());
+                        reply->Return(glib2::Value::CreateTupleWrapped(len));
+                    })
+                    .detach();
+            });
+        deferred_stringlen_args->AddInput("string", "s");
+        deferred_stringlen_args->AddOutput("length", "i");
+
+        //  Returns the received bytes in reverse order, passing them
+        //  as raw bytes without decoding the byte array
+        AddRawMethod("RawReverse",
+                     [](const std::string &caller, GBytes *data) -> GBytes *
+                     {
+                         gsize size = 0;
+                         auto bytes = static_cast<const guint8 *>(g_bytes_get_data(data, &size));
+                         std::string reversed(bytes, bytes + size);
+                         std::reverse(reversed.begin(), reversed.end());
+                         return g_bytes_new(reversed.data(), reversed.size());
+                     });
+
+
         //  Return the bus name of the caller back to the caller.  This is
         //  used so the proxy test program can check if that matches the
         //  assigned bus name of the calling client
@@ -353,6 +440,8 @@ class MethodTests : public DBus::Object::Base
                                              args->SetMethodReturn(glib2::Value::CreateTupleWrapped(args->GetCallerBusName()));
                                          });
         get_caller_args->AddOutput("caller_busname", glib2::DataType::DBus<std::string>());
+        // Cheap lookup; don't let it wait behind slower method calls
+        get_caller_args->SetPriority(DBus::AsyncProcess::Priority::HIGH);
 
 
         //  This creates a new child object, as defined in the SimpleObject class
@@ -382,6 +471,15 @@ class MethodTests : public DBus::Object::Base
                                     });
         rmobj_args->AddInput("name", "s");
 
+        //  Removes a child object and all objects below it in one go
+        auto rmobjs_args = AddMethod("RemoveSimpleObjectsUnder",
+                                     [this](DBus::Object::Method::Arguments::Ptr args)
+                                     {
+                                         this->RemoveSimpleObjectsUnder(args);
+                                     });
+        rmobjs_args->AddInput("name", "s");
+        rmobjs_args->AddOutput("removed", "u");
+
 
         auto get_removd_objs_args = AddMethod(
             "GetRemovedObjects",
@@ -421,6 +519,20 @@ class MethodTests : public DBus::Object::Base
         fstat_args->AddOutput("size", "t");
         fstat_args->PassFileDescriptor(DBus::Object::Method::PassFDmode::RECEIVE);
 
+        //  This method receives any number of file descriptors from the caller
+        //  and sends them all back again, in the same order.  This is for
+        //  testing passing several file descriptors in both directions
+        //  in a single D-Bus method call
+        auto echofds_args = AddMethod("EchoFDs",
+                                      [](DBus::Object::Method::Arguments::Ptr args)
+                                      {
+                                          const std::vector<int> fds = args->ReceiveFDs();
+                                          args->SendFDs(fds);
+                                          args->SetMethodReturn(g_variant_new("(u)", fds.size()));
+                                      });
+        echofds_args->AddOutput("count", "u");
+        echofds_args->PassFileDescriptor(DBus::Object::Method::PassFDmode::BOTH);
+
         Log(__func__, "Initialized");
     }
 
@@ -515,6 +627,26 @@ class MethodTests : public DBus::Object::Base
     }
 
 
+    void RemoveSimpleObjectsUnder(DBus::Object::Method::Arguments::Ptr args)
+    {
+        std::cout << "[RemoveSimpleObjectsUnder call] " << args << std::endl;
+
+        GVariant *params = args->GetMethodParameters();
+        std::string name = glib2::Value::Extract<std::string>(params, 0);
+        if (name.empty() || "/" == name)
+        {
+            throw DBus::Object::Exception("Path cannot be empty");
+        }
+
+        const std::string path = Constants::GenPath("simple1/childs/") + name;
+        size_t removed = object_manager->RemoveObjectsUnder(path);
+        std::cout << ">>> DELETED " << removed << " OBJECTS UNDER: " << path << std::endl;
+        Log(__func__, std::to_string(removed) + " child objects removed under " + path);
+
+        args->SetMethodReturn(g_variant_new("(u)", static_cast<uint32_t>(removed)));
+    }
+
+
 
     void OpenFile(DBus::Object::Method::Arguments::Ptr args)
     {
@@ -581,6 +713,17 @@ class MethodTests : public DBus::Object::Base
  */
 class FailingMethodTests : public DBus::Object::Base
 {
+    class CustomException : public DBus::Object::Method::Exception
+    {
+      public:
+        CustomException(const std::string &domain, const std::string &msg)
+            : DBus::Object::Method::Exception(msg)
+        {
+            error_domain = domain;
+        }
+    };
+
+
   public:
     FailingMethodTests()
         : DBus::Object::Base(Constants::GenPath("simple1/method_failures"),
@@ -629,6 +772,18 @@ class FailingMethodTests : public DBus::Object::Base
                                         args->SetMethodReturn(nullptr);
                                     });
         no_send_fd->PassFileDescriptor(DBus::Object::Method::PassFDmode::RECEIVE);
+
+
+        //  Fails with the error domain and message given by the caller
+        auto custom_error = AddMethod("CustomError",
+                                      [](DBus::Object::Method::Arguments::Ptr args)
+                                      {
+                                          GVariant *p = args->GetMethodParameters();
+                                          throw CustomException(glib2::Value::Extract<std::string>(p, 0),
+                                                                glib2::Value::Extract<std::string>(p, 1));
+                                      });
+        custom_error->AddInput("domain", "s");
+        custom_error->AddInput("message", "s");
     }
 
     const bool Authorize(const DBus::Authz::Request::Ptr request) override
@@ -652,11 +807,31 @@ class SimpleHandler : public DBus::Object::Base
         log = DBus::Signals::Group::Create<SimpleLog>(conn);
         RegisterSignals(log);
         log->AddTarget("");
+        log->RetainLastValue("Log");
+        AddLastValuesMethod();
 
         property_tests = object_mgr->CreateObject<PropertyTests>(log);
         method_tests = object_mgr->CreateObject<MethodTests>(object_mgr, log);
         failing_meths = object_mgr->CreateObject<FailingMethodTests>();
 
+        const DBus::Object::Path subtree_root = Constants::GenPath("simple1/subtree");
+        object_mgr->RegisterSubtree(
+            subtree_root,
+            [subtree_root](const DBus::Object::Path &path) -> DBus::Object::Base::Ptr
+            {
+                const std::string name = path.substr(subtree_root.size() + 1);
+                const auto &names = SubtreeNode::Names;
+                if (std::find(names.begin(), names.end(), name) == names.end())
+                {
+                    return nullptr;
+                }
+                return DBus::Object::Base::Create<SubtreeNode>(path, name);
+            },
+            []()
+            {
+                return SubtreeNode::Names;
+            });
+
         AddProperty("version", version, false);
 
         log->Log("SimpleHandler", "Handler is initialized");
@@ -734,7 +909,9 @@ class SimpleService : public DBus::Service
 {
   public:
     SimpleService(DBus::Connection::Ptr con)
-        : DBus::Service(con, Constants::GenServiceName("simple"))
+        : DBus::Service(con,
+                        Constants::GenServiceName("simple"),
+                        DBus::Service::Startup::DEFERRED)
     {
     }
 
@@ -744,7 +921,12 @@ class SimpleService : public DBus::Service
     //  is registered on the D-Bus connection
     void BusNameAcquired(const std::string &busname) override
     {
-        std::cout << "Bus name acquired: " << busname << std::endl;
+        auto timings = GetStartupTimings();
+        std::cout << "Bus name acquired: " << busname
+                  << " (build: " << timings.build.count() << "us"
+                  << ", registration: " << timings.registration.count() << "us"
+                  << ", name acquisition: " << timings.name_acquisition.count() << "us)"
+                  << std::endl;
     }
 
     //  This callback method will be called if the D-Bus service for some reason
@@ -844,6 +1026,25 @@ class SimpleService : public DBus::Service
         {
             throw DBus::Exception("InternalTests", "GetAllObject failed");
         }
+
+        std::cout << "   Validating DBus::Object::Manager::ForEachObject()" << std::endl;
+        size_t visited = 0;
+        object_mgr->ForEachObject(
+            [&check, &visited, &failed](const DBus::Object::Path &obj_path,
+                                        DBus::Object::Base::Ptr obj)
+            {
+                const auto chk = check.find(obj_path);
+                if (check.end() == chk || !compare_shared_ptr_obj(obj, chk->second))
+                {
+                    std::cout << "       - " << obj_path << " ... MATCH FAILED" << std::endl;
+                    failed = true;
+                }
+                ++visited;
+            });
+        if (failed || visited != check.size())
+        {
+            throw DBus::Exception("InternalTests", "ForEachObject failed");
+        }
         std::cout << "** Internal tests PASSED" << std::endl
                   << std::endl;
     }
@@ -860,6 +1061,12 @@ int main(int argc, char **argv)
         // Create a new service object - SimpleService
         auto simple_service = DBus::Service::Create<SimpleService>(dbuscon);
 
+        // Announce all objects via org.freedesktop.DBus.ObjectManager
+        simple_service->GetObjectManager()->EnableObjectManager("/gdbuspp/tests");
+
+        // Allow running several calls in a single batch request
+        simple_service->GetObjectManager()->EnableBatchInterface();
+
         // Create a new "root object", handling all the initial requests
         // This root object is the ServiceHandler; which can create child
         // objects with different functionality
@@ -0,0 +1,247 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file   stream-ring.cpp
+ *
+ * @brief  Tests the DBus::Stream shared memory ring buffer between a
+ *         Stream::Producer and a Stream::Consumer.  The file descriptors
+ *         are passed directly; this does not use any D-Bus connection.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../gdbuspp/stream.hpp"
+#include "test-utils.hpp"
+
+using TestUtils::run_test;
+using TestUtils::TestResult;
+
+
+static DBus::Stream::Consumer::Ptr attach(DBus::Stream::Producer::Ptr producer)
+{
+    std::vector<int> fds = producer->DuplicateFDs();
+    auto consumer = DBus::Stream::Consumer::Create(fds[0], fds[1]);
+    for (int fd : fds)
+    {
+        close(fd);
+    }
+    return consumer;
+}
+
+
+/**
+ *  Write records in order and check they are read back unmodified
+ */
+static bool test_records()
+{
+    auto producer = DBus::Stream::Producer::Create(4096);
+    auto consumer = attach(producer);
+
+    std::vector<std::string> written;
+    std::vector<std::string> read;
+    auto collect = [&read](const uint8_t *data, size_t size)
+    {
+        read.emplace_back(reinterpret_cast<const char *>(data), size);
+    };
+
+    // Several rounds, to wrap around the end of the data area
+    for (int round = 0; round < 20; ++round)
+    {
+        for (int i = 0; i < 10; ++i)
+        {
+            std::string rec = "record " + std::to_string(round) + "/" + std::to_string(i)
+                              + std::string(i * 13, 'x');
+            if (!producer->Write(rec))
+            {
+                return false;
+            }
+            written.push_back(rec);
+        }
+        if (!consumer->Wait(0) || consumer->Read(collect) != 10)
+        {
+            return false;
+        }
+    }
+    return written == read
+           && consumer->Read(collect) == 0
+           && consumer->GetDropped() == 0;
+}
+
+
+/**
+ *  Records which do not fit are dropped and counted
+ */
+static bool test_full()
+{
+    auto producer = DBus::Stream::Producer::Create(4096);
+    auto consumer = attach(producer);
+
+    const std::string rec(100, 'a');
+    size_t accepted = 0;
+    for (int i = 0; i < 100; ++i)
+    {
+        accepted += producer->Write(rec) ? 1 : 0;
+    }
+    const bool too_large = !producer->Write(std::string(4096, 'b'));
+
+    size_t count = consumer->Read([](const uint8_t *, size_t) {});
+    return accepted > 0 && accepted < 100
+           && too_large
+           && count == accepted
+           && consumer->GetDropped() == 100 - accepted + 1
+           && producer->Write(rec);
+}
+
+
+/**
+ *  A consumer waiting in another thread is woken up and sees the
+ *  stream closing once all records have been read
+ */
+static bool test_wakeup_close()
+{
+    auto producer = DBus::Stream::Producer::Create();
+    auto consumer = attach(producer);
+
+    const size_t records = 100000;
+    size_t count = 0;
+    uint64_t sum = 0;
+    std::thread reader([&]()
+                       {
+                           while (!consumer->IsClosed())
+                           {
+                               consumer->Wait(1000);
+                               count += consumer->Read(
+                                   [&sum](const uint8_t *data, size_t size)
+                                   {
+                                       sum += std::stoull(std::string(reinterpret_cast<const char *>(data), size));
+                                   });
+                           }
+                       });
+
+    uint64_t expected = 0;
+    for (size_t i = 0; i < records; ++i)
+    {
+        while (!producer->Write(std::to_string(i)))
+        {
+            std::this_thread::yield();
+        }
+        expected += i;
+    }
+    producer->Close();
+    reader.join();
+
+    return count == records
+           && sum == expected
+           && !producer->Write("closed");
+}
+
+
+/**
+ *  A consumer modifying the shared ring buffer header cannot make the
+ *  producer write outside of the data area
+ */
+static bool test_untrusted_consumer()
+{
+    auto producer = DBus::Stream::Producer::Create(4096);
+    std::vector<int> fds = producer->DuplicateFDs();
+    struct stat st = {};
+    fstat(fds[0], &st);
+    const size_t size = static_cast<size_t>(st.st_size);
+    void *m = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+    for (int fd : fds)
+    {
+        close(fd);
+    }
+    if (MAP_FAILED == m)
+    {
+        return false;
+    }
+
+    // Ring header layout: capacity at offset 8, consumer tail at offset 128
+    auto hdr = static_cast<uint8_t *>(m);
+    bool ok = true;
+    for (const uint64_t tail : {uint64_t(0xdeadbeef12345), uint64_t(4093), ~uint64_t(0)})
+    {
+        const uint64_t capacity = uint64_t(1) << 40;
+        std::memcpy(hdr + 8, &capacity, sizeof(capacity));
+        std::memcpy(hdr + 128, &tail, sizeof(tail));
+        for (int i = 0; i < 100; ++i)
+        {
+            (void)producer->Write(std::string(1000, 'x'));
+        }
+        ok &= (producer->GetCapacity() == 4096);
+    }
+    munmap(m, size);
+    return ok;
+}
+
+
+int main()
+{
+    int failures = 0;
+
+    failures += run_test([]()
+                         {
+                             return TestResult("Records are read in order", test_records());
+                         });
+    failures += run_test([]()
+                         {
+                             return TestResult("Full ring buffer drops records", test_full());
+                         });
+    failures += run_test([]()
+                         {
+                             return TestResult("Consumer wakeup and close", test_wakeup_close());
+                         });
+    failures += run_test([]()
+                         {
+                             return TestResult("Untrusted consumer header", test_untrusted_consumer());
+                         });
+
+    failures += run_test([]()
+                         {
+                             return TestUtils::expect_exception<DBus::Stream::Exception>(
+                                 "Unsealed memfd is rejected",
+                                 []()
+                                 {
+                                     int fd = memfd_create("test", MFD_CLOEXEC);
+                                     try
+                                     {
+                                         (void)DBus::Stream::Consumer::Create(fd, -1);
+                                     }
+                                     catch (...)
+                                     {
+                                         close(fd);
+                                         throw;
+                                     }
+                                     close(fd);
+                                 },
+                                 "Stream memfd is not sealed");
+                         });
+
+    failures += run_test([]()
+                         {
+                             return TestUtils::expect_exception<DBus::Stream::Exception>(
+                                 "Oversized capacity is rejected",
+                                 []()
+                                 {
+                                     (void)DBus::Stream::Producer::Create(SIZE_MAX);
+                                 },
+                                 "Stream capacity too large");
+                         });
+
+    return TestUtils::test_summary(failures);
+}
@@ -0,0 +1,264 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file   subtree-calls.cpp
+ *
+ * @brief  Tests the lifetime of the objects in a subtree registered via
+ *         DBus::Object::Manager::RegisterSubtree(), when glib2 calls the
+ *         object several times for a single D-Bus call (GetAll) or
+ *         rejects the call without calling the object at all.  The
+ *         service runs in a separate thread of this test.  This needs a
+ *         session bus.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glib.h>
+
+#include "../gdbuspp/authz-request.hpp"
+#include "../gdbuspp/connection.hpp"
+#include "../gdbuspp/object/base.hpp"
+#include "../gdbuspp/object/manager.hpp"
+#include "../gdbuspp/proxy.hpp"
+#include "../gdbuspp/service.hpp"
+#include "test-constants.hpp"
+#include "test-utils.hpp"
+
+using namespace DBus;
+using namespace Test;
+using TestUtils::run_test;
+using TestUtils::TestResult;
+
+
+/**
+ *  Collects the names of the released subtree objects
+ */
+class Released
+{
+  public:
+    void Add(const std::string &name)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        names.insert(name);
+    }
+
+    bool Contains(const std::string &name)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        return names.find(name) != names.end();
+    }
+
+  private:
+    std::mutex mtx{};
+    std::set<std::string> names{};
+};
+
+static Released released;
+
+
+/**
+ *  Subtree object with more than one readable property.  The "async"
+ *  node uses the asynchronous property access.
+ */
+class SubtreeNode : public Object::Base
+{
+  public:
+    static inline const std::vector<std::string> Names{"node", "async", "rejected"};
+
+    SubtreeNode(const Object::Path &path, const std::string &name_)
+        : Object::Base(path, Constants::GenInterface("subtree")),
+          name(name_)
+    {
+        AsyncPropertyAccess("async" == name);
+        AddProperty("name", name, false);
+        AddProperty("length", length, false);
+        AddProperty("counter", counter, true);
+
+        auto args = AddMethod("GetName",
+                              [this](Object::Method::Arguments::Ptr args)
+                              {
+                                  args->SetMethodReturn(g_variant_new("(s)", name.c_str()));
+                              });
+        args->AddOutput("name", "s");
+    }
+
+    ~SubtreeNode() noexcept
+    {
+        released.Add(name);
+    }
+
+    const bool Authorize(const Authz::Request::Ptr request) override
+    {
+        return true;
+    }
+
+  private:
+    std::string name;
+    uint32_t length = static_cast<uint32_t>(name.size());
+    uint32_t counter = 0;
+};
+
+
+class SubtreeService : public Service
+{
+  public:
+    SubtreeService(Connection::Ptr conn)
+        : Service(conn, Constants::GenServiceName("subtree"))
+    {
+    }
+
+    void BusNameAcquired(const std::string &busname) override
+    {
+        acquired = true;
+    }
+
+    void BusNameLost(const std::string &busname) override
+    {
+        Stop();
+    }
+
+    std::atomic<bool> acquired{false};
+};
+
+
+/**
+ *  Check if a D-Bus call fails
+ *
+ * @param call  Function doing the D-Bus call
+ *
+ * @return true if a DBus::Proxy::Exception was thrown
+ */
+template <typename F>
+static bool rejected(F &&call)
+{
+    try
+    {
+        call();
+    }
+    catch (const Proxy::Exception &)
+    {
+        return true;
+    }
+    return false;
+}
+
+
+int main()
+{
+    int failures = 0;
+    try
+    {
+        const Object::Path root = Constants::GenPath("subtree");
+        const std::string interface = Constants::GenInterface("subtree");
+
+        auto srvconn = Connection::Create(BusType::SESSION);
+        auto service = Service::Create<SubtreeService>(srvconn);
+        service->GetObjectManager()->RegisterSubtree(
+            root,
+            [root](const Object::Path &path) -> Object::Base::Ptr
+            {
+                const std::string name = path.substr(root.size() + 1);
+                const auto &names = SubtreeNode::Names;
+                if (std::find(names.begin(), names.end(), name) == names.end())
+                {
+                    return nullptr;
+                }
+                return Object::Base::Create<SubtreeNode>(path, name);
+            });
+
+        std::thread srvthread([service]()
+                              {
+                                  service->Run();
+                              });
+        for (int i = 0; i < 500 && !service->acquired; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        auto conn = Connection::CreateExclusive(BusType::SESSION);
+        auto prx = Proxy::Client::Create(conn, Constants::GenServiceName("subtree"));
+
+        for (const std::string node : {"node", "async"})
+        {
+            failures += run_test([prx, root, interface, node]()
+                                 {
+                                     bool ok = true;
+                                     for (int i = 0; i < 5; ++i)
+                                     {
+                                         GVariant *r = prx->GetAllProperties(root + "/" + node, interface);
+                                         ok &= (3 == g_variant_n_children(r));
+                                         g_variant_unref(r);
+                                     }
+                                     return TestResult("GetAll on the '" + node + "' subtree node",
+                                                       ok);
+                                 });
+        }
+
+        const Object::Path rejected_path = root + "/rejected";
+        failures += run_test([prx, rejected_path, interface]()
+                             {
+                                 bool ok = rejected([&]()
+                                                    {
+                                                        GVariant *r = prx->Call(rejected_path, interface, "NoSuchMethod");
+                                                        g_variant_unref(r);
+                                                    });
+                                 ok &= rejected([&]()
+                                                {
+                                                    GVariant *r = prx->GetPropertyGVariant(rejected_path, interface, "no_such_property");
+                                                    g_variant_unref(r);
+                                                });
+                                 ok &= rejected([&]()
+                                                {
+                                                    prx->SetPropertyGVariant(rejected_path,
+                                                                             interface,
+                                                                             "name",
+                                                                             g_variant_new_string("renamed"));
+                                                });
+                                 return TestResult("Calls rejected by glib2 fail", ok);
+                             });
+
+        failures += run_test([prx, rejected_path, interface]()
+                             {
+                                 GVariant *r = prx->Call(rejected_path, interface, "GetName");
+                                 const std::string name = glib2::Value::Extract<std::string>(r, 0);
+                                 g_variant_unref(r);
+                                 return TestResult("Subtree node is usable after rejected calls",
+                                                   "rejected" == name);
+                             });
+
+        failures += run_test([prx, root, interface]()
+                             {
+                                 // Objects are evicted by a later call, after
+                                 // not being used for 5 seconds
+                                 std::this_thread::sleep_for(std::chrono::milliseconds(5500));
+                                 GVariant *r = prx->Call(root + "/node", interface, "GetName");
+                                 g_variant_unref(r);
+                                 return TestResult("Subtree nodes are released after rejected calls",
+                                                   released.Contains("rejected")
+                                                       && released.Contains("async"));
+                             });
+
+        service->Stop();
+        srvthread.join();
+    }
+    catch (const DBus::Exception &excp)
+    {
+        std::cerr << "** EXCEPTION **  " << excp.what() << std::endl;
+        return 3;
+    }
+
+    return TestUtils::test_summary(failures);
+}
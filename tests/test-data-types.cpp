@@ -15,12 +15,17 @@
 
 #include <iostream>
 #include <string>
+#include <unordered_map>
 #include "../gdbuspp/connection.hpp"
 #include "../gdbuspp/glib2/utils.hpp"
 #include "../gdbuspp/object/path.hpp"
 #include "../gdbuspp/proxy.hpp"
 
 #include "test-constants.hpp"
+#include "test-utils.hpp"
+
+using TestUtils::run_test;
+using TestUtils::TestResult;
 
 /**
  *  Checks the values hardcoded dictionary in net.openvpn.gdbuspp.test.simple
@@ -101,18 +106,6 @@ bool test_dictionary(DBus::Proxy::Client::Ptr prx)
 }
 
 
-struct TestResult
-{
-    TestResult(const std::string &msg, const bool res)
-        : result(res), message(msg)
-    {
-    }
-
-    const bool result;
-    const std::string message;
-};
-
-
 template <typename T>
 TestResult check_data_type_cpp(const std::string &type_str,
                                T &value,
@@ -200,14 +193,6 @@ TestResult compare_vector(const std::string &msg,
 }
 
 
-template <typename FUNC>
-inline int run_test(FUNC &&testfunc)
-{
-    TestResult test = testfunc();
-    std::cout << test.message << ": " << (test.result ? "Pass" : "FAIL") << std::endl;
-    return (test.result ? 0 : 1);
-}
-
 int test_base_data_types()
 {
     std::cout << ":: Testing base data types ..." << std::endl;
@@ -313,6 +298,15 @@ int test_base_data_types()
                                  "o");
                          });
 
+    failures += run_test([]()
+                         {
+                             std::map<std::string, std::vector<std::tuple<uint32_t, std::optional<std::string>>>> type_c;
+                             return check_data_type_cpp(
+                                 "std::map<std::string, std::vector<std::tuple<uint32_t, std::optional<std::string>>>>",
+                                 type_c,
+                                 "a{sa(uas)}");
+                         });
+
     failures += run_test([]()
                          {
                              bool res = false;
@@ -370,6 +364,205 @@ int test_base_data_types()
                                                res);
                          });
 
+    failures += run_test([]()
+                         {
+                             DBus::Object::Path path = "/hello/world";
+                             DBus::Object::InternedPath a(path);
+                             DBus::Object::InternedPath b("/hello/world");
+                             DBus::Object::InternedPath c("/hello/other");
+                             const DBus::Object::Path &ref = a;
+                             bool res = (a == b && a != c
+                                         && a.Hash() == b.Hash()
+                                         && &a.GetPath() == &b.GetPath()
+                                         && ref == path
+                                         && DBus::Object::InternedPath::Find(path) == a
+                                         && DBus::Object::InternedPath::Find("/not/interned").empty());
+
+                             std::unordered_map<DBus::Object::InternedPath, int> index{};
+                             index[a] = 1;
+                             index[c] = 2;
+                             res = res && index.at(b) == 1 && index.size() == 2;
+                             return TestResult("DBus::Object::InternedPath", res);
+                         });
+
+    failures += run_test([]()
+                         {
+                             bool released = false;
+                             {
+                                 DBus::Object::InternedPath tmp("/interned/released");
+                             }
+                             released = DBus::Object::InternedPath::Find("/interned/released").empty();
+                             return TestResult("DBus::Object::InternedPath [released]",
+                                               released);
+                         });
+
+    failures += run_test([]()
+                         {
+                             struct MappedConfig
+                             {
+                                 std::string name{};
+                                 uint32_t port = 0;
+                                 bool enabled = false;
+                                 std::vector<std::string> tags{};
+                             };
+                             glib2::Value::Dict::Mapping<MappedConfig> map;
+                             map.Field("name", &MappedConfig::name)
+                                 .Field("port", &MappedConfig::port)
+                                 .Field("enabled", &MappedConfig::enabled)
+                                 .Field("tags", &MappedConfig::tags);
+                             auto copy = map;
+
+                             MappedConfig src{"mapped", 1194, true, {"a", "b"}};
+                             GVariant *dict = g_variant_ref_sink(map.Encode(src));
+                             MappedConfig dst = copy.Decode(dict);
+                             bool res = (dst.name == "mapped"
+                                         && dst.port == 1194
+                                         && dst.enabled
+                                         && dst.tags == src.tags
+                                         && glib2::Value::Dict::Lookup<uint32_t>(dict, "port") == 1194);
+
+                             // GetAll results are wrapped in a (a{sv}) tuple
+                             GVariant *getall = g_variant_ref_sink(g_variant_new("(@a{sv})", dict));
+                             MappedConfig wrapped{};
+                             map.Decode(getall, wrapped);
+                             res = res && wrapped.name == "mapped" && wrapped.port == 1194;
+                             g_variant_unref(getall);
+                             g_variant_unref(dict);
+                             return TestResult("glib2::Value::Dict::Mapping", res);
+                         });
+
+    failures += run_test([]()
+                         {
+                             struct MappedConfig
+                             {
+                                 std::string name{};
+                                 uint32_t port = 0;
+                             };
+                             glib2::Value::Dict::Mapping<MappedConfig> map;
+                             map.Field("name", &MappedConfig::name)
+                                 .Field("port", &MappedConfig::port);
+
+                             GVariantBuilder *b = glib2::Builder::Create("a{sv}");
+                             g_variant_builder_add(b, "{sv}", "name", g_variant_new_string("partial"));
+                             g_variant_builder_add(b, "{sv}", "unknown", g_variant_new_int32(1));
+                             GVariant *dict = g_variant_ref_sink(glib2::Builder::Finish(b));
+                             MappedConfig cfg{"default", 42};
+                             map.Decode(dict, cfg);
+                             bool res = (cfg.name == "partial" && cfg.port == 42);
+                             g_variant_unref(dict);
+
+                             b = glib2::Builder::Create("a{sv}");
+                             g_variant_builder_add(b, "{sv}", "port", g_variant_new_string("1194"));
+                             dict = g_variant_ref_sink(glib2::Builder::Finish(b));
+                             try
+                             {
+                                 map.Decode(dict);
+                                 res = false;
+                             }
+                             catch (const glib2::Utils::Exception &)
+                             {
+                             }
+                             g_variant_unref(dict);
+                             return TestResult("glib2::Value::Dict::Mapping [partial, wrong type]",
+                                               res);
+                         });
+
+    failures += run_test([]()
+                         {
+                             glib2::Variant empty;
+                             glib2::Variant v(g_variant_new_int32(5));
+                             bool res = (!empty && v && !g_variant_is_floating(v.get())
+                                         && v.GetTypeString() == "i");
+
+                             glib2::Variant copy = v.Copy();
+                             glib2::Variant moved = std::move(v);
+                             res = res && !v && moved.get() == copy.get();
+                             moved.reset();
+                             res = res && !moved && glib2::Value::Get<int32_t>(copy.get()) == 5;
+
+                             glib2::Variant tuple(g_variant_new("(si)", "value", 7));
+                             auto child = glib2::Value::Extract<glib2::Variant>(tuple.get(), 1);
+                             res = res && child.GetTypeString() == "i"
+                                   && glib2::Value::Get<int32_t>(child.get()) == 7;
+
+                             auto list = glib2::Value::ExtractVector<std::string>(
+                                 glib2::Variant(glib2::Value::CreateTupleWrapped(
+                                     std::vector<std::string>{"a", "b"})));
+                             res = res && list.size() == 2 && list[1] == "b";
+                             return TestResult("glib2::Variant", res);
+                         });
+
+    failures += run_test([]()
+                         {
+                             glib2::Builder::Scoped b("a{sv}");
+                             b.AddFormatted("{sv}", "name", g_variant_new_string("value"))
+                                 .AddFormatted("{sv}", "count", g_variant_new_uint32(2));
+                             glib2::Variant dict(b.Finish());
+                             bool res = dict.GetTypeString() == "a{sv}"
+                                        && g_variant_n_children(dict.get()) == 2;
+
+                             glib2::Builder::Scoped list("as");
+                             list.Add(std::string("a")).Add(std::string("b"));
+                             glib2::Variant wrapped(list.FinishWrapped());
+                             res = res && wrapped.GetTypeString() == "(as)";
+
+                             // Released without being completed
+                             glib2::Builder::Scoped unused("ai");
+                             unused.Add(int32_t(1));
+
+                             bool invalid = false;
+                             try
+                             {
+                                 glib2::Builder::Scoped bad("a{");
+                             }
+                             catch (const glib2::Utils::Exception &)
+                             {
+                                 invalid = true;
+                             }
+                             return TestResult("glib2::Builder::Scoped", res && invalid);
+                         });
+
+    failures += run_test([]()
+                         {
+                             glib2::Variant tuple(g_variant_new("(si)", "borrowed", 3));
+                             std::string_view name = glib2::Value::Extract<std::string_view>(tuple.get(), 0);
+                             bool res = (name == "borrowed");
+
+                             glib2::Variant list(glib2::Value::CreateTupleWrapped(
+                                 std::vector<std::string>{"first", "second", ""}));
+                             auto views = glib2::Value::ExtractStringViews(list.Copy());
+
+                             // Serializing the container, as done when it
+                             // is sent, must not invalidate the views
+                             g_variant_get_data(list.get());
+                             list.reset();
+                             res = res && views.size() == 3 && views[0] == "first"
+                                   && views[1] == "second" && views[2].empty();
+
+                             bool mismatch = false;
+                             try
+                             {
+                                 glib2::Value::ExtractStringViews(std::move(tuple));
+                             }
+                             catch (const glib2::Utils::Exception &)
+                             {
+                                 mismatch = true;
+                             }
+
+                             bool not_string = false;
+                             try
+                             {
+                                 glib2::Variant ints(g_variant_new_parsed("([1, 2],)"));
+                                 glib2::Value::ExtractStringViews(std::move(ints), "i");
+                             }
+                             catch (const glib2::Utils::Exception &)
+                             {
+                                 not_string = true;
+                             }
+                             return TestResult("glib2::Value::ExtractStringViews",
+                                               res && mismatch && not_string);
+                         });
+
     //
     // GVariant tests
     //
@@ -464,6 +657,33 @@ int test_base_data_types()
                                  "o");
                          });
 
+    failures += run_test([]()
+                         {
+                             GBytes *data = g_bytes_new_static("\x01\x02\x03\x04", 4);
+                             GVariant *value = glib2::Value::Create(data);
+                             GBytes *res = glib2::Value::Get<GBytes *>(value);
+                             bool pass = g_bytes_equal(data, res)
+                                         && "ay" == glib2::DataType::Extract(value);
+                             g_bytes_unref(res);
+                             g_variant_unref(value);
+                             g_bytes_unref(data);
+                             return TestResult("glib2::Value::Create<GBytes *>(...) / Get<GBytes *>(...) - Expects identical data",
+                                               pass);
+                         });
+
+    failures += run_test([]()
+                         {
+                             using Record = std::tuple<std::string, std::map<std::string, int32_t>, std::optional<bool>>;
+                             std::vector<Record> data = {{"first", {{"a", 1}, {"b", -2}}, true},
+                                                         {"second", {}, std::nullopt}};
+                             GVariant *value = glib2::Value::Create(data);
+                             bool pass = ("a(sa{si}ab)" == glib2::DataType::Extract(value))
+                                         && (glib2::Value::Get<std::vector<Record>>(value) == data);
+                             g_variant_unref(value);
+                             return TestResult("glib2::Value::Create<std::vector<std::tuple<...>>>(...) / Get<...>(...) - Expects identical data",
+                                               pass);
+                         });
+
 
     failures += run_test([]()
                          {
@@ -747,11 +967,5 @@ int main(int argc, char **argv)
         failures += static_cast<int>(test_dictionary(prx));
     }
 
-    if (failures > 0)
-    {
-        std::cout << "OVERALL TEST RESULT:  FAIL "
-                  << "(" << failures << " tests failed) " << std::endl;
-        return 2;
-    }
-    return 0;
+    return TestUtils::test_summary(failures);
 }
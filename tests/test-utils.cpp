@@ -13,10 +13,13 @@
  *         and tools
  */
 
+#include <algorithm>
+#include <chrono>
 #include <exception>
 #include <iostream>
 #include <limits>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <getopt.h>
 #include <glib.h>
@@ -83,6 +86,115 @@ void OptionParser::help(const std::string argv0, struct option options[])
 }
 
 
+int parse_int_option(const std::string &option, const char *arg)
+{
+    try
+    {
+        size_t end = 0;
+        const int ret = std::stoi(arg, &end);
+        if (arg[end] == '\0')
+        {
+            return ret;
+        }
+    }
+    catch (const std::logic_error &)
+    {
+        // Reported below; std::invalid_argument and std::out_of_range
+    }
+    throw TestUtils::Exception(option, "Invalid integer value: '"
+                                           + std::string(arg) + "'");
+}
+
+
+
+void CallTargetOptions::init_options(const std::vector<struct option> &extra_long,
+                                     const std::string &extra_short)
+{
+    long_opts = {
+        // clang-format off
+        {"system",        no_argument,       nullptr, 'Y'},
+        {"session",       no_argument,       nullptr, 'E'},
+        {"destination",   required_argument, nullptr, 'd'},
+        {"object_path",   required_argument, nullptr, 'p'},
+        {"interface",     required_argument, nullptr, 'i'},
+        {"method-call",   required_argument, nullptr, 'm'},
+        {"data-type",     required_argument, nullptr, 't'},
+        {"data-value",    required_argument, nullptr, 'v'},
+        {"timeout",       required_argument, nullptr, 'T'},
+        // clang-format on
+    };
+    long_opts.insert(long_opts.end(), extra_long.begin(), extra_long.end());
+    long_opts.push_back({nullptr, 0, nullptr, 0});
+    short_opts = "YEd:p:i:m:t:v:T:" + extra_short;
+}
+
+
+bool CallTargetOptions::parse_call_target(const int opt, const char *arg)
+{
+    switch (opt)
+    {
+    case 'Y':
+        bustype = DBus::BusType::SYSTEM;
+        return true;
+    case 'E':
+        bustype = DBus::BusType::SESSION;
+        return true;
+    case 'd':
+        destination = std::string(arg);
+        return true;
+    case 'p':
+        object_path = DBus::Object::Path(arg);
+        return true;
+    case 'i':
+        object_interface = std::string(arg);
+        return true;
+    case 'm':
+        method = std::string(arg);
+        return true;
+    case 't':
+        data_type = std::string(arg);
+        return true;
+    case 'v':
+        data_values.push_back(std::string(arg));
+        return true;
+    case 'T':
+        call_options = DBus::Proxy::CallOptions::Create(
+            std::chrono::milliseconds(std::max(0, parse_int_option("--timeout", arg))));
+        return true;
+    default:
+        return false;
+    }
+}
+
+
+bool CallTargetOptions::missing_call_target(const bool need_method) const
+{
+    bool missing = false;
+    if (destination.empty())
+    {
+        std::cerr << "** ERROR **  Missing --destination" << std::endl;
+        missing = true;
+    }
+    if (object_path.empty())
+    {
+        std::cerr << "** ERROR **  Missing --object_path" << std::endl;
+        missing = true;
+    }
+    if (need_method && object_interface.empty())
+    {
+        std::cerr << "** ERROR **  Missing --interface" << std::endl;
+        missing = true;
+    }
+    if (need_method && method.empty())
+    {
+        std::cerr << "** ERROR **  Missing --method-call" << std::endl;
+        missing = true;
+    }
+    return missing;
+}
+
+
+
 void dump_gvariant(std::ostringstream &log, const std::string &prefix, GVariant *data)
 {
     log << prefix << " type: " << g_variant_get_type_string(data) << std::endl;
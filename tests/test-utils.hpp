@@ -15,10 +15,15 @@
 
 #pragma once
 
+#include <functional>
+#include <iostream>
 #include <string>
 #include <vector>
+#include <getopt.h>
 #include <glib.h>
 
+#include "../gdbuspp/proxy.hpp"
+
 namespace TestUtils {
 
 class Exception : public std::exception
@@ -48,6 +53,78 @@ class OptionParser
 };
 
 
+/**
+ *  Parse an integer command line option argument
+ *
+ * @param option  std::string with the option name, used in errors
+ * @param arg     C string with the option argument
+ * @return int
+ * @throws TestUtils::Exception if the argument is not an integer
+ */
+int parse_int_option(const std::string &option, const char *arg);
+
+
+/**
+ *  Command line options selecting a D-Bus method to call, shared by the
+ *  tools calling methods of any D-Bus service:
+ *
+ *    --system, --session, --destination, --object_path, --interface,
+ *    --method-call, --data-type, --data-value and --timeout
+ *
+ *  The tool adds its own options via init_options() and passes the
+ *  options it does not handle itself on to parse_call_target().
+ */
+class CallTargetOptions : protected OptionParser
+{
+  public:
+    DBus::BusType bustype = DBus::BusType::SESSION;
+    std::string destination{};
+    DBus::Object::Path object_path;
+    std::string object_interface{};
+    std::string method{};
+    std::string data_type{};
+    std::vector<std::string> data_values{};
+    DBus::Proxy::CallOptions::Ptr call_options = nullptr;
+
+    /**
+     *  Report the missing required call target options on stderr
+     *
+     * @param need_method  bool, set if --interface and --method-call
+     *                     are required too
+     * @return true if any required option is missing
+     */
+    bool missing_call_target(const bool need_method) const;
+
+  protected:
+    /// getopt_long() option table, terminated by an empty entry
+    std::vector<struct option> long_opts{};
+
+    /// getopt_long() short option string
+    std::string short_opts{};
+
+    /**
+     *  Prepare the option table with the call target options followed
+     *  by the tool specific options
+     *
+     * @param extra_long   std::vector<struct option> with the tool options
+     * @param extra_short  std::string with the tool short options
+     */
+    void init_options(const std::vector<struct option> &extra_long,
+                      const std::string &extra_short);
+
+    /**
+     *  Parse an option returned by getopt_long() if it is one of the
+     *  call target options
+     *
+     * @param opt  int with the option returned by getopt_long()
+     * @param arg  C string with the option argument, may be nullptr
+     * @return true if the option was handled
+     * @throws TestUtils::Exception if the option argument is invalid
+     */
+    bool parse_call_target(const int opt, const char *arg);
+};
+
+
 /**
  *  Dumps a human readable string of both the data type and value
  *  contained in a GVariant object.  This is just a wrapper around
@@ -141,4 +218,79 @@ GVariant *generate_gvariant(std::ostringstream &log,
                             const std::vector<std::string> &data_values,
                             bool wrap_single_value);
 
+
+/**
+ *  Result of a single test case, reported by run_test()
+ */
+struct TestResult
+{
+    TestResult(const std::string &msg, const bool res)
+        : result(res), message(msg)
+    {
+    }
+
+    const bool result;
+    const std::string message;
+};
+
+
+/**
+ *  Run a single test case and report the result
+ *
+ * @param testfunc  Function returning a TestResult
+ * @return int with the number of failed tests; 0 or 1
+ */
+template <typename FUNC>
+inline int run_test(FUNC &&testfunc)
+{
+    TestResult test = testfunc();
+    std::cout << test.message << ": " << (test.result ? "Pass" : "FAIL") << std::endl;
+    return (test.result ? 0 : 1);
+}
+
+
+/**
+ *  Check that a function throws a specific exception type with an error
+ *  message containing a given string
+ *
+ * @param msg          std::string describing the test
+ * @param testfunc     Function expected to throw
+ * @param error_match  std::string expected in the what() message
+ * @return TestResult
+ */
+template <typename EXCEPTION>
+inline TestResult expect_exception(const std::string &msg,
+                                   std::function<void()> &&testfunc,
+                                   const std::string &error_match)
+{
+    try
+    {
+        testfunc();
+        return TestResult(msg + " - no exception", false);
+    }
+    catch (const EXCEPTION &excp)
+    {
+        return TestResult(msg,
+                          std::string(excp.what()).find(error_match) != std::string::npos);
+    }
+}
+
+
+/**
+ *  Report the overall result of a test program
+ *
+ * @param failures  int with the number of failed tests
+ * @return int with the exit code of the test program
+ */
+inline int test_summary(const int failures)
+{
+    if (failures > 0)
+    {
+        std::cout << "OVERALL TEST RESULT:  FAIL "
+                  << "(" << failures << " tests failed) " << std::endl;
+        return 2;
+    }
+    return 0;
+}
+
 }; // namespace TestUtils
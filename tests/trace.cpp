@@ -0,0 +1,142 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file   trace.cpp
+ *
+ * @brief  Tests the DBus::Features::Trace facility; the levels per
+ *         category, the deferred formatting, Clear() and the reuse of the
+ *         ring buffers of exited threads.  This does not use any D-Bus
+ *         connection.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "../gdbuspp/features/trace.hpp"
+#include "test-utils.hpp"
+
+using namespace DBus::Features;
+using TestUtils::run_test;
+using TestUtils::TestResult;
+
+
+static std::string dump()
+{
+    std::ostringstream out;
+    Trace::Dump(out);
+    return out.str();
+}
+
+
+static bool contains(const std::string &str, const std::string &needle)
+{
+    return std::string::npos != str.find(needle);
+}
+
+
+int main()
+{
+    int failures = 0;
+
+    // Tracing of this test program may be enabled via the environment
+    Trace::SetLevel(Trace::Level::OFF);
+    Trace::SetEcho(false);
+
+    failures += run_test([]()
+                         {
+                             GDBUSPP_TRACE(GENERAL, ERROR, "Disabled event {}", 1);
+                             return TestResult("Nothing is recorded while disabled",
+                                               !contains(dump(), "Disabled event"));
+                         });
+
+    failures += run_test([]()
+                         {
+                             Trace::SetLevel(Trace::Category::PROXY, Trace::Level::INFO);
+                             GDBUSPP_TRACE(PROXY, INFO, "Proxy event: a={}, b={}", 42, 7);
+                             GDBUSPP_TRACE(PROXY, DEBUG, "Proxy debug event");
+                             GDBUSPP_TRACE(SIGNALS, INFO, "Signals event");
+                             const std::string out = dump();
+                             return TestResult("Events are recorded per category and level",
+                                               contains(out, "Proxy event: a=42, b=7")
+                                                   && !contains(out, "Proxy debug event")
+                                                   && !contains(out, "Signals event"));
+                         });
+
+    failures += run_test([]()
+                         {
+                             Trace::SetLevel(Trace::Level::OFF);
+                             Trace::Configure("signals:debug,bogus:info,proxy:bogus");
+                             return TestResult("Configure() parses category:level pairs",
+                                               Trace::Enabled(Trace::Category::SIGNALS, Trace::Level::DEBUG)
+                                                   && !Trace::Enabled(Trace::Category::PROXY, Trace::Level::ERROR)
+                                                   && !Trace::Enabled(Trace::Category::GENERAL, Trace::Level::ERROR));
+                         });
+
+    failures += run_test([]()
+                         {
+                             Trace::SetLevel(Trace::Level::DEBUG);
+                             Trace::Message(Trace::Category::GENERAL,
+                                            Trace::Level::DEBUG,
+                                            __FILE__,
+                                            __LINE__,
+                                            "Long message " + std::string(GDBUSPP_TRACE_MSG_LEN, 'x'));
+                             const std::string out = dump();
+                             return TestResult("Formatted messages are truncated",
+                                               contains(out, "Long message x")
+                                                   && !contains(out, std::string(GDBUSPP_TRACE_MSG_LEN, 'x')));
+                         });
+
+    failures += run_test([]()
+                         {
+                             Trace::Clear();
+                             GDBUSPP_TRACE(GENERAL, INFO, "After clear");
+                             const std::string out = dump();
+                             return TestResult("Clear() discards the earlier records",
+                                               !contains(out, "Proxy event")
+                                                   && contains(out, "After clear"));
+                         });
+
+    failures += run_test([]()
+                         {
+                             // The main thread has a ring already; the first
+                             // thread gets a new one, which the second reuses
+                             std::thread first([]()
+                                               {
+                                                   GDBUSPP_TRACE(GENERAL, INFO, "First thread");
+                                               });
+                             first.join();
+                             std::thread second([]()
+                                                {
+                                                    GDBUSPP_TRACE(GENERAL, INFO, "Second thread");
+                                                });
+                             second.join();
+
+                             const std::string out = dump();
+                             return TestResult("Rings of exited threads are kept and reused",
+                                               contains(out, "ring:1) ")
+                                                   && contains(out, "First thread")
+                                                   && contains(out, "Second thread")
+                                                   && !contains(out, "ring:2) "));
+                         });
+
+    failures += run_test([]()
+                         {
+                             GVariant *v = g_variant_ref_sink(g_variant_new_uint32(5));
+                             const std::string str = Trace::VariantString(v);
+                             g_variant_unref(v);
+                             return TestResult("VariantString()",
+                                               "uint32 5" == str
+                                                   && "(none)" == Trace::VariantString(nullptr));
+                         });
+
+    Trace::SetLevel(Trace::Level::OFF);
+    return TestUtils::test_summary(failures);
+}
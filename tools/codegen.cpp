@@ -0,0 +1,1055 @@
+//  GDBus++ - glib2 GDBus C++ wrapper
+//
+//  SPDX-License-Identifier: AGPL-3.0-only
+//
+//  Copyright (C)  OpenVPN Inc <sales@openvpn.net>
+//  Copyright (C)  David Sommerseth <davids@openvpn.net>
+//
+
+/**
+ * @file   codegen.cpp
+ *
+ * @brief  gdbuspp-codegen - generates typed C++ D-Bus proxy clients and
+ *         object skeletons from D-Bus introspection XML.
+ *
+ *         For each interface in the XML document, two classes are
+ *         generated:
+ *
+ *           - <Name>Proxy     typed methods and property accessors
+ *                             calling the D-Bus service via a
+ *                             DBus::Proxy::Client
+ *
+ *           - <Name>Skeleton  a DBus::Object::Base implementation
+ *                             declaring all the methods and properties,
+ *                             calling pure virtual methods implemented
+ *                             by a subclass
+ *
+ *         The GVariant values are built and parsed by generated code
+ *         for each D-Bus data type in use, without any D-Bus format
+ *         strings parsed at runtime.  The data type of each reply is
+ *         checked before it is parsed.
+ *
+ *         File descriptors (h) are not supported, as the generated
+ *         proxies do not pass any file descriptor lists.
+ *
+ *  $ gdbuspp-codegen --namespace net::example --output example.hpp example.xml
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include <gio/gio.h>
+
+
+class CodegenException : public std::runtime_error
+{
+  public:
+    CodegenException(const std::string &err)
+        : std::runtime_error(err)
+    {
+    }
+};
+
+
+
+/**
+ *  Information about a single D-Bus argument or property
+ */
+struct Argument
+{
+    std::string name;
+    std::string signature;
+};
+
+
+
+/**
+ *  Maps D-Bus data types to C++ data types and generates the
+ *  marshalling helper functions for each of the data types in use
+ *  by an interface.
+ */
+class TypeMapper
+{
+  public:
+    /**
+     *  Declare a D-Bus data type as used, including all the data
+     *  types it contains
+     *
+     * @param sig  std::string with a single complete D-Bus data type
+     * @throws CodegenException if the data type is not supported
+     */
+    void Use(const std::string &sig)
+    {
+        if (std::find(used.begin(), used.end(), sig) != used.end())
+        {
+            return;
+        }
+        for (const auto &child : children(sig))
+        {
+            Use(child);
+        }
+        (void)CppType(sig);
+        used.push_back(sig);
+    }
+
+
+    /**
+     *  Retrieve the C++ data type representing a D-Bus data type
+     *
+     * @param sig  std::string with a single complete D-Bus data type
+     * @return std::string
+     * @throws CodegenException if the data type is not supported
+     */
+    std::string CppType(const std::string &sig) const
+    {
+        static const std::map<char, std::string> basic = {
+            {'y', "uint8_t"},
+            {'b', "bool"},
+            {'n', "int16_t"},
+            {'q', "uint16_t"},
+            {'i', "int32_t"},
+            {'u', "uint32_t"},
+            {'x', "int64_t"},
+            {'t', "uint64_t"},
+            {'d', "double"},
+            {'s', "std::string"},
+            {'o', "DBus::Object::Path"},
+            {'g', "std::string"},
+            {'v', "GVariant *"}};
+
+        if (1 == sig.size())
+        {
+            if ('h' == sig[0])
+            {
+                throw CodegenException("File descriptors (h) are not supported; "
+                                       "use DBus::Proxy::Client::CallWithFDs()");
+            }
+            auto it = basic.find(sig[0]);
+            if (basic.end() == it)
+            {
+                throw CodegenException("Unsupported D-Bus data type: " + sig);
+            }
+            return it->second;
+        }
+
+        const auto ch = children(sig);
+        if ('(' == sig[0])
+        {
+            std::string ret = "std::tuple<";
+            for (size_t i = 0; i < ch.size(); ++i)
+            {
+                ret += (i > 0 ? ", " : "") + CppType(ch[i]);
+            }
+            return ret + ">";
+        }
+        if ("a{" == sig.substr(0, 2))
+        {
+            return "std::map<" + CppType(ch[0]) + ", " + CppType(ch[1]) + ">";
+        }
+        if ('a' == sig[0])
+        {
+            return "std::vector<" + CppType(ch[0]) + ">";
+        }
+        throw CodegenException("Unsupported D-Bus data type: " + sig);
+    }
+
+
+    /**
+     *  Retrieve the C++ parameter declaration passing a value of a
+     *  D-Bus data type
+     *
+     * @param sig   std::string with the D-Bus data type
+     * @param name  std::string with the parameter name
+     * @return std::string
+     */
+    std::string Param(const std::string &sig, const std::string &name) const
+    {
+        if (1 == sig.size() && std::string("sog").find(sig[0]) == std::string::npos)
+        {
+            // Scalars and GVariant pointers are passed by value
+            const std::string t = CppType(sig);
+            return t + ('*' == t.back() ? "" : " ") + name;
+        }
+        return "const " + CppType(sig) + " &" + name;
+    }
+
+
+    /**
+     *  Retrieve the helper function name marshalling a value
+     *  of a D-Bus data type
+     */
+    std::string Marshal(const std::string &sig) const
+    {
+        return "marshal_" + mangle(sig);
+    }
+
+
+    /**
+     *  Retrieve the helper function name parsing a GVariant value
+     *  of a D-Bus data type
+     */
+    std::string Unmarshal(const std::string &sig) const
+    {
+        return "unmarshal_" + mangle(sig);
+    }
+
+
+    /**
+     *  Generate the marshalling helper functions of all the D-Bus data
+     *  types declared as used.  Contained data types are declared first.
+     *
+     * @param out  std::ostream to write the code to
+     */
+    void GenerateHelpers(std::ostream &out) const
+    {
+        out << "template <typename T>\n"
+            << "inline T extract_child(GVariant *v, gsize idx, T (*unmarshal)(GVariant *))\n"
+            << "{\n"
+            << "    GVariant *c = g_variant_get_child_value(v, idx);\n"
+            << "    T ret = unmarshal(c);\n"
+            << "    g_variant_unref(c);\n"
+            << "    return ret;\n"
+            << "}\n\n";
+
+        out << "inline void check_reply(GVariant *res,\n"
+            << "                        const char *type,\n"
+            << "                        const std::string &destination,\n"
+            << "                        const DBus::Proxy::TargetPreset::Ptr &preset,\n"
+            << "                        const std::string &member)\n"
+            << "{\n"
+            << "    if (!g_variant_is_of_type(res, reinterpret_cast<const GVariantType *>(type)))\n"
+            << "    {\n"
+            << "        const std::string got(g_variant_get_type_string(res));\n"
+            << "        g_variant_unref(res);\n"
+            << "        throw DBus::Proxy::Exception(destination,\n"
+            << "                                     preset->object_path,\n"
+            << "                                     preset->interface,\n"
+            << "                                     member,\n"
+            << "                                     \"Unexpected reply data type '\" + got\n"
+            << "                                         + \"', expected '\" + type + \"'\");\n"
+            << "    }\n"
+            << "}\n\n";
+
+        for (const auto &sig : used)
+        {
+            generate_helpers(out, sig);
+        }
+    }
+
+
+  private:
+    std::vector<std::string> used{};
+
+
+    /**
+     *  Find the end of the single complete D-Bus data type
+     *  starting at a given position
+     */
+    static size_t type_end(const std::string &sig, size_t pos)
+    {
+        if (pos >= sig.size())
+        {
+            throw CodegenException("Truncated D-Bus data type: " + sig);
+        }
+        switch (sig[pos])
+        {
+        case 'a':
+            return type_end(sig, pos + 1);
+        case '(':
+        case '{':
+            {
+                const char close = ('(' == sig[pos] ? ')' : '}');
+                ++pos;
+                while (pos < sig.size() && sig[pos] != close)
+                {
+                    pos = type_end(sig, pos);
+                }
+                if (pos >= sig.size())
+                {
+                    throw CodegenException("Truncated D-Bus data type: " + sig);
+                }
+                return pos + 1;
+            }
+        default:
+            return pos + 1;
+        }
+    }
+
+
+    /**
+     *  Split a container data type into the data types it contains.
+     *  For dictionaries, this is the key and value data types.
+     */
+    static std::vector<std::string> children(const std::string &sig)
+    {
+        std::vector<std::string> ret;
+        size_t start = 0;
+        size_t end = sig.size();
+        if ("a{" == sig.substr(0, 2))
+        {
+            start = 2;
+            end = sig.size() - 1;
+        }
+        else if ('a' == sig[0])
+        {
+            return {sig.substr(1)};
+        }
+        else if ('(' == sig[0])
+        {
+            start = 1;
+            end = sig.size() - 1;
+        }
+        else
+        {
+            return {};
+        }
+
+        while (start < end)
+        {
+            const size_t next = type_end(sig, start);
+            ret.push_back(sig.substr(start, next - start));
+            start = next;
+        }
+        return ret;
+    }
+
+
+    static std::string mangle(const std::string &sig)
+    {
+        std::string ret;
+        for (const char c : sig)
+        {
+            switch (c)
+            {
+            case '(':
+                ret += 'r';
+                break;
+            case ')':
+                ret += 'R';
+                break;
+            case '{':
+                ret += 'e';
+                break;
+            case '}':
+                ret += 'E';
+                break;
+            default:
+                ret += c;
+            }
+        }
+        return ret;
+    }
+
+
+    static bool is_fixed(const std::string &sig)
+    {
+        return 1 == sig.size() && std::string("ynqiuxtd").find(sig[0]) != std::string::npos;
+    }
+
+
+    static std::string type_ptr(const std::string &sig)
+    {
+        return "reinterpret_cast<const GVariantType *>(\"" + sig + "\")";
+    }
+
+
+    void generate_helpers(std::ostream &out, const std::string &sig) const
+    {
+        static const std::map<char, std::pair<std::string, std::string>> basic = {
+            {'y', {"g_variant_new_byte(v)", "g_variant_get_byte(v)"}},
+            {'b', {"g_variant_new_boolean(v)", "g_variant_get_boolean(v)"}},
+            {'n', {"g_variant_new_int16(v)", "g_variant_get_int16(v)"}},
+            {'q', {"g_variant_new_uint16(v)", "g_variant_get_uint16(v)"}},
+            {'i', {"g_variant_new_int32(v)", "g_variant_get_int32(v)"}},
+            {'u', {"g_variant_new_uint32(v)", "g_variant_get_uint32(v)"}},
+            {'x', {"g_variant_new_int64(v)", "g_variant_get_int64(v)"}},
+            {'t', {"g_variant_new_uint64(v)", "g_variant_get_uint64(v)"}},
+            {'d', {"g_variant_new_double(v)", "g_variant_get_double(v)"}},
+            {'s', {"g_variant_new_string(v.c_str())", "std::string(g_variant_get_string(v, nullptr))"}},
+            {'o', {"g_variant_new_object_path(v.c_str())", "DBus::Object::Path(g_variant_get_string(v, nullptr))"}},
+            {'g', {"g_variant_new_signature(v.c_str())", "std::string(g_variant_get_string(v, nullptr))"}},
+            {'v', {"g_variant_new_variant(v)", "g_variant_get_variant(v)"}}};
+
+        const std::string cpp = CppType(sig);
+        const auto ch = children(sig);
+
+        out << "inline GVariant *" << Marshal(sig) << "(" << Param(sig, "v") << ")\n"
+            << "{\n";
+        if (1 == sig.size())
+        {
+            out << "    return " << basic.at(sig[0]).first << ";\n";
+        }
+        else if ('(' == sig[0])
+        {
+            if (ch.empty())
+            {
+                out << "    return g_variant_new_tuple(nullptr, 0);\n";
+            }
+            else
+            {
+                out << "    GVariant *c[] = {";
+                for (size_t i = 0; i < ch.size(); ++i)
+                {
+                    out << (i > 0 ? ",\n                     " : "")
+                        << Marshal(ch[i]) << "(std::get<" << i << ">(v))";
+                }
+                out << "};\n"
+                    << "    return g_variant_new_tuple(c, " << ch.size() << ");\n";
+            }
+        }
+        else if (is_fixed(ch[0]) && "a{" != sig.substr(0, 2))
+        {
+            out << "    return g_variant_new_fixed_array(" << type_ptr(ch[0]) << ",\n"
+                << "                                     v.data(),\n"
+                << "                                     v.size(),\n"
+                << "                                     sizeof(" << CppType(ch[0]) << "));\n";
+        }
+        else
+        {
+            const bool dict = ("a{" == sig.substr(0, 2));
+            out << "    std::vector<GVariant *> c;\n"
+                << "    c.reserve(v.size());\n"
+                << "    for (const auto &e : v)\n"
+                << "    {\n";
+            if (dict)
+            {
+                out << "        c.push_back(g_variant_new_dict_entry(" << Marshal(ch[0]) << "(e.first),\n"
+                    << "                                             " << Marshal(ch[1]) << "(e.second)));\n";
+            }
+            else
+            {
+                out << "        c.push_back(" << Marshal(ch[0]) << "(e));\n";
+            }
+            out << "    }\n"
+                << "    return g_variant_new_array(" << type_ptr(sig.substr(1)) << ", c.data(), c.size());\n";
+        }
+        out << "}\n\n";
+
+        out << "inline " << cpp << ('*' == cpp.back() ? "" : " ") << Unmarshal(sig) << "(GVariant *v)\n"
+            << "{\n";
+        if (1 == sig.size())
+        {
+            out << "    return " << basic.at(sig[0]).second << ";\n";
+        }
+        else if ('(' == sig[0])
+        {
+            out << "    return " << cpp << "(";
+            for (size_t i = 0; i < ch.size(); ++i)
+            {
+                out << (i > 0 ? "," : "") << "\n        "
+                    << "extract_child(v, " << i << ", " << Unmarshal(ch[i]) << ")";
+            }
+            out << ");\n";
+        }
+        else if (is_fixed(ch[0]) && "a{" != sig.substr(0, 2))
+        {
+            const std::string elm = CppType(ch[0]);
+            out << "    gsize count = 0;\n"
+                << "    auto e = static_cast<const " << elm << " *>(g_variant_get_fixed_array(v, &count, sizeof(" << elm << ")));\n"
+                << "    return " << cpp << "(e, e + count);\n";
+        }
+        else if ("a{" == sig.substr(0, 2))
+        {
+            out << "    " << cpp << " ret;\n"
+                << "    const gsize count = g_variant_n_children(v);\n"
+                << "    for (gsize i = 0; i < count; ++i)\n"
+                << "    {\n"
+                << "        GVariant *e = g_variant_get_child_value(v, i);\n"
+                << "        ret.emplace(extract_child(e, 0, " << Unmarshal(ch[0]) << "),\n"
+                << "                    extract_child(e, 1, " << Unmarshal(ch[1]) << "));\n"
+                << "        g_variant_unref(e);\n"
+                << "    }\n"
+                << "    return ret;\n";
+        }
+        else
+        {
+            out << "    " << cpp << " ret;\n"
+                << "    const gsize count = g_variant_n_children(v);\n"
+                << "    ret.reserve(count);\n"
+                << "    for (gsize i = 0; i < count; ++i)\n"
+                << "    {\n"
+                << "        ret.push_back(extract_child(v, i, " << Unmarshal(ch[0]) << "));\n"
+                << "    }\n"
+                << "    return ret;\n";
+        }
+        out << "}\n\n";
+    }
+};
+
+
+
+/**
+ *  Make a valid C++ identifier of a D-Bus name
+ */
+static std::string identifier(const std::string &name)
+{
+    static const std::set<std::string> reserved = {
+        "alignas", "alignof", "and", "asm", "auto", "bool", "break", "case",
+        "catch", "char", "class", "const", "constexpr", "continue", "default",
+        "delete", "do", "double", "else", "enum", "explicit", "export",
+        "extern", "false", "float", "for", "friend", "goto", "if", "inline",
+        "int", "long", "mutable", "namespace", "new", "noexcept", "not",
+        "nullptr", "operator", "or", "private", "protected", "public",
+        "register", "return", "short", "signed", "sizeof", "static",
+        "struct", "switch", "template", "this", "throw", "true", "try",
+        "typedef", "typename", "union", "unsigned", "using", "virtual",
+        "void", "volatile", "while", "xor"};
+
+    std::string ret;
+    for (const char c : name)
+    {
+        ret += (std::isalnum(static_cast<unsigned char>(c)) ? c : '_');
+    }
+    if (ret.empty() || std::isdigit(static_cast<unsigned char>(ret[0])))
+    {
+        ret = "_" + ret;
+    }
+    if (reserved.count(ret) > 0)
+    {
+        ret += "_";
+    }
+    return ret;
+}
+
+
+static std::string class_name(const std::string &interface)
+{
+    std::string name = interface.substr(interface.rfind('.') + 1);
+    name = identifier(name);
+    name[0] = static_cast<char>(std::toupper(static_cast<unsigned char>(name[0])));
+    return name;
+}
+
+
+/**
+ *  Name of the C++ accessor methods of a D-Bus property, without the
+ *  Get/Set prefix.  Each word of the property name is capitalized, so
+ *  "counter" and "session_count" become "Counter" and "SessionCount".
+ */
+static std::string accessor_name(const std::string &property)
+{
+    std::string ret;
+    bool upper = true;
+    for (const char c : property)
+    {
+        if (!std::isalnum(static_cast<unsigned char>(c)))
+        {
+            upper = true;
+            continue;
+        }
+        ret += (upper ? static_cast<char>(std::toupper(static_cast<unsigned char>(c))) : c);
+        upper = false;
+    }
+    return ret;
+}
+
+
+/**
+ *  Ensure the generated C++ methods of an interface do not collide.  This
+ *  can happen with property accessors matching a D-Bus method name, like
+ *  a "GetCounter" method next to a "counter" property.
+ *
+ * @throws CodegenException if two members map to the same C++ method
+ */
+static void check_member_names(GDBusInterfaceInfo *iface)
+{
+    std::map<std::string, std::string> names;
+    auto add = [&names, iface](const std::string &cpp, const std::string &member)
+    {
+        auto r = names.emplace(cpp, member);
+        if (!r.second)
+        {
+            throw CodegenException(std::string(iface->name) + ": '" + member
+                                   + "' and '" + r.first->second
+                                   + "' both map to the C++ method " + cpp + "()");
+        }
+    };
+
+    for (size_t m = 0; iface->methods && iface->methods[m]; ++m)
+    {
+        add(identifier(iface->methods[m]->name), iface->methods[m]->name);
+    }
+    for (size_t p = 0; iface->properties && iface->properties[p]; ++p)
+    {
+        GDBusPropertyInfo *prop = iface->properties[p];
+        add("Get" + accessor_name(prop->name), prop->name);
+        if (prop->flags & G_DBUS_PROPERTY_INFO_FLAGS_WRITABLE)
+        {
+            add("Set" + accessor_name(prop->name), prop->name);
+        }
+    }
+}
+
+
+static std::vector<Argument> parse_args(GDBusArgInfo **args)
+{
+    std::vector<Argument> ret;
+    for (size_t i = 0; args && args[i]; ++i)
+    {
+        const std::string name = (args[i]->name ? args[i]->name : "");
+        ret.push_back({identifier(name.empty() ? "arg" + std::to_string(i) : name),
+                       args[i]->signature});
+    }
+    return ret;
+}
+
+
+/**
+ *  C++ return type of a D-Bus method with the given output arguments
+ */
+static std::string return_type(const TypeMapper &types, const std::vector<Argument> &out)
+{
+    if (out.empty())
+    {
+        return "void";
+    }
+    if (1 == out.size())
+    {
+        return types.CppType(out[0].signature);
+    }
+    std::string ret = "std::tuple<";
+    for (size_t i = 0; i < out.size(); ++i)
+    {
+        ret += (i > 0 ? ", " : "") + types.CppType(out[i].signature);
+    }
+    return ret + ">";
+}
+
+
+static std::string param_list(const TypeMapper &types, const std::vector<Argument> &in)
+{
+    std::string ret;
+    for (size_t i = 0; i < in.size(); ++i)
+    {
+        ret += (i > 0 ? ", " : "") + types.Param(in[i].signature, in[i].name);
+    }
+    return ret;
+}
+
+
+/**
+ *  Generate the code building the GVariant tuple of a list of arguments.
+ *  The values are taken from the given C++ expressions.
+ */
+static void gen_build_tuple(std::ostream &out,
+                            const TypeMapper &types,
+                            const std::vector<Argument> &args,
+                            const std::vector<std::string> &exprs,
+                            const std::string &indent,
+                            const std::string &var)
+{
+    out << indent << "GVariant *" << var << "_c[] = {";
+    for (size_t i = 0; i < args.size(); ++i)
+    {
+        out << (i > 0 ? ",\n" + indent + std::string(var.size() + 18, ' ') : "")
+            << types.Marshal(args[i].signature) << "(" << exprs[i] << ")";
+    }
+    out << "};\n"
+        << indent << "GVariant *" << var << " = g_variant_new_tuple(" << var << "_c, " << args.size() << ");\n";
+}
+
+
+/**
+ *  Generate the code checking the data type of the GVariant tuple of a
+ *  list of output arguments and parsing it into the C++ return type
+ */
+static void gen_parse_result(std::ostream &out,
+                             const TypeMapper &types,
+                             const std::vector<Argument> &args,
+                             const std::string &indent,
+                             const std::string &var,
+                             const std::string &member)
+{
+    if (args.empty())
+    {
+        out << indent << "if (" << var << ")\n"
+            << indent << "{\n"
+            << indent << "    g_variant_unref(" << var << ");\n"
+            << indent << "}\n";
+        return;
+    }
+
+    std::string sig = "(";
+    for (const auto &a : args)
+    {
+        sig += a.signature;
+    }
+    sig += ")";
+    out << indent << "check_reply(" << var << ", \"" << sig << "\", "
+        << "this->client->GetDestination(), this->preset, \"" << member << "\");\n";
+
+    if (1 == args.size())
+    {
+        out << indent << "auto _ret = extract_child(" << var << ", 0, "
+            << types.Unmarshal(args[0].signature) << ");\n"
+            << indent << "g_variant_unref(" << var << ");\n"
+            << indent << "return _ret;\n";
+        return;
+    }
+    out << indent << "auto _ret = " << return_type(types, args) << "(";
+    for (size_t i = 0; i < args.size(); ++i)
+    {
+        out << (i > 0 ? "," : "") << "\n" << indent << "    "
+            << "extract_child(" << var << ", " << i << ", " << types.Unmarshal(args[i].signature) << ")";
+    }
+    out << ");\n"
+        << indent << "g_variant_unref(" << var << ");\n"
+        << indent << "return _ret;\n";
+}
+
+
+static void gen_proxy(std::ostream &out,
+                      const TypeMapper &types,
+                      const std::string &cls,
+                      GDBusInterfaceInfo *iface)
+{
+    out << "/**\n"
+        << " *  Typed D-Bus proxy client of the " << iface->name << " interface\n"
+        << " */\n"
+        << "class " << cls << "Proxy\n"
+        << "{\n"
+        << "  public:\n"
+        << "    using Ptr = std::shared_ptr<" << cls << "Proxy>;\n\n"
+        << "    static constexpr const char *INTERFACE = \"" << iface->name << "\";\n\n"
+        << "    [[nodiscard]] static Ptr Create(DBus::Proxy::Client::Ptr client,\n"
+        << "                                    const DBus::Object::Path &path)\n"
+        << "    {\n"
+        << "        return Ptr(new " << cls << "Proxy(client, path));\n"
+        << "    }\n\n";
+
+    for (size_t m = 0; iface->methods && iface->methods[m]; ++m)
+    {
+        GDBusMethodInfo *meth = iface->methods[m];
+        const auto in = parse_args(meth->in_args);
+        const auto outargs = parse_args(meth->out_args);
+
+        out << "    " << return_type(types, outargs) << " " << identifier(meth->name)
+            << "(" << param_list(types, in) << ") const\n"
+            << "    {\n";
+        std::string params = "nullptr";
+        if (!in.empty())
+        {
+            std::vector<std::string> exprs;
+            for (const auto &a : in)
+            {
+                exprs.push_back(a.name);
+            }
+            gen_build_tuple(out, types, in, exprs, "        ", "_params");
+            params = "_params";
+        }
+        out << "        GVariant *_res = this->client->Call(this->preset, \"" << meth->name << "\", " << params << ");\n";
+        gen_parse_result(out, types, outargs, "        ", "_res", meth->name);
+        out << "    }\n\n";
+    }
+
+    for (size_t p = 0; iface->properties && iface->properties[p]; ++p)
+    {
+        GDBusPropertyInfo *prop = iface->properties[p];
+        const std::string sig = prop->signature;
+        const std::string name = accessor_name(prop->name);
+        const std::string cpp = types.CppType(sig);
+        out << "    " << cpp << ('*' == cpp.back() ? "" : " ") << "Get" << name << "() const\n"
+            << "    {\n"
+            << "        GVariant *res = client->GetPropertyGVariant(preset, \"" << prop->name << "\");\n"
+            << "        check_reply(res, \"" << sig << "\", client->GetDestination(), preset, \"" << prop->name << "\");\n"
+            << "        auto ret = " << types.Unmarshal(sig) << "(res);\n"
+            << "        g_variant_unref(res);\n"
+            << "        return ret;\n"
+            << "    }\n\n";
+        if (prop->flags & G_DBUS_PROPERTY_INFO_FLAGS_WRITABLE)
+        {
+            out << "    void Set" << name << "(" << types.Param(sig, "value") << ") const\n"
+                << "    {\n"
+                << "        client->SetPropertyGVariant(preset, \"" << prop->name << "\", "
+                << types.Marshal(sig) << "(value));\n"
+                << "    }\n\n";
+        }
+    }
+
+    out << "  private:\n"
+        << "    DBus::Proxy::Client::Ptr client;\n"
+        << "    DBus::Proxy::TargetPreset::Ptr preset;\n\n"
+        << "    " << cls << "Proxy(DBus::Proxy::Client::Ptr client_,\n"
+        << "    " << std::string(cls.size() + 6, ' ') << "const DBus::Object::Path &path)\n"
+        << "        : client(client_),\n"
+        << "          preset(DBus::Proxy::TargetPreset::Create(path, INTERFACE))\n"
+        << "    {\n"
+        << "    }\n"
+        << "};\n\n\n";
+}
+
+
+static void gen_skeleton(std::ostream &out,
+                         const TypeMapper &types,
+                         const std::string &cls,
+                         GDBusInterfaceInfo *iface)
+{
+    out << "/**\n"
+        << " *  D-Bus object skeleton of the " << iface->name << " interface.\n"
+        << " *  The D-Bus methods and property accessors are implemented by a\n"
+        << " *  subclass, together with Authorize().\n"
+        << " */\n"
+        << "class " << cls << "Skeleton : public DBus::Object::Base\n"
+        << "{\n"
+        << "  public:\n"
+        << "    static constexpr const char *INTERFACE = \"" << iface->name << "\";\n\n"
+        << "  protected:\n"
+        << "    " << cls << "Skeleton(const DBus::Object::Path &path)\n"
+        << "        : DBus::Object::Base(path, INTERFACE)\n"
+        << "    {\n";
+
+    for (size_t m = 0; iface->methods && iface->methods[m]; ++m)
+    {
+        GDBusMethodInfo *meth = iface->methods[m];
+        const auto in = parse_args(meth->in_args);
+        const auto outargs = parse_args(meth->out_args);
+
+        const bool declare = !in.empty() || !outargs.empty();
+        const std::string ind(declare ? 34 : 22, ' ');
+        out << "        {\n"
+            << "            " << (declare ? "auto args = " : "") << "AddMethod(\"" << meth->name << "\",\n"
+            << ind << "[this](DBus::Object::Method::Arguments::Ptr args)\n"
+            << ind << "{\n";
+        if (!in.empty())
+        {
+            out << ind << "    GVariant *_params = args->GetMethodParameters();\n";
+        }
+        std::string call = identifier(meth->name) + "(";
+        for (size_t i = 0; i < in.size(); ++i)
+        {
+            const std::string var = "in_" + in[i].name;
+            out << ind << "    const auto " << var << " = extract_child(_params, "
+                << i << ", " << types.Unmarshal(in[i].signature) << ");\n";
+            call += (i > 0 ? ", " : "") + var;
+        }
+        call += ")";
+
+        if (outargs.empty())
+        {
+            out << ind << "    " << call << ";\n"
+                << ind << "    args->SetMethodReturn(nullptr);\n";
+        }
+        else
+        {
+            out << ind << "    const auto _ret = " << call << ";\n";
+            std::vector<std::string> exprs;
+            for (size_t i = 0; i < outargs.size(); ++i)
+            {
+                exprs.push_back(1 == outargs.size()
+                                    ? "_ret"
+                                    : "std::get<" + std::to_string(i) + ">(_ret)");
+            }
+            gen_build_tuple(out, types, outargs, exprs, ind + "    ", "_result");
+            out << ind << "    args->SetMethodReturn(_result);\n";
+        }
+        out << ind << "});\n";
+        for (const auto &a : in)
+        {
+            out << "            args->AddInput(\"" << a.name << "\", \"" << a.signature << "\");\n";
+        }
+        for (const auto &a : outargs)
+        {
+            out << "            args->AddOutput(\"" << a.name << "\", \"" << a.signature << "\");\n";
+        }
+        out << "        }\n";
+    }
+
+    for (size_t p = 0; iface->properties && iface->properties[p]; ++p)
+    {
+        GDBusPropertyInfo *prop = iface->properties[p];
+        const std::string sig = prop->signature;
+        const std::string name = accessor_name(prop->name);
+        out << "        AddPropertyBySpec(\"" << prop->name << "\",\n"
+            << "                          \"" << sig << "\",\n"
+            << "                          [this](const DBus::Object::Property::BySpec &)\n"
+            << "                          {\n"
+            << "                              return " << types.Marshal(sig) << "(Get" << name << "());\n"
+            << "                          }";
+        if (prop->flags & G_DBUS_PROPERTY_INFO_FLAGS_WRITABLE)
+        {
+            out << ",\n"
+                << "                          [this](const DBus::Object::Property::BySpec &prop, GVariant *value)\n"
+                << "                          {\n"
+                << "                              const auto newvalue = " << types.Unmarshal(sig) << "(value);\n"
+                << "                              Set" << name << "(newvalue);\n"
+                << "                              auto upd = prop.PrepareUpdate();\n"
+                << "                              upd->AddValue(" << types.Marshal(sig) << "(newvalue));\n"
+                << "                              return upd;\n"
+                << "                          }";
+        }
+        out << ");\n";
+    }
+    out << "    }\n\n";
+
+    for (size_t m = 0; iface->methods && iface->methods[m]; ++m)
+    {
+        GDBusMethodInfo *meth = iface->methods[m];
+        out << "    virtual " << return_type(types, parse_args(meth->out_args))
+            << " " << identifier(meth->name)
+            << "(" << param_list(types, parse_args(meth->in_args)) << ") = 0;\n";
+    }
+    for (size_t p = 0; iface->properties && iface->properties[p]; ++p)
+    {
+        GDBusPropertyInfo *prop = iface->properties[p];
+        const std::string cpp = types.CppType(prop->signature);
+        const std::string name = accessor_name(prop->name);
+        out << "    virtual " << cpp << ('*' == cpp.back() ? "" : " ") << "Get" << name << "() = 0;\n";
+        if (prop->flags & G_DBUS_PROPERTY_INFO_FLAGS_WRITABLE)
+        {
+            out << "    virtual void Set" << name << "(" << types.Param(prop->signature, "value") << ") = 0;\n";
+        }
+    }
+    out << "};\n\n\n";
+}
+
+
+static void usage(const char *argv0)
+{
+    std::cerr << "Usage: " << argv0 << " [--namespace NAME] [--output FILE] XML-FILE" << std::endl
+              << std::endl
+              << "  -n, --namespace NAME   C++ namespace of the generated classes" << std::endl
+              << "  -o, --output FILE      Header file to write; default: stdout" << std::endl;
+}
+
+
+int main(int argc, char **argv)
+{
+    static struct option long_opts[] = {
+        {"namespace", required_argument, nullptr, 'n'},
+        {"output", required_argument, nullptr, 'o'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}};
+
+    std::string nspace;
+    std::string output;
+    int opt = 0;
+    while ((opt = getopt_long(argc, argv, "n:o:h", long_opts, nullptr)) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            nspace = optarg;
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind + 1 != argc)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::ifstream input(argv[optind]);
+    if (!input)
+    {
+        std::cerr << "Could not open " << argv[optind] << std::endl;
+        return 2;
+    }
+    const std::string xml((std::istreambuf_iterator<char>(input)),
+                          std::istreambuf_iterator<char>());
+
+    GError *err = nullptr;
+    GDBusNodeInfo *node = g_dbus_node_info_new_for_xml(xml.c_str(), &err);
+    if (!node)
+    {
+        std::cerr << "Could not parse " << argv[optind] << ": "
+                  << (err ? err->message : "unknown error") << std::endl;
+        g_clear_error(&err);
+        return 2;
+    }
+
+    std::ostringstream code;
+    try
+    {
+        const std::string xmlfile(argv[optind]);
+        code << "//  Generated by gdbuspp-codegen from "
+             << xmlfile.substr(xmlfile.rfind('/') + 1) << "\n"
+             << "//  DO NOT EDIT\n\n"
+             << "#pragma once\n\n"
+             << "#include <cstdint>\n"
+             << "#include <map>\n"
+             << "#include <memory>\n"
+             << "#include <string>\n"
+             << "#include <tuple>\n"
+             << "#include <vector>\n"
+             << "#include <glib.h>\n"
+             << "#include <gdbuspp/object/base.hpp>\n"
+             << "#include <gdbuspp/object/path.hpp>\n"
+             << "#include <gdbuspp/proxy.hpp>\n\n\n";
+        if (!nspace.empty())
+        {
+            code << "namespace " << nspace << " {\n\n";
+        }
+
+        for (size_t i = 0; node->interfaces && node->interfaces[i]; ++i)
+        {
+            GDBusInterfaceInfo *iface = node->interfaces[i];
+            const std::string cls = class_name(iface->name);
+            check_member_names(iface);
+
+            TypeMapper types;
+            for (size_t m = 0; iface->methods && iface->methods[m]; ++m)
+            {
+                for (const auto &a : parse_args(iface->methods[m]->in_args))
+                {
+                    types.Use(a.signature);
+                }
+                for (const auto &a : parse_args(iface->methods[m]->out_args))
+                {
+                    types.Use(a.signature);
+                }
+            }
+            for (size_t p = 0; iface->properties && iface->properties[p]; ++p)
+            {
+                types.Use(iface->properties[p]->signature);
+            }
+
+            code << "namespace _codegen_" << cls << " {\n\n";
+            types.GenerateHelpers(code);
+            gen_proxy(code, types, cls, iface);
+            gen_skeleton(code, types, cls, iface);
+            code << "} // namespace _codegen_" << cls << "\n\n"
+                 << "using _codegen_" << cls << "::" << cls << "Proxy;\n"
+                 << "using _codegen_" << cls << "::" << cls << "Skeleton;\n\n\n";
+        }
+
+        if (!nspace.empty())
+        {
+            code << "} // namespace " << nspace << "\n";
+        }
+    }
+    catch (const CodegenException &excp)
+    {
+        std::cerr << "Could not generate code: " << excp.what() << std::endl;
+        g_dbus_node_info_unref(node);
+        return 3;
+    }
+    g_dbus_node_info_unref(node);
+
+    if (output.empty())
+    {
+        std::cout << code.str();
+        return 0;
+    }
+    std::ofstream outfile(output);
+    outfile << code.str();
+    if (!outfile)
+    {
+        std::cerr << "Could not write " << output << std::endl;
+        return 2;
+    }
+    return 0;
+}